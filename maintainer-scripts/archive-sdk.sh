@@ -47,8 +47,10 @@ done
 # These go just in SDK
 generate_src src xr_generated_dispatch_table.c  "$SDK_TARNAME"
 generate_src src xr_generated_dispatch_table.h  "$SDK_TARNAME"
+generate_src src xr_generated_reflection.hpp  "$SDK_TARNAME"
 generate_src src/loader xr_generated_loader.cpp  "$SDK_TARNAME"
 generate_src src/loader xr_generated_loader.hpp  "$SDK_TARNAME"
+generate_src src/loader xr_generated_loader_extensions.hpp  "$SDK_TARNAME"
 
 # If the loader doc has been generated, include it too.
 if [ -f specification/out/1.0/loader.html ]; then
@@ -20,25 +20,28 @@
 // Author: Dave Houlton <daveh@lunarg.com>
 //
 
-#include "hex_and_handles.h"
+#include "allocation_callbacks.h"
+#include "api_dump_capture.h"
+#include "api_dump_filter.h"
+#include "api_dump_json.h"
+#include "background_file_writer.h"
 #include "loader_interfaces.h"
 #include "platform_utils.hpp"
 #include "xr_generated_api_dump.hpp"
+#include "xr_generated_api_dump_json.hpp"
 #include "xr_generated_dispatch_table.h"
 
 #include <openxr/openxr.h>
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <mutex>
-#include <sstream>
 #include <stdexcept>
 #include <string>
-#include <tuple>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -58,345 +61,319 @@ enum ApiDumpRecordType {
     RECORD_TEXT_FILE,
     RECORD_HTML_FILE,
     RECORD_CODE_FILE,
+    RECORD_CAPTURE_FILE,
+    RECORD_JSON_LINES,
 };
 
 struct ApiDumpRecordInfo {
     bool initialized;
     ApiDumpRecordType type;
+    // Read by the first instance and kept after it is destroyed, so not from the allocation callbacks.
     std::string file_name;
+    uint64_t max_file_size;
 };
 
 static ApiDumpRecordInfo g_record_info = {};
 static std::mutex g_record_mutex = {};
+// Keeps two first instances from choosing the commands to record at the same time.
+static std::mutex g_filter_mutex;
+// Writes the RECORD_TEXT_FILE, RECORD_HTML_FILE and RECORD_CAPTURE_FILE output, and the RECORD_JSON_LINES
+// output when it has a file name
+static BackgroundFileWriter g_record_writer;
+// Whether the capture file was already started, by an earlier instance.
+static bool g_capture_started = false;
+// Whether JSON lines were already written, by an earlier instance, which started their times.
+static bool g_json_started = false;
 
 // HTML utilities
-bool ApiDumpLayerWriteHtmlHeader() {
-    try {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-        std::ofstream html_file;
-        html_file.open(g_record_info.file_name, std::ios::out);
-        html_file << "<!doctype html>\n"
-                     "<html>\n"
-                     "    <head>\n"
-                     "        <title>OpenXR API Dump</title>\n"
-                     "        <style type='text/css'>\n"
-                     "        html {\n"
-                     "            background-color: #0b1e48;\n"
-                     "            background-image: url('https://vulkan.lunarg.com/img/bg-starfield.jpg');\n"
-                     "            background-position: center;\n"
-                     "            -webkit-background-size: cover;\n"
-                     "            -moz-background-size: cover;\n"
-                     "            -o-background-size: cover;\n"
-                     "            background-size: cover;\n"
-                     "            background-attachment: fixed;\n"
-                     "            background-repeat: no-repeat;\n"
-                     "            height: 100%;\n"
-                     "        }\n"
-                     "        #header {\n"
-                     "            z-index: -1;\n"
-                     "        }\n"
-                     "        #header>img {\n"
-                     "            position: absolute;\n"
-                     "            width: 160px;\n"
-                     "            margin-left: -280px;\n"
-                     "            top: -10px;\n"
-                     "            left: 50%;\n"
-                     "        }\n"
-                     "        #header>h1 {\n"
-                     "            font-family: Arial, 'Helvetica Neue', Helvetica, sans-serif;\n"
-                     "            font-size: 44px;\n"
-                     "            font-weight: 200;\n"
-                     "            text-shadow: 4px 4px 5px #000;\n"
-                     "            color: #eee;\n"
-                     "            position: absolute;\n"
-                     "            width: 400px;\n"
-                     "            margin-left: -80px;\n"
-                     "            top: 8px;\n"
-                     "            left: 50%;\n"
-                     "        }\n"
-                     "        body {\n"
-                     "            font-family: Consolas, monaco, monospace;\n"
-                     "            font-size: 14px;\n"
-                     "            line-height: 20px;\n"
-                     "            color: #eee;\n"
-                     "            height: 100%;\n"
-                     "            margin: 0;\n"
-                     "            overflow: hidden;\n"
-                     "        }\n"
-                     "        #wrapper {\n"
-                     "            background-color: rgba(0, 0, 0, 0.7);\n"
-                     "            border: 1px solid #446;\n"
-                     "            box-shadow: 0px 0px 10px #000;\n"
-                     "            padding: 8px 12px;\n"
-                     "            display: inline-block;\n"
-                     "            position: absolute;\n"
-                     "            top: 80px;\n"
-                     "            bottom: 25px;\n"
-                     "            left: 50px;\n"
-                     "            right: 50px;\n"
-                     "            overflow: auto;\n"
-                     "        }\n"
-                     "        details>*:not(summary) {\n"
-                     "            margin-left: 22px;\n"
-                     "        }\n"
-                     "        summary:only-child {\n"
-                     "            display: block;\n"
-                     "            padding-left: 15px;\n"
-                     "        }\n"
-                     "        details>summary:only-child::-webkit-details-marker {\n"
-                     "            display: none;\n"
-                     "            padding-left: 15px;\n"
-                     "        }\n"
-                     "        .headervar, .headertype, .headerval {\n"
-                     "            display: inline;\n"
-                     "            margin: 0 9px;\n"
-                     "        }\n"
-                     "        .var, .type, .val {\n"
-                     "            display: inline;\n"
-                     "            margin: 0 6px;\n"
-                     "        }\n"
-                     "        .headertype, .type {\n"
-                     "            color: #acf;\n"
-                     "        }\n"
-                     "        .headerval, .val {\n"
-                     "            color: #afa;\n"
-                     "            text-align: right;\n"
-                     "        }\n"
-                     "        .thd {\n"
-                     "            color: #888;\n"
-                     "        }\n"
-                     "        </style>\n"
-                     "    </head>\n"
-                     "    <body>\n"
-                     "        <div id='header'>\n"
-                     "            <img src='https://lunarg.com/wp-content/uploads/2016/02/LunarG-wReg-150.png' />\n"
-                     "            <h1>OpenXR API Dump</h1>\n"
-                     "        </div>\n"
-                     "        <div id='wrapper'>\n";
-        return true;
-    } catch (...) {
-        return false;
-    }
+const char *ApiDumpLayerHtmlHeader() {
+    return "<!doctype html>\n"
+           "<html>\n"
+           "    <head>\n"
+           "        <title>OpenXR API Dump</title>\n"
+           "        <style type='text/css'>\n"
+           "        html {\n"
+           "            background-color: #0b1e48;\n"
+           "            background-image: url('https://vulkan.lunarg.com/img/bg-starfield.jpg');\n"
+           "            background-position: center;\n"
+           "            -webkit-background-size: cover;\n"
+           "            -moz-background-size: cover;\n"
+           "            -o-background-size: cover;\n"
+           "            background-size: cover;\n"
+           "            background-attachment: fixed;\n"
+           "            background-repeat: no-repeat;\n"
+           "            height: 100%;\n"
+           "        }\n"
+           "        #header {\n"
+           "            z-index: -1;\n"
+           "        }\n"
+           "        #header>img {\n"
+           "            position: absolute;\n"
+           "            width: 160px;\n"
+           "            margin-left: -280px;\n"
+           "            top: -10px;\n"
+           "            left: 50%;\n"
+           "        }\n"
+           "        #header>h1 {\n"
+           "            font-family: Arial, 'Helvetica Neue', Helvetica, sans-serif;\n"
+           "            font-size: 44px;\n"
+           "            font-weight: 200;\n"
+           "            text-shadow: 4px 4px 5px #000;\n"
+           "            color: #eee;\n"
+           "            position: absolute;\n"
+           "            width: 400px;\n"
+           "            margin-left: -80px;\n"
+           "            top: 8px;\n"
+           "            left: 50%;\n"
+           "        }\n"
+           "        body {\n"
+           "            font-family: Consolas, monaco, monospace;\n"
+           "            font-size: 14px;\n"
+           "            line-height: 20px;\n"
+           "            color: #eee;\n"
+           "            height: 100%;\n"
+           "            margin: 0;\n"
+           "            overflow: hidden;\n"
+           "        }\n"
+           "        #wrapper {\n"
+           "            background-color: rgba(0, 0, 0, 0.7);\n"
+           "            border: 1px solid #446;\n"
+           "            box-shadow: 0px 0px 10px #000;\n"
+           "            padding: 8px 12px;\n"
+           "            display: inline-block;\n"
+           "            position: absolute;\n"
+           "            top: 80px;\n"
+           "            bottom: 25px;\n"
+           "            left: 50px;\n"
+           "            right: 50px;\n"
+           "            overflow: auto;\n"
+           "        }\n"
+           "        details>*:not(summary) {\n"
+           "            margin-left: 22px;\n"
+           "        }\n"
+           "        summary:only-child {\n"
+           "            display: block;\n"
+           "            padding-left: 15px;\n"
+           "        }\n"
+           "        details>summary:only-child::-webkit-details-marker {\n"
+           "            display: none;\n"
+           "            padding-left: 15px;\n"
+           "        }\n"
+           "        .headervar, .headertype, .headerval {\n"
+           "            display: inline;\n"
+           "            margin: 0 9px;\n"
+           "        }\n"
+           "        .var, .type, .val {\n"
+           "            display: inline;\n"
+           "            margin: 0 6px;\n"
+           "        }\n"
+           "        .headertype, .type {\n"
+           "            color: #acf;\n"
+           "        }\n"
+           "        .headerval, .val {\n"
+           "            color: #afa;\n"
+           "            text-align: right;\n"
+           "        }\n"
+           "        .thd {\n"
+           "            color: #888;\n"
+           "        }\n"
+           "        </style>\n"
+           "    </head>\n"
+           "    <body>\n"
+           "        <div id='header'>\n"
+           "            <img src='https://lunarg.com/wp-content/uploads/2016/02/LunarG-wReg-150.png' />\n"
+           "            <h1>OpenXR API Dump</h1>\n"
+           "        </div>\n"
+           "        <div id='wrapper'>\n";
 }
 
-bool ApiDumpLayerWriteHtmlFooter() {
-    try {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-        std::ofstream html_file;
-        html_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-        html_file << "        </div>\n"
-                     "    </body>\n"
-                     "</html>";
-
-        // Writing the footer means we're done.
-        if (g_record_info.initialized) {
-            g_record_info.initialized = false;
-            g_record_info.type = RECORD_NONE;
-        }
-
-        return true;
-    } catch (...) {
-        return false;
-    }
+const char *ApiDumpLayerHtmlFooter() {
+    return "        </div>\n"
+           "    </body>\n"
+           "</html>";
 }
 
 // Api Dump Utility function to return an instance based on the generated dispatch table
 // pointer.
 XrInstance FindInstanceFromDispatchTable(XrGeneratedDispatchTable *dispatch_table) {
-    std::unique_lock<std::mutex> mlock(g_instance_dispatch_mutex);
     XrInstance instance = XR_NULL_HANDLE;
-    for (auto it = g_instance_dispatch_map.begin(); it != g_instance_dispatch_map.end();) {
-        if (it->second == dispatch_table) {
-            instance = it->first;
-            break;
+    g_instance_dispatch_map.ForEach([&](XrInstance entry_instance, XrGeneratedDispatchTable *entry_table) {
+        if (entry_table == dispatch_table) {
+            instance = entry_instance;
         }
-    }
+    });
     return instance;
 }
 
+// Count the structure, pointer and array dereferences in an entry name
+static uint32_t ApiDumpCountDereferences(const char *name, size_t size) {
+    uint32_t count = 0;
+    for (size_t index = 0; index < size; ++index) {
+        if (name[index] == '.' || name[index] == '[' || (name[index] == '-' && index + 1 < size && name[index + 1] == '>')) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Format the contents as text, one entry per line
+static void ApiDumpFormatText(const ApiDumpContents &contents, std::string &record) {
+    for (size_t index = 0; index < contents.Size(); ++index) {
+        if (index != 0) {
+            record.append("    ");
+        }
+        record.append(contents.Type(index));
+        record.push_back(' ');
+        record.append(contents.Name(index), contents.NameSize(index));
+        if (contents.ValueSize(index) != 0) {
+            record.append(" = ");
+            record.append(contents.Value(index), contents.ValueSize(index));
+        }
+        record.push_back('\n');
+    }
+}
+
+// Format the contents as HTML, with a collapsible section for each structure, pointer and array
+static void ApiDumpFormatHtml(const ApiDumpContents &contents, std::string &record) {
+    // Entries whose name starts the names of the entries in the open sections
+    thread_local std::vector<size_t> prefixes;
+    prefixes.clear();
+
+    record.append("<details class='data'>\n");
+    uint32_t last_deref_count = 0;
+    for (size_t index = 0; index < contents.Size(); ++index) {
+        const char *type = contents.Type(index);
+        const char *name = contents.Name(index);
+        size_t name_size = contents.NameSize(index);
+        if (index == 0) {
+            record.append("   <summary>\n      <div class='headertype'>");
+            record.append(type);
+            record.append("</div>\n      <div class='headervar'>");
+            record.append(name, name_size);
+            record.append("</div>\n   </summary>\n");
+            continue;
+        }
+
+        // Count number of structure, pointer and array dereferences for the current line
+        uint32_t cur_deref_count = ApiDumpCountDereferences(name, name_size);
+        // If there's something after this, see if it's a sub-component of this.
+        uint32_t next_deref_count = 0;
+        if (index + 1 < contents.Size()) {
+            next_deref_count = ApiDumpCountDereferences(contents.Name(index + 1), contents.NameSize(index + 1));
+        }
+
+        // If we've reduced the number of dereferences in the name from last time, we need
+        // to close up those detail sections.
+        if (cur_deref_count < last_deref_count) {
+            uint32_t diff_count = last_deref_count - cur_deref_count;
+            while ((diff_count--) != 0u) {
+                record.append("   </details>\n");
+                prefixes.pop_back();
+            }
+        }
+
+        // Look through any prefixes we've saved (going backwards through the list)
+        // and find the one that matches our beginning.
+        const char *short_name = name;
+        size_t short_name_size = name_size;
+        if (cur_deref_count > 0) {
+            for (auto it = prefixes.rbegin(); it != prefixes.rend(); ++it) {
+                size_t prefix_size = contents.NameSize(*it);
+                if (prefix_size <= name_size && memcmp(name, contents.Name(*it), prefix_size) == 0) {
+                    size_t additional_offset = prefix_size + 1;
+                    if (prefix_size < name_size && name[prefix_size] == '-') {
+                        additional_offset++;
+                    } else if (prefix_size < name_size && name[prefix_size] == '[') {
+                        additional_offset--;
+                    }
+                    additional_offset = std::min(additional_offset, name_size);
+                    short_name = name + additional_offset;
+                    short_name_size = name_size - additional_offset;
+                    break;
+                }
+            }
+        }
+
+        bool writing_summary = false;
+
+        // If the next item contains this item as a prefix, start the summary.  Otherwise,
+        // start a <div> marker so that each component lands on its own line.
+        if (cur_deref_count < next_deref_count) {
+            record.append("   <details class='data'>\n      <summary>\n");
+            writing_summary = true;
+            prefixes.push_back(index);
+        } else {
+            record.append("      <div class='data'>\n");
+        }
+
+        // Write out the content
+        record.append("         <div class='type'>");
+        record.append(type);
+        record.append("</div>\n         <div class='var'>");
+        record.append(short_name, short_name_size);
+        record.append("</div>\n");
+        bool value_needs_printing = true;
+        if (strstr(type, "char") != nullptr) {
+            size_t star_count = std::count(type, type + strlen(type), '*');
+            size_t bracket_count = std::count(type, type + strlen(type), '[');
+            if (star_count + bracket_count < 2) {
+                record.append("         <div class='val'>\"");
+                record.append(contents.Value(index), contents.ValueSize(index));
+                record.append("\"</div>");
+                value_needs_printing = false;
+            }
+        }
+        if (contents.ValueSize(index) != 0 && value_needs_printing) {
+            record.append("         <div class='val'>");
+            record.append(contents.Value(index), contents.ValueSize(index));
+            record.append("</div>");
+        }
+        record.push_back('\n');
+
+        // Wrap up any summary we may have started.  Otherwise, just wrap up the
+        // <div> marker wrapping this entry.
+        if (writing_summary) {
+            record.append("      </summary>\n");
+        } else {
+            record.append("      </div>\n");
+        }
+
+        last_deref_count = cur_deref_count;
+    }
+
+    // Wrap up any remaining items
+    while ((last_deref_count--) != 0u) {
+        record.append("   </details>\n");
+    }
+    record.append("</details>\n");
+}
+
 // Function to record all the API dump information
-bool ApiDumpLayerRecordContent(std::vector<std::tuple<std::string, std::string, std::string>> contents) {
+bool ApiDumpLayerRecordContent(const ApiDumpContents &contents) {
     bool success = false;
     if (g_record_info.initialized) {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-        uint32_t count = 0;
+        // Formatted here, on the calling thread, into storage kept for the next command.
+        thread_local std::string record;
+        record.clear();
         switch (g_record_info.type) {
             case RECORD_TEXT_COUT: {
-                for (const auto &content : contents) {
-                    std::string content_type;
-                    std::string content_name;
-                    std::string content_value;
-                    std::tie(content_type, content_name, content_value) = content;
-                    if (count++ != 0) {
-                        std::cout << "    ";
-                    }
-                    if (!content_value.empty()) {
-                        std::cout << content_type << " " << content_name << " = " << content_value << "\n";
-                    } else {
-                        std::cout << content_type << " " << content_name << "\n";
-                    }
-                }
+                ApiDumpFormatText(contents, record);
+                std::unique_lock<std::mutex> mlock(g_record_mutex);
+                std::cout.write(record.data(), static_cast<std::streamsize>(record.size()));
                 success = true;
                 break;
             }
-            case RECORD_TEXT_FILE: {
-                std::ofstream text_file;
-                text_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-                for (const auto &content : contents) {
-                    std::string content_type;
-                    std::string content_name;
-                    std::string content_value;
-                    std::tie(content_type, content_name, content_value) = content;
-                    if (count++ != 0) {
-                        text_file << "    ";
-                    }
-                    if (!content_value.empty()) {
-                        text_file << content_type << " " << content_name << " = " << content_value << "\n";
-                    } else {
-                        text_file << content_type << " " << content_name << "\n";
-                    }
-                }
-                text_file.close();
+            case RECORD_TEXT_FILE:
+                // Written out by the writer thread.
+                ApiDumpFormatText(contents, record);
+                g_record_writer.Submit(record.data(), record.size());
                 success = true;
                 break;
-            }
-            case RECORD_HTML_FILE: {
-                std::ofstream text_file;
-                text_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-                text_file << "<details class='data'>\n";
-                std::vector<std::string> prefixes;
-                uint32_t last_deref_count = 0;
-                for (uint32_t content_index = 0; content_index < contents.size(); ++content_index) {
-                    std::string content_type;
-                    std::string content_name;
-                    std::string content_value;
-                    std::tie(content_type, content_name, content_value) = contents[content_index];
-                    if (content_index == 0) {
-                        text_file << "   <summary>\n"
-                                  << "      <div class='headertype'>" << content_type << "</div>\n"
-                                  << "      <div class='headervar'>" << content_name << "</div>\n"
-                                  << "   </summary>\n";
-                    } else {
-                        uint32_t cur_deref_count = 0;
-                        uint32_t next_deref_count = 0;
-
-                        // Count number of structure and pointer dereferences for the current line
-                        cur_deref_count = static_cast<uint32_t>(std::count(content_name.begin(), content_name.end(), '.'));
-                        std::string::size_type start = 0;
-                        while ((start = content_name.find("->", start)) != std::string::npos) {
-                            ++cur_deref_count;
-                            start += 2;
-                        }
-                        // Now look for array dereferences
-                        start = 0;
-                        while ((start = content_name.find('[', start)) != std::string::npos) {
-                            ++cur_deref_count;
-                            start++;
-                        }
-
-                        // If there's something after this, see if it's a sub-component of this.
-                        if (content_index < contents.size() - 1) {
-                            std::string next_content_type;
-                            std::string next_content_name;
-                            std::string next_content_value;
-                            std::tie(next_content_type, next_content_name, next_content_value) = contents[content_index + 1];
-
-                            // Count number of structure and pointer dereferences for the next line
-                            next_deref_count =
-                                static_cast<uint32_t>(std::count(next_content_name.begin(), next_content_name.end(), '.'));
-                            start = 0;
-                            while ((start = next_content_name.find("->", start)) != std::string::npos) {
-                                ++next_deref_count;
-                                start += 2;
-                            }
-                            // Now look for array dereferences
-                            start = 0;
-                            while ((start = next_content_name.find('[', start)) != std::string::npos) {
-                                ++next_deref_count;
-                                start++;
-                            }
-                        }
-
-                        // If we've reduced the number of dereferences in the name from last time, we need
-                        // to close up those detail sections.
-                        if (cur_deref_count < last_deref_count) {
-                            uint32_t diff_count = last_deref_count - cur_deref_count;
-                            while ((diff_count--) != 0u) {
-                                text_file << "   </details>\n";
-                                prefixes.pop_back();
-                            }
-                        }
-
-                        // Look through any prefixes we've saved (going backwards through the list)
-                        // and find the one that matches our beginning.
-                        std::string short_name = content_name;
-                        if (cur_deref_count > 0) {
-                            for (auto it = prefixes.rbegin(); it != prefixes.rend(); ++it) {
-                                if (content_name.find(*it) == 0) {
-                                    std::string::size_type additional_offset = it->size() + 1;
-                                    if (content_name[additional_offset - 1] == '-') {
-                                        additional_offset++;
-                                    } else if (content_name[additional_offset - 1] == '[') {
-                                        additional_offset--;
-                                    }
-                                    short_name = content_name.substr(additional_offset);
-                                    break;
-                                }
-                            }
-                        }
-
-                        bool writing_summary = false;
-
-                        // If the next item contains this item as a prefix, start the summary.  Otherwise,
-                        // start a <div> marker so that each component lands on its own line.
-                        if (cur_deref_count < next_deref_count) {
-                            text_file << "   <details class='data'>\n"
-                                      << "      <summary>\n";
-                            writing_summary = true;
-                            prefixes.push_back(content_name);
-                        } else {
-                            text_file << "      <div class='data'>\n";
-                        }
-
-                        // Write out the content
-                        text_file << "         <div class='type'>" << content_type << "</div>\n"
-                                  << "         <div class='var'>" << short_name << "</div>\n";
-                        bool value_needs_printing = true;
-                        if (content_type.find("char") != std::string::npos) {
-                            uint64_t star_count = std::count(content_type.begin(), content_type.end(), '*');
-                            uint64_t bracket_count = std::count(content_type.begin(), content_type.end(), '[');
-                            if (star_count + bracket_count < 2) {
-                                text_file << "         <div class='val'>\"" << content_value << "\"</div>";
-                                value_needs_printing = false;
-                            }
-                        }
-                        if (!content_value.empty() && value_needs_printing) {
-                            text_file << "         <div class='val'>" << content_value << "</div>";
-                        }
-                        text_file << "\n";
-
-                        // Wrap up any summary we may have started.  Otherwise, just wrap up the
-                        // <div> marker wrapping this entry.
-                        if (writing_summary) {
-                            text_file << "      </summary>\n";
-                        } else {
-                            text_file << "      </div>\n";
-                        }
-
-                        last_deref_count = cur_deref_count;
-                    }
-                }
-
-                // Wrap up any remaining items
-                if (last_deref_count != 0u) {
-                    while ((last_deref_count--) != 0u) {
-                        text_file << "   </details>\n";
-                        prefixes.pop_back();
-                    }
-                }
-                text_file << "</details>\n";
+            case RECORD_HTML_FILE:
+                ApiDumpFormatHtml(contents, record);
+                g_record_writer.Submit(record.data(), record.size());
+                success = true;
                 break;
-            }
             default:
                 break;
         }
@@ -404,6 +381,26 @@ bool ApiDumpLayerRecordContent(std::vector<std::tuple<std::string, std::string,
     return success;
 }
 
+void ApiDumpLayerRecordCapture(const char *record, size_t size) { g_record_writer.Submit(record, size); }
+
+void ApiDumpLayerRecordJson(const char *record, size_t size) {
+    if (g_record_info.file_name.empty()) {
+        std::unique_lock<std::mutex> mlock(g_record_mutex);
+        std::cout.write(record, static_cast<std::streamsize>(size));
+    } else {
+        g_record_writer.Submit(record, size);
+    }
+}
+
+static std::string ApiDumpLayerCaptureHeader() {
+    CaptureFileHeader header{};
+    memcpy(header.magic, XR_CAPTURE_MAGIC, sizeof(header.magic));
+    header.format_version = XR_CAPTURE_FORMAT_VERSION;
+    header.header_size = sizeof(header);
+    header.api_version = XR_CURRENT_API_VERSION;
+    return std::string(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
 XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateInstance(const XrInstanceCreateInfo * /*info*/, XrInstance * /*instance*/) {
     if (!g_record_info.initialized) {
         g_record_info.initialized = true;
@@ -412,6 +409,45 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateInstance(const XrInstanceCrea
     return XR_SUCCESS;
 }
 
+// Generate output for xrCreateInstance, which the layer sees as xrCreateApiLayerInstance
+static void ApiDumpLayerRecordCreateInstance(const XrInstanceCreateInfo *info, XrInstance *instance) {
+    ApiDumpContents &contents = ApiDumpContents::BeginCommand("XrResult", "xrCreateInstance");
+    contents.AddHexAddress("const XrInstanceCreateInfo*", "info", info);
+    if (nullptr != info) {
+        contents.AddDecimal("XrStructureType", "info->type", info->type);
+        ApiDumpContents::NameScope info_name(contents, "info->");
+        // Decode the next chain if it exists
+        if (!ApiDumpDecodeNextChain(nullptr, info->next, "next", contents)) {
+            throw std::invalid_argument("Invalid Operation");
+        }
+        contents.AddDecimal("XrInstanceCreateFlags", "createFlags", info->createFlags);
+        if (!ApiDumpOutputXrStruct(nullptr, &info->applicationInfo, "applicationInfo", "XrApplicationInfo", true, contents)) {
+            throw std::invalid_argument("Invalid Operation");
+        }
+        contents.AddHex("uint32_t", "enabledApiLayerCount", info->enabledApiLayerCount);
+        contents.AddHex("const char* const*", "enabledApiLayerNames", info->enabledApiLayerNames);
+        {
+            ApiDumpContents::NameScope enabledapilayernames_name(contents, "enabledApiLayerNames");
+            for (uint32_t i = 0; i < info->enabledApiLayerCount; ++i) {
+                ApiDumpContents::NameScope element_name(contents, i);
+                contents.AddString("const char* const*", "", info->enabledApiLayerNames[i]);
+            }
+        }
+        contents.AddHex("uint32_t", "enabledExtensionCount", info->enabledExtensionCount);
+        contents.AddHex("const char* const*", "enabledExtensionNames", info->enabledExtensionNames);
+        {
+            ApiDumpContents::NameScope enabledextensionnames_name(contents, "enabledExtensionNames");
+            for (uint32_t ii = 0; ii < info->enabledExtensionCount; ++ii) {
+                ApiDumpContents::NameScope element_name(contents, ii);
+                contents.AddString("const char* const*", "", info->enabledExtensionNames[ii]);
+            }
+        }
+    }
+
+    contents.AddHexAddress("XrInstance*", "instance", instance);
+    ApiDumpLayerRecordContent(contents);
+}
+
 XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInstanceCreateInfo *info,
                                                                     const struct XrApiLayerCreateInfo *apiLayerInfo,
                                                                     XrInstance *instance) {
@@ -419,7 +455,6 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
         PFN_xrGetInstanceProcAddr next_get_instance_proc_addr = nullptr;
         PFN_xrCreateApiLayerInstance next_create_api_layer_instance = nullptr;
         XrApiLayerCreateInfo new_api_layer_info = {};
-        bool first_time = !g_record_info.initialized;
 
         if (!g_record_info.initialized) {
             g_record_info.initialized = true;
@@ -432,6 +467,8 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
             g_record_info.file_name = file_name;
             g_record_info.type = RECORD_TEXT_FILE;
         }
+        std::string max_file_size = PlatformUtilsGetEnv("XR_API_DUMP_FILE_MAX_SIZE");
+        g_record_info.max_file_size = std::strtoull(max_file_size.c_str(), nullptr, 10);
 
         if (!export_type.empty()) {
             std::string export_type_lower = export_type;
@@ -444,16 +481,57 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
                 } else {
                     g_record_info.type = RECORD_TEXT_COUT;
                 }
-            } else if (export_type_lower == "html" && first_time) {
+            } else if (export_type_lower == "html") {
                 g_record_info.type = RECORD_HTML_FILE;
-                if (!ApiDumpLayerWriteHtmlHeader()) {
-                    return XR_ERROR_INITIALIZATION_FAILED;
-                }
             } else if (export_type_lower == "code") {
                 g_record_info.type = RECORD_CODE_FILE;
+            } else if (export_type_lower == "capture") {
+                g_record_info.type = RECORD_CAPTURE_FILE;
+            } else if (export_type_lower == "jsonl") {
+                g_record_info.type = RECORD_JSON_LINES;
             }
         }
 
+        // The file stays open until the last instance is destroyed.  Text is appended to an existing
+        // file, while an HTML file is started over, since it must begin with the header.
+        if (g_record_info.type == RECORD_TEXT_FILE && !g_record_writer.Open(g_record_info.file_name, true, false, "", "",
+                                                                            g_record_info.max_file_size)) {
+            return XR_ERROR_INITIALIZATION_FAILED;
+        }
+        if (g_record_info.type == RECORD_HTML_FILE &&
+            !g_record_writer.Open(g_record_info.file_name, false, false, ApiDumpLayerHtmlHeader(), ApiDumpLayerHtmlFooter(),
+                                  g_record_info.max_file_size)) {
+            return XR_ERROR_INITIALIZATION_FAILED;
+        }
+        // A capture is started over by the first instance, and continued by those created after it.
+        if (g_record_info.type == RECORD_CAPTURE_FILE) {
+            if (g_record_info.file_name.empty() ||
+                !g_record_writer.Open(g_record_info.file_name, g_capture_started, true, ApiDumpLayerCaptureHeader(), "",
+                                      g_record_info.max_file_size)) {
+                return XR_ERROR_INITIALIZATION_FAILED;
+            }
+            ApiDumpCaptureStart(!g_capture_started);
+            g_capture_started = true;
+        }
+        // JSON lines are appended like text, to the file if there is one, and timed from the first instance.
+        if (g_record_info.type == RECORD_JSON_LINES) {
+            if (!g_record_info.file_name.empty() &&
+                !g_record_writer.Open(g_record_info.file_name, true, false, "", "", g_record_info.max_file_size)) {
+                return XR_ERROR_INITIALIZATION_FAILED;
+            }
+            ApiDumpJsonStart(!g_json_started);
+            g_json_started = true;
+        }
+
+        // The commands to record are chosen again by the first instance, so not while another instance
+        // is still being recorded.
+        std::unique_lock<std::mutex> filter_lock(g_filter_mutex);
+        if (g_instance_dispatch_map.Empty()) {
+            ApiDumpConfigureCommandFilter(PlatformUtilsGetEnv("XR_API_DUMP_INCLUDE"), PlatformUtilsGetEnv("XR_API_DUMP_EXCLUDE"),
+                                          PlatformUtilsGetEnv("XR_API_DUMP_SAMPLE"));
+        }
+        filter_lock.unlock();
+
         // Validate the API layer info and next API layer info structures before we try to use them
         if (nullptr == apiLayerInfo || XR_LOADER_INTERFACE_STRUCT_API_LAYER_CREATE_INFO != apiLayerInfo->structType ||
             XR_API_LAYER_CREATE_INFO_STRUCT_VERSION > apiLayerInfo->structVersion ||
@@ -468,60 +546,15 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
         }
 
         // Generate output for this command as if it were the standard xrCreateInstance
-        std::vector<std::tuple<std::string, std::string, std::string>> contents;
-        contents.emplace_back("XrResult", "xrCreateInstance", "");
-        contents.emplace_back("const XrInstanceCreateInfo*", "info", PointerToHexString(info));
-        if (nullptr != info) {
-            std::string info_prefix = "info->";
-            contents.emplace_back("XrStructureType", "info->type", std::to_string(info->type));
-            std::string next_prefix = info_prefix;
-            next_prefix += "next";
-            // Decode the next chain if it exists
-            if (!ApiDumpDecodeNextChain(nullptr, info->next, next_prefix, contents)) {
-                throw std::invalid_argument("Invalid Operation");
-            }
-            std::string flags_prefix = info_prefix;
-            flags_prefix += "createFlags";
-            contents.emplace_back("XrInstanceCreateFlags", flags_prefix, std::to_string(info->createFlags));
-            std::string applicationinfo_prefix = info_prefix;
-            applicationinfo_prefix += "applicationInfo";
-            if (!ApiDumpOutputXrStruct(nullptr, &info->applicationInfo, applicationinfo_prefix, "XrApplicationInfo", true,
-                                       contents)) {
-                throw std::invalid_argument("Invalid Operation");
-            }
-            std::string enabledapilayercount_prefix = info_prefix;
-            enabledapilayercount_prefix += "enabledApiLayerCount";
-            std::ostringstream oss_enabledApiLayerCount;
-            oss_enabledApiLayerCount << "0x" << std::hex << (info->enabledApiLayerCount);
-            contents.emplace_back("uint32_t", enabledapilayercount_prefix, oss_enabledApiLayerCount.str());
-            std::string enabledapilayernames_prefix = info_prefix;
-            enabledapilayernames_prefix += "enabledApiLayerNames";
-            std::ostringstream oss_enabledApiLayerNames_array;
-            oss_enabledApiLayerNames_array << "0x" << std::hex << (info->enabledApiLayerNames);
-            contents.emplace_back("const char* const*", enabledapilayernames_prefix, oss_enabledApiLayerNames_array.str());
-            for (uint32_t i = 0; i < info->enabledApiLayerCount; ++i) {
-                std::string prefix = enabledapilayernames_prefix + "[" + std::to_string(i) + "]";
-                contents.emplace_back("const char* const*", prefix, info->enabledApiLayerNames[i]);
-            }
-            std::string enabledextensioncount_prefix = info_prefix;
-            enabledextensioncount_prefix += "enabledExtensionCount";
-            std::ostringstream oss_enabledExtensionCount;
-            oss_enabledExtensionCount << "0x" << std::hex << (info->enabledExtensionCount);
-            contents.emplace_back("uint32_t", enabledextensioncount_prefix, oss_enabledExtensionCount.str());
-            std::string enabledextensionnames_prefix = info_prefix;
-            enabledextensionnames_prefix += "enabledExtensionNames";
-            std::ostringstream oss_enabledExtensionNames_array;
-            oss_enabledExtensionNames_array << "0x" << std::hex << (info->enabledExtensionNames);
-            contents.emplace_back("const char* const*", enabledextensionnames_prefix, oss_enabledExtensionNames_array.str());
-            for (uint32_t ii = 0; ii < info->enabledExtensionCount; ++ii) {
-                std::string prefix = enabledextensionnames_prefix + "[" + std::to_string(ii) + "]";
-                contents.emplace_back("const char* const*", prefix, info->enabledExtensionNames[ii]);
-            }
+        const bool record = ApiDumpShouldRecordCommand(CAPTURE_COMMAND_XR_CREATE_INSTANCE);
+        ApiDumpCaptureCall capture(CAPTURE_COMMAND_XR_CREATE_INSTANCE, record);
+        ApiDumpJsonCall json(CAPTURE_COMMAND_XR_CREATE_INSTANCE, record);
+        if (capture.IsActive()) {
+            CaptureEncodeCreateInstanceInputs(capture.Encoder(), info, instance);
+        } else if (record && !json.IsActive()) {
+            ApiDumpLayerRecordCreateInstance(info, instance);
         }
 
-        contents.emplace_back("XrInstance*", "instance", PointerToHexString(instance));
-        ApiDumpLayerRecordContent(contents);
-
         // Copy the contents of the layer info struct, but then move the next info up by
         // one slot so that the next layer gets information.
         memcpy(&new_api_layer_info, apiLayerInfo, sizeof(XrApiLayerCreateInfo));
@@ -535,13 +568,21 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
         XrInstance returned_instance = *instance;
         XrResult result = next_create_api_layer_instance(info, &new_api_layer_info, &returned_instance);
         *instance = returned_instance;
+        if (capture.IsActive()) {
+            CaptureEncodeCreateInstanceOutputs(capture.Encoder(), result, info, instance);
+            capture.Finish(result);
+        }
+        if (json.IsActive()) {
+            ApiDumpJsonWriteCreateInstanceCall(json.Begin(), result, info, instance);
+            json.Finish();
+        }
 
         // Create the dispatch table to the next levels
         auto *next_dispatch = new XrGeneratedDispatchTable();
         GeneratedXrPopulateDispatchTable(next_dispatch, returned_instance, next_get_instance_proc_addr);
 
-        std::unique_lock<std::mutex> mlock(g_instance_dispatch_mutex);
-        g_instance_dispatch_map[returned_instance] = next_dispatch;
+        // The instance's table owns the handles created from it, which includes the instance itself.
+        g_instance_dispatch_map.Insert(returned_instance, next_dispatch, next_dispatch);
 
         return result;
     } catch (...) {
@@ -551,29 +592,49 @@ XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateApiLayerInstance(const XrInst
 
 XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrDestroyInstance(XrInstance instance) {
     // Generate output for this command
-    std::vector<std::tuple<std::string, std::string, std::string>> contents;
-    contents.emplace_back("XrResult", "xrDestroyInstance", "");
-    contents.emplace_back("XrInstance", "instance", HandleToHexString(instance));
-    ApiDumpLayerRecordContent(contents);
-
-    std::unique_lock<std::mutex> mlock(g_instance_dispatch_mutex);
-    XrGeneratedDispatchTable *next_dispatch = nullptr;
-    auto map_iter = g_instance_dispatch_map.find(instance);
-    if (map_iter != g_instance_dispatch_map.end()) {
-        next_dispatch = map_iter->second;
+    const bool record = ApiDumpShouldRecordCommand(CAPTURE_COMMAND_XR_DESTROY_INSTANCE);
+    ApiDumpCaptureCall capture(CAPTURE_COMMAND_XR_DESTROY_INSTANCE, record);
+    ApiDumpJsonCall json(CAPTURE_COMMAND_XR_DESTROY_INSTANCE, record);
+    if (capture.IsActive()) {
+        CaptureEncodeDestroyInstanceInputs(capture.Encoder(), instance);
+    } else if (record && !json.IsActive()) {
+        ApiDumpContents &contents = ApiDumpContents::BeginCommand("XrResult", "xrDestroyInstance");
+        contents.AddHandle("XrInstance", "instance", instance);
+        ApiDumpLayerRecordContent(contents);
     }
-    mlock.unlock();
 
+    XrGeneratedDispatchTable *next_dispatch = g_instance_dispatch_map.Find(instance);
     if (nullptr == next_dispatch) {
+        capture.Finish(XR_ERROR_HANDLE_INVALID);
+        if (json.IsActive()) {
+            ApiDumpJsonWriteDestroyInstanceCall(json.Begin(), XR_ERROR_HANDLE_INVALID, instance);
+            json.Finish();
+        }
         return XR_ERROR_HANDLE_INVALID;
     }
 
     next_dispatch->DestroyInstance(instance);
     ApiDumpCleanUpMapsForTable(next_dispatch);
+    // Recorded before the file can be closed below.
+    if (capture.IsActive()) {
+        CaptureEncodeDestroyInstanceOutputs(capture.Encoder(), XR_SUCCESS, instance);
+        capture.Finish(XR_SUCCESS);
+    }
+    if (json.IsActive()) {
+        ApiDumpJsonWriteDestroyInstanceCall(json.Begin(), XR_SUCCESS, instance);
+        json.Finish();
+    }
 
-    // Write out the HTML footer if we destroy the last instance
-    if (g_instance_dispatch_map.empty() && g_record_info.type == RECORD_HTML_FILE) {
-        ApiDumpLayerWriteHtmlFooter();
+    // Make sure everything recorded so far is in the file.  Once the last instance is destroyed,
+    // close the file, which also writes out the HTML footer.
+    if (g_instance_dispatch_map.Empty()) {
+        // Until an instance is created in capture or JSON lines mode again.
+        ApiDumpCaptureStop();
+        ApiDumpJsonStop();
+        g_record_writer.Close();
+        ApiDumpReleaseRetiredMapTables();
+    } else {
+        g_record_writer.Flush();
     }
     return XR_SUCCESS;
 }
@@ -605,4 +666,10 @@ XrResult LAYER_EXPORT XRAPI_CALL xrNegotiateLoaderApiLayerInterface(const XrNego
     return XR_SUCCESS;
 }
 
+// Optional function used by the loader to hand over the allocation callbacks the layer's bookkeeping should use.
+XrResult LAYER_EXPORT XRAPI_CALL xrApiLayerSetAllocationCallbacks(const XrLoaderAllocationCallbacks *allocator) {
+    XrSdkSetAllocationCallbacks(allocator);
+    return XR_SUCCESS;
+}
+
 }  // extern "C"
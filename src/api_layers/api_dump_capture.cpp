@@ -0,0 +1,99 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "api_dump_capture.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+std::atomic<bool> g_capturing{false};
+std::chrono::steady_clock::time_point g_capture_start;
+std::atomic<uint64_t> g_next_call_index{0};
+std::atomic<uint64_t> g_completed_calls{0};
+std::atomic<uint32_t> g_next_thread{0};
+
+struct ApiDumpCaptureThread {
+    uint32_t thread = 0;
+    bool numbered = false;
+    // One record buffer per nesting depth.
+    std::vector<std::unique_ptr<std::string>> records;
+    size_t depth = 0;
+};
+
+ApiDumpCaptureThread& GetCaptureThread() {
+    thread_local ApiDumpCaptureThread capture_thread;
+    return capture_thread;
+}
+
+std::string& AcquireRecord(bool active) {
+    if (!active) {
+        // Never written to, but the encoder needs somewhere to point.
+        static std::string unused;
+        return unused;
+    }
+    ApiDumpCaptureThread& capture_thread = GetCaptureThread();
+    if (!capture_thread.numbered) {
+        capture_thread.thread = g_next_thread++;
+        capture_thread.numbered = true;
+    }
+    if (capture_thread.depth == capture_thread.records.size()) {
+        capture_thread.records.emplace_back(new std::string());
+    }
+    return *capture_thread.records[capture_thread.depth++];
+}
+
+uint64_t NanosecondsSinceStart(std::chrono::steady_clock::time_point time) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - g_capture_start).count());
+}
+}  // namespace
+
+ApiDumpCaptureCall::ApiDumpCaptureCall(CaptureCommand command, bool recorded)
+    : _active(recorded && g_capturing), _record(AcquireRecord(_active)), _encoder(_record), _header() {
+    if (!_active) {
+        return;
+    }
+    _header.command = static_cast<uint32_t>(command);
+    _header.thread = GetCaptureThread().thread;
+    _header.call_index = g_next_call_index++;
+    _header.completed_before = g_completed_calls;
+    // The header is filled in once the call is finished.
+    _record.assign(sizeof(_header), '\0');
+    _start = std::chrono::steady_clock::now();
+}
+
+ApiDumpCaptureCall::~ApiDumpCaptureCall() {
+    if (_active) {
+        --GetCaptureThread().depth;
+    }
+}
+
+void ApiDumpCaptureCall::Finish(XrResult result) {
+    if (!_active) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    _header.size = static_cast<uint32_t>(_record.size());
+    _header.result = static_cast<int32_t>(result);
+    _header.completion_index = g_completed_calls++;
+    _header.start_time = NanosecondsSinceStart(_start);
+    _header.duration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count());
+    memcpy(&_record[0], &_header, sizeof(_header));
+    ApiDumpLayerRecordCapture(_record.data(), _record.size());
+}
+
+void ApiDumpCaptureStart(bool restart) {
+    if (restart) {
+        g_next_call_index = 0;
+        g_completed_calls = 0;
+        g_capture_start = std::chrono::steady_clock::now();
+    }
+    g_capturing = true;
+}
+
+void ApiDumpCaptureStop() { g_capturing = false; }
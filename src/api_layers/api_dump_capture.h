@@ -0,0 +1,52 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "capture_stream.h"
+#include "xr_generated_capture.hpp"
+#include <openxr/openxr.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Records one call in capture mode.
+//
+// The record is encoded on the calling thread, into a buffer the thread keeps for its next call, and
+// submitted to the file writer when the call is finished.  Calls that start inside another call on
+// the same thread, such as from a debug messenger callback, get a buffer of their own.  A call that
+// is never finished, because it threw, is left out of the capture.
+class ApiDumpCaptureCall {
+   public:
+    // Inactive, and recording nothing, unless the layer is capturing and the call is to be recorded.
+    ApiDumpCaptureCall(CaptureCommand command, bool recorded);
+    ApiDumpCaptureCall(const ApiDumpCaptureCall&) = delete;
+    ApiDumpCaptureCall& operator=(const ApiDumpCaptureCall&) = delete;
+    ~ApiDumpCaptureCall();
+
+    bool IsActive() const { return _active; }
+    CaptureEncoder& Encoder() { return _encoder; }
+
+    // Completes the record with the result returned to the application, and submits it.
+    void Finish(XrResult result);
+
+   private:
+    bool _active;
+    std::string& _record;
+    CaptureEncoder _encoder;
+    CaptureRecordHeader _header;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Starts capturing.  When restarting, the call numbers and times are counted from now, rather than
+// continuing from the last capture.
+void ApiDumpCaptureStart(bool restart);
+
+// Stops capturing, until started again.
+void ApiDumpCaptureStop();
+
+// Defined in api_dump.cpp, which owns the file writer.
+void ApiDumpLayerRecordCapture(const char* record, size_t size);
@@ -0,0 +1,106 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "api_dump_contents.h"
+
+#include <cstdio>
+
+namespace {
+const char kHexDigits[] = "0123456789abcdef";
+}  // namespace
+
+ApiDumpContents& ApiDumpContents::BeginCommand(const char* return_type, const char* command_name) {
+    thread_local ApiDumpContents contents;
+    contents._entries.clear();
+    contents._text.clear();
+    contents._name.clear();
+    contents.Add(return_type, command_name);
+    return contents;
+}
+
+void ApiDumpContents::AppendNameIndex(uint32_t index) {
+    char digits[16];
+    int size = snprintf(digits, sizeof(digits), "[%u]", index);
+    _name.append(digits, static_cast<size_t>(size));
+}
+
+void ApiDumpContents::AddSecondsAndNanoseconds(const char* type, const char* name, int64_t seconds, int64_t nanoseconds) {
+    BeginEntry(type, name);
+    AppendSignedDecimal(seconds);
+    _text.push_back('.');
+    // The fill goes before any sign, as std::ostream right-aligns by default.
+    char digits[24];
+    int size = snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(nanoseconds));
+    if (size < 9) {
+        _text.append(static_cast<size_t>(9 - size), '0');
+    }
+    _text.append(digits, static_cast<size_t>(size));
+    _text.push_back('s');
+}
+
+void ApiDumpContents::AppendSignedDecimal(long long value) {
+    if (value < 0) {
+        _text.push_back('-');
+        // Negated as unsigned, which also works for the smallest value.
+        AppendUnsignedDecimal(0ULL - static_cast<unsigned long long>(value));
+    } else {
+        AppendUnsignedDecimal(static_cast<unsigned long long>(value));
+    }
+}
+
+void ApiDumpContents::AppendUnsignedDecimal(unsigned long long value) {
+    char digits[20];
+    char* start = digits + sizeof(digits);
+    do {
+        *--start = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    _text.append(start, static_cast<size_t>(digits + sizeof(digits) - start));
+}
+
+void ApiDumpContents::AppendHexDigits(unsigned long long value) {
+    char digits[16];
+    char* start = digits + sizeof(digits);
+    do {
+        *--start = kHexDigits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    _text.append(start, static_cast<size_t>(digits + sizeof(digits) - start));
+}
+
+void ApiDumpContents::AppendPointer(const void* pointer) {
+#if defined(_MSC_VER) || defined(_LIBCPP_VERSION)
+    // These standard libraries write pointers with "%p".
+    char digits[32];
+    int size = snprintf(digits, sizeof(digits), "%p", pointer);
+    _text.append(digits, static_cast<size_t>(size));
+#else
+    // libstdc++ writes pointers as hex with the "0x" base, which it leaves out for zero.
+    uintptr_t value = reinterpret_cast<uintptr_t>(pointer);
+    if (value != 0) {
+        _text.append("0x", 2);
+    }
+    AppendHexDigits(value);
+#endif
+}
+
+void ApiDumpContents::AppendHexBytes(const void* data, size_t size) {
+    // Same digits as to_hex in hex_and_handles.h: the bytes from last to first.
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    _text.append("0x", 2);
+    for (size_t index = size; index-- > 0;) {
+        _text.push_back(kHexDigits[(bytes[index] >> 4) & 0xf]);
+        _text.push_back(kHexDigits[bytes[index] & 0xf]);
+    }
+}
+
+void ApiDumpContents::AppendFloat(double value, int precision) {
+    // std::ostream formats floating point values with "%.*g" when no floatfield is set.
+    char digits[128];
+    int size = snprintf(digits, sizeof(digits), "%.*g", precision, value);
+    if (size > 0) {
+        _text.append(digits, static_cast<size_t>(size) < sizeof(digits) ? static_cast<size_t>(size) : sizeof(digits) - 1);
+    }
+}
@@ -0,0 +1,181 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The contents recorded for one command: a list of entries, each with a type, a name and a value.
+//
+// Every thread records into one ApiDumpContents, which keeps its storage from one command to the
+// next, so recording a command does not allocate once the storage is large enough.  The types are
+// literals, and the names and values are formatted straight into a single character buffer.  The
+// values are written exactly as the std::ostream or std::to_string expression the layer used to
+// format them with would, since the output has to stay the same.  The storage comes from the global
+// operator new rather than the loader's allocation callbacks, since a thread keeps it after every
+// instance is destroyed.
+class ApiDumpContents {
+   public:
+    // Empty the contents of the calling thread and record the command name as the first entry.
+    static ApiDumpContents& BeginCommand(const char* return_type, const char* command_name);
+
+    size_t Size() const { return _entries.size(); }
+    const char* Type(size_t index) const { return _entries[index].type; }
+    const char* Name(size_t index) const { return _text.data() + _entries[index].name_offset; }
+    size_t NameSize(size_t index) const { return _entries[index].value_offset - _entries[index].name_offset; }
+    const char* Value(size_t index) const { return _text.data() + _entries[index].value_offset; }
+    size_t ValueSize(size_t index) const {
+        size_t end = index + 1 < _entries.size() ? _entries[index + 1].name_offset : _text.size();
+        return end - _entries[index].value_offset;
+    }
+
+    // Each entry added below is named after the enclosing NameScopes, followed by the name given to it.
+
+    // An entry without a value.
+    void Add(const char* type, const char* name) { BeginEntry(type, name); }
+
+    // A string value, such as a char array member.
+    void AddString(const char* type, const char* name, const char* text) {
+        BeginEntry(type, name);
+        _text.append(text);
+    }
+
+    // Like std::to_string(value).
+    template <typename T>
+    void AddDecimal(const char* type, const char* name, T value) {
+        BeginEntry(type, name);
+        // Unary plus promotes the value the same way choosing the std::to_string overload does.
+        AppendDecimal(+value);
+    }
+
+    // Like stream << "0x" << std::hex << value.
+    template <typename T>
+    void AddHex(const char* type, const char* name, T value) {
+        BeginEntry(type, name);
+        _text.append("0x", 2);
+        AppendHex(value);
+    }
+
+    // Like stream << std::hex << value.
+    template <typename T>
+    void AddHexWithoutBase(const char* type, const char* name, T value) {
+        BeginEntry(type, name);
+        AppendHex(value);
+    }
+
+    // Like stream << std::hex << pointer.
+    void AddPointer(const char* type, const char* name, const void* pointer) {
+        BeginEntry(type, name);
+        AppendPointer(pointer);
+    }
+
+    // Like stream << std::setprecision(precision) << value.
+    template <typename T>
+    void AddFloat(const char* type, const char* name, T value, int precision) {
+        BeginEntry(type, name);
+        AppendFloat(value, precision);
+    }
+
+    // Like PointerToHexString(pointer).
+    void AddHexAddress(const char* type, const char* name, const void* pointer) {
+        BeginEntry(type, name);
+        AppendHexBytes(&pointer, sizeof(pointer));
+    }
+
+    // Like HandleToHexString(handle).
+    template <typename T>
+    void AddHandle(const char* type, const char* name, T handle) {
+        BeginEntry(type, name);
+        AppendHexBytes(&handle, sizeof(handle));
+    }
+
+    // Like stream << seconds << "." << std::setw(9) << std::setfill('0') << nanoseconds << "s".
+    void AddSecondsAndNanoseconds(const char* type, const char* name, int64_t seconds, int64_t nanoseconds);
+
+    // Appends to the current name of contents, and restores it when going out of scope.
+    class NameScope {
+       public:
+        NameScope(ApiDumpContents& contents, const char* name) : _contents(contents), _size(contents._name.size()) {
+            contents._name.append(name);
+        }
+        // Appends "[index]".
+        NameScope(ApiDumpContents& contents, uint32_t index) : _contents(contents), _size(contents._name.size()) {
+            contents.AppendNameIndex(index);
+        }
+        NameScope(const NameScope&) = delete;
+        NameScope& operator=(const NameScope&) = delete;
+        ~NameScope() { _contents._name.resize(_size); }
+
+       private:
+        ApiDumpContents& _contents;
+        size_t _size;
+    };
+
+   private:
+    struct Entry {
+        const char* type;
+        size_t name_offset;
+        size_t value_offset;  // The value ends where the next entry starts
+    };
+
+    void AppendNameIndex(uint32_t index);
+
+    void BeginEntry(const char* type, const char* name) {
+        Entry entry;
+        entry.type = type;
+        entry.name_offset = _text.size();
+        _text.append(_name);
+        _text.append(name);
+        entry.value_offset = _text.size();
+        _entries.push_back(entry);
+    }
+
+    void AppendDecimal(int value) { AppendSignedDecimal(value); }
+    void AppendDecimal(long value) { AppendSignedDecimal(value); }
+    void AppendDecimal(long long value) { AppendSignedDecimal(value); }
+    void AppendDecimal(unsigned value) { AppendUnsignedDecimal(value); }
+    void AppendDecimal(unsigned long value) { AppendUnsignedDecimal(value); }
+    void AppendDecimal(unsigned long long value) { AppendUnsignedDecimal(value); }
+    void AppendSignedDecimal(long long value);
+    void AppendUnsignedDecimal(unsigned long long value);
+
+    // std::ostream writes characters as they are, and unsigned char pointers as strings.
+    void AppendHex(unsigned char value) { _text.push_back(static_cast<char>(value)); }
+    void AppendHex(const unsigned char* value) {
+        if (value != nullptr) {
+            _text.append(reinterpret_cast<const char*>(value));
+        }
+    }
+    void AppendHex(unsigned char* value) { AppendHex(const_cast<const unsigned char*>(value)); }
+    template <typename T>
+    void AppendHex(T value) {
+        AppendHex(value, std::is_pointer<T>());
+    }
+    template <typename T>
+    void AppendHex(T value, std::true_type /* is_pointer */) {
+        AppendPointer(value);
+    }
+    template <typename T>
+    void AppendHex(T value, std::false_type /* is_pointer */) {
+        // Signed values are written as their unsigned bit pattern.
+        AppendHexDigits(static_cast<typename std::make_unsigned<T>::type>(value));
+    }
+    void AppendHexDigits(unsigned long long value);
+
+    void AppendPointer(const void* pointer);
+    void AppendHexBytes(const void* data, size_t size);
+
+    void AppendFloat(double value, int precision);
+    void AppendFloat(const void* pointer, int /* precision */) { AppendPointer(pointer); }
+
+    std::vector<Entry> _entries;
+    std::string _text;
+    std::string _name;
+};
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "api_dump_filter.h"
+
+#include "command_patterns.h"
+
+#include <cstdlib>
+#include <vector>
+
+std::atomic<uint8_t> g_api_dump_command_modes[CAPTURE_COMMAND_COUNT] = {};
+
+namespace {
+std::atomic<uint64_t> g_sample_limits[CAPTURE_COMMAND_COUNT] = {};
+std::atomic<uint64_t> g_sample_calls[CAPTURE_COMMAND_COUNT] = {};
+}  // namespace
+
+bool ApiDumpSampleCommand(CaptureCommand command) {
+    uint64_t call = g_sample_calls[command].fetch_add(1, std::memory_order_relaxed);
+    uint64_t limit = g_sample_limits[command].load(std::memory_order_relaxed);
+    if (g_api_dump_command_modes[command].load(std::memory_order_relaxed) == API_DUMP_COMMAND_EVERY_NTH) {
+        // The limit is only 0 while being reconfigured.
+        return limit == 0 || call % limit == 0;
+    }
+    return call < limit;
+}
+
+void ApiDumpConfigureCommandFilter(const std::string& include, const std::string& exclude, const std::string& sample) {
+    std::vector<std::string> included = SplitCommandList(include);
+    std::vector<std::string> excluded = SplitCommandList(exclude);
+    std::vector<std::string> samples = SplitCommandList(sample);
+
+    for (uint32_t command = CAPTURE_COMMAND_NONE + 1; command < CAPTURE_COMMAND_COUNT; ++command) {
+        const char* name = g_api_dump_command_names[command];
+        uint8_t mode = API_DUMP_COMMAND_RECORDED;
+        uint64_t limit = 0;
+        if ((!included.empty() && !MatchAnyCommandPattern(included, name)) || MatchAnyCommandPattern(excluded, name)) {
+            mode = API_DUMP_COMMAND_SKIPPED;
+        } else {
+            for (const std::string& entry : samples) {
+                size_t equals = entry.find('=');
+                if (equals == std::string::npos || !MatchCommandPattern(entry.substr(0, equals).c_str(), name)) {
+                    continue;
+                }
+                std::string rule = entry.substr(equals + 1);
+                uint8_t rule_mode;
+                if (rule.compare(0, 6, "every:") == 0) {
+                    rule_mode = API_DUMP_COMMAND_EVERY_NTH;
+                } else if (rule.compare(0, 6, "first:") == 0) {
+                    rule_mode = API_DUMP_COMMAND_FIRST_N;
+                } else {
+                    continue;
+                }
+                char* end = nullptr;
+                uint64_t count = std::strtoull(rule.c_str() + 6, &end, 10);
+                if (end == rule.c_str() + 6 || *end != '\0') {
+                    continue;
+                }
+                if (rule_mode == API_DUMP_COMMAND_EVERY_NTH && count <= 1) {
+                    // Every call, or, for 0, taken as no sampling.
+                    mode = API_DUMP_COMMAND_RECORDED;
+                    limit = 0;
+                } else {
+                    mode = rule_mode;
+                    limit = count;
+                }
+            }
+        }
+        g_sample_limits[command].store(limit, std::memory_order_relaxed);
+        g_sample_calls[command].store(0, std::memory_order_relaxed);
+        g_api_dump_command_modes[command].store(mode, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "xr_generated_capture.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Chooses which calls of each command the layer records.
+//
+// Each command is either recorded, skipped, or sampled, as set by the include, exclude and sample
+// lists the layer reads from the environment.  The mode of every command is kept in one array,
+// indexed by its CaptureCommand ID, so deciding to record or skip a call is a single load and
+// branch.  Only sampled commands go on to count their calls.
+enum ApiDumpCommandMode : uint8_t {
+    API_DUMP_COMMAND_RECORDED = 0,
+    API_DUMP_COMMAND_SKIPPED,
+    API_DUMP_COMMAND_EVERY_NTH,  // Calls 0, N, 2N, ...
+    API_DUMP_COMMAND_FIRST_N,    // Calls 0 to N - 1
+};
+
+extern std::atomic<uint8_t> g_api_dump_command_modes[CAPTURE_COMMAND_COUNT];
+
+// Counts a call of a sampled command, and returns whether to record it.
+bool ApiDumpSampleCommand(CaptureCommand command);
+
+inline bool ApiDumpShouldRecordCommand(CaptureCommand command) {
+    uint8_t mode = g_api_dump_command_modes[command].load(std::memory_order_relaxed);
+    if (mode == API_DUMP_COMMAND_RECORDED) {
+        return true;
+    }
+    return mode != API_DUMP_COMMAND_SKIPPED && ApiDumpSampleCommand(command);
+}
+
+// Sets the mode of every command, and starts the sample counts over.
+//
+// include and exclude are comma separated lists of command names, in which '*' matches any number
+// of characters and '?' any single one, such as "xrLocate*,xrGetActionState*".  An empty include
+// list includes every command, and exclude wins over include.  sample is a comma separated list of
+// pattern=every:N or pattern=first:N entries, such as "xrLocateSpace=every:100", applied to the
+// included commands in order, so a later entry wins over an earlier one.  Malformed entries are
+// ignored.
+void ApiDumpConfigureCommandFilter(const std::string& include, const std::string& exclude, const std::string& sample);
+
+// Generated into xr_generated_api_dump.cpp.  The first entry, for CAPTURE_COMMAND_NONE, is null.
+extern const char* const g_api_dump_command_names[CAPTURE_COMMAND_COUNT];
@@ -0,0 +1,144 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "api_dump_json.h"
+
+#include "api_dump_filter.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+std::atomic<bool> g_writing_json{false};
+std::chrono::steady_clock::time_point g_json_start;
+std::atomic<uint32_t> g_next_json_thread{0};
+
+const char kHexDigits[] = "0123456789abcdef";
+
+std::string& AcquireRecord(bool active) {
+    if (!active) {
+        // Never written to, but the writer needs somewhere to point.
+        static std::string unused;
+        return unused;
+    }
+    thread_local std::string record;
+    return record;
+}
+
+uint32_t JsonThread() {
+    thread_local uint32_t thread = g_next_json_thread++;
+    return thread;
+}
+}  // namespace
+
+void ApiDumpJsonWriter::String(const char* value, size_t size) {
+    Separate();
+    _text.push_back('"');
+    for (size_t index = 0; index < size; ++index) {
+        unsigned char c = static_cast<unsigned char>(value[index]);
+        if (c == '"' || c == '\\') {
+            _text.push_back('\\');
+            _text.push_back(static_cast<char>(c));
+        } else if (c < 0x20) {
+            // Strings are passed on as UTF-8, apart from the control characters JSON escapes.
+            _text.append("\\u00", 4);
+            _text.push_back(kHexDigits[c >> 4]);
+            _text.push_back(kHexDigits[c & 0xf]);
+        } else {
+            _text.push_back(static_cast<char>(c));
+        }
+    }
+    _text.push_back('"');
+}
+
+void ApiDumpJsonWriter::SignedNumber(long long value) {
+    Separate();
+    if (value < 0) {
+        _text.push_back('-');
+        // Negated as unsigned, which also works for the smallest value.
+        AppendDigits(0ULL - static_cast<unsigned long long>(value));
+    } else {
+        AppendDigits(static_cast<unsigned long long>(value));
+    }
+}
+
+void ApiDumpJsonWriter::UnsignedNumber(unsigned long long value) {
+    Separate();
+    AppendDigits(value);
+}
+
+void ApiDumpJsonWriter::AppendDigits(unsigned long long value) {
+    char digits[20];
+    char* start = digits + sizeof(digits);
+    do {
+        *--start = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    _text.append(start, static_cast<size_t>(digits + sizeof(digits) - start));
+}
+
+void ApiDumpJsonWriter::FloatNumber(double value, int precision) {
+    if (!std::isfinite(value)) {
+        Null();
+        return;
+    }
+    Separate();
+    char digits[32];
+    int size = snprintf(digits, sizeof(digits), "%.*g", precision, value);
+    if (size > 0) {
+        _text.append(digits, static_cast<size_t>(size) < sizeof(digits) ? static_cast<size_t>(size) : sizeof(digits) - 1);
+    }
+}
+
+void ApiDumpJsonWriter::HexBytes(const void* data, size_t size) {
+    // The bytes from last to first, as the text output writes handles.
+    Separate();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    _text.append("\"0x", 3);
+    for (size_t index = size; index-- > 0;) {
+        _text.push_back(kHexDigits[(bytes[index] >> 4) & 0xf]);
+        _text.push_back(kHexDigits[bytes[index] & 0xf]);
+    }
+    _text.push_back('"');
+}
+
+ApiDumpJsonCall::ApiDumpJsonCall(CaptureCommand command, bool recorded)
+    : _active(recorded && g_writing_json), _command(command), _start(), _record(AcquireRecord(_active)), _writer(_record) {
+    if (_active) {
+        _start = std::chrono::steady_clock::now();
+    }
+}
+
+ApiDumpJsonWriter& ApiDumpJsonCall::Begin() {
+    auto end = std::chrono::steady_clock::now();
+    // Any call made from inside this one has been recorded by now.
+    _writer.Clear();
+    _writer.BeginObject();
+    _writer.Key("command");
+    _writer.String(g_api_dump_command_names[_command]);
+    _writer.Key("thread");
+    _writer.Value(JsonThread());
+    _writer.Key("time_ns");
+    _writer.Value(static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(_start - g_json_start).count()));
+    _writer.Key("duration_ns");
+    _writer.Value(static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count()));
+    return _writer;
+}
+
+void ApiDumpJsonCall::Finish() {
+    _writer.EndObject();
+    _record.push_back('\n');
+    ApiDumpLayerRecordJson(_record.data(), _record.size());
+}
+
+void ApiDumpJsonStart(bool restart) {
+    if (restart) {
+        g_json_start = std::chrono::steady_clock::now();
+    }
+    g_writing_json = true;
+}
+
+void ApiDumpJsonStop() { g_writing_json = false; }
@@ -0,0 +1,184 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "xr_generated_capture.hpp"
+#include <openxr/openxr.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Writes JSON straight into a character buffer, with no document built up in between.
+//
+// The writer only adds the commas between members and elements, so the calls must nest properly.
+// Handles and addresses are written as hexadecimal strings, and other values as numbers, except
+// those JSON has no numbers for, such as NaN, which are written as null.
+class ApiDumpJsonWriter {
+   public:
+    explicit ApiDumpJsonWriter(std::string& text) : _text(text) {}
+
+    // Starts over, with an empty buffer.
+    void Clear() {
+        _text.clear();
+        _separate = false;
+    }
+
+    void BeginObject() {
+        Separate();
+        _text.push_back('{');
+        _separate = false;
+    }
+    void EndObject() {
+        _text.push_back('}');
+        _separate = true;
+    }
+    void BeginArray() {
+        Separate();
+        _text.push_back('[');
+        _separate = false;
+    }
+    void EndArray() {
+        _text.push_back(']');
+        _separate = true;
+    }
+
+    // The key of the next member of an object, which must not need escaping.
+    void Key(const char* key) {
+        Separate();
+        _text.push_back('"');
+        _text.append(key);
+        _text.append("\":", 2);
+        _separate = false;
+    }
+
+    void Null() {
+        Separate();
+        _text.append("null", 4);
+    }
+
+    // A null-terminated string, or null.
+    void String(const char* value) {
+        if (value == nullptr) {
+            Null();
+        } else {
+            String(value, strlen(value));
+        }
+    }
+    void String(const char* value, size_t size);
+
+    // A string buffer or character array, up to its first null character.
+    void StringUpTo(const char* value, size_t max_size) {
+        const void* end = memchr(value, '\0', max_size);
+        String(value, end == nullptr ? max_size : static_cast<size_t>(static_cast<const char*>(end) - value));
+    }
+
+    // An enum value by its name, or as a number when it has none.
+    template <typename T>
+    void Enum(const char* name, T value) {
+        if (name != nullptr) {
+            String(name);
+        } else {
+            Value(static_cast<int64_t>(value));
+        }
+    }
+
+    void Address(const void* value) { HexBytes(&value, sizeof(value)); }
+
+    template <typename T>
+    void Handle(T value) {
+        HexBytes(&value, sizeof(value));
+    }
+
+    // Numbers, pointers as addresses, and anything else, such as a platform structure, as its bytes in
+    // hexadecimal.
+    template <typename T>
+    void Value(const T& value) {
+        WriteValue(value, std::is_pointer<T>(), std::is_arithmetic<T>());
+    }
+
+   private:
+    void Separate() {
+        if (_separate) {
+            _text.push_back(',');
+        }
+        _separate = true;
+    }
+
+    template <typename T>
+    void WriteValue(const T& value, std::true_type /* is_pointer */, std::false_type /* is_arithmetic */) {
+        Address(reinterpret_cast<const void*>(value));
+    }
+    template <typename T>
+    void WriteValue(const T& value, std::false_type /* is_pointer */, std::true_type /* is_arithmetic */) {
+        // Unary plus promotes characters and small integers to int.
+        Number(+value);
+    }
+    template <typename T>
+    void WriteValue(const T& value, std::false_type /* is_pointer */, std::false_type /* is_arithmetic */) {
+        HexBytes(&value, sizeof(value));
+    }
+
+    void Number(int value) { SignedNumber(value); }
+    void Number(long value) { SignedNumber(value); }
+    void Number(long long value) { SignedNumber(value); }
+    void Number(unsigned value) { UnsignedNumber(value); }
+    void Number(unsigned long value) { UnsignedNumber(value); }
+    void Number(unsigned long long value) { UnsignedNumber(value); }
+    void Number(float value) { FloatNumber(value, 9); }
+    void Number(double value) { FloatNumber(value, 17); }
+    void SignedNumber(long long value);
+    void UnsignedNumber(unsigned long long value);
+    void AppendDigits(unsigned long long value);
+    // With enough significant digits for the value to be read back exactly.
+    void FloatNumber(double value, int precision);
+    void HexBytes(const void* data, size_t size);
+
+    std::string& _text;
+    bool _separate = false;
+};
+
+// Records one call in JSON lines mode.
+//
+// The record of a call is written in one go once the call down returns, into a buffer the thread keeps
+// for its next call, and submitted to the file writer.  A call made from inside another, such as from
+// a debug messenger callback, is finished before the outer call returns, so it comes first.
+class ApiDumpJsonCall {
+   public:
+    // Inactive, and recording nothing, unless the layer is writing JSON lines and the call is to be
+    // recorded.  The duration of the call is measured from here.
+    ApiDumpJsonCall(CaptureCommand command, bool recorded);
+    ApiDumpJsonCall(const ApiDumpJsonCall&) = delete;
+    ApiDumpJsonCall& operator=(const ApiDumpJsonCall&) = delete;
+
+    bool IsActive() const { return _active; }
+
+    // Writes the command, thread, start time and duration, and returns the writer for the rest of the
+    // record: the result and parameters, written by the generated ApiDumpJsonWrite*Call functions.
+    ApiDumpJsonWriter& Begin();
+
+    // Completes the record, and submits it.
+    void Finish();
+
+   private:
+    bool _active;
+    CaptureCommand _command;
+    std::chrono::steady_clock::time_point _start;
+    std::string& _record;
+    ApiDumpJsonWriter _writer;
+};
+
+// Starts writing JSON lines.  When restarting, the times are counted from now.
+void ApiDumpJsonStart(bool restart);
+
+// Stops writing JSON lines, until started again.
+void ApiDumpJsonStop();
+
+// Defined in api_dump.cpp, which owns the file writer.
+void ApiDumpLayerRecordJson(const char* record, size_t size);
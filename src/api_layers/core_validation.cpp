@@ -19,7 +19,14 @@
 // Author: Mark Young <marky@lunarg.com>
 //
 
+#include "allocation_callbacks.h"
 #include "api_layer_platform_defines.h"
+#include "background_file_writer.h"
+#include "core_validation_async.h"
+#include "core_validation_messages.h"
+#include "core_validation_performance.h"
+#include "core_validation_sampling.h"
+#include "core_validation_struct_tables.h"
 #include "extra_algorithms.h"
 #include "hex_and_handles.h"
 #include "loader_interfaces.h"
@@ -27,13 +34,14 @@
 #include "validation_utils.h"
 #include "xr_generated_core_validation.hpp"
 #include "xr_generated_dispatch_table.h"
+#include "xr_generated_reflection.hpp"
 
 #include <openxr/openxr.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -65,189 +73,186 @@ enum CoreValidationRecordType {
 struct CoreValidationRecordInfo {
     bool initialized;
     CoreValidationRecordType type;
+    // Kept for the life of the library, so it does not hold memory from the allocation callbacks.
     std::string file_name;
 };
 
 static CoreValidationRecordInfo g_record_info = {};
 static std::mutex g_record_mutex = {};
+// Writes the RECORD_TEXT_COUT output to standard output, and the RECORD_TEXT_FILE and RECORD_HTML_FILE
+// output to the file
+static BackgroundFileWriter g_record_writer;
+static std::mutex g_policy_mutex = {};
+
+std::atomic<uint64_t> g_handle_generation{0};
 
 // HTML utilities
-bool CoreValidationWriteHtmlHeader() {
-    try {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-        std::ofstream html_file;
-        html_file.open(g_record_info.file_name, std::ios::out);
-        html_file
-            << "<!doctype html>\n"
-               "<html>\n"
-               "    <head>\n"
-               "        <title>OpenXR Core Validation</title>\n"
-               "        <style type='text/css'>\n"
-               "        html {\n"
-               "            background-color: #0b1e48;\n"
-               "            background-image: url('https://vulkan.lunarg.com/img/bg-starfield.jpg');\n"
-               "            background-position: center;\n"
-               "            -webkit-background-size: cover;\n"
-               "            -moz-background-size: cover;\n"
-               "            -o-background-size: cover;\n"
-               "            background-size: cover;\n"
-               "            background-attachment: fixed;\n"
-               "            background-repeat: no-repeat;\n"
-               "            height: 100%;\n"
-               "        }\n"
-               "        #header {\n"
-               "            z-index: -1;\n"
-               "        }\n"
-               "        #header>img {\n"
-               "            position: absolute;\n"
-               "            width: 160px;\n"
-               "            margin-left: -280px;\n"
-               "            top: -10px;\n"
-               "            left: 50%;\n"
-               "        }\n"
-               "        #header>h1 {\n"
-               "            font-family: Arial, 'Helvetica Neue', Helvetica, sans-serif;\n"
-               "            font-size: 48px;\n"
-               "            font-weight: 200;\n"
-               "            text-shadow: 4px 4px 5px #000;\n"
-               "            color: #eee;\n"
-               "            position: absolute;\n"
-               "            width: 600px;\n"
-               "            margin-left: -80px;\n"
-               "            top: 8px;\n"
-               "            left: 50%;\n"
-               "        }\n"
-               "        body {\n"
-               "            font-family: Consolas, monaco, monospace;\n"
-               "            font-size: 14px;\n"
-               "            line-height: 20px;\n"
-               "            color: #eee;\n"
-               "            height: 100%;\n"
-               "            margin: 0;\n"
-               "            overflow: hidden;\n"
-               "        }\n"
-               "        #wrapper {\n"
-               "            background-color: rgba(0, 0, 0, 0.7);\n"
-               "            border: 1px solid #446;\n"
-               "            box-shadow: 0px 0px 10px #000;\n"
-               "            padding: 8px 12px;\n"
-               "            display: inline-block;\n"
-               "            position: absolute;\n"
-               "            top: 80px;\n"
-               "            bottom: 25px;\n"
-               "            left: 50px;\n"
-               "            right: 50px;\n"
-               "            overflow: auto;\n"
-               "        }\n"
-               "        details>*:not(summary) {\n"
-               "            margin-left: 22px;\n"
-               "        }\n"
-               "        summary:only-child {\n"
-               "            display: block;\n"
-               "            padding-left: 15px;\n"
-               "        }\n"
-               "        details>summary:only-child::-webkit-details-marker {\n"
-               "            display: none;\n"
-               "            padding-left: 15px;\n"
-               "        }\n"
-               "        .headervar, .generalheadertype, .warningheadertype, .errorheadertype, .debugheadertype, .headerval {\n"
-               "            display: inline;\n"
-               "            margin: 0 9px;\n"
-               "        }\n"
-               "        .var, .type, .val {\n"
-               "            display: inline;\n"
-               "            margin: 0 6px;\n"
-               "        }\n"
-               "        .warningheadertype, .type {\n"
-               "            color: #dce22f;\n"
-               "        }\n"
-               "        .errorheadertype, .type {\n"
-               "            color: #ff1616;\n"
-               "        }\n"
-               "        .debugheadertype, .type {\n"
-               "            color: #888;\n"
-               "        }\n"
-               "        .generalheadertype, .type {\n"
-               "            color: #acf;\n"
-               "        }\n"
-               "        .headerval, .val {\n"
-               "            color: #afa;\n"
-               "            text-align: right;\n"
-               "        }\n"
-               "        .thd {\n"
-               "            color: #888;\n"
-               "        }\n"
-               "        </style>\n"
-               "    </head>\n"
-               "    <body>\n"
-               "        <div id='header'>\n"
-               "            <img src='https://lunarg.com/wp-content/uploads/2016/02/LunarG-wReg-150.png' />\n"
-               "            <h1>OpenXR Core Validation</h1>\n"
-               "        </div>\n"
-               "        <div id='wrapper'>\n";
-        return true;
-    } catch (...) {
-        return false;
-    }
+const char *CoreValidationHtmlHeader() {
+    return "<!doctype html>\n"
+           "<html>\n"
+           "    <head>\n"
+           "        <title>OpenXR Core Validation</title>\n"
+           "        <style type='text/css'>\n"
+           "        html {\n"
+           "            background-color: #0b1e48;\n"
+           "            background-image: url('https://vulkan.lunarg.com/img/bg-starfield.jpg');\n"
+           "            background-position: center;\n"
+           "            -webkit-background-size: cover;\n"
+           "            -moz-background-size: cover;\n"
+           "            -o-background-size: cover;\n"
+           "            background-size: cover;\n"
+           "            background-attachment: fixed;\n"
+           "            background-repeat: no-repeat;\n"
+           "            height: 100%;\n"
+           "        }\n"
+           "        #header {\n"
+           "            z-index: -1;\n"
+           "        }\n"
+           "        #header>img {\n"
+           "            position: absolute;\n"
+           "            width: 160px;\n"
+           "            margin-left: -280px;\n"
+           "            top: -10px;\n"
+           "            left: 50%;\n"
+           "        }\n"
+           "        #header>h1 {\n"
+           "            font-family: Arial, 'Helvetica Neue', Helvetica, sans-serif;\n"
+           "            font-size: 48px;\n"
+           "            font-weight: 200;\n"
+           "            text-shadow: 4px 4px 5px #000;\n"
+           "            color: #eee;\n"
+           "            position: absolute;\n"
+           "            width: 600px;\n"
+           "            margin-left: -80px;\n"
+           "            top: 8px;\n"
+           "            left: 50%;\n"
+           "        }\n"
+           "        body {\n"
+           "            font-family: Consolas, monaco, monospace;\n"
+           "            font-size: 14px;\n"
+           "            line-height: 20px;\n"
+           "            color: #eee;\n"
+           "            height: 100%;\n"
+           "            margin: 0;\n"
+           "            overflow: hidden;\n"
+           "        }\n"
+           "        #wrapper {\n"
+           "            background-color: rgba(0, 0, 0, 0.7);\n"
+           "            border: 1px solid #446;\n"
+           "            box-shadow: 0px 0px 10px #000;\n"
+           "            padding: 8px 12px;\n"
+           "            display: inline-block;\n"
+           "            position: absolute;\n"
+           "            top: 80px;\n"
+           "            bottom: 25px;\n"
+           "            left: 50px;\n"
+           "            right: 50px;\n"
+           "            overflow: auto;\n"
+           "        }\n"
+           "        details>*:not(summary) {\n"
+           "            margin-left: 22px;\n"
+           "        }\n"
+           "        summary:only-child {\n"
+           "            display: block;\n"
+           "            padding-left: 15px;\n"
+           "        }\n"
+           "        details>summary:only-child::-webkit-details-marker {\n"
+           "            display: none;\n"
+           "            padding-left: 15px;\n"
+           "        }\n"
+           "        .headervar, .generalheadertype, .warningheadertype, .errorheadertype, .debugheadertype, .headerval {\n"
+           "            display: inline;\n"
+           "            margin: 0 9px;\n"
+           "        }\n"
+           "        .var, .type, .val {\n"
+           "            display: inline;\n"
+           "            margin: 0 6px;\n"
+           "        }\n"
+           "        .warningheadertype, .type {\n"
+           "            color: #dce22f;\n"
+           "        }\n"
+           "        .errorheadertype, .type {\n"
+           "            color: #ff1616;\n"
+           "        }\n"
+           "        .debugheadertype, .type {\n"
+           "            color: #888;\n"
+           "        }\n"
+           "        .generalheadertype, .type {\n"
+           "            color: #acf;\n"
+           "        }\n"
+           "        .headerval, .val {\n"
+           "            color: #afa;\n"
+           "            text-align: right;\n"
+           "        }\n"
+           "        .thd {\n"
+           "            color: #888;\n"
+           "        }\n"
+           "        </style>\n"
+           "    </head>\n"
+           "    <body>\n"
+           "        <div id='header'>\n"
+           "            <img src='https://lunarg.com/wp-content/uploads/2016/02/LunarG-wReg-150.png' />\n"
+           "            <h1>OpenXR Core Validation</h1>\n"
+           "        </div>\n"
+           "        <div id='wrapper'>\n";
 }
 
-bool CoreValidationWriteHtmlFooter() {
-    try {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-        std::ofstream html_file;
-        html_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-        html_file << "        </div>\n"
-                     "    </body>\n"
-                     "</html>";
-
-        // Writing the footer means we're done.
-        if (g_record_info.initialized) {
-            g_record_info.initialized = false;
-            g_record_info.type = RECORD_NONE;
-        }
-        return true;
-    } catch (...) {
-        return false;
+const char *CoreValidationHtmlFooter() {
+    return "        </div>\n"
+           "    </body>\n"
+           "</html>";
+}
+
+// The name of the handle type of an object in the output.
+static const char *ObjectTypeHandleName(XrObjectType type) {
+    if (XR_OBJECT_TYPE_UNKNOWN == type) {
+        return "Unknown XR Object";
     }
+    const ReflectionObjectTypeInfo *info = ReflectionGetObjectTypeInfo(type);
+    return (nullptr != info && nullptr != info->handle_name) ? info->handle_name : "";
 }
 
-// Function to record all the core validation information
-void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::string &message_id,
-                         GenValidUsageDebugSeverity message_severity, const std::string &command_name,
-                         std::vector<GenValidUsageXrObjectInfo> objects_info, const std::string &message) {
+// Passes a message to the debug messengers and writes it to the chosen output.
+//
+// The debug messengers are called before this returns, but nothing is locked while they run, and
+// the output is only formatted here, then written by the background thread of g_record_writer.
+static void CoreValidWriteMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,
+                                  GenValidUsageDebugSeverity message_severity, XrDebugUtilsMessageTypeFlagsEXT message_type,
+                                  const char *command_name, const GenValidUsageXrObjectInfoList &objects_info,
+                                  const std::string &message) {
     if (g_record_info.initialized) {
-        std::unique_lock<std::mutex> mlock(g_record_mutex);
-
         // Debug Utils items (in case we need them)
         XrDebugUtilsMessageSeverityFlagsEXT debug_utils_severity = 0;
 
-        std::string severity_string;
+        // Performance warnings are told apart from validation messages in the output.
+        const bool performance = message_type == XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        std::string severity_string = performance ? "PERF" : "VALID";
         switch (message_severity) {
             case VALID_USAGE_DEBUG_SEVERITY_DEBUG:
-                severity_string = "VALID_DEBUG";
+                severity_string += "_DEBUG";
                 debug_utils_severity = XR_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
                 break;
             case VALID_USAGE_DEBUG_SEVERITY_INFO:
-                severity_string = "VALID_INFO";
+                severity_string += "_INFO";
                 debug_utils_severity = XR_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
                 break;
             case VALID_USAGE_DEBUG_SEVERITY_WARNING:
-                severity_string = "VALID_WARNING";
+                severity_string += "_WARNING";
                 debug_utils_severity = XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
                 break;
             case VALID_USAGE_DEBUG_SEVERITY_ERROR:
-                severity_string = "VALID_ERROR";
+                severity_string += "_ERROR";
                 debug_utils_severity = XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
                 break;
             default:
-                severity_string = "VALID_UNKNOWN";
+                severity_string += "_UNKNOWN";
                 break;
         }
         NamesAndLabels names_and_labels;
         // If we have instance information, see if we need to log this information out to a debug messenger
         // callback.
         if (nullptr != instance_info) {
-            if (!instance_info->debug_data.Empty() && !instance_info->debug_messengers.empty()) {
+            if (!instance_info->debug_messengers.empty()) {
                 std::vector<XrSdkLogObjectInfo> objects;
                 objects.reserve(objects_info.size());
                 std::transform(objects_info.begin(), objects_info.end(), std::back_inserter(objects),
@@ -258,8 +263,8 @@ void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::
                 // Setup our callback data once
                 XrDebugUtilsMessengerCallbackDataEXT callback_data = {};
                 callback_data.type = XR_TYPE_DEBUG_UTILS_MESSENGER_CALLBACK_DATA_EXT;
-                callback_data.messageId = message_id.c_str();
-                callback_data.functionName = command_name.c_str();
+                callback_data.messageId = message_id;
+                callback_data.functionName = command_name;
                 callback_data.message = message.c_str();
                 names_and_labels.PopulateCallbackData(callback_data);
 
@@ -270,70 +275,39 @@ void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::
                     // If a callback exists, and the message is of a type this callback cares about, call it.
                     if (nullptr != messenger_create_info->userCallback &&
                         0 != (messenger_create_info->messageSeverities & debug_utils_severity) &&
-                        0 != (messenger_create_info->messageTypes & XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT)) {
-                        XrBool32 ret_val = messenger_create_info->userCallback(debug_utils_severity,
-                                                                               XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT,
-                                                                               &callback_data, messenger_create_info->userData);
+                        0 != (messenger_create_info->messageTypes & message_type)) {
+                        XrBool32 ret_val = messenger_create_info->userCallback(debug_utils_severity, message_type, &callback_data,
+                                                                               messenger_create_info->userData);
                     }
                 }
             }
         }
 
+        std::ostringstream record;
         switch (g_record_info.type) {
-            case RECORD_TEXT_COUT: {
-                std::cout << "[" << severity_string << " | " << message_id << " | " << command_name << "]: " << message
-                          << std::endl;
-                if (!objects_info.empty()) {
-                    std::cout << "  Objects:" << std::endl;
-                    uint32_t count = 0;
-                    for (const auto &object_info : objects_info) {
-                        std::string object_type = GenValidUsageXrObjectTypeToString(object_info.type);
-                        std::ostringstream oss_object_handle;
-                        std::cout << "   [" << std::to_string(count++) << "] - " << object_type << " ("
-                                  << Uint64ToHexString(object_info.handle) << ")";
-                        std::cout << std::endl;
-                    }
-                }
-                if (!names_and_labels.labels.empty()) {
-                    std::cout << "  Session Labels:" << std::endl;
-                    uint32_t count = 0;
-                    for (const auto &session_label : names_and_labels.labels) {
-                        std::cout << "   [" << std::to_string(count++) << "] - " << session_label.labelName << std::endl;
-                    }
-                }
-                std::cout << std::flush;
-                break;
-            }
+            case RECORD_TEXT_COUT:
             case RECORD_TEXT_FILE: {
-                std::ofstream text_file;
-                text_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-                text_file << "[" << severity_string << " | " << message_id << " | " << command_name << "]: " << message
-                          << std::endl;
+                record << "[" << severity_string << " | " << message_id << " | " << command_name << "]: " << message << "\n";
                 if (!objects_info.empty()) {
-                    text_file << "  Objects:" << std::endl;
+                    record << "  Objects:\n";
                     uint32_t count = 0;
                     for (const auto &object_info : objects_info) {
-                        std::string object_type = GenValidUsageXrObjectTypeToString(object_info.type);
-                        text_file << "   [" << std::to_string(count++) << "] - " << object_type << " ("
-                                  << Uint64ToHexString(object_info.handle) << ")";
-                        text_file << std::endl;
+                        const char *object_type = ObjectTypeHandleName(object_info.type);
+                        record << "   [" << std::to_string(count++) << "] - " << object_type << " ("
+                               << Uint64ToHexString(object_info.handle) << ")\n";
                     }
                 }
                 if (!names_and_labels.labels.empty()) {
-                    text_file << "  Session Labels:" << std::endl;
+                    record << "  Session Labels:\n";
                     uint32_t count = 0;
                     for (const auto &session_label : names_and_labels.labels) {
-                        text_file << "   [" << std::to_string(count++) << "] - " << session_label.labelName << std::endl;
+                        record << "   [" << std::to_string(count++) << "] - " << session_label.labelName << "\n";
                     }
                 }
-                text_file << std::flush;
-                text_file.close();
                 break;
             }
             case RECORD_HTML_FILE: {
-                std::ofstream text_file;
-                text_file.open(g_record_info.file_name, std::ios::out | std::ios::app);
-                text_file << "<details class='data'>\n";
+                record << "<details class='data'>\n";
                 std::string header_type = "generalheadertype";
                 switch (message_severity) {
                     case VALID_USAGE_DEBUG_SEVERITY_DEBUG:
@@ -355,62 +329,118 @@ void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::
                         severity_string = "Unknown Message";
                         break;
                 }
-                text_file << "   <summary>\n"
-                          << "      <div class='" << header_type << "'>" << severity_string << "</div>\n"
-                          << "      <div class='headerval'>" << command_name << "</div>\n"
-                          << "      <div class='headervar'>" << message_id << "</div>\n"
-                          << "   </summary>\n";
-                text_file << "   <div class='data'>\n";
-                text_file << "      <div class='val'>" << message << "</div>\n";
+                if (performance) {
+                    severity_string = "Performance " + severity_string;
+                }
+                record << "   <summary>\n"
+                       << "      <div class='" << header_type << "'>" << severity_string << "</div>\n"
+                       << "      <div class='headerval'>" << command_name << "</div>\n"
+                       << "      <div class='headervar'>" << message_id << "</div>\n"
+                       << "   </summary>\n";
+                record << "   <div class='data'>\n";
+                record << "      <div class='val'>" << message << "</div>\n";
                 if (!objects_info.empty()) {
-                    text_file << "      <details class='data'>\n";
-                    text_file << "         <summary>\n";
-                    text_file << "            <div class='type'>Relevant OpenXR Objects</div>\n";
-                    text_file << "         </summary>\n";
+                    record << "      <details class='data'>\n";
+                    record << "         <summary>\n";
+                    record << "            <div class='type'>Relevant OpenXR Objects</div>\n";
+                    record << "         </summary>\n";
                     uint32_t count = 0;
                     for (const auto &object_info : objects_info) {
-                        std::string object_type = GenValidUsageXrObjectTypeToString(object_info.type);
-                        text_file << "         <div class='data'>\n";
-                        text_file << "             <div class='var'>[" << count++ << "]</div>\n";
-                        text_file << "             <div class='type'>" << object_type << "</div>\n";
-                        text_file << "             <div class='val'>" << Uint64ToHexString(object_info.handle) << "</div>\n";
-                        text_file << "         </div>\n";
+                        const char *object_type = ObjectTypeHandleName(object_info.type);
+                        record << "         <div class='data'>\n";
+                        record << "             <div class='var'>[" << count++ << "]</div>\n";
+                        record << "             <div class='type'>" << object_type << "</div>\n";
+                        record << "             <div class='val'>" << Uint64ToHexString(object_info.handle) << "</div>\n";
+                        record << "         </div>\n";
                     }
-                    text_file << "      </details>\n";
-                    text_file << std::flush;
+                    record << "      </details>\n";
                 }
                 if (!names_and_labels.labels.empty()) {
-                    text_file << "      <details class='data'>\n";
-                    text_file << "         <summary>\n";
-                    text_file << "            <div class='type'>Relevant Session Labels</div>\n";
-                    text_file << "         </summary>\n";
+                    record << "      <details class='data'>\n";
+                    record << "         <summary>\n";
+                    record << "            <div class='type'>Relevant Session Labels</div>\n";
+                    record << "         </summary>\n";
                     uint32_t count = 0;
                     for (const auto &session_label : names_and_labels.labels) {
-                        text_file << "         <div class='data'>\n";
-                        text_file << "             <div class='var'>[" << count++ << "]</div>\n";
-                        text_file << "             <div class='type'>" << session_label.labelName << "</div>\n";
-                        text_file << "         </div>\n";
+                        record << "         <div class='data'>\n";
+                        record << "             <div class='var'>[" << count++ << "]</div>\n";
+                        record << "             <div class='type'>" << session_label.labelName << "</div>\n";
+                        record << "         </div>\n";
                     }
-                    text_file << "      </details>\n";
+                    record << "      </details>\n";
                 }
-                text_file << "   </div>\n";
-                text_file << "</details>\n";
+                record << "   </div>\n";
+                record << "</details>\n";
                 break;
             }
             default:
-                break;
+                return;
         }
+        std::string text = record.str();
+        g_record_writer.Submit(text.data(), text.size());
+    }
+}
+
+// Writes a message that was counted, as the summary of its suppressed repeats if there were any.
+static void CoreValidWriteCountedMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,
+                                         GenValidUsageDebugSeverity message_severity, XrDebugUtilsMessageTypeFlagsEXT message_type,
+                                         const char *command_name, const GenValidUsageXrObjectInfoList &objects_info,
+                                         const std::string &message, const CoreValidationMessageCount &count) {
+    if (count.suppressed_repeats != 0) {
+        CoreValidWriteMessage(instance_info, message_id, message_severity, message_type, command_name, objects_info,
+                              message + " (suppressed " + std::to_string(count.suppressed_repeats) + " repeats of this message)");
+    } else {
+        CoreValidWriteMessage(instance_info, message_id, message_severity, message_type, command_name, objects_info, message);
     }
 }
 
+// Function to record all the core validation information
+void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,
+                         GenValidUsageDebugSeverity message_severity, const char *command_name,
+                         const GenValidUsageXrObjectInfoList &objects_info, const char *message) {
+    // Repeats are counted, and dropped, before the message is copied, locked or written.
+    if (CoreValidationMessageCount count = CoreValidationCountMessage(message_id, command_name, objects_info)) {
+        CoreValidWriteCountedMessage(instance_info, message_id, message_severity, XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT,
+                                     command_name, objects_info, message, count);
+    }
+}
+
+void CoreValidLogCountedMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,
+                                GenValidUsageDebugSeverity message_severity, const char *command_name,
+                                const GenValidUsageXrObjectInfoList &objects_info, const std::string &message,
+                                const CoreValidationMessageCount &count) {
+    CoreValidWriteCountedMessage(instance_info, message_id, message_severity, XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT,
+                                 command_name, objects_info, message, count);
+}
+
+void CoreValidLogPerformanceMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id, const char *command_name,
+                                    const GenValidUsageXrObjectInfoList &objects_info, const std::string &message,
+                                    const CoreValidationMessageCount &count) {
+    CoreValidWriteCountedMessage(instance_info, message_id, VALID_USAGE_DEBUG_SEVERITY_WARNING,
+                                 XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT, command_name, objects_info, message, count);
+}
+
 void reportInternalError(std::string const &message) {
     std::cerr << "INTERNAL VALIDATION LAYER ERROR: " << message << std::endl;
     throw std::runtime_error("Internal validation layer error: " + message);
 }
 
-void InvalidStructureType(GenValidUsageXrInstanceInfo *instance_info, const std::string &command_name,
-                          std::vector<GenValidUsageXrObjectInfo> &objects_info, const char *structure_name, XrStructureType type,
+void InvalidStructureType(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                          const GenValidUsageXrObjectInfoList &objects_info, const char *structure_name, XrStructureType type,
                           const char *vuid, XrStructureType expected, const char *expected_name) {
+    // A wrong structure is often passed in every frame, so repeats are dropped before the VUID or the message
+    // is formatted.
+    CoreValidationMessageCount count = vuid != nullptr
+                                           ? CoreValidationCountMessage(vuid, command_name, objects_info)
+                                           : CoreValidationCountMessage({"VUID-", structure_name, "-type-type"}, command_name, objects_info);
+    if (!count) {
+        return;
+    }
+    std::string type_vuid;
+    if (vuid == nullptr) {
+        type_vuid = "VUID-" + std::string(structure_name) + "-type-type";
+        vuid = type_vuid.c_str();
+    }
     std::ostringstream oss_type;
     oss_type << structure_name << " has an invalid XrStructureType ";
     oss_type << Uint32ToHexString(static_cast<uint32_t>(type));
@@ -418,30 +448,34 @@ void InvalidStructureType(GenValidUsageXrInstanceInfo *instance_info, const std:
         oss_type << ", expected " << Uint32ToHexString(static_cast<uint32_t>(type));
         oss_type << " (" << expected_name << ")";
     }
-    if (vuid != nullptr) {
-        CoreValidLogMessage(instance_info, vuid, VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name, objects_info, oss_type.str());
-    } else {
-        CoreValidLogMessage(instance_info, "VUID-" + std::string(structure_name) + "-type-type", VALID_USAGE_DEBUG_SEVERITY_ERROR,
-                            command_name, objects_info, oss_type.str());
-    }
+    CoreValidWriteCountedMessage(instance_info, vuid, VALID_USAGE_DEBUG_SEVERITY_ERROR, XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT,
+                                 command_name, objects_info, oss_type.str(), count);
 }
 
-std::string StructTypesToString(GenValidUsageXrInstanceInfo *instance_info, const std::vector<XrStructureType> &structs) {
+std::string StructTypesToString(GenValidUsageXrInstanceInfo *instance_info, const XrStructureType *types, size_t type_count,
+                                const GenValidUsageNextChainTypeSet &type_set) {
     char struct_type_buffer[XR_MAX_STRUCTURE_NAME_SIZE];
     std::string error_message;
-    if (nullptr == instance_info) {
-        error_message = "UNKNOWN - no instance info available";
-        return error_message;
-    }
     bool wrote_struct = false;
-    for (auto &s : structs)
-        if (XR_SUCCESS == instance_info->dispatch_table->StructureTypeToString(instance_info->instance, s, struct_type_buffer)) {
+    for (size_t type_index = 0; type_index < type_count; ++type_index) {
+        if (!type_set[type_index]) {
+            continue;
+        }
+        // Only types the registry does not define need the runtime to name them.
+        const char *struct_name = ReflectionStructureTypeName(types[type_index]);
+        if (nullptr == struct_name && nullptr != instance_info &&
+            XR_SUCCESS ==
+                instance_info->dispatch_table->StructureTypeToString(instance_info->instance, types[type_index], struct_type_buffer)) {
+            struct_name = struct_type_buffer;
+        }
+        if (nullptr != struct_name) {
             if (wrote_struct) {
                 error_message += ", ";
             }
             wrote_struct = true;
-            error_message += struct_type_buffer;
+            error_message += struct_name;
         }
+    }
     return error_message;
 }
 // NOTE: Can't validate the following VUIDs since the command never enters a layer:
@@ -459,14 +493,12 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateInstance(const XrInstanceCr
 }
 
 GenValidUsageXrInstanceInfo::GenValidUsageXrInstanceInfo(XrInstance inst, PFN_xrGetInstanceProcAddr next_get_instance_proc_addr)
-    : instance(inst), dispatch_table(new XrGeneratedDispatchTable()) {
-    /// @todo smart pointer here!
-
+    : instance(inst), dispatch_table(XrSdkMakeUnique<XrGeneratedDispatchTable>()) {
     // Create the dispatch table to the next levels
-    GeneratedXrPopulateDispatchTable(dispatch_table, instance, next_get_instance_proc_addr);
+    GeneratedXrPopulateDispatchTable(dispatch_table.get(), instance, next_get_instance_proc_addr);
 }
 
-GenValidUsageXrInstanceInfo::~GenValidUsageXrInstanceInfo() { delete dispatch_table; }
+GenValidUsageXrInstanceInfo::~GenValidUsageXrInstanceInfo() = default;
 
 // See if there is a debug utils create structure in the "next" chain
 
@@ -477,6 +509,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateApiLayerInstance(const XrIn
         XrApiLayerCreateInfo new_api_layer_info = {};
         XrResult validation_result = XR_SUCCESS;
         bool user_defined_output = false;
+        std::unique_lock<std::mutex> record_lock(g_record_mutex);
         bool first_time = !g_record_info.initialized;
 
         if (!g_record_info.initialized) {
@@ -497,20 +530,46 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateApiLayerInstance(const XrIn
 
             std::cerr << "Core Validation output type: " << export_type_lower
                       << ", first time = " << (first_time ? "true" : "false") << std::endl;
+            // The output stays open until the last instance is destroyed, so only the first instance
+            // chooses it.
             if (export_type_lower == "text") {
-                if (!g_record_info.file_name.empty()) {
-                    g_record_info.type = RECORD_TEXT_FILE;
-                } else {
-                    g_record_info.type = RECORD_TEXT_COUT;
+                if (first_time) {
+                    if (!g_record_info.file_name.empty()) {
+                        g_record_info.type = RECORD_TEXT_FILE;
+                    } else {
+                        g_record_info.type = RECORD_TEXT_COUT;
+                    }
+                    if (!g_record_writer.Open(g_record_info.type == RECORD_TEXT_FILE ? g_record_info.file_name : "", true,
+                                              false, "", "", 0)) {
+                        g_record_info.type = RECORD_NONE;
+                    }
                 }
                 user_defined_output = true;
             } else if (export_type_lower == "html" && first_time) {
                 g_record_info.type = RECORD_HTML_FILE;
-                if (!CoreValidationWriteHtmlHeader()) {
+                if (!g_record_writer.Open(g_record_info.file_name, false, false, CoreValidationHtmlHeader(),
+                                          CoreValidationHtmlFooter(), 0)) {
                     return XR_ERROR_INITIALIZATION_FAILED;
                 }
             }
         }
+        record_lock.unlock();
+
+        // The commands to validate, the limits on repeated messages and the performance checks are chosen
+        // again by the first instance, so not while another instance is still being validated.
+        std::unique_lock<std::mutex> policy_lock(g_policy_mutex);
+        if (g_instance_info.empty()) {
+            CoreValidationConfigureCommandPolicies(PlatformUtilsGetEnv("XR_CORE_VALIDATION_SAMPLE"),
+                                                   PlatformUtilsGetEnv("XR_CORE_VALIDATION_MEMOIZE"));
+            CoreValidationConfigureMessageLimits(PlatformUtilsGetEnv("XR_CORE_VALIDATION_MESSAGE_LIMIT"),
+                                                 PlatformUtilsGetEnv("XR_CORE_VALIDATION_MESSAGE_SUMMARY"));
+            CoreValidationConfigurePerformanceChecks(PlatformUtilsGetEnv("XR_CORE_VALIDATION_PERFORMANCE"));
+            CoreValidationConfigureAsyncValidation(PlatformUtilsGetEnv("XR_CORE_VALIDATION_ASYNC"));
+#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+            CoreValidationConfigureStructEngine(PlatformUtilsGetEnv("XR_CORE_VALIDATION_STRUCT_ENGINE"));
+#endif  // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+        }
+        policy_lock.unlock();
 
         // Call the generated pre valid usage check.
         validation_result = GenValidUsageInputsXrCreateInstance(info, instance);
@@ -534,9 +593,8 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateApiLayerInstance(const XrIn
             new GenValidUsageXrInstanceInfo(returned_instance, next_get_instance_proc_addr));
 
         // Save the enabled extensions.
-        for (uint32_t extension = 0; extension < info->enabledExtensionCount; ++extension) {
-            instance_info->enabled_extensions.emplace_back(info->enabledExtensionNames[extension]);
-        }
+        instance_info->enabled_extensions =
+            GenValidUsageExtensionSetFromNames(info->enabledExtensionCount, info->enabledExtensionNames);
 
         g_instance_info.insert(returned_instance, std::move(instance_info));
 
@@ -573,15 +631,8 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateApiLayerInstance(const XrIn
     }
 }
 
-void EraseAllInstanceTableMapElements(GenValidUsageXrInstanceInfo *search_value) {
-    typedef typename InstanceHandleInfo::value_t value_t;
-    auto map_with_lock = g_instance_info.lockMap();
-    auto &map = map_with_lock.second;
-
-    map_erase_if(map, [=](value_t const &data) { return data.second.get() == search_value; });
-}
-
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrDestroyInstance(XrInstance instance) {
+    CoreValidationWaitForQueuedCalls();
     GenValidUsageInputsXrDestroyInstance(instance);
     if (XR_NULL_HANDLE != instance) {
         auto info_with_lock = g_instance_info.getWithLock(instance);
@@ -591,8 +642,20 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrDestroyInstance(XrInstance instan
         }
     }
     XrResult result = GenValidUsageNextXrDestroyInstance(instance);
-    if (!g_instance_info.empty() && g_record_info.type == RECORD_HTML_FILE) {
-        CoreValidationWriteHtmlFooter();
+    if (XR_SUCCEEDED(result)) {
+        CoreValidationForgetPerformanceTrackers(instance);
+    }
+    if (g_instance_info.empty()) {
+        // Everything reported is written out once the last instance is gone, which also finishes
+        // the HTML output, and the next instance chooses the output again.
+        std::unique_lock<std::mutex> record_lock(g_record_mutex);
+        if (g_instance_info.empty()) {
+            g_record_info.initialized = false;
+            g_record_info.type = RECORD_NONE;
+            CoreValidationStopAsyncValidation();
+            g_record_writer.Close();
+            GenValidUsageReleaseRetiredMapTables();
+        }
     }
     return result;
 }
@@ -600,6 +663,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrDestroyInstance(XrInstance instan
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateSession(XrInstance instance, const XrSessionCreateInfo *createInfo,
                                                              XrSession *session) {
     try {
+        CoreValidationWaitForQueuedCalls();
         XrResult test_result = GenValidUsageInputsXrCreateSession(instance, createInfo, session);
         if (XR_SUCCESS != test_result) {
             return test_result;
@@ -649,11 +713,9 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateSession(XrInstance instance
         }
         bool has_headless = false;
         auto const &enabled_extensions = gen_instance_info->enabled_extensions;
-        has_headless |= (enabled_extensions.end() !=
-                         std::find(enabled_extensions.begin(), enabled_extensions.end(), XR_MND_HEADLESS_EXTENSION_NAME));
+        has_headless |= ExtensionEnabled(enabled_extensions, GEN_VALID_USAGE_EXTENSION_XR_MND_HEADLESS);
 #ifdef XR_KHR_headless
-        has_headless |= (enabled_extensions.end() !=
-                         std::find(enabled_extensions.begin(), enabled_extensions.end(), XR_KHR_HEADLESS_EXTENSION_NAME));
+        has_headless |= ExtensionEnabled(enabled_extensions, GEN_VALID_USAGE_EXTENSION_XR_KHR_HEADLESS);
 #endif  // XR_KHR_headless
 
         bool got_right_graphics_binding_count = (num_graphics_bindings_found == 1);
@@ -662,8 +724,14 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateSession(XrInstance instance
             got_right_graphics_binding_count = (num_graphics_bindings_found == 0);
         }
         if (!got_right_graphics_binding_count) {
-            std::vector<GenValidUsageXrObjectInfo> objects_info;
+            GenValidUsageXrObjectInfoList objects_info;
             objects_info.emplace_back(instance, XR_OBJECT_TYPE_INSTANCE);
+            // TODO: This needs to be updated with the actual VUID once we generate it.
+            const char *vuid = "VUID-xrCreateSession-next-parameter";
+            CoreValidationMessageCount count = CoreValidationCountMessage(vuid, "xrCreateSession", objects_info);
+            if (!count) {
+                return XR_ERROR_GRAPHICS_DEVICE_INVALID;
+            }
             std::ostringstream error_stream;
             error_stream << "Invalid number of graphics binding structures provided.  ";
             error_stream << "Expected ";
@@ -675,9 +743,8 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateSession(XrInstance instance
             error_stream << ", but received ";
             error_stream << num_graphics_bindings_found;
             error_stream << ".";
-            // TODO: This needs to be updated with the actual VUID once we generate it.
-            CoreValidLogMessage(gen_instance_info, "VUID-xrCreateSession-next-parameter", VALID_USAGE_DEBUG_SEVERITY_ERROR,
-                                "xrCreateSession", objects_info, error_stream.str());
+            CoreValidLogCountedMessage(gen_instance_info, vuid, VALID_USAGE_DEBUG_SEVERITY_ERROR, "xrCreateSession", objects_info,
+                                       error_stream.str(), count);
             return XR_ERROR_GRAPHICS_DEVICE_INVALID;
         }
         return GenValidUsageNextXrCreateSession(instance, createInfo, session);
@@ -702,6 +769,7 @@ void CoreValidationDeleteSessionLabels(XrSession session) {
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSetDebugUtilsObjectNameEXT(XrInstance instance,
                                                                           const XrDebugUtilsObjectNameInfoEXT *nameInfo) {
     try {
+        CoreValidationWaitForQueuedCalls();
         XrResult result = GenValidUsageInputsXrSetDebugUtilsObjectNameEXT(instance, nameInfo);
         if (!XR_UNQUALIFIED_SUCCESS(result)) {
             return result;
@@ -725,6 +793,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateDebugUtilsMessengerEXT(XrIn
                                                                             const XrDebugUtilsMessengerCreateInfoEXT *createInfo,
                                                                             XrDebugUtilsMessengerEXT *messenger) {
     try {
+        CoreValidationWaitForQueuedCalls();
         XrResult result = GenValidUsageInputsXrCreateDebugUtilsMessengerEXT(instance, createInfo, messenger);
         if (!XR_UNQUALIFIED_SUCCESS(result)) {
             return result;
@@ -736,7 +805,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateDebugUtilsMessengerEXT(XrIn
         auto info_with_lock = g_instance_info.getWithLock(instance);
         GenValidUsageXrInstanceInfo *gen_instance_info = info_with_lock.second;
         if (nullptr != gen_instance_info) {
-            auto *new_create_info = new XrDebugUtilsMessengerCreateInfoEXT(*createInfo);
+            auto *new_create_info = XrSdkMakeUnique<XrDebugUtilsMessengerCreateInfoEXT>(*createInfo).release();
             new_create_info->next = nullptr;
             UniqueCoreValidationMessengerInfo new_messenger_info(new CoreValidationMessengerInfo);
             new_messenger_info->messenger = *messenger;
@@ -751,6 +820,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrCreateDebugUtilsMessengerEXT(XrIn
 
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrDestroyDebugUtilsMessengerEXT(XrDebugUtilsMessengerEXT messenger) {
     try {
+        CoreValidationWaitForQueuedCalls();
         XrResult result = GenValidUsageInputsXrDestroyDebugUtilsMessengerEXT(messenger);
         if (!XR_UNQUALIFIED_SUCCESS(result)) {
             return result;
@@ -779,6 +849,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrDestroyDebugUtilsMessengerEXT(XrD
 
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSessionBeginDebugUtilsLabelRegionEXT(XrSession session,
                                                                                     const XrDebugUtilsLabelEXT *labelInfo) {
+    CoreValidationWaitForQueuedCalls();
     XrResult test_result = GenValidUsageInputsXrSessionBeginDebugUtilsLabelRegionEXT(session, labelInfo);
     if (XR_SUCCESS != test_result) {
         return test_result;
@@ -794,6 +865,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSessionBeginDebugUtilsLabelRegion
 }
 
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSessionEndDebugUtilsLabelRegionEXT(XrSession session) {
+    CoreValidationWaitForQueuedCalls();
     XrResult test_result = GenValidUsageInputsXrSessionEndDebugUtilsLabelRegionEXT(session);
     if (XR_SUCCESS != test_result) {
         return test_result;
@@ -810,6 +882,7 @@ XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSessionEndDebugUtilsLabelRegionEX
 
 XRAPI_ATTR XrResult XRAPI_CALL CoreValidationXrSessionInsertDebugUtilsLabelEXT(XrSession session,
                                                                                const XrDebugUtilsLabelEXT *labelInfo) {
+    CoreValidationWaitForQueuedCalls();
     XrResult test_result = GenValidUsageInputsXrSessionInsertDebugUtilsLabelEXT(session, labelInfo);
     if (XR_SUCCESS != test_result) {
         return test_result;
@@ -855,4 +928,10 @@ LAYER_EXPORT XrResult xrNegotiateLoaderApiLayerInterface(const XrNegotiateLoader
     return XR_SUCCESS;
 }
 
+// Optional function used by the loader to hand over the allocation callbacks the layer's bookkeeping should use.
+LAYER_EXPORT XrResult xrApiLayerSetAllocationCallbacks(const XrLoaderAllocationCallbacks *allocator) {
+    XrSdkSetAllocationCallbacks(allocator);
+    return XR_SUCCESS;
+}
+
 }  // extern "C"
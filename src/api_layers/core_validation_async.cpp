@@ -0,0 +1,326 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "core_validation_async.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+std::atomic<uint32_t> g_core_validation_async_workers{0};
+
+namespace {
+const size_t kArenaAlignment = alignof(std::max_align_t);
+const uint32_t kMaxAsyncWorkers = 64;
+// The calls a thread can have queued for one worker before it waits for the worker.  A power of two.
+const uint64_t kAsyncRingSize = 128;
+// The threads that can queue calls for one worker; the calls of any other thread are validated as they are made.
+const uint32_t kMaxRingsPerWorker = 64;
+// The size of the blocks of the arena of a ring entry, which most calls fit in.
+const size_t kRingArenaBlockSize = 2 * 1024;
+// How long a worker that has validated every call waits for more before it sleeps until one is queued.  Calls
+// made while it waits are picked up together, so that queuing a call does not switch to the worker.
+const std::chrono::milliseconds kAsyncWorkerPollInterval(1);
+// Keeps the members written by the thread queuing calls and by the worker on separate cache lines.
+const size_t kCacheLineSize = 64;
+}  // namespace
+
+struct CoreValidationAsyncWorker;
+
+struct CoreValidationAsyncRingEntry {
+    CoreValidationArena arena{kRingArenaBlockSize};
+    void (*validate)(const void* inputs){nullptr};
+    const void* inputs{nullptr};
+};
+
+// The calls one thread queued for one worker.  Only that thread writes the entries and head, and only the
+// worker writes tail, so neither takes a lock.
+struct CoreValidationAsyncRing {
+    explicit CoreValidationAsyncRing(CoreValidationAsyncWorker* ring_worker) : worker(ring_worker) {}
+
+    CoreValidationAsyncWorker* const worker;
+    // The number of calls queued so far, and the last tail the thread read.
+    std::atomic<uint64_t> head{0};
+    uint64_t cached_tail{0};
+    uint8_t separation[kCacheLineSize];
+    // The number of calls validated so far.
+    std::atomic<uint64_t> tail{0};
+    uint8_t entries_separation[kCacheLineSize];
+    CoreValidationAsyncRingEntry entries[kAsyncRingSize];
+};
+
+struct CoreValidationAsyncWorker {
+    CoreValidationAsyncWorker() {
+        for (auto& ring : rings) {
+            ring.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ~CoreValidationAsyncWorker() {
+        for (auto& ring : rings) {
+            delete ring.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Only used to add a ring, and to sleep and wake up; queuing and validating calls takes no lock.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable validated;
+    // The rings of the threads that queued calls for the worker, which it keeps until it stops, since a
+    // thread may exit before its calls are validated.
+    std::atomic<CoreValidationAsyncRing*> rings[kMaxRingsPerWorker];
+    std::atomic<uint32_t> ring_count{0};
+    // Whether the worker sleeps until a call is queued.
+    std::atomic<bool> sleeping{false};
+    // The number of threads waiting for the worker to validate calls.
+    std::atomic<uint32_t> waiters{0};
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+namespace {
+// Only changed while no instance is left to make calls, under g_async_workers_mutex.
+std::mutex g_async_workers_mutex;
+std::vector<std::unique_ptr<CoreValidationAsyncWorker>> g_async_workers;
+// Changed each time workers are started, so that threads forget the rings of the workers before.
+std::atomic<uint64_t> g_async_workers_generation{0};
+
+thread_local bool t_is_async_worker = false;
+// The rings of the calling thread, by worker, for the workers of t_async_workers_generation.
+thread_local uint64_t t_async_workers_generation = 0;
+thread_local CoreValidationAsyncRing* t_async_rings[kMaxAsyncWorkers];
+
+void WakeAsyncWorker(CoreValidationAsyncWorker* worker) {
+    std::unique_lock<std::mutex> lock(worker->mutex);
+    worker->wake.notify_one();
+}
+
+CoreValidationAsyncRing* AddAsyncRing(CoreValidationAsyncWorker* worker) {
+    std::unique_lock<std::mutex> lock(worker->mutex);
+    uint32_t ring_count = worker->ring_count.load(std::memory_order_relaxed);
+    if (ring_count == kMaxRingsPerWorker) {
+        return nullptr;
+    }
+    auto ring = new CoreValidationAsyncRing(worker);
+    worker->rings[ring_count].store(ring, std::memory_order_release);
+    worker->ring_count.store(ring_count + 1, std::memory_order_release);
+    return ring;
+}
+
+bool HasQueuedCalls(CoreValidationAsyncWorker* worker) {
+    uint32_t ring_count = worker->ring_count.load(std::memory_order_acquire);
+    for (uint32_t index = 0; index < ring_count; ++index) {
+        CoreValidationAsyncRing* ring = worker->rings[index].load(std::memory_order_acquire);
+        // Sequentially consistent, like the head a thread queuing a call stores before it checks whether
+        // the worker sleeps, so that either the worker sees the call or the thread wakes the worker.
+        if (ring->head.load(std::memory_order_seq_cst) != ring->tail.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Validates the calls queued so far in every ring of the worker, returning whether there were any.
+bool ValidateQueuedCalls(CoreValidationAsyncWorker* worker) {
+    bool validated = false;
+    uint32_t ring_count = worker->ring_count.load(std::memory_order_acquire);
+    for (uint32_t index = 0; index < ring_count; ++index) {
+        CoreValidationAsyncRing* ring = worker->rings[index].load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const CoreValidationAsyncRingEntry& entry = ring->entries[tail & (kAsyncRingSize - 1)];
+            entry.validate(entry.inputs);
+            // Hands the entry back to the thread, which may be waiting for room.
+            ring->tail.store(tail + 1, std::memory_order_seq_cst);
+            validated = true;
+        }
+    }
+    if (validated && worker->waiters.load(std::memory_order_seq_cst) != 0) {
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        worker->validated.notify_all();
+    }
+    return validated;
+}
+
+void RunAsyncWorker(CoreValidationAsyncWorker* worker) {
+    t_is_async_worker = true;
+    auto has_work = [worker]() { return worker->stop.load(std::memory_order_acquire) || HasQueuedCalls(worker); };
+    for (;;) {
+        // No call is made once the worker is told to stop, so it only has to validate those queued before.
+        const bool stopping = worker->stop.load(std::memory_order_acquire);
+        if (ValidateQueuedCalls(worker)) {
+            continue;
+        }
+        if (stopping) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        if (!worker->wake.wait_for(lock, kAsyncWorkerPollInterval, has_work)) {
+            worker->sleeping.store(true, std::memory_order_seq_cst);
+            worker->wake.wait(lock, has_work);
+            worker->sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint32_t ParseWorkerCount(const std::string& value) {
+    char* end = nullptr;
+    uint64_t count = std::strtoull(value.c_str(), &end, 10);
+    if (end == value.c_str() || *end != '\0') {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(count, kMaxAsyncWorkers));
+}
+
+// Stops the workers of an application that exits without destroying its instances, before the state
+// above is destroyed.
+struct AsyncWorkersStopper {
+    ~AsyncWorkersStopper() { CoreValidationStopAsyncValidation(); }
+} g_async_workers_stopper;
+}  // namespace
+
+void* CoreValidationArena::Allocate(size_t size) {
+    size = (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+    while (current_block_ < blocks_.size()) {
+        Block& block = blocks_[current_block_];
+        if (used_ + size <= block.size) {
+            void* allocation = block.data.get() + used_;
+            used_ += size;
+            return allocation;
+        }
+        // A larger block may come later; the rest of this one is left unused until the arena is reset.
+        current_block_++;
+        used_ = 0;
+    }
+    size_t block_size = std::max(size, block_size_);
+    blocks_.push_back(Block{std::unique_ptr<uint8_t, BlockFree>(static_cast<uint8_t*>(XrSdkAllocate(block_size, kArenaAlignment))),
+                            block_size});
+    current_block_ = blocks_.size() - 1;
+    used_ = size;
+    return blocks_.back().data.get();
+}
+
+char* CoreValidationArena::CopyString(const char* value) {
+    if (nullptr == value) {
+        return nullptr;
+    }
+    return CopyArray(value, strlen(value) + 1);
+}
+
+XrBaseOutStructure* CoreValidationArena::CopyChainTypes(const void* next) {
+    XrBaseOutStructure* first = nullptr;
+    XrBaseOutStructure** link = &first;
+    for (auto chained = static_cast<const XrBaseOutStructure*>(next); nullptr != chained; chained = chained->next) {
+        auto copy = Make<XrBaseOutStructure>();
+        copy->type = chained->type;
+        *link = copy;
+        link = &copy->next;
+    }
+    return first;
+}
+
+void CoreValidationArena::Reset() {
+    current_block_ = 0;
+    used_ = 0;
+}
+
+CoreValidationAsyncQueue::CoreValidationAsyncQueue(uint64_t first_handle) {
+    const uint64_t generation = g_async_workers_generation.load(std::memory_order_acquire);
+    if (t_async_workers_generation != generation) {
+        std::fill(std::begin(t_async_rings), std::end(t_async_rings), nullptr);
+        t_async_workers_generation = generation;
+    }
+    uint64_t mixed = first_handle * 0x9E3779B97F4A7C15ULL;
+    size_t worker_index = (mixed >> 32) % g_async_workers.size();
+    ring_ = t_async_rings[worker_index];
+    if (nullptr == ring_) {
+        ring_ = AddAsyncRing(g_async_workers[worker_index].get());
+        if (nullptr == ring_) {
+            throw CoreValidationAsyncRingUnavailable();
+        }
+        t_async_rings[worker_index] = ring_;
+    }
+
+    const uint64_t head = ring_->head.load(std::memory_order_relaxed);
+    if (head - ring_->cached_tail == kAsyncRingSize) {
+        ring_->cached_tail = ring_->tail.load(std::memory_order_acquire);
+        if (head - ring_->cached_tail == kAsyncRingSize) {
+            // The worker is behind, so don't leave it waiting for more calls.
+            WakeAsyncWorker(ring_->worker);
+            do {
+                std::this_thread::yield();
+                ring_->cached_tail = ring_->tail.load(std::memory_order_acquire);
+            } while (head - ring_->cached_tail == kAsyncRingSize);
+        }
+    }
+    entry_ = &ring_->entries[head & (kAsyncRingSize - 1)];
+    entry_->arena.Reset();
+}
+
+CoreValidationArena& CoreValidationAsyncQueue::Arena() { return entry_->arena; }
+
+void CoreValidationAsyncQueue::Queue(void (*validate)(const void* inputs), const void* inputs) {
+    entry_->validate = validate;
+    entry_->inputs = inputs;
+    ring_->head.store(ring_->head.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    if (ring_->worker->sleeping.load(std::memory_order_seq_cst)) {
+        WakeAsyncWorker(ring_->worker);
+    }
+}
+
+void CoreValidationWaitForQueuedCallsSlow() {
+    if (t_is_async_worker) {
+        return;
+    }
+    // Each ring is validated in order, so it is enough to wait for the last call queued in it so far.
+    for (auto& worker : g_async_workers) {
+        uint32_t ring_count = worker->ring_count.load(std::memory_order_acquire);
+        for (uint32_t index = 0; index < ring_count; ++index) {
+            CoreValidationAsyncRing* ring = worker->rings[index].load(std::memory_order_acquire);
+            const uint64_t queued = ring->head.load(std::memory_order_acquire);
+            if (ring->tail.load(std::memory_order_acquire) >= queued) {
+                continue;
+            }
+            worker->waiters.fetch_add(1, std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                // Don't wait for the worker to pick up the calls on its own.
+                worker->wake.notify_one();
+                worker->validated.wait(lock, [ring, queued]() { return ring->tail.load(std::memory_order_seq_cst) >= queued; });
+            }
+            worker->waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CoreValidationStopAsyncValidation() {
+    std::unique_lock<std::mutex> workers_lock(g_async_workers_mutex);
+    g_core_validation_async_workers.store(0, std::memory_order_relaxed);
+    // The workers validate every call queued before they stop.
+    for (auto& worker : g_async_workers) {
+        worker->stop.store(true, std::memory_order_release);
+        WakeAsyncWorker(worker.get());
+        worker->thread.join();
+    }
+    g_async_workers.clear();
+}
+
+void CoreValidationConfigureAsyncValidation(const std::string& workers) {
+    CoreValidationStopAsyncValidation();
+    uint32_t worker_count = ParseWorkerCount(workers);
+    std::unique_lock<std::mutex> workers_lock(g_async_workers_mutex);
+    for (uint32_t index = 0; index < worker_count; ++index) {
+        std::unique_ptr<CoreValidationAsyncWorker> worker(new CoreValidationAsyncWorker);
+        worker->thread = std::thread(RunAsyncWorker, worker.get());
+        g_async_workers.push_back(std::move(worker));
+    }
+    g_async_workers_generation.fetch_add(1, std::memory_order_release);
+    g_core_validation_async_workers.store(worker_count, std::memory_order_relaxed);
+}
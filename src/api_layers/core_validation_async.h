@@ -0,0 +1,152 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "allocation_callbacks.h"
+
+#include <openxr/openxr.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Validates calls on worker threads, so that the thread making a call only pays for copying its inputs.
+//
+// With asynchronous validation on, a call whose inputs the generator knows how to copy has them deep
+// copied, next chains included, into the arena of a CoreValidationAsyncQueue, and is passed down the
+// chain right away; a worker thread validates the copy later.  Calls are given to a worker by their
+// first handle.  Each thread making calls has a ring of calls of its own for each worker, which only
+// that thread writes and only that worker reads, so queuing a call takes no lock and writes nothing
+// another thread making calls writes.  A worker validates the calls of each ring in the order they were
+// made, so the calls a thread makes on one session, such as those between xrBeginFrame and xrEndFrame,
+// are checked in order.  The messages of a call are reported from its worker, through the same debug
+// messengers and output as any other.
+//
+// Every other call, such as those creating or destroying handles, naming objects or labelling a session,
+// first waits for the calls queued before it to be validated, and is then validated as it is made.  So
+// a queued call never outlives the handles it uses, and its messages get the names and labels its
+// objects had when it was made.
+
+// Holds the copies of the inputs of a queued call.  Its blocks are kept when it is reset, so copying inputs
+// only allocates while a call takes more room than the calls queued before it did.
+class CoreValidationArena {
+   public:
+    // Blocks are block_size bytes, unless a copy needs a larger one.
+    explicit CoreValidationArena(size_t block_size = 64 * 1024) : block_size_(block_size) {}
+    CoreValidationArena(const CoreValidationArena&) = delete;
+    CoreValidationArena& operator=(const CoreValidationArena&) = delete;
+
+    // Never returns NULL, even for 0 bytes.  Throws std::bad_alloc if a block can't be allocated.
+    void* Allocate(size_t size);
+
+    template <typename T>
+    T* Make() {
+        return new (Allocate(sizeof(T))) T();
+    }
+
+    template <typename T>
+    T* Copy(const T* value) {
+        if (nullptr == value) {
+            return nullptr;
+        }
+        return static_cast<T*>(memcpy(Allocate(sizeof(T)), value, sizeof(T)));
+    }
+
+    // An empty array that is not NULL is copied to one that is not NULL either, since validation tells
+    // the two apart.
+    template <typename T>
+    T* CopyArray(const T* values, size_t count) {
+        if (nullptr == values) {
+            return nullptr;
+        }
+        void* copy = Allocate(count * sizeof(T));
+        if (count != 0) {
+            memcpy(copy, values, count * sizeof(T));
+        }
+        return static_cast<T*>(copy);
+    }
+
+    char* CopyString(const char* value);
+
+    // Copies the structures chained to one that a call writes to, as far as validation reads them, which
+    // is only their types.
+    XrBaseOutStructure* CopyChainTypes(const void* next);
+
+    // Forgets every copy, keeping the blocks.
+    void Reset();
+
+   private:
+    struct BlockFree {
+        void operator()(uint8_t* data) const noexcept { XrSdkFree(data); }
+    };
+    struct Block {
+        std::unique_ptr<uint8_t, BlockFree> data;
+        size_t size;
+    };
+
+    XrSdkVector<Block> blocks_;
+    size_t block_size_;
+    size_t current_block_{0};
+    size_t used_{0};
+};
+
+// Thrown when a structure chained to the inputs of a call can't be copied, for the call to be validated
+// as it is made.
+struct CoreValidationUncopyableInputs {};
+
+// Thrown when the calling thread can't have a ring for a worker, for the call to be validated as it is made.
+struct CoreValidationAsyncRingUnavailable {};
+
+struct CoreValidationAsyncRing;
+struct CoreValidationAsyncRingEntry;
+
+// Holds the next entry of the ring of the calling thread for the worker validating the calls given a
+// handle, while the inputs of a call are copied to the arena of the entry, first waiting for the worker if
+// the ring is full.  Throws CoreValidationAsyncRingUnavailable if the thread can't have a ring for the
+// worker.  Nothing is queued unless Queue is called.
+class CoreValidationAsyncQueue {
+   public:
+    explicit CoreValidationAsyncQueue(uint64_t first_handle);
+    CoreValidationAsyncQueue(const CoreValidationAsyncQueue&) = delete;
+    CoreValidationAsyncQueue& operator=(const CoreValidationAsyncQueue&) = delete;
+
+    CoreValidationArena& Arena();
+
+    // Queues a call whose inputs were copied to the arena, for the worker to pass them to validate.
+    void Queue(void (*validate)(const void* inputs), const void* inputs);
+
+   private:
+    CoreValidationAsyncRing* ring_;
+    CoreValidationAsyncRingEntry* entry_;
+};
+
+// The number of worker threads, 0 while validation is not asynchronous.  Only changed while no instance
+// is left to make calls, so every call reads it without contending.
+extern std::atomic<uint32_t> g_core_validation_async_workers;
+
+inline bool CoreValidationValidatesAsync() { return g_core_validation_async_workers.load(std::memory_order_relaxed) != 0; }
+
+void CoreValidationWaitForQueuedCallsSlow();
+
+// Waits until every call queued so far, by any thread, is validated.  Does not wait when called from a
+// worker, such as by a debug messenger callback.
+inline void CoreValidationWaitForQueuedCalls() {
+    if (CoreValidationValidatesAsync()) {
+        CoreValidationWaitForQueuedCallsSlow();
+    }
+}
+
+// Stops the workers once every queued call is validated, and starts as many as workers asks for: a number,
+// where 0, or anything else, leaves validation synchronous.
+void CoreValidationConfigureAsyncValidation(const std::string& workers);
+
+// Stops the workers once every queued call is validated.
+void CoreValidationStopAsyncValidation();
@@ -0,0 +1,127 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "core_validation_messages.h"
+
+#include "core_validation_struct_tables.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+std::atomic<uint64_t> g_message_limit{0};
+std::atomic<uint64_t> g_message_summary_interval{0};
+const uint64_t kDefaultSummaryInterval = 100;
+
+// The messages counted so far, by the key hashing their VUID, command and objects.  0 marks an empty
+// slot.
+const size_t kMessageSlots = 1024;
+const size_t kMessageProbes = 8;
+struct MessageSlot {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> count;
+};
+MessageSlot g_message_slots[kMessageSlots] = {};
+
+uint64_t MixMessageKey(uint64_t key, uint64_t word) {
+    key = (key ^ word) * 0x9E3779B97F4A7C15ULL;
+    return key ^ (key >> 32);
+}
+
+// FNV-1a over the characters, continuing from text_hash.
+uint64_t HashMessageText(uint64_t text_hash, const char* text) {
+    for (; *text != '\0'; ++text) {
+        text_hash = (text_hash ^ static_cast<unsigned char>(*text)) * 0x100000001B3ULL;
+    }
+    return text_hash;
+}
+
+const uint64_t kMessageTextHashStart = 0xCBF29CE484222325ULL;
+
+// The text is mixed in as one word.
+uint64_t MixMessageKey(uint64_t key, const char* text) { return MixMessageKey(key, HashMessageText(kMessageTextHashStart, text)); }
+
+CoreValidationMessageCount CountMessageKey(uint64_t key, const char* command_name, const GenValidUsageXrObjectInfoList& objects_info) {
+    key = MixMessageKey(key, command_name);
+    for (const GenValidUsageXrObjectInfo& object_info : objects_info) {
+        key = MixMessageKey(MixMessageKey(key, object_info.handle), static_cast<uint64_t>(object_info.type));
+    }
+    key |= 1;
+
+    uint64_t limit = g_message_limit.load(std::memory_order_relaxed);
+    size_t start = static_cast<size_t>(key >> 32) % kMessageSlots;
+    for (size_t probe = 0; probe < kMessageProbes; ++probe) {
+        MessageSlot& slot = g_message_slots[(start + probe) % kMessageSlots];
+        uint64_t slot_key = slot.key.load(std::memory_order_relaxed);
+        if (slot_key == 0 && slot.key.compare_exchange_strong(slot_key, key, std::memory_order_relaxed)) {
+            slot_key = key;
+        }
+        if (slot_key != key) {
+            continue;
+        }
+        uint64_t count = slot.count.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (count <= limit) {
+            return {true, 0};
+        }
+        uint64_t interval = g_message_summary_interval.load(std::memory_order_relaxed);
+        if (interval == 0 || (count - limit) % interval != 0) {
+            return {false, 0};
+        }
+        return {true, interval};
+    }
+    return {true, 0};
+}
+
+uint64_t ParseCount(const std::string& value) {
+    char* end = nullptr;
+    uint64_t count = std::strtoull(value.c_str(), &end, 10);
+    return (end == value.c_str() || *end != '\0') ? 0 : count;
+}
+}  // namespace
+
+CoreValidationMessageCount CoreValidationCountMessage(const char* message_id, const char* command_name,
+                                                      const GenValidUsageXrObjectInfoList& objects_info) {
+#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+    if (CoreValidationCaptureStructMessage(message_id)) {
+        return {false, 0};
+    }
+#endif  // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+    if (g_message_limit.load(std::memory_order_relaxed) == 0) {
+        return {true, 0};
+    }
+    return CountMessageKey(MixMessageKey(0, message_id), command_name, objects_info);
+}
+
+CoreValidationMessageCount CoreValidationCountMessage(std::initializer_list<const char*> message_id_parts, const char* command_name,
+                                                      const GenValidUsageXrObjectInfoList& objects_info) {
+#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+    std::string message_id;
+    for (const char* part : message_id_parts) {
+        message_id += part;
+    }
+    if (CoreValidationCaptureStructMessage(message_id.c_str())) {
+        return {false, 0};
+    }
+#endif  // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+    if (g_message_limit.load(std::memory_order_relaxed) == 0) {
+        return {true, 0};
+    }
+    uint64_t text_hash = kMessageTextHashStart;
+    for (const char* part : message_id_parts) {
+        text_hash = HashMessageText(text_hash, part);
+    }
+    return CountMessageKey(MixMessageKey(0, text_hash), command_name, objects_info);
+}
+
+void CoreValidationConfigureMessageLimits(const std::string& limit, const std::string& summary_interval) {
+    g_message_limit.store(0, std::memory_order_relaxed);
+    for (MessageSlot& slot : g_message_slots) {
+        slot.key.store(0, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+    }
+    g_message_summary_interval.store(summary_interval.empty() ? kDefaultSummaryInterval : ParseCount(summary_interval),
+                                     std::memory_order_relaxed);
+    g_message_limit.store(ParseCount(limit), std::memory_order_relaxed);
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "validation_utils.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+// Limits how often the layer repeats the same message.
+//
+// A message is told apart by its VUID, its command and the objects it is about, which are hashed
+// into a fixed table, so that a repeat is dropped before anything is formatted, locked or written.
+// Once a message has been emitted as many times as the limit allows, only one in every summary
+// interval of its repeats is emitted, saying how many were suppressed.  While the table is full,
+// new messages are always emitted.
+//
+// A message whose text or VUID has to be formatted is counted with CoreValidationCountMessage first, and
+// only formatted and logged with CoreValidLogCountedMessage if it is to be emitted.
+
+// The result of counting a message.
+struct CoreValidationMessageCount {
+    bool emit;
+    // If the message is emitted as a summary, the number of repeats it stands for, including itself, and otherwise 0.
+    uint64_t suppressed_repeats;
+
+    explicit operator bool() const { return emit; }
+};
+
+// Counts a message, and returns whether to emit it.
+CoreValidationMessageCount CoreValidationCountMessage(const char* message_id, const char* command_name,
+                                                      const GenValidUsageXrObjectInfoList& objects_info);
+
+// Counts a message whose ID is made of several parts as if they were joined, so that the ID is only built
+// if the message is emitted.
+CoreValidationMessageCount CoreValidationCountMessage(std::initializer_list<const char*> message_id_parts, const char* command_name,
+                                                      const GenValidUsageXrObjectInfoList& objects_info);
+
+// Logs a message that CoreValidationCountMessage said to emit.
+void CoreValidLogCountedMessage(GenValidUsageXrInstanceInfo* instance_info, const char* message_id,
+                                GenValidUsageDebugSeverity message_severity, const char* command_name,
+                                const GenValidUsageXrObjectInfoList& objects_info, const std::string& message,
+                                const CoreValidationMessageCount& count);
+
+// Logs a warning of the performance checks that CoreValidationCountMessage said to emit, as an
+// XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT message.
+void CoreValidLogPerformanceMessage(GenValidUsageXrInstanceInfo* instance_info, const char* message_id, const char* command_name,
+                                    const GenValidUsageXrObjectInfoList& objects_info, const std::string& message,
+                                    const CoreValidationMessageCount& count);
+
+// Sets how many times each message is emitted, and how many of its further repeats each summary stands
+// for, and forgets the messages counted so far.  A limit of 0 emits every message, and a summary interval
+// of 0 never emits a summary.  Values that are not numbers are taken as 0, except for an empty summary
+// interval, which is taken as 100.
+void CoreValidationConfigureMessageLimits(const std::string& limit, const std::string& summary_interval);
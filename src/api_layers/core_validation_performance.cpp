@@ -0,0 +1,439 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "core_validation_performance.h"
+
+#include "command_patterns.h"
+#include "core_validation_messages.h"
+#include "hex_and_handles.h"
+#include "validation_utils.h"
+#include "xr_generated_core_validation.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+std::atomic<uint32_t> g_core_validation_performance_checks{0};
+
+namespace {
+const char* const kCheckNames[CORE_VALIDATION_PERFORMANCE_CHECK_COUNT] = {
+    "enumerate-per-frame", "path-in-frame", "repeated-locate", "repeated-sync", "wait-begin-gap",
+};
+
+// The message IDs of the warnings of each check.
+const char* const kCheckMessageIds[CORE_VALIDATION_PERFORMANCE_CHECK_COUNT] = {
+    "PERF-enumerate-per-frame", "PERF-path-in-frame", "PERF-repeated-locate", "PERF-repeated-sync", "PERF-wait-begin-gap",
+};
+
+// How many frames in a row an enumeration is called in before it is reported.
+const uint64_t kEnumerationFrameRun = 3;
+// How many of the pairs of spaces last located each session remembers.
+const size_t kLocatedPairCount = 16;
+const uint64_t kDefaultWaitBeginGapMicroseconds = 2000;
+
+std::atomic<uint64_t> g_wait_begin_gap_microseconds{kDefaultWaitBeginGapMicroseconds};
+
+// The enumerations enumerate-per-frame looks at.
+enum TrackedEnumeration {
+    TRACKED_ENUMERATE_REFERENCE_SPACES = 0,
+    TRACKED_ENUMERATE_SWAPCHAIN_FORMATS,
+    TRACKED_ENUMERATE_VIEW_CONFIGURATIONS,
+    TRACKED_ENUMERATE_VIEW_CONFIGURATION_VIEWS,
+    TRACKED_ENUMERATE_ENVIRONMENT_BLEND_MODES,
+    TRACKED_ENUMERATE_BOUND_SOURCES_FOR_ACTION,
+    TRACKED_ENUMERATION_COUNT,
+};
+
+struct LocatedPair {
+    XrSpace space;
+    XrSpace base_space;
+    XrTime time;
+};
+
+struct SessionTracker {
+    XR_SDK_ALLOCATION_OPERATORS
+    XrInstance instance;
+    // The number of frames started so far, so 0 until the first xrWaitFrame returns.
+    uint64_t frame = 0;
+    // Between xrWaitFrame returning and xrEndFrame.
+    bool in_frame = false;
+    bool waiting_for_begin = false;
+    std::chrono::steady_clock::time_point wait_returned;
+    uint32_t syncs_in_frame = 0;
+    // The frame each enumeration was last called in, and in how many frames in a row up to it.
+    uint64_t enumeration_frames[TRACKED_ENUMERATION_COUNT] = {};
+    uint64_t enumeration_runs[TRACKED_ENUMERATION_COUNT] = {};
+    // The last frame a path conversion was reported in, so that it is only reported once a frame.
+    uint64_t path_reported_frame = 0;
+    LocatedPair located_pairs[kLocatedPairCount] = {};
+    size_t next_located_pair = 0;
+};
+
+std::mutex g_trackers_mutex;
+XrSdkUnorderedMap<XrSession, std::unique_ptr<SessionTracker>> g_trackers;
+
+// A warning found while the trackers were locked, reported once they are not.
+struct PerformanceWarning {
+    CoreValidationPerformanceCheck check;
+    CoreValidationMessageCount count;
+    std::string message;
+};
+
+bool CheckEnabled(CoreValidationPerformanceCheck check) {
+    return (g_core_validation_performance_checks.load(std::memory_order_relaxed) & (1u << check)) != 0;
+}
+
+// Only called with g_trackers_mutex locked.
+SessionTracker& GetTracker(XrSession session, XrInstance instance) {
+    std::unique_ptr<SessionTracker>& tracker = g_trackers[session];
+    if (!tracker) {
+        tracker.reset(new SessionTracker);
+        tracker->instance = instance;
+    }
+    return *tracker;
+}
+
+// Counts a warning of the check, so that a repeat is dropped before its message is formatted.
+CoreValidationMessageCount CountWarning(CoreValidationPerformanceCheck check, const char* command_name,
+                                        const GenValidUsageXrObjectInfoList& objects_info) {
+    return CoreValidationCountMessage(kCheckMessageIds[check], command_name, objects_info);
+}
+
+void Report(GenValidUsageXrInstanceInfo* instance_info, const char* command_name, const GenValidUsageXrObjectInfoList& objects_info,
+            const std::vector<PerformanceWarning>& warnings) {
+    for (const PerformanceWarning& warning : warnings) {
+        CoreValidLogPerformanceMessage(instance_info, kCheckMessageIds[warning.check], command_name, objects_info, warning.message,
+                                       warning.count);
+    }
+}
+
+// Only called with g_trackers_mutex locked.
+void TrackEnumeration(SessionTracker& tracker, TrackedEnumeration enumeration, const char* command_name,
+                      const GenValidUsageXrObjectInfoList& objects_info, std::vector<PerformanceWarning>& warnings) {
+    // Enumerating before the frame loop starts is what the results are for.
+    if (tracker.frame == 0 || tracker.enumeration_frames[enumeration] == tracker.frame) {
+        return;
+    }
+    uint64_t run = tracker.enumeration_frames[enumeration] + 1 == tracker.frame ? tracker.enumeration_runs[enumeration] + 1 : 1;
+    tracker.enumeration_frames[enumeration] = tracker.frame;
+    tracker.enumeration_runs[enumeration] = run;
+    if (run != kEnumerationFrameRun) {
+        return;
+    }
+    if (CoreValidationMessageCount count = CountWarning(CORE_VALIDATION_PERFORMANCE_ENUMERATE_PER_FRAME, command_name, objects_info)) {
+        warnings.push_back(PerformanceWarning{
+            CORE_VALIDATION_PERFORMANCE_ENUMERATE_PER_FRAME, count,
+            std::string(command_name) + " called in " + std::to_string(run) +
+                " frames in a row.  Enumerate once, and again only when the results may have changed."});
+    }
+}
+
+void TrackSessionEnumeration(XrResult result, XrSession session, TrackedEnumeration enumeration, const char* command_name) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_ENUMERATE_PER_FRAME)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_session_info.getWithInstanceInfo(session).second;
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(session, XR_OBJECT_TYPE_SESSION);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            TrackEnumeration(GetTracker(session, instance_info->instance), enumeration, command_name, objects_info, warnings);
+        }
+        Report(instance_info, command_name, objects_info, warnings);
+    } catch (...) {
+    }
+}
+
+// Enumerations of an instance count against the frames of each of its sessions.
+void TrackInstanceEnumeration(XrResult result, XrInstance instance, TrackedEnumeration enumeration, const char* command_name) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_ENUMERATE_PER_FRAME)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_instance_info.get(instance);
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(instance, XR_OBJECT_TYPE_INSTANCE);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            for (auto& session_tracker : g_trackers) {
+                if (session_tracker.second->instance == instance) {
+                    TrackEnumeration(*session_tracker.second, enumeration, command_name, objects_info, warnings);
+                }
+            }
+        }
+        Report(instance_info, command_name, objects_info, warnings);
+    } catch (...) {
+    }
+}
+
+void TrackPathConversion(XrResult result, XrInstance instance, const char* command_name) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_PATH_IN_FRAME)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_instance_info.get(instance);
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(instance, XR_OBJECT_TYPE_INSTANCE);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            for (auto& session_tracker : g_trackers) {
+                SessionTracker& tracker = *session_tracker.second;
+                if (tracker.instance != instance || !tracker.in_frame || tracker.path_reported_frame == tracker.frame) {
+                    continue;
+                }
+                tracker.path_reported_frame = tracker.frame;
+                if (CoreValidationMessageCount count = CountWarning(CORE_VALIDATION_PERFORMANCE_PATH_IN_FRAME, command_name, objects_info)) {
+                    warnings.push_back(PerformanceWarning{
+                        CORE_VALIDATION_PERFORMANCE_PATH_IN_FRAME, count,
+                        std::string(command_name) + " called during frame " + std::to_string(tracker.frame) + " of session " +
+                            HandleToHexString(session_tracker.first) +
+                            ".  Convert the paths once, before the frame loop, and keep them."});
+                }
+            }
+        }
+        Report(instance_info, command_name, objects_info, warnings);
+    } catch (...) {
+    }
+}
+}  // namespace
+
+void CoreValidationConfigurePerformanceChecks(const std::string& checks) {
+    uint32_t enabled = 0;
+    uint64_t wait_begin_gap = kDefaultWaitBeginGapMicroseconds;
+    for (const std::string& entry : SplitCommandList(checks)) {
+        size_t equals = entry.find('=');
+        std::string name = entry.substr(0, equals);
+        if (name == "all") {
+            enabled = (1u << CORE_VALIDATION_PERFORMANCE_CHECK_COUNT) - 1;
+            continue;
+        }
+        for (uint32_t check = 0; check < CORE_VALIDATION_PERFORMANCE_CHECK_COUNT; ++check) {
+            if (name == kCheckNames[check]) {
+                enabled |= 1u << check;
+            }
+        }
+        if (name == kCheckNames[CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP] && equals != std::string::npos) {
+            char* end = nullptr;
+            double milliseconds = std::strtod(entry.c_str() + equals + 1, &end);
+            if (end != entry.c_str() + equals + 1 && *end == '\0' && milliseconds >= 0.0) {
+                wait_begin_gap = static_cast<uint64_t>(milliseconds * 1000.0);
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lock(g_trackers_mutex);
+    g_trackers.clear();
+    g_wait_begin_gap_microseconds.store(wait_begin_gap, std::memory_order_relaxed);
+    g_core_validation_performance_checks.store(enabled, std::memory_order_relaxed);
+}
+
+void CoreValidationForgetPerformanceTrackers(XrInstance instance) {
+    std::unique_lock<std::mutex> lock(g_trackers_mutex);
+    for (auto it = g_trackers.begin(); it != g_trackers.end();) {
+        if (it->second->instance == instance) {
+            it = g_trackers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CoreValidationTrackXrDestroySession(XrResult result, XrSession session) {
+    if (XR_SUCCEEDED(result)) {
+        std::unique_lock<std::mutex> lock(g_trackers_mutex);
+        g_trackers.erase(session);
+    }
+}
+
+void CoreValidationTrackXrWaitFrame(XrResult result, XrSession session, const XrFrameWaitInfo* /*frameWaitInfo*/,
+                                    XrFrameState* /*frameState*/) {
+    if (XR_FAILED(result)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_session_info.getWithInstanceInfo(session).second;
+        std::unique_lock<std::mutex> lock(g_trackers_mutex);
+        SessionTracker& tracker = GetTracker(session, instance_info->instance);
+        tracker.frame++;
+        tracker.in_frame = true;
+        tracker.syncs_in_frame = 0;
+        if (CheckEnabled(CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP)) {
+            tracker.waiting_for_begin = true;
+            tracker.wait_returned = std::chrono::steady_clock::now();
+        }
+    } catch (...) {
+    }
+}
+
+void CoreValidationTrackXrBeginFrame(XrResult result, XrSession session, const XrFrameBeginInfo* /*frameBeginInfo*/) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_session_info.getWithInstanceInfo(session).second;
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(session, XR_OBJECT_TYPE_SESSION);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            SessionTracker& tracker = GetTracker(session, instance_info->instance);
+            if (tracker.waiting_for_begin) {
+                tracker.waiting_for_begin = false;
+                uint64_t gap = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                         std::chrono::steady_clock::now() - tracker.wait_returned)
+                                                         .count());
+                CoreValidationMessageCount count{false, 0};
+                if (gap > g_wait_begin_gap_microseconds.load(std::memory_order_relaxed) &&
+                    (count = CountWarning(CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP, "xrBeginFrame", objects_info))) {
+                    warnings.push_back(PerformanceWarning{
+                        CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP, count,
+                        "xrBeginFrame called " + std::to_string(gap) + " us after xrWaitFrame returned, in frame " +
+                            std::to_string(tracker.frame) + ".  Work between them delays the frame for no benefit; do it after "
+                                                            "xrBeginFrame instead."});
+                }
+            }
+        }
+        Report(instance_info, "xrBeginFrame", objects_info, warnings);
+    } catch (...) {
+    }
+}
+
+void CoreValidationTrackXrEndFrame(XrResult result, XrSession session, const XrFrameEndInfo* /*frameEndInfo*/) {
+    if (XR_FAILED(result)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(g_trackers_mutex);
+    auto tracker = g_trackers.find(session);
+    if (tracker != g_trackers.end()) {
+        tracker->second->in_frame = false;
+    }
+}
+
+void CoreValidationTrackXrSyncActions(XrResult result, XrSession session, const XrActionsSyncInfo* /*syncInfo*/) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_REPEATED_SYNC)) {
+        return;
+    }
+    try {
+        GenValidUsageXrInstanceInfo* instance_info = g_session_info.getWithInstanceInfo(session).second;
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(session, XR_OBJECT_TYPE_SESSION);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            SessionTracker& tracker = GetTracker(session, instance_info->instance);
+            CoreValidationMessageCount count{false, 0};
+            // Reported once a frame, on the second call.
+            if (tracker.frame != 0 && ++tracker.syncs_in_frame == 2 &&
+                (count = CountWarning(CORE_VALIDATION_PERFORMANCE_REPEATED_SYNC, "xrSyncActions", objects_info))) {
+                warnings.push_back(PerformanceWarning{CORE_VALIDATION_PERFORMANCE_REPEATED_SYNC, count,
+                                                      "xrSyncActions called more than once in frame " +
+                                                          std::to_string(tracker.frame) +
+                                                          ".  Sync every active action set in one call, once a frame."});
+            }
+        }
+        Report(instance_info, "xrSyncActions", objects_info, warnings);
+    } catch (...) {
+    }
+}
+
+void CoreValidationTrackXrLocateSpace(XrResult result, XrSpace space, XrSpace baseSpace, XrTime time, XrSpaceLocation* /*location*/) {
+    if (XR_FAILED(result) || !CheckEnabled(CORE_VALIDATION_PERFORMANCE_REPEATED_LOCATE)) {
+        return;
+    }
+    try {
+        GenValidUsageXrHandleInfo* space_info = g_space_info.get(space);
+        if (space_info->direct_parent_type != XR_OBJECT_TYPE_SESSION) {
+            return;
+        }
+        XrSession session = TreatIntegerAsHandle<XrSession>(space_info->direct_parent_handle);
+        GenValidUsageXrObjectInfoList objects_info;
+        objects_info.emplace_back(space, XR_OBJECT_TYPE_SPACE);
+        objects_info.emplace_back(baseSpace, XR_OBJECT_TYPE_SPACE);
+        std::vector<PerformanceWarning> warnings;
+        {
+            std::unique_lock<std::mutex> lock(g_trackers_mutex);
+            SessionTracker& tracker = GetTracker(session, space_info->instance_info->instance);
+            LocatedPair* located = nullptr;
+            for (LocatedPair& pair : tracker.located_pairs) {
+                // Locating the spaces the other way around gives the inverse of the same pose.
+                if ((pair.space == space && pair.base_space == baseSpace) || (pair.space == baseSpace && pair.base_space == space)) {
+                    located = &pair;
+                    break;
+                }
+            }
+            if (located == nullptr) {
+                located = &tracker.located_pairs[tracker.next_located_pair];
+                tracker.next_located_pair = (tracker.next_located_pair + 1) % kLocatedPairCount;
+                *located = LocatedPair{space, baseSpace, 0};
+            } else if (located->time == time) {
+                if (CoreValidationMessageCount count =
+                        CountWarning(CORE_VALIDATION_PERFORMANCE_REPEATED_LOCATE, "xrLocateSpace", objects_info)) {
+                    warnings.push_back(PerformanceWarning{
+                        CORE_VALIDATION_PERFORMANCE_REPEATED_LOCATE, count,
+                        "XrSpace " + HandleToHexString(space) + " located in XrSpace " + HandleToHexString(baseSpace) +
+                            " again for time " + std::to_string(time) +
+                            ".  Locate each pair of spaces once for each time, and keep the result."});
+                }
+            }
+            located->time = time;
+        }
+        Report(space_info->instance_info, "xrLocateSpace", objects_info, warnings);
+    } catch (...) {
+    }
+}
+
+void CoreValidationTrackXrStringToPath(XrResult result, XrInstance instance, const char* /*pathString*/, XrPath* /*path*/) {
+    TrackPathConversion(result, instance, "xrStringToPath");
+}
+
+void CoreValidationTrackXrPathToString(XrResult result, XrInstance instance, XrPath /*path*/, uint32_t /*bufferCapacityInput*/,
+                                       uint32_t* /*bufferCountOutput*/, char* /*buffer*/) {
+    TrackPathConversion(result, instance, "xrPathToString");
+}
+
+void CoreValidationTrackXrEnumerateReferenceSpaces(XrResult result, XrSession session, uint32_t /*spaceCapacityInput*/,
+                                                   uint32_t* /*spaceCountOutput*/, XrReferenceSpaceType* /*spaces*/) {
+    TrackSessionEnumeration(result, session, TRACKED_ENUMERATE_REFERENCE_SPACES, "xrEnumerateReferenceSpaces");
+}
+
+void CoreValidationTrackXrEnumerateSwapchainFormats(XrResult result, XrSession session, uint32_t /*formatCapacityInput*/,
+                                                    uint32_t* /*formatCountOutput*/, int64_t* /*formats*/) {
+    TrackSessionEnumeration(result, session, TRACKED_ENUMERATE_SWAPCHAIN_FORMATS, "xrEnumerateSwapchainFormats");
+}
+
+void CoreValidationTrackXrEnumerateViewConfigurations(XrResult result, XrInstance instance, XrSystemId /*systemId*/,
+                                                      uint32_t /*viewConfigurationTypeCapacityInput*/,
+                                                      uint32_t* /*viewConfigurationTypeCountOutput*/,
+                                                      XrViewConfigurationType* /*viewConfigurationTypes*/) {
+    TrackInstanceEnumeration(result, instance, TRACKED_ENUMERATE_VIEW_CONFIGURATIONS, "xrEnumerateViewConfigurations");
+}
+
+void CoreValidationTrackXrEnumerateViewConfigurationViews(XrResult result, XrInstance instance, XrSystemId /*systemId*/,
+                                                          XrViewConfigurationType /*viewConfigurationType*/,
+                                                          uint32_t /*viewCapacityInput*/, uint32_t* /*viewCountOutput*/,
+                                                          XrViewConfigurationView* /*views*/) {
+    TrackInstanceEnumeration(result, instance, TRACKED_ENUMERATE_VIEW_CONFIGURATION_VIEWS, "xrEnumerateViewConfigurationViews");
+}
+
+void CoreValidationTrackXrEnumerateEnvironmentBlendModes(XrResult result, XrInstance instance, XrSystemId /*systemId*/,
+                                                         XrViewConfigurationType /*viewConfigurationType*/,
+                                                         uint32_t /*environmentBlendModeCapacityInput*/,
+                                                         uint32_t* /*environmentBlendModeCountOutput*/,
+                                                         XrEnvironmentBlendMode* /*environmentBlendModes*/) {
+    TrackInstanceEnumeration(result, instance, TRACKED_ENUMERATE_ENVIRONMENT_BLEND_MODES, "xrEnumerateEnvironmentBlendModes");
+}
+
+void CoreValidationTrackXrEnumerateBoundSourcesForAction(XrResult result, XrSession session,
+                                                         const XrBoundSourcesForActionEnumerateInfo* /*enumerateInfo*/,
+                                                         uint32_t /*sourceCapacityInput*/, uint32_t* /*sourceCountOutput*/,
+                                                         XrPath* /*sources*/) {
+    TrackSessionEnumeration(result, session, TRACKED_ENUMERATE_BOUND_SOURCES_FOR_ACTION, "xrEnumerateBoundSourcesForAction");
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Checks of how an application uses the API that are not errors, but cost it time every frame.
+//
+// They report warnings of the XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT type, with the name of
+// the check prefixed with "PERF-" as the message ID.  Each session has a tracker of its frames, which
+// the commands the checks look at update once they return.  A frame starts when xrWaitFrame returns.
+enum CoreValidationPerformanceCheck : uint32_t {
+    // A two-call enumeration, whose results do not change from frame to frame, called in several frames in a row
+    CORE_VALIDATION_PERFORMANCE_ENUMERATE_PER_FRAME = 0,
+    // xrStringToPath or xrPathToString called between xrWaitFrame and xrEndFrame
+    CORE_VALIDATION_PERFORMANCE_PATH_IN_FRAME,
+    // The same pair of spaces located more than once for the same time
+    CORE_VALIDATION_PERFORMANCE_REPEATED_LOCATE,
+    // xrSyncActions called more than once in a frame
+    CORE_VALIDATION_PERFORMANCE_REPEATED_SYNC,
+    // Too long between xrWaitFrame returning and xrBeginFrame
+    CORE_VALIDATION_PERFORMANCE_WAIT_BEGIN_GAP,
+    CORE_VALIDATION_PERFORMANCE_CHECK_COUNT,
+};
+
+// The enabled checks, as bits indexed by CoreValidationPerformanceCheck.
+extern std::atomic<uint32_t> g_core_validation_performance_checks;
+
+inline bool CoreValidationTracksPerformance() { return g_core_validation_performance_checks.load(std::memory_order_relaxed) != 0; }
+
+// Sets the enabled checks, and forgets every session tracker.
+//
+// checks is a comma separated list of the names of the checks, enumerate-per-frame, path-in-frame,
+// repeated-locate, repeated-sync and wait-begin-gap, or "all" for every check.  wait-begin-gap may be
+// followed by "=" and the longest gap allowed in milliseconds, which is 2 otherwise.  Unknown names
+// are ignored.
+void CoreValidationConfigurePerformanceChecks(const std::string& checks);
+
+// Forgets the trackers of the sessions of an instance that is being destroyed.
+void CoreValidationForgetPerformanceTrackers(XrInstance instance);
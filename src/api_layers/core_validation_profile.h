@@ -0,0 +1,47 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+// Chooses at compile time which kinds of checks the generated validation code contains.
+//
+// The build sets XR_CORE_VALIDATION_PROFILE to one of the profiles below, through the
+// CORE_VALIDATION_PROFILE CMake cache variable.  Each kind of check has a macro that is 1 when the
+// profile includes it; the generator wraps the checks of that kind, and the functions only they
+// call, in "#if" blocks on that macro, so a smaller profile is also a smaller layer.  Handles are
+// always tracked as they are created and destroyed, whatever the profile.
+#define XR_CORE_VALIDATION_PROFILE_MINIMAL 1   // Handles passed to commands
+#define XR_CORE_VALIDATION_PROFILE_STANDARD 2  // and pointers, structures, enums, handle parents and call order
+#define XR_CORE_VALIDATION_PROFILE_FULL 3      // and flags, next chains and extension dependencies
+
+#ifndef XR_CORE_VALIDATION_PROFILE
+#define XR_CORE_VALIDATION_PROFILE XR_CORE_VALIDATION_PROFILE_FULL
+#endif
+
+// Non-optional pointers and arrays are not NULL, and array lengths are not zero.
+#define XR_CORE_VALIDATION_CHECK_POINTERS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_STANDARD)
+// Structures passed to commands have the right type, and their members are valid.
+#define XR_CORE_VALIDATION_CHECK_STRUCTS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_STANDARD)
+// Enum values are in range.
+#define XR_CORE_VALIDATION_CHECK_ENUMS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_STANDARD)
+// Handles passed together share a parent.
+#define XR_CORE_VALIDATION_CHECK_PARENTS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_STANDARD)
+// Commands are called between the commands that begin and end their state, such as frames.
+#define XR_CORE_VALIDATION_CHECK_STATE (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_STANDARD)
+// Flags only have defined bits set.
+#define XR_CORE_VALIDATION_CHECK_FLAGS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_FULL)
+// Next chains only hold structures that extend their parent, each at most once.
+#define XR_CORE_VALIDATION_CHECK_NEXT_CHAINS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_FULL)
+// The extensions that commands, structures and enum values belong to, and the ones they depend on, are enabled.
+#define XR_CORE_VALIDATION_CHECK_EXTENSIONS (XR_CORE_VALIDATION_PROFILE >= XR_CORE_VALIDATION_PROFILE_FULL)
+
+// The name of the profile the layer was built with.
+#if XR_CORE_VALIDATION_PROFILE == XR_CORE_VALIDATION_PROFILE_MINIMAL
+#define XR_CORE_VALIDATION_PROFILE_NAME "minimal"
+#elif XR_CORE_VALIDATION_PROFILE == XR_CORE_VALIDATION_PROFILE_STANDARD
+#define XR_CORE_VALIDATION_PROFILE_NAME "standard"
+#else
+#define XR_CORE_VALIDATION_PROFILE_NAME "full"
+#endif
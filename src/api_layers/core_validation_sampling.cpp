@@ -0,0 +1,143 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "core_validation_sampling.h"
+
+#include "command_patterns.h"
+
+#include <cstdlib>
+#include <vector>
+
+std::atomic<uint8_t> g_core_validation_command_policies[REFLECTION_COMMAND_COUNT] = {};
+std::atomic<uint8_t> g_core_validation_memoized_commands[REFLECTION_COMMAND_COUNT] = {};
+std::atomic<uint64_t> g_core_validation_validated_inputs[kCoreValidationValidatedInputSlots] = {};
+
+namespace {
+std::atomic<uint64_t> g_sample_limits[REFLECTION_COMMAND_COUNT] = {};
+std::atomic<uint64_t> g_sample_calls[REFLECTION_COMMAND_COUNT] = {};
+
+// The calls already validated by commands with the unique policy, as keys mixing the command with
+// the shape of the call.  0 marks an empty slot.  Once a call finds no room, it is validated.
+const size_t kUniqueCallSlots = 4096;
+const size_t kUniqueCallProbes = 16;
+std::atomic<uint64_t> g_unique_calls[kUniqueCallSlots] = {};
+
+// The patterns that each command class stands for.
+struct CommandClass {
+    const char* name;
+    const char* patterns;
+};
+const CommandClass kCommandClasses[] = {
+    {"@frame", "xrWaitFrame,xrBeginFrame,xrEndFrame,xrLocateViews,xr*SwapchainImage"},
+    {"@spaces", "xr*Space*"},
+    {"@actions", "xr*Action*,xr*HapticFeedback"},
+};
+
+bool MatchCommandOrClass(const std::string& pattern, const char* name) {
+    if (pattern[0] != '@') {
+        return MatchCommandPattern(pattern.c_str(), name);
+    }
+    for (const CommandClass& command_class : kCommandClasses) {
+        if (pattern == command_class.name) {
+            return MatchAnyCommandPattern(SplitCommandList(command_class.patterns), name);
+        }
+    }
+    return false;
+}
+
+bool FirstUniqueCall(ReflectionCommand command, uint64_t call_shape) {
+    uint64_t key = (call_shape ^ (static_cast<uint64_t>(command) + 1) * 0xC2B2AE3D27D4EB4FULL) | 1;
+    size_t start = static_cast<size_t>(key >> 32) % kUniqueCallSlots;
+    for (size_t probe = 0; probe < kUniqueCallProbes; ++probe) {
+        std::atomic<uint64_t>& slot = g_unique_calls[(start + probe) % kUniqueCallSlots];
+        uint64_t slot_key = slot.load(std::memory_order_relaxed);
+        if (slot_key == 0 && slot.compare_exchange_strong(slot_key, key, std::memory_order_relaxed)) {
+            return true;
+        }
+        if (slot_key == key) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+bool CoreValidationSampleCommand(ReflectionCommand command, uint64_t call_shape) {
+    uint8_t policy = g_core_validation_command_policies[command].load(std::memory_order_relaxed);
+    if (policy == CORE_VALIDATION_POLICY_UNIQUE) {
+        return FirstUniqueCall(command, call_shape);
+    }
+    uint64_t call = g_sample_calls[command].fetch_add(1, std::memory_order_relaxed);
+    uint64_t limit = g_sample_limits[command].load(std::memory_order_relaxed);
+    if (policy == CORE_VALIDATION_POLICY_EVERY_NTH) {
+        // The limit is only 0 while being reconfigured.
+        return limit == 0 || call % limit == 0;
+    }
+    return call < limit;
+}
+
+void CoreValidationConfigureCommandPolicies(const std::string& policies, const std::string& memoized) {
+    std::vector<std::string> entries = SplitCommandList(policies);
+    std::vector<std::string> memoized_patterns = SplitCommandList(memoized);
+
+    for (uint32_t command = 0; command < REFLECTION_COMMAND_COUNT; ++command) {
+        const char* name = g_reflection_command_names[command];
+        uint8_t policy = CORE_VALIDATION_POLICY_ALWAYS;
+        uint64_t limit = 0;
+        for (const std::string& entry : entries) {
+            size_t equals = entry.find('=');
+            if (equals == 0 || equals == std::string::npos || !MatchCommandOrClass(entry.substr(0, equals), name)) {
+                continue;
+            }
+            std::string rule = entry.substr(equals + 1);
+            if (rule == "always") {
+                policy = CORE_VALIDATION_POLICY_ALWAYS;
+                limit = 0;
+                continue;
+            }
+            if (rule == "unique") {
+                policy = CORE_VALIDATION_POLICY_UNIQUE;
+                limit = 0;
+                continue;
+            }
+            uint8_t rule_policy;
+            if (rule.compare(0, 6, "every:") == 0) {
+                rule_policy = CORE_VALIDATION_POLICY_EVERY_NTH;
+            } else if (rule.compare(0, 6, "first:") == 0) {
+                rule_policy = CORE_VALIDATION_POLICY_FIRST_N;
+            } else {
+                continue;
+            }
+            char* end = nullptr;
+            uint64_t count = std::strtoull(rule.c_str() + 6, &end, 10);
+            if (end == rule.c_str() + 6 || *end != '\0') {
+                continue;
+            }
+            if (rule_policy == CORE_VALIDATION_POLICY_EVERY_NTH && count <= 1) {
+                // Every call, or, for 0, taken as no sampling.
+                policy = CORE_VALIDATION_POLICY_ALWAYS;
+                limit = 0;
+            } else {
+                policy = rule_policy;
+                limit = count;
+            }
+        }
+        g_sample_limits[command].store(limit, std::memory_order_relaxed);
+        g_sample_calls[command].store(0, std::memory_order_relaxed);
+        g_core_validation_command_policies[command].store(policy, std::memory_order_relaxed);
+
+        bool memoize = false;
+        for (const std::string& pattern : memoized_patterns) {
+            memoize = memoize || MatchCommandOrClass(pattern, name);
+        }
+        g_core_validation_memoized_commands[command].store(memoize ? 1 : 0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t>& slot : g_unique_calls) {
+        slot.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t>& slot : g_core_validation_validated_inputs) {
+        slot.store(0, std::memory_order_relaxed);
+    }
+}
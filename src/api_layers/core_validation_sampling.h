@@ -0,0 +1,159 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "hex_and_handles.h"
+#include "xr_generated_core_validation.hpp"
+#include "xr_generated_reflection.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Chooses which calls of each command the layer validates.
+//
+// Every call is passed down the chain and the handles it creates and destroys are tracked, but the
+// inputs of a call are only validated when the policy of its command says so.  The policy of every
+// command is kept in one array, indexed by its ReflectionCommand, so validating every call is
+// a single load and branch.  Only sampled commands go on to count their calls.
+enum CoreValidationCommandPolicy : uint8_t {
+    CORE_VALIDATION_POLICY_ALWAYS = 0,
+    CORE_VALIDATION_POLICY_EVERY_NTH,  // Calls 0, N, 2N, ...
+    CORE_VALIDATION_POLICY_FIRST_N,    // Calls 0 to N - 1
+    CORE_VALIDATION_POLICY_UNIQUE,     // The first call with each combination of handles
+};
+
+extern std::atomic<uint8_t> g_core_validation_command_policies[REFLECTION_COMMAND_COUNT];
+
+// Counts a call of a sampled command, and returns whether to validate it.
+bool CoreValidationSampleCommand(ReflectionCommand command, uint64_t call_shape);
+
+inline bool CoreValidationShouldValidateCommand(ReflectionCommand command, uint64_t call_shape) {
+    return g_core_validation_command_policies[command].load(std::memory_order_relaxed) == CORE_VALIDATION_POLICY_ALWAYS ||
+           CoreValidationSampleCommand(command, call_shape);
+}
+
+// Combines the handles passed to a call into the value the unique policy tells calls apart by.
+inline uint64_t CoreValidationCallShape() { return 0; }
+
+template <typename HandleType, typename... Rest>
+inline uint64_t CoreValidationCallShape(HandleType handle, Rest... rest) {
+    return (CoreValidationCallShape(rest...) ^ MakeHandleGeneric(handle)) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Remembers the inputs that already passed validation, for the commands chosen to be memoized.
+//
+// The inputs of a call are hashed, handles by value along with the number of handles destroyed so
+// far, so that the same inputs are not validated again until any handle is destroyed.  Each hash
+// takes the slot picked by its low bits, replacing whatever was there.
+const size_t kCoreValidationValidatedInputSlots = 4096;
+
+extern std::atomic<uint8_t> g_core_validation_memoized_commands[REFLECTION_COMMAND_COUNT];
+extern std::atomic<uint64_t> g_core_validation_validated_inputs[kCoreValidationValidatedInputSlots];
+
+inline bool CoreValidationMemoizesCommand(ReflectionCommand command) {
+    return g_core_validation_memoized_commands[command].load(std::memory_order_relaxed) != 0;
+}
+
+inline bool CoreValidationInputsValidated(uint64_t input_hash) {
+    return g_core_validation_validated_inputs[input_hash % kCoreValidationValidatedInputSlots].load(std::memory_order_relaxed) ==
+           input_hash;
+}
+
+inline void CoreValidationRememberInputs(uint64_t input_hash) {
+    g_core_validation_validated_inputs[input_hash % kCoreValidationValidatedInputSlots].store(input_hash, std::memory_order_relaxed);
+}
+
+// Hashes the inputs of one call of a memoized command.
+//
+// Everything that validation reads goes in: values, the contents of the arrays and strings passed,
+// and the structures chained to the inputs.  Of the structures a call writes to, only the types of
+// the chain are validated, so only those go in.
+class CoreValidationInputHash {
+   public:
+    explicit CoreValidationInputHash(ReflectionCommand command) : hash_(0) {
+        AddWord(static_cast<uint64_t>(command));
+        AddWord(g_handle_generation.load(std::memory_order_acquire));
+    }
+
+    template <typename T>
+    void Add(const T& value) {
+        if (sizeof(T) <= sizeof(uint64_t)) {
+            uint64_t word = 0;
+            memcpy(&word, &value, sizeof(T) <= sizeof(uint64_t) ? sizeof(T) : sizeof(uint64_t));
+            AddWord(word);
+        } else {
+            AddBytes(&value, sizeof(T));
+        }
+    }
+
+    void AddBytes(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        AddWord(size);
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, bytes, sizeof(uint64_t));
+            AddWord(word);
+        }
+        if (size > 0) {
+            uint64_t word = 0;
+            memcpy(&word, bytes, size);
+            AddWord(word);
+        }
+    }
+
+    // Adds whether a pointer is null, and returns whether what it points to should be added.
+    bool AddPresence(const void* pointer) {
+        AddWord(pointer != nullptr ? 1 : 0);
+        return pointer != nullptr;
+    }
+
+    template <typename T>
+    void AddArray(const T* values, size_t count) {
+        if (AddPresence(values)) {
+            AddBytes(values, count * sizeof(T));
+        }
+    }
+
+    void AddString(const char* value) {
+        if (AddPresence(value)) {
+            AddBytes(value, strlen(value));
+        }
+    }
+
+    // Adds the type of a structure a call writes to, and those of the structures chained to it.
+    void AddChainTypes(const void* structure) {
+        for (auto chained = static_cast<const XrBaseInStructure*>(structure); chained != nullptr; chained = chained->next) {
+            Add(chained->type);
+        }
+        AddWord(0);
+    }
+
+    // Never 0, the value of an empty slot.
+    uint64_t Value() const { return (hash_ ^ (hash_ >> 31)) | 1; }
+
+   private:
+    void AddWord(uint64_t word) {
+        hash_ = (hash_ ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash_ ^= hash_ >> 32;
+    }
+
+    uint64_t hash_;
+};
+
+// Sets the policy of every command, and starts the sample counts over.
+//
+// policies is a comma separated list of pattern=always, pattern=every:N, pattern=first:N or
+// pattern=unique entries, such as "xrLocateSpace=every:100,@frame=first:10", applied in order, so a
+// later entry wins over an earlier one.  In a pattern, '*' matches any number of characters of a
+// command name and '?' any single one, and @frame, @spaces and @actions stand for the commands of
+// the frame loop, of spaces and of actions.  Malformed entries are ignored.
+//
+// memoized is a comma separated list of the patterns of the commands whose validated inputs are
+// remembered, such as "@frame,xrSyncActions".  Whatever was remembered before is forgotten.
+void CoreValidationConfigureCommandPolicies(const std::string& policies, const std::string& memoized);
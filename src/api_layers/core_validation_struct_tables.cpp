@@ -0,0 +1,748 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "core_validation_struct_tables.h"
+
+#include "core_validation_messages.h"
+#include "hex_and_handles.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if XR_CORE_VALIDATION_STRUCT_TABLES && XR_CORE_VALIDATION_CHECK_STRUCTS
+namespace {
+// The arguments of a call to CoreValidationValidateStruct, which every structure it validates shares.
+struct StructValidation {
+    GenValidUsageXrInstanceInfo* instance_info;
+    const char* command_name;
+    const GenValidUsageXrObjectInfoList& objects_info;
+    bool check_members;
+};
+
+const char* StructString(uint16_t offset) { return g_gen_valid_usage_struct_strings + offset; }
+
+const uint8_t* MemberAddress(const void* value, uint16_t offset) { return static_cast<const uint8_t*>(value) + offset; }
+
+// Members are read with memcpy, as the tables only know their offsets and sizes.
+template <typename T>
+T ReadMember(const void* value, uint16_t offset) {
+    T member;
+    std::memcpy(&member, MemberAddress(value, offset), sizeof(T));
+    return member;
+}
+
+std::string StructVuid(const GenValidUsageStructInfo& info, uint16_t member_name, const char* suffix) {
+    std::string vuid = "VUID-";
+    vuid += StructString(info.name);
+    vuid += "-";
+    vuid += StructString(member_name);
+    vuid += suffix;
+    return vuid;
+}
+
+// The messages are written by functions of their own, so that the checks of valid structures stay short.  Each
+// counts its message first, so that neither the VUID nor the message is formatted for a dropped repeat.
+CoreValidationMessageCount CountMember(const StructValidation& validation, const GenValidUsageStructInfo& info, uint16_t member_name,
+                                       const char* suffix) {
+    return CoreValidationCountMessage({"VUID-", StructString(info.name), "-", StructString(member_name), suffix},
+                                      validation.command_name, validation.objects_info);
+}
+
+void ReportMember(const StructValidation& validation, const GenValidUsageStructInfo& info, uint16_t member_name, const char* suffix,
+                  const std::string& message, const CoreValidationMessageCount& count) {
+    CoreValidLogCountedMessage(validation.instance_info, StructVuid(info, member_name, suffix).c_str(), VALID_USAGE_DEBUG_SEVERITY_ERROR,
+                               validation.command_name, validation.objects_info, message, count);
+}
+
+// Reports that a structure member, or one element of it if index is not negative, did not validate.
+void ReportInvalidStructMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                               const GenValidUsageStructMember& member, int64_t index) {
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::string error_message = "Structure ";
+    error_message += StructString(info.name);
+    error_message += " member ";
+    error_message += StructString(member.name);
+    if (index >= 0) {
+        error_message += "[";
+        error_message += std::to_string(index);
+        error_message += "]";
+    }
+    error_message += " is invalid";
+    ReportMember(validation, info, member.name, "-parameter", error_message, count);
+}
+
+// InvalidStructureType reports it with the VUID-<structure>-type-type VUID.
+void ReportInvalidChildType(const StructValidation& validation, const GenValidUsageStructInfo& base_info, XrStructureType type) {
+    InvalidStructureType(validation.instance_info, validation.command_name, validation.objects_info, StructString(base_info.name),
+                         type);
+}
+
+void ReportInvalidHandle(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                         const GenValidUsageStructMember& member, const void* handle) {
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::ostringstream oss;
+    oss << "Invalid " << StructString(member.type_name) << " handle \"" << StructString(member.name) << "\" ";
+    oss << Uint64ToHexString(ReadMember<uint64_t>(handle, 0));
+    ReportMember(validation, info, member.name, "-parameter", oss.str(), count);
+}
+
+#if XR_CORE_VALIDATION_CHECK_ENUMS
+void ReportInvalidEnum(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                       const GenValidUsageStructMember& member, const void* value) {
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::ostringstream oss_enum;
+    oss_enum << StructString(info.name) << " contains invalid " << StructString(member.type_name) << " \""
+             << StructString(member.name) << "\" enum value ";
+    oss_enum << Uint32ToHexString(ReadMember<uint32_t>(value, 0));
+    ReportMember(validation, info, member.name, "-parameter", oss_enum.str(), count);
+}
+#endif  // XR_CORE_VALIDATION_CHECK_ENUMS
+
+#if XR_CORE_VALIDATION_CHECK_FLAGS
+void ReportInvalidFlags(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                        const GenValidUsageStructMember& member, XrFlags64 flags, ValidateXrFlagsResult flags_result) {
+    if ((member.flags & GEN_VALID_USAGE_MEMBER_HAS_FLAG_VALUES) == 0 || VALIDATE_XR_FLAGS_ZERO == flags_result) {
+        const char* suffix = VALIDATE_XR_FLAGS_ZERO == flags_result ? "-requiredbitmask" : "-zerobitmask";
+        CoreValidationMessageCount count = CountMember(validation, info, member.name, suffix);
+        if (!count) {
+            return;
+        }
+        std::string error_message = StructString(member.type_name);
+        error_message += " \"";
+        error_message += StructString(member.name);
+        if (VALIDATE_XR_FLAGS_ZERO == flags_result) {
+            error_message += "\" flag must be non-zero";
+        } else {
+            error_message += "\" flag must be zero";
+        }
+        ReportMember(validation, info, member.name, suffix, error_message, count);
+        return;
+    }
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::ostringstream oss_enum;
+    oss_enum << StructString(info.name) << " invalid member " << StructString(member.type_name) << " \""
+             << StructString(member.name) << "\" flag value ";
+    oss_enum << Uint32ToHexString(static_cast<uint32_t>(flags));
+    oss_enum << " contains illegal bit";
+    ReportMember(validation, info, member.name, "-parameter", oss_enum.str(), count);
+}
+#endif  // XR_CORE_VALIDATION_CHECK_FLAGS
+
+#if XR_CORE_VALIDATION_CHECK_POINTERS
+void ReportNullMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                      const GenValidUsageStructMember& member) {
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::string error_message = StructString(info.name);
+    error_message += " contains invalid NULL for ";
+    error_message += StructString(member.type_name);
+    error_message += " \"";
+    error_message += StructString(member.name);
+    if ((member.flags & GEN_VALID_USAGE_MEMBER_IS_ARRAY) != 0) {
+        error_message += "\" is which not optional since \"";
+        error_message += StructString(member.other_name);
+        error_message += "\" is set and must be non-NULL";
+    } else {
+        error_message += "\" which is not optional and must be non-NULL";
+    }
+    ReportMember(validation, info, member.name, "-parameter", error_message, count);
+}
+
+void ReportInvalidCount(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                        const GenValidUsageStructMember& member) {
+    const bool optional = (member.flags & GEN_VALID_USAGE_MEMBER_OPTIONAL) != 0;
+    uint16_t vuid_member = optional ? member.other_name : member.name;
+    const char* suffix = optional ? "-parameter" : "-arraylength";
+    CoreValidationMessageCount count = CountMember(validation, info, vuid_member, suffix);
+    if (!count) {
+        return;
+    }
+    std::string error_message = "Structure ";
+    error_message += StructString(info.name);
+    error_message += " member ";
+    error_message += StructString(member.name);
+    if (optional) {
+        error_message += " is NULL, but value->";
+        error_message += StructString(member.name);
+        error_message += " is greater than 0";
+    } else {
+        error_message += " is non-optional and must be greater than 0";
+    }
+    ReportMember(validation, info, vuid_member, suffix, error_message, count);
+}
+#endif  // XR_CORE_VALIDATION_CHECK_POINTERS
+
+void ReportLongString(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                      const GenValidUsageStructMember& member) {
+    CoreValidationMessageCount count = CountMember(validation, info, member.name, "-parameter");
+    if (!count) {
+        return;
+    }
+    std::string error_message = "Structure ";
+    error_message += StructString(info.name);
+    error_message += " member ";
+    error_message += StructString(member.name);
+    error_message += " length is too long.";
+    ReportMember(validation, info, member.name, "-parameter", error_message, count);
+}
+
+#if XR_CORE_VALIDATION_CHECK_NEXT_CHAINS
+void ReportInvalidNextChain(const StructValidation& validation, const GenValidUsageStructInfo& info, NextChainResult next_result,
+                            const XrStructureType* valid_ext_structs, const GenValidUsageNextChainTypeSet& duplicate_ext_structs) {
+    const char* suffix = NEXT_CHAIN_RESULT_ERROR == next_result ? "-next-next" : "-next-unique";
+    CoreValidationMessageCount count =
+        CoreValidationCountMessage({"VUID-", StructString(info.name), suffix}, validation.command_name, validation.objects_info);
+    if (!count) {
+        return;
+    }
+    std::string error_message;
+    std::string vuid = "VUID-";
+    vuid += StructString(info.name);
+    vuid += suffix;
+    if (NEXT_CHAIN_RESULT_ERROR == next_result) {
+        error_message = "Invalid structure(s) in \"next\" chain for ";
+        error_message += StructString(info.name);
+        error_message += " struct \"next\"";
+    } else {
+        error_message = "Multiple structures of the same type(s) in \"next\" chain for ";
+        error_message += StructString(info.name);
+        error_message += " : ";
+        error_message +=
+            StructTypesToString(validation.instance_info, valid_ext_structs, info.related_count, duplicate_ext_structs);
+    }
+    CoreValidLogCountedMessage(validation.instance_info, vuid.c_str(), VALID_USAGE_DEBUG_SEVERITY_ERROR, validation.command_name,
+                               validation.objects_info, error_message, count);
+}
+#endif  // XR_CORE_VALIDATION_CHECK_NEXT_CHAINS
+
+// Returns the structure sharing the header of a base structure that has the given type, or
+// GEN_VALID_USAGE_STRUCT_COUNT if there is none built for this platform.
+GenValidUsageStruct FindChildStruct(const GenValidUsageStructInfo& base_info, XrStructureType type) {
+    for (uint16_t child = 0; child < base_info.related_count; ++child) {
+        GenValidUsageStruct child_id = g_gen_valid_usage_struct_children[base_info.first_related + child];
+        const GenValidUsageStructInfo& child_info = g_gen_valid_usage_struct_infos[child_id];
+        if (child_info.type == type && (child_info.flags & GEN_VALID_USAGE_STRUCT_AVAILABLE) != 0) {
+            return child_id;
+        }
+    }
+    return GEN_VALID_USAGE_STRUCT_COUNT;
+}
+
+// Checks that the extension of a structure used in place of its base structure is enabled.
+bool ChildStructExtensionEnabled(const StructValidation& validation, const GenValidUsageStructInfo& base_info,
+                                 const GenValidUsageStructInfo& child_info) {
+#if XR_CORE_VALIDATION_CHECK_EXTENSIONS
+    if (child_info.extension != GEN_VALID_USAGE_EXTENSION_COUNT && nullptr != validation.instance_info &&
+        !ExtensionEnabled(validation.instance_info->enabled_extensions, child_info.extension)) {
+        CoreValidationMessageCount count = CoreValidationCountMessage({"VUID-", StructString(base_info.name), "-type-type"},
+                                                                      validation.command_name, validation.objects_info);
+        if (!count) {
+            return false;
+        }
+        std::string error_str = StructString(base_info.name);
+        error_str += " being used with child struct type \"";
+        error_str += StructString(child_info.type_name);
+        error_str += "\" which requires extension \"";
+        error_str += StructString(child_info.extension_name);
+        error_str += "\" to be enabled, but it is not enabled";
+        std::string vuid = "VUID-";
+        vuid += StructString(base_info.name);
+        vuid += "-type-type";
+        CoreValidLogCountedMessage(validation.instance_info, vuid.c_str(), VALID_USAGE_DEBUG_SEVERITY_ERROR, validation.command_name,
+                                   validation.objects_info, error_str, count);
+        return false;
+    }
+#else
+    (void)validation;
+    (void)base_info;
+    (void)child_info;
+#endif  // XR_CORE_VALIDATION_CHECK_EXTENSIONS
+    return true;
+}
+
+XrResult ValidateStruct(const StructValidation& validation, GenValidUsageStruct struct_id, const void* value);
+
+// Validates a member, or an element of an array member, holding a structure that may be used in place of
+// its base structure.  Returns XR_SUCCESS, or the result to return from the structure holding it.
+XrResult ValidateBaseStructMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                  const GenValidUsageStructMember& member, const void* element, int64_t index,
+                                  XrResult* xr_result) {
+    const GenValidUsageStructInfo& base_info = g_gen_valid_usage_struct_infos[member.type_index];
+    XrStructureType type = ReadMember<XrStructureType>(element, 0);
+    GenValidUsageStruct child_id = FindChildStruct(base_info, type);
+    if (child_id == GEN_VALID_USAGE_STRUCT_COUNT) {
+        ReportInvalidChildType(validation, base_info, type);
+        ReportInvalidStructMember(validation, info, member, -1);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    *xr_result = ValidateStruct(validation, child_id, element);
+    if (XR_SUCCESS != *xr_result) {
+        ReportInvalidStructMember(validation, info, member, index);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    // The extension of the structure is only checked for members that are not arrays.
+    if (index < 0 && !ChildStructExtensionEnabled(validation, base_info, g_gen_valid_usage_struct_infos[child_id])) {
+        ReportInvalidStructMember(validation, info, member, -1);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    return XR_SUCCESS;
+}
+
+// The checks of one value of a member: the member itself, or one element of an array member.  Each returns
+// XR_SUCCESS, or the result to return from the structure holding it.
+inline XrResult ValidateHandleValue(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                    const GenValidUsageStructMember& member, const void* element) {
+    ValidateXrHandleResult handle_result = g_gen_valid_usage_handle_verifiers[member.type_index](element);
+    if (handle_result != VALIDATE_XR_HANDLE_SUCCESS &&
+        ((member.flags & GEN_VALID_USAGE_MEMBER_OPTIONAL) == 0 || handle_result == VALIDATE_XR_HANDLE_INVALID)) {
+        ReportInvalidHandle(validation, info, member, element);
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    return XR_SUCCESS;
+}
+
+#if XR_CORE_VALIDATION_CHECK_ENUMS
+inline XrResult ValidateEnumValue(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                  const GenValidUsageStructMember& member, const void* element) {
+    if (!g_gen_valid_usage_enum_validators[member.type_index](validation.instance_info, validation.command_name,
+                                                              StructString(info.name), StructString(member.name),
+                                                              validation.objects_info, element)) {
+        ReportInvalidEnum(validation, info, member, element);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    return XR_SUCCESS;
+}
+#endif  // XR_CORE_VALIDATION_CHECK_ENUMS
+
+#if XR_CORE_VALIDATION_CHECK_FLAGS
+inline XrResult ValidateFlagsValue(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                   const GenValidUsageStructMember& member, const void* element) {
+    XrFlags64 flags = ReadMember<XrFlags64>(element, 0);
+    ValidateXrFlagsResult flags_result = g_gen_valid_usage_flags_validators[member.type_index](flags);
+    bool invalid = (member.flags & GEN_VALID_USAGE_MEMBER_HAS_FLAG_VALUES) == 0
+                       ? VALIDATE_XR_FLAGS_ZERO != flags_result
+                       : VALIDATE_XR_FLAGS_INVALID == flags_result ||
+                             ((member.flags & GEN_VALID_USAGE_MEMBER_OPTIONAL) == 0 && VALIDATE_XR_FLAGS_ZERO == flags_result);
+    if (invalid) {
+        ReportInvalidFlags(validation, info, member, flags, flags_result);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    return XR_SUCCESS;
+}
+#endif  // XR_CORE_VALIDATION_CHECK_FLAGS
+
+inline XrResult ValidateStructValue(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                    const GenValidUsageStructMember& member, const void* element, int64_t index,
+                                    XrResult* xr_result) {
+    if ((g_gen_valid_usage_struct_infos[member.type_index].flags & GEN_VALID_USAGE_STRUCT_BASE) != 0) {
+        return ValidateBaseStructMember(validation, info, member, element, index, xr_result);
+    }
+    *xr_result = ValidateStruct(validation, static_cast<GenValidUsageStruct>(member.type_index), element);
+    if (XR_SUCCESS != *xr_result) {
+        ReportInvalidStructMember(validation, info, member, -1);
+        return *xr_result;
+    }
+    return XR_SUCCESS;
+}
+
+XrResult ValidateMemberValue(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                             const GenValidUsageStructMember& member, const void* element, int64_t index,
+                             XrResult* xr_result) {
+    switch (member.kind) {
+        case GEN_VALID_USAGE_MEMBER_HANDLE:
+            return ValidateHandleValue(validation, info, member, element);
+#if XR_CORE_VALIDATION_CHECK_ENUMS
+        case GEN_VALID_USAGE_MEMBER_ENUM:
+            return ValidateEnumValue(validation, info, member, element);
+#endif  // XR_CORE_VALIDATION_CHECK_ENUMS
+#if XR_CORE_VALIDATION_CHECK_FLAGS
+        case GEN_VALID_USAGE_MEMBER_FLAGS:
+            return ValidateFlagsValue(validation, info, member, element);
+#endif  // XR_CORE_VALIDATION_CHECK_FLAGS
+        case GEN_VALID_USAGE_MEMBER_STRUCT:
+            return ValidateStructValue(validation, info, member, element, index, xr_result);
+        default:
+            return XR_SUCCESS;
+    }
+}
+
+// The validators of whole members, as chosen by ValidateMember.  Each is given the structure holding the
+// member, and returns XR_SUCCESS, or the result to return from that structure.
+typedef XrResult (*MemberValidator)(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                    const GenValidUsageStructMember& member, const void* value, XrResult* xr_result);
+
+XrResult ValidateUncheckedMember(const StructValidation&, const GenValidUsageStructInfo&, const GenValidUsageStructMember&,
+                                 const void*, XrResult*) {
+    return XR_SUCCESS;
+}
+
+XrResult ValidateHandleMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                              const GenValidUsageStructMember& member, const void* value, XrResult*) {
+    return ValidateHandleValue(validation, info, member, MemberAddress(value, member.offset));
+}
+
+#if XR_CORE_VALIDATION_CHECK_ENUMS
+XrResult ValidateEnumMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                            const GenValidUsageStructMember& member, const void* value, XrResult*) {
+    return ValidateEnumValue(validation, info, member, MemberAddress(value, member.offset));
+}
+#endif  // XR_CORE_VALIDATION_CHECK_ENUMS
+
+#if XR_CORE_VALIDATION_CHECK_FLAGS
+XrResult ValidateFlagsMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                             const GenValidUsageStructMember& member, const void* value, XrResult*) {
+    return ValidateFlagsValue(validation, info, member, MemberAddress(value, member.offset));
+}
+#endif  // XR_CORE_VALIDATION_CHECK_FLAGS
+
+XrResult ValidateStructMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                              const GenValidUsageStructMember& member, const void* value, XrResult* xr_result) {
+    return ValidateStructValue(validation, info, member, MemberAddress(value, member.offset), -1, xr_result);
+}
+
+#if XR_CORE_VALIDATION_CHECK_POINTERS
+XrResult ValidateCountMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                             const GenValidUsageStructMember& member, const void* value, XrResult* xr_result) {
+    uint32_t array_count = ReadMember<uint32_t>(value, member.offset);
+    const void* array = ReadMember<const void*>(value, member.other_offset);
+    if ((member.flags & GEN_VALID_USAGE_MEMBER_OPTIONAL) != 0) {
+        if (0 != array_count && nullptr == array) {
+            ReportInvalidCount(validation, info, member);
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+    } else if (0 == array_count && nullptr != array) {
+        // The written out functions go on to check the other members in this case.
+        ReportInvalidCount(validation, info, member);
+        *xr_result = XR_ERROR_VALIDATION_FAILURE;
+    }
+    return XR_SUCCESS;
+}
+#endif  // XR_CORE_VALIDATION_CHECK_POINTERS
+
+XrResult ValidateStringMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                              const GenValidUsageStructMember& member, const void* value, XrResult*) {
+    if (member.other_offset < strlen(reinterpret_cast<const char*>(MemberAddress(value, member.offset)))) {
+        ReportLongString(validation, info, member);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    return XR_SUCCESS;
+}
+
+#if XR_CORE_VALIDATION_CHECK_EXTENSIONS
+XrResult ValidateExtensionsMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                  const GenValidUsageStructMember& member, const void* value, XrResult*) {
+    GenValidUsageExtensionSet enabled_extension_set = GenValidUsageExtensionSetFromNames(
+        ReadMember<uint32_t>(value, member.other_offset), ReadMember<const char* const*>(value, member.offset));
+    bool valid = (member.flags & GEN_VALID_USAGE_MEMBER_SYSTEM) != 0
+                     ? ValidateSystemExtensionDependencies(validation.instance_info, validation.command_name,
+                                                           StructString(info.name), validation.objects_info, enabled_extension_set)
+                     : ValidateInstanceExtensionDependencies(nullptr, validation.command_name, StructString(info.name),
+                                                             validation.objects_info, enabled_extension_set);
+    return valid ? XR_SUCCESS : XR_ERROR_VALIDATION_FAILURE;
+}
+#endif  // XR_CORE_VALIDATION_CHECK_EXTENSIONS
+
+// Checks a member that is a pointer or an array: that it is not NULL, then the value it points to, or the
+// value of each of its elements, in the order the written out validation functions do.
+XrResult ValidateIndirectMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                                const GenValidUsageStructMember& member, const void* value, XrResult* xr_result) {
+    const bool is_pointer = (member.flags & GEN_VALID_USAGE_MEMBER_IS_POINTER) != 0;
+    const bool is_array = (member.flags & GEN_VALID_USAGE_MEMBER_IS_ARRAY) != 0;
+    const void* pointer = is_pointer ? ReadMember<const void*>(value, member.offset) : nullptr;
+    uint32_t count = is_array ? ReadMember<uint32_t>(value, member.other_offset) : 0;
+
+#if XR_CORE_VALIDATION_CHECK_POINTERS
+    if ((member.flags & GEN_VALID_USAGE_MEMBER_CHECK_NULL) != 0 && nullptr == pointer && (!is_array || 0 != count)) {
+        ReportNullMember(validation, info, member);
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+#endif  // XR_CORE_VALIDATION_CHECK_POINTERS
+    if (GEN_VALID_USAGE_MEMBER_POINTER == member.kind) {
+        return XR_SUCCESS;
+    }
+
+    if (!is_array) {
+        if (is_pointer && nullptr == pointer) {
+            return XR_SUCCESS;
+        }
+        return ValidateMemberValue(validation, info, member, is_pointer ? pointer : MemberAddress(value, member.offset), -1,
+                                   xr_result);
+    }
+    if (nullptr == pointer) {
+        return XR_SUCCESS;
+    }
+    const bool pointer_elements = (member.flags & GEN_VALID_USAGE_MEMBER_POINTER_ELEMENTS) != 0;
+    for (uint32_t index = 0; index < count; ++index) {
+        const void* element = static_cast<const uint8_t*>(pointer) + static_cast<size_t>(index) * member.element_size;
+        if (pointer_elements) {
+            element = ReadMember<const void*>(element, 0);
+            if (nullptr == element) {
+                continue;
+            }
+        }
+        XrResult result = ValidateMemberValue(validation, info, member, element, index, xr_result);
+        if (XR_SUCCESS != result) {
+            return result;
+        }
+    }
+    return XR_SUCCESS;
+}
+
+// Members that are pointers, arrays or must not be NULL use the second half of the validators.
+const uint8_t kIndirectMemberFlags =
+    GEN_VALID_USAGE_MEMBER_IS_POINTER | GEN_VALID_USAGE_MEMBER_IS_ARRAY | GEN_VALID_USAGE_MEMBER_CHECK_NULL;
+const uint32_t kIndirectMemberValidators = 8;
+
+#if XR_CORE_VALIDATION_CHECK_ENUMS
+#define CORE_VALIDATION_ENUM_MEMBER_VALIDATOR ValidateEnumMember
+#else
+#define CORE_VALIDATION_ENUM_MEMBER_VALIDATOR ValidateUncheckedMember
+#endif  // XR_CORE_VALIDATION_CHECK_ENUMS
+#if XR_CORE_VALIDATION_CHECK_FLAGS
+#define CORE_VALIDATION_FLAGS_MEMBER_VALIDATOR ValidateFlagsMember
+#else
+#define CORE_VALIDATION_FLAGS_MEMBER_VALIDATOR ValidateUncheckedMember
+#endif  // XR_CORE_VALIDATION_CHECK_FLAGS
+#if XR_CORE_VALIDATION_CHECK_POINTERS
+#define CORE_VALIDATION_COUNT_MEMBER_VALIDATOR ValidateCountMember
+#else
+#define CORE_VALIDATION_COUNT_MEMBER_VALIDATOR ValidateUncheckedMember
+#endif  // XR_CORE_VALIDATION_CHECK_POINTERS
+#if XR_CORE_VALIDATION_CHECK_EXTENSIONS
+#define CORE_VALIDATION_EXTENSIONS_MEMBER_VALIDATOR ValidateExtensionsMember
+#else
+#define CORE_VALIDATION_EXTENSIONS_MEMBER_VALIDATOR ValidateUncheckedMember
+#endif  // XR_CORE_VALIDATION_CHECK_EXTENSIONS
+
+const MemberValidator g_member_validators[2 * kIndirectMemberValidators] = {
+    // Members holding their value, by GenValidUsageMemberKind
+    ValidateUncheckedMember,
+    ValidateHandleMember,
+    CORE_VALIDATION_ENUM_MEMBER_VALIDATOR,
+    CORE_VALIDATION_FLAGS_MEMBER_VALIDATOR,
+    ValidateStructMember,
+    CORE_VALIDATION_COUNT_MEMBER_VALIDATOR,
+    ValidateStringMember,
+    CORE_VALIDATION_EXTENSIONS_MEMBER_VALIDATOR,
+    // Pointers and arrays
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+    ValidateIndirectMember,
+};
+
+#undef CORE_VALIDATION_ENUM_MEMBER_VALIDATOR
+#undef CORE_VALIDATION_FLAGS_MEMBER_VALIDATOR
+#undef CORE_VALIDATION_COUNT_MEMBER_VALIDATOR
+#undef CORE_VALIDATION_EXTENSIONS_MEMBER_VALIDATOR
+
+inline XrResult ValidateMember(const StructValidation& validation, const GenValidUsageStructInfo& info,
+                               const GenValidUsageStructMember& member, const void* value, XrResult* xr_result) {
+    uint32_t validator = member.kind + ((member.flags & kIndirectMemberFlags) != 0 ? kIndirectMemberValidators : 0);
+    return g_member_validators[validator](validation, info, member, value, xr_result);
+}
+
+XrResult ValidateStruct(const StructValidation& validation, GenValidUsageStruct struct_id, const void* value) {
+    const GenValidUsageStructInfo& info = g_gen_valid_usage_struct_infos[struct_id];
+    if ((info.flags & GEN_VALID_USAGE_STRUCT_BASE) != 0) {
+        XrStructureType type = ReadMember<XrStructureType>(value, 0);
+        GenValidUsageStruct child_id = FindChildStruct(info, type);
+        if (child_id == GEN_VALID_USAGE_STRUCT_COUNT) {
+            ReportInvalidChildType(validation, info, type);
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+        if (!ChildStructExtensionEnabled(validation, info, g_gen_valid_usage_struct_infos[child_id])) {
+            return XR_ERROR_VALIDATION_FAILURE;
+        }
+        return ValidateStruct(validation, child_id, value);
+    }
+
+    XrResult xr_result = XR_SUCCESS;
+    if ((info.flags & GEN_VALID_USAGE_STRUCT_CHECK_TYPE) != 0) {
+        XrStructureType type = ReadMember<XrStructureType>(value, 0);
+        if (type != info.type) {
+            InvalidStructureType(validation.instance_info, validation.command_name, validation.objects_info,
+                                 StructString(info.name), type, nullptr, info.type, StructString(info.type_name));
+            xr_result = XR_ERROR_VALIDATION_FAILURE;
+        }
+    }
+#if XR_CORE_VALIDATION_CHECK_NEXT_CHAINS
+    const void* next = (info.flags & GEN_VALID_USAGE_STRUCT_CHECK_NEXT) != 0
+                           ? ReadMember<const void*>(value, offsetof(XrBaseInStructure, next))
+                           : nullptr;
+    // An empty chain is always valid.
+    if (nullptr != next) {
+        const XrStructureType* valid_ext_structs =
+            info.related_count != 0 ? &g_gen_valid_usage_next_types[info.first_related] : nullptr;
+        GenValidUsageNextChainTypeSet duplicate_ext_structs;
+        NextChainResult next_result = ValidateNextChain(validation.instance_info, validation.command_name, validation.objects_info,
+                                                        next, valid_ext_structs, info.related_count, duplicate_ext_structs);
+        // Duplicates can only be found among the structures that may be in the chain.
+        if (NEXT_CHAIN_RESULT_ERROR == next_result ||
+            (NEXT_CHAIN_RESULT_DUPLICATE_STRUCT == next_result && info.related_count != 0)) {
+            ReportInvalidNextChain(validation, info, next_result, valid_ext_structs, duplicate_ext_structs);
+            xr_result = XR_ERROR_VALIDATION_FAILURE;
+        }
+    }
+#endif  // XR_CORE_VALIDATION_CHECK_NEXT_CHAINS
+    // If we are not to check the rest of the members, just return here.
+    if (!validation.check_members || XR_SUCCESS != xr_result) {
+        return xr_result;
+    }
+
+    // The last few members are each checked from a call of their own, rather than from the loop, which lets
+    // the processor predict each of those calls from where it is made.
+    const GenValidUsageStructMember* const members_end = info.members + info.member_count;
+    const GenValidUsageStructMember* member = info.members;
+    for (; members_end - member > 4; ++member) {
+        XrResult result = ValidateMember(validation, info, *member, value, &xr_result);
+        if (XR_SUCCESS != result) {
+            return result;
+        }
+    }
+    XrResult result = XR_SUCCESS;
+    switch (members_end - member) {
+        case 4:
+            result = ValidateMember(validation, info, members_end[-4], value, &xr_result);
+            if (XR_SUCCESS != result) {
+                break;
+            }
+            // fall through
+        case 3:
+            result = ValidateMember(validation, info, members_end[-3], value, &xr_result);
+            if (XR_SUCCESS != result) {
+                break;
+            }
+            // fall through
+        case 2:
+            result = ValidateMember(validation, info, members_end[-2], value, &xr_result);
+            if (XR_SUCCESS != result) {
+                break;
+            }
+            // fall through
+        case 1:
+            result = ValidateMember(validation, info, members_end[-1], value, &xr_result);
+            break;
+        default:
+            break;
+    }
+    return XR_SUCCESS != result ? result : xr_result;
+}
+}  // namespace
+
+XrResult CoreValidationValidateStruct(GenValidUsageXrInstanceInfo* instance_info, const char* command_name,
+                                      const GenValidUsageXrObjectInfoList& objects_info, bool check_members,
+                                      GenValidUsageStruct struct_id, const void* value) {
+    const StructValidation validation{instance_info, command_name, objects_info, check_members};
+    return ValidateStruct(validation, struct_id, value);
+}
+#endif  // XR_CORE_VALIDATION_STRUCT_TABLES && XR_CORE_VALIDATION_CHECK_STRUCTS
+
+#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+namespace {
+enum StructEngine {
+    STRUCT_ENGINE_TABLES,
+    STRUCT_ENGINE_UNROLLED,
+    STRUCT_ENGINE_COMPARE,
+};
+std::atomic<int> g_struct_engine{STRUCT_ENGINE_TABLES};
+
+// The IDs of the messages reported on this thread while it compares the engines, or NULL.
+thread_local std::vector<std::string>* t_captured_message_ids = nullptr;
+
+#if XR_CORE_VALIDATION_CHECK_STRUCTS
+std::string DescribeStructResult(XrResult result, const std::vector<std::string>& message_ids) {
+    std::string description = std::to_string(static_cast<int32_t>(result));
+    description += " (";
+    for (size_t id = 0; id < message_ids.size(); ++id) {
+        if (id > 0) {
+            description += ", ";
+        }
+        description += message_ids[id];
+    }
+    description += ")";
+    return description;
+}
+#endif  // XR_CORE_VALIDATION_CHECK_STRUCTS
+}  // namespace
+
+void CoreValidationConfigureStructEngine(const std::string& engine) {
+    if (engine == "unrolled") {
+        g_struct_engine.store(STRUCT_ENGINE_UNROLLED, std::memory_order_relaxed);
+    } else if (engine == "compare") {
+        g_struct_engine.store(STRUCT_ENGINE_COMPARE, std::memory_order_relaxed);
+    } else {
+        g_struct_engine.store(STRUCT_ENGINE_TABLES, std::memory_order_relaxed);
+    }
+}
+
+bool CoreValidationCaptureStructMessage(const char* message_id) {
+    if (nullptr == t_captured_message_ids) {
+        return false;
+    }
+    t_captured_message_ids->emplace_back(message_id);
+    return true;
+}
+
+#if XR_CORE_VALIDATION_CHECK_STRUCTS
+XrResult CoreValidationValidateStructWithEngine(GenValidUsageXrInstanceInfo* instance_info, const char* command_name,
+                                                const GenValidUsageXrObjectInfoList& objects_info, bool check_members,
+                                                GenValidUsageStruct struct_id, const void* value,
+                                                GenValidUsageUnrolledValidator unrolled) {
+    int engine = g_struct_engine.load(std::memory_order_relaxed);
+    if (engine == STRUCT_ENGINE_UNROLLED) {
+        return unrolled(instance_info, command_name, objects_info, check_members, value);
+    }
+    // Structures validated by the next chains of a comparison are compared as part of it.
+    if (engine == STRUCT_ENGINE_TABLES || nullptr != t_captured_message_ids) {
+        return CoreValidationValidateStruct(instance_info, command_name, objects_info, check_members, struct_id, value);
+    }
+
+    std::vector<std::string> unrolled_ids;
+    std::vector<std::string> table_ids;
+    t_captured_message_ids = &unrolled_ids;
+    XrResult unrolled_result = unrolled(instance_info, command_name, objects_info, check_members, value);
+    t_captured_message_ids = &table_ids;
+    XrResult table_result = CoreValidationValidateStruct(instance_info, command_name, objects_info, check_members, struct_id, value);
+    t_captured_message_ids = nullptr;
+    const char* mismatch_id = "CoreValidation-struct-tables-mismatch";
+    CoreValidationMessageCount count{false, 0};
+    if ((unrolled_result != table_result || unrolled_ids != table_ids) &&
+        (count = CoreValidationCountMessage(mismatch_id, command_name, objects_info))) {
+        std::string error_message = "Validating ";
+        error_message += StructString(g_gen_valid_usage_struct_infos[struct_id].name);
+        error_message += " with tables gave ";
+        error_message += DescribeStructResult(table_result, table_ids);
+        error_message += ", but the unrolled functions gave ";
+        error_message += DescribeStructResult(unrolled_result, unrolled_ids);
+        CoreValidLogCountedMessage(instance_info, mismatch_id, VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name, objects_info,
+                                   error_message, count);
+    }
+    return CoreValidationValidateStruct(instance_info, command_name, objects_info, check_members, struct_id, value);
+}
+#endif  // XR_CORE_VALIDATION_CHECK_STRUCTS
+#endif  // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
@@ -0,0 +1,144 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "core_validation_profile.h"
+#include "validation_utils.h"
+#include "xr_generated_core_validation.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Validates structures by walking tables that describe their members, a smaller but slower layer that
+// a build chooses with XR_CORE_VALIDATION_STRUCT_TABLES, set by the CORE_VALIDATION_STRUCT_TABLES CMake
+// option.  Otherwise the generator writes out a function for each structure, ValidateXrStructUnrolled.
+//
+// The generator describes each structure with a GenValidUsageStructInfo, and each member with checks
+// with a GenValidUsageStructMember, giving its offset, what to check and where its array length is.
+// Every generated ValidateXrStruct overload then passes its structure to CoreValidationValidateStruct,
+// which makes the same checks, in the same order and with the same messages, as the written out
+// functions, in a fraction of the code.  Names are offsets into one string table, so that the tables
+// hold no pointers to relocate, apart from the member list of each structure.
+//
+// With XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES, set by the CORE_VALIDATION_COMPARE_STRUCT_TABLES CMake
+// option, the layer has both, and the environmental variable XR_CORE_VALIDATION_STRUCT_ENGINE chooses
+// which of the two validate structures.
+#ifndef XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+#define XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES 0
+#endif
+
+#ifndef XR_CORE_VALIDATION_STRUCT_TABLES
+#define XR_CORE_VALIDATION_STRUCT_TABLES XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+#endif
+
+// Whether the written out functions are built.
+#define XR_CORE_VALIDATION_UNROLLED_STRUCTS (!XR_CORE_VALIDATION_STRUCT_TABLES || XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES)
+
+// What is checked of the value of a member, or of each element of an array member.
+enum GenValidUsageMemberKind : uint8_t {
+    GEN_VALID_USAGE_MEMBER_POINTER = 0,  // Only that the pointer is not NULL
+    GEN_VALID_USAGE_MEMBER_HANDLE,       // A valid handle
+    GEN_VALID_USAGE_MEMBER_ENUM,         // A valid enum value
+    GEN_VALID_USAGE_MEMBER_FLAGS,        // Only valid flag bits
+    GEN_VALID_USAGE_MEMBER_STRUCT,       // A valid structure
+    GEN_VALID_USAGE_MEMBER_COUNT,        // The length of an array member
+    GEN_VALID_USAGE_MEMBER_STRING,       // A string short enough for its fixed size array
+    GEN_VALID_USAGE_MEMBER_EXTENSIONS,   // The names of the extensions to enable, whose dependencies must be enabled too
+};
+
+enum GenValidUsageMemberFlagBits : uint8_t {
+    GEN_VALID_USAGE_MEMBER_OPTIONAL = 0x01,
+    GEN_VALID_USAGE_MEMBER_IS_POINTER = 0x02,        // Points to the value, or to the elements of an array
+    GEN_VALID_USAGE_MEMBER_IS_ARRAY = 0x04,          // Has a length member
+    GEN_VALID_USAGE_MEMBER_POINTER_ELEMENTS = 0x08,  // The elements of the array are pointers
+    GEN_VALID_USAGE_MEMBER_CHECK_NULL = 0x10,        // Must not be NULL, or not while its length is not 0
+    GEN_VALID_USAGE_MEMBER_HAS_FLAG_VALUES = 0x20,   // The flags type defines bits
+    GEN_VALID_USAGE_MEMBER_SYSTEM = 0x40,            // The extensions are system extensions, not instance ones
+};
+
+// A member with checks.  The names are offsets into g_gen_valid_usage_struct_strings.
+struct GenValidUsageStructMember {
+    uint16_t name;
+    uint16_t type_name;
+    // The member holding the length of an array, or the array of a length member.
+    uint16_t other_name;
+    uint16_t offset;
+    // The offset of the member holding the length of an array, the offset of the array of a length
+    // member, the length of the array of a string, or the offset of the extension count.
+    uint16_t other_offset;
+    uint16_t element_size;
+    // The GenValidUsageStruct of a structure, or the index of the function checking a handle, enum or flags.
+    uint16_t type_index;
+    uint8_t kind;
+    uint8_t flags;
+};
+
+enum GenValidUsageStructFlagBits : uint8_t {
+    GEN_VALID_USAGE_STRUCT_AVAILABLE = 0x01,  // Built for this platform, so its members are described
+    GEN_VALID_USAGE_STRUCT_BASE = 0x02,       // The base of a group of structures that share its header
+    GEN_VALID_USAGE_STRUCT_CHECK_TYPE = 0x04,
+    GEN_VALID_USAGE_STRUCT_CHECK_NEXT = 0x08,
+};
+
+// A structure, indexed by its GenValidUsageStruct.  The names are offsets into g_gen_valid_usage_struct_strings.
+struct GenValidUsageStructInfo {
+    const GenValidUsageStructMember *members;
+    uint16_t name;
+    uint16_t type_name;
+    XrStructureType type;
+    uint16_t member_count;
+    uint16_t size;
+    // The structures that may be in the next chain, in g_gen_valid_usage_next_types, or the structures
+    // that share the header of a base structure, in g_gen_valid_usage_struct_children.
+    uint16_t first_related;
+    uint16_t related_count;
+    GenValidUsageExtension extension;
+    uint16_t extension_name;
+    uint8_t flags;
+};
+
+typedef ValidateXrHandleResult (*GenValidUsageHandleVerifier)(const void *handle);
+typedef bool (*GenValidUsageEnumValidator)(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                                           const char *validation_name, const char *item_name,
+                                           const GenValidUsageXrObjectInfoList &objects_info, const void *value);
+typedef ValidateXrFlagsResult (*GenValidUsageFlagsValidator)(const XrFlags64 value);
+
+extern const char g_gen_valid_usage_struct_strings[];
+extern const GenValidUsageStructInfo g_gen_valid_usage_struct_infos[GEN_VALID_USAGE_STRUCT_COUNT];
+extern const XrStructureType g_gen_valid_usage_next_types[];
+extern const GenValidUsageStruct g_gen_valid_usage_struct_children[];
+extern const GenValidUsageHandleVerifier g_gen_valid_usage_handle_verifiers[];
+extern const GenValidUsageEnumValidator g_gen_valid_usage_enum_validators[];
+extern const GenValidUsageFlagsValidator g_gen_valid_usage_flags_validators[];
+
+#if XR_CORE_VALIDATION_STRUCT_TABLES && XR_CORE_VALIDATION_CHECK_STRUCTS
+// Validates a structure, and its members if check_members is set, as the ValidateXrStruct overloads do.
+XrResult CoreValidationValidateStruct(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                                      const GenValidUsageXrObjectInfoList &objects_info, bool check_members,
+                                      GenValidUsageStruct struct_id, const void *value);
+#endif  // XR_CORE_VALIDATION_STRUCT_TABLES && XR_CORE_VALIDATION_CHECK_STRUCTS
+
+#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
+typedef XrResult (*GenValidUsageUnrolledValidator)(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                                                    const GenValidUsageXrObjectInfoList &objects_info, bool check_members,
+                                                    const void *value);
+
+#if XR_CORE_VALIDATION_CHECK_STRUCTS
+// Validates a structure with the engine chosen by XR_CORE_VALIDATION_STRUCT_ENGINE: "tables", the default,
+// "unrolled", or "compare", which validates it with both, reports any difference in their results or in
+// the IDs of their messages, and then reports the messages of the tables.
+XrResult CoreValidationValidateStructWithEngine(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                                                const GenValidUsageXrObjectInfoList &objects_info, bool check_members,
+                                                GenValidUsageStruct struct_id, const void *value,
+                                                GenValidUsageUnrolledValidator unrolled);
+#endif  // XR_CORE_VALIDATION_CHECK_STRUCTS
+
+// Chooses the engine from the value of XR_CORE_VALIDATION_STRUCT_ENGINE.
+void CoreValidationConfigureStructEngine(const std::string &engine);
+
+// Returns true if the message was taken by a comparison of the engines, and so is not to be reported.
+bool CoreValidationCaptureStructMessage(const char *message_id);
+#endif  // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES
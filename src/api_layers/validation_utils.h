@@ -24,14 +24,17 @@
 #ifndef VALIDATION_UTILS_H_
 #define VALIDATION_UTILS_H_ 1
 
+#include "allocation_callbacks.h"
 #include "api_layer_platform_defines.h"
+#include "concurrent_handle_registry.h"
 #include "hex_and_handles.h"
-#include "extra_algorithms.h"
 #include "object_info.h"
 
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
+#include <atomic>
+#include <bitset>
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -48,6 +51,7 @@
 
 // Debug Utils items
 struct CoreValidationMessengerInfo {
+    XR_SDK_ALLOCATION_OPERATORS
     XrDebugUtilsMessengerEXT messenger;
     XrDebugUtilsMessengerCreateInfoEXT *create_info;
 };
@@ -56,7 +60,7 @@ struct XrGeneratedDispatchTable;
 
 struct CoreValidationMessengerInfoDeleter {
     void operator()(CoreValidationMessengerInfo *ptr) const {
-        delete ptr->create_info;
+        XrSdkDeleter<XrDebugUtilsMessengerCreateInfoEXT>()(ptr->create_info);
         delete ptr;
     }
 };
@@ -72,30 +76,42 @@ typedef std::unique_ptr<XrDebugUtilsObjectNameInfoEXT, XrDebugUtilsObjectNameInf
 
 typedef std::unique_ptr<CoreValidationMessengerInfo, CoreValidationMessengerInfoDeleter> UniqueCoreValidationMessengerInfo;
 
+// The set of enabled extensions, indexed by the GenValidUsageExtension identifiers generated from the registry.
+// The generator checks that every extension in the registry fits.
+typedef std::bitset<256> GenValidUsageExtensionSet;
+
+// A set of the structures in a next chain, as bits indexed by their position in the table of the structures that may
+// extend the parent structure.  The generator checks that every table fits.
+typedef std::bitset<64> GenValidUsageNextChainTypeSet;
+
 // Define the instance struct used for passing information around.
 // This information includes things like the dispatch table as well as the
 // enabled extensions.
 struct GenValidUsageXrInstanceInfo {
+    XR_SDK_ALLOCATION_OPERATORS
     GenValidUsageXrInstanceInfo(XrInstance inst, PFN_xrGetInstanceProcAddr next_get_instance_proc_addr);
     ~GenValidUsageXrInstanceInfo();
     XrInstance const instance;
-    XrGeneratedDispatchTable *dispatch_table;
-    std::vector<std::string> enabled_extensions;
-    std::vector<UniqueCoreValidationMessengerInfo> debug_messengers;
+    XrSdkUniquePtr<XrGeneratedDispatchTable> dispatch_table;
+    GenValidUsageExtensionSet enabled_extensions;
+    XrSdkVector<UniqueCoreValidationMessengerInfo> debug_messengers;
     DebugUtilsData debug_data;
 };
 
 // Structure used for storing information for other handles
 struct GenValidUsageXrHandleInfo {
+    XR_SDK_ALLOCATION_OPERATORS
     GenValidUsageXrInstanceInfo *instance_info;
     XrObjectType direct_parent_type;
     uint64_t direct_parent_handle;
+    // The info of the direct parent, which owns this handle in the handle maps.
+    const void *direct_parent_info;
 };
 
 // Structure used for storing session label information
 struct GenValidUsageXrInternalSessionLabel {
     XrDebugUtilsLabelEXT debug_utils_label;
-    std::string label_name;
+    XrSdkString label_name;
     bool is_individual_label;
 };
 
@@ -106,6 +122,13 @@ enum ValidateXrHandleResult {
     VALIDATE_XR_HANDLE_SUCCESS,
 };
 
+// Structure used for indicating status of 'flags' test.
+enum ValidateXrFlagsResult {
+    VALIDATE_XR_FLAGS_ZERO,
+    VALIDATE_XR_FLAGS_INVALID,
+    VALIDATE_XR_FLAGS_SUCCESS,
+};
+
 // Unordered Map associating pointer to a vector of session label information to a session's handle
 extern std::unordered_map<XrSession, std::vector<GenValidUsageXrInternalSessionLabel *> *> g_xr_session_labels;
 
@@ -121,6 +144,30 @@ struct GenValidUsageXrObjectInfo {
     GenValidUsageXrObjectInfo(T h, XrObjectType t) : handle(MakeHandleGeneric(h)), type(t) {}
 };
 
+// The objects a message is about, which are the handle parameters of the command being validated.
+// No command takes more than a few handles, so they are kept inline, without allocating; the
+// generator checks that max_size is enough for every command.
+class GenValidUsageXrObjectInfoList {
+   public:
+    static const size_t max_size = 4;
+
+    template <typename T>
+    void emplace_back(T handle, XrObjectType type) {
+        if (count_ < max_size) {
+            objects_[count_++] = GenValidUsageXrObjectInfo(handle, type);
+        }
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    const GenValidUsageXrObjectInfo *begin() const { return objects_; }
+    const GenValidUsageXrObjectInfo *end() const { return objects_ + count_; }
+
+   private:
+    GenValidUsageXrObjectInfo objects_[max_size];
+    size_t count_ = 0;
+};
+
 // Debug message severity levels for logging.
 enum GenValidUsageDebugSeverity {
     VALID_USAGE_DEBUG_SEVERITY_DEBUG = 0,
@@ -129,17 +176,30 @@ enum GenValidUsageDebugSeverity {
     VALID_USAGE_DEBUG_SEVERITY_ERROR = 21,
 };
 
-// in core_validation.cpp
-void EraseAllInstanceTableMapElements(GenValidUsageXrInstanceInfo *search_value);
-
 typedef std::unique_lock<std::mutex> UniqueLock;
+
+/// The info that owns a handle info in the handle maps: that of its direct parent, or itself for an instance.
+inline const void *HandleInfoOwner(const GenValidUsageXrInstanceInfo *info) { return info; }
+inline const void *HandleInfoOwner(const GenValidUsageXrHandleInfo *info) { return info->direct_parent_info; }
+
+/// The number of handles erased so far, which tells apart the calls made before and after a handle
+/// was destroyed, when the value of the handle might have been reused.
+extern std::atomic<uint64_t> g_handle_generation;
+
+/// The information kept for each handle of one type.
+///
+/// Lookups take no lock and only write to a record of their own thread, so validating calls on the
+/// same handles from any number of threads does not contend, and the children of a handle can be
+/// removed without looking at any other handles; see ConcurrentHandleRegistry.  An info is deleted as soon as its handle is erased, which OpenXR's
+/// external synchronization rules keep from happening while another thread uses the handle.
 template <typename HandleType, typename InfoType>
 class HandleInfoBase {
    public:
     typedef InfoType info_t;
     typedef HandleType handle_t;
-    typedef std::unordered_map<HandleType, std::unique_ptr<InfoType>> map_t;
-    typedef typename map_t::value_type value_t;
+
+    HandleInfoBase() = default;
+    ~HandleInfoBase();
 
     /// Validate a handle.
     ///
@@ -151,9 +211,10 @@ class HandleInfoBase {
     InfoType *get(HandleType handle);
 
     /// Lookup a handle, returning a pointer (if found) as well as a lock for this object's dispatch mutex.
+    /// The lock keeps the info from being erased, and serializes changes to its contents.
     std::pair<UniqueLock, InfoType *> getWithLock(HandleType handle);
 
-    bool empty() const { return info_map_.empty(); }
+    bool empty() const { return info_map_.Empty(); }
 
     /// Insert an info for the supplied handle.
     /// Throws if it's already there.
@@ -163,14 +224,15 @@ class HandleInfoBase {
     /// Throws if not found.
     void erase(HandleType handle);
 
-    /// Get a constant reference to the whole map as well as a lock for this object's dispatch mutex.
-    std::pair<UniqueLock, map_t const &> lockMapConst();
+    /// Removes the handles whose direct parent has the supplied info, first passing the info of each
+    /// to clean_up_children, if not null, to remove their own children.
+    void removeHandlesForParent(const void *parent_info, void (*clean_up_children)(const void *info));
 
-    /// Get a  reference to the whole map as well as a lock for this object's dispatch mutex.
-    std::pair<UniqueLock, map_t &> lockMap();
+    /// Free the tables the map replaced as it grew that threads were still reading when it last changed.
+    void releaseRetiredTables() { info_map_.ReleaseRetiredTables(); }
 
    protected:
-    map_t info_map_;
+    ConcurrentHandleRegistry<HandleType, InfoType> info_map_;
     std::mutex dispatch_mutex_;
 };
 
@@ -193,33 +255,28 @@ class HandleInfo : public HandleInfoBase<HandleType, GenValidUsageXrHandleInfo>
     /// Lookup a handle and its instance info
     /// Throws if not found.
     std::pair<GenValidUsageXrHandleInfo *, GenValidUsageXrInstanceInfo *> getWithInstanceInfo(HandleType handle);
-
-    /// Removes handles associated  with an instance.
-    void removeHandlesForInstance(GenValidUsageXrInstanceInfo *search_value);
 };
 
-/// Function to record all the core validation information
-void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::string &message_id,
-                         GenValidUsageDebugSeverity message_severity, const std::string &command_name,
-                         std::vector<GenValidUsageXrObjectInfo> objects_info, const std::string &message);
+/// Function to record all the core validation information.  Only for messages that need no formatting: the
+/// others are counted with CoreValidationCountMessage before they are formatted.
+void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,
+                         GenValidUsageDebugSeverity message_severity, const char *command_name,
+                         const GenValidUsageXrObjectInfoList &objects_info, const char *message);
 
-void InvalidStructureType(GenValidUsageXrInstanceInfo *instance_info, const std::string &command_name,
-                          std::vector<GenValidUsageXrObjectInfo> &objects_info, const char *structure_name, XrStructureType type,
+void InvalidStructureType(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,
+                          const GenValidUsageXrObjectInfoList &objects_info, const char *structure_name, XrStructureType type,
                           const char *vuid = nullptr, XrStructureType expected = XrStructureType(0),
                           const char *expected_name = "");
 
-std::string StructTypesToString(GenValidUsageXrInstanceInfo *instance_info, const std::vector<XrStructureType> &structs);
+// Returns the names of the structure types in the table that are in the set, separated by commas.
+std::string StructTypesToString(GenValidUsageXrInstanceInfo *instance_info, const XrStructureType *types, size_t type_count,
+                                const GenValidUsageNextChainTypeSet &type_set);
 
 // -- Only implementations of templates follow --//
 
-template <typename HT, typename IT>
-inline std::pair<UniqueLock, typename HandleInfoBase<HT, IT>::map_t const &> HandleInfoBase<HT, IT>::lockMapConst() {
-    return {UniqueLock(dispatch_mutex_), info_map_};
-}
-
-template <typename HT, typename IT>
-inline std::pair<UniqueLock, typename HandleInfoBase<HT, IT>::map_t &> HandleInfoBase<HT, IT>::lockMap() {
-    return {UniqueLock(dispatch_mutex_), info_map_};
+template <typename HandleType, typename InfoType>
+inline HandleInfoBase<HandleType, InfoType>::~HandleInfoBase() {
+    info_map_.ForEach([](HandleType, InfoType *info) { delete info; });
 }
 
 template <typename HandleType, typename InfoType>
@@ -235,10 +292,7 @@ inline ValidateXrHandleResult HandleInfoBase<HandleType, InfoType>::verifyHandle
         }
 
         // Try to find the handle in the appropriate map
-        UniqueLock lock(dispatch_mutex_);
-        auto entry_returned = info_map_.find(*handle_to_check);
-        // If it is not a valid handle, it should return the end of the map.
-        if (info_map_.end() == entry_returned) {
+        if (nullptr == info_map_.Find(*handle_to_check)) {
             return VALIDATE_XR_HANDLE_INVALID;
         }
         return VALIDATE_XR_HANDLE_SUCCESS;
@@ -253,12 +307,11 @@ inline InfoType *HandleInfoBase<HandleType, InfoType>::get(HandleType handle) {
         reportInternalError("Null handle passed to HandleInfoBase::get()");
     }
     // Try to find the handle in the appropriate map
-    UniqueLock lock(dispatch_mutex_);
-    auto entry_returned = info_map_.find(handle);
-    if (entry_returned == info_map_.end()) {
+    InfoType *info = info_map_.Find(handle);
+    if (nullptr == info) {
         reportInternalError("Handle passed to HandleInfoBase::insert() not inserted");
     }
-    return entry_returned->second.get();
+    return info;
 }
 
 template <typename HandleType, typename InfoType>
@@ -268,12 +321,8 @@ inline std::pair<UniqueLock, InfoType *> HandleInfoBase<HandleType, InfoType>::g
     }
     // Try to find the handle in the appropriate map
     UniqueLock lock(dispatch_mutex_);
-    auto it = info_map_.find(handle);
-    // If it is not a valid handle, it should return the end of the map.
-    if (info_map_.end() == it) {
-        return {std::move(lock), nullptr};
-    }
-    return {std::move(lock), it->second.get()};
+    InfoType *info = info_map_.Find(handle);
+    return {std::move(lock), info};
 }
 
 template <typename HandleType, typename InfoType>
@@ -282,11 +331,11 @@ inline void HandleInfoBase<HandleType, InfoType>::insert(HandleType handle, std:
         reportInternalError("Null handle passed to HandleInfoBase::insert()");
     }
     UniqueLock lock(dispatch_mutex_);
-    auto entry_returned = info_map_.find(handle);
-    if (entry_returned != info_map_.end()) {
+    if (nullptr != info_map_.Find(handle)) {
         reportInternalError("Handle passed to HandleInfoBase::insert() already inserted");
     }
-    info_map_[handle] = std::move(info);
+    const void *owner = HandleInfoOwner(info.get());
+    info_map_.Insert(handle, info.release(), owner);
 }
 
 template <typename HandleType, typename InfoType>
@@ -295,11 +344,11 @@ inline void HandleInfoBase<HandleType, InfoType>::erase(HandleType handle) {
         reportInternalError("Null handle passed to HandleInfoBase::erase()");
     }
     UniqueLock lock(dispatch_mutex_);
-    auto entry_returned = info_map_.find(handle);
-    if (entry_returned == info_map_.end()) {
+    std::unique_ptr<InfoType> info(info_map_.Erase(handle));
+    if (nullptr == info) {
         reportInternalError("Handle passed to HandleInfoBase::insert() not inserted");
     }
-    info_map_.erase(handle);
+    g_handle_generation.fetch_add(1, std::memory_order_release);
 }
 
 template <typename HandleType>
@@ -309,21 +358,25 @@ inline std::pair<GenValidUsageXrHandleInfo *, GenValidUsageXrInstanceInfo *> Han
         reportInternalError("Null handle passed to HandleInfoBase::getWithInstanceInfo()");
     }
     // Try to find the handle in the appropriate map
-    UniqueLock lock(this->dispatch_mutex_);
-    auto entry_returned = this->info_map_.find(handle);
-    if (entry_returned == this->info_map_.end()) {
+    GenValidUsageXrHandleInfo *info = this->info_map_.Find(handle);
+    if (nullptr == info) {
         reportInternalError("Handle passed to HandleInfoBase::getWithInstanceInfo() not inserted");
     }
-    GenValidUsageXrHandleInfo *info = entry_returned->second.get();
     GenValidUsageXrInstanceInfo *instance_info = info->instance_info;
     return {info, instance_info};
 }
 
-template <typename HandleType>
-inline void HandleInfo<HandleType>::removeHandlesForInstance(GenValidUsageXrInstanceInfo *search_value) {
-    typedef typename base_t::value_t value_t;
-    UniqueLock lock(this->dispatch_mutex_);
-    map_erase_if(this->info_map_, [=](value_t const &data) { return data.second && data.second->instance_info == search_value; });
+template <typename HandleType, typename InfoType>
+inline void HandleInfoBase<HandleType, InfoType>::removeHandlesForParent(const void *parent_info,
+                                                                         void (*clean_up_children)(const void *info)) {
+    UniqueLock lock(dispatch_mutex_);
+    info_map_.EraseOwner(parent_info, [=](HandleType, InfoType *info) {
+        if (nullptr != clean_up_children) {
+            clean_up_children(info);
+        }
+        delete info;
+        g_handle_generation.fetch_add(1, std::memory_order_release);
+    });
 }
 
 #endif  // VALIDATION_UTILS_H_
@@ -0,0 +1,249 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include "loader_specific_api.h"
+
+#include <openxr/openxr.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Allocation routing shared by the loader and the API layers.
+//
+// Every module (the loader, each API layer library) has its own current set of
+// XrLoaderAllocationCallbacks, installed with XrSdkSetAllocationCallbacks, and falls back to
+// the global operator new when none are installed.  Each allocation records in a small header
+// which callbacks produced it, so memory is always returned to the right place, even if the
+// callbacks are replaced while it is alive.
+
+//! One installed set of callbacks.  Never freed, since allocations may outlive the installation.
+struct XrSdkAllocationState {
+    XrLoaderAllocationCallbacks callbacks;
+};
+
+//! Allocation counters.  Trivially destructible, so they stay usable during static destruction.
+struct XrSdkAllocationCounters {
+    std::atomic<uint64_t> allocation_count;
+    std::atomic<uint64_t> free_count;
+    std::atomic<uint64_t> current_bytes;
+    std::atomic<uint64_t> peak_bytes;
+    std::atomic<uint64_t> total_bytes;
+};
+
+struct XrSdkAllocationHeader {
+    const XrSdkAllocationState* state;  //!< nullptr when allocated with the global operator new
+    XrSdkAllocationCounters* counters;
+    size_t size;
+    size_t offset;  //!< From the start of the underlying block to the returned pointer
+};
+
+//! The callbacks currently used for new allocations in this module, if any.
+inline std::atomic<const XrSdkAllocationState*>& XrSdkCurrentAllocationState() {
+    static std::atomic<const XrSdkAllocationState*> state{nullptr};
+    return state;
+}
+
+//! Counters for the allocations made by this module.
+inline XrSdkAllocationCounters& XrSdkModuleAllocationCounters() {
+    static XrSdkAllocationCounters counters;
+    return counters;
+}
+
+//! Install (or, with nullptr, remove) the callbacks used for new allocations in this module.
+//! Installing the callbacks that are already current is a no-op, so repeated installs do not leak.
+inline void XrSdkSetAllocationCallbacks(const XrLoaderAllocationCallbacks* callbacks) {
+    const XrSdkAllocationState* state = nullptr;
+    if (callbacks != nullptr && callbacks->pfnAllocation != nullptr && callbacks->pfnFree != nullptr) {
+        const XrSdkAllocationState* current = XrSdkCurrentAllocationState().load(std::memory_order_acquire);
+        if (current != nullptr && current->callbacks.userData == callbacks->userData &&
+            current->callbacks.pfnAllocation == callbacks->pfnAllocation && current->callbacks.pfnFree == callbacks->pfnFree) {
+            return;
+        }
+        state = new XrSdkAllocationState{*callbacks};
+    }
+    XrSdkCurrentAllocationState().store(state, std::memory_order_release);
+}
+
+inline void XrSdkGetAllocationStatistics(const XrSdkAllocationCounters& counters, XrLoaderAllocationStatistics* statistics) {
+    statistics->allocationCount = counters.allocation_count.load(std::memory_order_relaxed);
+    statistics->freeCount = counters.free_count.load(std::memory_order_relaxed);
+    statistics->currentBytes = counters.current_bytes.load(std::memory_order_relaxed);
+    statistics->peakBytes = counters.peak_bytes.load(std::memory_order_relaxed);
+    statistics->totalBytes = counters.total_bytes.load(std::memory_order_relaxed);
+}
+
+//! Allocate through the current callbacks of this module, counting the allocation in counters.
+//! Returns nullptr on failure.
+inline void* XrSdkTryAllocate(size_t size, size_t alignment, XrSdkAllocationCounters& counters) noexcept {
+    if (alignment < alignof(XrSdkAllocationHeader)) {
+        alignment = alignof(XrSdkAllocationHeader);
+    }
+    if (size > std::numeric_limits<size_t>::max() - sizeof(XrSdkAllocationHeader) - 2 * alignment) {
+        return nullptr;
+    }
+    const XrSdkAllocationState* state = XrSdkCurrentAllocationState().load(std::memory_order_acquire);
+
+    uint8_t* block;
+    uint8_t* memory;
+    if (state != nullptr) {
+        // The callbacks return memory aligned as requested, so the header just takes one aligned slot.
+        size_t offset = (sizeof(XrSdkAllocationHeader) + alignment - 1) / alignment * alignment;
+        block = static_cast<uint8_t*>(state->callbacks.pfnAllocation(state->callbacks.userData, size + offset, alignment));
+        if (block == nullptr) {
+            return nullptr;
+        }
+        memory = block + offset;
+    } else {
+        // Global operator new only guarantees fundamental alignment, so align by hand.
+        block = static_cast<uint8_t*>(::operator new(size + sizeof(XrSdkAllocationHeader) + alignment, std::nothrow));
+        if (block == nullptr) {
+            return nullptr;
+        }
+        auto address = reinterpret_cast<uintptr_t>(block) + sizeof(XrSdkAllocationHeader);
+        memory = reinterpret_cast<uint8_t*>((address + alignment - 1) / alignment * alignment);
+    }
+
+    auto* header = reinterpret_cast<XrSdkAllocationHeader*>(memory) - 1;
+    header->state = state;
+    header->counters = &counters;
+    header->size = size;
+    header->offset = static_cast<size_t>(memory - block);
+
+    counters.allocation_count.fetch_add(1, std::memory_order_relaxed);
+    counters.total_bytes.fetch_add(size, std::memory_order_relaxed);
+    uint64_t current = counters.current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+    while (current > peak && !counters.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+    return memory;
+}
+
+//! Like XrSdkTryAllocate, but fails like operator new does.
+inline void* XrSdkAllocate(size_t size, size_t alignment, XrSdkAllocationCounters& counters) {
+    void* memory = XrSdkTryAllocate(size, alignment, counters);
+    if (memory == nullptr) {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+        throw std::bad_alloc();
+#else
+        std::abort();
+#endif
+    }
+    return memory;
+}
+
+//! @overload
+inline void* XrSdkAllocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    return XrSdkAllocate(size, alignment, XrSdkModuleAllocationCounters());
+}
+
+//! Free memory from XrSdkAllocate.  nullptr is ignored.
+inline void XrSdkFree(void* memory) noexcept {
+    if (memory == nullptr) {
+        return;
+    }
+    auto* header = static_cast<XrSdkAllocationHeader*>(memory) - 1;
+    header->counters->free_count.fetch_add(1, std::memory_order_relaxed);
+    header->counters->current_bytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+    void* block = static_cast<uint8_t*>(memory) - header->offset;
+    if (header->state != nullptr) {
+        header->state->callbacks.pfnFree(header->state->callbacks.userData, block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+//! Standard library allocator that goes through XrSdkAllocate.
+template <typename T>
+class XrSdkAllocator {
+   public:
+    typedef T value_type;
+
+    XrSdkAllocator() noexcept = default;
+    template <typename U>
+    XrSdkAllocator(const XrSdkAllocator<U>& /*other*/) noexcept {}
+
+    T* allocate(size_t n) {
+        // An overflowing size is rejected by XrSdkAllocate
+        size_t size = n > std::numeric_limits<size_t>::max() / sizeof(T) ? std::numeric_limits<size_t>::max() : n * sizeof(T);
+        return static_cast<T*>(XrSdkAllocate(size, alignof(T)));
+    }
+
+    void deallocate(T* p, size_t /*n*/) noexcept { XrSdkFree(p); }
+};
+
+template <typename T, typename U>
+inline bool operator==(const XrSdkAllocator<T>& /*a*/, const XrSdkAllocator<U>& /*b*/) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const XrSdkAllocator<T>& /*a*/, const XrSdkAllocator<U>& /*b*/) noexcept {
+    return false;
+}
+
+template <typename T>
+using XrSdkVector = std::vector<T, XrSdkAllocator<T>>;
+
+using XrSdkString = std::basic_string<char, std::char_traits<char>, XrSdkAllocator<char>>;
+
+//! std::hash is only specialized for strings with the default allocator.
+struct XrSdkStringHash {
+    size_t operator()(const XrSdkString& value) const noexcept {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : value) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+using XrSdkUnorderedMap = std::unordered_map<Key, Value, Hash, KeyEqual, XrSdkAllocator<std::pair<const Key, Value>>>;
+
+template <typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+using XrSdkUnorderedSet = std::unordered_set<Key, Hash, KeyEqual, XrSdkAllocator<Key>>;
+
+//! Deleter for the objects of XrSdkMakeUnique.
+template <typename T>
+struct XrSdkDeleter {
+    void operator()(T* object) const noexcept {
+        if (object != nullptr) {
+            object->~T();
+            XrSdkFree(object);
+        }
+    }
+};
+
+template <typename T>
+using XrSdkUniquePtr = std::unique_ptr<T, XrSdkDeleter<T>>;
+
+//! Like std::make_unique, for types that cannot have XR_SDK_ALLOCATION_OPERATORS (generated C structures, for example).
+template <typename T, typename... Args>
+XrSdkUniquePtr<T> XrSdkMakeUnique(Args&&... args) {
+    std::unique_ptr<void, void (*)(void*)> memory(XrSdkAllocate(sizeof(T), alignof(T)), XrSdkFree);
+    XrSdkUniquePtr<T> object(new (memory.get()) T(std::forward<Args>(args)...));
+    memory.release();
+    return object;
+}
+
+//! Put in a class body to allocate its objects (and those of derived classes) through XrSdkAllocate.
+#define XR_SDK_ALLOCATION_OPERATORS                                                                     \
+    static void* operator new(size_t size) { return XrSdkAllocate(size, alignof(std::max_align_t)); } \
+    static void operator delete(void* memory) noexcept { XrSdkFree(memory); }
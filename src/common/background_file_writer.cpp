@@ -0,0 +1,250 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "background_file_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+#ifdef XR_OS_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif  // !NOMINMAX
+#include <windows.h>
+#endif  // XR_OS_WINDOWS
+
+namespace {
+// How long records may wait in the thread buffers before being written.
+constexpr std::chrono::milliseconds kWriteInterval(10);
+// A thread buffer this large wakes the writer thread up early.
+constexpr size_t kWakeUpBytes = 1024 * 1024;
+}  // namespace
+
+BackgroundFileWriter::~BackgroundFileWriter() { Stop(false); }
+
+bool BackgroundFileWriter::Open(const std::string& file_name, bool append, bool binary, const std::string& header,
+                             const std::string& footer, uint64_t max_file_size) {
+    std::unique_lock<std::mutex> lock(_state_mutex);
+    if (_open) {
+        return true;
+    }
+
+    _binary_mode = binary ? std::ios::binary : std::ios::openmode{};
+    if (file_name.empty()) {
+        _output = &std::cout;
+        _file_size = 0;
+        max_file_size = 0;
+    } else {
+        _file.open(file_name, _binary_mode | (append ? (std::ios::out | std::ios::app) : (std::ios::out | std::ios::trunc)));
+        if (!_file.is_open()) {
+            return false;
+        }
+        _output = &_file;
+        _file.seekp(0, std::ios::end);
+        std::streamoff size = _file.tellp();
+        _file_size = size > 0 ? static_cast<uint64_t>(size) : 0;
+    }
+    _file_name = file_name;
+    _header = header;
+    _footer = footer;
+    _max_file_size = max_file_size;
+    if (_file_size == 0) {
+        WriteToFile(_header.data(), _header.size());
+    }
+
+    _stop = false;
+    _thread_stopped = false;
+    _thread = std::thread(&BackgroundFileWriter::Run, this);
+    _open = true;
+    return true;
+}
+
+bool BackgroundFileWriter::IsOpen() {
+    std::unique_lock<std::mutex> lock(_state_mutex);
+    return _open && !_stop;
+}
+
+BackgroundFileWriter::ThreadBuffer& BackgroundFileWriter::GetThreadBuffer() {
+    // The writer shares ownership of each buffer, so that records queued by a thread
+    // are still written after the thread exits.
+    thread_local std::shared_ptr<ThreadBuffer> thread_buffer;
+    if (!thread_buffer) {
+        thread_buffer = std::make_shared<ThreadBuffer>();
+        std::unique_lock<std::mutex> lock(_buffers_mutex);
+        _buffers.push_back(thread_buffer);
+    }
+    return *thread_buffer;
+}
+
+void BackgroundFileWriter::Submit(const char* record, size_t size) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    bool wake_up;
+    {
+        // The sequence number is taken under the buffer lock, which lets the writer thread tell
+        // when it has every record numbered below some value.
+        std::unique_lock<std::mutex> lock(buffer.mutex);
+        size_t bytes = buffer.text.size();
+        buffer.text.append(record, size);
+        buffer.records.push_back(RecordEnd{_next_sequence.fetch_add(1), buffer.text.size()});
+        wake_up = bytes < kWakeUpBytes && buffer.text.size() >= kWakeUpBytes;
+    }
+    if (wake_up) {
+        std::unique_lock<std::mutex> lock(_state_mutex);
+        _wake_requested = true;
+        _wake.notify_one();
+    }
+}
+
+void BackgroundFileWriter::Flush() {
+    std::unique_lock<std::mutex> lock(_state_mutex);
+    if (!_open || _stop) {
+        return;
+    }
+    uint64_t request = ++_flush_requested;
+    _wake.notify_one();
+    _flushed.wait(lock, [&]() { return _flush_completed >= request; });
+}
+
+void BackgroundFileWriter::Close() { Stop(true); }
+
+void BackgroundFileWriter::Stop(bool join) {
+    std::unique_lock<std::mutex> lock(_state_mutex);
+    if (!_open || _stop) {
+        return;
+    }
+    _stop = true;
+    _wake.notify_one();
+    if (!WriterThreadEnded()) {
+        _flushed.wait(lock, [this]() { return _thread_stopped; });
+    }
+    lock.unlock();
+    if (join) {
+        _thread.join();
+    } else {
+        _thread.detach();
+    }
+    lock.lock();
+
+    // Once the writer thread has stopped, the records it did not get to are written here: those
+    // submitted after its last pass, or all of them if the thread was ended before it could stop.
+    WriteSubmittedRecords();
+    *_output << _footer;
+    _output->flush();
+    if (_output == &_file) {
+        _file.close();
+    }
+    _open = false;
+}
+
+void BackgroundFileWriter::Run() {
+    std::unique_lock<std::mutex> lock(_state_mutex);
+    for (;;) {
+        _wake.wait_for(lock, kWriteInterval,
+                       [this]() { return _stop || _wake_requested || _flush_requested != _flush_completed; });
+        _wake_requested = false;
+        bool stop = _stop;
+        uint64_t flush_requested = _flush_requested;
+        lock.unlock();
+
+        WriteSubmittedRecords();
+
+        lock.lock();
+        _flush_completed = flush_requested;
+        _thread_stopped = stop;
+        _flushed.notify_all();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+// Whether the writer thread ended without being stopped.  At process exit, Windows ends every other
+// thread before running the static destructors, so the thread may be gone with records left to write.
+bool BackgroundFileWriter::WriterThreadEnded() {
+#ifdef XR_OS_WINDOWS
+    return WaitForSingleObject(_thread.native_handle(), 0) == WAIT_OBJECT_0;
+#else
+    return false;
+#endif  // XR_OS_WINDOWS
+}
+
+void BackgroundFileWriter::WriteSubmittedRecords() {
+    // Every record numbered below this is in a thread buffer by the time that buffer's lock is taken.
+    uint64_t complete_below = _next_sequence.load();
+    {
+        std::unique_lock<std::mutex> lock(_buffers_mutex);
+        for (auto it = _buffers.begin(); it != _buffers.end();) {
+            // Checked first: once the thread is gone, nothing more can be added after draining.
+            bool thread_exited = it->use_count() == 1;
+            {
+                ThreadBuffer& buffer = **it;
+                std::unique_lock<std::mutex> buffer_lock(buffer.mutex);
+                std::swap(buffer.text, buffer.drained_text);
+                std::swap(buffer.records, buffer.drained_records);
+            }
+            _draining.push_back(*it);
+            if (thread_exited) {
+                it = _buffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    _refs.clear();
+    for (const Record& record : _pending) {
+        _refs.push_back(RecordRef{record.sequence, record.text.data(), record.text.size()});
+    }
+    for (const auto& buffer : _draining) {
+        size_t start = 0;
+        for (const RecordEnd& record : buffer->drained_records) {
+            _refs.push_back(RecordRef{record.sequence, buffer->drained_text.data() + start, record.end - start});
+            start = record.end;
+        }
+    }
+
+    // Each thread buffer is already in order, so this only interleaves them.
+    std::sort(_refs.begin(), _refs.end(), [](const RecordRef& a, const RecordRef& b) { return a.sequence < b.sequence; });
+    std::vector<Record> still_pending;
+    for (const RecordRef& ref : _refs) {
+        if (ref.sequence < complete_below) {
+            WriteToFile(ref.text, ref.size);
+        } else {
+            still_pending.push_back(Record{ref.sequence, std::string(ref.text, ref.size)});
+        }
+    }
+    _pending.swap(still_pending);
+    _output->flush();
+
+    // Keep the storage of the drained buffers for the next time they are swapped in.
+    for (const auto& buffer : _draining) {
+        buffer->drained_text.clear();
+        buffer->drained_records.clear();
+    }
+    _draining.clear();
+}
+
+void BackgroundFileWriter::WriteToFile(const char* text, size_t size) {
+    if (_max_file_size != 0 && _file_size > _header.size() && _file_size + size > _max_file_size) {
+        Rotate();
+    }
+    _output->write(text, static_cast<std::streamsize>(size));
+    _file_size += size;
+}
+
+void BackgroundFileWriter::Rotate() {
+    _file << _footer;
+    _file.close();
+
+    std::string rotated_name = _file_name + ".1";
+    std::remove(rotated_name.c_str());
+    std::rename(_file_name.c_str(), rotated_name.c_str());
+
+    _file.open(_file_name, _binary_mode | std::ios::out | std::ios::trunc);
+    _file.write(_header.data(), static_cast<std::streamsize>(_header.size()));
+    _file_size = _header.size();
+}
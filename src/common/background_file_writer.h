@@ -0,0 +1,124 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the output file of an API layer from a background thread.
+//
+// Each application thread queues its records in a buffer of its own, so recording a call neither
+// waits for the disk nor contends with other threads.  The buffers keep their storage once drained,
+// so queuing a record does not allocate once they are large enough.  The writer thread collects the records of
+// all threads every few milliseconds, and writes them to the file, which stays open, in the order
+// they were submitted.  Once the file grows past the size limit, it is renamed with a ".1" suffix
+// (replacing any earlier one) and a new file is started.
+//
+// The thread buffers are kept per thread rather than per writer, so a layer has a single writer.
+class BackgroundFileWriter {
+   public:
+    BackgroundFileWriter() = default;
+    BackgroundFileWriter(const BackgroundFileWriter&) = delete;
+    BackgroundFileWriter& operator=(const BackgroundFileWriter&) = delete;
+    // Closes the writer like Close, but does not join the writer thread: a writer is destroyed by the
+    // static destructors, which on Windows run under the loader lock that an exiting thread needs.
+    ~BackgroundFileWriter();
+
+    // Start writing to file_name, either appending to it or replacing it, as text or as binary data.
+    // header is written at the start of every new file, and footer at the end of every file.  A
+    // max_file_size of 0 disables rotation.  An empty file_name writes to standard output instead, which
+    // is never rotated.  Does nothing and returns true if the writer is already open.
+    bool Open(const std::string& file_name, bool append, bool binary, const std::string& header, const std::string& footer,
+              uint64_t max_file_size);
+    bool IsOpen();
+
+    // Queue a copy of a record.  Records are written in the order of the calls to Submit, across all threads.
+    void Submit(const char* record, size_t size);
+
+    // Wait until everything submitted so far is written to the file.
+    void Flush();
+
+    // Write everything submitted so far and the footer, then stop the writer thread and close the file.
+    // Whatever the writer thread did not write, because it had already ended, is written by the caller.
+    void Close();
+
+   private:
+    struct Record {
+        uint64_t sequence;
+        std::string text;
+    };
+
+    // A record in a thread buffer ends where the next one starts.
+    struct RecordEnd {
+        uint64_t sequence;
+        size_t end;
+    };
+
+    // Points to a record in a drained thread buffer, or in _pending.
+    struct RecordRef {
+        uint64_t sequence;
+        const char* text;
+        size_t size;
+    };
+
+    struct ThreadBuffer {
+        // Guards text and records
+        std::mutex mutex;
+        std::string text;
+        std::vector<RecordEnd> records;
+        // The previous contents of text and records, only used by the writer thread.
+        std::string drained_text;
+        std::vector<RecordEnd> drained_records;
+    };
+
+    ThreadBuffer& GetThreadBuffer();
+    void Stop(bool join);
+    bool WriterThreadEnded();
+    void Run();
+    // Only called by the writer thread, or once it has stopped.
+    void WriteSubmittedRecords();
+    void WriteToFile(const char* text, size_t size);
+    void Rotate();
+
+    std::atomic<uint64_t> _next_sequence{0};
+
+    // Guards _buffers.  Buffers stay registered after their thread exits until they are drained.
+    std::mutex _buffers_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+
+    // Guards the writer thread state below.
+    std::mutex _state_mutex;
+    std::condition_variable _wake;
+    std::condition_variable _flushed;
+    std::thread _thread;
+    bool _open{false};
+    bool _stop{false};
+    bool _thread_stopped{false};  // Set by the writer thread once it has written its last records
+    bool _wake_requested{false};
+    uint64_t _flush_requested{0};
+    uint64_t _flush_completed{0};
+
+    // Only used by the writer thread, or while it is not running.
+    std::vector<std::shared_ptr<ThreadBuffer>> _draining;
+    std::vector<RecordRef> _refs;
+    std::vector<Record> _pending;  // Drained records still waiting for records numbered before them
+    std::ofstream _file;
+    std::ostream* _output{&_file};  // _file, or std::cout
+    std::string _file_name;
+    std::ios::openmode _binary_mode{};
+    std::string _header;
+    std::string _footer;
+    uint64_t _file_size{0};
+    uint64_t _max_file_size{0};
+};
@@ -0,0 +1,167 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// The call capture format written by the api_dump layer in capture mode, and read by openxr_replay.
+//
+// A capture file starts with a CaptureFileHeader, followed by one record per call, in the order the
+// calls completed.  Each record is a CaptureRecordHeader followed by the parameters of the call as
+// they were passed in, and then, if the call succeeded, the values it returned through them.  How
+// each command lays out its parameters is generated from the registry, so a capture can only be
+// replayed by a tool built from the same registry version.  Values are stored in the byte order of
+// the machine that made the capture.
+
+#define XR_CAPTURE_MAGIC "XRCAPTUR"
+#define XR_CAPTURE_FORMAT_VERSION 1
+
+struct CaptureFileHeader {
+    char magic[8];              // XR_CAPTURE_MAGIC, without the terminating null
+    uint32_t format_version;    // XR_CAPTURE_FORMAT_VERSION
+    uint32_t header_size;       // sizeof(CaptureFileHeader)
+    uint64_t api_version;       // XR_CURRENT_API_VERSION of the registry the capture was made with
+};
+
+struct CaptureRecordHeader {
+    uint32_t size;              // Of the whole record, including this header
+    uint32_t command;           // A CaptureCommand value
+    uint32_t thread;            // Threads are numbered in the order they made their first captured call
+    int32_t result;             // The XrResult returned to the application
+    uint64_t call_index;        // Calls are numbered in the order they started
+    uint64_t completion_index;  // And again in the order they completed
+    uint64_t completed_before;  // How many calls had completed when this one started
+    uint64_t start_time;        // In nanoseconds since the capture started
+    uint64_t duration;          // In nanoseconds
+};
+
+// Written in place of an array size, or of a string length, for a null pointer.
+const uint32_t kCaptureNullCount = 0xFFFFFFFF;
+
+// Appends the parameters of a call to a record.
+class CaptureEncoder {
+   public:
+    explicit CaptureEncoder(std::string& data) : _data(data) {}
+
+    void Write(const void* data, size_t size) { _data.append(static_cast<const char*>(data), size); }
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        Write(&value, sizeof(value));
+    }
+
+    void WriteCount(uint32_t count) { WriteValue(count); }
+
+    // Writes whether pointer is null, and returns true if it is not.
+    bool WritePresence(const void* pointer) {
+        uint8_t present = pointer != nullptr ? 1 : 0;
+        WriteValue(present);
+        return present != 0;
+    }
+
+    // The length, including the terminating null, followed by the characters.
+    void WriteString(const char* text) {
+        if (text == nullptr) {
+            WriteCount(kCaptureNullCount);
+            return;
+        }
+        size_t size = strlen(text) + 1;
+        WriteCount(static_cast<uint32_t>(size));
+        Write(text, size);
+    }
+
+    // Handles and atoms are always written as 64 bit values.
+    template <typename T>
+    void WriteObject(T object) {
+        static_assert(sizeof(T) <= sizeof(uint64_t), "Objects are stored in 64 bits");
+        uint64_t value = 0;
+        memcpy(&value, &object, sizeof(object));
+        WriteValue(value);
+    }
+
+    // Pointers to memory the capture does not follow, such as user data or graphics API objects,
+    // are only written as addresses.
+    template <typename T>
+    void WriteAddress(T pointer) {
+        WriteObject(pointer);
+    }
+
+   private:
+    std::string& _data;
+};
+
+// Reads back the parameters of a call from a record.  Reading past the end of the record throws.
+class CaptureDecoder {
+   public:
+    CaptureDecoder(const char* data, size_t size) : _data(data), _end(data + size) {}
+
+    size_t Remaining() const { return static_cast<size_t>(_end - _data); }
+
+    void Read(void* data, size_t size) { memcpy(data, Take(size), size); }
+
+    template <typename T>
+    void ReadValue(T& value) {
+        Read(&value, sizeof(value));
+    }
+
+    template <typename T>
+    T PeekValue() const {
+        if (Remaining() < sizeof(T)) {
+            throw std::out_of_range("Capture record is truncated");
+        }
+        T value;
+        memcpy(&value, _data, sizeof(value));
+        return value;
+    }
+
+    uint32_t ReadCount() {
+        uint32_t count = 0;
+        ReadValue(count);
+        return count;
+    }
+
+    bool ReadPresence() {
+        uint8_t present = 0;
+        ReadValue(present);
+        return present != 0;
+    }
+
+    // Points into the record, which has to outlive the string.
+    const char* ReadString() {
+        uint32_t size = ReadCount();
+        if (size == kCaptureNullCount) {
+            return nullptr;
+        }
+        const char* text = Take(size);
+        if (size == 0 || text[size - 1] != '\0') {
+            throw std::invalid_argument("Capture record has an unterminated string");
+        }
+        return text;
+    }
+
+    uint64_t ReadObjectValue() {
+        uint64_t value = 0;
+        ReadValue(value);
+        return value;
+    }
+
+   private:
+    const char* Take(size_t size) {
+        if (Remaining() < size) {
+            throw std::out_of_range("Capture record is truncated");
+        }
+        const char* data = _data;
+        _data += size;
+        return data;
+    }
+
+    const char* _data;
+    const char* _end;
+};
@@ -0,0 +1,68 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+/*!
+ * @file
+ *
+ * Parsing of the lists of command name patterns that API layers read from the environment.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// Splits a comma separated list, trimming spaces and tabs around each entry and leaving out empty ones.
+static inline std::vector<std::string> SplitCommandList(const std::string& list) {
+    std::vector<std::string> entries;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        size_t first = list.find_first_not_of(" \t", start);
+        size_t last = list.find_last_not_of(" \t", end == 0 ? 0 : end - 1);
+        if (first != std::string::npos && first < end && last != std::string::npos && last >= first) {
+            entries.push_back(list.substr(first, last - first + 1));
+        }
+        start = end + 1;
+    }
+    return entries;
+}
+
+/// Returns whether a command name matches a pattern, in which '*' matches any number of characters and '?' any single one.
+static inline bool MatchCommandPattern(const char* pattern, const char* name) {
+    // Backtracks to just after the last '*' on a mismatch.
+    const char* star = nullptr;
+    const char* star_name = nullptr;
+    while (*name != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            star_name = name;
+        } else if (*pattern == '?' || *pattern == *name) {
+            ++pattern;
+            ++name;
+        } else if (star != nullptr) {
+            pattern = star + 1;
+            name = ++star_name;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        ++pattern;
+    }
+    return *pattern == '\0';
+}
+
+static inline bool MatchAnyCommandPattern(const std::vector<std::string>& patterns, const char* name) {
+    for (const std::string& pattern : patterns) {
+        if (MatchCommandPattern(pattern.c_str(), name)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,447 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include "allocation_callbacks.h"
+#include "hex_and_handles.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// The tables each thread of a module is reading in ConcurrentHandleRegistry::Find, which tell the
+// writers of every registry when nobody can still read a table they replaced.
+//
+// Each thread has its own reader record, on its own cache line, where Find publishes the table it
+// reads and clears it when done, so lookups from many threads share no line that is written to.  A
+// writer frees a replaced table once no record holds it, so a thread that keeps calling Find, or
+// stalls in the middle of one, only ever keeps the one table it is reading.
+class ConcurrentHandleRegistryReaders {
+   public:
+    struct alignas(64) Reader {
+        Reader() { Get().Link(this); }
+        ~Reader() { Get().Unlink(this); }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        std::atomic<const void*> table{nullptr};  // nullptr while the thread is not in Find
+        Reader* previous{nullptr};                // Only used under the mutex, like next
+        Reader* next{nullptr};
+    };
+
+    // Never destroyed, since threads may exit after the static objects of the module are gone.
+    static ConcurrentHandleRegistryReaders& Get() {
+        static ConcurrentHandleRegistryReaders* readers = new ConcurrentHandleRegistryReaders;
+        return *readers;
+    }
+
+    static Reader& ThisThread() {
+        thread_local Reader reader;
+        return reader;
+    }
+
+    // Whether a thread may still be reading table.  Only meaningful for a table that was replaced.
+    bool IsRead(const void* table) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (const Reader* reader = _readers; reader != nullptr; reader = reader->next) {
+            if (reader->table.load(std::memory_order_seq_cst) == table) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+   private:
+    void Link(Reader* reader) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        reader->next = _readers;
+        if (_readers != nullptr) {
+            _readers->previous = reader;
+        }
+        _readers = reader;
+    }
+
+    void Unlink(Reader* reader) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        (reader->previous != nullptr ? reader->previous->next : _readers) = reader->next;
+        if (reader->next != nullptr) {
+            reader->next->previous = reader->previous;
+        }
+    }
+
+    std::mutex _mutex;
+    Reader* _readers{nullptr};
+};
+
+// Maps the handles of one type to a pointer each, such as the dispatch table to call down with, for
+// the loader and the API layers, which look handles up on every call from any number of threads.
+//
+// Find takes no lock and never waits: the entries live in open-addressing tables of atomics, which
+// writers never move an entry within.  The handles are spread over a fixed number of shards, each
+// with its own table and mutex, so writes to different shards do not contend.  When a table fills
+// up, with live or erased entries, its live entries are copied to a new one which is then
+// published.  Find only writes to the record of its own thread in ConcurrentHandleRegistryReaders,
+// which the writers check to free the tables a shard has replaced as soon as no Find is reading
+// them, so churn does not grow the registry.
+//
+// Each entry also has an owner, usually its instance, and each shard keeps a list of the handles
+// of every owner, so EraseOwner takes time proportional to the number of handles it erases.
+//
+// The registry does not own the values.  Find may return a value while another thread erases it,
+// so a value must stay valid for as long as its handle may still be used.
+template <typename HandleType, typename ValueType>
+class ConcurrentHandleRegistry {
+   public:
+    ConcurrentHandleRegistry() = default;
+    ConcurrentHandleRegistry(const ConcurrentHandleRegistry&) = delete;
+    ConcurrentHandleRegistry& operator=(const ConcurrentHandleRegistry&) = delete;
+
+    // Returns the value of handle, or nullptr if the handle is unknown.
+    ValueType* Find(HandleType handle) const;
+
+    // Adds handle, or replaces its value and owner if it is already present, returning the value it
+    // replaced, or nullptr.  Null handles and values are ignored.
+    ValueType* Insert(HandleType handle, ValueType* value, const void* owner);
+
+    // Removes handle, returning its value, or nullptr if it was unknown.
+    ValueType* Erase(HandleType handle);
+
+    // Removes handle only if its value is still value, so that a handle given to another value since
+    // is kept.  Returns whether it was removed.
+    bool EraseIfValue(HandleType handle, const ValueType* value);
+
+    // Removes every handle of owner, calling callback(handle, value) for each.  The callback is
+    // called with a shard locked, so it must not use the registry.
+    template <typename Callback>
+    void EraseOwner(const void* owner, Callback callback);
+    void EraseOwner(const void* owner) {
+        EraseOwner(owner, [](HandleType, ValueType*) {});
+    }
+
+    bool Empty() const { return _live_handles.load(std::memory_order_acquire) == 0; }
+
+    // Calls callback(handle, value) for every handle, with its shard locked.
+    template <typename Callback>
+    void ForEach(Callback callback) const;
+
+    // Frees the tables replaced as the shards grew that no Find is still reading.  Writers already
+    // do this as they go, so it only matters for a registry that is no longer written to.
+    void ReleaseRetiredTables();
+
+   private:
+    static const uint32_t kShardBits = 4;
+    static const uint32_t kMinTableBits = 3;
+
+    struct Slot {
+        std::atomic<uint64_t> handle;    // 0 while unused, then never changes
+        std::atomic<ValueType*> value;   // nullptr once erased
+        const void* owner;               // Only used by writers, like the rest below
+        size_t owner_position;           // In the list of handles of the owner
+    };
+
+    struct Table {
+        XR_SDK_ALLOCATION_OPERATORS
+
+        explicit Table(uint32_t bits) : shift(64 - bits), slots(size_t(1) << bits) {}
+
+        // The bits used to pick the shard are left out, since they are the same for the whole table.
+        size_t Start(uint64_t hash) const { return static_cast<size_t>((hash << kShardBits) >> shift); }
+        size_t Next(size_t position) const { return (position + 1) & (slots.size() - 1); }
+
+        uint32_t shift;
+        XrSdkVector<Slot> slots;
+    };
+
+    // Aligned so that writers to one shard do not slow down the readers of its neighbours.
+    struct alignas(64) Shard {
+        std::atomic<Table*> table{nullptr};
+        mutable std::mutex mutex;
+        size_t used_slots{0};  // Slots with a handle, including erased ones
+        size_t live_handles{0};
+        std::unique_ptr<Table> current;
+        XrSdkVector<std::unique_ptr<Table>> retired;
+        XrSdkUnorderedMap<const void*, XrSdkVector<uint64_t>> owned;
+    };
+
+    static uint64_t Hash(uint64_t handle) { return handle * 0x9E3779B97F4A7C15ULL; }
+    Shard& ShardOf(uint64_t hash) { return _shards[hash >> (64 - kShardBits)]; }
+    const Shard& ShardOf(uint64_t hash) const { return _shards[hash >> (64 - kShardBits)]; }
+
+    // The slot holding handle, or else the unused slot where it would go.
+    static Slot& Probe(Table& table, uint64_t handle, uint64_t hash);
+    // Moves the live entries to a new table, big enough to take at least one more handle.
+    static Table& Rebuild(Shard& shard);
+    // Frees the retired tables of shard that no Find can still be reading.  The shard must be locked.
+    static void ReleaseRetiredTables(Shard& shard);
+    static void AddOwned(Shard& shard, Slot& slot, uint64_t handle, const void* owner);
+    static void RemoveOwned(Shard& shard, Table& table, Slot& slot);
+
+    Shard _shards[size_t(1) << kShardBits];
+    std::atomic<size_t> _live_handles{0};
+};
+
+// -- Only implementations of templates follow --//
+
+template <typename HandleType, typename ValueType>
+inline ValueType* ConcurrentHandleRegistry<HandleType, ValueType>::Find(HandleType handle) const {
+    const uint64_t generic = MakeHandleGeneric(handle);
+    if (generic == 0) {
+        return nullptr;
+    }
+    const uint64_t hash = Hash(generic);
+    const Shard& shard = ShardOf(hash);
+    // The table is published before it is checked to still be current, both sequentially consistent
+    // like the writers' replacing and checking of it, so that a writer that replaces the table after
+    // the check sees that it is being read.
+    ConcurrentHandleRegistryReaders::Reader& reader = ConcurrentHandleRegistryReaders::ThisThread();
+    const Table* table = shard.table.load(std::memory_order_acquire);
+    for (;;) {
+        reader.table.store(table, std::memory_order_seq_cst);
+        const Table* current = shard.table.load(std::memory_order_seq_cst);
+        if (current == table) {
+            break;
+        }
+        table = current;
+    }
+    ValueType* value = nullptr;
+    if (table != nullptr) {
+        // Tables are kept at most half full, so this always reaches an unused slot.
+        for (size_t position = table->Start(hash);; position = table->Next(position)) {
+            const Slot& slot = table->slots[position];
+            uint64_t slot_handle = slot.handle.load(std::memory_order_acquire);
+            if (slot_handle == generic) {
+                value = slot.value.load(std::memory_order_acquire);
+                break;
+            }
+            if (slot_handle == 0) {
+                break;
+            }
+        }
+    }
+    reader.table.store(nullptr, std::memory_order_release);
+    return value;
+}
+
+template <typename HandleType, typename ValueType>
+inline typename ConcurrentHandleRegistry<HandleType, ValueType>::Slot& ConcurrentHandleRegistry<HandleType, ValueType>::Probe(
+    Table& table, uint64_t handle, uint64_t hash) {
+    size_t position = table.Start(hash);
+    for (;;) {
+        uint64_t slot_handle = table.slots[position].handle.load(std::memory_order_relaxed);
+        if (slot_handle == handle || slot_handle == 0) {
+            return table.slots[position];
+        }
+        position = table.Next(position);
+    }
+}
+
+template <typename HandleType, typename ValueType>
+inline ValueType* ConcurrentHandleRegistry<HandleType, ValueType>::Insert(HandleType handle, ValueType* value,
+                                                                          const void* owner) {
+    const uint64_t generic = MakeHandleGeneric(handle);
+    if (generic == 0 || value == nullptr) {
+        return nullptr;
+    }
+    const uint64_t hash = Hash(generic);
+    Shard& shard = ShardOf(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    ReleaseRetiredTables(shard);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    Slot* slot = table == nullptr ? nullptr : &Probe(*table, generic, hash);
+    if (slot != nullptr && slot->handle.load(std::memory_order_relaxed) == generic) {
+        ValueType* replaced = slot->value.exchange(value, std::memory_order_acq_rel);
+        if (replaced != nullptr) {
+            RemoveOwned(shard, *table, *slot);
+        } else {
+            ++shard.live_handles;
+            _live_handles.fetch_add(1, std::memory_order_release);
+        }
+        AddOwned(shard, *slot, generic, owner);
+        return replaced;
+    }
+    if (table == nullptr || (shard.used_slots + 1) * 2 > table->slots.size()) {
+        table = &Rebuild(shard);
+        slot = &Probe(*table, generic, hash);
+    }
+    // Readers check the handle first, so it is published last.
+    slot->value.store(value, std::memory_order_relaxed);
+    slot->handle.store(generic, std::memory_order_release);
+    AddOwned(shard, *slot, generic, owner);
+    ++shard.used_slots;
+    ++shard.live_handles;
+    _live_handles.fetch_add(1, std::memory_order_release);
+    return nullptr;
+}
+
+template <typename HandleType, typename ValueType>
+inline ValueType* ConcurrentHandleRegistry<HandleType, ValueType>::Erase(HandleType handle) {
+    const uint64_t generic = MakeHandleGeneric(handle);
+    const uint64_t hash = Hash(generic);
+    Shard& shard = ShardOf(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    ReleaseRetiredTables(shard);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (generic == 0 || table == nullptr) {
+        return nullptr;
+    }
+    Slot& slot = Probe(*table, generic, hash);
+    if (slot.handle.load(std::memory_order_relaxed) != generic) {
+        return nullptr;
+    }
+    ValueType* value = slot.value.exchange(nullptr, std::memory_order_acq_rel);
+    if (value != nullptr) {
+        RemoveOwned(shard, *table, slot);
+        --shard.live_handles;
+        _live_handles.fetch_sub(1, std::memory_order_release);
+    }
+    return value;
+}
+
+template <typename HandleType, typename ValueType>
+inline bool ConcurrentHandleRegistry<HandleType, ValueType>::EraseIfValue(HandleType handle, const ValueType* value) {
+    const uint64_t generic = MakeHandleGeneric(handle);
+    const uint64_t hash = Hash(generic);
+    Shard& shard = ShardOf(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    ReleaseRetiredTables(shard);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (generic == 0 || value == nullptr || table == nullptr) {
+        return false;
+    }
+    Slot& slot = Probe(*table, generic, hash);
+    // Writers hold the shard lock, so the value can't change between the check and the erase.
+    if (slot.handle.load(std::memory_order_relaxed) != generic || slot.value.load(std::memory_order_relaxed) != value) {
+        return false;
+    }
+    slot.value.store(nullptr, std::memory_order_release);
+    RemoveOwned(shard, *table, slot);
+    --shard.live_handles;
+    _live_handles.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+template <typename HandleType, typename ValueType>
+template <typename Callback>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::EraseOwner(const void* owner, Callback callback) {
+    for (Shard& shard : _shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        ReleaseRetiredTables(shard);
+        auto owned = shard.owned.find(owner);
+        if (owned == shard.owned.end()) {
+            continue;
+        }
+        Table& table = *shard.table.load(std::memory_order_relaxed);
+        for (uint64_t handle : owned->second) {
+            Slot& slot = Probe(table, handle, Hash(handle));
+            ValueType* value = slot.value.exchange(nullptr, std::memory_order_acq_rel);
+            --shard.live_handles;
+            _live_handles.fetch_sub(1, std::memory_order_release);
+            callback(TreatIntegerAsHandle<HandleType>(handle), value);
+        }
+        shard.owned.erase(owned);
+    }
+}
+
+template <typename HandleType, typename ValueType>
+template <typename Callback>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::ForEach(Callback callback) const {
+    for (const Shard& shard : _shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        const Table* table = shard.table.load(std::memory_order_relaxed);
+        if (table == nullptr) {
+            continue;
+        }
+        for (const Slot& slot : table->slots) {
+            ValueType* value = slot.value.load(std::memory_order_relaxed);
+            if (value != nullptr) {
+                uint64_t handle = slot.handle.load(std::memory_order_relaxed);
+                callback(TreatIntegerAsHandle<HandleType>(handle), value);
+            }
+        }
+    }
+}
+
+template <typename HandleType, typename ValueType>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::ReleaseRetiredTables() {
+    for (Shard& shard : _shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        ReleaseRetiredTables(shard);
+    }
+}
+
+template <typename HandleType, typename ValueType>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::ReleaseRetiredTables(Shard& shard) {
+    // The current table was published before this, so a Find that does not hold a retired table
+    // now never will.
+    ConcurrentHandleRegistryReaders& readers = ConcurrentHandleRegistryReaders::Get();
+    auto kept = shard.retired.begin();
+    for (auto& retired : shard.retired) {
+        if (readers.IsRead(retired.get())) {
+            *kept++ = std::move(retired);
+        }
+    }
+    shard.retired.erase(kept, shard.retired.end());
+}
+
+template <typename HandleType, typename ValueType>
+inline typename ConcurrentHandleRegistry<HandleType, ValueType>::Table& ConcurrentHandleRegistry<HandleType, ValueType>::Rebuild(
+    Shard& shard) {
+    // Erased slots are dropped, so a shard with many of them may be rebuilt at the same size.
+    uint32_t bits = kMinTableBits;
+    while ((size_t(1) << bits) < (shard.live_handles + 1) * 4) {
+        ++bits;
+    }
+    std::unique_ptr<Table> rebuilt(new Table(bits));
+    const Table* current = shard.table.load(std::memory_order_relaxed);
+    if (current != nullptr) {
+        for (const Slot& slot : current->slots) {
+            ValueType* value = slot.value.load(std::memory_order_relaxed);
+            if (value != nullptr) {
+                uint64_t handle = slot.handle.load(std::memory_order_relaxed);
+                Slot& target = Probe(*rebuilt, handle, Hash(handle));
+                target.value.store(value, std::memory_order_relaxed);
+                target.handle.store(handle, std::memory_order_relaxed);
+                target.owner = slot.owner;
+                target.owner_position = slot.owner_position;
+            }
+        }
+    }
+    Table& table = *rebuilt;
+    shard.used_slots = shard.live_handles;
+    shard.table.store(&table, std::memory_order_seq_cst);
+    if (shard.current != nullptr) {
+        shard.retired.push_back(std::move(shard.current));
+    }
+    shard.current = std::move(rebuilt);
+    ReleaseRetiredTables(shard);
+    return table;
+}
+
+template <typename HandleType, typename ValueType>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::AddOwned(Shard& shard, Slot& slot, uint64_t handle,
+                                                                      const void* owner) {
+    XrSdkVector<uint64_t>& handles = shard.owned[owner];
+    slot.owner = owner;
+    slot.owner_position = handles.size();
+    handles.push_back(handle);
+}
+
+template <typename HandleType, typename ValueType>
+inline void ConcurrentHandleRegistry<HandleType, ValueType>::RemoveOwned(Shard& shard, Table& table, Slot& slot) {
+    // The last handle of the owner takes the place of the removed one.
+    auto owned = shard.owned.find(slot.owner);
+    XrSdkVector<uint64_t>& handles = owned->second;
+    uint64_t moved = handles.back();
+    handles[slot.owner_position] = moved;
+    Probe(table, moved, Hash(moved)).owner_position = slot.owner_position;
+    handles.pop_back();
+    if (handles.empty()) {
+        shard.owned.erase(owned);
+    }
+}
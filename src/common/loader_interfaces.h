@@ -109,6 +109,12 @@ typedef struct XrApiLayerCreateInfo {
     XrApiLayerNextInfo *nextInfo;                                      // Pointer to the next API layer's Info
 } XrApiLayerCreateInfo;
 
+// Optional function exported by an API layer library, next to xrNegotiateLoaderApiLayerInterface.  When present,
+// the loader calls it right after loading the library, before negotiation, with the callbacks the layer
+// should allocate through (see loader_specific_api.h).  The callbacks stay valid until the library is unloaded.
+typedef struct XrLoaderAllocationCallbacks XrLoaderAllocationCallbacks;
+typedef XrResult(XRAPI_PTR *PFN_xrApiLayerSetAllocationCallbacks)(const XrLoaderAllocationCallbacks *allocator);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
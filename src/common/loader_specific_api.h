@@ -0,0 +1,70 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include <openxr/openxr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Entry points implemented by this loader only, and not part of the OpenXR specification.
+// Each of them is retrieved through xrGetInstanceProcAddr, which also accepts XR_NULL_HANDLE
+// for the instance, and is absent (XR_ERROR_FUNCTION_UNSUPPORTED) when the loader was built
+// without the feature.
+
+// Per-command call statistics, gathered when the loader is built with BUILD_LOADER_WITH_COMMAND_STATS
+// and XR_LOADER_COMMAND_STATS=1 or XR_LOADER_COMMAND_STATS_FILE is set in the environment.
+// Durations are the time spent below the loader (API layers and runtime), in nanoseconds.
+// Percentiles come from a log-linear histogram and are accurate to within 1/8th of their value.
+typedef struct XrLoaderCommandStatistics {
+    const char* commandName;
+    uint64_t callCount;
+    XrDuration totalDuration;
+    XrDuration maxDuration;
+    XrDuration p50Duration;
+    XrDuration p95Duration;
+    XrDuration p99Duration;
+} XrLoaderCommandStatistics;
+
+// Two-call idiom: fills in one element for every command called at least once so far.
+typedef XrResult(XRAPI_PTR* PFN_xrLoaderGetCommandStatistics)(uint32_t statisticsCapacityInput, uint32_t* statisticsCountOutput,
+                                                              XrLoaderCommandStatistics* statistics);
+
+// Allocation callbacks, in the spirit of VkAllocationCallbacks.  Once installed, the loader's own
+// objects and containers, and those of the API layers that support it, are allocated through them.
+// They must stay callable until the loader is unloaded, and must be thread-safe.
+// pfnAllocation returns memory aligned to at least alignment, or NULL on failure.
+typedef void*(XRAPI_PTR* PFN_xrLoaderAllocationFunction)(void* userData, size_t size, size_t alignment);
+typedef void(XRAPI_PTR* PFN_xrLoaderFreeFunction)(void* userData, void* memory);
+
+typedef struct XrLoaderAllocationCallbacks {
+    void* userData;
+    PFN_xrLoaderAllocationFunction pfnAllocation;
+    PFN_xrLoaderFreeFunction pfnFree;
+} XrLoaderAllocationCallbacks;
+
+// Install before xrCreateInstance so that everything is covered; API layers receive the callbacks
+// when they are loaded.  Memory allocated before a change is still returned to the callbacks that
+// allocated it.  Passing NULL goes back to the default allocator.
+typedef XrResult(XRAPI_PTR* PFN_xrLoaderSetAllocationCallbacks)(const XrLoaderAllocationCallbacks* allocator);
+
+typedef struct XrLoaderAllocationStatistics {
+    uint64_t allocationCount;
+    uint64_t freeCount;
+    uint64_t currentBytes;
+    uint64_t peakBytes;
+    uint64_t totalBytes;
+} XrLoaderAllocationStatistics;
+
+// Statistics for the loader's own allocations and for those of the API layers it loaded.
+// Either pointer may be NULL.
+typedef XrResult(XRAPI_PTR* PFN_xrLoaderGetAllocationStatistics)(XrLoaderAllocationStatistics* loaderStatistics,
+                                                                 XrLoaderAllocationStatistics* apiLayerStatistics);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
@@ -9,11 +9,14 @@
 
 #include "api_layer_interface.hpp"
 
+#include "allocation_callbacks.h"
 #include "loader_interfaces.h"
 #include "loader_logger.hpp"
 #include "loader_platform.hpp"
+#include "loader_specific_api.h"
 #include "manifest_file.hpp"
 #include "platform_utils.hpp"
+#include "xr_generated_reflection.hpp"
 
 #include <openxr/openxr.h>
 
@@ -26,6 +29,33 @@
 
 #define OPENXR_ENABLE_LAYERS_ENV_VAR "XR_ENABLE_API_LAYERS"
 
+// Allocations made by API layers on the loader's behalf are counted separately from the loader's own.
+static XrSdkAllocationCounters& GetApiLayerAllocationCounters() {
+    static XrSdkAllocationCounters counters;
+    return counters;
+}
+
+static void* XRAPI_CALL ApiLayerAllocate(void* user_data, size_t size, size_t alignment) {
+    return XrSdkTryAllocate(size, alignment, *static_cast<XrSdkAllocationCounters*>(user_data));
+}
+
+static void XRAPI_CALL ApiLayerFree(void* /*user_data*/, void* memory) { XrSdkFree(memory); }
+
+// Hand the loader's allocation routing to a layer library that exports xrApiLayerSetAllocationCallbacks.
+static void SetApiLayerAllocationCallbacks(const std::string& openxr_command, const std::string& layer_name,
+                                           LoaderPlatformLibraryHandle layer_library) {
+    auto set_allocation_callbacks = reinterpret_cast<PFN_xrApiLayerSetAllocationCallbacks>(
+        LoaderPlatformLibraryGetProcAddr(layer_library, "xrApiLayerSetAllocationCallbacks"));
+    if (nullptr == set_allocation_callbacks) {
+        return;
+    }
+    static const XrLoaderAllocationCallbacks callbacks = {&GetApiLayerAllocationCounters(), ApiLayerAllocate, ApiLayerFree};
+    if (XR_FAILED(set_allocation_callbacks(&callbacks))) {
+        LoaderLogger::LogWarningMessage(openxr_command, "ApiLayerInterface::LoadApiLayers layer " + layer_name +
+                                                            " rejected the loader allocation callbacks");
+    }
+}
+
 // Add any layers defined in the loader layer environment variable.
 static void AddEnvironmentApiLayers(std::vector<std::string>& enabled_layers) {
     std::string layers = PlatformUtilsGetEnv(OPENXR_ENABLE_LAYERS_ENV_VAR);
@@ -183,7 +213,7 @@ XrResult ApiLayerInterface::GetInstanceExtensionProperties(const std::string& op
 
 XrResult ApiLayerInterface::LoadApiLayers(const std::string& openxr_command, uint32_t enabled_api_layer_count,
                                           const char* const* enabled_api_layer_names,
-                                          std::vector<std::unique_ptr<ApiLayerInterface>>& api_layer_interfaces) {
+                                          XrSdkVector<std::unique_ptr<ApiLayerInterface>>& api_layer_interfaces) {
     XrResult last_error = XR_SUCCESS;
     bool any_loaded = false;
     std::vector<bool> layer_found;
@@ -255,6 +285,8 @@ XrResult ApiLayerInterface::LoadApiLayers(const std::string& openxr_command, uin
             continue;
         }
 
+        SetApiLayerAllocationCallbacks(openxr_command, manifest_file->LayerName(), layer_library);
+
         // Get and settle on an layer interface version (using any provided name if required).
         std::string function_name = manifest_file->GetFunctionName("xrNegotiateLoaderApiLayerInterface");
         auto negotiate = reinterpret_cast<PFN_xrNegotiateLoaderApiLayerInterface>(
@@ -303,6 +335,10 @@ XrResult ApiLayerInterface::LoadApiLayers(const std::string& openxr_command, uin
             std::ostringstream oss;
             oss << "ApiLayerInterface::LoadApiLayers skipping layer " << manifest_file->LayerName()
                 << " due to failed negotiation with error " << res;
+            const char* result_name = ReflectionResultName(res);
+            if (nullptr != result_name) {
+                oss << " (" << result_name << ")";
+            }
             LoaderLogger::LogWarningMessage(openxr_command, oss.str());
             LoaderPlatformLibraryClose(layer_library);
             continue;
@@ -318,12 +354,11 @@ XrResult ApiLayerInterface::LoadApiLayers(const std::string& openxr_command, uin
 
         // Grab the list of extensions this layer supports for easy filtering after the
         // xrCreateInstance call
-        std::vector<std::string> supported_extensions;
+        LoaderExtensionSet supported_extensions;
         std::vector<XrExtensionProperties> extension_properties;
         manifest_file->GetInstanceExtensionProperties(extension_properties);
-        supported_extensions.reserve(extension_properties.size());
-        for (XrExtensionProperties& ext_prop : extension_properties) {
-            supported_extensions.emplace_back(ext_prop.extensionName);
+        for (const XrExtensionProperties& ext_prop : extension_properties) {
+            supported_extensions.Insert(ext_prop.extensionName);
         }
 
         // Add this runtime to the vector
@@ -358,10 +393,10 @@ XrResult ApiLayerInterface::LoadApiLayers(const std::string& openxr_command, uin
 }
 
 ApiLayerInterface::ApiLayerInterface(const std::string& layer_name, LoaderPlatformLibraryHandle layer_library,
-                                     std::vector<std::string>& supported_extensions,
+                                     const LoaderExtensionSet& supported_extensions,
                                      PFN_xrGetInstanceProcAddr get_instance_proc_addr,
                                      PFN_xrCreateApiLayerInstance create_api_layer_instance)
-    : _layer_name(layer_name),
+    : _layer_name(layer_name.begin(), layer_name.end()),
       _layer_library(layer_library),
       _get_instance_proc_addr(get_instance_proc_addr),
       _create_api_layer_instance(create_api_layer_instance),
@@ -369,18 +404,15 @@ ApiLayerInterface::ApiLayerInterface(const std::string& layer_name, LoaderPlatfo
 
 ApiLayerInterface::~ApiLayerInterface() {
     std::string info_message = "ApiLayerInterface being destroyed for layer ";
-    info_message += _layer_name;
+    info_message += _layer_name.c_str();
     LoaderLogger::LogInfoMessage("", info_message);
     LoaderPlatformLibraryClose(_layer_library);
 }
 
+void ApiLayerInterface::GetAllocationStatistics(XrLoaderAllocationStatistics* statistics) {
+    XrSdkGetAllocationStatistics(GetApiLayerAllocationCounters(), statistics);
+}
+
 bool ApiLayerInterface::SupportsExtension(const std::string& extension_name) const {
-    bool found_prop = false;
-    for (const std::string& supported_extension : _supported_extensions) {
-        if (supported_extension == extension_name) {
-            found_prop = true;
-            break;
-        }
-    }
-    return found_prop;
+    return _supported_extensions.Contains(extension_name.c_str());
 }
@@ -15,6 +15,8 @@
 
 #include <openxr/openxr.h>
 
+#include "allocation_callbacks.h"
+#include "loader_extension_set.hpp"
 #include "loader_platform.hpp"
 #include "loader_interfaces.h"
 
@@ -22,10 +24,12 @@ struct XrGeneratedDispatchTable;
 
 class ApiLayerInterface {
    public:
+    XR_SDK_ALLOCATION_OPERATORS
+
     // Factory method
     static XrResult LoadApiLayers(const std::string& openxr_command, uint32_t enabled_api_layer_count,
                                   const char* const* enabled_api_layer_names,
-                                  std::vector<std::unique_ptr<ApiLayerInterface>>& api_layer_interfaces);
+                                  XrSdkVector<std::unique_ptr<ApiLayerInterface>>& api_layer_interfaces);
     // Static queries
     static XrResult GetApiLayerProperties(const std::string& openxr_command, uint32_t incoming_count, uint32_t* outgoing_count,
                                           XrApiLayerProperties* api_layer_properties);
@@ -33,22 +37,26 @@ class ApiLayerInterface {
                                                    std::vector<XrExtensionProperties>& extension_properties);
 
     ApiLayerInterface(const std::string& layer_name, LoaderPlatformLibraryHandle layer_library,
-                      std::vector<std::string>& supported_extensions, PFN_xrGetInstanceProcAddr get_instance_proc_addr,
+                      const LoaderExtensionSet& supported_extensions, PFN_xrGetInstanceProcAddr get_instance_proc_addr,
                       PFN_xrCreateApiLayerInstance create_api_layer_instance);
     virtual ~ApiLayerInterface();
 
     PFN_xrGetInstanceProcAddr GetInstanceProcAddrFuncPointer() { return _get_instance_proc_addr; }
     PFN_xrCreateApiLayerInstance GetCreateApiLayerInstanceFuncPointer() { return _create_api_layer_instance; }
 
-    std::string LayerName() { return _layer_name; }
+    std::string LayerName() { return std::string(_layer_name.begin(), _layer_name.end()); }
 
     // Generated methods
     bool SupportsExtension(const std::string& extension_name) const;
+    const LoaderExtensionSet& SupportedExtensions() const { return _supported_extensions; }
+
+    // Allocation statistics for every API layer library that accepted the loader's allocation callbacks
+    static void GetAllocationStatistics(XrLoaderAllocationStatistics* statistics);
 
    private:
-    std::string _layer_name;
+    XrSdkString _layer_name;
     LoaderPlatformLibraryHandle _layer_library;
     PFN_xrGetInstanceProcAddr _get_instance_proc_addr;
     PFN_xrCreateApiLayerInstance _create_api_layer_instance;
-    std::vector<std::string> _supported_extensions;
+    LoaderExtensionSet _supported_extensions;
 };
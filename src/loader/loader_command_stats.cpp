@@ -0,0 +1,235 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#include "loader_command_stats.hpp"
+
+#include "loader_histogram.hpp"
+#include "loader_logger.hpp"
+#include "platform_utils.hpp"
+#include "xr_generated_reflection.hpp"
+
+#include <openxr/openxr.h>
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct CommandCounters {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::array<std::atomic<uint64_t>, kLoaderHistogramBucketCount> buckets{};
+};
+
+// Counters owned by a single thread at a time.  Counters for a command are only allocated
+// once that command is called on the thread.
+struct ThreadCounters {
+    std::array<std::atomic<CommandCounters*>, REFLECTION_COMMAND_COUNT> commands{};
+
+    ~ThreadCounters() {
+        for (auto& command : commands) {
+            delete command.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+// Keeps the counters of every thread that ever recorded anything.  The counters of exited
+// threads are handed to new threads rather than freed, so their totals are kept and the
+// list does not grow with thread churn.
+struct ThreadCountersRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> all;
+    std::vector<ThreadCounters*> available;
+};
+
+ThreadCountersRegistry& GetThreadCountersRegistry() {
+    static ThreadCountersRegistry registry;
+    return registry;
+}
+
+struct ThreadCountersOwner {
+    ThreadCounters* counters = nullptr;
+
+    ~ThreadCountersOwner() {
+        if (counters != nullptr) {
+            auto& registry = GetThreadCountersRegistry();
+            std::unique_lock<std::mutex> lock(registry.mutex);
+            registry.available.push_back(counters);
+        }
+    }
+};
+
+thread_local ThreadCountersOwner t_counters_owner;
+
+ThreadCounters& GetThreadCounters() {
+    if (t_counters_owner.counters == nullptr) {
+        auto& registry = GetThreadCountersRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        if (registry.available.empty()) {
+            registry.all.emplace_back(new ThreadCounters);
+            t_counters_owner.counters = registry.all.back().get();
+        } else {
+            t_counters_owner.counters = registry.available.back();
+            registry.available.pop_back();
+        }
+    }
+    return *t_counters_owner.counters;
+}
+
+// Only the owning thread writes, so a relaxed load and store is enough for an increment.
+void AddRelaxed(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+struct CommandSummary {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::array<uint64_t, kLoaderHistogramBucketCount> buckets{};
+
+    uint64_t Percentile(double percent) const { return LoaderHistogramPercentile(buckets.data(), count, max_ns, percent); }
+};
+
+std::vector<CommandSummary> SummarizeCommands() {
+    std::vector<CommandSummary> summaries(REFLECTION_COMMAND_COUNT);
+    auto& registry = GetThreadCountersRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    for (const auto& thread_counters : registry.all) {
+        for (uint32_t command_id = 0; command_id < REFLECTION_COMMAND_COUNT; ++command_id) {
+            const CommandCounters* counters = thread_counters->commands[command_id].load(std::memory_order_acquire);
+            if (counters == nullptr) {
+                continue;
+            }
+            CommandSummary& summary = summaries[command_id];
+            summary.count += counters->count.load(std::memory_order_relaxed);
+            summary.total_ns += counters->total_ns.load(std::memory_order_relaxed);
+            uint64_t max_ns = counters->max_ns.load(std::memory_order_relaxed);
+            if (max_ns > summary.max_ns) {
+                summary.max_ns = max_ns;
+            }
+            for (uint32_t bucket = 0; bucket < kLoaderHistogramBucketCount; ++bucket) {
+                summary.buckets[bucket] += counters->buckets[bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return summaries;
+}
+
+bool ReadEnabledFromEnvironment() {
+    return PlatformUtilsGetEnv("XR_LOADER_COMMAND_STATS") == "1" || !PlatformUtilsGetEnv("XR_LOADER_COMMAND_STATS_FILE").empty();
+}
+
+}  // namespace
+
+bool LoaderCommandStats::IsEnabled() {
+    static const bool enabled = ReadEnabledFromEnvironment();
+    return enabled;
+}
+
+void LoaderCommandStats::Record(uint32_t command_id, uint64_t duration_ns) {
+    if (command_id >= REFLECTION_COMMAND_COUNT) {
+        return;
+    }
+    ThreadCounters& thread_counters = GetThreadCounters();
+    CommandCounters* counters = thread_counters.commands[command_id].load(std::memory_order_relaxed);
+    if (counters == nullptr) {
+        counters = new CommandCounters;
+        thread_counters.commands[command_id].store(counters, std::memory_order_release);
+    }
+    AddRelaxed(counters->count, 1);
+    AddRelaxed(counters->total_ns, duration_ns);
+    if (duration_ns > counters->max_ns.load(std::memory_order_relaxed)) {
+        counters->max_ns.store(duration_ns, std::memory_order_relaxed);
+    }
+    AddRelaxed(counters->buckets[LoaderHistogramBucket(duration_ns)], 1);
+}
+
+XrResult LoaderCommandStats::GetStatistics(uint32_t statistics_capacity_input, uint32_t* statistics_count_output,
+                                           XrLoaderCommandStatistics* statistics) {
+    if (statistics_count_output == nullptr) {
+        LoaderLogger::LogValidationErrorMessage("VUID-xrLoaderGetCommandStatistics-statisticsCountOutput-parameter",
+                                                "xrLoaderGetCommandStatistics", "statisticsCountOutput must be non-NULL");
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+
+    std::vector<CommandSummary> summaries = SummarizeCommands();
+    uint32_t called_count = 0;
+    for (const auto& summary : summaries) {
+        if (summary.count > 0) {
+            ++called_count;
+        }
+    }
+    *statistics_count_output = called_count;
+    if (statistics_capacity_input == 0) {
+        return XR_SUCCESS;
+    }
+    if (statistics_capacity_input < called_count) {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    if (statistics == nullptr) {
+        LoaderLogger::LogValidationErrorMessage("VUID-xrLoaderGetCommandStatistics-statistics-parameter",
+                                                "xrLoaderGetCommandStatistics", "statistics must be non-NULL");
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+
+    uint32_t index = 0;
+    for (uint32_t command_id = 0; command_id < REFLECTION_COMMAND_COUNT; ++command_id) {
+        const CommandSummary& summary = summaries[command_id];
+        if (summary.count == 0) {
+            continue;
+        }
+        XrLoaderCommandStatistics& out = statistics[index++];
+        out.commandName = g_reflection_command_names[command_id];
+        out.callCount = summary.count;
+        out.totalDuration = static_cast<XrDuration>(summary.total_ns);
+        out.maxDuration = static_cast<XrDuration>(summary.max_ns);
+        out.p50Duration = static_cast<XrDuration>(summary.Percentile(50.0));
+        out.p95Duration = static_cast<XrDuration>(summary.Percentile(95.0));
+        out.p99Duration = static_cast<XrDuration>(summary.Percentile(99.0));
+    }
+    return XR_SUCCESS;
+}
+
+void LoaderCommandStats::WriteToFile(const char* command_name) {
+    if (!IsEnabled()) {
+        return;
+    }
+    std::string file_name = PlatformUtilsGetEnv("XR_LOADER_COMMAND_STATS_FILE");
+    if (file_name.empty()) {
+        return;
+    }
+    std::ofstream out(file_name, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        LoaderLogger::LogErrorMessage(command_name, "Failed to open command statistics file " + file_name);
+        return;
+    }
+
+    std::vector<CommandSummary> summaries = SummarizeCommands();
+    out << std::fixed << std::setprecision(3);
+    out << "command,calls,total_us,mean_us,p50_us,p95_us,p99_us,max_us\n";
+    for (uint32_t command_id = 0; command_id < REFLECTION_COMMAND_COUNT; ++command_id) {
+        const CommandSummary& summary = summaries[command_id];
+        if (summary.count == 0) {
+            continue;
+        }
+        out << g_reflection_command_names[command_id] << ',' << summary.count << ',' << summary.total_ns / 1000.0 << ','
+            << static_cast<double>(summary.total_ns) / static_cast<double>(summary.count) / 1000.0 << ','
+            << summary.Percentile(50.0) / 1000.0 << ',' << summary.Percentile(95.0) / 1000.0 << ','
+            << summary.Percentile(99.0) / 1000.0 << ',' << summary.max_ns / 1000.0 << '\n';
+    }
+    out.close();
+    if (out.fail()) {
+        LoaderLogger::LogErrorMessage(command_name, "Failed to write command statistics file " + file_name);
+    } else {
+        LoaderLogger::LogInfoMessage(command_name, "Wrote command statistics to " + file_name);
+    }
+}
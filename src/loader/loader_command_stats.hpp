@@ -0,0 +1,69 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include "loader_specific_api.h"
+
+#include <openxr/openxr.h>
+
+#include <chrono>
+#include <cstdint>
+
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+
+// Call counts and latency histograms for the loader trampolines.
+//
+// Each thread records into its own counters, which are only ever written by that thread,
+// so the hot path takes no lock and does no read-modify-write on shared cache lines.
+// Readers sum the counters of all threads.
+class LoaderCommandStats {
+   public:
+    // True when enabled through XR_LOADER_COMMAND_STATS=1 or XR_LOADER_COMMAND_STATS_FILE.
+    static bool IsEnabled();
+
+    // command_id is the ReflectionCommand of the command.
+    static void Record(uint32_t command_id, uint64_t duration_ns);
+
+    // Implementation of xrLoaderGetCommandStatistics.
+    static XrResult GetStatistics(uint32_t statistics_capacity_input, uint32_t* statistics_count_output,
+                                  XrLoaderCommandStatistics* statistics);
+
+    // Writes a CSV summary to XR_LOADER_COMMAND_STATS_FILE, if set - called at xrDestroyInstance.
+    static void WriteToFile(const char* command_name);
+};
+
+// Records the time from its construction to its destruction against a command.
+class LoaderCommandTimer {
+   public:
+    explicit LoaderCommandTimer(uint32_t command_id) : _command_id(command_id), _enabled(LoaderCommandStats::IsEnabled()) {
+        if (_enabled) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+    ~LoaderCommandTimer() {
+        if (_enabled) {
+            auto duration = std::chrono::steady_clock::now() - _start;
+            LoaderCommandStats::Record(_command_id,
+                                       static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+        }
+    }
+
+    LoaderCommandTimer(const LoaderCommandTimer&) = delete;
+    LoaderCommandTimer& operator=(const LoaderCommandTimer&) = delete;
+
+   private:
+    uint32_t _command_id;
+    bool _enabled;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#define XRLOADER_TIME_COMMAND(command_id) LoaderCommandTimer loader_command_timer(command_id)
+
+#else  // !XRLOADER_ENABLE_COMMAND_STATS
+
+#define XRLOADER_TIME_COMMAND(command_id)
+
+#endif  // XRLOADER_ENABLE_COMMAND_STATS
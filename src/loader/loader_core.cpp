@@ -11,16 +11,21 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif  // defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
 
+#include "allocation_callbacks.h"
 #include "api_layer_interface.hpp"
 #include "exception_handling.hpp"
 #include "hex_and_handles.h"
+#include "loader_command_stats.hpp"
+#include "loader_extension_set.hpp"
 #include "loader_instance.hpp"
 #include "loader_logger_recorders.hpp"
 #include "loader_logger.hpp"
 #include "loader_platform.hpp"
+#include "loader_specific_api.h"
 #include "runtime_interface.hpp"
 #include "xr_generated_dispatch_table.h"
 #include "xr_generated_loader.hpp"
+#include "xr_generated_reflection.hpp"
 
 #include <openxr/openxr.h>
 
@@ -143,21 +148,17 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrEnumerateInstanceExtensionProperties(cons
     // If this is not in reference to a specific layer, then add the loader-specific extension properties as well.
     // These are extensions that the loader directly supports.
     if (!just_layer_properties) {
+        LoaderExtensionPropertiesIndex properties_index(extension_properties);
         for (const XrExtensionProperties &loader_prop : LoaderInstance::LoaderSpecificExtensions()) {
-            bool found_prop = false;
-            for (XrExtensionProperties &existing_prop : extension_properties) {
-                if (0 == strcmp(existing_prop.extensionName, loader_prop.extensionName)) {
-                    found_prop = true;
-                    // Use the loader version if it is newer
-                    if (existing_prop.extensionVersion < loader_prop.extensionVersion) {
-                        existing_prop.extensionVersion = loader_prop.extensionVersion;
-                    }
-                    break;
+            XrExtensionProperties *existing_prop = properties_index.Find(loader_prop.extensionName);
+            if (nullptr != existing_prop) {
+                // Use the loader version if it is newer
+                if (existing_prop->extensionVersion < loader_prop.extensionVersion) {
+                    existing_prop->extensionVersion = loader_prop.extensionVersion;
                 }
-            }
-            // Only add extensions not supported by the loader
-            if (!found_prop) {
-                extension_properties.push_back(loader_prop);
+            } else {
+                // Only add extensions not supported by the loader
+                properties_index.Append(loader_prop);
             }
         }
     }
@@ -233,17 +234,7 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrCreateInstance(const XrInstanceCreateInfo
 
     std::unique_lock<std::mutex> instance_lock(GetInstanceCreateDestroyMutex());
 
-    // Check if there is already an XrInstance that is alive. If so, another instance cannot be created.
-    // The loader does not support multiple simultaneous instances because the loader is intended to be
-    // usable by apps using future OpenXR APIs (through xrGetInstanceProcAddr). Because the loader would
-    // not be aware of new handle types, it would not be able to look up the appropriate dispatch table
-    // in some cases.
-    if (ActiveLoaderInstance::IsAvailable()) {  // If there is an XrInstance already alive.
-        LoaderLogger::LogErrorMessage("xrCreateInstance", "Loader does not support simultaneous XrInstances");
-        return XR_ERROR_LIMIT_REACHED;
-    }
-
-    std::vector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces;
+    XrSdkVector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces;
     XrResult result;
 
     // Make sure only one thread is attempting to read the JSON files and use the instance.
@@ -265,7 +256,9 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrCreateInstance(const XrInstanceCreateInfo
 
     // Create the loader instance (only send down first runtime interface)
     LoaderInstance *loader_instance = nullptr;
+    XrInstance created_instance = XR_NULL_HANDLE;
     if (XR_SUCCEEDED(result)) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_CREATE_INSTANCE);
         std::unique_ptr<LoaderInstance> owned_loader_instance;
         result = LoaderInstance::CreateInstance(LoaderXrTermGetInstanceProcAddr, LoaderXrTermCreateInstance,
                                                 LoaderXrTermCreateApiLayerInstance, std::move(api_layer_interfaces), info,
@@ -273,6 +266,9 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrCreateInstance(const XrInstanceCreateInfo
         if (XR_SUCCEEDED(result)) {
             loader_instance = owned_loader_instance.get();
             result = ActiveLoaderInstance::Set(std::move(owned_loader_instance), "xrCreateInstance");
+            if (XR_SUCCEEDED(result)) {
+                created_instance = loader_instance->GetInstanceHandle();
+            }
         }
     }
 
@@ -297,9 +293,11 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrCreateInstance(const XrInstanceCreateInfo
     }
 
     if (XR_FAILED(result)) {
-        // Ensure the global loader instance and runtime are destroyed if something went wrong.
-        ActiveLoaderInstance::Remove();
-        RuntimeInterface::UnloadRuntime("xrCreateInstance");
+        // Ensure the loader instance is destroyed if something went wrong, and the runtime too unless other instances use it.
+        ActiveLoaderInstance::Remove(created_instance);
+        if (!ActiveLoaderInstance::IsAvailable()) {
+            RuntimeInterface::UnloadRuntime("xrCreateInstance");
+        }
         LoaderLogger::LogErrorMessage("xrCreateInstance", "xrCreateInstance failed");
     } else {
         *instance = loader_instance->GetInstanceHandle();
@@ -321,12 +319,12 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrDestroyInstance(XrInstance instance) XRLO
     std::unique_lock<std::mutex> loader_instance_lock(GetInstanceCreateDestroyMutex());
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrDestroyInstance");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(instance), "xrDestroyInstance");
     if (XR_FAILED(result)) {
         return result;
     }
 
-    const std::unique_ptr<XrGeneratedDispatchTable> &dispatch_table = loader_instance->DispatchTable();
+    XrGeneratedDispatchTable *dispatch_table = loader_instance->DispatchTable();
 
     // If we allocated a default debug utils messenger, free it
     XrDebugUtilsMessengerEXT messenger = loader_instance->DefaultDebugUtilsMessenger();
@@ -335,18 +333,40 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrDestroyInstance(XrInstance instance) XRLO
     }
 
     // Now destroy the instance
-    if (XR_FAILED(dispatch_table->DestroyInstance(instance))) {
-        LoaderLogger::LogErrorMessage("xrDestroyInstance", "Unknown error occurred calling down chain");
+    {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_DESTROY_INSTANCE);
+        if (XR_FAILED(dispatch_table->DestroyInstance(instance))) {
+            LoaderLogger::LogErrorMessage("xrDestroyInstance", "Unknown error occurred calling down chain");
+        }
     }
 
-    // Get rid of the loader instance. This will make it possible to create another instance in the future.
-    ActiveLoaderInstance::Remove();
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+    LoaderCommandStats::WriteToFile("xrDestroyInstance");
+#endif
+
+    // Get rid of the loader instance, along with the handles recorded for it.
+    ActiveLoaderInstance::Remove(instance);
+
+    {
+        XrLoaderAllocationStatistics loader_statistics;
+        XrLoaderAllocationStatistics api_layer_statistics;
+        XrSdkGetAllocationStatistics(XrSdkModuleAllocationCounters(), &loader_statistics);
+        ApiLayerInterface::GetAllocationStatistics(&api_layer_statistics);
+        std::ostringstream oss;
+        oss << "Allocations: loader " << loader_statistics.currentBytes << " bytes live, " << loader_statistics.peakBytes
+            << " bytes peak, " << loader_statistics.allocationCount << " allocations; API layers "
+            << api_layer_statistics.currentBytes << " bytes live, " << api_layer_statistics.peakBytes << " bytes peak, "
+            << api_layer_statistics.allocationCount << " allocations";
+        LoaderLogger::LogInfoMessage("xrDestroyInstance", oss.str());
+    }
 
     // Lock the instance create/destroy mutex
     LoaderLogger::LogVerboseMessage("xrDestroyInstance", "Completed loader trampoline");
 
-    // Finally, unload the runtime if necessary
-    RuntimeInterface::UnloadRuntime("xrDestroyInstance");
+    // Finally, unload the runtime once no instance uses it
+    if (!ActiveLoaderInstance::IsAvailable()) {
+        RuntimeInterface::UnloadRuntime("xrDestroyInstance");
+    }
 
     return XR_SUCCESS;
 }
@@ -443,24 +463,37 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrTermGetInstanceProcAddr(XrInstance instan
 
     // NOTE: ActiveLoaderInstance cannot be used in this function because it is called before an instance is made active.
 
-    if (0 == strcmp(name, "xrGetInstanceProcAddr")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermGetInstanceProcAddr);
-    } else if (0 == strcmp(name, "xrCreateInstance")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateInstance);
-    } else if (0 == strcmp(name, "xrDestroyInstance")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermDestroyInstance);
-    } else if (0 == strcmp(name, "xrSetDebugUtilsObjectNameEXT")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermSetDebugUtilsObjectNameEXT);
-    } else if (0 == strcmp(name, "xrCreateDebugUtilsMessengerEXT")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateDebugUtilsMessengerEXT);
-    } else if (0 == strcmp(name, "xrDestroyDebugUtilsMessengerEXT")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermDestroyDebugUtilsMessengerEXT);
-    } else if (0 == strcmp(name, "xrSubmitDebugUtilsMessageEXT")) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermSubmitDebugUtilsMessageEXT);
-    } else if (0 == strcmp(name, "xrCreateApiLayerInstance")) {
-        // Special layer version of xrCreateInstance terminator.  If we get called this by a layer,
-        // we simply re-direct the information back into the standard xrCreateInstance terminator.
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateApiLayerInstance);
+    switch (ReflectionCommandFromName(name)) {
+        case REFLECTION_COMMAND_XR_GET_INSTANCE_PROC_ADDR:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermGetInstanceProcAddr);
+            break;
+        case REFLECTION_COMMAND_XR_CREATE_INSTANCE:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateInstance);
+            break;
+        case REFLECTION_COMMAND_XR_DESTROY_INSTANCE:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermDestroyInstance);
+            break;
+        case REFLECTION_COMMAND_XR_SET_DEBUG_UTILS_OBJECT_NAME_EXT:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermSetDebugUtilsObjectNameEXT);
+            break;
+        case REFLECTION_COMMAND_XR_CREATE_DEBUG_UTILS_MESSENGER_EXT:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateDebugUtilsMessengerEXT);
+            break;
+        case REFLECTION_COMMAND_XR_DESTROY_DEBUG_UTILS_MESSENGER_EXT:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermDestroyDebugUtilsMessengerEXT);
+            break;
+        case REFLECTION_COMMAND_XR_SUBMIT_DEBUG_UTILS_MESSAGE_EXT:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermSubmitDebugUtilsMessageEXT);
+            break;
+        case REFLECTION_COMMAND_COUNT:
+            if (0 == strcmp(name, "xrCreateApiLayerInstance")) {
+                // Special layer version of xrCreateInstance terminator.  If we get called this by a layer,
+                // we simply re-direct the information back into the standard xrCreateInstance terminator.
+                *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrTermCreateApiLayerInstance);
+            }
+            break;
+        default:
+            break;
     }
 
     if (nullptr != *function) {
@@ -484,12 +517,19 @@ XRAPI_ATTR XrResult XRAPI_CALL xrCreateDebugUtilsMessengerEXT(XrInstance instanc
     }
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrCreateDebugUtilsMessengerEXT");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(instance), "xrCreateDebugUtilsMessengerEXT");
     if (XR_FAILED(result)) {
         return result;
     }
 
-    result = loader_instance->DispatchTable()->CreateDebugUtilsMessengerEXT(instance, createInfo, messenger);
+    {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_CREATE_DEBUG_UTILS_MESSENGER_EXT);
+        result = loader_instance->DispatchTable()->CreateDebugUtilsMessengerEXT(instance, createInfo, messenger);
+    }
+    if (XR_SUCCEEDED(result)) {
+        ActiveLoaderInstance::AddHandle(loader_instance, MakeHandleGeneric(*messenger), MakeHandleGeneric(instance),
+                                        "xrCreateDebugUtilsMessengerEXT");
+    }
     LoaderLogger::LogVerboseMessage("xrCreateDebugUtilsMessengerEXT", "Completed loader trampoline");
     return result;
 }
@@ -497,8 +537,7 @@ XRLOADER_ABI_CATCH_BAD_ALLOC_OOM XRLOADER_ABI_CATCH_FALLBACK
 
     XRAPI_ATTR XrResult XRAPI_CALL
     xrDestroyDebugUtilsMessengerEXT(XrDebugUtilsMessengerEXT messenger) XRLOADER_ABI_TRY {
-    // TODO: get instance from messenger in loader
-    // Also, is the loader really doing all this every call?
+    // TODO: is the loader really doing all this every call?
     LoaderLogger::LogVerboseMessage("xrDestroyDebugUtilsMessengerEXT", "Entering loader trampoline");
 
     if (messenger == XR_NULL_HANDLE) {
@@ -507,12 +546,18 @@ XRLOADER_ABI_CATCH_BAD_ALLOC_OOM XRLOADER_ABI_CATCH_FALLBACK
     }
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrDestroyDebugUtilsMessengerEXT");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(messenger), "xrDestroyDebugUtilsMessengerEXT");
     if (XR_FAILED(result)) {
         return result;
     }
 
-    result = loader_instance->DispatchTable()->DestroyDebugUtilsMessengerEXT(messenger);
+    {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_DESTROY_DEBUG_UTILS_MESSENGER_EXT);
+        result = loader_instance->DispatchTable()->DestroyDebugUtilsMessengerEXT(messenger);
+    }
+    if (XR_SUCCEEDED(result)) {
+        ActiveLoaderInstance::RemoveHandle(loader_instance, MakeHandleGeneric(messenger));
+    }
     LoaderLogger::LogVerboseMessage("xrDestroyDebugUtilsMessengerEXT", "Completed loader trampoline");
     return result;
 }
@@ -533,13 +578,15 @@ XRAPI_ATTR XrResult XRAPI_CALL xrSessionBeginDebugUtilsLabelRegionEXT(XrSession
     }
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrSessionBeginDebugUtilsLabelRegionEXT");
+    XrResult result =
+        ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(session), "xrSessionBeginDebugUtilsLabelRegionEXT");
     if (XR_FAILED(result)) {
         return result;
     }
     LoaderLogger::GetInstance().BeginLabelRegion(session, labelInfo);
-    const std::unique_ptr<XrGeneratedDispatchTable> &dispatch_table = loader_instance->DispatchTable();
+    XrGeneratedDispatchTable *dispatch_table = loader_instance->DispatchTable();
     if (nullptr != dispatch_table->SessionBeginDebugUtilsLabelRegionEXT) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_SESSION_BEGIN_DEBUG_UTILS_LABEL_REGION_EXT);
         return dispatch_table->SessionBeginDebugUtilsLabelRegionEXT(session, labelInfo);
     }
     return XR_SUCCESS;
@@ -553,14 +600,16 @@ XRAPI_ATTR XrResult XRAPI_CALL xrSessionEndDebugUtilsLabelRegionEXT(XrSession se
     }
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrSessionEndDebugUtilsLabelRegionEXT");
+    XrResult result =
+        ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(session), "xrSessionEndDebugUtilsLabelRegionEXT");
     if (XR_FAILED(result)) {
         return result;
     }
 
     LoaderLogger::GetInstance().EndLabelRegion(session);
-    const std::unique_ptr<XrGeneratedDispatchTable> &dispatch_table = loader_instance->DispatchTable();
+    XrGeneratedDispatchTable *dispatch_table = loader_instance->DispatchTable();
     if (nullptr != dispatch_table->SessionEndDebugUtilsLabelRegionEXT) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_SESSION_END_DEBUG_UTILS_LABEL_REGION_EXT);
         return dispatch_table->SessionEndDebugUtilsLabelRegionEXT(session);
     }
     return XR_SUCCESS;
@@ -575,7 +624,7 @@ XRAPI_ATTR XrResult XRAPI_CALL xrSessionInsertDebugUtilsLabelEXT(XrSession sessi
     }
 
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrSessionInsertDebugUtilsLabelEXT");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(session), "xrSessionInsertDebugUtilsLabelEXT");
     if (XR_FAILED(result)) {
         return result;
     }
@@ -589,8 +638,9 @@ XRAPI_ATTR XrResult XRAPI_CALL xrSessionInsertDebugUtilsLabelEXT(XrSession sessi
 
     LoaderLogger::GetInstance().InsertLabel(session, labelInfo);
 
-    const std::unique_ptr<XrGeneratedDispatchTable> &dispatch_table = loader_instance->DispatchTable();
+    XrGeneratedDispatchTable *dispatch_table = loader_instance->DispatchTable();
     if (nullptr != dispatch_table->SessionInsertDebugUtilsLabelEXT) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_SESSION_INSERT_DEBUG_UTILS_LABEL_EXT);
         return dispatch_table->SessionInsertDebugUtilsLabelEXT(session, labelInfo);
     }
 
@@ -602,8 +652,9 @@ XRLOADER_ABI_CATCH_FALLBACK
 XRAPI_ATTR XrResult XRAPI_CALL xrSetDebugUtilsObjectNameEXT(XrInstance instance,
                                                             const XrDebugUtilsObjectNameInfoEXT *nameInfo) XRLOADER_ABI_TRY {
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrSetDebugUtilsObjectNameEXT");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(instance), "xrSetDebugUtilsObjectNameEXT");
     if (XR_SUCCEEDED(result)) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_SET_DEBUG_UTILS_OBJECT_NAME_EXT);
         result = loader_instance->DispatchTable()->SetDebugUtilsObjectNameEXT(instance, nameInfo);
     }
     return result;
@@ -615,8 +666,9 @@ XRAPI_ATTR XrResult XRAPI_CALL xrSubmitDebugUtilsMessageEXT(
     XrInstance instance, XrDebugUtilsMessageSeverityFlagsEXT messageSeverity, XrDebugUtilsMessageTypeFlagsEXT messageTypes,
     const XrDebugUtilsMessengerCallbackDataEXT *callbackData) XRLOADER_ABI_TRY {
     LoaderInstance *loader_instance;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrSubmitDebugUtilsMessageEXT");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(instance), "xrSubmitDebugUtilsMessageEXT");
     if (XR_SUCCEEDED(result)) {
+        XRLOADER_TIME_COMMAND(REFLECTION_COMMAND_XR_SUBMIT_DEBUG_UTILS_MESSAGE_EXT);
         result =
             loader_instance->DispatchTable()->SubmitDebugUtilsMessageEXT(instance, messageSeverity, messageTypes, callbackData);
     }
@@ -704,6 +756,42 @@ LoaderXrTermSetDebugUtilsObjectNameEXT(XrInstance instance, const XrDebugUtilsOb
 }
 XRLOADER_ABI_CATCH_FALLBACK
 
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+// Loader-specific, see loader_specific_api.h
+XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetCommandStatistics(uint32_t statisticsCapacityInput, uint32_t *statisticsCountOutput,
+                                                            XrLoaderCommandStatistics *statistics) XRLOADER_ABI_TRY {
+    return LoaderCommandStats::GetStatistics(statisticsCapacityInput, statisticsCountOutput, statistics);
+}
+XRLOADER_ABI_CATCH_FALLBACK
+#endif  // XRLOADER_ENABLE_COMMAND_STATS
+
+// Loader-specific, see loader_specific_api.h
+XRAPI_ATTR XrResult XRAPI_CALL LoaderXrSetAllocationCallbacks(const XrLoaderAllocationCallbacks *allocator) XRLOADER_ABI_TRY {
+    if (nullptr != allocator && (nullptr == allocator->pfnAllocation || nullptr == allocator->pfnFree)) {
+        LoaderLogger::LogValidationErrorMessage("VUID-xrLoaderSetAllocationCallbacks-allocator-parameter",
+                                                "xrLoaderSetAllocationCallbacks", "pfnAllocation and pfnFree must be non-NULL");
+        return XR_ERROR_VALIDATION_FAILURE;
+    }
+    XrSdkSetAllocationCallbacks(allocator);
+    LoaderLogger::LogInfoMessage("xrLoaderSetAllocationCallbacks",
+                                 nullptr != allocator ? "Installed allocation callbacks" : "Removed allocation callbacks");
+    return XR_SUCCESS;
+}
+XRLOADER_ABI_CATCH_FALLBACK
+
+// Loader-specific, see loader_specific_api.h
+XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetAllocationStatistics(XrLoaderAllocationStatistics *loaderStatistics,
+                                                               XrLoaderAllocationStatistics *apiLayerStatistics) XRLOADER_ABI_TRY {
+    if (nullptr != loaderStatistics) {
+        XrSdkGetAllocationStatistics(XrSdkModuleAllocationCounters(), loaderStatistics);
+    }
+    if (nullptr != apiLayerStatistics) {
+        ApiLayerInterface::GetAllocationStatistics(apiLayerStatistics);
+    }
+    return XR_SUCCESS;
+}
+XRLOADER_ABI_CATCH_FALLBACK
+
 XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetInstanceProcAddr(XrInstance instance, const char *name,
                                                            PFN_xrVoidFunction *function) XRLOADER_ABI_TRY {
     // Initialize the function to nullptr in case it does not get caught in a known case
@@ -721,10 +809,30 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetInstanceProcAddr(XrInstance instance,
         return XR_ERROR_VALIDATION_FAILURE;
     }
 
+    // The loader's own commands are not in the registry, and need no instance.
+    const ReflectionCommand command = ReflectionCommandFromName(name);
+    if (REFLECTION_COMMAND_COUNT == command) {
+        if (strcmp(name, "xrLoaderGetCommandStatistics") == 0) {
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrGetCommandStatistics);
+            return XR_SUCCESS;
+#else
+            return XR_ERROR_FUNCTION_UNSUPPORTED;
+#endif
+        } else if (strcmp(name, "xrLoaderSetAllocationCallbacks") == 0) {
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrSetAllocationCallbacks);
+            return XR_SUCCESS;
+        } else if (strcmp(name, "xrLoaderGetAllocationStatistics") == 0) {
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrGetAllocationStatistics);
+            return XR_SUCCESS;
+        }
+    }
+
     if (instance == XR_NULL_HANDLE) {
         // Null instance is allowed for a few specific API entry points, otherwise return error
-        if (strcmp(name, "xrCreateInstance") != 0 && strcmp(name, "xrEnumerateApiLayerProperties") != 0 &&
-            strcmp(name, "xrEnumerateInstanceExtensionProperties") != 0 && strcmp(name, "xrInitializeLoaderKHR") != 0) {
+        if (command != REFLECTION_COMMAND_XR_CREATE_INSTANCE && command != REFLECTION_COMMAND_XR_ENUMERATE_API_LAYER_PROPERTIES &&
+            command != REFLECTION_COMMAND_XR_ENUMERATE_INSTANCE_EXTENSION_PROPERTIES &&
+            command != REFLECTION_COMMAND_XR_INITIALIZE_LOADER_KHR) {
             // TODO why is xrGetInstanceProcAddr not listed in here?
             std::string error_str = "XR_NULL_HANDLE for instance but query for ";
             error_str += name;
@@ -736,33 +844,36 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetInstanceProcAddr(XrInstance instance,
     }
 
     // These functions must always go through the loader's implementation (trampoline).
-    if (strcmp(name, "xrGetInstanceProcAddr") == 0) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrGetInstanceProcAddr);
-        return XR_SUCCESS;
-    } else if (strcmp(name, "xrInitializeLoaderKHR") == 0) {
+    switch (command) {
+        case REFLECTION_COMMAND_XR_GET_INSTANCE_PROC_ADDR:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrGetInstanceProcAddr);
+            return XR_SUCCESS;
+        case REFLECTION_COMMAND_XR_INITIALIZE_LOADER_KHR:
 #ifdef XR_KHR_LOADER_INIT_SUPPORT
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrInitializeLoaderKHR);
-        return XR_SUCCESS;
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrInitializeLoaderKHR);
+            return XR_SUCCESS;
 #else
-        return XR_ERROR_FUNCTION_UNSUPPORTED;
+            return XR_ERROR_FUNCTION_UNSUPPORTED;
 #endif
-    } else if (strcmp(name, "xrEnumerateApiLayerProperties") == 0) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrEnumerateApiLayerProperties);
-        return XR_SUCCESS;
-    } else if (strcmp(name, "xrEnumerateInstanceExtensionProperties") == 0) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrEnumerateInstanceExtensionProperties);
-        return XR_SUCCESS;
-    } else if (strcmp(name, "xrCreateInstance") == 0) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrCreateInstance);
-        return XR_SUCCESS;
-    } else if (strcmp(name, "xrDestroyInstance") == 0) {
-        *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrDestroyInstance);
-        return XR_SUCCESS;
+        case REFLECTION_COMMAND_XR_ENUMERATE_API_LAYER_PROPERTIES:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrEnumerateApiLayerProperties);
+            return XR_SUCCESS;
+        case REFLECTION_COMMAND_XR_ENUMERATE_INSTANCE_EXTENSION_PROPERTIES:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrEnumerateInstanceExtensionProperties);
+            return XR_SUCCESS;
+        case REFLECTION_COMMAND_XR_CREATE_INSTANCE:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrCreateInstance);
+            return XR_SUCCESS;
+        case REFLECTION_COMMAND_XR_DESTROY_INSTANCE:
+            *function = reinterpret_cast<PFN_xrVoidFunction>(LoaderXrDestroyInstance);
+            return XR_SUCCESS;
+        default:
+            break;
     }
 
     // Remainder of the functions require the LoaderInstance.
     LoaderInstance *loader_instance = nullptr;
-    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "xrGetInstanceProcAddr");
+    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(instance), "xrGetInstanceProcAddr");
     if (XR_FAILED(result)) {
         return result;
     }
@@ -770,23 +881,33 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetInstanceProcAddr(XrInstance instance,
     // XR_EXT_debug_utils is built into the loader and handled partly through the xrGetInstanceProcAddress terminator,
     // but the check to see if the extension is enabled must be done here where ActiveLoaderInstance is safe to use.
     if (*function == nullptr) {
-        if (strcmp(name, "xrCreateDebugUtilsMessengerEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrCreateDebugUtilsMessengerEXT);
-        } else if (strcmp(name, "xrDestroyDebugUtilsMessengerEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrDestroyDebugUtilsMessengerEXT);
-        } else if (strcmp(name, "xrSessionBeginDebugUtilsLabelRegionEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionBeginDebugUtilsLabelRegionEXT);
-        } else if (strcmp(name, "xrSessionEndDebugUtilsLabelRegionEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionEndDebugUtilsLabelRegionEXT);
-        } else if (strcmp(name, "xrSessionInsertDebugUtilsLabelEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionInsertDebugUtilsLabelEXT);
-        } else if (strcmp(name, "xrSetDebugUtilsObjectNameEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrSetDebugUtilsObjectNameEXT);
-        } else if (strcmp(name, "xrSubmitDebugUtilsMessageEXT") == 0) {
-            *function = reinterpret_cast<PFN_xrVoidFunction>(xrSubmitDebugUtilsMessageEXT);
+        switch (command) {
+            case REFLECTION_COMMAND_XR_CREATE_DEBUG_UTILS_MESSENGER_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrCreateDebugUtilsMessengerEXT);
+                break;
+            case REFLECTION_COMMAND_XR_DESTROY_DEBUG_UTILS_MESSENGER_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrDestroyDebugUtilsMessengerEXT);
+                break;
+            case REFLECTION_COMMAND_XR_SESSION_BEGIN_DEBUG_UTILS_LABEL_REGION_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionBeginDebugUtilsLabelRegionEXT);
+                break;
+            case REFLECTION_COMMAND_XR_SESSION_END_DEBUG_UTILS_LABEL_REGION_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionEndDebugUtilsLabelRegionEXT);
+                break;
+            case REFLECTION_COMMAND_XR_SESSION_INSERT_DEBUG_UTILS_LABEL_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrSessionInsertDebugUtilsLabelEXT);
+                break;
+            case REFLECTION_COMMAND_XR_SET_DEBUG_UTILS_OBJECT_NAME_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrSetDebugUtilsObjectNameEXT);
+                break;
+            case REFLECTION_COMMAND_XR_SUBMIT_DEBUG_UTILS_MESSAGE_EXT:
+                *function = reinterpret_cast<PFN_xrVoidFunction>(xrSubmitDebugUtilsMessageEXT);
+                break;
+            default:
+                break;
         }
 
-        if (*function != nullptr && !loader_instance->ExtensionIsEnabled("XR_EXT_debug_utils")) {
+        if (*function != nullptr && !loader_instance->ExtensionIsEnabled(LOADER_EXTENSION_XR_EXT_debug_utils)) {
             // The function matches one of the XR_EXT_debug_utils functions but the extension is not enabled.
             *function = nullptr;
             return XR_ERROR_FUNCTION_UNSUPPORTED;
@@ -799,7 +920,15 @@ XRAPI_ATTR XrResult XRAPI_CALL LoaderXrGetInstanceProcAddr(XrInstance instance,
     }
 
     // If the function is not supported by the loader, call down to the next layer.
-    return loader_instance->GetInstanceProcAddr(name, function);
+    result = loader_instance->GetInstanceProcAddr(name, function);
+    if (XR_SUCCEEDED(result) && *function != nullptr) {
+        // Handles created or destroyed by the command may be passed to the trampolines, so the loader records them.
+        PFN_xrVoidFunction tracking_function = LoaderHandleTrackingFunction(command);
+        if (tracking_function != nullptr) {
+            *function = tracking_function;
+        }
+    }
+    return result;
 }
 XRLOADER_ABI_CATCH_FALLBACK
 
@@ -0,0 +1,65 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#include "loader_extension_set.hpp"
+
+#include <openxr/openxr.h>
+
+#include <string>
+#include <vector>
+
+void LoaderExtensionSet::Insert(const char* name) {
+    LoaderExtensionId id = LoaderExtensionIdFromName(name);
+    if (id < LOADER_EXTENSION_COUNT) {
+        _known.set(id);
+    } else {
+        _unknown.emplace(name);
+    }
+}
+
+bool LoaderExtensionSet::Contains(const char* name) const {
+    LoaderExtensionId id = LoaderExtensionIdFromName(name);
+    if (id < LOADER_EXTENSION_COUNT) {
+        return _known.test(id);
+    }
+    return !_unknown.empty() && _unknown.count(name) != 0;
+}
+
+void LoaderExtensionSet::Merge(const LoaderExtensionSet& other) {
+    _known |= other._known;
+    _unknown.insert(other._unknown.begin(), other._unknown.end());
+}
+
+LoaderExtensionPropertiesIndex::LoaderExtensionPropertiesIndex(std::vector<XrExtensionProperties>& properties)
+    : _properties(properties) {
+    for (size_t position = 0; position < _properties.size(); ++position) {
+        LoaderExtensionId id = LoaderExtensionIdFromName(_properties[position].extensionName);
+        if (id < LOADER_EXTENSION_COUNT) {
+            _known_positions[id] = static_cast<uint32_t>(position + 1);
+        } else {
+            _unknown_positions.emplace(_properties[position].extensionName, position);
+        }
+    }
+}
+
+XrExtensionProperties* LoaderExtensionPropertiesIndex::Find(const char* name) {
+    LoaderExtensionId id = LoaderExtensionIdFromName(name);
+    if (id < LOADER_EXTENSION_COUNT) {
+        uint32_t position = _known_positions[id];
+        return position == 0 ? nullptr : &_properties[position - 1];
+    }
+    auto found = _unknown_positions.find(name);
+    return found == _unknown_positions.end() ? nullptr : &_properties[found->second];
+}
+
+void LoaderExtensionPropertiesIndex::Append(const XrExtensionProperties& property) {
+    LoaderExtensionId id = LoaderExtensionIdFromName(property.extensionName);
+    if (id < LOADER_EXTENSION_COUNT) {
+        _known_positions[id] = static_cast<uint32_t>(_properties.size() + 1);
+    } else {
+        _unknown_positions.emplace(property.extensionName, _properties.size());
+    }
+    _properties.push_back(property);
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include "allocation_callbacks.h"
+#include "xr_generated_loader_extensions.hpp"
+
+#include <openxr/openxr.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A set of extension names.  Extensions known from the registry are kept as bits indexed by
+// LoaderExtensionId, so checking an ID and merging two sets are bit operations.  Any other name
+// (a vendor extension newer than this loader, for example) falls back to a hash set.
+class LoaderExtensionSet {
+   public:
+    void Insert(LoaderExtensionId id) { _known.set(id); }
+    void Insert(const char* name);
+
+    bool Contains(LoaderExtensionId id) const { return id < LOADER_EXTENSION_COUNT && _known.test(id); }
+    bool Contains(const char* name) const;
+
+    // Add every extension of other to this set.
+    void Merge(const LoaderExtensionSet& other);
+
+   private:
+    std::bitset<LOADER_EXTENSION_COUNT> _known;
+    XrSdkUnorderedSet<XrSdkString, XrSdkStringHash> _unknown;
+};
+
+// Indexes a list of extension properties by name, so that merging more properties into it
+// does not need a search of the whole list for each one.  The list must only be grown
+// through Append while the index is in use.
+class LoaderExtensionPropertiesIndex {
+   public:
+    explicit LoaderExtensionPropertiesIndex(std::vector<XrExtensionProperties>& properties);
+
+    // Returns the entry with the same name, or nullptr.
+    XrExtensionProperties* Find(const char* name);
+
+    void Append(const XrExtensionProperties& property);
+
+   private:
+    std::vector<XrExtensionProperties>& _properties;
+    // Position in _properties plus one for each known extension, zero when absent.
+    std::array<uint32_t, LOADER_EXTENSION_COUNT> _known_positions{};
+    std::unordered_map<std::string, size_t> _unknown_positions;
+};
@@ -0,0 +1,59 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include <cstdint>
+
+// Log-linear histogram of durations in nanoseconds, shared by the command statistics and the label
+// profiler: values below 8ns get a bucket each, every power of two above that is split into 8 linear
+// sub-buckets, so a bucket is never wider than 1/8th of its lower bound.  The last bucket also holds
+// everything above 2^39ns (about 9 minutes).
+const uint32_t kLoaderHistogramSubBucketBits = 3;
+const uint32_t kLoaderHistogramSubBucketCount = 1u << kLoaderHistogramSubBucketBits;
+const uint32_t kLoaderHistogramBucketCount = kLoaderHistogramSubBucketCount * 38;
+
+inline uint32_t LoaderHistogramBucket(uint64_t value) {
+    if (value < kLoaderHistogramSubBucketCount) {
+        return static_cast<uint32_t>(value);
+    }
+    uint32_t exponent = 0;
+    for (uint64_t v = value; v > 1; v >>= 1) {
+        ++exponent;
+    }
+    uint32_t sub_bucket =
+        static_cast<uint32_t>(value >> (exponent - kLoaderHistogramSubBucketBits)) & (kLoaderHistogramSubBucketCount - 1);
+    uint32_t bucket = kLoaderHistogramSubBucketCount * (exponent - kLoaderHistogramSubBucketBits + 1) + sub_bucket;
+    return bucket < kLoaderHistogramBucketCount ? bucket : kLoaderHistogramBucketCount - 1;
+}
+
+// Largest value that falls in the given bucket
+inline uint64_t LoaderHistogramBucketUpperBound(uint32_t bucket) {
+    if (bucket < kLoaderHistogramSubBucketCount) {
+        return bucket;
+    }
+    uint32_t exponent = bucket / kLoaderHistogramSubBucketCount + kLoaderHistogramSubBucketBits - 1;
+    uint64_t sub_bucket = bucket % kLoaderHistogramSubBucketCount;
+    uint64_t lower = (kLoaderHistogramSubBucketCount + sub_bucket) << (exponent - kLoaderHistogramSubBucketBits);
+    return lower + (uint64_t(1) << (exponent - kLoaderHistogramSubBucketBits)) - 1;
+}
+
+// Percentile of the count values in buckets, as the upper bound of the bucket holding it, but no more
+// than the largest value seen.
+inline uint64_t LoaderHistogramPercentile(const uint64_t* buckets, uint64_t count, uint64_t max_value, double percent) {
+    auto rank = static_cast<uint64_t>(percent / 100.0 * static_cast<double>(count) + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < kLoaderHistogramBucketCount; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint64_t upper = LoaderHistogramBucketUpperBound(bucket);
+            return upper < max_value ? upper : max_value;
+        }
+    }
+    return max_value;
+}
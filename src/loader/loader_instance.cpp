@@ -14,6 +14,7 @@
 #include "loader_instance.hpp"
 
 #include "api_layer_interface.hpp"
+#include "concurrent_handle_registry.h"
 #include "hex_and_handles.h"
 #include "loader_interfaces.h"
 #include "loader_logger.hpp"
@@ -23,44 +24,185 @@
 
 #include <openxr/openxr.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace {
-std::unique_ptr<LoaderInstance>& GetSetCurrentLoaderInstance() {
-    static std::unique_ptr<LoaderInstance> current_loader_instance;
-    return current_loader_instance;
+struct LoaderInstanceRegistry {
+    std::mutex mutex;
+    XrSdkVector<std::unique_ptr<LoaderInstance>> instances;
+    // The only alive instance, or nullptr when there are none or several.  This keeps the trampolines
+    // from needing a handle lookup in the common case of a single instance.
+    std::atomic<LoaderInstance*> sole_instance{nullptr};
+    // Owner of every XrInstance and of the handles created through the trampolines.
+    ConcurrentHandleRegistry<uint64_t, LoaderInstance> handles;
+    // The handles created from another handle than their XrInstance, which are destroyed along with that
+    // parent, such as the spaces of a session or the actions of an action set.
+    std::mutex children_mutex;
+    XrSdkUnorderedMap<uint64_t, XrSdkVector<uint64_t>> children;
+    XrSdkUnorderedMap<uint64_t, uint64_t> parents;
+
+    // Forget that handle has a parent or children.  children_mutex must be locked.
+    void ForgetHandleFamily(uint64_t handle) {
+        auto parent = parents.find(handle);
+        if (parent != parents.end()) {
+            auto siblings = children.find(parent->second);
+            if (siblings != children.end()) {
+                auto& handles_of_parent = siblings->second;
+                handles_of_parent.erase(std::remove(handles_of_parent.begin(), handles_of_parent.end(), handle),
+                                        handles_of_parent.end());
+                if (handles_of_parent.empty()) {
+                    children.erase(siblings);
+                }
+            }
+            parents.erase(parent);
+        }
+        children.erase(handle);
+    }
+
+    void UpdateSoleInstance() {
+        sole_instance.store(instances.size() == 1 ? instances.front().get() : nullptr, std::memory_order_release);
+    }
+};
+
+LoaderInstanceRegistry& GetLoaderInstanceRegistry() {
+    static LoaderInstanceRegistry registry;
+    return registry;
 }
 }  // namespace
 
 namespace ActiveLoaderInstance {
 XrResult Set(std::unique_ptr<LoaderInstance> loader_instance, const char* log_function_name) {
-    if (GetSetCurrentLoaderInstance() != nullptr) {
-        LoaderLogger::LogErrorMessage(log_function_name, "Active XrInstance handle already exists");
-        return XR_ERROR_LIMIT_REACHED;
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    uint64_t instance_handle = MakeHandleGeneric(loader_instance->GetInstanceHandle());
+    if (registry.handles.Find(instance_handle) != nullptr) {
+        LoaderLogger::LogErrorMessage(log_function_name, "Runtime returned an XrInstance handle that is already in use");
+        return XR_ERROR_RUNTIME_FAILURE;
     }
 
-    GetSetCurrentLoaderInstance() = std::move(loader_instance);
+    registry.instances.push_back(std::move(loader_instance));
+    LoaderInstance* added = registry.instances.back().get();
+    registry.handles.Insert(instance_handle, added, added);
+    registry.UpdateSoleInstance();
     return XR_SUCCESS;
 }
 
-XrResult Get(LoaderInstance** loader_instance, const char* log_function_name) {
-    *loader_instance = GetSetCurrentLoaderInstance().get();
+XrResult Get(LoaderInstance** loader_instance, uint64_t handle, const char* log_function_name) {
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    *loader_instance = registry.sole_instance.load(std::memory_order_acquire);
+    if (*loader_instance != nullptr) {
+        return XR_SUCCESS;
+    }
+
+    *loader_instance = registry.handles.Find(handle);
     if (*loader_instance == nullptr) {
-        LoaderLogger::LogErrorMessage(log_function_name, "No active XrInstance handle.");
+        if (IsAvailable()) {
+            LoaderLogger::LogErrorMessage(log_function_name, "Handle does not belong to any active XrInstance.");
+        } else {
+            LoaderLogger::LogErrorMessage(log_function_name, "No active XrInstance handle.");
+        }
         return XR_ERROR_HANDLE_INVALID;
     }
 
     return XR_SUCCESS;
 }
 
-bool IsAvailable() { return GetSetCurrentLoaderInstance() != nullptr; }
+bool IsAvailable() {
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    return !registry.instances.empty();
+}
+
+void AddHandle(LoaderInstance* loader_instance, uint64_t handle, uint64_t parent, const char* log_function_name) {
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    LoaderInstance* replaced = registry.handles.Insert(handle, loader_instance, loader_instance);
+    if (replaced != nullptr && replaced != loader_instance) {
+        LoaderLogger::LogErrorMessage(log_function_name,
+                                      "Runtime returned a handle still in use by another XrInstance, which the handle "
+                                      "now belongs to instead");
+    }
 
-void Remove() { GetSetCurrentLoaderInstance().release(); }
+    // A single instance never looks handles up, so the parents of its handles are not recorded: its children
+    // are only forgotten with it or when destroyed themselves, and a value handed out again replaces them.
+    const bool sole = registry.sole_instance.load(std::memory_order_acquire) != nullptr;
+    if (sole && replaced == nullptr) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(registry.children_mutex);
+    if (replaced != nullptr) {
+        registry.ForgetHandleFamily(handle);
+    }
+    // The handles created from the XrInstance are forgotten with it.
+    if (!sole && parent != MakeHandleGeneric(loader_instance->GetInstanceHandle())) {
+        registry.children[parent].push_back(handle);
+        registry.parents[handle] = parent;
+    }
+}
+
+void RemoveHandle(LoaderInstance* loader_instance, uint64_t handle) {
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    if (!registry.handles.EraseIfValue(handle, loader_instance)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(registry.children_mutex);
+    // The children of the handle went with it, and so did theirs.
+    XrSdkVector<uint64_t> destroyed;
+    auto children = registry.children.find(handle);
+    if (children != registry.children.end()) {
+        destroyed = std::move(children->second);
+    }
+    registry.ForgetHandleFamily(handle);
+    while (!destroyed.empty()) {
+        uint64_t child = destroyed.back();
+        destroyed.pop_back();
+        registry.handles.EraseIfValue(child, loader_instance);
+        auto grandchildren = registry.children.find(child);
+        if (grandchildren != registry.children.end()) {
+            destroyed.insert(destroyed.end(), grandchildren->second.begin(), grandchildren->second.end());
+            registry.children.erase(grandchildren);
+        }
+        registry.parents.erase(child);
+    }
+}
+
+void Remove(XrInstance instance) {
+    LoaderInstanceRegistry& registry = GetLoaderInstanceRegistry();
+    // Destroyed once the lock is released
+    std::unique_ptr<LoaderInstance> removed;
+    {
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        auto it = std::find_if(registry.instances.begin(), registry.instances.end(),
+                               [&](const std::unique_ptr<LoaderInstance>& loader_instance) {
+                                   return loader_instance->GetInstanceHandle() == instance;
+                               });
+        if (it == registry.instances.end()) {
+            return;
+        }
+        removed = std::move(*it);
+        registry.instances.erase(it);
+        registry.UpdateSoleInstance();
+        XrSdkVector<uint64_t> erased;
+        registry.handles.EraseOwner(removed.get(), [&erased](uint64_t handle, LoaderInstance*) { erased.push_back(handle); });
+        std::unique_lock<std::mutex> children_lock(registry.children_mutex);
+        for (uint64_t handle : erased) {
+            registry.children.erase(handle);
+            registry.parents.erase(handle);
+        }
+        children_lock.unlock();
+        if (registry.instances.empty()) {
+            registry.handles.ReleaseRetiredTables();
+        }
+    }
+}
 }  // namespace ActiveLoaderInstance
 
 // Extensions that are supported by the loader, but may not be supported
@@ -137,38 +279,22 @@ class InstanceCreateInfoManager {
 XrResult LoaderInstance::CreateInstance(PFN_xrGetInstanceProcAddr get_instance_proc_addr_term,
                                         PFN_xrCreateInstance create_instance_term,
                                         PFN_xrCreateApiLayerInstance create_api_layer_instance_term,
-                                        std::vector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces,
+                                        XrSdkVector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces,
                                         const XrInstanceCreateInfo* info, std::unique_ptr<LoaderInstance>* loader_instance) {
     LoaderLogger::LogVerboseMessage("xrCreateInstance", "Entering LoaderInstance::CreateInstance");
 
-    // Check the list of enabled extensions to make sure something supports them, and, if we do,
-    // add it to the list of enabled extensions
+    // Check the list of enabled extensions to make sure something supports them: the runtime, the loader
+    // or one of the enabled layers.
     XrResult last_error = XR_SUCCESS;
+    LoaderExtensionSet available_extensions = RuntimeInterface::GetRuntime().SupportedExtensions();
+    for (auto& loader_extension : LoaderInstance::LoaderSpecificExtensions()) {
+        available_extensions.Insert(loader_extension.extensionName);
+    }
+    for (auto& layer_interface : api_layer_interfaces) {
+        available_extensions.Merge(layer_interface->SupportedExtensions());
+    }
     for (uint32_t ext = 0; ext < info->enabledExtensionCount; ++ext) {
-        bool found = false;
-        // First check the runtime
-        if (RuntimeInterface::GetRuntime().SupportsExtension(info->enabledExtensionNames[ext])) {
-            found = true;
-        }
-        // Next check the loader
-        if (!found) {
-            for (auto& loader_extension : LoaderInstance::LoaderSpecificExtensions()) {
-                if (strcmp(loader_extension.extensionName, info->enabledExtensionNames[ext]) == 0) {
-                    found = true;
-                    break;
-                }
-            }
-        }
-        // Finally, check the enabled layers
-        if (!found) {
-            for (auto& layer_interface : api_layer_interfaces) {
-                if (layer_interface->SupportsExtension(info->enabledExtensionNames[ext])) {
-                    found = true;
-                    break;
-                }
-            }
-        }
-        if (!found) {
+        if (!available_extensions.Contains(info->enabledExtensionNames[ext])) {
             std::string msg = "LoaderInstance::CreateInstance, no support found for requested extension: ";
             msg += info->enabledExtensionNames[ext];
             LoaderLogger::LogErrorMessage("xrCreateInstance", msg);
@@ -274,13 +400,13 @@ XrResult LoaderInstance::GetInstanceProcAddr(const char* name, PFN_xrVoidFunctio
 }
 
 LoaderInstance::LoaderInstance(XrInstance instance, const XrInstanceCreateInfo* create_info, PFN_xrGetInstanceProcAddr topmost_gipa,
-                               std::vector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces)
+                               XrSdkVector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces)
     : _runtime_instance(instance),
       _topmost_gipa(topmost_gipa),
       _api_layer_interfaces(std::move(api_layer_interfaces)),
-      _dispatch_table(new XrGeneratedDispatchTable{}) {
+      _dispatch_table(XrSdkMakeUnique<XrGeneratedDispatchTable>()) {
     for (uint32_t ext = 0; ext < create_info->enabledExtensionCount; ++ext) {
-        _enabled_extensions.push_back(create_info->enabledExtensionNames[ext]);
+        _enabled_extensions.Insert(create_info->enabledExtensionNames[ext]);
     }
 
     GeneratedXrPopulateDispatchTable(_dispatch_table.get(), instance, topmost_gipa);
@@ -293,11 +419,4 @@ LoaderInstance::~LoaderInstance() {
     LoaderLogger::LogInfoMessage("xrDestroyInstance", oss.str());
 }
 
-bool LoaderInstance::ExtensionIsEnabled(const std::string& extension) {
-    for (std::string& cur_enabled : _enabled_extensions) {
-        if (cur_enabled == extension) {
-            return true;
-        }
-    }
-    return false;
-}
+bool LoaderInstance::ExtensionIsEnabled(const std::string& extension) { return _enabled_extensions.Contains(extension.c_str()); }
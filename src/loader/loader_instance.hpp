@@ -9,13 +9,16 @@
 
 #pragma once
 
+#include "allocation_callbacks.h"
 #include "extra_algorithms.h"
+#include "loader_extension_set.hpp"
 #include "loader_interfaces.h"
 
 #include <openxr/openxr.h>
 
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -26,52 +29,64 @@ class ApiLayerInterface;
 struct XrGeneratedDispatchTable;
 class LoaderInstance;
 
-// Manage the single loader instance that is available.
+// Manage the loader instances that are alive.  Any number of them may exist at the same time.
 namespace ActiveLoaderInstance {
-// Set the active loader instance. This will fail if there is already an active loader instance.
+// Add an active loader instance, reachable from its XrInstance handle.
 XrResult Set(std::unique_ptr<LoaderInstance> loader_instance, const char* log_function_name);
 
-// Returns true if there is an active loader instance.
+// Returns true if there is at least one active loader instance.
 bool IsAvailable();
 
-// Get the active LoaderInstance.
-XrResult Get(LoaderInstance** loader_instance, const char* log_function_name);
+// Get the active LoaderInstance owning handle, which is either an XrInstance or a handle passed to AddHandle.
+// While only one instance is alive, that one is returned without looking the handle up.
+XrResult Get(LoaderInstance** loader_instance, uint64_t handle, const char* log_function_name);
 
-// Destroy the currently active LoaderInstance if there is one. This will make the loader able to create a new XrInstance if needed.
-void Remove();
+// Record that a handle created through a loader trampoline, from the handle parent, belongs to loader_instance.
+// Logs an error if the handle still belonged to another instance, which calls with it no longer go to.
+void AddHandle(LoaderInstance* loader_instance, uint64_t handle, uint64_t parent, const char* log_function_name);
+
+// Forget a handle of loader_instance that was destroyed, along with the handles destroyed with it.  A handle
+// the runtime has since given to another instance is kept.
+void RemoveHandle(LoaderInstance* loader_instance, uint64_t handle);
+
+// Destroy the LoaderInstance of an XrInstance, if there is one, along with the handles recorded for it.
+void Remove(XrInstance instance);
 };  // namespace ActiveLoaderInstance
 
 // Manages information needed by the loader for an XrInstance, such as what extensions are available and the dispatch table.
 class LoaderInstance {
    public:
+    XR_SDK_ALLOCATION_OPERATORS
+
     // Factory method
     static XrResult CreateInstance(PFN_xrGetInstanceProcAddr get_instance_proc_addr_term, PFN_xrCreateInstance create_instance_term,
                                    PFN_xrCreateApiLayerInstance create_api_layer_instance_term,
-                                   std::vector<std::unique_ptr<ApiLayerInterface>> layer_interfaces,
+                                   XrSdkVector<std::unique_ptr<ApiLayerInterface>> layer_interfaces,
                                    const XrInstanceCreateInfo* createInfo, std::unique_ptr<LoaderInstance>* loader_instance);
     static const std::array<XrExtensionProperties, 1>& LoaderSpecificExtensions();
 
     virtual ~LoaderInstance();
 
     XrInstance GetInstanceHandle() { return _runtime_instance; }
-    const std::unique_ptr<XrGeneratedDispatchTable>& DispatchTable() { return _dispatch_table; }
-    std::vector<std::unique_ptr<ApiLayerInterface>>& LayerInterfaces() { return _api_layer_interfaces; }
+    XrGeneratedDispatchTable* DispatchTable() const { return _dispatch_table.get(); }
+    XrSdkVector<std::unique_ptr<ApiLayerInterface>>& LayerInterfaces() { return _api_layer_interfaces; }
     bool ExtensionIsEnabled(const std::string& extension);
+    bool ExtensionIsEnabled(LoaderExtensionId extension) const { return _enabled_extensions.Contains(extension); }
     XrDebugUtilsMessengerEXT DefaultDebugUtilsMessenger() { return _messenger; }
     void SetDefaultDebugUtilsMessenger(XrDebugUtilsMessengerEXT messenger) { _messenger = messenger; }
     XrResult GetInstanceProcAddr(const char* name, PFN_xrVoidFunction* function);
 
    private:
     LoaderInstance(XrInstance instance, const XrInstanceCreateInfo* createInfo, PFN_xrGetInstanceProcAddr topmost_gipa,
-                   std::vector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces);
+                   XrSdkVector<std::unique_ptr<ApiLayerInterface>> api_layer_interfaces);
 
    private:
     XrInstance _runtime_instance{XR_NULL_HANDLE};
     PFN_xrGetInstanceProcAddr _topmost_gipa{nullptr};
-    std::vector<std::string> _enabled_extensions;
-    std::vector<std::unique_ptr<ApiLayerInterface>> _api_layer_interfaces;
+    LoaderExtensionSet _enabled_extensions;
+    XrSdkVector<std::unique_ptr<ApiLayerInterface>> _api_layer_interfaces;
 
-    std::unique_ptr<XrGeneratedDispatchTable> _dispatch_table;
+    XrSdkUniquePtr<XrGeneratedDispatchTable> _dispatch_table;
     // Internal debug messenger created during xrCreateInstance
     XrDebugUtilsMessengerEXT _messenger{XR_NULL_HANDLE};
 };
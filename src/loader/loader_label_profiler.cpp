@@ -0,0 +1,347 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#include "loader_label_profiler.hpp"
+
+#include "hex_and_handles.h"
+#include "loader_logger.hpp"
+#include "platform_utils.hpp"
+
+#include <openxr/openxr.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Number of Chrome trace events kept in memory before they are all appended to the file, so
+// long-running sessions do not grow without limit.
+static const size_t kMaxTraceEvents = 1u << 16;
+
+namespace {
+
+void WriteJsonString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+                        << std::setfill(' ');
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    out << '"';
+}
+
+void WriteCsvString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"') {
+            out << '"';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+// Durations are recorded in nanoseconds; both output formats use microseconds.
+double NanosecondsToMicroseconds(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+}  // namespace
+
+LoaderLabelProfiler::LoaderLabelProfiler()
+    : _enabled(false),
+      _format(XR_LOADER_LABEL_PROFILE_FORMAT_CHROME_TRACE),
+      _wrote_trace_entry(false),
+      _origin(clock::now()),
+      _session_count(0),
+      _trace_event_count(0) {
+    _file_name = PlatformUtilsGetEnv("XR_LOADER_LABEL_PROFILE");
+    _enabled = !_file_name.empty();
+    if (PlatformUtilsGetEnv("XR_LOADER_LABEL_PROFILE_FORMAT") == "csv") {
+        _format = XR_LOADER_LABEL_PROFILE_FORMAT_CSV;
+    }
+}
+
+LoaderLabelProfiler::~LoaderLabelProfiler() {
+    // Sessions that were never destroyed still get written out at exit.
+    // The logger is going away too, so failures here are silent.
+    if (_enabled) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        WriteSessionsLocked();
+        if (_out.is_open() && _format == XR_LOADER_LABEL_PROFILE_FORMAT_CHROME_TRACE) {
+            _out << "\n]\n";
+        }
+    }
+}
+
+LoaderLabelProfiler::SessionProfile& LoaderLabelProfiler::GetOrCreateSessionProfile(XrSession session) {
+    std::unique_ptr<SessionProfile>& profile = _sessions[session];
+    if (!profile) {
+        profile.reset(new SessionProfile);
+        profile->session = session;
+        profile->ordinal = ++_session_count;
+        profile->named = false;
+        profile->has_open_label = false;
+    }
+    return *profile;
+}
+
+uint32_t LoaderLabelProfiler::GetPathId(SessionProfile& profile, const char* label_name, bool is_region) {
+    std::string name = (label_name == nullptr) ? std::string() : std::string(label_name);
+    std::string path;
+    if (!profile.open_regions.empty()) {
+        path = _paths[profile.open_regions.back().path_id].path;
+        path += '/';
+    }
+    path += name;
+
+    auto& path_ids = is_region ? _region_path_ids : _label_path_ids;
+    auto it = path_ids.find(path);
+    if (it != path_ids.end()) {
+        return it->second;
+    }
+    auto path_id = static_cast<uint32_t>(_paths.size());
+    _paths.push_back({path, name, is_region});
+    path_ids.emplace(std::move(path), path_id);
+    return path_id;
+}
+
+void LoaderLabelProfiler::CloseLabel(SessionProfile& profile, const OpenLabel& label, clock::time_point end) {
+    auto duration_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - label.start).count());
+    if (_format == XR_LOADER_LABEL_PROFILE_FORMAT_CHROME_TRACE) {
+        auto start_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(label.start - _origin).count());
+        profile.events.push_back({label.path_id, start_ns, duration_ns});
+        ++_trace_event_count;
+    } else {
+        LabelStats& stats = profile.stats[label.path_id];
+        ++stats.count;
+        stats.total_ns += duration_ns;
+        stats.max_ns = std::max(stats.max_ns, duration_ns);
+        ++stats.buckets[LoaderHistogramBucket(duration_ns)];
+    }
+}
+
+void LoaderLabelProfiler::CloseIndividualLabel(SessionProfile& profile, clock::time_point end) {
+    // Individual labels last until they are replaced or the enclosing region changes,
+    // matching how the loader reports them in debug messages.
+    if (profile.has_open_label) {
+        profile.has_open_label = false;
+        CloseLabel(profile, profile.open_label, end);
+    }
+}
+
+void LoaderLabelProfiler::BeginLabelRegion(XrSession session, const XrDebugUtilsLabelEXT* label_info) {
+    if (!_enabled) {
+        return;
+    }
+    auto now = clock::now();
+    std::unique_lock<std::mutex> lock(_mutex);
+    SessionProfile& profile = GetOrCreateSessionProfile(session);
+    CloseIndividualLabel(profile, now);
+    profile.open_regions.push_back({GetPathId(profile, label_info->labelName, true), now});
+    if (!WriteTraceIfFullLocked()) {
+        lock.unlock();
+        LoaderLogger::LogErrorMessage("xrSessionBeginDebugUtilsLabelRegionEXT", "Failed to write label profile to " + _file_name);
+    }
+}
+
+void LoaderLabelProfiler::EndLabelRegion(XrSession session) {
+    if (!_enabled) {
+        return;
+    }
+    auto now = clock::now();
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end()) {
+        return;
+    }
+    SessionProfile& profile = *it->second;
+    CloseIndividualLabel(profile, now);
+    if (!profile.open_regions.empty()) {
+        OpenLabel region = profile.open_regions.back();
+        profile.open_regions.pop_back();
+        CloseLabel(profile, region, now);
+    }
+    if (!WriteTraceIfFullLocked()) {
+        lock.unlock();
+        LoaderLogger::LogErrorMessage("xrSessionEndDebugUtilsLabelRegionEXT", "Failed to write label profile to " + _file_name);
+    }
+}
+
+void LoaderLabelProfiler::InsertLabel(XrSession session, const XrDebugUtilsLabelEXT* label_info) {
+    if (!_enabled) {
+        return;
+    }
+    auto now = clock::now();
+    if (label_info->labelName != nullptr && strcmp(label_info->labelName, XR_LOADER_LABEL_PROFILE_FLUSH_LABEL) == 0) {
+        if (!WriteProfile()) {
+            LoaderLogger::LogErrorMessage("xrSessionInsertDebugUtilsLabelEXT",
+                                          "Failed to write label profile to " + _file_name);
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    SessionProfile& profile = GetOrCreateSessionProfile(session);
+    CloseIndividualLabel(profile, now);
+    profile.open_label = {GetPathId(profile, label_info->labelName, false), now};
+    profile.has_open_label = true;
+    if (!WriteTraceIfFullLocked()) {
+        lock.unlock();
+        LoaderLogger::LogErrorMessage("xrSessionInsertDebugUtilsLabelEXT", "Failed to write label profile to " + _file_name);
+    }
+}
+
+void LoaderLabelProfiler::EndSession(XrSession session) {
+    if (!_enabled) {
+        return;
+    }
+    auto now = clock::now();
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto it = _sessions.find(session);
+    if (it == _sessions.end()) {
+        return;
+    }
+    std::unique_ptr<SessionProfile> profile = std::move(it->second);
+    _sessions.erase(it);
+    CloseIndividualLabel(*profile, now);
+    while (!profile->open_regions.empty()) {
+        OpenLabel region = profile->open_regions.back();
+        profile->open_regions.pop_back();
+        CloseLabel(*profile, region, now);
+    }
+
+    // Only this session is written, the others are left until they end.
+    if (!WriteSessionLocked(*profile)) {
+        lock.unlock();
+        LoaderLogger::LogErrorMessage("xrDestroySession", "Failed to write label profile to " + _file_name);
+    }
+}
+
+bool LoaderLabelProfiler::WriteProfile() {
+    if (!_enabled) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    return WriteSessionsLocked();
+}
+
+bool LoaderLabelProfiler::WriteTraceIfFullLocked() {
+    if (_trace_event_count < kMaxTraceEvents) {
+        return true;
+    }
+    return WriteSessionsLocked();
+}
+
+bool LoaderLabelProfiler::WriteSessionsLocked() {
+    bool written = true;
+    for (auto& session : _sessions) {
+        written = WriteSessionLocked(*session.second) && written;
+    }
+    return written;
+}
+
+bool LoaderLabelProfiler::WriteSessionLocked(SessionProfile& profile) {
+    if (profile.events.empty() && profile.stats.empty()) {
+        return true;
+    }
+    // The file is started over by the first write of the process, and only appended to after that.
+    if (!_out.is_open()) {
+        _out.open(_file_name, std::ios::out | std::ios::trunc);
+        if (!_out.is_open()) {
+            return false;
+        }
+        _out << std::fixed << std::setprecision(3);
+        if (_format == XR_LOADER_LABEL_PROFILE_FORMAT_CSV) {
+            _out << "session,kind,label_path,count,mean_us,p50_us,p95_us,p99_us,max_us\n";
+        } else {
+            _out << "[";
+        }
+    }
+    if (_format == XR_LOADER_LABEL_PROFILE_FORMAT_CSV) {
+        WriteCsv(profile);
+    } else {
+        WriteChromeTrace(profile);
+    }
+    // What was written is forgotten, even if writing it failed, so memory stays bounded.
+    _trace_event_count -= profile.events.size();
+    profile.events.clear();
+    profile.stats.clear();
+    _out.flush();
+    return !_out.fail();
+}
+
+// Uses the JSON array form of the trace event format, which trace viewers accept without the
+// closing bracket, so the file can be appended to and still be opened while the application runs.
+void LoaderLabelProfiler::WriteChromeTrace(SessionProfile& profile) {
+    if (!profile.named) {
+        // One trace "thread" per session, named after the session handle
+        profile.named = true;
+        _out << (_wrote_trace_entry ? ",\n" : "\n");
+        _wrote_trace_entry = true;
+        _out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << profile.ordinal << ",\"args\":{\"name\":\"XrSession "
+             << HandleToHexString(profile.session) << "\"}}";
+    }
+    for (const auto& event : profile.events) {
+        const LabelPath& label_path = _paths[event.path_id];
+        _out << ",\n{\"name\":";
+        WriteJsonString(_out, label_path.name);
+        _out << ",\"cat\":\"" << (label_path.is_region ? "label_region" : "label") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << profile.ordinal << ",\"ts\":" << NanosecondsToMicroseconds(event.start_ns)
+             << ",\"dur\":" << NanosecondsToMicroseconds(event.duration_ns) << ",\"args\":{\"path\":";
+        WriteJsonString(_out, label_path.path);
+        _out << "}}";
+    }
+}
+
+void LoaderLabelProfiler::WriteCsv(SessionProfile& profile) {
+    // Sort by path so the output is stable between runs
+    std::vector<std::pair<const LabelPath*, const LabelStats*>> entries;
+    entries.reserve(profile.stats.size());
+    for (const auto& path_stats : profile.stats) {
+        entries.emplace_back(&_paths[path_stats.first], &path_stats.second);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<const LabelPath*, const LabelStats*>& a, const std::pair<const LabelPath*, const LabelStats*>& b) {
+                  return a.first->path == b.first->path ? a.first->is_region && !b.first->is_region : a.first->path < b.first->path;
+              });
+
+    for (const auto& entry : entries) {
+        const LabelStats& stats = *entry.second;
+        double mean_us = static_cast<double>(stats.total_ns) / static_cast<double>(stats.count) / 1000.0;
+        _out << HandleToHexString(profile.session) << ',' << (entry.first->is_region ? "region" : "label") << ',';
+        WriteCsvString(_out, entry.first->path);
+        _out << ',' << stats.count << ',' << mean_us << ','
+             << NanosecondsToMicroseconds(LoaderHistogramPercentile(stats.buckets.data(), stats.count, stats.max_ns, 50.0)) << ','
+             << NanosecondsToMicroseconds(LoaderHistogramPercentile(stats.buckets.data(), stats.count, stats.max_ns, 95.0)) << ','
+             << NanosecondsToMicroseconds(LoaderHistogramPercentile(stats.buckets.data(), stats.count, stats.max_ns, 99.0)) << ','
+             << NanosecondsToMicroseconds(stats.max_ns) << '\n';
+    }
+}
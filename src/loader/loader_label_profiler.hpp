@@ -0,0 +1,125 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0 OR MIT
+//
+
+#pragma once
+
+#include "loader_histogram.hpp"
+
+#include <openxr/openxr.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Inserting an individual label with this name through xrSessionInsertDebugUtilsLabelEXT
+// asks the profiler to write out everything collected so far in the sessions still alive.
+#define XR_LOADER_LABEL_PROFILE_FLUSH_LABEL "XR_LOADER_LABEL_PROFILE_FLUSH"
+
+enum XrLoaderLabelProfileFormat {
+    XR_LOADER_LABEL_PROFILE_FORMAT_CHROME_TRACE = 0,
+    XR_LOADER_LABEL_PROFILE_FORMAT_CSV,
+};
+
+// Times the XR_EXT_debug_utils label regions and individual labels of every session
+// with a monotonic clock, and aggregates the durations per label path (the names of
+// all enclosing label regions joined with '/').
+//
+// Disabled unless the XR_LOADER_LABEL_PROFILE environment variable names an output file.
+// XR_LOADER_LABEL_PROFILE_FORMAT selects "trace" (Chrome trace event JSON, the default)
+// or "csv" (count, mean, p50, p95, p99 and max per label path).
+//
+// A session is appended to the file when it ends and then forgotten, and durations are kept
+// in fixed-size histograms, so memory does not grow with the number of sessions or labels.
+class LoaderLabelProfiler {
+   public:
+    LoaderLabelProfiler();
+    ~LoaderLabelProfiler();
+
+    bool IsEnabled() const { return _enabled; }
+
+    void BeginLabelRegion(XrSession session, const XrDebugUtilsLabelEXT* label_info);
+    void EndLabelRegion(XrSession session);
+    void InsertLabel(XrSession session, const XrDebugUtilsLabelEXT* label_info);
+
+    // Closes anything still open in the session and appends its profile - call in xrDestroySession
+    void EndSession(XrSession session);
+
+    // Appends what every live session collected since it was last written
+    bool WriteProfile();
+
+    // Non-copyable
+    LoaderLabelProfiler(const LoaderLabelProfiler&) = delete;
+    LoaderLabelProfiler& operator=(const LoaderLabelProfiler&) = delete;
+
+   private:
+    typedef std::chrono::steady_clock clock;
+
+    struct LabelPath {
+        std::string path;
+        std::string name;
+        bool is_region;
+    };
+
+    struct OpenLabel {
+        uint32_t path_id;
+        clock::time_point start;
+    };
+
+    struct TraceEvent {
+        uint32_t path_id;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    struct LabelStats {
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+        std::array<uint64_t, kLoaderHistogramBucketCount> buckets{};
+    };
+
+    // What a session collected since it was last written out.
+    struct SessionProfile {
+        XrSession session;
+        uint32_t ordinal;
+        bool named;
+        std::vector<OpenLabel> open_regions;
+        bool has_open_label;
+        OpenLabel open_label;
+        // Only the one for the output format is filled in.
+        std::vector<TraceEvent> events;
+        std::unordered_map<uint32_t, LabelStats> stats;
+    };
+
+    SessionProfile& GetOrCreateSessionProfile(XrSession session);
+    uint32_t GetPathId(SessionProfile& profile, const char* label_name, bool is_region);
+    void CloseLabel(SessionProfile& profile, const OpenLabel& label, clock::time_point end);
+    void CloseIndividualLabel(SessionProfile& profile, clock::time_point end);
+    bool WriteTraceIfFullLocked();
+    bool WriteSessionsLocked();
+    bool WriteSessionLocked(SessionProfile& profile);
+    void WriteChromeTrace(SessionProfile& profile);
+    void WriteCsv(SessionProfile& profile);
+
+    bool _enabled;
+    XrLoaderLabelProfileFormat _format;
+    std::string _file_name;
+    std::ofstream _out;
+    bool _wrote_trace_entry;
+    clock::time_point _origin;
+    uint32_t _session_count;
+    size_t _trace_event_count;
+    std::mutex _mutex;
+    std::vector<LabelPath> _paths;
+    std::unordered_map<std::string, uint32_t> _region_path_ids;
+    std::unordered_map<std::string, uint32_t> _label_path_ids;
+    std::unordered_map<XrSession, std::unique_ptr<SessionProfile>> _sessions;
+};
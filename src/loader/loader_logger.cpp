@@ -219,13 +219,21 @@ void LoaderLogger::AddObjectName(uint64_t object_handle, XrObjectType object_typ
 }
 
 void LoaderLogger::BeginLabelRegion(XrSession session, const XrDebugUtilsLabelEXT* label_info) {
+    label_profiler_.BeginLabelRegion(session, label_info);
     data_.BeginLabelRegion(session, *label_info);
 }
 
-void LoaderLogger::EndLabelRegion(XrSession session) { data_.EndLabelRegion(session); }
+void LoaderLogger::EndLabelRegion(XrSession session) {
+    label_profiler_.EndLabelRegion(session);
+    data_.EndLabelRegion(session);
+}
 
 void LoaderLogger::InsertLabel(XrSession session, const XrDebugUtilsLabelEXT* label_info) {
+    label_profiler_.InsertLabel(session, label_info);
     data_.InsertLabel(session, *label_info);
 }
 
-void LoaderLogger::DeleteSessionLabels(XrSession session) { data_.DeleteSessionLabels(session); }
+void LoaderLogger::DeleteSessionLabels(XrSession session) {
+    label_profiler_.EndSession(session);
+    data_.DeleteSessionLabels(session);
+}
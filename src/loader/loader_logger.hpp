@@ -20,7 +20,9 @@
 
 #include <openxr/openxr.h>
 
+#include "allocation_callbacks.h"
 #include "hex_and_handles.h"
+#include "loader_label_profiler.hpp"
 #include "object_info.h"
 
 // Use internal versions of flags similar to XR_EXT_debug_utils so that
@@ -62,6 +64,8 @@ enum XrLoaderLogType {
 
 class LoaderLogRecorder {
    public:
+    XR_SDK_ALLOCATION_OPERATORS
+
     LoaderLogRecorder(XrLoaderLogType type, void* user_data, XrLoaderLogMessageSeverityFlags message_severities,
                       XrLoaderLogMessageTypeFlags message_types) {
         _active = false;
@@ -180,6 +184,9 @@ class LoaderLogger {
     std::unordered_map<XrInstance, std::unordered_set<uint64_t>> _recordersByInstance;
 
     DebugUtilsData data_;
+
+    // Opt-in timing of session label regions, see XR_LOADER_LABEL_PROFILE
+    LoaderLabelProfiler label_profiler_;
 };
 
 // Utility functions for converting to/from XR_EXT_debug_utils values
@@ -18,6 +18,7 @@
 #endif  // OPENXR_HAVE_COMMON_CONFIG
 
 #include "filesystem_utils.hpp"
+#include "loader_extension_set.hpp"
 #include "loader_platform.hpp"
 #include "platform_utils.hpp"
 #include "loader_logger.hpp"
@@ -412,7 +413,7 @@ static void ReadLayerDataFilesInRegistry(const std::string &registry_location, s
 #endif  // XR_OS_WINDOWS
 
 ManifestFile::ManifestFile(ManifestFileType type, const std::string &filename, const std::string &library_path)
-    : _filename(filename), _type(type), _library_path(library_path) {}
+    : _filename(filename.begin(), filename.end()), _type(type), _library_path(library_path.begin(), library_path.end()) {}
 
 bool ManifestFile::IsValidJson(const Json::Value &root_node, JsonVersion &version) {
     if (root_node["file_format_version"].isNull() || !root_node["file_format_version"].isString()) {
@@ -435,12 +436,12 @@ bool ManifestFile::IsValidJson(const Json::Value &root_node, JsonVersion &versio
     return true;
 }
 
-static void GetExtensionProperties(const std::vector<ExtensionListing> &extensions, std::vector<XrExtensionProperties> &props) {
+static void GetExtensionProperties(const XrSdkVector<ExtensionListing> &extensions, std::vector<XrExtensionProperties> &props) {
+    LoaderExtensionPropertiesIndex props_index(props);
     for (const auto &ext : extensions) {
-        auto it =
-            std::find_if(props.begin(), props.end(), [&](XrExtensionProperties &prop) { return prop.extensionName == ext.name; });
-        if (it != props.end()) {
-            it->extensionVersion = std::max(it->extensionVersion, ext.extension_version);
+        XrExtensionProperties *existing_prop = props_index.Find(ext.name.c_str());
+        if (nullptr != existing_prop) {
+            existing_prop->extensionVersion = std::max(existing_prop->extensionVersion, ext.extension_version);
         } else {
             XrExtensionProperties prop = {};
             prop.type = XR_TYPE_EXTENSION_PROPERTIES;
@@ -448,7 +449,7 @@ static void GetExtensionProperties(const std::vector<ExtensionListing> &extensio
             strncpy(prop.extensionName, ext.name.c_str(), XR_MAX_EXTENSION_NAME_SIZE - 1);
             prop.extensionName[XR_MAX_EXTENSION_NAME_SIZE - 1] = '\0';
             prop.extensionVersion = ext.extension_version;
-            props.push_back(prop);
+            props_index.Append(prop);
         }
     }
 }
@@ -459,11 +460,11 @@ void ManifestFile::GetInstanceExtensionProperties(std::vector<XrExtensionPropert
     GetExtensionProperties(_instance_extensions, props);
 }
 
-const std::string &ManifestFile::GetFunctionName(const std::string &func_name) const {
+std::string ManifestFile::GetFunctionName(const std::string &func_name) const {
     if (!_functions_renamed.empty()) {
-        auto found = _functions_renamed.find(func_name);
+        auto found = _functions_renamed.find(XrSdkString(func_name.begin(), func_name.end()));
         if (found != _functions_renamed.end()) {
-            return found->second;
+            return std::string(found->second.begin(), found->second.end());
         }
     }
     return func_name;
@@ -472,7 +473,7 @@ const std::string &ManifestFile::GetFunctionName(const std::string &func_name) c
 RuntimeManifestFile::RuntimeManifestFile(const std::string &filename, const std::string &library_path)
     : ManifestFile(MANIFEST_TYPE_RUNTIME, filename, library_path) {}
 
-static void ParseExtension(Json::Value const &ext, std::vector<ExtensionListing> &extensions) {
+static void ParseExtension(Json::Value const &ext, XrSdkVector<ExtensionListing> &extensions) {
     Json::Value ext_name = ext["name"];
     Json::Value ext_version = ext["extension_version"];
 
@@ -481,7 +482,8 @@ static void ParseExtension(Json::Value const &ext, std::vector<ExtensionListing>
     // Internal MR !1867: https://gitlab.khronos.org/openxr/openxr/-/merge_requests/1867
     if (ext_name.isString() && (ext_version.isString() || ext_version.isUInt())) {
         ExtensionListing ext_listing = {};
-        ext_listing.name = ext_name.asString();
+        std::string name = ext_name.asString();
+        ext_listing.name.assign(name.begin(), name.end());
         if (ext_version.isUInt()) {
             ext_listing.extension_version = ext_version.asUInt();
         } else {
@@ -503,12 +505,13 @@ void ManifestFile::ParseCommon(Json::Value const &root_node) {
         for (Json::ValueConstIterator func_it = funcs_renamed.begin(); func_it != funcs_renamed.end(); ++func_it) {
             if (!(*func_it).isString()) {
                 LoaderLogger::LogWarningMessage(
-                    "", "ManifestFile::ParseCommon " + _filename + " \"functions\" section contains non-string values.");
+                    "", "ManifestFile::ParseCommon " + Filename() + " \"functions\" section contains non-string values.");
                 continue;
             }
             std::string original_name = func_it.key().asString();
             std::string new_name = (*func_it).asString();
-            _functions_renamed.emplace(original_name, new_name);
+            _functions_renamed.emplace(XrSdkString(original_name.begin(), original_name.end()),
+                                       XrSdkString(new_name.begin(), new_name.end()));
         }
     }
 }
@@ -646,8 +649,8 @@ ApiLayerManifestFile::ApiLayerManifestFile(ManifestFileType type, const std::str
                                            const uint32_t &implementation_version, const std::string &library_path)
     : ManifestFile(type, filename, library_path),
       _api_version(api_version),
-      _layer_name(layer_name),
-      _description(description),
+      _layer_name(layer_name.begin(), layer_name.end()),
+      _description(description.begin(), description.end()),
       _implementation_version(implementation_version) {}
 
 void ApiLayerManifestFile::CreateIfValid(ManifestFileType type, const std::string &filename,
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include "allocation_callbacks.h"
+
 #include <openxr/openxr.h>
 
 #include <memory>
@@ -34,7 +36,7 @@ struct JsonVersion {
 };
 
 struct ExtensionListing {
-    std::string name;
+    XrSdkString name;
     uint32_t extension_version;
 };
 
@@ -42,15 +44,17 @@ struct ExtensionListing {
 // Base class responsible for finding and parsing manifest files.
 class ManifestFile {
    public:
+    XR_SDK_ALLOCATION_OPERATORS
+
     // Non-copyable
     ManifestFile(const ManifestFile &) = delete;
     ManifestFile &operator=(const ManifestFile &) = delete;
 
     ManifestFileType Type() const { return _type; }
-    const std::string &Filename() const { return _filename; }
-    const std::string &LibraryPath() const { return _library_path; }
+    std::string Filename() const { return std::string(_filename.begin(), _filename.end()); }
+    std::string LibraryPath() const { return std::string(_library_path.begin(), _library_path.end()); }
     void GetInstanceExtensionProperties(std::vector<XrExtensionProperties> &props);
-    const std::string &GetFunctionName(const std::string &func_name) const;
+    std::string GetFunctionName(const std::string &func_name) const;
 
    protected:
     ManifestFile(ManifestFileType type, const std::string &filename, const std::string &library_path);
@@ -58,11 +62,11 @@ class ManifestFile {
     static bool IsValidJson(const Json::Value &root, JsonVersion &version);
 
    private:
-    std::string _filename;
+    XrSdkString _filename;
     ManifestFileType _type;
-    std::string _library_path;
-    std::vector<ExtensionListing> _instance_extensions;
-    std::unordered_map<std::string, std::string> _functions_renamed;
+    XrSdkString _library_path;
+    XrSdkVector<ExtensionListing> _instance_extensions;
+    XrSdkUnorderedMap<XrSdkString, XrSdkString, XrSdkStringHash> _functions_renamed;
 };
 
 // RuntimeManifestFile class -
@@ -84,7 +88,7 @@ class ApiLayerManifestFile : public ManifestFile {
     // Factory method
     static XrResult FindManifestFiles(ManifestFileType type, std::vector<std::unique_ptr<ApiLayerManifestFile>> &manifest_files);
 
-    const std::string &LayerName() const { return _layer_name; }
+    std::string LayerName() const { return std::string(_layer_name.begin(), _layer_name.end()); }
     void PopulateApiLayerProperties(XrApiLayerProperties &props) const;
 
    private:
@@ -95,7 +99,7 @@ class ApiLayerManifestFile : public ManifestFile {
                               std::vector<std::unique_ptr<ApiLayerManifestFile>> &manifest_files);
 
     JsonVersion _api_version;
-    std::string _layer_name;
-    std::string _description;
+    XrSdkString _layer_name;
+    XrSdkString _description;
     uint32_t _implementation_version;
 };
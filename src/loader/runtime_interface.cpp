@@ -14,6 +14,7 @@
 #include "loader_logger.hpp"
 #include "loader_platform.hpp"
 #include "xr_generated_dispatch_table.h"
+#include "xr_generated_reflection.hpp"
 
 #include <openxr/openxr.h>
 
@@ -207,6 +208,12 @@ void RuntimeInterface::TryLoadingSingleRuntime(const std::string& openxr_command
         warning_message += manifest_file->Filename();
         warning_message += ", negotiation failed with error ";
         warning_message += std::to_string(res);
+        const char* result_name = ReflectionResultName(res);
+        if (nullptr != result_name) {
+            warning_message += " (";
+            warning_message += result_name;
+            warning_message += ")";
+        }
         LoaderLogger::LogErrorMessage(openxr_command, warning_message);
         LoaderPlatformLibraryClose(runtime_library);
         return;
@@ -227,12 +234,11 @@ void RuntimeInterface::TryLoadingSingleRuntime(const std::string& openxr_command
 
     // Grab the list of extensions this runtime supports for easy filtering after the
     // xrCreateInstance call
-    std::vector<std::string> supported_extensions;
+    LoaderExtensionSet supported_extensions;
     std::vector<XrExtensionProperties> extension_properties;
     GetInstance()->GetInstanceExtensionProperties(extension_properties);
-    supported_extensions.reserve(extension_properties.size());
-    for (XrExtensionProperties ext_prop : extension_properties) {
-        supported_extensions.emplace_back(ext_prop.extensionName);
+    for (const XrExtensionProperties& ext_prop : extension_properties) {
+        supported_extensions.Insert(ext_prop.extensionName);
     }
     GetInstance()->SetSupportedExtensions(supported_extensions);
 
@@ -345,22 +351,15 @@ void RuntimeInterface::GetInstanceExtensionProperties(std::vector<XrExtensionPro
         }
         rt_xrEnumerateInstanceExtensionProperties(nullptr, count, &count_output, runtime_extension_properties.data());
     }
-    size_t ext_count = runtime_extension_properties.size();
-    size_t props_count = extension_properties.size();
-    for (size_t ext = 0; ext < ext_count; ++ext) {
-        bool found = false;
-        for (size_t prop = 0; prop < props_count; ++prop) {
-            // If we find it, then make sure the spec version matches that of the runtime instead of the
-            // layer.
-            if (strcmp(extension_properties[prop].extensionName, runtime_extension_properties[ext].extensionName) == 0) {
-                // Make sure the spec version used is the runtime's
-                extension_properties[prop].extensionVersion = runtime_extension_properties[ext].extensionVersion;
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            extension_properties.push_back(runtime_extension_properties[ext]);
+    LoaderExtensionPropertiesIndex properties_index(extension_properties);
+    for (const XrExtensionProperties& runtime_extension_property : runtime_extension_properties) {
+        // If we find it, then make sure the spec version matches that of the runtime instead of the
+        // layer.
+        XrExtensionProperties* existing_property = properties_index.Find(runtime_extension_property.extensionName);
+        if (nullptr != existing_property) {
+            existing_property->extensionVersion = runtime_extension_property.extensionVersion;
+        } else {
+            properties_index.Append(runtime_extension_property);
         }
     }
 }
@@ -421,17 +420,10 @@ void RuntimeInterface::ForgetDebugMessenger(XrDebugUtilsMessengerEXT messenger)
     }
 }
 
-void RuntimeInterface::SetSupportedExtensions(std::vector<std::string>& supported_extensions) {
+void RuntimeInterface::SetSupportedExtensions(const LoaderExtensionSet& supported_extensions) {
     _supported_extensions = supported_extensions;
 }
 
 bool RuntimeInterface::SupportsExtension(const std::string& extension_name) {
-    bool found_prop = false;
-    for (const std::string& supported_extension : _supported_extensions) {
-        if (supported_extension == extension_name) {
-            found_prop = true;
-            break;
-        }
-    }
-    return found_prop;
+    return _supported_extensions.Contains(extension_name.c_str());
 }
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include "allocation_callbacks.h"
+#include "loader_extension_set.hpp"
 #include "loader_platform.hpp"
 
 #include <openxr/openxr.h>
@@ -33,6 +35,8 @@ XrResult InitializeLoader(const XrLoaderInitInfoBaseHeaderKHR* loaderInitInfo);
 
 class RuntimeInterface {
    public:
+    XR_SDK_ALLOCATION_OPERATORS
+
     virtual ~RuntimeInterface();
 
     // Helper functions for loading and unloading the runtime (but only when necessary)
@@ -47,6 +51,7 @@ class RuntimeInterface {
 
     void GetInstanceExtensionProperties(std::vector<XrExtensionProperties>& extension_properties);
     bool SupportsExtension(const std::string& extension_name);
+    const LoaderExtensionSet& SupportedExtensions() const { return _supported_extensions; }
     XrResult CreateInstance(const XrInstanceCreateInfo* info, XrInstance* instance);
     XrResult DestroyInstance(XrInstance instance);
     bool TrackDebugMessenger(XrInstance instance, XrDebugUtilsMessengerEXT messenger);
@@ -61,7 +66,7 @@ class RuntimeInterface {
 
    private:
     RuntimeInterface(LoaderPlatformLibraryHandle runtime_library, PFN_xrGetInstanceProcAddr get_instance_proc_addr);
-    void SetSupportedExtensions(std::vector<std::string>& supported_extensions);
+    void SetSupportedExtensions(const LoaderExtensionSet& supported_extensions);
     static void TryLoadingSingleRuntime(const std::string& openxr_command, std::unique_ptr<RuntimeManifestFile>& manifest_file,
                                         bool& any_loaded, XrResult& last_error);
 
@@ -72,9 +77,9 @@ class RuntimeInterface {
 
     LoaderPlatformLibraryHandle _runtime_library;
     PFN_xrGetInstanceProcAddr _get_instance_proc_addr;
-    std::unordered_map<XrInstance, std::unique_ptr<XrGeneratedDispatchTable>> _dispatch_table_map;
+    XrSdkUnorderedMap<XrInstance, std::unique_ptr<XrGeneratedDispatchTable>> _dispatch_table_map;
     std::mutex _dispatch_table_mutex;
-    std::unordered_map<XrDebugUtilsMessengerEXT, XrInstance> _messenger_to_instance_map;
+    XrSdkUnorderedMap<XrDebugUtilsMessengerEXT, XrInstance> _messenger_to_instance_map;
     std::mutex _messenger_to_instance_mutex;
-    std::vector<std::string> _supported_extensions;
+    LoaderExtensionSet _supported_extensions;
 };
@@ -26,7 +26,9 @@
 
 from automatic_source_generator import (AutomaticSourceOutputGenerator,
                                         undecorate)
+from capture_generator import CaptureOutputGenerator
 from generator import write
+from reflection_source_generator import reflectionCommandId
 
 # The following commands should not be generated for the layer
 MANUALLY_DEFINED_IN_LAYER = set((
@@ -58,24 +60,25 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         preamble = ''
         if self.genOpts.filename == 'xr_generated_api_dump.hpp':
             preamble += '#pragma once\n\n'
+            preamble += '#include "allocation_callbacks.h"\n'
+            preamble += '#include "api_dump_contents.h"\n'
             preamble += '#include "api_layer_platform_defines.h"\n'
+            preamble += '#include "concurrent_handle_registry.h"\n'
             preamble += '#include <openxr/openxr.h>\n'
             preamble += '#include <openxr/openxr_platform.h>\n\n'
-            preamble += '#include <mutex>\n'
-            preamble += '#include <string>\n'
-            preamble += '#include <tuple>\n'
-            preamble += '#include <unordered_map>\n'
-            preamble += '#include <vector>\n\n'
             preamble += 'struct XrGeneratedDispatchTable;\n\n'
         elif self.genOpts.filename == 'xr_generated_api_dump.cpp':
+            preamble += '#include "api_dump_capture.h"\n'
+            preamble += '#include "api_dump_filter.h"\n'
+            preamble += '#include "api_dump_json.h"\n'
             preamble += '#include "xr_generated_api_dump.hpp"\n'
+            preamble += '#include "xr_generated_api_dump_json.hpp"\n'
             preamble += '#include "xr_generated_dispatch_table.h"\n'
-            preamble += '#include "hex_and_handles.h"\n\n'
+            preamble += '#include "xr_generated_reflection.hpp"\n\n'
+            preamble += '#include <cstdio>\n'
             preamble += '#include <cstring>\n'
-            preamble += '#include <mutex>\n'
-            preamble += '#include <sstream>\n'
-            preamble += '#include <iomanip>\n'
-            preamble += '#include <unordered_map>\n\n'
+            preamble += '#include <stdexcept>\n'
+            preamble += '#include <string>\n\n'
         write(preamble, file=self.outFile)
 
     # Write out all the information for the appropriate file,
@@ -88,7 +91,8 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             file_data += self.outputApiDumpExterns()
 
         elif self.genOpts.filename == 'xr_generated_api_dump.cpp':
-            file_data += self.outputApiDumpMapMutexItems()
+            file_data += self.outputCommandNames()
+            file_data += self.outputApiDumpMapItems()
             file_data += self.writeApiDumpUnionStructFuncs()
             file_data += self.outputLayerCommands()
 
@@ -97,6 +101,19 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         # Finish processing in superclass
         AutomaticSourceOutputGenerator.endFile(self)
 
+    # Output the name of each command, indexed by the CaptureCommand IDs generated in
+    # capture_generator.py, which the command filter matches its lists against.
+    #   self            the ApiDumpOutputGenerator object
+    def outputCommandNames(self):
+        names = '\n// The name of each command, indexed by CaptureCommand\n'
+        names += 'const char* const g_api_dump_command_names[CAPTURE_COMMAND_COUNT] = {\n'
+        names += '    nullptr,\n'
+        for cur_cmd in self.core_commands + self.ext_commands:
+            if cur_cmd.name not in self.no_trampoline_or_terminator:
+                names += '    "%s",\n' % cur_cmd.name
+        names += '};\n'
+        return names
+
     # Output the externs required by the manual code to work with the API Dump
     # gnerated code.
     #   self            the ApiDumpOutputGenerator object
@@ -106,12 +123,12 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             base_handle_name = undecorate(handle.name)
             if handle.protect_value is not None:
                 externs += '#if %s\n' % handle.protect_string
-            externs += 'extern std::unordered_map<%s, XrGeneratedDispatchTable*> g_%s_dispatch_map;\n' % (
+            externs += 'extern ConcurrentHandleRegistry<%s, XrGeneratedDispatchTable> g_%s_dispatch_map;\n' % (
                 handle.name, base_handle_name)
-            externs += 'extern std::mutex g_%s_dispatch_mutex;\n' % base_handle_name
             if handle.protect_value is not None:
                 externs += '#endif // %s\n' % handle.protect_string
         externs += 'void ApiDumpCleanUpMapsForTable(XrGeneratedDispatchTable *table);\n'
+        externs += 'void ApiDumpReleaseRetiredMapTables();\n'
         return externs
 
     # Output the externs manually implemented by the API Dump layer so that the generated code
@@ -122,80 +139,74 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         generated_prototypes += 'XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrGetInstanceProcAddr(XrInstance instance,\n'
         generated_prototypes += '                                          const char* name, PFN_xrVoidFunction* function);\n\n'
         generated_prototypes += '// Api Dump Log Command\n'
-        generated_prototypes += 'bool ApiDumpLayerRecordContent(std::vector<std::tuple<std::string, std::string, std::string>> contents);\n\n'
+        generated_prototypes += 'bool ApiDumpLayerRecordContent(const ApiDumpContents& contents);\n\n'
         generated_prototypes += '// Api Dump Manual Functions\n'
         generated_prototypes += 'XrInstance FindInstanceFromDispatchTable(XrGeneratedDispatchTable* dispatch_table);\n'
         generated_prototypes += 'XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrCreateInstance(const XrInstanceCreateInfo *info,\n'
         generated_prototypes += '                                      XrInstance *instance);\n'
         generated_prototypes += 'XRAPI_ATTR XrResult XRAPI_CALL ApiDumpLayerXrDestroyInstance(XrInstance instance);\n'
         generated_prototypes += '\n//Dump utility functions\n'
-        generated_prototypes += 'bool ApiDumpDecodeNextChain(XrGeneratedDispatchTable* gen_dispatch_table, const void* value, std::string prefix,\n'
-        generated_prototypes += '                            std::vector<std::tuple<std::string, std::string, std::string>> &contents);\n'
+        generated_prototypes += 'bool ApiDumpDecodeNextChain(XrGeneratedDispatchTable* gen_dispatch_table, const void* value, const char* name,\n'
+        generated_prototypes += '                            ApiDumpContents& contents);\n'
         generated_prototypes += '\n// Union/Structure Output Helper function prototypes\n'
         for xr_union in self.api_unions:
             if xr_union.protect_value:
                 generated_prototypes += '#if %s\n' % xr_union.protect_string
             generated_prototypes += 'bool ApiDumpOutputXrUnion(XrGeneratedDispatchTable* gen_dispatch_table, const %s* value,\n' % xr_union.name
-            generated_prototypes += '                          std::string prefix, std::string type_string, bool is_pointer,\n'
-            generated_prototypes += '                          std::vector<std::tuple<std::string, std::string, std::string>> &contents);\n'
+            generated_prototypes += '                          const char* name, const char* type_string, bool is_pointer,\n'
+            generated_prototypes += '                          ApiDumpContents& contents);\n'
             if xr_union.protect_value:
                 generated_prototypes += '#endif // %s\n' % xr_union.protect_string
         for xr_struct in self.api_structures:
             if xr_struct.protect_value:
                 generated_prototypes += '#if %s\n' % xr_struct.protect_string
             generated_prototypes += 'bool ApiDumpOutputXrStruct(XrGeneratedDispatchTable* gen_dispatch_table, const %s* value,\n' % xr_struct.name
-            generated_prototypes += '                           std::string prefix, std::string type_string, bool is_pointer,\n'
-            generated_prototypes += '                           std::vector<std::tuple<std::string, std::string, std::string>> &contents);\n'
+            generated_prototypes += '                           const char* name, const char* type_string, bool is_pointer,\n'
+            generated_prototypes += '                           ApiDumpContents& contents);\n'
             if xr_struct.protect_value:
                 generated_prototypes += '#endif // %s\n' % xr_struct.protect_string
         return generated_prototypes
 
-    # Output the unordered_map's required to track all the data we need per handle type.  Also, create
-    # a mutex that allows us to access the unordered_maps in a thread-safe manner.  Finally, wrap it
-    # all up by creating utility functions for cleaning up a dispatch table when it's instance has
-    # been deleted.
+    # Output the registry mapping each handle type to the dispatch table of its instance, which the
+    # instance's table also owns, so that all of an instance's handles can be removed together with it.
+    # Finally, wrap it all up by creating a utility function for cleaning up a dispatch table when its
+    # instance has been deleted.
     #   self            the ApiDumpOutputGenerator object
-    def outputApiDumpMapMutexItems(self):
-        maps_mutexes = ''
+    def outputApiDumpMapItems(self):
+        map_items = ''
         for handle in self.api_handles:
             base_handle_name = undecorate(handle.name)
             if handle.protect_value:
-                maps_mutexes += '#if %s\n' % handle.protect_string
-            maps_mutexes += 'std::unordered_map<%s, XrGeneratedDispatchTable*> g_%s_dispatch_map;\n' % (
+                map_items += '#if %s\n' % handle.protect_string
+            map_items += 'ConcurrentHandleRegistry<%s, XrGeneratedDispatchTable> g_%s_dispatch_map;\n' % (
                 handle.name, base_handle_name)
-            maps_mutexes += 'std::mutex g_%s_dispatch_mutex;\n' % base_handle_name
             if handle.protect_value:
-                maps_mutexes += '#endif // %s\n' % handle.protect_string
-        maps_mutexes += '\n'
-        maps_mutexes += '// Template function to reduce duplicating the map locking, searching, and deleting.`\n'
-        maps_mutexes += 'template <typename MapType>\n'
-        maps_mutexes += 'void eraseAllTableMapElements(MapType &search_map, std::mutex &mutex, XrGeneratedDispatchTable *search_value) {\n'
-        maps_mutexes += '    std::unique_lock<std::mutex> lock(mutex);\n'
-        maps_mutexes += '    for (auto it = search_map.begin(); it != search_map.end();) {\n'
-        maps_mutexes += '        if (it->second == search_value) {\n'
-        maps_mutexes += '            search_map.erase(it++);\n'
-        maps_mutexes += '        } else {\n'
-        maps_mutexes += '            ++it;\n'
-        maps_mutexes += '        }\n'
-        maps_mutexes += '    }\n'
-        maps_mutexes += '}\n'
-        maps_mutexes += '\n'
-        maps_mutexes += '// Function used to clean up any residual map values that point to an instance prior to that\n'
-        maps_mutexes += '// instance being deleted.\n'
-        maps_mutexes += 'void ApiDumpCleanUpMapsForTable(XrGeneratedDispatchTable *table) {\n'
-        # Call each handle's erase utility function using the template we defined above.
+                map_items += '#endif // %s\n' % handle.protect_string
+        map_items += '\n'
+        map_items += '// Function used to clean up any residual map values that point to an instance prior to that\n'
+        map_items += '// instance being deleted.\n'
+        map_items += 'void ApiDumpCleanUpMapsForTable(XrGeneratedDispatchTable *table) {\n'
+        for handle in self.api_handles:
+            base_handle_name = undecorate(handle.name)
+            if handle.protect_value:
+                map_items += '#if %s\n' % handle.protect_string
+            map_items += '    g_%s_dispatch_map.EraseOwner(table);\n' % base_handle_name
+            if handle.protect_value:
+                map_items += '#endif // %s\n' % handle.protect_string
+        map_items += '}\n'
+        map_items += '\n'
+        map_items += '// Function used to free the tables the maps replaced as they grew, once no instance is left.\n'
+        map_items += 'void ApiDumpReleaseRetiredMapTables() {\n'
         for handle in self.api_handles:
             base_handle_name = undecorate(handle.name)
             if handle.protect_value:
-                maps_mutexes += '#if %s\n' % handle.protect_string
-            maps_mutexes += '    eraseAllTableMapElements<std::unordered_map<%s, XrGeneratedDispatchTable*>>' % handle.name
-            maps_mutexes += '(g_%s_dispatch_map, g_%s_dispatch_mutex, table);\n' % (
-                base_handle_name, base_handle_name)
+                map_items += '#if %s\n' % handle.protect_string
+            map_items += '    g_%s_dispatch_map.ReleaseRetiredTables();\n' % base_handle_name
             if handle.protect_value:
-                maps_mutexes += '#endif // %s\n' % handle.protect_string
-        maps_mutexes += '}\n'
-        maps_mutexes += '\n'
-        return maps_mutexes
+                map_items += '#endif // %s\n' % handle.protect_string
+        map_items += '}\n'
+        map_items += '\n'
+        return map_items
 
     # Generate a short version of the parameter name that we can use as a variable.
     #   self            the ApiDumpOutputGenerator object
@@ -264,7 +275,7 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         int_short_param_name = ''
         is_standard_type = False
         is_char = False
-        use_stream = False
+        use_formatted = False
         pointer_count = member_param.pointer_count
         is_array = member_param.is_array
         is_external = self.isExternalGraphicsApiHandle(base_type)
@@ -302,19 +313,19 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             if base_type[0:4].lower() == 'char':
                 is_char = True
                 if not can_dereference or ((is_array and pointer_count > 0) or pointer_count > 1):
-                    use_stream = True
+                    use_formatted = True
                 elif pointer_count > 0:
                     pointer_count -= 1
             else:
                 # If it's a non-character standard type, we want to output the information
-                # using a string stream instead of the standard output path.
-                use_stream = True
+                # as hex or with a precision instead of the standard output path.
+                use_formatted = True
 
         # If this is a pointer and not a character, or it's a handle, we also want to
-        # use a stream.  This is because we can output hex values through a stream.
+        # output it as hex.
         if (self.isHandle(base_type) or is_external or
                 ((is_array or pointer_count > 0) and not is_char)):
-            use_stream = True
+            use_formatted = True
 
         # Create a short name for use as a variable
         int_short_param_name = self.generateShortParamVariableName(
@@ -324,116 +335,72 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
 
         write_string = ''
 
+        # Everything is recorded through ApiDumpContents, which writes each value the same way the
+        # std::ostream or std::to_string expression noted next to it would.
+        deref = ''
+        if can_dereference and pointer_count > 0:
+            deref = '*' * pointer_count
+
         if base_type == 'GUID':
+            # oss << std::uppercase; oss.width(8); oss << std::hex << Data1 << '-'; ... and so on
+            write_string += self.writeIndent(indent)
             write_string += '{\n'
             indent = indent + 1
             write_string += self.writeIndent(indent)
-            write_string += 'std::ostringstream oss_%s;\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::uppercase;\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s.width(8);\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex << %s.Data1 << \'-\';\n' % (int_short_param_name, full_name)
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s.width(4);\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex << %s.Data2 << \'-\';\n' % (int_short_param_name, full_name)
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s.width(4);\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex << %s.Data3 << \'-\';\n' % (int_short_param_name, full_name)
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s.width(2);\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[0])\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[1])\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << \'-\'\n'
+            write_string += 'char %s_string[48];\n' % int_short_param_name
             write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[2])\n' % full_name
+            write_string += 'snprintf(%s_string, sizeof(%s_string), "%%8lX-%%4X-%%4X-%%2X%%X-%%X%%X%%X%%X%%X%%X",\n' % (
+                int_short_param_name, int_short_param_name)
             write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[3])\n' % full_name
+            write_string += '         static_cast<unsigned long>(%s.Data1), static_cast<unsigned>(%s.Data2),\n' % (full_name, full_name)
             write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[4])\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[5])\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[6])\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += '    << static_cast<short>(%s.Data4[7]);\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::nouppercase;\n' % int_short_param_name
+            write_string += '         static_cast<unsigned>(%s.Data3)' % full_name
+            for data4_index in range(0, 8):
+                write_string += ',\n'
+                write_string += self.writeIndent(indent)
+                write_string += '         static_cast<unsigned>(%s.Data4[%d])' % (full_name, data4_index)
+            write_string += ');\n'
             write_string += self.writeIndent(indent)
-            write_string += 'contents.emplace_back("%s", %s' % (full_type, description)
-            write_string += ', oss_%s.str());\n' % int_short_param_name
+            write_string += 'contents.AddString("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
             indent = indent - 1
             write_string += self.writeIndent(indent)
             write_string += '}\n'
         elif base_type == 'LUID':
+            # oss << std::uppercase; oss.width(8); oss << std::hex << LowPart; oss << std::hex << HighPart
             write_string += self.writeIndent(indent)
             write_string += '{\n'
             indent = indent + 1
             write_string += self.writeIndent(indent)
-            write_string += 'std::ostringstream oss_%s;\n' % int_short_param_name
+            write_string += 'char %s_string[40];\n' % int_short_param_name
             write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::uppercase;\n' % int_short_param_name
+            write_string += 'snprintf(%s_string, sizeof(%s_string), "%%8lX%%lX", static_cast<unsigned long>(%s.LowPart),\n' % (
+                int_short_param_name, int_short_param_name, full_name)
             write_string += self.writeIndent(indent)
-            write_string += 'oss_%s.width(8);\n' % int_short_param_name
+            write_string += '         static_cast<unsigned long>(%s.HighPart));\n' % full_name
             write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex << %s.LowPart;\n' % (int_short_param_name, full_name)
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::hex << %s.HighPart;\n' % (int_short_param_name, full_name)
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << std::nouppercase;\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'contents.emplace_back("%s", %s' % (full_type, description)
-            write_string += ', oss_%s.str());\n' % int_short_param_name
+            write_string += 'contents.AddString("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
             indent = indent - 1
             write_string += self.writeIndent(indent)
             write_string += '}\n'
         elif base_type == 'LARGE_INTEGER':
             # Unbeknownst to XR, this is actually a union. Append '.QuadPart' to get the entirety
+            # Ignore can_dereference, must deref to access union member
             write_string += self.writeIndent(indent)
-            write_string += 'std::ostringstream oss_%s;\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            write_string += 'oss_%s << ' % int_short_param_name
-            write_string += 'std::hex << reinterpret_cast<const void*>( ('
-            if pointer_count > 0:   # Ignore can_dereference, must deref to access union member
-                write_string += '*' * pointer_count
-            write_string += '%s).QuadPart );\n' % full_name
-            write_string += self.writeIndent(indent)
-            write_string += 'contents.emplace_back("%s", %s' % (full_type, description)
-            write_string += ', oss_%s.str());\n' % int_short_param_name
+            write_string += 'contents.AddPointer("%s", %s, reinterpret_cast<const void*>((%s%s).QuadPart));\n' % (
+                full_type, description, '*' * pointer_count, full_name)
         elif base_type == 'timespec':
-            # Unbeknownst to XR, this is actually a struct.
+            # Unbeknownst to XR, this is actually a struct.  Written as seconds, and nanoseconds as a decimal.
             write_string += self.writeIndent(indent)
-            write_string += 'std::ostringstream oss_%s;\n' % int_short_param_name
-            write_string += self.writeIndent(indent)
-            deref = '' + '*' * pointer_count
-
-            # Write whole seconds
-            write_string += 'oss_%s << (' % int_short_param_name
-            write_string += deref
-            write_string += '%s).tv_sec << ".";\n' % full_name
-
-            # Write nanoseconds as a decimal
-            write_string += self.writeIndent(indent)
-            write_string += "oss_%s << std::setw(9) << std::setfill('0') << (" % int_short_param_name
-            write_string += deref
-            write_string += '%s).tv_nsec << "s";\n' % full_name
-
-            write_string += self.writeIndent(indent)
-            write_string += 'contents.emplace_back("%s", %s' % (
-                full_type, description)
-            write_string += ', oss_%s.str());\n' % int_short_param_name
+            write_string += 'contents.AddSecondsAndNanoseconds("%s", %s, (%s%s).tv_sec, (%s%s).tv_nsec);\n' % (
+                full_type, description, '*' * pointer_count, full_name, '*' * pointer_count, full_name)
         else:
             if base_type == 'XrResult':
                 write_string += self.writeIndent(indent)
-                write_string += 'if (nullptr != gen_dispatch_table) {\n'
+                write_string += 'if (nullptr != ReflectionResultName(%s)) {\n' % full_name
+                write_string += self.writeIndent(indent + 1)
+                write_string += 'contents.AddString("%s", %s, ReflectionResultName(%s));\n' % (full_type, description, full_name)
+                write_string += self.writeIndent(indent)
+                write_string += '} else if (nullptr != gen_dispatch_table) {\n'
                 indent = indent + 1
                 write_string += self.writeIndent(indent)
                 write_string += 'char %s_string[XR_MAX_RESULT_STRING_SIZE];\n' % int_short_param_name
@@ -442,13 +409,16 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 write_string += self.writeIndent(indent)
                 write_string += '                                   %s, %s_string);\n' % (full_name, int_short_param_name)
                 write_string += self.writeIndent(indent)
-                write_string += 'contents.emplace_back("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
+                write_string += 'contents.AddString("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
                 write_string += self.writeIndent(indent - 1)
                 write_string += '} else {\n'
-                write_string += self.writeIndent(indent)
             elif base_type == 'XrStructureType':
                 write_string += self.writeIndent(indent)
-                write_string += 'if (nullptr != gen_dispatch_table) {\n'
+                write_string += 'if (nullptr != ReflectionStructureTypeName(%s)) {\n' % full_name
+                write_string += self.writeIndent(indent + 1)
+                write_string += 'contents.AddString("%s", %s, ReflectionStructureTypeName(%s));\n' % (full_type, description, full_name)
+                write_string += self.writeIndent(indent)
+                write_string += '} else if (nullptr != gen_dispatch_table) {\n'
                 indent = indent + 1
                 write_string += self.writeIndent(indent)
                 write_string += 'char %s_string[XR_MAX_STRUCTURE_NAME_SIZE];\n' % int_short_param_name
@@ -457,17 +427,14 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 write_string += self.writeIndent(indent)
                 write_string += '                                          %s, %s_string);\n' % (full_name, int_short_param_name)
                 write_string += self.writeIndent(indent)
-                write_string += 'contents.emplace_back("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
+                write_string += 'contents.AddString("%s", %s, %s_string);\n' % (full_type, description, int_short_param_name)
                 write_string += self.writeIndent(indent - 1)
                 write_string += '} else {\n'
-                write_string += self.writeIndent(indent)
 
-            # If we're outputting using a string stream, determine the type of information
-            # we're generating and format it appropriately.
-            if use_stream:
-                write_string += self.writeIndent(indent)
-                write_string += 'std::ostringstream oss_%s;\n' % int_short_param_name
-                write_string += self.writeIndent(indent)
+            write_string += self.writeIndent(indent)
+            # If we're outputting a formatted value, determine the type of information we're
+            # generating and format it appropriately.
+            if use_formatted:
                 # Output the standard type information if we can, except for characters because the
                 # hex converter will try to use the string value in the char.
                 if is_standard_type and not is_char:
@@ -477,39 +444,38 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                             precision = '64'
                         elif '16' in base_type:
                             precision = '16'
-                        write_string += 'oss_%s << std::setprecision(%s) << (' % (int_short_param_name, precision)
+                        # oss << std::setprecision(precision) << value
+                        write_string += 'contents.AddFloat("%s", %s, %s%s, %s);\n' % (
+                            full_type, description, deref, full_name, precision)
                     elif 'double' in base_type:
-                        write_string += 'oss_%s << std::setprecision(64) << (' % int_short_param_name
+                        write_string += 'contents.AddFloat("%s", %s, %s%s, 64);\n' % (
+                            full_type, description, deref, full_name)
+                    elif member_param.pointer_count == 0:
+                        # oss << "0x" << std::hex << value
+                        write_string += 'contents.AddHex("%s", %s, %s%s);\n' % (full_type, description, deref, full_name)
                     else:
-                        write_string += 'oss_%s << ' % int_short_param_name
-                        if member_param.pointer_count == 0:
-                            write_string += '"0x" << '
-                        write_string += 'std::hex << ('
+                        # oss << std::hex << value
+                        write_string += 'contents.AddHexWithoutBase("%s", %s, %s%s);\n' % (
+                            full_type, description, deref, full_name)
                 else:
-                    write_string += 'oss_%s << ' % int_short_param_name
-                    write_string += 'std::hex << reinterpret_cast<const void*>('
-                if can_dereference and pointer_count > 0:
-                    write_string += '*' * pointer_count
-                write_string += '%s);\n' % full_name
-                write_string += self.writeIndent(indent)
-                write_string += 'contents.emplace_back("%s", %s' % (full_type, description)
-                write_string += ', oss_%s.str());\n' % int_short_param_name
-
-            else:
-                write_string += self.writeIndent(indent)
-                write_string += 'contents.emplace_back("%s", %s, ' % (full_type, description)
-                if not is_char:
-                    write_string += 'std::to_string('
+                    # oss << std::hex << reinterpret_cast<const void*>(value)
+                    write_string += 'contents.AddPointer("%s", %s, reinterpret_cast<const void*>(%s%s));\n' % (
+                        full_type, description, deref, full_name)
+            elif is_char:
+                write_string += 'contents.AddString("%s", %s, ' % (full_type, description)
                 if can_dereference:
                     write_string += '*' * pointer_count
                 if full_type == 'char*' and not member_param.is_static_array:
                     write_string += '(%s ? %s : "(nullptr)")' % (full_name, full_name)
                 else:
                     write_string += '%s' % full_name
-                # Close std::to_string
-                if not is_char:
-                    write_string += ')'
                 write_string += ');\n'
+            else:
+                # std::to_string(value)
+                write_string += 'contents.AddDecimal("%s", %s, ' % (full_type, description)
+                if can_dereference:
+                    write_string += '*' * pointer_count
+                write_string += '%s);\n' % full_name
 
             if base_type in ('XrResult', 'XrStructureType'):
                 indent = indent - 1
@@ -523,26 +489,16 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
     #   is_pointer          Boolean indicating whether or not the contents of the arrays are pointers
     #   pointer_count       The number of pointers per variable (void*[] would be one, void**[] would be two)
     #   member_param        The structure from automatic_source_generator for the member or parameter.
-    #   member_param_prefix The prefix to place in front of the member/param items
+    #   member_param_prefix The C++ string literal naming the member/param, after the enclosing names
     #   member_param_name   The prefixed name of this member/param
-    #   has_prefix          Boolean indicates that there's an incoming C++ prefix that needs to be added to the variable.
-    #   prefix_string1      The first prefix string to add prior to writing out the variable information
-    #   prefix_string1      The second prefix string to add prior to writing out the variable information
     #   expand              Boolean indicates whether or not to try to expand/dereference the contents of this parameter
     #   indent              the number of "tabs" to space in for the resulting C+ code.
-    def writeExpandedMember(self, base_type, is_pointer, pointer_count, member_param, member_param_prefix, member_param_name, has_prefix, prefix_string1, prefix_string2, expand, indent):
+    def writeExpandedMember(self, base_type, is_pointer, pointer_count, member_param, member_param_prefix, member_param_name, expand, indent):
         member_string = ''
         derefernce_str = ''
         if not is_pointer:
             derefernce_str = '&'
 
-        prefix_string = ''
-        if has_prefix:
-            prefix_string += self.writeIndent(indent)
-            prefix_string += prefix_string1
-            prefix_string += self.writeIndent(indent)
-            prefix_string += prefix_string2
-
         # If it's a structure or union, we can also only expand it if it's not
         # return-only
         # If this is a structure or union, save that info for easier use later
@@ -558,7 +514,6 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         if is_pointer:
             pointer_string = 'true'
         if member_param.name == 'next':
-            member_string += prefix_string
             member_string += self.writeIndent(indent)
             member_string += '// Decode the next chain if it exists\n'
             member_string += self.writeIndent(indent)
@@ -570,7 +525,6 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             member_string += self.writeIndent(indent)
             member_string += '}\n'
         elif is_struct_union and expand:
-            member_string += prefix_string
             member_string += self.writeIndent(indent)
             # If it's optional, we still want to dump out NULL if it's present just so it's logged
             if member_param.is_optional and is_pointer:
@@ -602,7 +556,6 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             valid_extension_structs = None
             if member_param_struct or member_param_union:
                 valid_extension_structs = member_param.valid_extension_structs
-            member_string += prefix_string
 
             tmp_member_param = self.MemberOrParam(type=member_param.type,
                                                   name=member_param.name,
@@ -657,13 +610,11 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
     #   pointer_count       The number of pointers per variable (void*[] would be one, void**[] would be two)
     #   member_param        The structure from automatic_source_generator for the member or parameter.
     #   array_param         The member/parameter used to indicate the size of the array (or None)
-    #   member_param_prefix The prefix to place in front of the member/param items
+    #   member_param_prefix The C++ string literal naming the member/param, after the enclosing names
     #   member_param_name   The prefixed name of this member/param
-    #   has_prefix          Boolean indicates that there's an incoming C++ prefix that needs to be added to the variable.
-    #   prefix_string1      The first prefix string to add prior to writing out the variable information
-    #   prefix_string1      The second prefix string to add prior to writing out the variable information
+    #   has_prefix          Boolean indicates that this is a member accessed through "value->".
     #   indent              the number of "tabs" to space in for the resulting C+ code.
-    def writeExpandedArray(self, base_type, is_pointer, pointer_count, member_param, array_param, member_param_prefix, member_param_name, has_prefix, prefix_string1, prefix_string2, indent):
+    def writeExpandedArray(self, base_type, is_pointer, pointer_count, member_param, array_param, member_param_prefix, member_param_name, has_prefix, indent):
         member_array_string = ''
         loop_count_name = ''
         loop_param_name = ''
@@ -678,12 +629,6 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             loop_param_name = 'value_'
         loop_param_name += member_param.name.lower()
         loop_param_name += '_inc'
-        member_array_string += self.writeIndent(indent)
-        member_array_string += prefix_string1
-        prefix_string1 = ''
-        member_array_string += self.writeIndent(indent)
-        member_array_string += prefix_string2
-        prefix_string2 = ''
         member_array_string += self.outputSingleEntry(indent,
                                                       False,
                                                       member_param,
@@ -691,26 +636,26 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                                                       member_param_prefix,
                                                       member_param_name,
                                                       member_param.cdecl)
+
+        # The elements are named after the array, followed by their index.
+        has_array_name = member_param_prefix != '""'
+        if has_array_name:
+            member_array_string += self.writeIndent(indent)
+            member_array_string += '{\n'
+            indent = indent + 1
+            member_array_string += self.writeIndent(indent)
+            member_array_string += 'ApiDumpContents::NameScope %s_name(contents, %s);\n' % (member_param.name.lower(),
+                                                                                           member_param_prefix)
         member_array_string += self.writeIndent(indent)
         member_array_string += 'for (uint32_t %s = 0; %s < %s; ++%s) {\n' % (loop_param_name,
                                                                              loop_param_name,
                                                                              loop_count_name,
                                                                              loop_param_name)
         indent = indent + 1
-
-        # Make sure we set that we need a prefix (even if we didn't need one before) because
-        # of the array looping.
-        paranet_param_prefix = member_param_prefix
-        member_param_prefix = '%s_array_prefix' % member_param.name.lower()
-        prefix_string1 = 'std::string %s = %s;\n' % (
-            member_param_prefix, paranet_param_prefix)
-        prefix_string2 += '%s += "[";\n' % member_param_prefix
-        prefix_string2 += self.writeIndent(indent)
-        prefix_string2 += '%s += std::to_string(%s);\n' % (
-            member_param_prefix, loop_param_name)
-        prefix_string2 += self.writeIndent(indent)
-        prefix_string2 += '%s += "]' % member_param_prefix
-        prefix_string2 += '";\n'
+        member_array_string += self.writeIndent(indent)
+        member_array_string += 'ApiDumpContents::NameScope %s_element_name(contents, %s);\n' % (member_param.name.lower(),
+                                                                                               loop_param_name)
+        member_param_prefix = '""'
         member_param_name += "[%s]" % loop_param_name
         array_dimen = member_param.array_dimen - 1
         static_array_sizes = []
@@ -749,16 +694,20 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                                               values=member_param.values)
 
         member_array_string += self.writeExpandedMember(base_type, is_pointer, pointer_count, tmp_member_param,
-                                                        member_param_prefix, member_param_name, True, prefix_string1, prefix_string2, True, indent)
+                                                        member_param_prefix, member_param_name, True, indent)
         indent = indent - 1
         member_array_string += self.writeIndent(indent)
         member_array_string += '}\n'
+        if has_array_name:
+            indent = indent - 1
+            member_array_string += self.writeIndent(indent)
+            member_array_string += '}\n'
         return member_array_string
 
     # Output a single parameter or member based on whether it is an array or not
     #   self            the ApiDumpOutputGenerator object
     #   member_param    the structure from automatic_source_generator for the member or parameter.
-    #   has_prefix      Boolean indicates that there's an incoming C++ prefix that needs to be added to the variable.
+    #   has_prefix      Boolean indicates that this is a structure member, accessed through "value->".
     #   expand_parent   Boolean indicating that the parent could or could not be expanded.
     #   indent          the number of "tabs" to space in for the resulting C+ code.
     def writeParamMember(self, member_param, has_prefix, expand_parent, indent):
@@ -805,18 +754,11 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         if base_type == 'char' and is_array and not is_pointer:
             is_array = False
 
-        member_param_prefix = ''
-        prefix_string1 = ''
-        prefix_string2 = ''
+        # Members are named after the structure, which is the enclosing name.
+        member_param_prefix = '"%s"' % member_param.name
         member_param_name = member_param.name
         if has_prefix:
-            member_param_prefix = '%s_prefix' % member_param.name.lower()
-            prefix_string1 = 'std::string %s = prefix;\n' % member_param_prefix
-            prefix_string2 = '%s += "' % member_param_prefix
             member_param_name = "value->%s" % member_param.name
-            prefix_string2 += '%s";\n' % member_param.name
-        else:
-            member_param_prefix = '"%s"' % member_param.name
 
         if can_expand and is_array:
             is_relation_group = False
@@ -841,7 +783,7 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                     member_param_string += 'if (%s[0].type == %s) {\n' % (
                         member_param_name, self.genXrStructureType(child))
                     member_param_string += self.writeExpandedArray(base_type, is_pointer, pointer_count, member_param, array_param,
-                                                                   member_param_prefix, member_param_name, has_prefix, prefix_string1, prefix_string2, indent + 1)
+                                                                   member_param_prefix, member_param_name, has_prefix, indent + 1)
                     member_param_string += self.writeIndent(indent + 1)
                     member_param_string += '%s = true;\n' % decoded_var
                     member_param_string += self.writeIndent(indent)
@@ -852,14 +794,14 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 member_param_string += 'if (!%s) {\n' % decoded_var
                 indent += 1
             member_param_string += self.writeExpandedArray(base_type, is_pointer, pointer_count, member_param,
-                                                           array_param, member_param_prefix, member_param_name, has_prefix, prefix_string1, prefix_string2, indent)
+                                                           array_param, member_param_prefix, member_param_name, has_prefix, indent)
             if is_relation_group:
                 indent -= 1
                 member_param_string += self.writeIndent(indent)
                 member_param_string += '}\n'
         else:
             member_param_string += self.writeExpandedMember(base_type, is_pointer, pointer_count, member_param,
-                                                            member_param_prefix, member_param_name, has_prefix, prefix_string1, prefix_string2, can_expand, indent)
+                                                            member_param_prefix, member_param_name, can_expand, indent)
         return member_param_string
 
     # Generate the C++ output code for each member of a union or structure.
@@ -881,24 +823,18 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             if xr_union.protect_value:
                 struct_union_check += '#if %s\n' % xr_union.protect_string
             struct_union_check += 'bool ApiDumpOutputXrUnion(XrGeneratedDispatchTable* gen_dispatch_table, const %s* value,\n' % xr_union.name
-            struct_union_check += '                          std::string prefix, std::string type_string, bool is_pointer,\n'
-            struct_union_check += '                          std::vector<std::tuple<std::string, std::string, std::string>> &contents) {\n'
+            struct_union_check += '                          const char* name, const char* type_string, bool is_pointer,\n'
+            struct_union_check += '                          ApiDumpContents& contents) {\n'
             struct_union_check += self.writeIndent(1)
             struct_union_check += '(void)gen_dispatch_table;  // silence warning\n'
             struct_union_check += self.writeIndent(1)
             struct_union_check += 'try {\n'
             struct_union_check += self.writeIndent(2)
-            struct_union_check += 'contents.emplace_back(type_string, prefix, PointerToHexString(value));\n'
+            struct_union_check += 'ApiDumpContents::NameScope union_name(contents, name);\n'
             struct_union_check += self.writeIndent(2)
-            struct_union_check += 'if (is_pointer) {\n'
-            struct_union_check += self.writeIndent(3)
-            struct_union_check += 'prefix += "->";\n'
+            struct_union_check += 'contents.AddHexAddress(type_string, "", value);\n'
             struct_union_check += self.writeIndent(2)
-            struct_union_check += '} else {\n'
-            struct_union_check += self.writeIndent(3)
-            struct_union_check += 'prefix += ".";\n'
-            struct_union_check += self.writeIndent(2)
-            struct_union_check += '}\n'
+            struct_union_check += 'ApiDumpContents::NameScope member_prefix(contents, is_pointer ? "->" : ".");\n'
             struct_union_check += self.writeUnionStructMembers(xr_union, 2)
             struct_union_check += self.writeIndent(2)
             struct_union_check += 'return true;\n'
@@ -915,8 +851,8 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             if xr_struct.protect_value:
                 struct_union_check += '#if %s\n' % xr_struct.protect_string
             struct_union_check += 'bool ApiDumpOutputXrStruct(XrGeneratedDispatchTable* gen_dispatch_table, const %s* value,\n' % xr_struct.name
-            struct_union_check += '                           std::string prefix, std::string type_string, bool is_pointer,\n'
-            struct_union_check += '                           std::vector<std::tuple<std::string, std::string, std::string>> &contents) {\n'
+            struct_union_check += '                           const char* name, const char* type_string, bool is_pointer,\n'
+            struct_union_check += '                           ApiDumpContents& contents) {\n'
             indent = 1
             struct_union_check += self.writeIndent(indent)
             struct_union_check += '(void)gen_dispatch_table;  // silence warning\n'
@@ -941,7 +877,7 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                     struct_union_check += 'const %s* new_value = reinterpret_cast<const %s*>(value);\n' % (
                         child, child)
                     struct_union_check += self.writeIndent(indent + 1)
-                    struct_union_check += 'return ApiDumpOutputXrStruct(gen_dispatch_table, new_value, prefix, type_string, is_pointer, contents);\n'
+                    struct_union_check += 'return ApiDumpOutputXrStruct(gen_dispatch_table, new_value, name, type_string, is_pointer, contents);\n'
                     struct_union_check += self.writeIndent(indent)
                     struct_union_check += '}\n'
                     if child_struct.protect_value:
@@ -949,17 +885,11 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 struct_union_check += self.writeIndent(indent)
                 struct_union_check += '// Fallback path - Just output generic information about the base struct\n'
             struct_union_check += self.writeIndent(indent)
-            struct_union_check += 'contents.emplace_back(type_string, prefix, PointerToHexString(value));\n'
+            struct_union_check += 'ApiDumpContents::NameScope struct_name(contents, name);\n'
             struct_union_check += self.writeIndent(indent)
-            struct_union_check += 'if (is_pointer) {\n'
-            struct_union_check += self.writeIndent(indent + 1)
-            struct_union_check += 'prefix += "->";\n'
+            struct_union_check += 'contents.AddHexAddress(type_string, "", value);\n'
             struct_union_check += self.writeIndent(indent)
-            struct_union_check += '} else {\n'
-            struct_union_check += self.writeIndent(indent + 1)
-            struct_union_check += 'prefix += ".";\n'
-            struct_union_check += self.writeIndent(indent)
-            struct_union_check += '}\n'
+            struct_union_check += 'ApiDumpContents::NameScope member_prefix(contents, is_pointer ? "->" : ".");\n'
             struct_union_check += self.writeUnionStructMembers(
                 xr_struct, indent)
             struct_union_check += self.writeIndent(indent)
@@ -975,12 +905,12 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             if xr_struct.protect_value:
                 struct_union_check += '#endif // %s\n' % xr_struct.protect_string
             struct_union_check += '\n'
-        struct_union_check += 'bool ApiDumpDecodeNextChain(XrGeneratedDispatchTable* gen_dispatch_table, const void* value, std::string prefix,\n'
-        struct_union_check += '                            std::vector<std::tuple<std::string, std::string, std::string>> &contents) {\n'
+        struct_union_check += 'bool ApiDumpDecodeNextChain(XrGeneratedDispatchTable* gen_dispatch_table, const void* value, const char* name,\n'
+        struct_union_check += '                            ApiDumpContents& contents) {\n'
         struct_union_check += self.writeIndent(1)
         struct_union_check += '(void)gen_dispatch_table;  // silence warning\n'
         struct_union_check += '    try {\n'
-        struct_union_check += '        contents.emplace_back("const void *", prefix, PointerToHexString(value));\n'
+        struct_union_check += '        contents.AddHexAddress("const void *", name, value);\n'
         struct_union_check += '        if (nullptr == value) {\n'
         struct_union_check += '            return true;\n'
         struct_union_check += '        }\n'
@@ -1010,7 +940,7 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 struct_union_check += self.writeIndent(3)
                 struct_union_check += 'case %s:\n' % cur_value.name
                 struct_union_check += self.writeIndent(4)
-                struct_union_check += 'if (!ApiDumpOutputXrStruct(gen_dispatch_table, reinterpret_cast<const %s*>(value), prefix, "const %s*", true, contents)) {\n' % (
+                struct_union_check += 'if (!ApiDumpOutputXrStruct(gen_dispatch_table, reinterpret_cast<const %s*>(value), name, "const %s*", true, contents)) {\n' % (
                     struct_define_name, struct_define_name)
                 struct_union_check += self.writeIndent(5)
                 struct_union_check += 'return false;\n'
@@ -1098,8 +1028,6 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                     generated_commands += return_prefix
 
                 generated_commands += '    try {\n'
-                generated_commands += '        // Generate output for this command\n'
-                generated_commands += '        std::vector<std::tuple<std::string, std::string, std::string>> contents;\n'
 
                 # Next, we have to call down to the next implementation of this command in the call chain.
                 # Before we can do that, we have to figure out what the dispatch table is
@@ -1107,21 +1035,31 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                     handle_param = cur_cmd.params[0]
                     base_handle_name = undecorate(handle_param.type)
                     first_handle_name = self.getFirstHandleName(handle_param)
-                    generated_commands += '        std::unique_lock<std::mutex> mlock(g_%s_dispatch_mutex);\n' % base_handle_name
-                    generated_commands += '        auto map_iter = g_%s_dispatch_map.find(%s);\n' % (base_handle_name, first_handle_name)
-                    generated_commands += '        mlock.unlock();\n\n'
-                    generated_commands += '        if (map_iter == g_%s_dispatch_map.end()) return XR_ERROR_VALIDATION_FAILURE;\n' % base_handle_name
-                    generated_commands += '        XrGeneratedDispatchTable *gen_dispatch_table = map_iter->second;\n'
+                    generated_commands += '        XrGeneratedDispatchTable *gen_dispatch_table = g_%s_dispatch_map.Find(%s);\n' % (
+                        base_handle_name, first_handle_name)
+                    generated_commands += '        if (nullptr == gen_dispatch_table) return XR_ERROR_VALIDATION_FAILURE;\n'
                 else:
                     generated_commands += self.printCodeGenErrorMessage(
                         'Command %s does not have an OpenXR Object handle as the first parameter.' % cur_cmd.name)
 
-                # Print out a tuple for the header
+                # In capture mode, the parameters are encoded into a binary record instead, which is
+                # finished once the command returns.  In JSON lines mode, the whole call is written
+                # once it returns.
+                param_names = ', '.join(param.name for param in cur_cmd.params)
+                command_id = CaptureOutputGenerator.enumName('CAPTURE_COMMAND_', cur_cmd.name)
+                generated_commands += '\n        // Generate output for this command, unless it is filtered out\n'
+                generated_commands += '        const bool record = ApiDumpShouldRecordCommand(%s);\n' % command_id
+                generated_commands += '        ApiDumpCaptureCall capture(%s, record);\n' % command_id
+                generated_commands += '        ApiDumpJsonCall json(%s, record);\n' % command_id
+                generated_commands += '        if (capture.IsActive()) {\n'
+                generated_commands += '            CaptureEncode%sInputs(capture.Encoder(), %s);\n' % (base_name, param_names)
+                generated_commands += '        } else if (record && !json.IsActive()) {\n'
+                # Start the output for this command with the header
                 if has_return:
-                    generated_commands += '        contents.emplace_back("%s", "%s", "");\n' % (
+                    generated_commands += '            ApiDumpContents& contents = ApiDumpContents::BeginCommand("%s", "%s");\n' % (
                         cur_cmd.return_type.text, cur_cmd.name)
                 else:
-                    generated_commands += '        contents.emplace_back("void", "%s", "");\n' % cur_cmd.name
+                    generated_commands += '            ApiDumpContents& contents = ApiDumpContents::BeginCommand("void", "%s");\n' % cur_cmd.name
                 # Print out information for each parameter
                 for param in cur_cmd.params:
                     can_expand = False
@@ -1130,10 +1068,11 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                             (param.is_const or param.pointer_count == 0)):
                         can_expand = True
                     generated_commands += self.writeParamMember(
-                        param, False, can_expand, 2)
+                        param, False, can_expand, 3)
 
                 # Now record the information
-                generated_commands += '        ApiDumpLayerRecordContent(contents);\n\n'
+                generated_commands += '            ApiDumpLayerRecordContent(contents);\n'
+                generated_commands += '        }\n\n'
 
                 # Call down, looking for the returned result if required.
                 generated_commands += '        '
@@ -1148,35 +1087,33 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                     generated_commands += param.name
                     count = count + 1
                 generated_commands += ');\n'
+                generated_commands += '        if (capture.IsActive()) {\n'
+                generated_commands += '            CaptureEncode%sOutputs(capture.Encoder(), result, %s);\n' % (base_name, param_names)
+                generated_commands += '            capture.Finish(result);\n'
+                generated_commands += '        }\n'
+                generated_commands += '        if (json.IsActive()) {\n'
+                generated_commands += '            ApiDumpJsonWrite%sCall(json.Begin(), %s, %s);\n' % (
+                    base_name, 'result' if has_return else 'XR_SUCCESS', param_names)
+                generated_commands += '            json.Finish();\n'
+                generated_commands += '        }\n'
 
                 # If this is a create command, we have to create an entry in the appropriate
-                # unordered_map pointing to the correct dispatch table for the newly created
+                # registry pointing to the correct dispatch table for the newly created
                 # object.  Likewise, if it's a delete command, we have to remove the entry
-                # for the dispatch table from the unordered_map
+                # for the dispatch table from the registry
                 second_base_handle_name = ''
                 if cur_cmd.params[-1].is_handle and (is_create or is_destroy):
                     second_base_handle_name = undecorate(cur_cmd.params[-1].type)
                     if is_create:
                         generated_commands += '        if (XR_SUCCESS == result && nullptr != %s) {\n' % cur_cmd.params[-1].name
-                        generated_commands += '            auto exists = g_%s_dispatch_map.find(*%s);\n' % (
-                            second_base_handle_name, cur_cmd.params[-1].name)
-                        generated_commands += '            if (exists == g_%s_dispatch_map.end()) {\n' % second_base_handle_name
-                        generated_commands += '                std::unique_lock<std::mutex> lock(g_%s_dispatch_mutex);\n' % second_base_handle_name
-                        generated_commands += '                g_%s_dispatch_map[*%s] = gen_dispatch_table;\n' % (
+                        generated_commands += '            g_%s_dispatch_map.Insert(*%s, gen_dispatch_table, gen_dispatch_table);\n' % (
                             second_base_handle_name, cur_cmd.params[-1].name)
-                        generated_commands += '            }\n'
                         generated_commands += '        }\n'
                     elif is_destroy:
-                        generated_commands += '        auto exists = g_%s_dispatch_map.find(%s);\n' % (
+                        generated_commands += '        g_%s_dispatch_map.Erase(%s);\n' % (
                             second_base_handle_name, cur_cmd.params[-1].name)
-                        generated_commands += '        if (exists != g_%s_dispatch_map.end()) {\n' % second_base_handle_name
-                        generated_commands += '            std::unique_lock<std::mutex> lock(g_%s_dispatch_mutex);\n' % second_base_handle_name
-                        generated_commands += '            g_%s_dispatch_map.erase(%s);\n' % (
-                            second_base_handle_name, cur_cmd.params[-1].name)
-                        generated_commands += '        }\n'
 
-                # Catch any exceptions that may have occurred.  If any occurred between any of the
-                # valid mutex lock/unlock statements, perform the unlock now.
+                # Catch any exceptions that may have occurred.
                 generated_commands += '    } catch (...) {\n'
                 if has_return:
                     generated_commands += '        return XR_ERROR_VALIDATION_FAILURE;\n'
@@ -1196,19 +1133,18 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
         generated_commands += '    const char*                                 name,\n'
         generated_commands += '    PFN_xrVoidFunction*                         function) {\n'
         generated_commands += '    try {\n'
-        generated_commands += '        std::string func_name = name;\n\n'
-        generated_commands += '        // Generate output for this command\n'
-        generated_commands += '        std::vector<std::tuple<std::string, std::string, std::string>> contents;\n'
-        generated_commands += '        contents.emplace_back("XrResult", "xrGetInstanceProcAddr", "");\n'
-        generated_commands += '        contents.emplace_back("XrInstance", "instance", HandleToHexString(instance));\n'
-        generated_commands += '        contents.emplace_back("const char*", "name", name);\n'
-        generated_commands += '        contents.emplace_back("PFN_xrVoidFunction*", "function", PointerToHexString(reinterpret_cast<const void*>(function)));\n'
-        generated_commands += '        ApiDumpLayerRecordContent(contents);\n'
+        generated_commands += '        // Generate output for this command, unless it is filtered out\n'
+        generated_commands += '        if (ApiDumpShouldRecordCommand(CAPTURE_COMMAND_XR_GET_INSTANCE_PROC_ADDR)) {\n'
+        generated_commands += '            ApiDumpContents& contents = ApiDumpContents::BeginCommand("XrResult", "xrGetInstanceProcAddr");\n'
+        generated_commands += '            contents.AddHandle("XrInstance", "instance", instance);\n'
+        generated_commands += '            contents.AddString("const char*", "name", name);\n'
+        generated_commands += '            contents.AddHexAddress("PFN_xrVoidFunction*", "function", reinterpret_cast<const void*>(function));\n'
+        generated_commands += '            ApiDumpLayerRecordContent(contents);\n'
+        generated_commands += '        }\n'
 
         generated_commands += '        // Set the function pointer to NULL so that the fall-through below actually works:\n'
         generated_commands += '        *function = nullptr;\n\n'
-
-        count = 0
+        generated_commands += '        switch (ReflectionCommandFromName(name)) {\n'
         for x in range(0, 2):
             if x == 0:
                 commands = self.core_commands
@@ -1218,19 +1154,15 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
             for cur_cmd in commands:
                 if cur_cmd.ext_name != cur_extension_name:
                     if self.isCoreExtensionName(cur_cmd.ext_name):
-                        generated_commands += '\n        // ---- Core %s commands\n' % cur_cmd.ext_name[11:].replace(
+                        generated_commands += '\n            // ---- Core %s commands\n' % cur_cmd.ext_name[11:].replace(
                             "_", ".")
                     else:
-                        generated_commands += '\n        // ---- %s extension commands\n' % cur_cmd.ext_name
+                        generated_commands += '\n            // ---- %s extension commands\n' % cur_cmd.ext_name
                     cur_extension_name = cur_cmd.ext_name
 
                 if cur_cmd.name in self.no_trampoline_or_terminator:
                     continue
 
-                has_return = False
-                if cur_cmd.return_type is not None:
-                    has_return = True
-
                 # Replace 'xr' in proto name with an API Dump-specific name to avoid collisions.s
                 layer_command_name = cur_cmd.name.replace(
                     "xr", "ApiDumpLayerXr")
@@ -1238,29 +1170,21 @@ class ApiDumpOutputGenerator(AutomaticSourceOutputGenerator):
                 if cur_cmd.protect_value:
                     generated_commands += '#if %s\n' % cur_cmd.protect_string
 
-                if count == 0:
-                    generated_commands += '        if (func_name == "%s") {\n' % cur_cmd.name
-                else:
-                    generated_commands += '        } else if (func_name == "%s") {\n' % cur_cmd.name
-                count = count + 1
-
-                generated_commands += '            *function = reinterpret_cast<PFN_xrVoidFunction>(%s);\n' % layer_command_name
+                generated_commands += '            case %s:\n' % reflectionCommandId(cur_cmd.name)
+                generated_commands += '                *function = reinterpret_cast<PFN_xrVoidFunction>(%s);\n' % layer_command_name
+                generated_commands += '                break;\n'
                 if cur_cmd.protect_value:
                     generated_commands += '#endif // %s\n' % cur_cmd.protect_string
 
+        generated_commands += '            default:\n'
+        generated_commands += '                break;\n'
         generated_commands += '        }\n'
         generated_commands += '        // If we setup the function, just return\n'
         generated_commands += '        if (*function != nullptr) {\n'
         generated_commands += '            return XR_SUCCESS;\n'
         generated_commands += '        }\n\n'
         generated_commands += '        // We have not found it, so pass it down to the next layer/runtime\n'
-        generated_commands += '        std::unique_lock<std::mutex> mlock(g_instance_dispatch_mutex);\n'
-        generated_commands += '        auto map_iter = g_instance_dispatch_map.find(instance);\n'
-        generated_commands += '        mlock.unlock();\n\n'
-        generated_commands += '        if (map_iter == g_instance_dispatch_map.end()) {\n'
-        generated_commands += '            return XR_ERROR_HANDLE_INVALID;\n'
-        generated_commands += '        }\n\n'
-        generated_commands += '        XrGeneratedDispatchTable *gen_dispatch_table = map_iter->second;\n'
+        generated_commands += '        XrGeneratedDispatchTable *gen_dispatch_table = g_instance_dispatch_map.Find(instance);\n'
         generated_commands += '        if (nullptr == gen_dispatch_table) {\n'
         generated_commands += '            return XR_ERROR_HANDLE_INVALID;\n'
         generated_commands += '        }\n\n'
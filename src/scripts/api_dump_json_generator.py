@@ -0,0 +1,403 @@
+#!/usr/bin/python3 -i
+#
+# Copyright (c) 2017-2021, The Khronos Group Inc.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Purpose:      This file utilizes the content formatted in the
+#               automatic_source_generator.py class to produce the
+#               generated source code writing each call as a line of
+#               JSON, for the JSON lines output of the API Dump layer.
+
+import re
+
+from automatic_source_generator import AutomaticSourceOutputGenerator
+from capture_generator import CaptureOutputGenerator, POLYMORPHIC_OUTPUTS
+from generator import write
+from reflection_source_generator import REFLECTED_ENUM_NAME_FUNCTIONS
+
+# Types which are safe to read through a pointer, besides those defined by OpenXR.
+C_TYPES = set((
+    'char',
+    'float',
+    'double',
+    'int8_t',
+    'int16_t',
+    'int32_t',
+    'int64_t',
+    'uint8_t',
+    'uint16_t',
+    'uint32_t',
+    'uint64_t',
+    'size_t',
+))
+
+# ApiDumpJsonOutputGenerator - subclass of CaptureOutputGenerator, for the type checks it shares
+# with the call capture.
+
+
+class ApiDumpJsonOutputGenerator(CaptureOutputGenerator):
+    """Generate API Dump JSON lines writers using XML element attributes from registry"""
+
+    # Override the base class header warning so the comment indicates this file.
+    #   self            the ApiDumpJsonOutputGenerator object
+    def outputGeneratedHeaderWarning(self):
+        # File Comment
+        generated_warning = '// *********** THIS FILE IS GENERATED - DO NOT EDIT ***********\n'
+        generated_warning += '//     See api_dump_json_generator.py for modifications\n'
+        generated_warning += '// ************************************************************\n'
+        write(generated_warning, file=self.outFile)
+
+    # Call the base class to properly begin the file, and then add
+    # the file-specific header information.
+    #   self            the ApiDumpJsonOutputGenerator object
+    #   gen_opts        the AutomaticSourceGeneratorOptions object
+    def beginFile(self, genOpts):
+        AutomaticSourceOutputGenerator.beginFile(self, genOpts)
+        preamble = ''
+        if self.genOpts.filename == 'xr_generated_api_dump_json.hpp':
+            preamble += '#pragma once\n\n'
+            preamble += '#include "api_dump_json.h"\n'
+            preamble += '#include "xr_dependencies.h"\n'
+            preamble += '#include <openxr/openxr.h>\n'
+            preamble += '#include <openxr/openxr_platform.h>\n\n'
+        elif self.genOpts.filename == 'xr_generated_api_dump_json.cpp':
+            preamble += '#include "xr_generated_api_dump_json.hpp"\n'
+            preamble += '#include "xr_generated_reflection.hpp"\n\n'
+            preamble += '#include <cstdint>\n\n'
+        write(preamble, file=self.outFile)
+
+    # Write out all the information for the appropriate file,
+    # and then call down to the base class to wrap everything up.
+    #   self            the ApiDumpJsonOutputGenerator object
+    def endFile(self):
+        self.plain_structs = {}
+        file_data = ''
+        if self.genOpts.filename == 'xr_generated_api_dump_json.hpp':
+            file_data += self.outputCommandPrototypes()
+        elif self.genOpts.filename == 'xr_generated_api_dump_json.cpp':
+            generic = self.outputGenericStructFunctions()
+            commands = self.outputCommandWriters()
+            file_data += self.outputTypeFunctions(generic + commands)
+            file_data += generic
+            file_data += commands
+        write(file_data, file=self.outFile)
+
+        # Finish processing in superclass
+        AutomaticSourceOutputGenerator.endFile(self)
+
+    def isStructOrUnion(self, type_name):
+        return self.isStruct(type_name) or self.isUnion(type_name)
+
+    # Values of platform types, other than handles, may be incomplete types, and so are only written
+    # by address when passed by pointer.
+    def isReadable(self, type_name):
+        return type_name.startswith('Xr') or type_name in C_TYPES
+
+    def writerName(self, type_name):
+        return 'ApiDumpJsonWrite%s' % type_name
+
+    def enumNameFunction(self, type_name):
+        if type_name in REFLECTED_ENUM_NAME_FUNCTIONS:
+            return REFLECTED_ENUM_NAME_FUNCTIONS[type_name]
+        return 'ApiDumpJson%sName' % type_name
+
+    # The line writing one value of a type, other than an array or a pointer.
+    #   self            the ApiDumpJsonOutputGenerator object
+    #   type_name       the type of the value
+    #   expr            the value
+    #   ind             the indentation
+    def valueLine(self, type_name, expr, ind):
+        if self.isHandle(type_name):
+            return '%swriter.Handle(%s);' % (ind, expr)
+        if type_name.startswith('PFN_'):
+            return '%swriter.Address(reinterpret_cast<const void*>(%s));' % (ind, expr)
+        if self.isStructOrUnion(type_name):
+            return '%s%s(writer, %s);' % (ind, self.writerName(type_name), expr)
+        if self.isEnumType(type_name):
+            return '%swriter.Enum(%s(%s), %s);' % (ind, self.enumNameFunction(type_name), expr, expr)
+        return '%swriter.Value(%s);' % (ind, expr)
+
+    # Lines writing each element of a fixed size array, as nested JSON arrays.
+    #   self            the ApiDumpJsonOutputGenerator object
+    #   member          a MemberOrParam object for the array
+    #   expr            the array
+    #   sizes           the sizes of the dimensions left
+    #   indent          the indentation level
+    def staticArrayLines(self, member, expr, sizes, indent):
+        ind = self.writeIndent(indent)
+        if len(sizes) == 1 and member.type == 'char':
+            return ['%swriter.StringUpTo(%s, %s);' % (ind, expr, sizes[0])]
+        index = 'i%d' % (len(member.static_array_sizes) - len(sizes))
+        lines = ['%swriter.BeginArray();' % ind]
+        lines.append('%sfor (uint32_t %s = 0; %s < %s; ++%s) {' % (ind, index, index, sizes[0], index))
+        element = '%s[%s]' % (expr, index)
+        if len(sizes) > 1:
+            lines += self.staticArrayLines(member, element, sizes[1:], indent + 1)
+        else:
+            lines.append(self.valueLine(member.type, element, self.writeIndent(indent + 1)))
+        lines.append('%s}' % ind)
+        lines.append('%swriter.EndArray();' % ind)
+        return lines
+
+    # Lines writing the value of one member or parameter, as it is once the call returns.
+    #   self            the ApiDumpJsonOutputGenerator object
+    #   member          a MemberOrParam object
+    #   prefix          what the member is accessed through, such as "value."
+    #   siblings        the members or parameters next to this one
+    #   indent          the indentation level
+    def jsonLines(self, member, prefix, siblings, indent):
+        expr = prefix + member.name
+        type_name = member.type
+        stars = self.starCount(member)
+        ind = self.writeIndent(indent)
+        lines = []
+        if member.name == 'next':
+            lines.append('%sApiDumpJsonWriteNextChain(writer, %s);' % (ind, expr))
+        elif member.is_static_array and stars == 0:
+            lines += self.staticArrayLines(member, expr, member.static_array_sizes, indent)
+        elif stars == 0:
+            lines.append(self.valueLine(type_name, expr, ind))
+        elif member.pointer_count_var and stars == 1 and not (self.isReadable(type_name) or self.isHandle(type_name)):
+            lines.append('%swriter.Address(%s);' % (ind, expr))
+        elif member.pointer_count_var:
+            count = self.countExpression(member, prefix, siblings, False)
+            lines.append('%sif (%s == nullptr) {' % (ind, expr))
+            lines.append('%s    writer.Null();' % ind)
+            if stars == 1 and type_name == 'char':
+                # A string buffer, whose count includes the terminating null character.
+                lines.append('%s} else {' % ind)
+                lines.append('%s    writer.StringUpTo(%s, %s);' % (ind, expr, count))
+            elif stars == 1 and self.isBaseHeader(type_name):
+                lines.append('%s} else {' % ind)
+                lines.append('%s    ApiDumpJsonWriteStructArray(writer, %s, %s);' % (ind, expr, count))
+            else:
+                if stars == 2 and type_name == 'char':
+                    element = '%s    writer.String(%s[i]);' % (ind, expr)
+                elif stars == 2 and self.isStruct(type_name):
+                    element = '%s    ApiDumpJsonWriteStruct(writer, %s[i]);' % (ind, expr)
+                elif stars == 1:
+                    element = self.valueLine(type_name, '%s[i]' % expr, ind + '    ')
+                else:
+                    element = self.printCodeGenErrorMessage('Array %s is not supported' % expr)
+                lines.append('%s} else {' % ind)
+                lines.append('%s    uint32_t count = %s;' % (ind, count))
+                lines.append('%s    writer.BeginArray();' % ind)
+                lines.append('%s    for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('    ' + element)
+                lines.append('%s    }' % ind)
+                lines.append('%s    writer.EndArray();' % ind)
+            lines.append('%s}' % ind)
+        elif stars == 1 and type_name == 'char':
+            lines.append('%swriter.String(%s);' % (ind, expr))
+        elif stars == 1 and (self.isTypedStruct(type_name) or self.isBaseHeader(type_name)):
+            lines.append('%sApiDumpJsonWriteStruct(writer, %s);' % (ind, expr))
+        elif stars == 1 and (self.isReadable(type_name) or self.isHandle(type_name)) and not self.isOpaque(type_name):
+            lines.append('%sif (%s == nullptr) {' % (ind, expr))
+            lines.append('%s    writer.Null();' % ind)
+            lines.append('%s} else {' % ind)
+            lines.append(self.valueLine(type_name, '*' + expr, ind + '    '))
+            lines.append('%s}' % ind)
+        else:
+            # Opaque and platform types, and pointers to pointers.
+            lines.append('%swriter.Address(%s);' % (ind, expr))
+        return lines
+
+    # The structures and unions which get their own functions.
+    def writtenStructs(self):
+        return [struct for struct in self.api_structures + self.api_unions
+                if struct.name not in self.structs_with_no_type and not self.isBaseHeader(struct.name)]
+
+    # Output the functions writing each enum value by name, and each structure and union as an
+    # object, leaving out those which nothing calls.
+    #   self            the ApiDumpJsonOutputGenerator object
+    #   callers         the code calling these functions
+    def outputTypeFunctions(self, callers):
+        candidates = []
+        for enum in self.api_enums:
+            # The generated reflection header already names these.
+            if enum.name in REFLECTED_ENUM_NAME_FUNCTIONS:
+                continue
+            name = self.enumNameFunction(enum.name)
+            prototype = 'static const char* %s(%s value)' % (name, enum.name)
+            body = '    switch (value) {\n'
+            for value in enum.values:
+                if value.alias:
+                    continue
+                if value.protect_value:
+                    body += '#if %s\n' % value.protect_string
+                body += '        case %s:\n' % value.name
+                body += '            return "%s";\n' % value.name
+                if value.protect_value:
+                    body += '#endif // %s\n' % value.protect_string
+            body += '        default:\n'
+            body += '            return nullptr;\n'
+            body += '    }\n'
+            candidates.append((enum, name, prototype, body))
+        for struct in self.writtenStructs():
+            name = self.writerName(struct.name)
+            prototype = 'static void %s(ApiDumpJsonWriter& writer, const %s& value)' % (name, struct.name)
+            body = '    writer.BeginObject();\n'
+            for member in struct.members:
+                body += '    writer.Key("%s");\n' % member.name
+                body += ''.join(line + '\n' for line in self.jsonLines(member, 'value.', struct.members, 1))
+            body += '    writer.EndObject();\n'
+            candidates.append((struct, name, prototype, body))
+
+        used = set()
+        pending = [callers]
+        while pending:
+            code = pending.pop()
+            for item, name, prototype, body in candidates:
+                if name not in used and re.search(r'\b%s\(' % name, code):
+                    used.add(name)
+                    pending.append(body)
+
+        # Prototypes first, since structures contain each other.
+        functions = ''
+        for item, name, prototype, body in candidates:
+            if name in used:
+                if item.protect_value:
+                    functions += '#if %s\n' % item.protect_string
+                functions += '%s;\n' % prototype
+                if item.protect_value:
+                    functions += '#endif // %s\n' % item.protect_string
+        functions += 'static void ApiDumpJsonWriteStructArray(ApiDumpJsonWriter& writer, const void* value, uint32_t count);\n'
+        functions += 'static void ApiDumpJsonWriteStruct(ApiDumpJsonWriter& writer, const void* value);\n'
+        functions += 'static void ApiDumpJsonWriteNextChain(ApiDumpJsonWriter& writer, const void* next);\n\n'
+
+        for item, name, prototype, body in candidates:
+            if name in used:
+                if item.protect_value:
+                    functions += '#if %s\n' % item.protect_string
+                functions += '%s {\n%s}\n' % (prototype, body)
+                if item.protect_value:
+                    functions += '#endif // %s\n' % item.protect_string
+                functions += '\n'
+        return functions
+
+    # Output the functions writing a structure by its structure type, for next chains and pointers
+    # to base structures.
+    #   self            the ApiDumpJsonOutputGenerator object
+    def outputGenericStructFunctions(self):
+        def write_case(struct_name):
+            case = '            writer.BeginArray();\n'
+            case += '            for (uint32_t i = 0; i < count; ++i) {\n'
+            case += '                %s(writer, reinterpret_cast<const %s*>(value)[i]);\n' % (
+                self.writerName(struct_name), struct_name)
+            case += '            }\n'
+            case += '            writer.EndArray();\n'
+            case += '            return true;\n'
+            return case
+
+        functions = '// Writes an array of count structures of the type of the first one, returning false for an unknown type.\n'
+        functions += 'static bool ApiDumpJsonWriteKnownStructs(ApiDumpJsonWriter& writer, const void* value, uint32_t count) {\n'
+        functions += '    switch (reinterpret_cast<const XrBaseInStructure*>(value)->type) {\n'
+        functions += self.structureTypeCases(write_case)
+        functions += '        default:\n'
+        functions += '            return false;\n'
+        functions += '    }\n'
+        functions += '}\n\n'
+        functions += '// The elements of an array of unknown structures cannot be found, so it is written by address.\n'
+        functions += 'static void ApiDumpJsonWriteStructArray(ApiDumpJsonWriter& writer, const void* value, uint32_t count) {\n'
+        functions += '    if (value == nullptr) {\n'
+        functions += '        writer.Null();\n'
+        functions += '    } else if (!ApiDumpJsonWriteKnownStructs(writer, value, count)) {\n'
+        functions += '        writer.Address(value);\n'
+        functions += '    }\n'
+        functions += '}\n\n'
+        functions += '// Writes a structure of an unknown type with only its type.\n'
+        functions += 'static void ApiDumpJsonWriteUnknownStruct(ApiDumpJsonWriter& writer, const void* value) {\n'
+        functions += '    writer.BeginObject();\n'
+        functions += '    writer.Key("type");\n'
+        functions += '    XrStructureType type = reinterpret_cast<const XrBaseInStructure*>(value)->type;\n'
+        functions += '    writer.Enum(%s(type), type);\n' % self.enumNameFunction('XrStructureType')
+        functions += '    writer.EndObject();\n'
+        functions += '}\n\n'
+        functions += '// Writes a structure by its structure type, as an object rather than an array of one.\n'
+        functions += 'static void ApiDumpJsonWriteStruct(ApiDumpJsonWriter& writer, const void* value) {\n'
+        functions += '    if (value == nullptr) {\n'
+        functions += '        writer.Null();\n'
+        functions += '        return;\n'
+        functions += '    }\n'
+        functions += '    switch (reinterpret_cast<const XrBaseInStructure*>(value)->type) {\n'
+
+        def single_case(struct_name):
+            case = '            %s(writer, *reinterpret_cast<const %s*>(value));\n' % (self.writerName(struct_name), struct_name)
+            case += '            return;\n'
+            return case
+        functions += self.structureTypeCases(single_case)
+        functions += '        default:\n'
+        functions += '            ApiDumpJsonWriteUnknownStruct(writer, value);\n'
+        functions += '            return;\n'
+        functions += '    }\n'
+        functions += '}\n\n'
+        functions += '// Writes the structures of a next chain as an array, in order.\n'
+        functions += 'static void ApiDumpJsonWriteNextChain(ApiDumpJsonWriter& writer, const void* next) {\n'
+        functions += '    writer.BeginArray();\n'
+        functions += '    for (; next != nullptr; next = reinterpret_cast<const XrBaseInStructure*>(next)->next) {\n'
+        functions += '        ApiDumpJsonWriteStruct(writer, next);\n'
+        functions += '    }\n'
+        functions += '    writer.EndArray();\n'
+        functions += '}\n\n'
+        return functions
+
+    # Output the prototypes of the functions the API Dump layer writes each call with.
+    #   self            the ApiDumpJsonOutputGenerator object
+    def outputCommandPrototypes(self):
+        prototypes = '// Write the result and parameters of a call, once it returns, as members of the object of the call\n'
+        for cmd in self.capturedCommands():
+            if cmd.protect_value:
+                prototypes += '#if %s\n' % cmd.protect_string
+            prototypes += 'void ApiDumpJsonWrite%sCall(ApiDumpJsonWriter& writer, XrResult result, %s);\n' % (
+                cmd.name[2:], self.paramList(cmd))
+            if cmd.protect_value:
+                prototypes += '#endif // %s\n' % cmd.protect_string
+        return prototypes
+
+    # Output the functions writing the result and parameters of each command.  What the command
+    # returned through its parameters is only written when it succeeded, and otherwise only where
+    # it would have been returned to.
+    #   self            the ApiDumpJsonOutputGenerator object
+    def outputCommandWriters(self):
+        writers = '// Command writers\n'
+        for cmd in self.capturedCommands():
+            if cmd.protect_value:
+                writers += '#if %s\n' % cmd.protect_string
+            writers += 'void ApiDumpJsonWrite%sCall(ApiDumpJsonWriter& writer, XrResult result, %s) {\n' % (
+                cmd.name[2:], self.paramList(cmd))
+            writers += '    writer.Key("result");\n'
+            writers += '    writer.Enum(%s(result), result);\n' % self.enumNameFunction('XrResult')
+            writers += '    writer.Key("params");\n'
+            writers += '    writer.BeginObject();\n'
+            for param in cmd.params:
+                lines = self.jsonLines(param, '', cmd.params, 1)
+                writers += '    writer.Key("%s");\n' % param.name
+                if param in self.outputParams(cmd):
+                    if param.type in POLYMORPHIC_OUTPUTS:
+                        writers += '    if (result != XR_SUCCESS) {\n'
+                    else:
+                        writers += '    if (XR_FAILED(result)) {\n'
+                    writers += '        writer.Address(%s);\n' % param.name
+                    writers += '    } else {\n'
+                    writers += ''.join('    ' + line + '\n' for line in lines)
+                    writers += '    }\n'
+                else:
+                    writers += ''.join(line + '\n' for line in lines)
+            writers += '    writer.EndObject();\n'
+            writers += '}\n\n'
+            if cmd.protect_value:
+                writers += '#endif // %s\n' % cmd.protect_string
+        return writers
@@ -0,0 +1,773 @@
+#!/usr/bin/python3 -i
+#
+# Copyright (c) 2017-2021, The Khronos Group Inc.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Purpose:      This file utilizes the content formatted in the
+#               automatic_source_generator.py class to produce the
+#               generated source code for the call capture written by
+#               the API Dump layer, and read back by openxr_replay.
+
+import re
+
+from automatic_source_generator import AutomaticSourceOutputGenerator
+from generator import write
+
+# Types only ever captured by address, since the capture cannot copy what they point to.
+OPAQUE_TYPES = set((
+    'void',
+    'Display',
+    'IUnknown',
+    'VkAllocationCallbacks',
+    'VkDeviceCreateInfo',
+    'VkInstanceCreateInfo',
+))
+
+# Output structures captured by their actual type, and only when the command returned XR_SUCCESS.
+POLYMORPHIC_OUTPUTS = set((
+    'XrEventDataBuffer',
+))
+
+# CaptureOutputGenerator - subclass of AutomaticSourceOutputGenerator.
+
+
+class CaptureOutputGenerator(AutomaticSourceOutputGenerator):
+    """Generate call capture and replay source using XML element attributes from registry"""
+
+    # Override the base class header warning so the comment indicates this file.
+    #   self            the AutomaticSourceOutputGenerator object
+    def outputGeneratedHeaderWarning(self):
+        # File Comment
+        generated_warning = '// *********** THIS FILE IS GENERATED - DO NOT EDIT ***********\n'
+        generated_warning += '//     See capture_generator.py for modifications\n'
+        generated_warning += '// ************************************************************\n'
+        write(generated_warning, file=self.outFile)
+
+    # Call the base class to properly begin the file, and then add
+    # the file-specific header information.
+    #   self            the CaptureOutputGenerator object
+    #   gen_opts        the AutomaticSourceGeneratorOptions object
+    def beginFile(self, genOpts):
+        AutomaticSourceOutputGenerator.beginFile(self, genOpts)
+        preamble = ''
+        if self.genOpts.filename == 'xr_generated_capture.hpp':
+            preamble += '#pragma once\n\n'
+            preamble += '#include "capture_stream.h"\n'
+            preamble += '#include "xr_dependencies.h"\n'
+            preamble += '#include <openxr/openxr.h>\n'
+            preamble += '#include <openxr/openxr_platform.h>\n\n'
+            preamble += '#include <cstdint>\n\n'
+        elif self.genOpts.filename == 'xr_generated_capture.cpp':
+            preamble += '#include "xr_generated_capture.hpp"\n\n'
+            preamble += '#include <cstdint>\n\n'
+        elif self.genOpts.filename == 'xr_generated_replay.cpp':
+            preamble += '#include "replay_decoder.h"\n'
+            preamble += '#include "xr_generated_capture.hpp"\n'
+            preamble += '#include "xr_generated_dispatch_table.h"\n\n'
+            preamble += '#include <cstdint>\n'
+            preamble += '#include <stdexcept>\n\n'
+        write(preamble, file=self.outFile)
+
+    # Write out all the information for the appropriate file,
+    # and then call down to the base class to wrap everything up.
+    #   self            the CaptureOutputGenerator object
+    def endFile(self):
+        self.plain_structs = {}
+        file_data = ''
+        if self.genOpts.filename == 'xr_generated_capture.hpp':
+            file_data += self.outputCommandIds()
+            file_data += self.outputEncodePrototypes()
+        elif self.genOpts.filename == 'xr_generated_capture.cpp':
+            generic = self.outputGenericStructFunctions(True)
+            commands = self.outputCommandEncoders()
+            file_data += self.outputStructFunctions(True, generic + commands)
+            file_data += generic
+            file_data += commands
+        elif self.genOpts.filename == 'xr_generated_replay.cpp':
+            generic = self.outputGenericStructFunctions(False)
+            commands = self.outputCommandReplays()
+            file_data += self.outputObjectKinds()
+            file_data += self.outputStructFunctions(False, generic + commands)
+            file_data += generic
+            file_data += commands
+        write(file_data, file=self.outFile)
+
+        # Finish processing in superclass
+        AutomaticSourceOutputGenerator.endFile(self)
+
+    # The commands which reach the API layers, and so can be captured.
+    #   self            the CaptureOutputGenerator object
+    def capturedCommands(self):
+        return [cmd for cmd in self.core_commands + self.ext_commands
+                if cmd.name not in self.no_trampoline_or_terminator]
+
+    # Turn a name like XrSystemId into XR_SYSTEM_ID, prefixed.  Also used by the api_dump layer
+    # generator, for the CaptureCommand values.
+    #   prefix          the prefix for the enum value
+    #   name            the command or type name
+    @staticmethod
+    def enumName(prefix, name):
+        return prefix + re.sub('([a-z0-9])([A-Z])', r'\1_\2', name).upper()
+
+    # The number of pointer indirections in a member or parameter declaration.
+    #   self            the CaptureOutputGenerator object
+    #   member          a MemberOrParam object
+    def starCount(self, member):
+        return member.cdecl.count('*')
+
+    def isAtom(self, type_name):
+        base_type = self.getBaseType(type_name)
+        return base_type is not None and base_type.type == 'XR_DEFINE_ATOM'
+
+    # Handles and atoms are captured as values, and translated when replayed.
+    def isObject(self, type_name):
+        return self.isHandle(type_name) or self.isAtom(type_name)
+
+    # Structures starting with a structure type, which lets them be found in next chains.
+    def isTypedStruct(self, type_name):
+        struct = self.getStruct(type_name)
+        return (struct is not None and type_name not in self.structs_with_no_type and
+                self.getRelationGroupForBaseStruct(type_name) is None and
+                len(struct.members) > 0 and struct.members[0].name == 'type')
+
+    def isBaseHeader(self, type_name):
+        return self.getRelationGroupForBaseStruct(type_name) is not None
+
+    def isOpaque(self, type_name):
+        return type_name in OPAQUE_TYPES or type_name.startswith('ID3D')
+
+    # A structure without pointers, handles or atoms, anywhere inside it, is captured as raw bytes.
+    #   self            the CaptureOutputGenerator object
+    #   type_name       the name of the structure
+    def isPlainStruct(self, type_name):
+        if type_name in self.plain_structs:
+            return self.plain_structs[type_name]
+        struct = self.getStruct(type_name)
+        plain = struct is not None and not self.isBaseHeader(type_name) and type_name not in self.structs_with_no_type
+        if plain:
+            for member in struct.members:
+                if (member.name in ('type', 'next') or self.starCount(member) > 0 or member.type.startswith('PFN_') or
+                        self.isObject(member.type) or
+                        (self.isStruct(member.type) and not self.isPlainStruct(member.type))):
+                    plain = False
+                    break
+        self.plain_structs[type_name] = plain
+        return plain
+
+    # Structures which need their own functions, because they cannot be copied as raw bytes.
+    def isEncodedStruct(self, type_name):
+        return self.isStruct(type_name) and not self.isPlainStruct(type_name)
+
+    # The structures which get their own functions.
+    def encodedStructs(self):
+        return [struct for struct in self.api_structures
+                if struct.name not in self.structs_with_no_type and not self.isBaseHeader(struct.name) and
+                not self.isPlainStruct(struct.name)]
+
+    def functionName(self, encode, type_name, shape):
+        return '%s%s%s' % ('CaptureEncode' if encode else 'ReplayDecode', type_name, 'Shape' if shape else '')
+
+    # The element count written for an array: output arrays with a matching count output are limited to
+    # the elements actually returned.
+    #   self            the CaptureOutputGenerator object
+    #   member          a MemberOrParam object for the array
+    #   prefix          what the count and count output are accessed through
+    #   siblings        the members or parameters next to the array
+    #   shape           whether the structure is only being captured before the call
+    def countExpression(self, member, prefix, siblings, shape):
+        count = prefix + member.pointer_count_var
+        if not shape and member.pointer_count_var.endswith('CapacityInput'):
+            output_name = member.pointer_count_var.replace('CapacityInput', 'CountOutput')
+            for sibling in siblings:
+                if sibling.name == output_name:
+                    if self.starCount(sibling) > 0:
+                        output = prefix + output_name
+                        return '(%s != nullptr && *%s < %s ? *%s : %s)' % (output, output, count, output, count)
+                    output = prefix + output_name
+                    return '(%s < %s ? %s : %s)' % (output, count, output, count)
+        return count
+
+    # The pointer type a generic structure decode is cast to.
+    def pointerType(self, member, stars):
+        return '%s%s%s' % ('const ' if member.is_const else '', member.type, '*' * stars)
+
+    # Lines encoding one member or parameter.
+    #   self            the CaptureOutputGenerator object
+    #   member          a MemberOrParam object
+    #   prefix          what the member is accessed through, such as "value."
+    #   siblings        the members or parameters next to this one
+    #   shape           whether only the shape of an output is captured, before the call: the
+    #                   sizes of the buffers, but not what is in them
+    #   indent          the indentation level
+    def encodeLines(self, member, prefix, siblings, shape, indent):
+        expr = prefix + member.name
+        type_name = member.type
+        stars = self.starCount(member)
+        ind = self.writeIndent(indent)
+        shape_suffix = 'Shape' if shape else ''
+        lines = []
+        if member.name == 'next':
+            lines.append('%sCaptureEncodeNextChain%s(encoder, %s);' % (ind, shape_suffix, expr))
+        elif member.is_static_array and stars == 0:
+            if shape:
+                # The contents of arrays in outputs are not needed before the call.
+                pass
+            elif self.isEncodedStruct(type_name) or self.isObject(type_name):
+                if len(member.static_array_sizes) > 1:
+                    lines.append(self.printCodeGenErrorMessage('Multi-dimensional array %s is not supported' % expr))
+                    return lines
+                lines.append('%sfor (uint32_t i = 0; i < %s; ++i) {' % (ind, member.static_array_sizes[0]))
+                if self.isObject(type_name):
+                    lines.append('%s    encoder.WriteObject(%s[i]);' % (ind, expr))
+                else:
+                    lines.append('%s    %s(encoder, %s[i]);' % (ind, self.functionName(True, type_name, False), expr))
+                lines.append('%s}' % ind)
+            elif len(member.static_array_sizes) == 1:
+                # Array parameters are only pointers, so their size comes from the declaration.
+                lines.append('%sencoder.Write(%s, sizeof(%s[0]) * %s);' % (ind, expr, expr, member.static_array_sizes[0]))
+            else:
+                lines.append('%sencoder.WriteValue(%s);' % (ind, expr))
+        elif stars == 0:
+            if self.isObject(type_name):
+                lines.append('%sencoder.WriteObject(%s);' % (ind, expr))
+            elif type_name.startswith('PFN_'):
+                lines.append('%sencoder.WriteAddress(%s);' % (ind, expr))
+            elif self.isEncodedStruct(type_name):
+                lines.append('%s%s(encoder, %s);' % (ind, self.functionName(True, type_name, shape), expr))
+            else:
+                lines.append('%sencoder.WriteValue(%s);' % (ind, expr))
+        elif member.pointer_count_var:
+            count = self.countExpression(member, prefix, siblings, shape)
+            lines.append('%sif (%s == nullptr) {' % (ind, expr))
+            lines.append('%s    encoder.WriteCount(kCaptureNullCount);' % ind)
+            lines.append('%s} else {' % ind)
+            lines.append('%s    uint32_t count = %s;' % (ind, count))
+            lines.append('%s    encoder.WriteCount(count);' % ind)
+            if stars == 1 and self.isBaseHeader(type_name):
+                lines.append('%s    CaptureEncodeStructArray%s(encoder, %s, count);' % (ind, shape_suffix, expr))
+            elif stars == 1 and self.isEncodedStruct(type_name):
+                lines.append('%s    for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s        %s(encoder, %s[i]);' % (ind, self.functionName(True, type_name, shape), expr))
+                lines.append('%s    }' % ind)
+            elif shape:
+                # Only the size of buffers of values is needed before the call.
+                pass
+            elif stars == 2 and type_name == 'char':
+                lines.append('%s    for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s        encoder.WriteString(%s[i]);' % (ind, expr))
+                lines.append('%s    }' % ind)
+            elif stars == 2 and self.isStruct(type_name):
+                lines.append('%s    for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s        CaptureEncodeStruct(encoder, %s[i]);' % (ind, expr))
+                lines.append('%s    }' % ind)
+            elif stars == 1 and self.isObject(type_name):
+                lines.append('%s    for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s        encoder.WriteObject(%s[i]);' % (ind, expr))
+                lines.append('%s    }' % ind)
+            elif stars == 1:
+                lines.append('%s    encoder.Write(%s, count * sizeof(%s[0]));' % (ind, expr, expr))
+            else:
+                lines.append(self.printCodeGenErrorMessage('Array %s is not supported' % expr))
+            lines.append('%s}' % ind)
+        elif type_name == 'char' and stars == 1:
+            lines.append('%sencoder.WriteString(%s);' % (ind, expr))
+        elif stars == 1 and self.isOpaque(type_name):
+            if not shape:
+                lines.append('%sencoder.WriteAddress(%s);' % (ind, expr))
+        elif stars == 1 and (self.isTypedStruct(type_name) or self.isBaseHeader(type_name)):
+            lines.append('%sCaptureEncodeStruct%s(encoder, %s);' % (ind, shape_suffix, expr))
+        elif stars == 1 and self.isEncodedStruct(type_name):
+            lines.append('%sif (encoder.WritePresence(%s)) {' % (ind, expr))
+            lines.append('%s    %s(encoder, *%s);' % (ind, self.functionName(True, type_name, shape), expr))
+            lines.append('%s}' % ind)
+        elif shape:
+            lines.append('%sencoder.WritePresence(%s);' % (ind, expr))
+        elif stars == 1 and self.isObject(type_name):
+            lines.append('%sif (encoder.WritePresence(%s)) {' % (ind, expr))
+            lines.append('%s    encoder.WriteObject(*%s);' % (ind, expr))
+            lines.append('%s}' % ind)
+        elif stars <= 2:
+            lines.append('%sif (encoder.WritePresence(%s)) {' % (ind, expr))
+            lines.append('%s    encoder.WriteValue(*%s);' % (ind, expr))
+            lines.append('%s}' % ind)
+        else:
+            lines.append(self.printCodeGenErrorMessage('Pointer %s is not supported' % expr))
+        return lines
+
+    # Lines decoding one member or parameter, mirroring encodeLines.
+    #   self            the CaptureOutputGenerator object
+    #   member          a MemberOrParam object
+    #   expr            the member or variable decoded into
+    #   shape           whether only the shape of an output was captured
+    #   indent          the indentation level
+    def decodeLines(self, member, expr, shape, indent):
+        type_name = member.type
+        stars = self.starCount(member)
+        ind = self.writeIndent(indent)
+        shape_suffix = 'Shape' if shape else ''
+        lines = []
+        if member.name == 'next':
+            lines.append('%s%s = ReplayDecodeStruct%s(decoder);' % (ind, expr, shape_suffix))
+        elif member.is_static_array and stars == 0:
+            if shape:
+                pass
+            elif self.isEncodedStruct(type_name) or self.isObject(type_name):
+                if len(member.static_array_sizes) > 1:
+                    lines.append(self.printCodeGenErrorMessage('Multi-dimensional array %s is not supported' % expr))
+                    return lines
+                lines.append('%sfor (uint32_t i = 0; i < %s; ++i) {' % (ind, member.static_array_sizes[0]))
+                if self.isObject(type_name):
+                    lines.append('%s    decoder.ReadObject(%s, %s[i]);' % (ind, self.enumName('REPLAY_OBJECT_', type_name), expr))
+                else:
+                    lines.append('%s    %s(decoder, %s[i]);' % (ind, self.functionName(False, type_name, False), expr))
+                lines.append('%s}' % ind)
+            elif len(member.static_array_sizes) == 1:
+                lines.append('%sdecoder.Read(%s, sizeof(%s[0]) * %s);' % (ind, expr, expr, member.static_array_sizes[0]))
+            else:
+                lines.append('%sdecoder.ReadValue(%s);' % (ind, expr))
+        elif stars == 0:
+            if self.isObject(type_name):
+                lines.append('%sdecoder.ReadObject(%s, %s);' % (ind, self.enumName('REPLAY_OBJECT_', type_name), expr))
+            elif type_name.startswith('PFN_'):
+                lines.append('%sdecoder.ReadAddress(%s);' % (ind, expr))
+            elif self.isEncodedStruct(type_name):
+                lines.append('%s%s(decoder, %s);' % (ind, self.functionName(False, type_name, shape), expr))
+            else:
+                lines.append('%sdecoder.ReadValue(%s);' % (ind, expr))
+        elif member.pointer_count_var:
+            if stars == 1 and self.isBaseHeader(type_name):
+                lines.append('%s{' % ind)
+                lines.append('%s    uint32_t count = decoder.ReadCount();' % ind)
+                lines.append('%s    if (count != kCaptureNullCount) {' % ind)
+                lines.append('%s        %s = static_cast<%s>(ReplayDecodeStructArray%s(decoder, count));' % (
+                    ind, expr, self.pointerType(member, 1), shape_suffix))
+                lines.append('%s    }' % ind)
+                lines.append('%s}' % ind)
+            elif stars == 1 and self.isEncodedStruct(type_name):
+                lines.append('%s{' % ind)
+                lines.append('%s    uint32_t count = decoder.ReadCount();' % ind)
+                lines.append('%s    if (count != kCaptureNullCount) {' % ind)
+                lines.append('%s        %s* elements = decoder.Allocate<%s>(count);' % (ind, type_name, type_name))
+                lines.append('%s        for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s            %s(decoder, elements[i]);' % (ind, self.functionName(False, type_name, shape)))
+                lines.append('%s        }' % ind)
+                lines.append('%s        %s = elements;' % (ind, expr))
+                lines.append('%s    }' % ind)
+                lines.append('%s}' % ind)
+            elif shape:
+                lines.append('%sdecoder.ReadArrayShape(%s);' % (ind, expr))
+            elif stars == 2 and type_name == 'char':
+                lines.append('%sdecoder.ReadStringArray(%s);' % (ind, expr))
+            elif stars == 2 and self.isStruct(type_name):
+                element_type = self.pointerType(member, 1)
+                lines.append('%s{' % ind)
+                lines.append('%s    uint32_t count = decoder.ReadCount();' % ind)
+                lines.append('%s    if (count != kCaptureNullCount) {' % ind)
+                lines.append('%s        %s* elements = decoder.Allocate<%s>(count);' % (ind, element_type, element_type))
+                lines.append('%s        for (uint32_t i = 0; i < count; ++i) {' % ind)
+                lines.append('%s            elements[i] = static_cast<%s>(ReplayDecodeStruct(decoder));' % (ind, element_type))
+                lines.append('%s        }' % ind)
+                lines.append('%s        %s = elements;' % (ind, expr))
+                lines.append('%s    }' % ind)
+                lines.append('%s}' % ind)
+            elif stars == 1 and self.isObject(type_name):
+                lines.append('%sdecoder.ReadObjectArray(%s, %s);' % (ind, self.enumName('REPLAY_OBJECT_', type_name), expr))
+            elif stars == 1:
+                lines.append('%sdecoder.ReadArray(%s);' % (ind, expr))
+            else:
+                lines.append(self.printCodeGenErrorMessage('Array %s is not supported' % expr))
+        elif type_name == 'char' and stars == 1:
+            lines.append('%s%s = decoder.ReadString();' % (ind, expr))
+        elif stars == 1 and self.isOpaque(type_name):
+            if not shape:
+                lines.append('%sdecoder.ReadAddress(%s);' % (ind, expr))
+        elif stars == 1 and (self.isTypedStruct(type_name) or self.isBaseHeader(type_name)):
+            lines.append('%s%s = static_cast<%s>(ReplayDecodeStruct%s(decoder));' % (
+                ind, expr, self.pointerType(member, 1), shape_suffix))
+        elif stars == 1 and self.isEncodedStruct(type_name):
+            lines.append('%sif (decoder.ReadPresence()) {' % ind)
+            lines.append('%s    %s* element = decoder.Allocate<%s>(1);' % (ind, type_name, type_name))
+            lines.append('%s    %s(decoder, *element);' % (ind, self.functionName(False, type_name, shape)))
+            lines.append('%s    %s = element;' % (ind, expr))
+            lines.append('%s}' % ind)
+        elif shape:
+            lines.append('%sdecoder.ReadPointeeShape(%s);' % (ind, expr))
+        elif stars == 1 and self.isObject(type_name):
+            lines.append('%sdecoder.ReadObjectPointee(%s, %s);' % (ind, self.enumName('REPLAY_OBJECT_', type_name), expr))
+        elif stars <= 2:
+            lines.append('%sdecoder.ReadPointee(%s);' % (ind, expr))
+        else:
+            lines.append(self.printCodeGenErrorMessage('Pointer %s is not supported' % expr))
+        return lines
+
+    # Output the IDs identifying each command in a capture.  They only depend on the registry, and
+    # not on which platforms are enabled.
+    #   self            the CaptureOutputGenerator object
+    def outputCommandIds(self):
+        ids = '// Identifies the command of each captured call\n'
+        ids += 'enum CaptureCommand {\n'
+        ids += '    CAPTURE_COMMAND_NONE = 0,\n'
+        for cmd in self.capturedCommands():
+            ids += '    %s,\n' % self.enumName('CAPTURE_COMMAND_', cmd.name)
+        ids += '    CAPTURE_COMMAND_COUNT\n'
+        ids += '};\n\n'
+        return ids
+
+    # The parameters of a command, as declared.
+    def paramList(self, cmd):
+        return ', '.join(param.cdecl.strip() for param in cmd.params)
+
+    # Commands return values through the parameters which are non-const pointers or arrays.
+    def outputParams(self, cmd):
+        return [param for param in cmd.params
+                if (self.starCount(param) > 0 or param.is_static_array) and not param.is_const]
+
+    # Output the prototypes of the functions the API Dump layer captures each command with.
+    #   self            the CaptureOutputGenerator object
+    def outputEncodePrototypes(self):
+        prototypes = '// Capture the parameters of a command before it is called, and what it returned through\n'
+        prototypes += '// them after it succeeded\n'
+        for cmd in self.capturedCommands():
+            if cmd.protect_value:
+                prototypes += '#if %s\n' % cmd.protect_string
+            base_name = cmd.name[2:]
+            prototypes += 'void CaptureEncode%sInputs(CaptureEncoder& encoder, %s);\n' % (base_name, self.paramList(cmd))
+            prototypes += 'void CaptureEncode%sOutputs(CaptureEncoder& encoder, XrResult result, %s);\n' % (
+                base_name, self.paramList(cmd))
+            if cmd.protect_value:
+                prototypes += '#endif // %s\n' % cmd.protect_string
+        return prototypes
+
+    # Output the kinds of objects which are translated from their captured values when replayed.
+    #   self            the CaptureOutputGenerator object
+    def outputObjectKinds(self):
+        kinds = '// The kinds of objects translated from their captured values\n'
+        kinds += 'enum ReplayObjectKind {\n'
+        for handle in self.api_handles:
+            kinds += '    %s,\n' % self.enumName('REPLAY_OBJECT_', handle.name)
+        for base_type in self.api_base_types:
+            if base_type.type == 'XR_DEFINE_ATOM':
+                kinds += '    %s,\n' % self.enumName('REPLAY_OBJECT_', base_type.name)
+        kinds += '};\n\n'
+        return kinds
+
+    # Output the functions encoding or decoding each structure, either all of it or only its shape,
+    # leaving out those which nothing calls.
+    #   self            the CaptureOutputGenerator object
+    #   encode          whether to output the encoders or the decoders
+    #   callers         the code calling these functions
+    def outputStructFunctions(self, encode, callers):
+        candidates = []
+        for struct in self.encodedStructs():
+            for shape in (False, True):
+                name = self.functionName(encode, struct.name, shape)
+                if encode:
+                    prototype = 'static void %s(CaptureEncoder& encoder, const %s& value)' % (name, struct.name)
+                else:
+                    prototype = 'static void %s(ReplayDecoder& decoder, %s& value)' % (name, struct.name)
+                body = ''
+                for member in struct.members:
+                    if encode:
+                        lines = self.encodeLines(member, 'value.', struct.members, shape, 1)
+                    else:
+                        lines = self.decodeLines(member, 'value.' + member.name, shape, 1)
+                    body += ''.join(line + '\n' for line in lines)
+                candidates.append((struct, name, prototype, body))
+
+        used = set()
+        pending = [callers]
+        while pending:
+            code = pending.pop()
+            for struct, name, prototype, body in candidates:
+                if name not in used and re.search(r'\b%s\(' % name, code):
+                    used.add(name)
+                    pending.append(body)
+
+        # Prototypes first, since structures contain each other.
+        functions = ''
+        for struct, name, prototype, body in candidates:
+            if name in used:
+                if struct.protect_value:
+                    functions += '#if %s\n' % struct.protect_string
+                functions += '%s;\n' % prototype
+                if struct.protect_value:
+                    functions += '#endif // %s\n' % struct.protect_string
+        if encode:
+            functions += 'static void CaptureEncodeStructArray(CaptureEncoder& encoder, const void* value, uint32_t count);\n'
+            functions += 'static void CaptureEncodeStructArrayShape(CaptureEncoder& encoder, const void* value, uint32_t count);\n'
+            functions += 'static void CaptureEncodeStruct(CaptureEncoder& encoder, const void* value);\n'
+            functions += 'static void CaptureEncodeStructShape(CaptureEncoder& encoder, const void* value);\n'
+            functions += 'static void CaptureEncodeNextChain(CaptureEncoder& encoder, const void* next);\n'
+            functions += 'static void CaptureEncodeNextChainShape(CaptureEncoder& encoder, const void* next);\n'
+        else:
+            functions += 'static void* ReplayDecodeStructArray(ReplayDecoder& decoder, uint32_t count);\n'
+            functions += 'static void* ReplayDecodeStructArrayShape(ReplayDecoder& decoder, uint32_t count);\n'
+            functions += 'static void* ReplayDecodeStruct(ReplayDecoder& decoder);\n'
+            functions += 'static void* ReplayDecodeStructShape(ReplayDecoder& decoder);\n'
+        functions += '\n'
+
+        for struct, name, prototype, body in candidates:
+            if name in used:
+                if struct.protect_value:
+                    functions += '#if %s\n' % struct.protect_string
+                functions += '%s {\n%s}\n' % (prototype, body)
+                if struct.protect_value:
+                    functions += '#endif // %s\n' % struct.protect_string
+                functions += '\n'
+        return functions
+
+    # The cases of a switch on the structure type, one for each structure type, with a body for the structure.
+    #   self            the CaptureOutputGenerator object
+    #   body            a function returning the lines of a case for a structure name
+    def structureTypeCases(self, body):
+        cases = ''
+        enum_tuple = [x for x in self.api_enums if x.name == 'XrStructureType'][0]
+        for cur_value in enum_tuple.values:
+            if cur_value.alias:
+                continue
+            struct_name = self.genXrStructureName(cur_value.name)
+            if not struct_name:
+                continue
+            struct = self.getStruct(struct_name)
+            if struct.protect_value:
+                cases += '#if %s\n' % struct.protect_string
+            cases += '        case %s:\n' % cur_value.name
+            cases += body(struct_name)
+            if struct.protect_value:
+                cases += '#endif // %s\n' % struct.protect_string
+        return cases
+
+    # Output the functions encoding or decoding a structure by its structure type, for next chains
+    # and pointers to base structures.
+    #   self            the CaptureOutputGenerator object
+    #   encode          whether to output the encoders or the decoders
+    def outputGenericStructFunctions(self, encode):
+        functions = ''
+        for shape in (False, True):
+            suffix = 'Shape' if shape else ''
+            if encode:
+                functions += '// Encodes count structures of the type of the first one, returning false for an unknown type.\n'
+                functions += 'static bool CaptureEncodeKnownStructs%s(CaptureEncoder& encoder, const void* value, uint32_t count) {\n' % suffix
+                functions += '    switch (reinterpret_cast<const XrBaseInStructure*>(value)->type) {\n'
+
+                def encode_case(struct_name):
+                    case = '            for (uint32_t i = 0; i < count; ++i) {\n'
+                    case += '                %s(encoder, reinterpret_cast<const %s*>(value)[i]);\n' % (
+                        self.functionName(True, struct_name, shape), struct_name)
+                    case += '            }\n'
+                    case += '            return true;\n'
+                    return case
+                functions += self.structureTypeCases(encode_case)
+                functions += '        default:\n'
+                functions += '            return false;\n'
+                functions += '    }\n'
+                functions += '}\n\n'
+                functions += 'static void CaptureEncodeStructArray%s(CaptureEncoder& encoder, const void* value, uint32_t count) {\n' % suffix
+                functions += '    if (value == nullptr || count == 0 || !CaptureEncodeKnownStructs%s(encoder, value, count)) {\n' % suffix
+                functions += '        encoder.WriteValue(XR_TYPE_UNKNOWN);\n'
+                functions += '    }\n'
+                functions += '}\n\n'
+                functions += 'static void CaptureEncodeStruct%s(CaptureEncoder& encoder, const void* value) {\n' % suffix
+                functions += '    CaptureEncodeStructArray%s(encoder, value, 1);\n' % suffix
+                functions += '}\n\n'
+                functions += '// Structures of unknown types are left out of the chain.\n'
+                functions += 'static void CaptureEncodeNextChain%s(CaptureEncoder& encoder, const void* next) {\n' % suffix
+                functions += '    for (; next != nullptr; next = reinterpret_cast<const XrBaseInStructure*>(next)->next) {\n'
+                functions += '        if (CaptureEncodeKnownStructs%s(encoder, next, 1)) {\n' % suffix
+                functions += '            return;\n'
+                functions += '        }\n'
+                functions += '    }\n'
+                functions += '    encoder.WriteValue(XR_TYPE_UNKNOWN);\n'
+                functions += '}\n\n'
+            else:
+                functions += '// Decodes count structures of the type of the first one, or returns nullptr for XR_TYPE_UNKNOWN.\n'
+                functions += 'static void* ReplayDecodeStructArray%s(ReplayDecoder& decoder, uint32_t count) {\n' % suffix
+                functions += '    XrStructureType type = decoder.PeekValue<XrStructureType>();\n'
+                functions += '    switch (type) {\n'
+                functions += '        case XR_TYPE_UNKNOWN:\n'
+                functions += '            decoder.ReadValue(type);\n'
+                functions += '            return nullptr;\n'
+
+                def decode_case(struct_name):
+                    case = '        {\n'
+                    case += '            %s* elements = decoder.Allocate<%s>(count);\n' % (struct_name, struct_name)
+                    case += '            for (uint32_t i = 0; i < count; ++i) {\n'
+                    case += '                %s(decoder, elements[i]);\n' % self.functionName(False, struct_name, shape)
+                    case += '            }\n'
+                    case += '            return elements;\n'
+                    case += '        }\n'
+                    return case
+                functions += self.structureTypeCases(decode_case)
+                functions += '        default:\n'
+                functions += '            throw std::invalid_argument("Capture record has an unknown structure type");\n'
+                functions += '    }\n'
+                functions += '}\n\n'
+                functions += 'static void* ReplayDecodeStruct%s(ReplayDecoder& decoder) { return ReplayDecodeStructArray%s(decoder, 1); }\n\n' % (
+                    suffix, suffix)
+        return functions
+
+    # Whether a command is one of those creating or destroying a handle.
+    def isCreate(self, cmd):
+        return ('xrCreate' in cmd.name or 'xrConnect' in cmd.name) and cmd.params[-1].is_handle
+
+    def isDestroy(self, cmd):
+        return ('xrDestroy' in cmd.name or 'xrDisconnect' in cmd.name) and cmd.params[-1].is_handle
+
+    # Output the functions capturing the parameters of each command.
+    #   self            the CaptureOutputGenerator object
+    def outputCommandEncoders(self):
+        encoders = '// Command encoders\n'
+        for cmd in self.capturedCommands():
+            if cmd.protect_value:
+                encoders += '#if %s\n' % cmd.protect_string
+            base_name = cmd.name[2:]
+            encoders += 'void CaptureEncode%sInputs(CaptureEncoder& encoder, %s) {\n' % (base_name, self.paramList(cmd))
+            for param in cmd.params:
+                shape = param in self.outputParams(cmd)
+                lines = self.encodeLines(param, '', cmd.params, shape, 1)
+                if not lines:
+                    # Such as a fixed size output buffer, which has no shape to capture.
+                    lines = ['    (void)%s;' % param.name]
+                encoders += ''.join(line + '\n' for line in lines)
+            encoders += '}\n\n'
+            encoders += 'void CaptureEncode%sOutputs(CaptureEncoder& encoder, XrResult result, %s) {\n' % (
+                base_name, self.paramList(cmd))
+            if self.outputParams(cmd):
+                encoders += '    if (XR_FAILED(result)) {\n'
+                encoders += '        return;\n'
+                encoders += '    }\n'
+            else:
+                encoders += '    (void)encoder;\n'
+                encoders += '    (void)result;\n'
+            for param in cmd.params:
+                if param not in self.outputParams(cmd):
+                    encoders += '    (void)%s;\n' % param.name
+            for param in self.outputParams(cmd):
+                lines = self.encodeLines(param, '', cmd.params, False, 1)
+                if param.type in POLYMORPHIC_OUTPUTS:
+                    encoders += '    if (result == XR_SUCCESS) {\n'
+                    encoders += ''.join('    ' + line + '\n' for line in lines)
+                    encoders += '    }\n'
+                else:
+                    encoders += ''.join(line + '\n' for line in lines)
+            encoders += '}\n\n'
+            if cmd.protect_value:
+                encoders += '#endif // %s\n' % cmd.protect_string
+        return encoders
+
+    # Output the functions replaying each command, and the function choosing between them.
+    #   self            the CaptureOutputGenerator object
+    def outputCommandReplays(self):
+        replays = '// Command replays\n'
+        replayed = []
+        for cmd in self.capturedCommands():
+            is_instance_create = cmd.name == 'xrCreateInstance'
+            if not is_instance_create and not cmd.params[0].is_handle:
+                replays += self.printCodeGenErrorMessage(
+                    'Command %s does not have an OpenXR Object handle as the first parameter.' % cmd.name)
+                continue
+            replayed.append(cmd)
+            if cmd.protect_value:
+                replays += '#if %s\n' % cmd.protect_string
+            base_name = cmd.name[2:]
+            outputs = self.outputParams(cmd)
+            replays += 'static XrResult Replay%s(ReplayDecoder& decoder, XrResult captured_result) {\n' % base_name
+            for param in cmd.params:
+                cdecl = param.cdecl.strip()
+                # The parameters are decoded into the locals, so those passed by value cannot be const.
+                if self.starCount(param) == 0 and cdecl.startswith('const '):
+                    cdecl = cdecl[len('const '):]
+                replays += '    %s{};\n' % cdecl
+            for param in cmd.params:
+                replays += ''.join(line + '\n' for line in self.decodeLines(param, param.name, param in outputs, 1))
+
+            # Call through the dispatch table of the instance the first handle belongs to.
+            call_params = ', '.join(param.name for param in cmd.params)
+            if is_instance_create:
+                replays += '    XrResult result = xrCreateInstance(%s);\n' % call_params
+                replays += '    XrGeneratedDispatchTable* table = nullptr;\n'
+                replays += '    if (XR_SUCCEEDED(result)) {\n'
+                replays += '        table = decoder.AddInstance(*%s);\n' % cmd.params[-1].name
+                replays += '    }\n'
+            else:
+                replays += '    XrGeneratedDispatchTable* table = decoder.Table(%s, %s);\n' % (
+                    self.enumName('REPLAY_OBJECT_', cmd.params[0].type), cmd.params[0].name)
+                replays += '    if (table == nullptr) {\n'
+                replays += '        return XR_ERROR_HANDLE_INVALID;\n'
+                replays += '    }\n'
+                replays += '    XrResult result = table->%s(%s);\n' % (base_name, call_params)
+
+            # Read back what the captured call returned, translating the objects it returned to
+            # those returned now.
+            if outputs:
+                replays += '    if (XR_SUCCEEDED(captured_result)) {\n'
+                for param in outputs:
+                    stars = self.starCount(param)
+                    kind = self.enumName('REPLAY_OBJECT_', param.type)
+                    if stars == 1 and self.isObject(param.type) and param.pointer_count_var:
+                        replays += '        decoder.ReadReturnedObjects(%s, %s, result, table);\n' % (kind, param.name)
+                    elif stars == 1 and self.isObject(param.type):
+                        replays += '        decoder.ReadReturnedObject(%s, %s, result, table);\n' % (kind, param.name)
+                    else:
+                        captured_name = param.name + '_captured'
+                        cdecl = param.cdecl.strip()
+                        name_index = cdecl.rfind(param.name)
+                        replays += '        %s{};\n' % (cdecl[:name_index] + captured_name + cdecl[name_index + len(param.name):])
+                        lines = self.decodeLines(param, captured_name, False, 2)
+                        if param.type in POLYMORPHIC_OUTPUTS:
+                            replays += '        if (captured_result == XR_SUCCESS) {\n'
+                            replays += ''.join('    ' + line + '\n' for line in lines)
+                            replays += '        }\n'
+                        else:
+                            replays += ''.join(line + '\n' for line in lines)
+                        replays += '        (void)%s;\n' % captured_name
+                replays += '    }\n'
+            else:
+                replays += '    (void)captured_result;\n'
+            if self.isDestroy(cmd):
+                replays += '    if (XR_SUCCEEDED(result)) {\n'
+                replays += '        decoder.RemoveObject(%s, %s);\n' % (
+                    self.enumName('REPLAY_OBJECT_', cmd.params[-1].type), cmd.params[-1].name)
+                replays += '    }\n'
+            replays += '    return result;\n'
+            replays += '}\n\n'
+            if cmd.protect_value:
+                replays += '#endif // %s\n' % cmd.protect_string
+
+        replays += 'XrResult ReplayCommand(ReplayDecoder& decoder, uint32_t command, XrResult captured_result) {\n'
+        replays += '    switch (command) {\n'
+        for cmd in replayed:
+            if cmd.protect_value:
+                replays += '#if %s\n' % cmd.protect_string
+            replays += '        case %s:\n' % self.enumName('CAPTURE_COMMAND_', cmd.name)
+            replays += '            return Replay%s(decoder, captured_result);\n' % cmd.name[2:]
+            if cmd.protect_value:
+                replays += '#endif // %s\n' % cmd.protect_string
+        replays += '        default:\n'
+        replays += '            throw std::invalid_argument("Capture has a command this platform cannot replay");\n'
+        replays += '    }\n'
+        replays += '}\n\n'
+
+        replays += 'const char* ReplayCommandName(uint32_t command) {\n'
+        replays += '    switch (command) {\n'
+        for cmd in self.capturedCommands():
+            replays += '        case %s:\n' % self.enumName('CAPTURE_COMMAND_', cmd.name)
+            replays += '            return "%s";\n' % cmd.name
+        replays += '        default:\n'
+        replays += '            return "unknown command";\n'
+        replays += '    }\n'
+        replays += '}\n'
+        return replays
@@ -19,6 +19,7 @@
 from automatic_source_generator import (AutomaticSourceOutputGenerator,
                                         undecorate)
 from generator import write
+from reflection_source_generator import reflectionCommandId
 
 # The following commands are manually implemented in the loader.
 MANUAL_LOADER_FUNCS = set((
@@ -112,21 +113,28 @@ class LoaderSourceOutputGenerator(AutomaticSourceOutputGenerator):
             preamble += '#include "loader_instance.hpp"\n\n'
             preamble += '#include "loader_platform.hpp"\n\n'
 
+        elif self.genOpts.filename == 'xr_generated_loader_extensions.hpp':
+            preamble += '#pragma once\n\n'
+            preamble += '#include <cstdint>\n'
+
         elif self.genOpts.filename == 'xr_generated_loader.cpp':
             preamble += '#include "xr_generated_loader.hpp"\n\n'
             preamble += '#include "api_layer_interface.hpp"\n'
             preamble += '#include "exception_handling.hpp"\n'
             preamble += '#include "hex_and_handles.h"\n'
+            preamble += '#include "loader_command_stats.hpp"\n'
             preamble += '#include "loader_instance.hpp"\n'
             preamble += '#include "loader_logger.hpp"\n'
             preamble += '#include "loader_platform.hpp"\n'
             preamble += '#include "runtime_interface.hpp"\n'
-            preamble += '#include "xr_generated_dispatch_table.h"\n\n'
+            preamble += '#include "xr_generated_dispatch_table.h"\n'
+            preamble += '#include "xr_generated_reflection.hpp"\n\n'
 
             preamble += '#include "xr_dependencies.h"\n'
             preamble += '#include <openxr/openxr.h>\n'
             preamble += '#include <openxr/openxr_platform.h>\n\n'
 
+            preamble += '#include <algorithm>\n'
             preamble += '#include <cstring>\n'
             preamble += '#include <memory>\n'
             preamble += '#include <new>\n'
@@ -149,9 +157,15 @@ class LoaderSourceOutputGenerator(AutomaticSourceOutputGenerator):
             file_data += '#ifdef __cplusplus\n'
             file_data += '} // extern "C"\n'
             file_data += '#endif\n'
+            file_data += self.outputLoaderHandleTrackingProto()
+
+        elif self.genOpts.filename == 'xr_generated_loader_extensions.hpp':
+            file_data += self.outputLoaderExtensionIds()
 
         elif self.genOpts.filename == 'xr_generated_loader.cpp':
+            file_data += self.outputLoaderExtensionNames()
             file_data += self.outputLoaderGeneratedFuncs()
+            file_data += self.outputLoaderHandleTrackingFuncs()
 
         write(file_data, file=self.outFile)
 
@@ -180,6 +194,131 @@ class LoaderSourceOutputGenerator(AutomaticSourceOutputGenerator):
 
         return manual_funcs
 
+    # Commands with a trampoline in the loader: every core command plus the commands of
+    # the extensions the loader implements itself.
+    #   self            the LoaderSourceOutputGenerator object
+    def getLoaderTrampolineCommands(self):
+        return self.core_commands + [cur_cmd for cur_cmd in self.ext_commands
+                                     if cur_cmd.name in MANUAL_LOADER_FUNCS or cur_cmd.ext_name in EXTENSIONS_LOADER_IMPLEMENTS]
+
+    # Output an ID for each instance extension in the registry, used to index extension bitsets.
+    # Extension IDs are not protected by platform defines so they stay the same on every platform.
+    #   self            the LoaderSourceOutputGenerator object
+    def outputLoaderExtensionIds(self):
+        extension_ids = '\n// Loader extension IDs\n'
+        extension_ids += 'enum LoaderExtensionId : uint32_t {\n'
+        for extension in self.extensions:
+            extension_ids += '    LOADER_EXTENSION_%s,\n' % extension.name
+        extension_ids += '    LOADER_EXTENSION_COUNT\n'
+        extension_ids += '};\n\n'
+        extension_ids += '// Extension names indexed by LoaderExtensionId\n'
+        extension_ids += 'extern const char* const g_loader_extension_names[LOADER_EXTENSION_COUNT];\n\n'
+        extension_ids += '// Returns the ID of an extension known from the registry, or LOADER_EXTENSION_COUNT for any other name.\n'
+        extension_ids += 'LoaderExtensionId LoaderExtensionIdFromName(const char* name);\n'
+        return extension_ids
+
+    # Output the extension names, and a binary search over a copy of the IDs sorted by name.
+    #   self            the LoaderSourceOutputGenerator object
+    def outputLoaderExtensionNames(self):
+        extension_names = '\nconst char* const g_loader_extension_names[LOADER_EXTENSION_COUNT] = {\n'
+        for extension in self.extensions:
+            extension_names += '    "%s",\n' % extension.name
+        extension_names += '};\n\n'
+        extension_names += '// Extension IDs sorted by name\n'
+        extension_names += 'static const LoaderExtensionId g_loader_extension_ids_by_name[LOADER_EXTENSION_COUNT] = {\n'
+        for extension in sorted(self.extensions, key=lambda extension: extension.name):
+            extension_names += '    LOADER_EXTENSION_%s,\n' % extension.name
+        extension_names += '};\n\n'
+        extension_names += 'LoaderExtensionId LoaderExtensionIdFromName(const char* name) {\n'
+        extension_names += '    const LoaderExtensionId* end = g_loader_extension_ids_by_name + LOADER_EXTENSION_COUNT;\n'
+        extension_names += '    const LoaderExtensionId* found = std::lower_bound(g_loader_extension_ids_by_name, end, name,\n'
+        extension_names += '        [](LoaderExtensionId id, const char* value) { return strcmp(g_loader_extension_names[id], value) < 0; });\n'
+        extension_names += '    if (found != end && strcmp(g_loader_extension_names[*found], name) == 0) {\n'
+        extension_names += '        return *found;\n'
+        extension_names += '    }\n'
+        extension_names += '    return LOADER_EXTENSION_COUNT;\n'
+        extension_names += '}\n'
+        return extension_names
+
+    # The parameter a command returns the handle it creates in, or None if the command creates no handle.
+    #   self            the LoaderSourceOutputGenerator object
+    #   cur_cmd         the command
+    def getCreatedHandleParam(self, cur_cmd):
+        if not cur_cmd.is_create_connect:
+            return None
+        for param in cur_cmd.params[1:]:
+            if param.is_handle and not param.is_const and not param.is_array and param.pointer_count == 1:
+                return param
+        return None
+
+    # Commands without a loader trampoline that create or destroy handles.  Their handles may be passed to
+    # the trampolines, which need to know them when several instances are alive, so xrGetInstanceProcAddr
+    # returns a wrapper that records them instead of the command of the call chain.
+    #   self            the LoaderSourceOutputGenerator object
+    def getHandleTrackingCommands(self):
+        trampoline_names = set(cur_cmd.name for cur_cmd in self.getLoaderTrampolineCommands())
+        return [cur_cmd for cur_cmd in self.ext_commands
+                if cur_cmd.name not in trampoline_names and cur_cmd.params[0].is_handle and
+                (self.getCreatedHandleParam(cur_cmd) is not None or
+                 (cur_cmd.is_destroy_disconnect and len(cur_cmd.params) == 1))]
+
+    #   self            the LoaderSourceOutputGenerator object
+    def outputLoaderHandleTrackingProto(self):
+        tracking_proto = '\n// Returns the wrapper that records the handles the command creates or destroys, for a command without a\n'
+        tracking_proto += '// trampoline that xrGetInstanceProcAddr should return it for, or nullptr for any other command.\n'
+        tracking_proto += 'enum ReflectionCommand : uint32_t;\n'
+        tracking_proto += 'PFN_xrVoidFunction LoaderHandleTrackingFunction(ReflectionCommand command);\n'
+        return tracking_proto
+
+    # Output the wrappers of the commands from getHandleTrackingCommands, which go through the dispatch table
+    # of the instance like the trampolines do, and the lookup of the wrapper of a command.
+    #   self            the LoaderSourceOutputGenerator object
+    def outputLoaderHandleTrackingFuncs(self):
+        tracking_funcs = '\n// Wrappers recording the handles of the commands without a trampoline\n'
+        tracking_commands = self.getHandleTrackingCommands()
+        for cur_cmd in tracking_commands:
+            if cur_cmd.protect_value:
+                tracking_funcs += '#if %s\n' % cur_cmd.protect_string
+            param_names = ', '.join(param.name for param in cur_cmd.params)
+            first_param = cur_cmd.params[0].name
+            tracking_funcs += cur_cmd.cdecl.replace('XRAPI_ATTR', 'static XRAPI_ATTR').replace(
+                ' xr', ' LoaderTrackXr', 1).replace(';', ' XRLOADER_ABI_TRY {\n')
+            tracking_funcs += '    LoaderInstance* loader_instance;\n'
+            tracking_funcs += '    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(%s), "%s");\n' % (
+                first_param, cur_cmd.name)
+            tracking_funcs += '    if (XR_SUCCEEDED(result)) {\n'
+            tracking_funcs += '        result = loader_instance->DispatchTable()->%s(%s);\n' % (cur_cmd.name[2:], param_names)
+            tracking_funcs += '    }\n'
+            created_param = self.getCreatedHandleParam(cur_cmd)
+            tracking_funcs += '    if (XR_SUCCEEDED(result)) {\n'
+            if created_param is not None:
+                tracking_funcs += '        ActiveLoaderInstance::AddHandle(loader_instance, MakeHandleGeneric(*%s), MakeHandleGeneric(%s),\n' % (
+                    created_param.name, first_param)
+                tracking_funcs += '                                        "%s");\n' % cur_cmd.name
+            else:
+                tracking_funcs += '        ActiveLoaderInstance::RemoveHandle(loader_instance, MakeHandleGeneric(%s));\n' % first_param
+            tracking_funcs += '    }\n'
+            tracking_funcs += '    return result;\n'
+            tracking_funcs += '}\nXRLOADER_ABI_CATCH_FALLBACK\n'
+            if cur_cmd.protect_value:
+                tracking_funcs += '#endif // %s\n' % cur_cmd.protect_string
+            tracking_funcs += '\n'
+
+        tracking_funcs += 'PFN_xrVoidFunction LoaderHandleTrackingFunction(ReflectionCommand command) {\n'
+        tracking_funcs += '    switch (command) {\n'
+        for cur_cmd in tracking_commands:
+            if cur_cmd.protect_value:
+                tracking_funcs += '#if %s\n' % cur_cmd.protect_string
+            tracking_funcs += '        case %s:\n' % reflectionCommandId(cur_cmd.name)
+            tracking_funcs += '            return reinterpret_cast<PFN_xrVoidFunction>(LoaderTrackX%s);\n' % cur_cmd.name[1:]
+            if cur_cmd.protect_value:
+                tracking_funcs += '#endif // %s\n' % cur_cmd.protect_string
+        tracking_funcs += '        default:\n'
+        tracking_funcs += '            return nullptr;\n'
+        tracking_funcs += '    }\n'
+        tracking_funcs += '}\n'
+        return tracking_funcs
+
    # Output loader generated functions.  This has special cases for create and destroy commands
     # since we have to associate the created objects with the original instance during the create,
     # and then remove that association in the delete.
@@ -229,8 +368,10 @@ class LoaderSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         first_handle_name = self.getFirstHandleName(param)
 
                         tramp_variable_defines += '    LoaderInstance* loader_instance;\n'
-                        tramp_variable_defines += '    XrResult result = ActiveLoaderInstance::Get(&loader_instance, "%s");\n' % (cur_cmd.name)
+                        tramp_variable_defines += '    XrResult result = ActiveLoaderInstance::Get(&loader_instance, MakeHandleGeneric(%s), "%s");\n' % (
+                            param.name, cur_cmd.name)
                         tramp_variable_defines += '    if (XR_SUCCEEDED(result)) {\n'
+                        tramp_variable_defines += '        XRLOADER_TIME_COMMAND(%s);\n' % reflectionCommandId(cur_cmd.name)
 
                         # These should be mutually exclusive - verify it.
                         assert((not cur_cmd.is_destroy_disconnect) or
@@ -283,9 +424,30 @@ class LoaderSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 generated_funcs += param.name
                 count = count + 1
             generated_funcs += ');\n'
-
             generated_funcs += '    }\n'
 
+            # Record which instance the new handle belongs to, so that calls using it are routed there.
+            if cur_cmd.is_create_connect:
+                generated_funcs += '    if (XR_SUCCEEDED(result)) {\n'
+                generated_funcs += '        ActiveLoaderInstance::AddHandle(loader_instance, MakeHandleGeneric(*%s), MakeHandleGeneric(%s),\n' % (
+                    cur_cmd.params[-1].name, cur_cmd.params[0].name)
+                generated_funcs += '                                        "%s");\n' % cur_cmd.name
+                generated_funcs += '    }\n'
+
+            # Forget the handle once it is destroyed, and only then: a failed destroy leaves it alive.  The runtime
+            # may hand the value out again right away, so a handle given to another instance since is kept.
+            if cur_cmd.is_destroy_disconnect:
+                generated_funcs += '    if (XR_SUCCEEDED(result)) {\n'
+                generated_funcs += '        ActiveLoaderInstance::RemoveHandle(loader_instance, MakeHandleGeneric(%s));\n' % (
+                    cur_cmd.params[0].name)
+                generated_funcs += '    }\n'
+
+            # Session labels (and the label profiler) track sessions by handle, so drop them once the session is gone.
+            if cur_cmd.name == 'xrDestroySession':
+                generated_funcs += '    if (XR_SUCCEEDED(result)) {\n'
+                generated_funcs += '        LoaderLogger::GetInstance().DeleteSessionLabels(session);\n'
+                generated_funcs += '    }\n'
+
 
             if has_return:
                 generated_funcs += '    return result;\n'
@@ -0,0 +1,450 @@
+#!/usr/bin/python3 -i
+#
+# Copyright (c) 2017-2021, The Khronos Group Inc.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# NOTE: Generated file is dual-licensed (Apache-2.0 OR MIT),
+# to allow downstream projects to avoid license incompatibility with
+# the loader
+#
+# Purpose:      This file utilizes the content formatted in the
+#               automatic_source_generator.py class to produce the
+#               constant reflection tables shared by the loader, the
+#               API layers and the samples.
+
+import re
+
+from automatic_source_generator import AutomaticSourceOutputGenerator
+from generator import write
+
+# The values of extension enumerants are numbered from this base, in blocks of this many for each extension.
+EXTENSION_ENUM_BASE = 1000000000
+EXTENSION_ENUM_STRIDE = 1000
+
+# The enums whose values are collected, for the tables looking them up.
+REFLECTED_ENUMS = ('XrResult', 'XrStructureType', 'XrObjectType')
+
+# The functions of the generated header naming the values of the enums it reflects, for the generators
+# that would otherwise write a switch naming them.
+REFLECTED_ENUM_NAME_FUNCTIONS = {
+    'XrResult': 'ReflectionResultName',
+    'XrStructureType': 'ReflectionStructureTypeName',
+    'XrObjectType': 'ReflectionObjectTypeName',
+}
+
+
+# The 32-bit FNV-1a hash of a command name, as ReflectionHashName computes it.
+def hashName(name):
+    value = 2166136261
+    for char in name.encode('ascii'):
+        value = ((value ^ char) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+# The finalizer of MurmurHash3, as ReflectionMixHash computes it.
+def mixHash(value):
+    value ^= value >> 16
+    value = (value * 0x85EBCA6B) & 0xFFFFFFFF
+    value ^= value >> 13
+    value = (value * 0xC2B2AE35) & 0xFFFFFFFF
+    value ^= value >> 16
+    return value
+
+
+# The identifier of a command in the ReflectionCommand enum, for the generators switching on it.
+def reflectionCommandId(command_name):
+    return 'REFLECTION_COMMAND_' + re.sub('([a-z0-9])([A-Z])', r'\1_\2', command_name).upper()
+
+
+# The lines of an array initializer listing values, 16 to a line.
+def listLines(values):
+    return ''.join('    %s,\n' % ', '.join(str(value) for value in values[first:first + 16])
+                   for first in range(0, len(values), 16))
+
+
+# ReflectionSourceOutputGenerator - subclass of AutomaticSourceOutputGenerator.
+
+
+class ReflectionSourceOutputGenerator(AutomaticSourceOutputGenerator):
+    """Generate constant reflection tables using XML element attributes from registry"""
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        # The (name, value) pairs of each enum in REFLECTED_ENUMS, leaving out aliases.
+        self.enum_values = {}
+
+    # Override the base class header warning so the comment indicates this file.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputGeneratedHeaderWarning(self):
+        generated_warning = ''
+        generated_warning += '// Copyright (c) 2017-2021, The Khronos Group Inc.\n'
+        # Broken string is to avoid confusing the REUSE tool here.
+        generated_warning += '// SPDX-License-' + 'Identifier: Apache-2.0 OR MIT\n'
+        generated_warning += '// *********** THIS FILE IS GENERATED - DO NOT EDIT ***********\n'
+        generated_warning += '//     See reflection_source_generator.py for modifications\n'
+        generated_warning += '// ************************************************************\n'
+        write(generated_warning, file=self.outFile)
+
+    # Call the base class to properly begin the file, and then add
+    # the file-specific header information.
+    #   self            the ReflectionSourceOutputGenerator object
+    #   gen_opts        the AutomaticSourceGeneratorOptions object
+    def beginFile(self, genOpts):
+        AutomaticSourceOutputGenerator.beginFile(self, genOpts)
+        preamble = ''
+        preamble += '#pragma once\n\n'
+        preamble += '#include "xr_dependencies.h"\n'
+        preamble += '#include <openxr/openxr.h>\n'
+        preamble += '#include <openxr/openxr_platform.h>\n\n'
+        preamble += '#include <cstdint>\n\n'
+        write(preamble, file=self.outFile)
+
+    # Collect the values of the enums the tables look up, on top of what the base class collects.
+    #   self            the ReflectionSourceOutputGenerator object
+    #   group_info      the XML information for the group
+    #   name            the name of the group
+    #   alias           the name of the group this one is an alias of, if any
+    def genGroup(self, group_info, name, alias):
+        AutomaticSourceOutputGenerator.genGroup(self, group_info, name, alias)
+        if name not in REFLECTED_ENUMS or alias:
+            return
+        values = []
+        for elem in group_info.elem.findall('enum'):
+            if elem.get('supported') == 'disabled' or elem.get('alias'):
+                continue
+            values.append((elem.get('name'), self.enumToValue(elem, True)[0]))
+        self.enum_values[name] = values
+
+    # Write out all the information for the appropriate file,
+    # and then call down to the base class to wrap everything up.
+    #   self            the ReflectionSourceOutputGenerator object
+    def endFile(self):
+        if self.genOpts.filename != 'xr_generated_reflection.hpp':
+            raise RuntimeError("Unknown filename! " + self.genOpts.filename)
+        file_data = ''
+        file_data += self.outputEnumLookup()
+        file_data += self.outputStructInfos()
+        file_data += self.outputResultNames()
+        file_data += self.outputObjectTypeInfos()
+        file_data += self.outputCommands()
+        write(file_data, file=self.outFile)
+
+        # Finish processing in superclass
+        AutomaticSourceOutputGenerator.endFile(self)
+
+    # Lay out the values of an enum in its dense table.
+    #   self            the ReflectionSourceOutputGenerator object
+    #   enum_name       the name of the enum
+    # Returns the names of the entries, None for the holes, and the first entry of each block of
+    # non-negative and negative values, with one more at the end for the last block.
+    def layOutEnum(self, enum_name):
+        blocks = ({}, {})
+        for name, value in self.enum_values[enum_name]:
+            magnitude = abs(value)
+            block, offset = 0, magnitude
+            if magnitude >= EXTENSION_ENUM_BASE:
+                block = (magnitude - EXTENSION_ENUM_BASE) // EXTENSION_ENUM_STRIDE + 1
+                offset = magnitude % EXTENSION_ENUM_STRIDE
+            blocks[1 if value < 0 else 0].setdefault(block, {})[offset] = name
+        entries = []
+        firsts = []
+        for sign_blocks in blocks:
+            first = []
+            block_count = max(sign_blocks.keys()) + 1 if sign_blocks else 0
+            for block in range(block_count):
+                first.append(len(entries))
+                offsets = sign_blocks.get(block, {})
+                if offsets:
+                    entries.extend(offsets.get(offset) for offset in range(max(offsets.keys()) + 1))
+            first.append(len(entries))
+            firsts.append(first)
+        # The entries are indexed by uint16_t.
+        assert(len(entries) < 0xFFFF)
+        return entries, firsts[0], firsts[1]
+
+    # Output the arrays of the blocks of an enum, and the ReflectionEnumBlocks pointing at them.
+    #   self            the ReflectionSourceOutputGenerator object
+    #   prefix          the prefix of the names of the arrays
+    #   non_negative    the first entry of each block of non-negative values
+    #   negative        the first entry of each block of negative values
+    def outputEnumBlocks(self, prefix, non_negative, negative):
+        blocks = ''
+        negative_first = 'nullptr'
+        if len(negative) > 1:
+            negative_first = '%s_negative_first' % prefix
+            blocks += 'constexpr uint16_t %s[] = {\n%s};\n' % (negative_first, listLines(negative))
+        blocks += 'constexpr uint16_t %s_non_negative_first[] = {\n%s};\n' % (prefix, listLines(non_negative))
+        blocks += 'constexpr ReflectionEnumBlocks %s_blocks = {%s_non_negative_first, %d, %s, %d};\n\n' % (
+            prefix, prefix, len(non_negative) - 1, negative_first, len(negative) - 1)
+        return blocks
+
+    # Output the lookup of enum values shared by the tables.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputEnumLookup(self):
+        lookup = ''
+        lookup += '// Constant tables describing the structures, results, object types and commands of the API, which the\n'
+        lookup += '// loader, the API layers and the samples look them up in.\n'
+        lookup += '//\n'
+        lookup += '// The values of an enum are looked up in a dense table.  Its core values, and those of each extension,\n'
+        lookup += '// take up a block of the table, indexed by their offset from the first value of the block, so a lookup\n'
+        lookup += '// is a few array reads.  Values missing from a block are empty entries of the table.\n\n'
+        lookup += 'constexpr uint32_t kReflectionExtensionEnumBase = %d;\n' % EXTENSION_ENUM_BASE
+        lookup += 'constexpr uint32_t kReflectionExtensionEnumStride = %d;\n\n' % EXTENSION_ENUM_STRIDE
+        lookup += '// Where the values of an enum are in its dense table, in separate blocks for non-negative and negative\n'
+        lookup += '// values.  Block 0 holds the core values, and block N + 1 those of extension number N.  The entries of a\n'
+        lookup += '// block start at first[block], and end at first[block + 1].\n'
+        lookup += 'struct ReflectionEnumBlocks {\n'
+        lookup += '    const uint16_t* non_negative_first;\n'
+        lookup += '    uint32_t non_negative_block_count;\n'
+        lookup += '    const uint16_t* negative_first;\n'
+        lookup += '    uint32_t negative_block_count;\n'
+        lookup += '};\n\n'
+        lookup += '// Returned for a value outside every block of an enum.\n'
+        lookup += 'constexpr uint32_t kReflectionNoEntry = UINT32_MAX;\n\n'
+        lookup += '// Returns the index of the entry of a value in the dense table of its enum, or kReflectionNoEntry.\n'
+        lookup += 'static constexpr uint32_t ReflectionEnumEntry(const ReflectionEnumBlocks& blocks, int32_t value) {\n'
+        lookup += '    const bool negative = value < 0;\n'
+        lookup += '    const uint32_t magnitude = negative ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);\n'
+        lookup += '    uint32_t block = 0;\n'
+        lookup += '    uint32_t offset = magnitude;\n'
+        lookup += '    if (magnitude >= kReflectionExtensionEnumBase) {\n'
+        lookup += '        block = (magnitude - kReflectionExtensionEnumBase) / kReflectionExtensionEnumStride + 1;\n'
+        lookup += '        offset = magnitude % kReflectionExtensionEnumStride;\n'
+        lookup += '    }\n'
+        lookup += '    const uint16_t* first = negative ? blocks.negative_first : blocks.non_negative_first;\n'
+        lookup += '    if (block >= (negative ? blocks.negative_block_count : blocks.non_negative_block_count) ||\n'
+        lookup += '        offset >= static_cast<uint32_t>(first[block + 1] - first[block])) {\n'
+        lookup += '        return kReflectionNoEntry;\n'
+        lookup += '    }\n'
+        lookup += '    return first[block] + offset;\n'
+        lookup += '}\n\n'
+        return lookup
+
+    # Output the table of the structures, indexed by their structure types.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputStructInfos(self):
+        structs_by_type = {}
+        for xr_struct in self.api_structures:
+            for member in xr_struct.members:
+                if member.name == 'type' and member.values:
+                    structs_by_type[member.values] = xr_struct
+        struct_types = dict((xr_struct.name, type_name) for type_name, xr_struct in structs_by_type.items())
+
+        entries, non_negative, negative = self.layOutEnum('XrStructureType')
+        next_types = []
+        infos = ''
+        for type_name in entries:
+            if type_name is None:
+                infos += '    {nullptr, nullptr, 0, 0, 0, 0},\n'
+                continue
+            xr_struct = structs_by_type.get(type_name)
+            if xr_struct is None:
+                infos += '    {"%s", nullptr, 0, 0, 0, 0},\n' % type_name
+                continue
+            next_first = len(next_types)
+            for member in xr_struct.members:
+                if member.name == 'next' and member.valid_extension_structs:
+                    next_types.extend(struct_types[valid_struct] for valid_struct in member.valid_extension_structs
+                                      if valid_struct in struct_types)
+            next_count = len(next_types) - next_first
+            # The next chains are indexed by uint16_t.
+            assert(len(next_types) < 0xFFFF)
+            if xr_struct.protect_value:
+                infos += '#if %s\n' % xr_struct.protect_string
+            infos += '    {"%s", "%s", sizeof(%s), alignof(%s), %d, %d},\n' % (
+                type_name, xr_struct.name, xr_struct.name, xr_struct.name, next_first, next_count)
+            if xr_struct.protect_value:
+                infos += '#else\n'
+                infos += '    {"%s", "%s", 0, 0, %d, %d},\n' % (type_name, xr_struct.name, next_first, next_count)
+                infos += '#endif // %s\n' % xr_struct.protect_string
+
+        struct_infos = ''
+        struct_infos += '// A structure, looked up by its structure type.\n'
+        struct_infos += 'struct ReflectionStructInfo {\n'
+        struct_infos += '    // Such as "XR_TYPE_INSTANCE_CREATE_INFO", or NULL for an empty entry.\n'
+        struct_infos += '    const char* type_name;\n'
+        struct_infos += '    // Such as "XrInstanceCreateInfo", or NULL for a structure type no structure has.\n'
+        struct_infos += '    const char* struct_name;\n'
+        struct_infos += '    // 0 for a structure of a platform or graphics API this is not compiled for.\n'
+        struct_infos += '    uint32_t size;\n'
+        struct_infos += '    uint32_t alignment;\n'
+        struct_infos += '    // The structure types allowed in its next chain, in g_reflection_next_types.\n'
+        struct_infos += '    uint16_t next_first;\n'
+        struct_infos += '    uint16_t next_count;\n'
+        struct_infos += '};\n\n'
+        struct_infos += self.outputEnumBlocks('g_reflection_structure_type', non_negative, negative)
+        struct_infos += 'constexpr XrStructureType g_reflection_next_types[] = {\n'
+        for type_name in next_types:
+            struct_infos += '    %s,\n' % type_name
+        struct_infos += '};\n\n'
+        struct_infos += 'constexpr ReflectionStructInfo g_reflection_struct_infos[] = {\n'
+        struct_infos += infos
+        struct_infos += '};\n\n'
+        struct_infos += '// Returns NULL for a structure type the registry does not define.\n'
+        struct_infos += 'static constexpr const ReflectionStructInfo* ReflectionGetStructInfo(XrStructureType type) {\n'
+        struct_infos += '    const uint32_t entry = ReflectionEnumEntry(g_reflection_structure_type_blocks, static_cast<int32_t>(type));\n'
+        struct_infos += '    return (entry == kReflectionNoEntry || nullptr == g_reflection_struct_infos[entry].type_name)\n'
+        struct_infos += '               ? nullptr\n'
+        struct_infos += '               : &g_reflection_struct_infos[entry];\n'
+        struct_infos += '}\n\n'
+        struct_infos += '// Returns the name of a structure type, such as "XR_TYPE_INSTANCE_CREATE_INFO", or NULL.\n'
+        struct_infos += 'static constexpr const char* ReflectionStructureTypeName(XrStructureType type) {\n'
+        struct_infos += '    return nullptr == ReflectionGetStructInfo(type) ? nullptr : ReflectionGetStructInfo(type)->type_name;\n'
+        struct_infos += '}\n\n'
+        struct_infos += '// Returns whether a structure of type next_type may be in the next chain of one of type type.\n'
+        struct_infos += 'static constexpr bool ReflectionStructAllowsNext(XrStructureType type, XrStructureType next_type) {\n'
+        struct_infos += '    const ReflectionStructInfo* info = ReflectionGetStructInfo(type);\n'
+        struct_infos += '    if (nullptr != info) {\n'
+        struct_infos += '        for (uint32_t next = info->next_first; next < info->next_first + info->next_count; ++next) {\n'
+        struct_infos += '            if (g_reflection_next_types[next] == next_type) {\n'
+        struct_infos += '                return true;\n'
+        struct_infos += '            }\n'
+        struct_infos += '        }\n'
+        struct_infos += '    }\n'
+        struct_infos += '    return false;\n'
+        struct_infos += '}\n\n'
+        return struct_infos
+
+    # Output the names of the results.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputResultNames(self):
+        entries, non_negative, negative = self.layOutEnum('XrResult')
+        result_names = ''
+        result_names += self.outputEnumBlocks('g_reflection_result', non_negative, negative)
+        result_names += 'constexpr const char* const g_reflection_result_names[] = {\n'
+        for name in entries:
+            result_names += '    %s,\n' % ('nullptr' if name is None else '"%s"' % name)
+        result_names += '};\n\n'
+        result_names += '// Returns the name of a result, such as "XR_ERROR_HANDLE_INVALID", or NULL for one the registry does not define.\n'
+        result_names += 'static constexpr const char* ReflectionResultName(XrResult result) {\n'
+        result_names += '    const uint32_t entry = ReflectionEnumEntry(g_reflection_result_blocks, static_cast<int32_t>(result));\n'
+        result_names += '    return entry == kReflectionNoEntry ? nullptr : g_reflection_result_names[entry];\n'
+        result_names += '}\n\n'
+        return result_names
+
+    # Output the table of the object types, with the handle types they stand for.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputObjectTypeInfos(self):
+        handle_names = dict((handle.name[2:].upper(), handle.name) for handle in self.api_handles)
+        entries, non_negative, negative = self.layOutEnum('XrObjectType')
+        object_types = ''
+        object_types += '// An object type, looked up by its value.\n'
+        object_types += 'struct ReflectionObjectTypeInfo {\n'
+        object_types += '    // Such as "XR_OBJECT_TYPE_SESSION", or NULL for an empty entry.\n'
+        object_types += '    const char* type_name;\n'
+        object_types += '    // Such as "XrSession", or NULL for XR_OBJECT_TYPE_UNKNOWN.\n'
+        object_types += '    const char* handle_name;\n'
+        object_types += '};\n\n'
+        object_types += self.outputEnumBlocks('g_reflection_object_type', non_negative, negative)
+        object_types += 'constexpr ReflectionObjectTypeInfo g_reflection_object_type_infos[] = {\n'
+        for type_name in entries:
+            if type_name is None:
+                object_types += '    {nullptr, nullptr},\n'
+                continue
+            handle_name = handle_names.get(type_name.replace('XR_OBJECT_TYPE_', '').replace('_', ''))
+            object_types += '    {"%s", %s},\n' % (type_name, 'nullptr' if handle_name is None else '"%s"' % handle_name)
+        object_types += '};\n\n'
+        object_types += '// Returns NULL for an object type the registry does not define.\n'
+        object_types += 'static constexpr const ReflectionObjectTypeInfo* ReflectionGetObjectTypeInfo(XrObjectType type) {\n'
+        object_types += '    const uint32_t entry = ReflectionEnumEntry(g_reflection_object_type_blocks, static_cast<int32_t>(type));\n'
+        object_types += '    return (entry == kReflectionNoEntry || nullptr == g_reflection_object_type_infos[entry].type_name)\n'
+        object_types += '               ? nullptr\n'
+        object_types += '               : &g_reflection_object_type_infos[entry];\n'
+        object_types += '}\n\n'
+        object_types += '// Returns the name of an object type, such as "XR_OBJECT_TYPE_SESSION", or NULL.\n'
+        object_types += 'static constexpr const char* ReflectionObjectTypeName(XrObjectType type) {\n'
+        object_types += '    return nullptr == ReflectionGetObjectTypeInfo(type) ? nullptr : ReflectionGetObjectTypeInfo(type)->type_name;\n'
+        object_types += '}\n\n'
+        return object_types
+
+    # Find a perfect hash of the command names: each name hashes to a bucket, whose displacement is chosen
+    # so that mixing it into the hash gives every name a slot of its own.
+    #   self            the ReflectionSourceOutputGenerator object
+    #   names           the command names
+    # Returns the displacement of each bucket and the command in each slot, or None for an empty one.
+    def hashCommandNames(self, names):
+        slot_count = 1
+        while slot_count < 2 * len(names):
+            slot_count *= 2
+        bucket_count = max(1, slot_count // 4)
+        buckets = [[] for _ in range(bucket_count)]
+        for command, name in enumerate(names):
+            buckets[hashName(name) % bucket_count].append(command)
+        displacements = [0] * bucket_count
+        slots = [None] * slot_count
+        # The buckets with the most names are placed first, while most slots are free.
+        for bucket in sorted(range(bucket_count), key=lambda bucket: -len(buckets[bucket])):
+            if not buckets[bucket]:
+                break
+            for displacement in range(0x10000):
+                taken = [mixHash(hashName(names[command]) ^ displacement) % slot_count for command in buckets[bucket]]
+                if len(set(taken)) == len(taken) and all(slots[slot] is None for slot in taken):
+                    break
+            else:
+                raise RuntimeError('No perfect hash of the command names found')
+            displacements[bucket] = displacement
+            for command, slot in zip(buckets[bucket], taken):
+                slots[slot] = command
+        return displacements, slots
+
+    # Output the identifiers of the commands, and the lookup of a command by its name.
+    #   self            the ReflectionSourceOutputGenerator object
+    def outputCommands(self):
+        names = [cur_cmd.name for cur_cmd in self.core_commands + self.ext_commands]
+        displacements, slots = self.hashCommandNames(names)
+        commands = ''
+        commands += '// Identifiers of the commands in the registry.\n'
+        commands += 'enum ReflectionCommand : uint32_t {\n'
+        for name in names:
+            commands += '    %s,\n' % reflectionCommandId(name)
+        commands += '    REFLECTION_COMMAND_COUNT\n'
+        commands += '};\n\n'
+        commands += 'constexpr const char* const g_reflection_command_names[REFLECTION_COMMAND_COUNT] = {\n'
+        for name in names:
+            commands += '    "%s",\n' % name
+        commands += '};\n\n'
+        commands += '// A perfect hash of the command names: a name hashes to a bucket, whose displacement mixed into the\n'
+        commands += '// hash gives the slot of the only command the name can be.\n'
+        commands += 'constexpr uint32_t kReflectionCommandBucketCount = %d;\n' % len(displacements)
+        commands += 'constexpr uint32_t kReflectionCommandSlotCount = %d;\n' % len(slots)
+        commands += 'constexpr uint16_t g_reflection_command_displacements[kReflectionCommandBucketCount] = {\n'
+        commands += listLines(displacements)
+        commands += '};\n'
+        commands += '// REFLECTION_COMMAND_COUNT for an empty slot.\n'
+        commands += 'constexpr uint16_t g_reflection_command_slots[kReflectionCommandSlotCount] = {\n'
+        for slot in slots:
+            commands += '    %s,\n' % ('REFLECTION_COMMAND_COUNT' if slot is None else reflectionCommandId(names[slot]))
+        commands += '};\n\n'
+        commands += '// The 32-bit FNV-1a hash of a name.\n'
+        commands += 'static constexpr uint32_t ReflectionHashName(const char* name) {\n'
+        commands += '    uint32_t hash = 2166136261u;\n'
+        commands += '    for (; *name != \'\\0\'; ++name) {\n'
+        commands += '        hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;\n'
+        commands += '    }\n'
+        commands += '    return hash;\n'
+        commands += '}\n\n'
+        commands += '// The finalizer of MurmurHash3, which spreads a displaced hash over the slots.\n'
+        commands += 'static constexpr uint32_t ReflectionMixHash(uint32_t hash) {\n'
+        commands += '    hash ^= hash >> 16;\n'
+        commands += '    hash *= 0x85EBCA6Bu;\n'
+        commands += '    hash ^= hash >> 13;\n'
+        commands += '    hash *= 0xC2B2AE35u;\n'
+        commands += '    hash ^= hash >> 16;\n'
+        commands += '    return hash;\n'
+        commands += '}\n\n'
+        commands += 'static constexpr bool ReflectionNamesEqual(const char* first, const char* second) {\n'
+        commands += '    for (; *first != \'\\0\' && *first == *second; ++first, ++second) {\n'
+        commands += '    }\n'
+        commands += '    return *first == *second;\n'
+        commands += '}\n\n'
+        commands += '// Returns the identifier of the named command, or REFLECTION_COMMAND_COUNT if the registry does not define it.\n'
+        commands += 'static constexpr ReflectionCommand ReflectionCommandFromName(const char* name) {\n'
+        commands += '    const uint32_t hash = ReflectionHashName(name);\n'
+        commands += '    const uint32_t displacement = g_reflection_command_displacements[hash % kReflectionCommandBucketCount];\n'
+        commands += '    const uint16_t command = g_reflection_command_slots[ReflectionMixHash(hash ^ displacement) % kReflectionCommandSlotCount];\n'
+        commands += '    return (command != REFLECTION_COMMAND_COUNT && ReflectionNamesEqual(g_reflection_command_names[command], name))\n'
+        commands += '               ? static_cast<ReflectionCommand>(command)\n'
+        commands += '               : REFLECTION_COMMAND_COUNT;\n'
+        commands += '}\n'
+        return commands
@@ -27,9 +27,12 @@ sys.path.append(os.path.join(base_dir, 'src', 'scripts'))
 sys.path.append(os.path.join(base_dir, 'specification', 'scripts'))
 
 from api_dump_generator import ApiDumpOutputGenerator
+from api_dump_json_generator import ApiDumpJsonOutputGenerator
 from automatic_source_generator import AutomaticSourceGeneratorOptions
+from capture_generator import CaptureOutputGenerator
 from generator import write
 from loader_source_generator import LoaderSourceOutputGenerator
+from reflection_source_generator import ReflectionSourceOutputGenerator
 from reg import Registry
 from utility_source_generator import UtilitySourceOutputGenerator
 from validation_layer_generator import ValidationSourceOutputGenerator
@@ -215,6 +218,22 @@ def makeGenOpts(args):
             emitExtensions    = emitExtensionsPat)
         ]
 
+    genOpts['xr_generated_reflection.hpp'] = [
+          ReflectionSourceOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_reflection.hpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat)
+        ]
+
     genOpts['xr_generated_loader.hpp'] = [
           LoaderSourceOutputGenerator,
           AutomaticSourceGeneratorOptions(
@@ -239,6 +258,30 @@ def makeGenOpts(args):
             alignFuncParam    = 48)
         ]
 
+    genOpts['xr_generated_loader_extensions.hpp'] = [
+          LoaderSourceOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_loader_extensions.hpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            prefixText        = prefixStrings + xrPrefixStrings,
+            protectFeature    = False,
+            protectProto      = '#ifndef',
+            protectProtoStr   = 'XR_NO_PROTOTYPES',
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *',
+            alignFuncParam    = 48)
+        ]
+
     genOpts['xr_generated_loader.cpp'] = [
           LoaderSourceOutputGenerator,
           AutomaticSourceGeneratorOptions(
@@ -302,6 +345,103 @@ def makeGenOpts(args):
             apientryp         = 'XRAPI_PTR *')
         ]
 
+    # Source files generated for the JSON lines output of the api_dump layer
+    genOpts['xr_generated_api_dump_json.cpp'] = [
+          ApiDumpJsonOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_api_dump_json.cpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *')
+        ]
+
+    genOpts['xr_generated_api_dump_json.hpp'] = [
+          ApiDumpJsonOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_api_dump_json.hpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *')
+        ]
+
+    # Source files generated for the call capture of the api_dump layer, and openxr_replay
+    genOpts['xr_generated_capture.cpp'] = [
+          CaptureOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_capture.cpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *')
+        ]
+
+    genOpts['xr_generated_capture.hpp'] = [
+          CaptureOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_capture.hpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *')
+        ]
+
+    genOpts['xr_generated_replay.cpp'] = [
+          CaptureOutputGenerator,
+          AutomaticSourceGeneratorOptions(
+            conventions       = conventions,
+            filename          = 'xr_generated_replay.cpp',
+            directory         = directory,
+            apiname           = 'openxr',
+            profile           = None,
+            versions          = featuresPat,
+            emitversions      = featuresPat,
+            defaultExtensions = 'openxr',
+            addExtensions     = None,
+            removeExtensions  = None,
+            emitExtensions    = emitExtensionsPat,
+            apicall           = 'XRAPI_ATTR ',
+            apientry          = 'XRAPI_CALL ',
+            apientryp         = 'XRAPI_PTR *')
+        ]
+
     # Source files generated for the core validation layer
     genOpts['xr_generated_core_validation.hpp'] = [
           ValidationSourceOutputGenerator,
@@ -26,6 +26,7 @@ import re
 from automatic_source_generator import (AutomaticSourceOutputGenerator,
                                         undecorate)
 from generator import write
+from reflection_source_generator import reflectionCommandId
 
 # The following commands have a manually defined component to them.
 VALID_USAGE_MANUALLY_DEFINED = set((
@@ -43,6 +44,35 @@ VALID_USAGE_MANUALLY_DEFINED = set((
 ))
 
 
+# The commands passed to the performance checks of the layer once they return, which are declared
+# here and defined by hand.
+VALID_USAGE_PERFORMANCE_TRACKED = set((
+    'xrDestroySession',
+    'xrWaitFrame',
+    'xrBeginFrame',
+    'xrEndFrame',
+    'xrSyncActions',
+    'xrLocateSpace',
+    'xrStringToPath',
+    'xrPathToString',
+    'xrEnumerateReferenceSpaces',
+    'xrEnumerateSwapchainFormats',
+    'xrEnumerateViewConfigurations',
+    'xrEnumerateViewConfigurationViews',
+    'xrEnumerateEnvironmentBlendModes',
+    'xrEnumerateBoundSourcesForAction',
+))
+
+
+# The types of the values that validation never looks at, unless they count the elements of an array.
+VALID_USAGE_UNCHECKED_TYPES = set((
+    'float',
+    'double',
+    'XrTime',
+    'XrDuration',
+))
+
+
 # ValidationSourceOutputGenerator - subclass of AutomaticSourceOutputGenerator.
 
 
@@ -63,6 +93,11 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
     #   gen_opts        the ValidationSourceGeneratorOptions object
     def beginFile(self, genOpts):
         AutomaticSourceOutputGenerator.beginFile(self, genOpts)
+        # Every extension in the registry, including the ones left out of self.extensions
+        self.extension_names = []
+        # The structures that can be hashed, found when first needed
+        self.hashable_structs = None
+        self.struct_copy_bodies = {}
         preamble = ''
         if self.genOpts.filename == 'xr_generated_core_validation.hpp':
             preamble += '#pragma once\n'
@@ -84,10 +119,17 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             preamble += '#include "xr_generated_core_validation.hpp"\n'
             preamble += '\n'
             preamble += '#include "api_layer_platform_defines.h"\n'
+            preamble += '#include "core_validation_async.h"\n'
+            preamble += '#include "core_validation_messages.h"\n'
+            preamble += '#include "core_validation_performance.h"\n'
+            preamble += '#include "core_validation_profile.h"\n'
+            preamble += '#include "core_validation_sampling.h"\n'
+            preamble += '#include "core_validation_struct_tables.h"\n'
             preamble += '#include "hex_and_handles.h"\n'
             preamble += '#include "validation_utils.h"\n'
             preamble += '#include "xr_dependencies.h"\n'
             preamble += '#include "xr_generated_dispatch_table.h"\n'
+            preamble += '#include "xr_generated_reflection.hpp"\n'
             preamble += '\n'
 
             preamble += '#include "api_layer_platform_defines.h"\n'
@@ -96,6 +138,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             preamble += '#include <openxr/openxr_platform.h>\n\n'
 
             preamble += '#include <algorithm>\n'
+            preamble += '#include <cstddef>\n'
             preamble += '#include <cstring>\n'
             preamble += '#include <memory>\n'
             preamble += '#include <sstream>\n'
@@ -114,19 +157,81 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         if self.genOpts.filename == 'xr_generated_core_validation.hpp':
             file_data += self.outputValidationHeaderInfo()
         elif self.genOpts.filename == 'xr_generated_core_validation.cpp':
-            file_data += self.outputCommonTypesForValidation()
             file_data += self.outputValidationSourceFuncs()
         write(file_data, file=self.outFile)
 
         # Finish processing in superclass
         AutomaticSourceOutputGenerator.endFile(self)
 
+    # Record the name of each extension, so every one of them gets an identifier.
+    #   self            the ValidationSourceOutputGenerator object
+    #   interface       element for the <version> / <extension> to generate
+    #   emit            actually write to the header only when True (ignored in this class)
+    def beginFeature(self, interface, emit):
+        AutomaticSourceOutputGenerator.beginFeature(self, interface, emit)
+        if not self.isCoreExtensionName(self.currentExtension):
+            self.extension_names.append(self.currentExtension)
+
     def makeInfoName(self, handle_type=None, handle_type_name=None):
         if not handle_type_name:
             handle_type_name = handle_type.name
         base_handle_name = undecorate(handle_type_name)
         return 'g_%s_info' % base_handle_name
 
+    def makeCleanUpChildrenName(self, handle_type_name):
+        return 'GenValidUsageCleanUp%sChildren' % handle_type_name
+
+    # Map the name of each handle type to the handles created from handles of that type, in the
+    # order they are declared.  The handle a create command is called on is the direct parent of the
+    # handle it creates.
+    #   self            the ValidationSourceOutputGenerator object
+    def getHandleChildren(self):
+        children = {}
+        for cur_cmd in self.core_commands + self.ext_commands:
+            first_param = cur_cmd.params[0]
+            last_param = cur_cmd.params[-1]
+            if (('xrCreate' in cur_cmd.name or 'xrConnect' in cur_cmd.name) and first_param.is_handle and
+                    last_param.is_handle):
+                # Removing the children of a handle locks the maps of its children, so no type may be its own child.
+                assert(first_param.type != last_param.type)
+                children.setdefault(first_param.type, set()).add(last_param.type)
+        return {parent: [handle for handle in self.api_handles if handle.name in child_names]
+                for parent, child_names in children.items()}
+
+    # Output a function for each handle type with children, removing the infos of the handles created
+    # from a handle of that type, along with their own children.
+    #   self            the ValidationSourceOutputGenerator object
+    def outputCleanUpChildrenFuncs(self):
+        handle_children = self.getHandleChildren()
+        parents = [handle for handle in self.api_handles if handle.name in handle_children]
+        cleanup_funcs = '// Functions used to remove the handles that are destroyed along with their direct parent.\n'
+        for parent in parents:
+            if parent.protect_value:
+                cleanup_funcs += '#if %s\n' % parent.protect_string
+            cleanup_funcs += 'static void %s(const void *parent_info);\n' % self.makeCleanUpChildrenName(parent.name)
+            if parent.protect_value:
+                cleanup_funcs += '#endif // %s\n' % parent.protect_string
+        cleanup_funcs += '\n'
+        for parent in parents:
+            if parent.protect_value:
+                cleanup_funcs += '#if %s\n' % parent.protect_string
+            cleanup_funcs += 'static void %s(const void *parent_info) {\n' % self.makeCleanUpChildrenName(parent.name)
+            for child in handle_children[parent.name]:
+                if child.protect_value:
+                    cleanup_funcs += '#if %s\n' % child.protect_string
+                clean_up_grandchildren = 'nullptr'
+                if child.name in handle_children:
+                    clean_up_grandchildren = self.makeCleanUpChildrenName(child.name)
+                cleanup_funcs += '    %s.removeHandlesForParent(parent_info, %s);\n' % (
+                    self.makeInfoName(handle_type=child), clean_up_grandchildren)
+                if child.protect_value:
+                    cleanup_funcs += '#endif // %s\n' % child.protect_string
+            cleanup_funcs += '}\n'
+            if parent.protect_value:
+                cleanup_funcs += '#endif // %s\n' % parent.protect_string
+            cleanup_funcs += '\n'
+        return cleanup_funcs
+
     def outputInfoMapDeclarations(self, extern):
         lines = []
         extern_keyword = 'extern ' if extern else ''
@@ -145,18 +250,6 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 lines.append('#endif // %s' % handle.protect_string)
         return '\n'.join(lines)
 
-    # Write out common internal types for validation
-    #   self            the ValidationSourceOutputGenerator object
-    def outputCommonTypesForValidation(self):
-        common_validation_types = ''
-        common_validation_types += '// Structure used for indicating status of \'flags\' test.\n'
-        common_validation_types += 'enum ValidateXrFlagsResult {\n'
-        common_validation_types += '    VALIDATE_XR_FLAGS_ZERO,\n'
-        common_validation_types += '    VALIDATE_XR_FLAGS_INVALID,\n'
-        common_validation_types += '    VALIDATE_XR_FLAGS_SUCCESS,\n'
-        common_validation_types += '};\n\n'
-        return common_validation_types
-
     # Generate C++ structures and maps used for validating the states identified
     # in the specification.
     #   self            the ValidationSourceOutputGenerator object
@@ -180,6 +273,15 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_state_checks += '\n'
         return validation_state_checks
 
+    # Wrap generated C++ checks in a block that is only compiled when the profile of the build includes them.
+    #   self            the ValidationSourceOutputGenerator object
+    #   check           the kind of check, which names its XR_CORE_VALIDATION_CHECK_ macro
+    #   code            the generated C++ code of the checks
+    def guardChecks(self, check, code):
+        if not code:
+            return code
+        return '#if XR_CORE_VALIDATION_CHECK_%s\n%s#endif // XR_CORE_VALIDATION_CHECK_%s\n' % (check, code, check)
+
     # Generate C++ structure and utility function prototypes for validating
     # the 'next' chains in structures.
     #   self            the ValidationSourceOutputGenerator object
@@ -193,12 +295,12 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         next_chain_info += '};\n\n'
         next_chain_info += '// Prototype for validateNextChain command (it uses the validate structure commands so add it after\n'
         next_chain_info += 'NextChainResult ValidateNextChain(GenValidUsageXrInstanceInfo *instance_info,\n'
-        next_chain_info += '                                  const std::string &command_name,\n'
-        next_chain_info += '                                  std::vector<GenValidUsageXrObjectInfo>& objects_info,\n'
+        next_chain_info += '                                  const char *command_name,\n'
+        next_chain_info += '                                  const GenValidUsageXrObjectInfoList& objects_info,\n'
         next_chain_info += '                                  const void* next,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& valid_ext_structs,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& encountered_structs,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& duplicate_structs);\n\n'
+        next_chain_info += '                                  const XrStructureType* valid_ext_structs,\n'
+        next_chain_info += '                                  size_t valid_ext_struct_count,\n'
+        next_chain_info += '                                  GenValidUsageNextChainTypeSet& duplicate_structs);\n\n'
         return next_chain_info
 
     # Generate C++ enum and utility function prototypes for validating
@@ -246,7 +348,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             flag_value_validate += '}\n\n'
             if flag_tuple.protect_value:
                 flag_value_validate += '#endif // %s\n' % flag_tuple.protect_string
-        return flag_value_validate
+        return self.guardChecks('FLAGS', flag_value_validate)
 
     # Generate C++ functions for validating enums.
     #   self            the ValidationSourceOutputGenerator object
@@ -257,10 +359,10 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 enum_value_validate += '#if %s\n' % enum_tuple.protect_string
             enum_value_validate += '// Function to validate %s enum\n' % enum_tuple.name
             enum_value_validate += 'bool ValidateXrEnum(GenValidUsageXrInstanceInfo *instance_info,\n'
-            enum_value_validate += '                    const std::string &command_name,\n'
-            enum_value_validate += '                    const std::string &validation_name,\n'
-            enum_value_validate += '                    const std::string &item_name,\n'
-            enum_value_validate += '                    std::vector<GenValidUsageXrObjectInfo>& objects_info,\n'
+            enum_value_validate += '                    const char *command_name,\n'
+            enum_value_validate += '                    const char *validation_name,\n'
+            enum_value_validate += '                    const char *item_name,\n'
+            enum_value_validate += '                    const GenValidUsageXrObjectInfoList& objects_info,\n'
             enum_value_validate += '                    const %s value) {\n' % enum_tuple.name
             indent = 1
             enum_value_validate += self.writeIndent(indent)
@@ -276,36 +378,25 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             checked_extension = ''
             if enum_tuple.ext_name and not self.isCoreExtensionName(enum_tuple.ext_name):
                 checked_extension = enum_tuple.ext_name
+                extension_check_start = len(enum_value_validate)
                 enum_value_validate += self.writeIndent(indent)
                 enum_value_validate += '// Enum requires extension %s, so check that it is enabled\n' % enum_tuple.ext_name
                 enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, "%s")) {\n' % enum_tuple.ext_name
+                enum_value_validate += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, %s)) {\n' % self.makeExtensionId(enum_tuple.ext_name)
                 indent += 1
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'std::string vuid = "VUID-";\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'vuid += validation_name;\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'vuid += "-";\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'vuid += item_name;\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'vuid += "-parameter";\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'std::string error_str = "%s requires extension ";\n' % enum_tuple.name
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'error_str += " \\"%s\\" to be enabled, but it is not enabled";\n' % enum_tuple.ext_name
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += 'CoreValidLogMessage(instance_info, vuid,\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name,\n'
-                enum_value_validate += self.writeIndent(indent)
-                enum_value_validate += '                    objects_info, error_str);\n'
+                enum_value_validate += self.writeCountedMessage(
+                    indent, 'instance_info', '{"VUID-", validation_name, "-", item_name, "-parameter"}', 'command_name',
+                    ['std::string vuid = "VUID-";', 'vuid += validation_name;', 'vuid += "-";', 'vuid += item_name;',
+                     'vuid += "-parameter";'],
+                    '"%s requires extension  \\"%s\\" to be enabled, but it is not enabled"' % (enum_tuple.name, enum_tuple.ext_name),
+                    log_vuid='vuid.c_str()')
                 enum_value_validate += self.writeIndent(indent)
                 enum_value_validate += 'return false;\n'
                 indent -= 1
                 enum_value_validate += self.writeIndent(indent)
                 enum_value_validate += '}\n'
+                enum_value_validate = enum_value_validate[:extension_check_start] + self.guardChecks(
+                    'EXTENSIONS', enum_value_validate[extension_check_start:])
             enum_value_validate += self.writeIndent(indent)
             enum_value_validate += 'switch (value) {\n'
             indent += 1
@@ -329,40 +420,27 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 enum_value_validate += 'case %s:\n' % cur_value.name
                 if cur_value.ext_name and cur_value.ext_name != checked_extension and not self.isCoreExtensionName(cur_value.ext_name):
                     indent += 1
+                    extension_check_start = len(enum_value_validate)
                     enum_value_validate += self.writeIndent(indent)
                     enum_value_validate += '// Enum value %s requires extension %s, so check that it is enabled\n' % (
                         cur_value.name, cur_value.ext_name)
                     enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, "%s")) {\n' % cur_value.ext_name
+                    enum_value_validate += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, %s)) {\n' % self.makeExtensionId(cur_value.ext_name)
                     indent += 1
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'std::string vuid = "VUID-";\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'vuid += validation_name;\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'vuid += "-";\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'vuid += item_name;\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'vuid += "-parameter";\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'std::string error_str = "%s value \\"%s\\"";\n' % (
-                        enum_tuple.name, cur_value.name)
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'error_str += " being used, which requires extension ";\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'error_str += " \\"%s\\" to be enabled, but it is not enabled";\n' % cur_value.ext_name
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += 'CoreValidLogMessage(instance_info, vuid,\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name,\n'
-                    enum_value_validate += self.writeIndent(indent)
-                    enum_value_validate += '                    objects_info, error_str);\n'
+                    enum_value_validate += self.writeCountedMessage(
+                        indent, 'instance_info', '{"VUID-", validation_name, "-", item_name, "-parameter"}', 'command_name',
+                        ['std::string vuid = "VUID-";', 'vuid += validation_name;', 'vuid += "-";', 'vuid += item_name;',
+                         'vuid += "-parameter";'],
+                        '"%s value \\"%s\\" being used, which requires extension  \\"%s\\" to be enabled, but it is not enabled"' % (
+                            enum_tuple.name, cur_value.name, cur_value.ext_name),
+                        log_vuid='vuid.c_str()')
                     enum_value_validate += self.writeIndent(indent)
                     enum_value_validate += 'return false;\n'
                     indent -= 1
                     enum_value_validate += self.writeIndent(indent)
                     enum_value_validate += '}\n'
+                    enum_value_validate = enum_value_validate[:extension_check_start] + self.guardChecks(
+                        'EXTENSIONS', enum_value_validate[extension_check_start:])
                     enum_value_validate += self.writeIndent(indent)
                     enum_value_validate += 'return true;\n'
                     indent -= 1
@@ -386,7 +464,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             enum_value_validate += '}\n\n'
             if enum_tuple.protect_value:
                 enum_value_validate += '#endif // %s\n' % enum_tuple.protect_string
-        return enum_value_validate
+        return self.guardChecks('ENUMS', enum_value_validate)
 
     # Generate prototypes for functions used internal to the source file so other functions can use them
     #   self            the ValidationSourceOutputGenerator object
@@ -403,17 +481,26 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_internal_protos += 'bool VerifyXrParent(XrObjectType handle1_type, const uint64_t handle1,\n'
         validation_internal_protos += '                    XrObjectType handle2_type, const uint64_t handle2,\n'
         validation_internal_protos += '                    bool check_this);\n'
-        validation_internal_protos += '\n// Function to check if an extension has been enabled\n'
-        validation_internal_protos += 'bool ExtensionEnabled(const std::vector<std::string> &extensions, const char* const check_extension_name);\n'
         validation_internal_protos += '\n// Functions to validate structures\n'
         for xr_struct in self.api_structures:
             if xr_struct.protect_value:
                 validation_internal_protos += '#if %s\n' % xr_struct.protect_string
-            validation_internal_protos += 'XrResult ValidateXrStruct(GenValidUsageXrInstanceInfo *instance_info, const std::string &command_name,\n'
-            validation_internal_protos += '                          std::vector<GenValidUsageXrObjectInfo>& objects_info, bool check_members,\n'
+            validation_internal_protos += 'XrResult ValidateXrStruct(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+            validation_internal_protos += '                          const GenValidUsageXrObjectInfoList& objects_info, bool check_members,\n'
             validation_internal_protos += '                          const %s* value);\n' % xr_struct.name
             if xr_struct.protect_value:
                 validation_internal_protos += '#endif // %s\n' % xr_struct.protect_string
+        validation_internal_protos += '\n#if XR_CORE_VALIDATION_UNROLLED_STRUCTS\n'
+        validation_internal_protos += '// The written out functions, which validate structures unless the layer is built with the structure tables\n'
+        for xr_struct in self.getValidatedStructs():
+            if xr_struct.protect_value:
+                validation_internal_protos += '#if %s\n' % xr_struct.protect_string
+            validation_internal_protos += 'XrResult ValidateXrStructUnrolled(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+            validation_internal_protos += '                                  const GenValidUsageXrObjectInfoList& objects_info, bool check_members,\n'
+            validation_internal_protos += '                                  const %s* value);\n' % xr_struct.name
+            if xr_struct.protect_value:
+                validation_internal_protos += '#endif // %s\n' % xr_struct.protect_string
+        validation_internal_protos += '#endif // XR_CORE_VALIDATION_UNROLLED_STRUCTS\n'
         return validation_internal_protos
 
     # Generate C++ functions for validating 'next' chains in a structure.
@@ -421,133 +508,56 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
     def outputValidationSourceNextChainFunc(self):
         next_chain_info = ''
         next_chain_info += 'NextChainResult ValidateNextChain(GenValidUsageXrInstanceInfo *instance_info,\n'
-        next_chain_info += '                                  const std::string &command_name,\n'
-        next_chain_info += '                                  std::vector<GenValidUsageXrObjectInfo>& objects_info,\n'
+        next_chain_info += '                                  const char *command_name,\n'
+        next_chain_info += '                                  const GenValidUsageXrObjectInfoList& objects_info,\n'
         next_chain_info += '                                  const void* next,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& valid_ext_structs,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& encountered_structs,\n'
-        next_chain_info += '                                  std::vector<XrStructureType>& duplicate_structs) {\n'
+        next_chain_info += '                                  const XrStructureType* valid_ext_structs,\n'
+        next_chain_info += '                                  size_t valid_ext_struct_count,\n'
+        next_chain_info += '                                  GenValidUsageNextChainTypeSet& duplicate_structs) {\n'
         next_chain_info += self.writeIndent(1)
         next_chain_info += 'NextChainResult return_result = NEXT_CHAIN_RESULT_VALID;\n'
         next_chain_info += self.writeIndent(1)
-        next_chain_info += '// NULL is valid\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'if (nullptr == next) {\n'
-        next_chain_info += self.writeIndent(2)
-        next_chain_info += 'return return_result;\n'
+        next_chain_info += 'GenValidUsageNextChainTypeSet encountered_structs;\n'
         next_chain_info += self.writeIndent(1)
-        next_chain_info += '}\n'
+        next_chain_info += '// NULL is valid, and every structure in the chain must be one that extends the parent structure.\n'
         next_chain_info += self.writeIndent(1)
-        next_chain_info += '// Non-NULL is not valid if there is no valid extension structs\n'
+        next_chain_info += 'for (const XrBaseInStructure* next_header = reinterpret_cast<const XrBaseInStructure*>(next);\n'
         next_chain_info += self.writeIndent(1)
-        next_chain_info += 'if (nullptr != next && 0 == valid_ext_structs.size()) {\n'
+        next_chain_info += '     nullptr != next_header; next_header = next_header->next) {\n'
+        next_chain_info += self.writeIndent(2)
+        next_chain_info += 'size_t type_index = 0;\n'
+        next_chain_info += self.writeIndent(2)
+        next_chain_info += 'while (type_index < valid_ext_struct_count && valid_ext_structs[type_index] != next_header->type) {\n'
+        next_chain_info += self.writeIndent(3)
+        next_chain_info += '++type_index;\n'
         next_chain_info += self.writeIndent(2)
-        next_chain_info += 'return NEXT_CHAIN_RESULT_ERROR;\n'
-        next_chain_info += self.writeIndent(1)
         next_chain_info += '}\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'const XrBaseInStructure* next_header = reinterpret_cast<const XrBaseInStructure*>(next);\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'auto valid_ext = std::find(valid_ext_structs.begin(), valid_ext_structs.end(), next_header->type);\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'if (valid_ext == valid_ext_structs.end()) {\n'
         next_chain_info += self.writeIndent(2)
+        next_chain_info += 'if (type_index == valid_ext_struct_count) {\n'
+        next_chain_info += self.writeIndent(3)
         next_chain_info += '// Not a valid extension structure type for this next chain.\n'
-        next_chain_info += self.writeIndent(2)
+        next_chain_info += self.writeIndent(3)
         next_chain_info += 'return NEXT_CHAIN_RESULT_ERROR;\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '} else {\n'
         next_chain_info += self.writeIndent(2)
-        next_chain_info += '// Check to see if we\'ve already encountered this structure.\n'
+        next_chain_info += '}\n'
         next_chain_info += self.writeIndent(2)
-        next_chain_info += 'auto already_encountered_ext = std::find(encountered_structs.begin(), encountered_structs.end(), next_header->type);\n'
+        next_chain_info += '// Check to see if we\'ve already encountered this structure.\n'
         next_chain_info += self.writeIndent(2)
-        next_chain_info += 'if (already_encountered_ext != encountered_structs.end()) {\n'
-        next_chain_info += self.writeIndent(3)
-        next_chain_info += '// Make sure we only put in unique types into our duplicate list.\n'
-        next_chain_info += self.writeIndent(3)
-        next_chain_info += 'auto already_duplicate = std::find(duplicate_structs.begin(), duplicate_structs.end(), next_header->type);\n'
-        next_chain_info += self.writeIndent(3)
-        next_chain_info += 'if (already_duplicate == duplicate_structs.end()) {\n'
-        next_chain_info += self.writeIndent(4)
-        next_chain_info += 'duplicate_structs.push_back(next_header->type);\n'
+        next_chain_info += 'if (encountered_structs[type_index]) {\n'
         next_chain_info += self.writeIndent(3)
-        next_chain_info += '}\n'
+        next_chain_info += 'duplicate_structs.set(type_index);\n'
         next_chain_info += self.writeIndent(3)
         next_chain_info += 'return_result = NEXT_CHAIN_RESULT_DUPLICATE_STRUCT;\n'
         next_chain_info += self.writeIndent(2)
         next_chain_info += '}\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '}\n'
-        # Validate the rest of this struct
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'switch (next_header->type) {\n'
-        enum_tuple = [x for x in self.api_enums if x.name == 'XrStructureType'][0]
-        for cur_value in enum_tuple.values:
-            struct_define_name = self.genXrStructureName(
-                cur_value.name)
-            if not struct_define_name:
-                continue
-
-            struct_tuple = self.getStruct(struct_define_name)
-            avoid_dupe = None
-            if cur_value.alias:
-                aliased_value = [x for x in enum_tuple.values if x.name == cur_value.alias][0]
-                if aliased_value.protect_value and aliased_value.protect_value != cur_value.protect_value and aliased_value.protect_value != struct_tuple.protect_value:
-                    avoid_dupe = aliased_value.protect_string
-                    next_chain_info += '#if !(%s)\n' % avoid_dupe
-                else:
-                    # This would unconditionally cause a duplicate case
-                    continue
-            if struct_tuple.protect_value:
-                next_chain_info += '#if %s\n' % struct_tuple.protect_string
-                
-            next_chain_info += self.writeIndent(2)
-            next_chain_info += 'case %s:\n' % cur_value.name
-            next_chain_info += self.writeIndent(3)
-            next_chain_info += 'if (XR_SUCCESS != ValidateXrStruct(instance_info, command_name, objects_info, false,\n'
-            next_chain_info += self.writeIndent(3)
-            next_chain_info += '                                   reinterpret_cast<const %s*>(next))) {\n' % struct_define_name
-            next_chain_info += self.writeIndent(4)
-            next_chain_info += 'return NEXT_CHAIN_RESULT_ERROR;\n'
-            next_chain_info += self.writeIndent(3)
-            next_chain_info += '}\n'
-            next_chain_info += self.writeIndent(3)
-            next_chain_info += 'break;\n'
-            if struct_tuple.protect_value:
-                next_chain_info += '#endif // %s\n' % struct_tuple.protect_string
-            if avoid_dupe:
-                next_chain_info += '#endif // !(%s)\n' % avoid_dupe
-
         next_chain_info += self.writeIndent(2)
-        next_chain_info += 'default:\n'
-        next_chain_info += self.writeIndent(3)
-        next_chain_info += 'return NEXT_CHAIN_RESULT_ERROR;\n'
+        next_chain_info += 'encountered_structs.set(type_index);\n'
         next_chain_info += self.writeIndent(1)
         next_chain_info += '}\n'
-        # Validate any chained structs
         next_chain_info += self.writeIndent(1)
-        next_chain_info += 'NextChainResult next_result = ValidateNextChain(instance_info, command_name,\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '                                                objects_info, next_header->next,\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '                                                valid_ext_structs,\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '                                                encountered_structs,\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '                                                duplicate_structs);\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += 'if (NEXT_CHAIN_RESULT_VALID == next_result && NEXT_CHAIN_RESULT_VALID != return_result) {\n'
-        next_chain_info += self.writeIndent(2)
         next_chain_info += 'return return_result;\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '} else {\n'
-        next_chain_info += self.writeIndent(2)
-        next_chain_info += 'return next_result;\n'
-        next_chain_info += self.writeIndent(1)
-        next_chain_info += '}\n'
         next_chain_info += '}\n\n'
-        return next_chain_info
+        return self.guardChecks('NEXT_CHAINS', next_chain_info)
 
     # Generate C++ header information containing functionality used in both
     # the generated and manual code.
@@ -619,223 +629,263 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_header_info += '#pragma GCC diagnostic ignored "-Wunused-variable"\n'
         validation_header_info += '#endif\n'
 
-        validation_header_info += '\n// Externs for Core Validation\n'
+        validation_header_info += '\n'
+        validation_header_info += self.outputExtensionIds()
+        validation_header_info += self.outputStructIds()
+        validation_header_info += self.outputValidationSourceNextChainProtos()
+        validation_header_info += self.outputPerformanceTrackingProtos()
+        validation_header_info += '// Externs for Core Validation\n'
         validation_header_info += self.outputInfoMapDeclarations(extern=True)
-        validation_header_info += 'void GenValidUsageCleanUpMaps(GenValidUsageXrInstanceInfo *instance_info);\n\n'
+        validation_header_info += 'void GenValidUsageCleanUpMaps(GenValidUsageXrInstanceInfo *instance_info);\n'
+        validation_header_info += 'void GenValidUsageReleaseRetiredMapTables();\n\n'
 
-        validation_header_info += '\n// Function to convert XrObjectType to string\n'
-        validation_header_info += 'std::string GenValidUsageXrObjectTypeToString(const XrObjectType& type);\n\n'
         validation_header_info += '// Function to record all the core validation information\n'
-        validation_header_info += 'extern void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const std::string &message_id,\n'
-        validation_header_info += '                                GenValidUsageDebugSeverity message_severity, const std::string &command_name,\n'
-        validation_header_info += '                                std::vector<GenValidUsageXrObjectInfo> objects_info, const std::string &message);\n'
+        validation_header_info += 'extern void CoreValidLogMessage(GenValidUsageXrInstanceInfo *instance_info, const char *message_id,\n'
+        validation_header_info += '                                GenValidUsageDebugSeverity message_severity, const char *command_name,\n'
+        validation_header_info += '                                const GenValidUsageXrObjectInfoList &objects_info, const char *message);\n'
         return validation_header_info
 
+    # Get the commands whose calls are validated by generated functions, which the layer can sample.
+    #   self            the ValidationSourceOutputGenerator object
+    def getSampledCommands(self):
+        return [cur_cmd for cur_cmd in self.core_commands + self.ext_commands
+                if cur_cmd.name not in self.no_trampoline_or_terminator and cur_cmd.name != 'xrGetInstanceProcAddr' and
+                cur_cmd.name not in VALID_USAGE_MANUALLY_DEFINED]
+
+    # Generate the C++ prototypes of the functions that pass calls to the performance checks.
+    #   self            the ValidationSourceOutputGenerator object
+    def outputPerformanceTrackingProtos(self):
+        tracking_protos = '// Pass the calls of the commands the performance checks look at, once they return.\n'
+        tracked_commands = [cur_cmd for cur_cmd in self.getSampledCommands() if cur_cmd.name in VALID_USAGE_PERFORMANCE_TRACKED]
+        # Every tracked command has to exist and return a result.
+        assert(len(tracked_commands) == len(VALID_USAGE_PERFORMANCE_TRACKED))
+        for cur_cmd in tracked_commands:
+            assert(cur_cmd.return_type is not None and cur_cmd.return_type.text == 'XrResult')
+            if cur_cmd.protect_value:
+                tracking_protos += '#if %s\n' % cur_cmd.protect_string
+            tracking_protos += 'void %s(XrResult result' % cur_cmd.name.replace("xr", "CoreValidationTrackXr", 1)
+            for param in cur_cmd.params:
+                tracking_protos += ', %s' % param.cdecl.strip()
+            tracking_protos += ');\n'
+            if cur_cmd.protect_value:
+                tracking_protos += '#endif // %s\n' % cur_cmd.protect_string
+        tracking_protos += '\n'
+        return tracking_protos
+
+    # Get the name of the identifier of an extension, used to index GenValidUsageExtensionSet.
+    #   self            the ValidationSourceOutputGenerator object
+    #   extension_name  the name of the extension
+    def makeExtensionId(self, extension_name):
+        assert(extension_name in self.extension_names)
+        return 'GEN_VALID_USAGE_EXTENSION_%s' % extension_name.upper()
+
+    # Generate the C++ enum of extension identifiers.
+    #   self            the ValidationSourceOutputGenerator object
+    def outputExtensionIds(self):
+        # Every extension needs a bit in GenValidUsageExtensionSet.
+        assert(len(self.extension_names) <= 256)
+        extension_ids = '// Identifiers of the extensions in the registry, which index the bits of GenValidUsageExtensionSet.\n'
+        extension_ids += 'enum GenValidUsageExtension {\n'
+        for extension_name in self.extension_names:
+            extension_ids += '    %s,\n' % self.makeExtensionId(extension_name)
+        extension_ids += '    GEN_VALID_USAGE_EXTENSION_COUNT,\n'
+        extension_ids += '};\n\n'
+        extension_ids += '// Returns the identifier of the named extension, or GEN_VALID_USAGE_EXTENSION_COUNT if it is not in the registry.\n'
+        extension_ids += 'GenValidUsageExtension GenValidUsageExtensionFromName(const char *name);\n\n'
+        extension_ids += '// Returns the set of the named extensions, leaving out any that are not in the registry.\n'
+        extension_ids += 'GenValidUsageExtensionSet GenValidUsageExtensionSetFromNames(uint32_t count, const char *const *names);\n\n'
+        extension_ids += '// Function to check if an extension has been enabled\n'
+        extension_ids += 'inline bool ExtensionEnabled(const GenValidUsageExtensionSet &extensions, GenValidUsageExtension extension) {\n'
+        extension_ids += '    return extensions[extension];\n'
+        extension_ids += '}\n\n'
+        extension_ids += '// Check that the extensions the enabled instance or system extensions depend on are enabled too\n'
+        extension_ids += 'bool ValidateInstanceExtensionDependencies(GenValidUsageXrInstanceInfo *gen_instance_info,\n'
+        extension_ids += '                                           const char *command,\n'
+        extension_ids += '                                           const char *struct_name,\n'
+        extension_ids += '                                           const GenValidUsageXrObjectInfoList& objects_info,\n'
+        extension_ids += '                                           const GenValidUsageExtensionSet &extensions);\n'
+        extension_ids += 'bool ValidateSystemExtensionDependencies(GenValidUsageXrInstanceInfo *gen_instance_info,\n'
+        extension_ids += '                                         const char *command,\n'
+        extension_ids += '                                         const char *struct_name,\n'
+        extension_ids += '                                         const GenValidUsageXrObjectInfoList& objects_info,\n'
+        extension_ids += '                                         const GenValidUsageExtensionSet &extensions);\n\n'
+        return extension_ids
+
     # Generate C++ utility functions to verify that all the required extensions have been enabled.
     #   self            the ValidationSourceOutputGenerator object
     def writeVerifyExtensions(self):
-        verify_extensions = 'bool ExtensionEnabled(const std::vector<std::string> &extensions, const char* const check_extension_name) {\n'
+        verify_extensions = 'GenValidUsageExtension GenValidUsageExtensionFromName(const char *name) {\n'
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += 'static const char *const extension_names[GEN_VALID_USAGE_EXTENSION_COUNT] = {\n'
+        for extension_name in self.extension_names:
+            verify_extensions += self.writeIndent(2)
+            verify_extensions += '"%s",\n' % extension_name
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += '};\n'
         verify_extensions += self.writeIndent(1)
-        verify_extensions += 'for (const auto& enabled_extension: extensions) {\n'
+        verify_extensions += 'for (uint32_t extension = 0; extension < GEN_VALID_USAGE_EXTENSION_COUNT; ++extension) {\n'
         verify_extensions += self.writeIndent(2)
-        verify_extensions += 'if (enabled_extension == check_extension_name) {\n'
+        verify_extensions += 'if (0 == strcmp(name, extension_names[extension])) {\n'
         verify_extensions += self.writeIndent(3)
-        verify_extensions += 'return true;\n'
+        verify_extensions += 'return static_cast<GenValidUsageExtension>(extension);\n'
         verify_extensions += self.writeIndent(2)
         verify_extensions += '}\n'
         verify_extensions += self.writeIndent(1)
         verify_extensions += '}\n'
         verify_extensions += self.writeIndent(1)
-        verify_extensions += 'return false;\n'
+        verify_extensions += 'return GEN_VALID_USAGE_EXTENSION_COUNT;\n'
         verify_extensions += '}\n\n'
-        number_of_instance_extensions = 0
-        number_of_system_extensions = 0
-        for extension in self.extensions:
-            if extension.type == 'instance':
-                number_of_instance_extensions += 1
-            elif extension.type == 'system':
-                number_of_system_extensions += 1
+        verify_extensions += 'GenValidUsageExtensionSet GenValidUsageExtensionSetFromNames(uint32_t count, const char *const *names) {\n'
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += 'GenValidUsageExtensionSet extensions;\n'
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += 'for (uint32_t index = 0; index < count; ++index) {\n'
+        verify_extensions += self.writeIndent(2)
+        verify_extensions += 'GenValidUsageExtension extension = GenValidUsageExtensionFromName(names[index]);\n'
+        verify_extensions += self.writeIndent(2)
+        verify_extensions += 'if (GEN_VALID_USAGE_EXTENSION_COUNT != extension) {\n'
+        verify_extensions += self.writeIndent(3)
+        verify_extensions += 'extensions.set(extension);\n'
+        verify_extensions += self.writeIndent(2)
+        verify_extensions += '}\n'
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += '}\n'
+        verify_extensions += self.writeIndent(1)
+        verify_extensions += 'return extensions;\n'
+        verify_extensions += '}\n\n'
+        dependency_check_start = len(verify_extensions)
         verify_extensions += 'bool ValidateInstanceExtensionDependencies(GenValidUsageXrInstanceInfo *gen_instance_info,\n'
-        verify_extensions += '                                           const std::string &command,\n'
-        verify_extensions += '                                           const std::string &struct_name,\n'
-        verify_extensions += '                                           std::vector<GenValidUsageXrObjectInfo>& objects_info,\n'
-        verify_extensions += '                                           std::vector<std::string> &extensions) {\n'
+        verify_extensions += '                                           const char *command,\n'
+        verify_extensions += '                                           const char *struct_name,\n'
+        verify_extensions += '                                           const GenValidUsageXrObjectInfoList& objects_info,\n'
+        verify_extensions += '                                           const GenValidUsageExtensionSet &extensions) {\n'
         indent = 1
-        if number_of_instance_extensions > 0:
-            verify_extensions += self.writeIndent(indent)
-            verify_extensions += 'for (uint32_t cur_index = 0; cur_index < extensions.size(); ++cur_index) {\n'
-            indent += 1
-            for extension in self.extensions:
-                number_of_required = len(extension.required_exts) - 1
-                if extension.type == 'instance' and number_of_required > 0:
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'if (extensions[cur_index] == "%s") {\n' % extension.name
-                    current_count = 0
-                    indent += 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'for (uint32_t check_index = 0; check_index < extensions.size(); ++check_index) {\n'
-                    indent += 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'if (cur_index == check_index) {\n'
-                    verify_extensions += self.writeIndent(indent + 1)
-                    verify_extensions += 'continue;\n'
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-                    current_count = 0
-                    for required_ext in extension.required_exts:
-                        if current_count > 0:
-                            found = False
-                            for extension_look in self.extensions:
-                                if extension_look.name == required_ext:
-                                    found = True
-                                    if extension_look.type != 'instance':
-                                        verify_extensions += self.printCodeGenErrorMessage('Instance extension "%s" requires non-instance extension "%s" which is not allowed' % (
-                                            self.currentExtension, required_ext))
-                            if not found:
-                                verify_extensions += self.printCodeGenErrorMessage('Instance extension "%s" lists extension "%s" as a requirement, but'
-                                                                                   ' it is not defined in the registry.' % (
-                                                                                       self.currentExtension, required_ext))
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'if (!ExtensionEnabled(extensions, "%s")) {\n' % required_ext
-                            indent += 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'if (nullptr != gen_instance_info) {\n'
-                            indent += 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'std::string vuid = "VUID-";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += command;\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += "-";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += struct_name;\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += "-parameter";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'CoreValidLogMessage(gen_instance_info, vuid, VALID_USAGE_DEBUG_SEVERITY_ERROR,\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    command, objects_info,\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    "Missing extension dependency \\"%s\\" (required by extension" \\\n' % required_ext
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    "\\"%s\\") from enabled extension list");\n' % extension.name
-                            indent -= 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '}\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'return false;\n'
-                            indent -= 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '}\n'
-                        current_count += 1
-                    indent -= 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-                    indent -= 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-            indent -= 1
-            verify_extensions += self.writeIndent(indent)
-            verify_extensions += '}\n'
-        else:
+        wrote_check = False
+        for extension in self.extensions:
+            if extension.type != 'instance':
+                continue
+            for required_ext in extension.required_exts[1:]:
+                found = False
+                for extension_look in self.extensions:
+                    if extension_look.name == required_ext:
+                        found = True
+                        if extension_look.type != 'instance':
+                            verify_extensions += self.printCodeGenErrorMessage('Instance extension "%s" requires non-instance extension "%s" which is not allowed' % (
+                                extension.name, required_ext))
+                if not found:
+                    verify_extensions += self.printCodeGenErrorMessage('Instance extension "%s" lists extension "%s" as a requirement, but'
+                                                                       ' it is not defined in the registry.' % (
+                                                                           extension.name, required_ext))
+                    continue
+                wrote_check = True
+                verify_extensions += self.writeIndent(indent)
+                verify_extensions += 'if (ExtensionEnabled(extensions, %s) && !ExtensionEnabled(extensions, %s)) {\n' % (
+                    self.makeExtensionId(extension.name), self.makeExtensionId(required_ext))
+                verify_extensions += self.writeMissingExtensionDependency(indent + 1, 'gen_instance_info', extension.name,
+                                                                          required_ext)
+                verify_extensions += self.writeIndent(indent)
+                verify_extensions += '}\n'
+        if not wrote_check:
             verify_extensions += self.writeIndent(indent)
             verify_extensions += '// No instance extensions to check dependencies for\n'
         verify_extensions += self.writeIndent(indent)
         verify_extensions += 'return true;\n'
         verify_extensions += '}\n\n'
         verify_extensions += 'bool ValidateSystemExtensionDependencies(GenValidUsageXrInstanceInfo *gen_instance_info,\n'
-        verify_extensions += '                                         const std::string &command,\n'
-        verify_extensions += '                                         const std::string &struct_name,\n'
-        verify_extensions += '                                         std::vector<GenValidUsageXrObjectInfo>& objects_info,\n'
-        verify_extensions += '                                         std::vector<std::string> &extensions) {\n'
-        indent = 1
-        if number_of_system_extensions > 0:
-            verify_extensions += self.writeIndent(indent)
-            verify_extensions += 'for (uint32_t cur_index = 0; cur_index < extensions.size(); ++cur_index) {\n'
-            indent += 1
-            for extension in self.extensions:
-                number_of_required = len(self.required_exts) - 1
-                if extension.type == 'system' and number_of_required > 0:
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'if (extensions[cur_index] == "%s") {\n' % extension.name
-                    current_count = 0
-                    indent += 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'for (uint32_t check_index = 0; check_index < extensions.size(); ++check_index) {\n'
-                    indent += 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += 'if (cur_index == check_index) {\n'
-                    verify_extensions += self.writeIndent(indent + 1)
-                    verify_extensions += 'continue;\n'
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-                    current_count = 0
-                    for required_ext in extension.required_exts:
-                        if current_count > 0:
-                            found = False
-                            is_instance = False
-                            for extension_look in self.extensions:
-                                if extension_look.name == required_ext:
-                                    found = True
-                                    if extension_look.type == 'instance':
-                                        is_instance = True
-                                    if not is_instance and extension_look.type != 'system':
-                                        verify_extensions += self.printCodeGenErrorMessage('System extension "%s" has an extension dependency on extension "%s" '
-                                                                                           'which is of an invalid type.' % (
-                                                                                               self.currentExtension, required_ext))
-                            if not found:
-                                verify_extensions += self.printCodeGenErrorMessage('System extension "%s" lists extension "%s" as a requirement, but'
-                                                                                   ' it is not defined in the registry.' % (
-                                                                                       self.currentExtension, required_ext))
-                            if is_instance:
-                                verify_extensions += self.writeIndent(indent)
-                                verify_extensions += '// This is an instance extension dependency, so make sure it is enabled in the instance\n'
-                                verify_extensions += self.writeIndent(indent)
-                                verify_extensions += 'if (!ExtensionEnabled(gen_instance_info->enabled_extensions, "%s") {\n' % required_ext
-                            else:
-                                verify_extensions += self.writeIndent(indent)
-                                verify_extensions += 'if (!ExtensionEnabled(extensions, "%s")) {\n' % required_ext
-                            indent += 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'std::string vuid = "VUID-";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += command;\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += "-";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += struct_name;\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'vuid += "-parameter";\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'CoreValidLogMessage(gen_instance_info, vuid, VALID_USAGE_DEBUG_SEVERITY_ERROR,\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    command, objects_info,\n'
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    "Missing extension dependency \\"%s\\" (required by extension" \\' % required_ext
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '                    "\\"%s\\") from enabled extension list");\n' % extension.name
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += 'return false;\n'
-                            indent -= 1
-                            verify_extensions += self.writeIndent(indent)
-                            verify_extensions += '}\n'
-                        current_count += 1
-                    indent -= 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-                    indent -= 1
-                    verify_extensions += self.writeIndent(indent)
-                    verify_extensions += '}\n'
-            indent -= 1
-            verify_extensions += self.writeIndent(indent)
-            verify_extensions += '}\n'
-        else:
+        verify_extensions += '                                         const char *command,\n'
+        verify_extensions += '                                         const char *struct_name,\n'
+        verify_extensions += '                                         const GenValidUsageXrObjectInfoList& objects_info,\n'
+        verify_extensions += '                                         const GenValidUsageExtensionSet &extensions) {\n'
+        wrote_check = False
+        for extension in self.extensions:
+            if extension.type != 'system':
+                continue
+            for required_ext in extension.required_exts[1:]:
+                found = False
+                is_instance = False
+                for extension_look in self.extensions:
+                    if extension_look.name == required_ext:
+                        found = True
+                        if extension_look.type == 'instance':
+                            is_instance = True
+                        if not is_instance and extension_look.type != 'system':
+                            verify_extensions += self.printCodeGenErrorMessage('System extension "%s" has an extension dependency on extension "%s" '
+                                                                               'which is of an invalid type.' % (
+                                                                                   extension.name, required_ext))
+                if not found:
+                    verify_extensions += self.printCodeGenErrorMessage('System extension "%s" lists extension "%s" as a requirement, but'
+                                                                       ' it is not defined in the registry.' % (
+                                                                           extension.name, required_ext))
+                    continue
+                wrote_check = True
+                # An instance extension dependency must be enabled in the instance
+                required_in = 'gen_instance_info->enabled_extensions' if is_instance else 'extensions'
+                verify_extensions += self.writeIndent(indent)
+                verify_extensions += 'if (ExtensionEnabled(extensions, %s) && !ExtensionEnabled(%s, %s)) {\n' % (
+                    self.makeExtensionId(extension.name), required_in, self.makeExtensionId(required_ext))
+                verify_extensions += self.writeMissingExtensionDependency(indent + 1, 'gen_instance_info', extension.name,
+                                                                          required_ext)
+                verify_extensions += self.writeIndent(indent)
+                verify_extensions += '}\n'
+        if not wrote_check:
             verify_extensions += self.writeIndent(indent)
             verify_extensions += '// No system extensions to check dependencies for\n'
         verify_extensions += self.writeIndent(indent)
         verify_extensions += 'return true;\n'
         verify_extensions += '}\n\n'
-        return verify_extensions
+        return verify_extensions[:dependency_check_start] + self.guardChecks('EXTENSIONS',
+                                                                             verify_extensions[dependency_check_start:])
+
+    # Generate C++ code that counts an error message, and only formats and logs it if it is to be emitted, so
+    # that nothing is formatted for a repeat that is dropped.
+    #   self            the ValidationSourceOutputGenerator object
+    #   indent          the number of "tabs" to space in for the resulting C+ code.
+    #   instance_info   the name of the instance info variable
+    #   count_vuid      the VUID to count: a string literal, or a braced list of its parts
+    #   command         the command name expression
+    #   format_lines    the statements that format the message, and the VUID if it is not a literal
+    #   message         the message expression, after format_lines
+    #   log_vuid        the VUID to log, if it is not count_vuid
+    #   objects         the name of the objects info list
+    def writeCountedMessage(self, indent, instance_info, count_vuid, command, format_lines, message, log_vuid=None,
+                            objects='objects_info'):
+        counted_message = self.writeIndent(indent)
+        counted_message += 'if (CoreValidationMessageCount message_count = CoreValidationCountMessage(%s, %s, %s)) {\n' % (
+            count_vuid, command, objects)
+        for line in format_lines:
+            counted_message += self.writeIndent(indent + 1)
+            counted_message += line + '\n'
+        counted_message += self.writeIndent(indent + 1)
+        counted_message += 'CoreValidLogCountedMessage(%s, %s, VALID_USAGE_DEBUG_SEVERITY_ERROR, %s, %s,\n' % (
+            instance_info, log_vuid if log_vuid else count_vuid, command, objects)
+        counted_message += self.writeIndent(indent + 1)
+        counted_message += '                           %s, message_count);\n' % message
+        counted_message += self.writeIndent(indent)
+        counted_message += '}\n'
+        return counted_message
+
+    # Generate C++ code to report a missing extension dependency and fail.
+    #   self                the ValidationSourceOutputGenerator object
+    #   indent              the number of "tabs" to space in for the resulting C+ code.
+    #   instance_info_name  the name of the instance info variable, which may be null
+    #   extension_name      the name of the extension that has the dependency
+    #   required_ext        the name of the extension it depends on
+    def writeMissingExtensionDependency(self, indent, instance_info_name, extension_name, required_ext):
+        missing_dependency = self.writeIndent(indent)
+        missing_dependency += 'if (nullptr != %s) {\n' % instance_info_name
+        indent += 1
+        missing_dependency += self.writeCountedMessage(
+            indent, instance_info_name, '{"VUID-", command, "-", struct_name, "-parameter"}', 'command',
+            ['std::string vuid = "VUID-";', 'vuid += command;', 'vuid += "-";', 'vuid += struct_name;', 'vuid += "-parameter";'],
+            '"Missing extension dependency \\"%s\\" (required by extension\\"%s\\") from enabled extension list"' % (
+                required_ext, extension_name),
+            log_vuid='vuid.c_str()')
+        indent -= 1
+        missing_dependency += self.writeIndent(indent)
+        missing_dependency += '}\n'
+        missing_dependency += self.writeIndent(indent)
+        missing_dependency += 'return false;\n'
+        return missing_dependency
 
     # Generate C++ enum and utility functions for verify that handles are valid.
     #   self            the ValidationSourceOutputGenerator object
@@ -991,24 +1041,31 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
     #   member          the member generated in automatic_source_generator.py to validate
     #   indent          the number of "tabs" to space in for the resulting C+ code.
     def writeValidateStructNextCheck(self, struct_type, struct_name, member, indent):
-        validate_struct_next = self.writeIndent(indent)
-        validate_struct_next += 'std::vector<XrStructureType> valid_ext_structs;\n'
-        validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += 'std::vector<XrStructureType> duplicate_ext_structs;\n'
-        validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += 'std::vector<XrStructureType> encountered_structs;\n'
+        # The valid structures are a constant table, so that a chain is checked without allocating.
+        # Their positions in it index the bits of GenValidUsageNextChainTypeSet.
+        validate_struct_next = ''
+        valid_ext_struct_count = 0
         if member.valid_extension_structs:
+            valid_ext_struct_count = len(member.valid_extension_structs)
+            assert(valid_ext_struct_count <= 64)
+            validate_struct_next += self.writeIndent(indent)
+            validate_struct_next += 'static constexpr XrStructureType valid_ext_structs[] = {\n'
             for valid_struct in member.valid_extension_structs:
-                validate_struct_next += self.writeIndent(indent)
-                validate_struct_next += 'valid_ext_structs.push_back(%s);\n' % self.genXrStructureType(
-                    valid_struct)
+                validate_struct_next += self.writeIndent(indent + 1)
+                validate_struct_next += '%s,\n' % self.genXrStructureType(valid_struct)
+            validate_struct_next += self.writeIndent(indent)
+            validate_struct_next += '};\n'
         validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += 'NextChainResult next_result = ValidateNextChain(instance_info, command_name, objects_info,\n'
+        validate_struct_next += 'GenValidUsageNextChainTypeSet duplicate_ext_structs;\n'
         validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += '                                                 %s->%s, valid_ext_structs,\n' % (
-            struct_name, member.name)
+        validate_struct_next += 'NextChainResult next_result = ValidateNextChain(instance_info, command_name, objects_info,\n'
         validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += '                                                 encountered_structs,\n'
+        if valid_ext_struct_count:
+            validate_struct_next += '                                                 %s->%s, valid_ext_structs, %d,\n' % (
+                struct_name, member.name, valid_ext_struct_count)
+        else:
+            validate_struct_next += '                                                 %s->%s, nullptr, 0,\n' % (
+                struct_name, member.name)
         validate_struct_next += self.writeIndent(indent)
         validate_struct_next += '                                                 duplicate_ext_structs);\n'
         validate_struct_next += self.writeIndent(indent)
@@ -1027,24 +1084,19 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                                                                                                                                              member.name)
         validate_struct_next += self.writeIndent(indent + 1)
         validate_struct_next += 'xr_result = XR_ERROR_VALIDATION_FAILURE;\n'
-        validate_struct_next += self.writeIndent(indent)
-        validate_struct_next += '} else if (NEXT_CHAIN_RESULT_DUPLICATE_STRUCT == next_result) {\n'
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += 'std::string error_message = "Multiple structures of the same type(s) in \\"next\\" chain for ";\n'
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += 'error_message += "%s : ";\n' % struct_type
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += 'error_message += StructTypesToString(instance_info, duplicate_ext_structs);\n'
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += 'CoreValidLogMessage(instance_info, "VUID-%s-next-unique",\n' % struct_type
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name,\n'
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += '                    objects_info,\n'
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += '"Multiple structures of the same type(s) in \\"next\\" chain for %s struct");\n' %  struct_type
-        validate_struct_next += self.writeIndent(indent + 1)
-        validate_struct_next += 'xr_result = XR_ERROR_VALIDATION_FAILURE;\n'
+        if valid_ext_struct_count:
+            # A structure can only be duplicated if there are any that may be in the chain.
+            validate_struct_next += self.writeIndent(indent)
+            validate_struct_next += '} else if (NEXT_CHAIN_RESULT_DUPLICATE_STRUCT == next_result) {\n'
+            validate_struct_next += self.writeCountedMessage(
+                indent + 1, 'instance_info', '"VUID-%s-next-unique"' % struct_type, 'command_name',
+                ['std::string error_message = "Multiple structures of the same type(s) in \\"next\\" chain for ";',
+                 'error_message += "%s : ";' % struct_type,
+                 'error_message += StructTypesToString(instance_info, valid_ext_structs, %d, duplicate_ext_structs);' % (
+                     valid_ext_struct_count)],
+                'error_message')
+            validate_struct_next += self.writeIndent(indent + 1)
+            validate_struct_next += 'xr_result = XR_ERROR_VALIDATION_FAILURE;\n'
         validate_struct_next += self.writeIndent(indent)
         validate_struct_next += '}\n'
         return validate_struct_next
@@ -1154,23 +1206,12 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         inline_enum_str += 'if (!ValidateXrEnum(%s, %s, "%s", "%s", objects_info, %s%s)) {\n' % (
             instance_info_string, cmd_name_param, cmd_struct_name, param_name, pointer_string, full_param_name)
         int_indent = int_indent + 1
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += 'std::ostringstream oss_enum;\n'
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += 'oss_enum << "%s %s \\"%s\\" enum value ";\n' % (error_prefix,
-                                                                            param_type,
-                                                                            param_name)
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += 'oss_enum << Uint32ToHexString(static_cast<uint32_t>(%s%s));\n' % (pointer_string,
-                                                                                              full_param_name)
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += 'CoreValidLogMessage(%s, "VUID-%s-%s-parameter",\n' % (instance_info_string,
-                                                                                  cmd_struct_name,
-                                                                                  param_name)
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, %s,\n' % cmd_name_param
-        inline_enum_str += self.writeIndent(int_indent)
-        inline_enum_str += '                    objects_info, oss_enum.str());\n'
+        inline_enum_str += self.writeCountedMessage(
+            int_indent, instance_info_string, '"VUID-%s-%s-parameter"' % (cmd_struct_name, param_name), cmd_name_param,
+            ['std::ostringstream oss_enum;',
+             'oss_enum << "%s %s \\"%s\\" enum value ";' % (error_prefix, param_type, param_name),
+             'oss_enum << Uint32ToHexString(static_cast<uint32_t>(%s%s));' % (pointer_string, full_param_name)],
+            'oss_enum.str()')
         inline_enum_str += self.writeIndent(int_indent)
         inline_enum_str += 'return XR_ERROR_VALIDATION_FAILURE;\n'
         int_indent = int_indent - 1
@@ -1246,25 +1287,13 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             int_indent = int_indent + 1
             inline_flag_str += self.writeIndent(int_indent)
             inline_flag_str += '// Otherwise, flags must be valid.\n'
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += 'std::ostringstream oss_enum;\n'
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += 'oss_enum << "%s %s \\"%s\\" flag value ";\n' % (error_prefix,
-                                                                                param_type,
-                                                                                param_name)
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += 'oss_enum << Uint32ToHexString(static_cast<uint32_t>(%s%s));\n' % (pointer_string,
-                                                                                                  full_param_name)
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += 'oss_enum <<" contains illegal bit";\n'
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += 'CoreValidLogMessage(%s, "VUID-%s-%s-parameter",\n' % (instance_info_string,
-                                                                                      cmd_struct_name,
-                                                                                      param_name)
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, %s,\n' % cmd_name_param
-            inline_flag_str += self.writeIndent(int_indent)
-            inline_flag_str += '                    objects_info, oss_enum.str());\n'
+            inline_flag_str += self.writeCountedMessage(
+                int_indent, instance_info_string, '"VUID-%s-%s-parameter"' % (cmd_struct_name, param_name), cmd_name_param,
+                ['std::ostringstream oss_enum;',
+                 'oss_enum << "%s %s \\"%s\\" flag value ";' % (error_prefix, param_type, param_name),
+                 'oss_enum << Uint32ToHexString(static_cast<uint32_t>(%s%s));' % (pointer_string, full_param_name),
+                 'oss_enum <<" contains illegal bit";'],
+                'oss_enum.str()')
             inline_flag_str += self.writeIndent(int_indent)
             inline_flag_str += 'return XR_ERROR_VALIDATION_FAILURE;\n'
             int_indent = int_indent - 1
@@ -1347,21 +1376,12 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 inline_validate_handle += 'if (handle_result != VALIDATE_XR_HANDLE_SUCCESS) {\n'
                 inline_validate_handle += self.writeIndent(indent)
                 inline_validate_handle += '// Not a valid handle or NULL (which is not valid in this case)\n'
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += 'std::ostringstream oss;\n'
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += 'oss << "Invalid %s handle \\"%s\\" ";\n' % (member_param.type,
-                                                                                   member_param.name)
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += 'oss << HandleToHexString(%s);\n' % mem_par_desc_name
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += 'CoreValidLogMessage(%s, "VUID-%s-%s-parameter",\n' % (instance_info_name,
-                                                                                             vuid_name,
-                                                                                             member_param.name)
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, %s,\n' % cmd_name
-            inline_validate_handle += self.writeIndent(indent)
-            inline_validate_handle += '                    objects_info, oss.str());\n'
+            inline_validate_handle += self.writeCountedMessage(
+                indent, instance_info_name, '"VUID-%s-%s-parameter"' % (vuid_name, member_param.name), cmd_name,
+                ['std::ostringstream oss;',
+                 'oss << "Invalid %s handle \\"%s\\" ";' % (member_param.type, member_param.name),
+                 'oss << HandleToHexString(%s);' % mem_par_desc_name],
+                'oss.str()')
             inline_validate_handle += self.writeIndent(indent)
             inline_validate_handle += 'return XR_ERROR_HANDLE_INVALID;\n'
             indent = indent - 1
@@ -1424,14 +1444,15 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     long_count_name += param_member.pointer_count_var
             if check_pointer_array_null:
                 full_count_var = long_count_name
-                param_member_contents += self.writeValidatePointerArrayNonNull(struct_command_name,
-                                                                               param_member.name,
-                                                                               param_member.type,
-                                                                               prefixed_param_member_name,
-                                                                               full_count_var,
-                                                                               short_count_var,
-                                                                               is_command,
-                                                                               indent)
+                pointer_check = self.writeValidatePointerArrayNonNull(struct_command_name,
+                                                                      param_member.name,
+                                                                      param_member.type,
+                                                                      prefixed_param_member_name,
+                                                                      full_count_var,
+                                                                      short_count_var,
+                                                                      is_command,
+                                                                      indent)
+                param_member_contents += self.guardChecks('POINTERS', pointer_check)
             if (param_member.is_handle or self.isEnumType(param_member.type) or
                     (self.isStruct(param_member.type) and not self.isStructAlwaysValid(param_member.type))):
                 loop_string += self.writeIndent(indent)
@@ -1447,16 +1468,18 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     prefixed_param_member_name, loop_param_name)
                 is_loop = True
         elif check_pointer_array_null:
-            param_member_contents += self.writeValidatePointerArrayNonNull(struct_command_name,
-                                                                           param_member.name,
-                                                                           param_member.type,
-                                                                           prefixed_param_member_name,
-                                                                           None,
-                                                                           None,
-                                                                           is_command,
-                                                                           indent)
+            pointer_check = self.writeValidatePointerArrayNonNull(struct_command_name,
+                                                                  param_member.name,
+                                                                  param_member.type,
+                                                                  prefixed_param_member_name,
+                                                                  None,
+                                                                  None,
+                                                                  is_command,
+                                                                  indent)
+            param_member_contents += self.guardChecks('POINTERS', pointer_check)
 
         if not param_member.is_static_array and param_member.array_length_for:
+            length_check_start = len(param_member_contents)
             if param_member.is_optional:
                 param_member_contents += self.writeIndent(indent)
                 param_member_contents += '// Optional array must be non-NULL when %s is non-zero\n' % prefixed_param_member_name
@@ -1511,7 +1534,12 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 param_member_contents += 'xr_result = XR_ERROR_VALIDATION_FAILURE;\n'
                 param_member_contents += self.writeIndent(indent)
                 param_member_contents += '}\n'
+            param_member_contents = param_member_contents[:length_check_start] + self.guardChecks(
+                'POINTERS', param_member_contents[length_check_start:])
         first_time_handle_check = not wrote_handle_proto
+        # The checks of a structure, enum or flag member, along with any loop over its array
+        guarded_check = None
+        guarded_check_start = 0
         if param_member.is_handle:
             if param_member.pointer_count == 0:
                 param_member_contents += self.writeValidateInlineHandleValidation(command_name_variable,
@@ -1527,16 +1555,17 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 # one is either the parent of the other, or that they share a common ancestor.
                 if primary_handle_tuple is not None and not first_time_handle_check:
                     current_handle_tuple = self.getHandle(param_member.type)
-                    param_member_contents += self.writeInlineParentCheckCall(instance_info_variable,
-                                                                             primary_handle_tuple,
-                                                                             primary_handle,
-                                                                             primary_handle_desc_name,
-                                                                             current_handle_tuple,
-                                                                             param_member,
-                                                                             prefixed_param_member_name,
-                                                                             struct_command_name,
-                                                                             command_name_variable,
-                                                                             indent)
+                    parent_check = self.writeInlineParentCheckCall(instance_info_variable,
+                                                                   primary_handle_tuple,
+                                                                   primary_handle,
+                                                                   primary_handle_desc_name,
+                                                                   current_handle_tuple,
+                                                                   param_member,
+                                                                   prefixed_param_member_name,
+                                                                   struct_command_name,
+                                                                   command_name_variable,
+                                                                   indent)
+                    param_member_contents += self.guardChecks('PARENTS', parent_check)
 
                 elif not is_command:
                     primary_handle_tuple = self.getHandle(param_member.type)
@@ -1554,6 +1583,11 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                                                                                   True,
                                                                                   indent)
         elif self.isStruct(param_member.type) and not self.isStructAlwaysValid(param_member.type):
+            guarded_check = 'STRUCTS'
+            # Commands validate their structures with ValidateXrStruct, which the build points at the
+            # structure tables or at the written out structure functions, and those call each other.
+            validate_struct_func = 'ValidateXrStruct' if is_command else 'ValidateXrStructUnrolled'
+            guarded_check_start = len(param_member_contents)
             param_member_contents += loop_string
             wrote_loop = True
             # Check to see if this struct is the base of a relation group
@@ -1609,7 +1643,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         param_member_contents += 'if (nullptr != new_%s_value) {\n' % base_child_struct_name
                         indent = indent + 1
                         param_member_contents += self.writeIndent(indent)
-                        param_member_contents += 'xr_result = ValidateXrStruct(%s, %s,\n' % (
+                        param_member_contents += 'xr_result = %s(%s, %s,\n' % (validate_struct_func,
                             instance_info_variable, command_name_variable)
                         param_member_contents += self.writeIndent(indent)
                         param_member_contents += '                                                objects_info,'
@@ -1628,7 +1662,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                             param_member_contents += ' new_%s_value);\n' % base_child_struct_name
                     else:
                         param_member_contents += self.writeIndent(indent)
-                        param_member_contents += 'xr_result = ValidateXrStruct(%s, %s,\n' % (
+                        param_member_contents += 'xr_result = %s(%s, %s,\n' % (validate_struct_func,
                             instance_info_variable, command_name_variable)
                         param_member_contents += self.writeIndent(indent)
                         param_member_contents += '                                                objects_info,'
@@ -1645,33 +1679,20 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     param_member_contents += self.writeIndent(indent)
                     param_member_contents += 'if (XR_SUCCESS != xr_result) {\n'
                     indent = indent + 1
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += 'std::string error_message = "'
                     if is_command:
-                        param_member_contents += 'Command %s param %s";\n' % (
-                            struct_command_name, param_member.name)
+                        format_lines = ['std::string error_message = "Command %s param %s";' % (
+                            struct_command_name, param_member.name)]
                     else:
-                        param_member_contents += 'Structure %s member %s";\n' % (
-                            struct_command_name, param_member.name)
+                        format_lines = ['std::string error_message = "Structure %s member %s";' % (
+                            struct_command_name, param_member.name)]
                     if is_array:
-                        param_member_contents += self.writeIndent(indent)
-                        param_member_contents += 'error_message += "[";\n'
-                        param_member_contents += self.writeIndent(indent)
-                        param_member_contents += 'error_message += std::to_string(%s);\n' % loop_param_name
-                        param_member_contents += self.writeIndent(indent)
-                        param_member_contents += 'error_message += "]";\n'
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += 'error_message += " is invalid";\n'
-
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += 'CoreValidLogMessage(%s, "VUID-%s-%s-parameter",\n' % (
-                        instance_info_variable, struct_command_name, param_member.name)
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, %s,\n' % command_name_variable
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += '                    objects_info,\n'
-                    param_member_contents += self.writeIndent(indent)
-                    param_member_contents += '                    error_message);\n'
+                        format_lines += ['error_message += "[";',
+                                         'error_message += std::to_string(%s);' % loop_param_name,
+                                         'error_message += "]";']
+                    format_lines.append('error_message += " is invalid";')
+                    param_member_contents += self.writeCountedMessage(
+                        indent, instance_info_variable, '"VUID-%s-%s-parameter"' % (struct_command_name, param_member.name),
+                        command_name_variable, format_lines, 'error_message')
                     param_member_contents += self.writeIndent(indent)
                     param_member_contents += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     if is_array:
@@ -1715,7 +1736,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     param_member_contents += 'if (nullptr != %s) {\n' % prefixed_param_member_name
                     indent = indent + 1
                     param_member_contents += self.writeIndent(indent)
-                    param_member_contents += 'xr_result = ValidateXrStruct(%s, %s,\n' % (
+                    param_member_contents += 'xr_result = %s(%s, %s,\n' % (validate_struct_func,
                         instance_info_variable, command_name_variable)
                     param_member_contents += self.writeIndent(indent)
                     param_member_contents += '                                                objects_info,'
@@ -1725,7 +1746,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         param_member_contents += ' check_members,'
                     param_member_contents += ' %s);\n' % prefixed_param_member_name
                 else:
-                    param_member_contents += 'xr_result = ValidateXrStruct(%s, %s, objects_info,\n' % (
+                    param_member_contents += 'xr_result = %s(%s, %s, objects_info,\n' % (validate_struct_func,
                         instance_info_variable, command_name_variable)
                     param_member_contents += self.writeIndent(indent)
                     param_member_contents += '                                                '
@@ -1738,7 +1759,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         param_member_contents += 'check_members,'
                     param_member_contents += ' %s);\n' % prefixed_param_member_name
             else:
-                param_member_contents += 'xr_result = ValidateXrStruct(%s, %s, objects_info,\n' % (
+                param_member_contents += 'xr_result = %s(%s, %s, objects_info,\n' % (validate_struct_func,
                     instance_info_variable, command_name_variable)
                 param_member_contents += self.writeIndent(indent)
                 param_member_contents += '                                                '
@@ -1781,6 +1802,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 param_member_contents += self.writeIndent(indent)
                 param_member_contents += '// NOTE: Can\'t validate "VUID-%s-%s-parameter" output enum buffer\n' % (struct_command_name, param_member.name)
             else:
+                guarded_check = 'ENUMS'
+                guarded_check_start = len(param_member_contents)
                 if is_array:
                     param_member_contents += loop_string
                     wrote_loop = True
@@ -1793,6 +1816,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                                                                     is_command,
                                                                     indent)
         elif self.isFlagType(param_member.type):
+            guarded_check = 'FLAGS'
+            guarded_check_start = len(param_member_contents)
             param_member_contents += self.writeValidateInlineFlag(struct_command_name,
                                                                   command_name_variable,
                                                                   param_member.type,
@@ -1844,12 +1869,363 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 param_member_contents += '}\n'
                 param_member_contents += self.writeIndent(indent)
                 param_member_contents += '}\n'
+        if guarded_check:
+            param_member_contents = param_member_contents[:guarded_check_start] + self.guardChecks(
+                guarded_check, param_member_contents[guarded_check_start:])
 
         return param_member_contents
 
 
 
-    # Write the validation function for every struct we know about.
+    # Get the structures that have ValidateXrStruct overloads, in the order of their identifiers.
+    #   self            the ValidationSourceOutputGenerator object
+    def getValidatedStructs(self):
+        return [xr_struct for xr_struct in self.api_structures if xr_struct.name not in self.structs_with_no_type]
+
+    # Get the name of the identifier of a structure, used to index the structure tables.
+    #   self            the ValidationSourceOutputGenerator object
+    #   struct_name     the name of the structure
+    def makeStructId(self, struct_name):
+        return 'GEN_VALID_USAGE_STRUCT_' + re.sub('([a-z0-9])([A-Z])', r'\1_\2', struct_name).upper()
+
+    # Generate the C++ enum of structure identifiers.
+    #   self            the ValidationSourceOutputGenerator object
+    def outputStructIds(self):
+        struct_ids = '// Identifiers of the structures validated by ValidateXrStruct, which index the structure tables.\n'
+        struct_ids += 'enum GenValidUsageStruct {\n'
+        written_ids = set()
+        for xr_struct in self.getValidatedStructs():
+            struct_id = self.makeStructId(xr_struct.name)
+            assert(struct_id not in written_ids)
+            written_ids.add(struct_id)
+            struct_ids += '    %s,\n' % struct_id
+        struct_ids += '    GEN_VALID_USAGE_STRUCT_COUNT,\n'
+        struct_ids += '};\n\n'
+        return struct_ids
+
+    # Get the offset of a string in the string table of the structure tables, adding it if it is new.
+    #   self            the ValidationSourceOutputGenerator object
+    #   tables          the dict holding the structure tables being written
+    #   string          the string
+    def addStructTableString(self, tables, string):
+        offsets = tables['string_offsets']
+        if string not in offsets:
+            offsets[string] = tables['string_size']
+            tables['strings'].append(string)
+            tables['string_size'] += len(string) + 1
+            # The offsets are 16 bits.
+            assert(tables['string_size'] <= 65536)
+        return offsets[string]
+
+    # Get the index of the function that checks a handle, enum or flags type in its table of the structure
+    # tables, adding it if it is new.
+    #   self            the ValidationSourceOutputGenerator object
+    #   tables          the dict holding the structure tables being written
+    #   table_name      the name of the table: 'handles', 'enums' or 'flags'
+    #   type_name       the name of the type
+    def addStructTableType(self, tables, table_name, type_name):
+        types = tables[table_name]
+        if type_name not in types:
+            types.append(type_name)
+        return types.index(type_name)
+
+    # Generate the C++ initializer of the GenValidUsageStructMember describing the checks of a structure member,
+    # or None if nothing is checked.  These are the checks that outputParamMemberContents writes out for a
+    # structure member.
+    #   self            the ValidationSourceOutputGenerator object
+    #   xr_struct       the structure
+    #   member          the member to check
+    #   tables          the dict holding the structure tables being written
+    def makeStructMemberEntry(self, xr_struct, member, tables):
+        kind = None
+        flags = []
+        other_name = ''
+        other_offset = '0'
+        element_size = '0'
+        type_index = '0'
+        is_array = bool(member.array_count_var or member.pointer_count_var)
+        if member.array_count_var:
+            # Only fixed size arrays have a constant length, and they only hold values.
+            assert(member.is_static_array and member.pointer_count == 0)
+        if member.is_optional:
+            flags.append('GEN_VALID_USAGE_MEMBER_OPTIONAL')
+        if member.pointer_count > 0:
+            flags.append('GEN_VALID_USAGE_MEMBER_IS_POINTER')
+        if member.pointer_count_var:
+            flags.append('GEN_VALID_USAGE_MEMBER_IS_ARRAY')
+            count_member = None
+            for other_member in xr_struct.members:
+                if other_member.name == member.pointer_count_var:
+                    count_member = other_member
+            # The interpreter reads the length of an array as a uint32_t member of the same structure.
+            assert(count_member is not None and count_member.type == 'uint32_t' and count_member.pointer_count == 0)
+            other_name = count_member.name
+            other_offset = 'offsetof(%s, %s)' % (xr_struct.name, count_member.name)
+            if member.pointer_count > 1:
+                flags.append('GEN_VALID_USAGE_MEMBER_POINTER_ELEMENTS')
+                element_size = 'sizeof(void*)'
+            else:
+                element_size = 'sizeof(%s)' % member.type
+        if (is_array or member.pointer_count > 0) and not member.is_optional and not member.is_static_array:
+            flags.append('GEN_VALID_USAGE_MEMBER_CHECK_NULL')
+            kind = 'GEN_VALID_USAGE_MEMBER_POINTER'
+
+        if not member.is_static_array and member.array_length_for:
+            assert(member.pointer_count == 0)
+            kind = 'GEN_VALID_USAGE_MEMBER_COUNT'
+            other_name = member.array_length_for
+            other_offset = 'offsetof(%s, %s)' % (xr_struct.name, member.array_length_for)
+        elif member.is_handle:
+            if member.pointer_count == 0 or (is_array and member.pointer_count == 1):
+                kind = 'GEN_VALID_USAGE_MEMBER_HANDLE'
+                type_index = str(self.addStructTableType(tables, 'handles', member.type))
+        elif self.isStruct(member.type) and not self.isStructAlwaysValid(member.type):
+            assert(not member.is_static_array)
+            kind = 'GEN_VALID_USAGE_MEMBER_STRUCT'
+            type_index = self.makeStructId(member.type)
+        elif self.isEnumType(member.type):
+            if not is_array or member.is_const:
+                assert(not member.is_static_array)
+                kind = 'GEN_VALID_USAGE_MEMBER_ENUM'
+                type_index = str(self.addStructTableType(tables, 'enums', member.type))
+        elif self.isFlagType(member.type):
+            assert(not is_array)
+            kind = 'GEN_VALID_USAGE_MEMBER_FLAGS'
+            type_index = str(self.addStructTableType(tables, 'flags', member.type))
+            if self.flagHasValidValues(member.type):
+                flags.append('GEN_VALID_USAGE_MEMBER_HAS_FLAG_VALUES')
+        elif ("void" not in member.type and not member.is_null_terminated and member.pointer_count == 0 and
+              member.is_static_array and "char" in member.type):
+            kind = 'GEN_VALID_USAGE_MEMBER_STRING'
+            other_offset = member.static_array_sizes[0]
+        if kind is None:
+            return None
+        entry = '{%d, %d, %d, offsetof(%s, %s), %s, %s, %s, %s, %s}' % (
+            self.addStructTableString(tables, member.name), self.addStructTableString(tables, member.type),
+            self.addStructTableString(tables, other_name), xr_struct.name, member.name, other_offset, element_size,
+            type_index, kind, ' | '.join(flags) if flags else '0')
+        return entry
+
+    # Generate the C++ tables describing the checks of every structure, and the ValidateXrStruct overloads,
+    # which pass their structure to the interpreter of the tables in a build with XR_CORE_VALIDATION_STRUCT_TABLES,
+    # and to the written out function otherwise.
+    #   self            the ValidationSourceOutputGenerator object
+    def writeStructTables(self):
+        tables = {
+            'strings': [],
+            'string_offsets': {},
+            'string_size': 0,
+            'handles': [],
+            'enums': [],
+            'flags': [],
+        }
+        # Offset 0 is the empty string, for names that are not used.
+        self.addStructTableString(tables, '')
+        next_types = []
+        children = []
+        member_arrays = ''
+        struct_infos = ''
+        for xr_struct in self.getValidatedStructs():
+            members_name = 'nullptr'
+            members = []
+            flags = ['GEN_VALID_USAGE_STRUCT_AVAILABLE']
+            first_related = 0
+            related_count = 0
+            xr_type = 'XR_TYPE_UNKNOWN'
+            relation_group = self.getRelationGroupForBaseStruct(xr_struct.name)
+            if relation_group is not None:
+                flags.append('GEN_VALID_USAGE_STRUCT_BASE')
+                first_related = len(children)
+                for child in relation_group.child_struct_names:
+                    children.append(self.makeStructId(child))
+                related_count = len(children) - first_related
+            else:
+                setup_bail = False
+                has_enable_extension_count = False
+                has_enable_extension_names = False
+                for member in xr_struct.members:
+                    if member.no_auto_validity:
+                        continue
+                    if member.name == 'type':
+                        flags.append('GEN_VALID_USAGE_STRUCT_CHECK_TYPE')
+                        xr_type = self.genXrStructureType(xr_struct.name)
+                        continue
+                    elif member.name == 'next':
+                        assert(member.is_optional)
+                        flags.append('GEN_VALID_USAGE_STRUCT_CHECK_NEXT')
+                        first_related = len(next_types)
+                        if member.valid_extension_structs:
+                            # They must fit in GenValidUsageNextChainTypeSet.
+                            assert(len(member.valid_extension_structs) <= 64)
+                            for valid_struct in member.valid_extension_structs:
+                                next_types.append(self.genXrStructureType(valid_struct))
+                        related_count = len(next_types) - first_related
+                        continue
+                    elif member.name == 'enabledExtensionCount':
+                        has_enable_extension_count = True
+                    elif member.name == 'enabledExtensionNames':
+                        has_enable_extension_names = True
+                    else:
+                        setup_bail = True
+                    entry = self.makeStructMemberEntry(xr_struct, member, tables)
+                    if entry is not None:
+                        # Only the type and next chain are checked before check_members is looked at.
+                        assert(setup_bail)
+                        members.append(entry)
+                # We only have extensions to check if both the count and enable fields are there
+                if has_enable_extension_count and has_enable_extension_names:
+                    extension_flags = '0'
+                    if xr_struct.name != 'XrInstanceCreateInfo':
+                        extension_flags = 'GEN_VALID_USAGE_MEMBER_SYSTEM'
+                    members.append('{%d, %d, 0, offsetof(%s, enabledExtensionNames), offsetof(%s, enabledExtensionCount), '
+                                   '0, 0, GEN_VALID_USAGE_MEMBER_EXTENSIONS, %s}' % (
+                                       self.addStructTableString(tables, 'enabledExtensionNames'),
+                                       self.addStructTableString(tables, 'char'), xr_struct.name, xr_struct.name,
+                                       extension_flags))
+            if members:
+                members_name = 'g_gen_valid_usage_%s_members' % undecorate(xr_struct.name)
+                if xr_struct.protect_value:
+                    member_arrays += '#if %s\n' % xr_struct.protect_string
+                member_arrays += 'static constexpr GenValidUsageStructMember %s[] = {\n' % members_name
+                for entry in members:
+                    member_arrays += '    %s,\n' % entry
+                member_arrays += '};\n'
+                if xr_struct.protect_value:
+                    member_arrays += '#endif // %s\n' % xr_struct.protect_string
+
+            extension_id = 'GEN_VALID_USAGE_EXTENSION_COUNT'
+            extension_name = 0
+            if xr_struct.ext_name and not self.isCoreExtensionName(xr_struct.ext_name):
+                extension_id = self.makeExtensionId(xr_struct.ext_name)
+                extension_name = self.addStructTableString(tables, xr_struct.ext_name)
+            name = self.addStructTableString(tables, xr_struct.name)
+            type_name = 0
+            if xr_type != 'XR_TYPE_UNKNOWN':
+                type_name = self.addStructTableString(tables, xr_type)
+            # A structure that is not built for this platform keeps its place, but has no members and can't be a child.
+            if xr_struct.protect_value:
+                struct_infos += '#if %s\n' % xr_struct.protect_string
+            struct_infos += '    {%s, %d, %d, %s, %d, sizeof(%s), %d, %d, %s, %d, %s},\n' % (
+                members_name, name, type_name, xr_type, len(members), xr_struct.name, first_related, related_count,
+                extension_id, extension_name, ' | '.join(flags))
+            if xr_struct.protect_value:
+                struct_infos += '#else\n'
+                struct_infos += '    {nullptr, %d, %d, %s, 0, 0, %d, %d, %s, %d, %s},\n' % (
+                    name, type_name, xr_type, first_related, related_count, extension_id, extension_name,
+                    ' | '.join(flags[1:]) if len(flags) > 1 else '0')
+                struct_infos += '#endif // %s\n' % xr_struct.protect_string
+
+        struct_tables = '#if XR_CORE_VALIDATION_STRUCT_TABLES\n'
+        struct_tables += '// The tables describing the checks of every structure, which CoreValidationValidateStruct walks.\n'
+        struct_tables += 'constexpr char g_gen_valid_usage_struct_strings[] =\n'
+        for string in tables['strings']:
+            struct_tables += '    "%s\\0"\n' % string
+        struct_tables += '    ;\n\n'
+        struct_tables += self.guardChecks('NEXT_CHAINS', 'constexpr XrStructureType g_gen_valid_usage_next_types[] = {\n%s};\n' % (
+            ''.join('    %s,\n' % next_type for next_type in next_types)))
+        struct_tables += '\n'
+        struct_tables += 'constexpr GenValidUsageStruct g_gen_valid_usage_struct_children[] = {\n'
+        for child in children:
+            struct_tables += '    %s,\n' % child
+        struct_tables += '};\n\n'
+
+        struct_tables += 'template <typename Handle, ValidateXrHandleResult (*verify)(const Handle *)>\n'
+        struct_tables += 'ValidateXrHandleResult VerifyXrHandleAt(const void *handle) {\n'
+        struct_tables += '    return verify(static_cast<const Handle *>(handle));\n'
+        struct_tables += '}\n\n'
+        struct_tables += 'constexpr GenValidUsageHandleVerifier g_gen_valid_usage_handle_verifiers[] = {\n'
+        for handle_name in tables['handles']:
+            handle = self.getHandle(handle_name)
+            if handle.protect_value:
+                struct_tables += '#if %s\n' % handle.protect_string
+            struct_tables += '    VerifyXrHandleAt<%s, Verify%sHandle>,\n' % (handle_name, handle_name)
+            if handle.protect_value:
+                struct_tables += '#else\n'
+                struct_tables += '    nullptr,\n'
+                struct_tables += '#endif // %s\n' % handle.protect_string
+        struct_tables += '};\n\n'
+
+        enum_tables = 'template <typename Enum>\n'
+        enum_tables += 'bool ValidateXrEnumAt(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+        enum_tables += '                      const char *validation_name, const char *item_name,\n'
+        enum_tables += '                      const GenValidUsageXrObjectInfoList &objects_info, const void *value) {\n'
+        enum_tables += '    return ValidateXrEnum(instance_info, command_name, validation_name, item_name, objects_info,\n'
+        enum_tables += '                          *static_cast<const Enum *>(value));\n'
+        enum_tables += '}\n\n'
+        enum_tables += 'constexpr GenValidUsageEnumValidator g_gen_valid_usage_enum_validators[] = {\n'
+        for enum_name in tables['enums']:
+            enum_tuple = [enum_tuple for enum_tuple in self.api_enums if enum_tuple.name == enum_name][0]
+            if enum_tuple.protect_value:
+                enum_tables += '#if %s\n' % enum_tuple.protect_string
+            enum_tables += '    ValidateXrEnumAt<%s>,\n' % enum_name
+            if enum_tuple.protect_value:
+                enum_tables += '#else\n'
+                enum_tables += '    nullptr,\n'
+                enum_tables += '#endif // %s\n' % enum_tuple.protect_string
+        enum_tables += '};\n'
+        struct_tables += self.guardChecks('ENUMS', enum_tables)
+        struct_tables += '\n'
+
+        flags_tables = 'constexpr GenValidUsageFlagsValidator g_gen_valid_usage_flags_validators[] = {\n'
+        for flags_name in tables['flags']:
+            flag_tuple = [flag_tuple for flag_tuple in self.api_flags if flag_tuple.name == flags_name][0]
+            assert(flag_tuple.type == 'XrFlags64')
+            if flag_tuple.protect_value:
+                flags_tables += '#if %s\n' % flag_tuple.protect_string
+            flags_tables += '    ValidateXr%s,\n' % flags_name[2:]
+            if flag_tuple.protect_value:
+                flags_tables += '#else\n'
+                flags_tables += '    nullptr,\n'
+                flags_tables += '#endif // %s\n' % flag_tuple.protect_string
+        flags_tables += '};\n'
+        struct_tables += self.guardChecks('FLAGS', flags_tables)
+        struct_tables += '\n'
+
+        struct_tables += member_arrays
+        struct_tables += '\n'
+        struct_tables += 'constexpr GenValidUsageStructInfo g_gen_valid_usage_struct_infos[GEN_VALID_USAGE_STRUCT_COUNT] = {\n'
+        struct_tables += struct_infos
+        struct_tables += '};\n'
+        struct_tables += '#endif // XR_CORE_VALIDATION_STRUCT_TABLES\n\n'
+
+        struct_tables += '#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES\n'
+        struct_tables += 'template <typename Struct>\n'
+        struct_tables += 'XrResult ValidateXrStructUnrolledAt(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+        struct_tables += '                                    const GenValidUsageXrObjectInfoList &objects_info, bool check_members,\n'
+        struct_tables += '                                    const void *value) {\n'
+        struct_tables += '    return ValidateXrStructUnrolled(instance_info, command_name, objects_info, check_members,\n'
+        struct_tables += '                                    static_cast<const Struct *>(value));\n'
+        struct_tables += '}\n'
+        struct_tables += '#endif // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES\n\n'
+        struct_tables += 'template <typename Struct>\n'
+        struct_tables += 'inline XrResult ValidateXrStructAsBuilt(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+        struct_tables += '                                       const GenValidUsageXrObjectInfoList &objects_info, bool check_members,\n'
+        struct_tables += '                                       GenValidUsageStruct struct_id, const Struct *value) {\n'
+        struct_tables += '#if XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES\n'
+        struct_tables += '    return CoreValidationValidateStructWithEngine(instance_info, command_name, objects_info, check_members, struct_id,\n'
+        struct_tables += '                                                  value, ValidateXrStructUnrolledAt<Struct>);\n'
+        struct_tables += '#elif XR_CORE_VALIDATION_STRUCT_TABLES\n'
+        struct_tables += '    return CoreValidationValidateStruct(instance_info, command_name, objects_info, check_members, struct_id, value);\n'
+        struct_tables += '#else\n'
+        struct_tables += '    (void)struct_id;\n'
+        struct_tables += '    return ValidateXrStructUnrolled(instance_info, command_name, objects_info, check_members, value);\n'
+        struct_tables += '#endif // XR_CORE_VALIDATION_COMPARE_STRUCT_TABLES\n'
+        struct_tables += '}\n\n'
+        for xr_struct in self.getValidatedStructs():
+            if xr_struct.protect_value:
+                struct_tables += '#if %s\n' % xr_struct.protect_string
+            struct_tables += 'XrResult ValidateXrStruct(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+            struct_tables += '                          const GenValidUsageXrObjectInfoList& objects_info, bool check_members,\n'
+            struct_tables += '                          const %s* value) {\n' % xr_struct.name
+            struct_tables += '    return ValidateXrStructAsBuilt(instance_info, command_name, objects_info, check_members,\n'
+            struct_tables += '                                   %s, value);\n' % self.makeStructId(xr_struct.name)
+            struct_tables += '}\n\n'
+            if xr_struct.protect_value:
+                struct_tables += '#endif // %s\n' % xr_struct.protect_string
+        return self.guardChecks('STRUCTS', struct_tables)
+
+    # Write the validation function for every struct we know about, as ValidateXrStructUnrolled.  The structure
+    # tables make the same checks, so a build with them only keeps these to compare the two.
     #   self            the ValidationSourceOutputGenerator object
     def writeValidateStructFuncs(self):
         struct_check = ''
@@ -1864,9 +2240,9 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
 
             if xr_struct.protect_value:
                 struct_check += '#if %s\n' % xr_struct.protect_string
-            struct_check += 'XrResult ValidateXrStruct(GenValidUsageXrInstanceInfo *instance_info, const std::string &command_name,\n'
-            struct_check += '                          std::vector<GenValidUsageXrObjectInfo>& objects_info, bool check_members,\n'
-            struct_check += '                          const %s* value) {\n' % xr_struct.name
+            struct_check += 'XrResult ValidateXrStructUnrolled(GenValidUsageXrInstanceInfo *instance_info, const char *command_name,\n'
+            struct_check += '                                  const GenValidUsageXrObjectInfoList& objects_info, bool check_members,\n'
+            struct_check += '                                  const %s* value) {\n' % xr_struct.name
             setup_bail = False
             struct_check += '    XrResult xr_result = XR_SUCCESS;\n'
 
@@ -1898,30 +2274,29 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     struct_check += 'const %s* new_value = reinterpret_cast<const %s*>(value);\n' % (
                         child, child)
                     if child_struct.ext_name and not self.isCoreExtensionName(child_struct.ext_name):
+                        extension_check_start = len(struct_check)
                         struct_check += self.writeIndent(indent)
-                        struct_check += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, "%s")) {\n' % child_struct.ext_name
+                        struct_check += 'if (nullptr != instance_info && !ExtensionEnabled(instance_info->enabled_extensions, %s)) {\n' % self.makeExtensionId(child_struct.ext_name)
                         indent += 1
                         struct_check += self.writeIndent(indent)
-                        struct_check += 'std::string error_str = "%s being used with child struct type ";\n' % xr_struct.name
-                        struct_check += self.writeIndent(indent)
-                        struct_check += 'error_str += "\\"%s\\"";\n' % self.genXrStructureType(
-                            child)
-                        struct_check += self.writeIndent(indent)
-                        struct_check += 'error_str += " which requires extension \\"%s\\" to be enabled, but it is not enabled";\n' % child_struct.ext_name
-                        struct_check += self.writeIndent(indent)
                         struct_check += 'CoreValidLogMessage(instance_info, "VUID-%s-type-type",\n' % (
                             xr_struct.name)
                         struct_check += self.writeIndent(indent)
                         struct_check += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, command_name,\n'
                         struct_check += self.writeIndent(indent)
-                        struct_check += '                    objects_info, error_str);\n'
+                        struct_check += '                    objects_info, "%s being used with child struct type \\"%s\\" which requires "\n' % (
+                            xr_struct.name, self.genXrStructureType(child))
+                        struct_check += self.writeIndent(indent)
+                        struct_check += '                    "extension \\"%s\\" to be enabled, but it is not enabled");\n' % child_struct.ext_name
                         struct_check += self.writeIndent(indent)
                         struct_check += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                         indent -= 1
                         struct_check += self.writeIndent(indent)
                         struct_check += '}\n'
+                        struct_check = struct_check[:extension_check_start] + self.guardChecks(
+                            'EXTENSIONS', struct_check[extension_check_start:])
                     struct_check += self.writeIndent(indent)
-                    struct_check += 'return ValidateXrStruct(instance_info, command_name, objects_info, check_members, new_value);\n'
+                    struct_check += 'return ValidateXrStructUnrolled(instance_info, command_name, objects_info, check_members, new_value);\n'
                     indent -= 1
                     struct_check += self.writeIndent(indent)
                     struct_check += '}\n'
@@ -1967,8 +2342,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     struct_check += '}\n'
                     continue
                 elif member.name == 'next':
-                    struct_check += self.writeValidateStructNextCheck(
-                        xr_struct.name, 'value', member, indent)
+                    struct_check += self.guardChecks('NEXT_CHAINS', self.writeValidateStructNextCheck(
+                        xr_struct.name, 'value', member, indent))
                 elif member.name == 'enabledExtensionCount':
                     has_enable_extension_count = True
                 elif member.name == 'enabledExtensionNames':
@@ -1998,19 +2373,16 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             # We only have extensions to check if both the count and enable fields are there
             if has_enable_extension_count and has_enable_extension_names:
                 # This is create instance, so check all instance extensions
+                extension_check_start = len(struct_check)
                 struct_check += self.writeIndent(indent)
-                struct_check += 'std::vector<std::string> enabled_extension_vec;\n'
-                struct_check += self.writeIndent(indent)
-                struct_check += 'for (uint32_t extension = 0; extension < value->enabledExtensionCount; ++extension) {\n'
+                struct_check += 'GenValidUsageExtensionSet enabled_extension_set =\n'
                 struct_check += self.writeIndent(indent + 1)
-                struct_check += 'enabled_extension_vec.push_back(value->enabledExtensionNames[extension]);\n'
-                struct_check += self.writeIndent(indent)
-                struct_check += '}\n'
+                struct_check += 'GenValidUsageExtensionSetFromNames(value->enabledExtensionCount, value->enabledExtensionNames);\n'
                 if xr_struct.name == 'XrInstanceCreateInfo':
                     struct_check += self.writeIndent(indent)
                     struct_check += 'if (!ValidateInstanceExtensionDependencies(nullptr, command_name, "%s",\n' % xr_struct.name
                     struct_check += self.writeIndent(indent)
-                    struct_check += '                                           objects_info, enabled_extension_vec)) {\n'
+                    struct_check += '                                           objects_info, enabled_extension_set)) {\n'
                     struct_check += self.writeIndent(indent + 1)
                     struct_check += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     struct_check += self.writeIndent(indent)
@@ -2019,11 +2391,13 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     struct_check += self.writeIndent(indent)
                     struct_check += 'if (!ValidateSystemExtensionDependencies(instance_info, command_name, "%s",\n' % xr_struct.name
                     struct_check += self.writeIndent(indent)
-                    struct_check += '                                         objects_info, enabled_extension_vec)) {\n'
+                    struct_check += '                                         objects_info, enabled_extension_set)) {\n'
                     struct_check += self.writeIndent(indent + 1)
                     struct_check += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     struct_check += self.writeIndent(indent)
                     struct_check += '}\n'
+                struct_check = struct_check[:extension_check_start] + self.guardChecks(
+                    'EXTENSIONS', struct_check[extension_check_start:])
             struct_check += self.writeIndent(indent)
             struct_check += '// Everything checked out properly\n'
             struct_check += self.writeIndent(indent)
@@ -2032,7 +2406,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             if xr_struct.protect_value:
                 struct_check += '#endif // %s\n' % xr_struct.protect_string
         struct_check += '\n'
-        return struct_check
+        struct_check = '#if XR_CORE_VALIDATION_UNROLLED_STRUCTS\n%s#endif // XR_CORE_VALIDATION_UNROLLED_STRUCTS\n' % struct_check
+        return self.guardChecks('STRUCTS', struct_check)
 
     # Write an inline validation check for handle parents
     #   self                    the ValidationSourceOutputGenerator object
@@ -2083,36 +2458,20 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             parent_check_string += '                    %s,  MakeHandleGeneric(%s%s), %s)) {\n' % (
                 self.genXrObjectType(cur_handle_mem_param.type), pointer_deref, cur_handle_desc_name, compare_flag)
         indent = indent + 1
-        parent_check_string += self.writeIndent(indent)
-        parent_check_string += 'std::ostringstream oss_error;\n'
-        parent_check_string += self.writeIndent(indent)
-        parent_check_string += 'oss_error << "%s " << HandleToHexString(%s);\n' % (
-            first_handle_mem_param.type, first_handle_desc_name)
+        format_lines = ['std::ostringstream oss_error;',
+                        'oss_error << "%s " << HandleToHexString(%s);' % (first_handle_mem_param.type, first_handle_desc_name)]
         if first_handle_tuple.name == cur_handle_tuple.parent:
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error << " must be a parent to %s ";\n' % cur_handle_mem_param.type
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error << HandleToHexString(%s);\n' % cur_handle_desc_name
+            format_lines += ['oss_error << " must be a parent to %s ";' % cur_handle_mem_param.type,
+                             'oss_error << HandleToHexString(%s);' % cur_handle_desc_name]
         elif cur_handle_tuple.name == first_handle_tuple.parent:
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error << " must be a child of %s ";\n' % cur_handle_mem_param.type
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error << HandleToHexString(%s);\n' % cur_handle_desc_name
+            format_lines += ['oss_error << " must be a child of %s ";' % cur_handle_mem_param.type,
+                             'oss_error << HandleToHexString(%s);' % cur_handle_desc_name]
         else:
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error <<  " and %s ";\n' % cur_handle_mem_param.type
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error << HandleToHexString(%s);\n' % cur_handle_desc_name
-            parent_check_string += self.writeIndent(indent)
-            parent_check_string += 'oss_error <<  " must share a parent";\n'
-        parent_check_string += self.writeIndent(indent)
-        parent_check_string += 'CoreValidLogMessage(%s, "VUID-%s-%s",\n' % (instance_info_string,
-                                                                            vuid_name,
-                                                                            parent_id)
-        parent_check_string += self.writeIndent(indent)
-        parent_check_string += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, %s,\n' % cmd_name_param
-        parent_check_string += self.writeIndent(indent)
-        parent_check_string += '                    objects_info, oss_error.str());\n'
+            format_lines += ['oss_error <<  " and %s ";' % cur_handle_mem_param.type,
+                             'oss_error << HandleToHexString(%s);' % cur_handle_desc_name,
+                             'oss_error <<  " must share a parent";']
+        parent_check_string += self.writeCountedMessage(
+            indent, instance_info_string, '"VUID-%s-%s"' % (vuid_name, parent_id), cmd_name_param, format_lines, 'oss_error.str()')
         parent_check_string += self.writeIndent(indent)
         parent_check_string += 'return XR_ERROR_VALIDATION_FAILURE;\n'
         indent = indent - 1
@@ -2144,7 +2503,9 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         pre_validate_func += self.writeIndent(indent)
         pre_validate_func += 'XrResult xr_result = XR_SUCCESS;\n'
         pre_validate_func += self.writeIndent(indent)
-        pre_validate_func += 'std::vector<GenValidUsageXrObjectInfo> objects_info;\n'
+        pre_validate_func += 'GenValidUsageXrObjectInfoList objects_info;\n'
+        # The handle parameters are all added to objects_info, which only has room for a few.
+        assert(len([param for param in cur_command.params if param.is_handle]) <= 4)
         first_param = cur_command.params[0]
         first_param_tuple = self.getHandle(first_param.type)
         if first_param_tuple is not None:
@@ -2188,6 +2549,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         # appropriate struct setup for validation later in the function
         valid_type_list = []
         if cur_command.checks_state:
+            state_check_start = len(pre_validate_func)
             for cur_state in self.api_states:
                 if cur_command.name in cur_state.check_commands:
                     command_param_of_type = ''
@@ -2200,16 +2562,21 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         pre_validate_func += self.writeIndent(2)
                         pre_validate_func += 'auto %s_valid = g_%s_valid_states[%s];\n' % (
                             undecorate(cur_state.type), undecorate(cur_state.type), command_param_of_type)
+            pre_validate_func = pre_validate_func[:state_check_start] + self.guardChecks(
+                'STATE', pre_validate_func[state_check_start:])
 
+            extension_check_start = len(pre_validate_func)
             for additional_ext in cur_command.required_exts:
                 pre_validate_func += self.writeIndent(indent)
                 pre_validate_func += '// Check to make sure that the extension this command is in has been enabled\n'
                 pre_validate_func += self.writeIndent(indent)
-                pre_validate_func += 'if (!ExtensionEnabled(gen_instance_info->enabled_extensions, "%s")) {\n' % additional_ext
+                pre_validate_func += 'if (!ExtensionEnabled(gen_instance_info->enabled_extensions, %s)) {\n' % self.makeExtensionId(additional_ext)
                 pre_validate_func += self.writeIndent(indent + 1)
                 pre_validate_func += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                 pre_validate_func += self.writeIndent(indent)
                 pre_validate_func += '}\n'
+            pre_validate_func = pre_validate_func[:extension_check_start] + self.guardChecks(
+                'EXTENSIONS', pre_validate_func[extension_check_start:])
 
         instance_info_variable = 'gen_instance_info' if first_param_tuple else 'nullptr'
 
@@ -2238,6 +2605,7 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
 
         # If this command needs to be checked to ensure that it is executing between
         # a "begin" and an "end" command, do so.
+        state_check_start = len(pre_validate_func)
         if cur_command.checks_state:
             for cur_state in self.api_states:
                 if cur_command.name in cur_state.check_commands:
@@ -2252,30 +2620,15 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     pre_validate_func += 'if (!%s_valid->%s) {\n' % (
                         undecorate(cur_state.type), cur_state.variable)
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'std::string error_msg = "%s is required to be called between successful calls to ";\n' % cur_command.name
-                    pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'error_msg += "'
-                    cur_count = 0
-                    for begin_command in cur_state.begin_commands:
-                        if cur_count > 0:
-                            pre_validate_func += '/'
-                        cur_count += 1
-                        pre_validate_func += '%s' % begin_command
-                    pre_validate_func += ' and '
-                    cur_count = 0
-                    for end_command in cur_state.end_commands:
-                        if cur_count > 0:
-                            pre_validate_func += '/'
-                        cur_count += 1
-                        pre_validate_func += '%s' % end_command
-                    pre_validate_func += ' commands";\n'
-                    pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'CoreValidLogMessage(%s, "VUID-%s-%s-checkstate",\n' % (
                         instance_info_variable, cur_command.name, cur_state.state)
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, "%s", objects_info,\n' % cur_command.name
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += '                    error_msg);\n'
+                    pre_validate_func += '                    "%s is required to be called between successful calls to "\n' % cur_command.name
+                    pre_validate_func += self.writeIndent(3)
+                    pre_validate_func += '                    "%s and %s commands");\n' % (
+                        '/'.join(cur_state.begin_commands), '/'.join(cur_state.end_commands))
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     pre_validate_func += self.writeIndent(2)
@@ -2297,23 +2650,14 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     pre_validate_func += 'if (%s_valid->%s) {\n' % (
                         undecorate(cur_state.type), cur_state.variable)
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'std::string error_msg = "%s is called again without first successfully calling ";\n' % cur_command.name
-                    pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'error_msg += "'
-                    cur_count = 0
-                    for end_command in cur_state.end_commands:
-                        if cur_count > 0:
-                            pre_validate_func += '/'
-                        cur_count += 1
-                        pre_validate_func += '%s' % end_command
-                    pre_validate_func += '";\n'
-                    pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'CoreValidLogMessage(%s, "VUID-%s-%s-beginstate",\n' % (
                         instance_info_variable, cur_command.name, cur_state.state)
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, "%s", objects_info,\n' % cur_command.name
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += '                    error_msg);\n'
+                    pre_validate_func += '                    "%s is called again without first successfully calling "\n' % cur_command.name
+                    pre_validate_func += self.writeIndent(3)
+                    pre_validate_func += '                    "%s");\n' % '/'.join(cur_state.end_commands)
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     pre_validate_func += self.writeIndent(2)
@@ -2341,23 +2685,14 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     pre_validate_func += 'if (!%s_valid->%s) {\n' % (
                         undecorate(cur_state.type), cur_state.variable)
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'std::string error_msg = "%s is called again without first successfully calling ";\n' % cur_command.name
-                    pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += 'error_msg += "'
-                    cur_count = 0
-                    for begin_command in cur_state.begin_commands:
-                        if cur_count > 0:
-                            pre_validate_func += '/'
-                        cur_count += 1
-                        pre_validate_func += '%s' % begin_command
-                    pre_validate_func += '";\n'
-                    pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'CoreValidLogMessage(%s, "VUID-%s-%s-endstate",\n' % (
                         instance_info_variable, cur_command.name, cur_state.state)
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += '                    VALID_USAGE_DEBUG_SEVERITY_ERROR, "%s", objects_info,\n' % cur_command.name
                     pre_validate_func += self.writeIndent(3)
-                    pre_validate_func += '                    error_msg);\n'
+                    pre_validate_func += '                    "%s is called again without first successfully calling "\n' % cur_command.name
+                    pre_validate_func += self.writeIndent(3)
+                    pre_validate_func += '                    "%s");\n' % '/'.join(cur_state.begin_commands)
                     pre_validate_func += self.writeIndent(3)
                     pre_validate_func += 'return XR_ERROR_VALIDATION_FAILURE;\n'
                     pre_validate_func += self.writeIndent(2)
@@ -2368,6 +2703,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                     pre_validate_func += self.writeIndent(2)
                     pre_validate_func += '%s_valid->%s = false;\n' % (
                         undecorate(cur_state.type), cur_state.variable)
+        pre_validate_func = pre_validate_func[:state_check_start] + self.guardChecks(
+            'STATE', pre_validate_func[state_check_start:])
 
         pre_validate_func += self.writeIndent(indent)
         pre_validate_func += 'return xr_result;\n'
@@ -2459,6 +2796,10 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 next_validate_func += '            handle_info->direct_parent_type = %s;\n' % self.genXrObjectType(
                     first_param.type)
                 next_validate_func += '            handle_info->direct_parent_handle = MakeHandleGeneric(%s);\n' % first_param.name
+                if first_param.type == 'XrInstance':
+                    next_validate_func += '            handle_info->direct_parent_info = gen_instance_info;\n'
+                else:
+                    next_validate_func += '            handle_info->direct_parent_info = gen_%s_info;\n' % base_handle_name
                 next_validate_func += '            %s.insert(*%s, std::move(handle_info));\n' % (self.makeInfoName(last_handle_tuple), last_handle_name)
 
                 # If this object contains a state that needs tracking, allocate it
@@ -2511,10 +2852,15 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                         next_validate_func += self.writeIndent(3)
                         next_validate_func += '}\n'
 
+                # Destroying a handle also destroys its children, so remove those first, while the
+                # info they are owned by is still allocated.
+                if last_handle_tuple.name == 'XrInstance':
+                    next_validate_func += '            GenValidUsageCleanUpMaps(gen_instance_info);\n'
+                elif last_handle_tuple.name in self.getHandleChildren():
+                    next_validate_func += '            %s(gen_%s_info);\n' % (
+                        self.makeCleanUpChildrenName(last_handle_tuple.name), base_handle_name)
                 next_validate_func += '            %s.erase(%s);\n' % (self.makeInfoName(handle_type=last_handle_tuple), last_handle_name)
                 next_validate_func += '        }\n'
-                if 'xrDestroyInstance' in cur_command.name:
-                    next_validate_func += '        GenValidUsageCleanUpMaps(gen_instance_info);\n'
 
         # Catch any exceptions that may have occurred.  If any occurred between any of the
         # valid mutex lock/unlock statements, perform the unlock now.  Notice that a create can
@@ -2531,49 +2877,566 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         next_validate_func += '}\n\n'
         return next_validate_func
 
+    # Get the C++ statements adding the members of each structure to a CoreValidationInputHash, by the names
+    # of the structures that can be hashed.  Base structures are left out, since they are hashed as the
+    # structure their type names.
+    #   self            the ValidationSourceOutputGenerator object
+    def getHashableStructs(self):
+        if self.hashable_structs is None:
+            hashable_structs = dict((xr_struct.name, None) for xr_struct in self.api_structures
+                                    if self.getRelationGroupForBaseStruct(xr_struct.name) is None)
+            # A structure is only hashable when the structures it points to are, and has nothing to hash when
+            # the structures it holds have nothing either.
+            changed = True
+            while changed:
+                changed = False
+                for xr_struct in self.api_structures:
+                    if xr_struct.name not in hashable_structs:
+                        continue
+                    struct_body = self.writeHashStructBody(xr_struct, hashable_structs)
+                    if struct_body is None:
+                        del hashable_structs[xr_struct.name]
+                        changed = True
+                    elif struct_body != hashable_structs[xr_struct.name]:
+                        hashable_structs[xr_struct.name] = struct_body
+                        changed = True
+            self.hashable_structs = hashable_structs
+        return self.hashable_structs
+
+    # Write the C++ statements adding one struct member or command parameter to the CoreValidationInputHash
+    # "hash", or return None if it can't be hashed.
+    #   self            the ValidationSourceOutputGenerator object
+    #   mem_par         the member or parameter to hash
+    #   prefix          what to put in front of its name: "value->" for members, nothing for parameters
+    #   siblings        the other members or parameters, which hold the array counts
+    #   hashable_structs the statements hashing each structure that can be hashed, by its name
+    #   indent          the indentation of the statements
+    def writeHashMemberOrParam(self, mem_par, prefix, siblings, hashable_structs, indent):
+        name = prefix + mem_par.name
+        is_base = self.getRelationGroupForBaseStruct(mem_par.type) is not None
+        is_struct = mem_par.type in hashable_structs
+        if self.isStruct(mem_par.type) and not is_base and not is_struct:
+            return None
+        count = None
+        if mem_par.pointer_count_var:
+            count_names = mem_par.pointer_count_var.split(',')
+            count_member = [sibling for sibling in siblings if sibling.name == count_names[0]]
+            if len(count_names) != 1 or len(count_member) != 1 or count_member[0].pointer_count != 0:
+                return None
+            count = prefix + count_names[0]
+        loop_var = 'value_%s_inc' % mem_par.name.lower()
+
+        # Loop over the elements of an array, adding each one.
+        def writeLoop(add_element):
+            loop = self.writeIndent(indent)
+            loop += 'if (hash.AddPresence(%s)) {\n' % name
+            loop += self.writeIndent(indent + 1)
+            loop += 'for (uint32_t %s = 0; %s < %s; ++%s) {\n' % (loop_var, loop_var, count, loop_var)
+            loop += self.writeIndent(indent + 2)
+            loop += '%s;\n' % add_element
+            loop += self.writeIndent(indent + 1)
+            loop += '}\n'
+            loop += self.writeIndent(indent)
+            loop += '}\n'
+            return loop
+
+        element = '%s[%s]' % (name, loop_var)
+        statement = None
+        if mem_par.name == 'next':
+            statement = 'GenValidUsageHashStructOfType(hash, reinterpret_cast<const XrBaseInStructure*>(%s));\n' % name
+        elif not prefix and mem_par.is_static_array:
+            # An array parameter is a pointer, whose size can't be taken.
+            if not mem_par.is_const:
+                statement = 'hash.AddPresence(%s);\n' % name
+        elif mem_par.pointer_count == 0:
+            if ((mem_par.type in VALID_USAGE_UNCHECKED_TYPES and not mem_par.array_length_for) or
+                    (is_struct and hashable_structs[mem_par.type] == '')):
+                # Validation never looks at these values, like the times and poses that change every frame.
+                return ''
+            if mem_par.is_static_array:
+                statement = 'hash.AddBytes(%s, sizeof(%s));\n' % (name, name)
+            elif is_struct:
+                statement = 'GenValidUsageHashStruct(hash, &%s);\n' % name
+            elif not is_base:
+                statement = 'hash.Add(%s);\n' % name
+        elif not prefix and not mem_par.is_const:
+            # A call writes to its non-const parameters, so only what validation checks of them is added.
+            is_typed = is_base or (is_struct and any(member.name == 'type' for member in self.getStruct(mem_par.type).members))
+            if mem_par.pointer_count != 1 or not is_typed:
+                statement = 'hash.AddPresence(%s);\n' % name
+            elif count is None:
+                statement = 'hash.AddChainTypes(%s);\n' % name
+            elif not is_base:
+                return writeLoop('hash.AddChainTypes(&%s)' % element)
+        elif mem_par.pointer_count == 1:
+            if mem_par.type == 'char':
+                statement = ('hash.AddArray(%s, %s);\n' % (name, count)) if count else ('hash.AddString(%s);\n' % name)
+            elif is_base:
+                if count is None:
+                    statement = 'GenValidUsageHashStructOfType(hash, reinterpret_cast<const XrBaseInStructure*>(%s));\n' % name
+            elif is_struct:
+                if count is None:
+                    statement = 'GenValidUsageHashStruct(hash, %s);\n' % name
+                else:
+                    return writeLoop('GenValidUsageHashStruct(hash, &%s)' % element)
+            elif mem_par.type == 'void' or count is None:
+                # What other pointers point to is not validated.
+                statement = 'hash.Add(%s);\n' % name
+            elif mem_par.type in VALID_USAGE_UNCHECKED_TYPES:
+                statement = 'hash.AddPresence(%s);\n' % name
+            else:
+                statement = 'hash.AddArray(%s, %s);\n' % (name, count)
+        elif mem_par.pointer_count == 2 and count is not None:
+            if mem_par.type == 'char':
+                return writeLoop('hash.AddString(%s)' % element)
+            if is_base:
+                return writeLoop('GenValidUsageHashStructOfType(hash, reinterpret_cast<const XrBaseInStructure*>(%s))' % element)
+            if is_struct:
+                return writeLoop('GenValidUsageHashStruct(hash, %s)' % element)
+        if statement is None:
+            return None
+        return self.writeIndent(indent) + statement
+
+    # Write the C++ statements adding the members of a structure to a CoreValidationInputHash, or return
+    # None if it can't be hashed.
+    #   self            the ValidationSourceOutputGenerator object
+    #   xr_struct       the structure to hash
+    #   hashable_structs the statements hashing each structure that can be hashed, by its name
+    def writeHashStructBody(self, xr_struct, hashable_structs):
+        struct_body = ''
+        for member in xr_struct.members:
+            member_hash = self.writeHashMemberOrParam(member, 'value->', xr_struct.members, hashable_structs, 1)
+            if member_hash is None:
+                return None
+            struct_body += member_hash
+        return struct_body
+
+    # Generate the C++ functions adding structures to a CoreValidationInputHash, one per structure and one
+    # choosing the structure by its type.
+    #   self            the ValidationSourceOutputGenerator object
+    def writeHashStructFuncs(self):
+        hashable_structs = self.getHashableStructs()
+        hashable = [xr_struct for xr_struct in self.api_structures if xr_struct.name in hashable_structs]
+        hash_funcs = '// Functions adding the contents of structures to the hash of the inputs of a call\n'
+        hash_funcs += 'void GenValidUsageHashStructOfType(CoreValidationInputHash& hash, const XrBaseInStructure* value);\n'
+        for xr_struct in hashable:
+            if xr_struct.protect_value:
+                hash_funcs += '#if %s\n' % xr_struct.protect_string
+            hash_funcs += 'void GenValidUsageHashStruct(CoreValidationInputHash& hash, const %s* value);\n' % xr_struct.name
+            if xr_struct.protect_value:
+                hash_funcs += '#endif // %s\n' % xr_struct.protect_string
+        hash_funcs += '\n'
+
+        struct_types = []
+        for xr_struct in hashable:
+            if xr_struct.protect_value:
+                hash_funcs += '#if %s\n' % xr_struct.protect_string
+            hash_funcs += 'void GenValidUsageHashStruct(CoreValidationInputHash& hash, const %s* value) {\n' % xr_struct.name
+            hash_funcs += '    if (!hash.AddPresence(value)) {\n'
+            hash_funcs += '        return;\n'
+            hash_funcs += '    }\n'
+            hash_funcs += hashable_structs[xr_struct.name]
+            hash_funcs += '}\n'
+            if xr_struct.protect_value:
+                hash_funcs += '#endif // %s\n' % xr_struct.protect_string
+            hash_funcs += '\n'
+            # Base structures have no type value of their own.
+            type_values = [member.values for member in xr_struct.members if member.name == 'type' and member.values]
+            if type_values:
+                struct_types.append((xr_struct, type_values[0]))
+
+        hash_funcs += 'void GenValidUsageHashStructOfType(CoreValidationInputHash& hash, const XrBaseInStructure* value) {\n'
+        hash_funcs += '    if (!hash.AddPresence(value)) {\n'
+        hash_funcs += '        return;\n'
+        hash_funcs += '    }\n'
+        hash_funcs += '    switch (value->type) {\n'
+        for xr_struct, struct_type in struct_types:
+            if xr_struct.protect_value:
+                hash_funcs += '#if %s\n' % xr_struct.protect_string
+            hash_funcs += '        case %s:\n' % struct_type
+            hash_funcs += '            GenValidUsageHashStruct(hash, reinterpret_cast<const %s*>(value));\n' % xr_struct.name
+            hash_funcs += '            return;\n'
+            if xr_struct.protect_value:
+                hash_funcs += '#endif // %s\n' % xr_struct.protect_string
+        hash_funcs += '        default:\n'
+        hash_funcs += '            hash.Add(value->type);\n'
+        hash_funcs += '            GenValidUsageHashStructOfType(hash, value->next);\n'
+        hash_funcs += '            return;\n'
+        hash_funcs += '    }\n'
+        hash_funcs += '}\n\n'
+        return hash_funcs
+
+    # Generate the C++ function hashing the inputs of a command, or return None if they can't be hashed,
+    # in which case the command is never memoized.
+    #   self            the ValidationSourceOutputGenerator object
+    #   cur_command     the command generated in automatic_source_generator.py to hash the inputs of
+    def genHashInputsFunc(self, cur_command):
+        hash_inputs_func = 'uint64_t %s(' % cur_command.name.replace("xr", "GenValidUsageHashInputsXr", 1)
+        hash_inputs_func += ', '.join(param.cdecl.strip() for param in cur_command.params)
+        hash_inputs_func += ') {\n'
+        hash_inputs_func += self.writeIndent(1)
+        hash_inputs_func += 'CoreValidationInputHash hash(%s);\n' % reflectionCommandId(cur_command.name)
+        for param in cur_command.params:
+            param_hash = self.writeHashMemberOrParam(param, '', cur_command.params, self.getHashableStructs(), 1)
+            if param_hash is None:
+                return None
+            hash_inputs_func += param_hash
+        hash_inputs_func += self.writeIndent(1)
+        hash_inputs_func += 'return hash.Value();\n'
+        hash_inputs_func += '}\n\n'
+        return hash_inputs_func
+
+    # Write the C++ statements replacing what one struct member or command parameter points to by a copy in
+    # the CoreValidationArena "arena", as far as validation reads it.  This follows writeHashMemberOrParam:
+    # whatever is hashed is copied, and pointers whose targets are only checked against NULL, or not at all,
+    # are kept.  Returns None for what can't be hashed.
+    #   self            the ValidationSourceOutputGenerator object
+    #   mem_par         the member or parameter to copy
+    #   prefix          what to put in front of its name to read it: "value->" for members, nothing for parameters
+    #   dest_prefix     what to put in front of its name to write the copy: "value->" for members, which are
+    #                   copied in place, and "inputs->" for parameters
+    #   indent          the indentation of the statements
+    def writeCopyMemberOrParam(self, mem_par, prefix, dest_prefix, indent):
+        hashable_structs = self.getHashableStructs()
+        name = prefix + mem_par.name
+        dest = dest_prefix + mem_par.name
+        is_base = self.getRelationGroupForBaseStruct(mem_par.type) is not None
+        is_struct = mem_par.type in hashable_structs
+        if self.isStruct(mem_par.type) and not is_base and not is_struct:
+            return None
+        count = None
+        if mem_par.pointer_count_var:
+            if len(mem_par.pointer_count_var.split(',')) != 1:
+                return None
+            count = prefix + mem_par.pointer_count_var
+        loop_var = 'value_%s_inc' % mem_par.name.lower()
+        copy_var = '%s_copy' % mem_par.name
+
+        # Copy an array, then each of its elements.
+        def writeLoop(copy_element):
+            loop = self.writeIndent(indent)
+            loop += 'if (nullptr != %s) {\n' % name
+            loop += self.writeIndent(indent + 1)
+            loop += 'auto %s = arena.CopyArray(%s, %s);\n' % (copy_var, name, count)
+            loop += self.writeIndent(indent + 1)
+            loop += 'for (uint32_t %s = 0; %s < %s; ++%s) {\n' % (loop_var, loop_var, count, loop_var)
+            loop += self.writeIndent(indent + 2)
+            loop += '%s;\n' % (copy_element % {'copy': '%s[%s]' % (copy_var, loop_var),
+                                               'value': '%s[%s]' % (name, loop_var)})
+            loop += self.writeIndent(indent + 1)
+            loop += '}\n'
+            loop += self.writeIndent(indent + 1)
+            loop += '%s = %s;\n' % (dest, copy_var)
+            loop += self.writeIndent(indent)
+            loop += '}\n'
+            return loop
+
+        copy_of_type = 'static_cast<%s*>(GenValidUsageCopyStructOfType(arena, reinterpret_cast<const XrBaseInStructure*>(%s)))'
+        statement = None
+        if mem_par.name == 'next':
+            copy = 'GenValidUsageCopyStructOfType(arena, reinterpret_cast<const XrBaseInStructure*>(%s))' % name
+            if mem_par.type != 'void':
+                copy = 'static_cast<%s%s*>(%s)' % ('const ' if mem_par.is_const else '', mem_par.type, copy)
+            statement = '%s = %s;\n' % (dest, copy)
+        elif not prefix and mem_par.is_static_array:
+            if not mem_par.is_const:
+                return ''
+        elif mem_par.pointer_count == 0:
+            if ((mem_par.type in VALID_USAGE_UNCHECKED_TYPES and not mem_par.array_length_for) or
+                    (is_struct and hashable_structs[mem_par.type] == '')):
+                return ''
+            if mem_par.is_static_array or not is_struct:
+                # Copied with the structure or parameters holding it.
+                return '' if mem_par.is_static_array or not is_base else None
+            if not self.getCopyStructBody(mem_par.type):
+                return ''
+            statement = 'GenValidUsageCopyStructContents(arena, &%s);\n' % dest
+        elif not prefix and not mem_par.is_const:
+            # Of the structures a call writes to, validation only reads the types of their chains.
+            is_typed = is_base or (is_struct and any(member.name == 'type' for member in self.getStruct(mem_par.type).members))
+            if mem_par.pointer_count != 1 or not is_typed:
+                return ''
+            elif count is None:
+                copy = self.writeIndent(indent)
+                copy += '%s = arena.Copy(%s);\n' % (dest, name)
+                copy += self.writeIndent(indent)
+                copy += 'if (nullptr != %s) {\n' % dest
+                copy += self.writeIndent(indent + 1)
+                copy += '%s->next = arena.CopyChainTypes(%s->next);\n' % (dest, name)
+                copy += self.writeIndent(indent)
+                copy += '}\n'
+                return copy
+            elif not is_base:
+                return writeLoop('%(copy)s.next = arena.CopyChainTypes(%(value)s.next)')
+        elif mem_par.pointer_count == 1:
+            if mem_par.type == 'char':
+                if count:
+                    statement = '%s = arena.CopyArray(%s, %s);\n' % (dest, name, count)
+                else:
+                    statement = '%s = arena.CopyString(%s);\n' % (dest, name)
+            elif is_base:
+                if count is None:
+                    statement = '%s = %s;\n' % (dest, copy_of_type % (mem_par.type, name))
+            elif is_struct:
+                if count is None:
+                    statement = '%s = GenValidUsageCopyStruct(arena, %s);\n' % (dest, name)
+                elif self.getCopyStructBody(mem_par.type):
+                    return writeLoop('GenValidUsageCopyStructContents(arena, &%(copy)s)')
+                else:
+                    statement = '%s = arena.CopyArray(%s, %s);\n' % (dest, name, count)
+            elif mem_par.type == 'void' or count is None or mem_par.type in VALID_USAGE_UNCHECKED_TYPES:
+                # Only the pointer is validated, if anything.
+                return ''
+            else:
+                statement = '%s = arena.CopyArray(%s, %s);\n' % (dest, name, count)
+        elif mem_par.pointer_count == 2 and count is not None:
+            if mem_par.type == 'char':
+                return writeLoop('%(copy)s = arena.CopyString(%(value)s)')
+            if is_base:
+                return writeLoop('%%(copy)s = %s' % (copy_of_type % (mem_par.type, '%(value)s')))
+            if is_struct:
+                return writeLoop('%(copy)s = GenValidUsageCopyStruct(arena, %(value)s)')
+        if statement is None:
+            return None
+        return self.writeIndent(indent) + statement
+
+    # Get the C++ statements replacing what the members of a copied structure point to by copies, which
+    # are empty if validation reads nothing they point to.
+    #   self            the ValidationSourceOutputGenerator object
+    #   struct_name     the name of the structure, which can be hashed
+    def getCopyStructBody(self, struct_name):
+        if struct_name not in self.struct_copy_bodies:
+            struct_body = ''
+            for member in self.getStruct(struct_name).members:
+                member_copy = self.writeCopyMemberOrParam(member, 'value->', 'value->', 1)
+                assert(member_copy is not None)
+                struct_body += member_copy
+            self.struct_copy_bodies[struct_name] = struct_body
+        return self.struct_copy_bodies[struct_name]
+
+    # Generate the C++ functions copying structures to the arena of a call validated asynchronously, one per
+    # structure and one choosing the structure by its type.
+    #   self            the ValidationSourceOutputGenerator object
+    def writeCopyStructFuncs(self):
+        hashable_structs = self.getHashableStructs()
+        copyable = [xr_struct for xr_struct in self.api_structures if xr_struct.name in hashable_structs]
+        copy_funcs = '// Functions copying structures to the arena of a call validated asynchronously, as far as\n'
+        copy_funcs += '// validation reads them.  GenValidUsageCopyStructContents replaces what the members of a copied\n'
+        copy_funcs += '// structure point to by copies.\n'
+        copy_funcs += 'void* GenValidUsageCopyStructOfType(CoreValidationArena& arena, const XrBaseInStructure* value);\n'
+        for xr_struct in copyable:
+            if xr_struct.protect_value:
+                copy_funcs += '#if %s\n' % xr_struct.protect_string
+            copy_funcs += 'void GenValidUsageCopyStructContents(CoreValidationArena& arena, %s* value);\n' % xr_struct.name
+            if xr_struct.protect_value:
+                copy_funcs += '#endif // %s\n' % xr_struct.protect_string
+        copy_funcs += '\n'
+        copy_funcs += 'template <typename T>\n'
+        copy_funcs += 'T* GenValidUsageCopyStruct(CoreValidationArena& arena, const T* value) {\n'
+        copy_funcs += '    T* copy = arena.Copy(value);\n'
+        copy_funcs += '    if (nullptr != copy) {\n'
+        copy_funcs += '        GenValidUsageCopyStructContents(arena, copy);\n'
+        copy_funcs += '    }\n'
+        copy_funcs += '    return copy;\n'
+        copy_funcs += '}\n\n'
+
+        for xr_struct in copyable:
+            if xr_struct.protect_value:
+                copy_funcs += '#if %s\n' % xr_struct.protect_string
+            struct_body = self.getCopyStructBody(xr_struct.name)
+            if struct_body:
+                copy_funcs += 'void GenValidUsageCopyStructContents(CoreValidationArena& arena, %s* value) {\n' % xr_struct.name
+                copy_funcs += struct_body
+                copy_funcs += '}\n'
+            else:
+                copy_funcs += 'void GenValidUsageCopyStructContents(CoreValidationArena& /*arena*/, %s* /*value*/) {}\n' % (
+                    xr_struct.name)
+            if xr_struct.protect_value:
+                copy_funcs += '#endif // %s\n' % xr_struct.protect_string
+            copy_funcs += '\n'
+
+        copy_funcs += 'void* GenValidUsageCopyStructOfType(CoreValidationArena& arena, const XrBaseInStructure* value) {\n'
+        copy_funcs += '    if (nullptr == value) {\n'
+        copy_funcs += '        return nullptr;\n'
+        copy_funcs += '    }\n'
+        copy_funcs += '    switch (value->type) {\n'
+        for xr_struct in self.api_structures:
+            # Base structures have no type value of their own.
+            type_values = [member.values for member in xr_struct.members if member.name == 'type' and member.values]
+            if not type_values:
+                continue
+            if xr_struct.protect_value:
+                copy_funcs += '#if %s\n' % xr_struct.protect_string
+            copy_funcs += '        case %s:\n' % type_values[0]
+            if xr_struct.name in hashable_structs:
+                copy_funcs += '            return GenValidUsageCopyStruct(arena, reinterpret_cast<const %s*>(value));\n' % (
+                    xr_struct.name)
+            else:
+                copy_funcs += '            throw CoreValidationUncopyableInputs();\n'
+            if xr_struct.protect_value:
+                copy_funcs += '#endif // %s\n' % xr_struct.protect_string
+        copy_funcs += '        default: {\n'
+        copy_funcs += '            // Only the type of a structure of an unknown type is validated.\n'
+        copy_funcs += '            XrBaseInStructure* copy = arena.Copy(value);\n'
+        copy_funcs += '            copy->next = static_cast<const XrBaseInStructure*>(GenValidUsageCopyStructOfType(arena, value->next));\n'
+        copy_funcs += '            return copy;\n'
+        copy_funcs += '        }\n'
+        copy_funcs += '    }\n'
+        copy_funcs += '}\n\n'
+        return copy_funcs
+
+    # Generate the C++ functions queuing a call of a command to be validated asynchronously, or return None
+    # if its inputs can't be copied, in which case its calls are always validated as they are made.  The
+    # generated function returns false, for the call to be validated as it is made, when the structures
+    # chained to one of its calls can't be copied.
+    #   self            the ValidationSourceOutputGenerator object
+    #   cur_command     the command generated in automatic_source_generator.py to queue the calls of
+    def genQueueInputsFunc(self, cur_command):
+        if any(param.is_static_array for param in cur_command.params):
+            return None
+        # The calls of a command checking the state of a handle are given to a worker by that handle, so that
+        # they are validated in the order they were made.
+        for cur_state in self.api_states:
+            if cur_command.name in cur_state.check_commands:
+                assert(cur_command.params[0].type == cur_state.type)
+        inputs_struct = cur_command.name.replace("xr", "GenValidUsageAsyncInputsXr", 1)
+        validate_func = cur_command.name.replace("xr", "GenValidUsageValidateAsyncXr", 1)
+        copies = ''
+        for param in cur_command.params:
+            param_copy = self.writeCopyMemberOrParam(param, '', 'inputs->', 2)
+            if param_copy is None:
+                return None
+            if not param_copy:
+                param_copy = '%sinputs->%s = %s;\n' % (self.writeIndent(2), param.name, param.name)
+            copies += param_copy
+
+        queue_func = '// The inputs of a call of %s, copied to be validated asynchronously\n' % cur_command.name
+        queue_func += 'struct %s {\n' % inputs_struct
+        queue_func += '    uint64_t input_hash;\n'
+        for param in cur_command.params:
+            param_decl = param.cdecl.strip()
+            if param.pointer_count == 0 and param_decl.startswith('const '):
+                # Assigned once the structure is made.
+                param_decl = param_decl[len('const '):]
+            queue_func += '    %s;\n' % param_decl
+        queue_func += '};\n\n'
+
+        queue_func += 'void %s(const void* queued_inputs) {\n' % validate_func
+        queue_func += '    auto inputs = static_cast<const %s*>(queued_inputs);\n' % inputs_struct
+        queue_func += '    XrResult test_result = %s(%s);\n' % (
+            cur_command.name.replace("xr", "GenValidUsageInputsXr", 1),
+            ', '.join('inputs->%s' % param.name for param in cur_command.params))
+        queue_func += '    if (XR_SUCCESS == test_result && 0 != inputs->input_hash) {\n'
+        queue_func += '        CoreValidationRememberInputs(inputs->input_hash);\n'
+        queue_func += '    }\n'
+        queue_func += '}\n\n'
+
+        first_handles = [param.name for param in cur_command.params if param.is_handle and param.pointer_count == 0]
+        queue_func += 'bool %s(' % cur_command.name.replace("xr", "GenValidUsageQueueInputsXr", 1)
+        queue_func += ', '.join(param.cdecl.strip() for param in cur_command.params)
+        queue_func += ', uint64_t input_hash) {\n'
+        queue_func += '    try {\n'
+        queue_func += '        CoreValidationAsyncQueue queue(%s);\n' % (
+            'MakeHandleGeneric(%s)' % first_handles[0] if first_handles else '0')
+        queue_func += '        CoreValidationArena& arena = queue.Arena();\n'
+        queue_func += '        auto inputs = arena.Make<%s>();\n' % inputs_struct
+        queue_func += '        inputs->input_hash = input_hash;\n'
+        queue_func += copies
+        queue_func += '        queue.Queue(%s, inputs);\n' % validate_func
+        queue_func += '        return true;\n'
+        queue_func += '    } catch (...) {\n'
+        queue_func += '        return false;\n'
+        queue_func += '    }\n'
+        queue_func += '}\n\n'
+        return queue_func
+
     # Generate a top-level automatic C++ validation function which will be used until
     # a manual function is defined.
     #   self            the ValidationSourceOutputGenerator object
     #   cur_command     the command generated in automatic_source_generator.py to validate
     #   has_return      Boolean indicating that the command must return a value (usually XrResult)
-    def genAutoValidateFunc(self, cur_command, has_return):
+    #   memoized        Boolean indicating that the inputs of the command can be hashed, to be memoized
+    def genAutoValidateFunc(self, cur_command, has_return, memoized, queued):
         auto_validate_func = ''
         prototype = cur_command.cdecl.replace(" xr", " GenValidUsageXr")
         prototype = prototype.replace(";", " {")
         auto_validate_func += '%s\n' % (prototype)
+        param_names = ', '.join(param.name for param in cur_command.params)
+        command_id = reflectionCommandId(cur_command.name)
+        # Only the inputs are sampled; the next call still tracks the handles it creates and destroys.
+        handle_names = ', '.join(param.name for param in cur_command.params if param.is_handle and param.pointer_count == 0)
+        if not queued:
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += 'CoreValidationWaitForQueuedCalls();\n'
         auto_validate_func += self.writeIndent(1)
+        if memoized:
+            auto_validate_func += 'const bool memoized = CoreValidationMemoizesCommand(%s);\n' % command_id
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += 'const uint64_t input_hash = memoized ? %s(%s) : 0;\n' % (
+                cur_command.name.replace("xr", "GenValidUsageHashInputsXr", 1), param_names)
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += 'if ((!memoized || !CoreValidationInputsValidated(input_hash)) &&\n'
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += '    CoreValidationShouldValidateCommand(%s, CoreValidationCallShape(%s))) {\n' % (
+                command_id, handle_names)
+        else:
+            auto_validate_func += 'if (CoreValidationShouldValidateCommand(%s, CoreValidationCallShape(%s))) {\n' % (
+                command_id, handle_names)
+        indent = 2
+        if queued:
+            # A queued call is passed down the chain whether or not its inputs turn out to be valid.  A call
+            # that can't be queued is validated after those that were.
+            auto_validate_func += self.writeIndent(2)
+            auto_validate_func += 'if (!CoreValidationValidatesAsync() ||\n'
+            auto_validate_func += self.writeIndent(2)
+            auto_validate_func += '    !%s(%s, %s)) {\n' % (cur_command.name.replace("xr", "GenValidUsageQueueInputsXr", 1),
+                                                          param_names, 'input_hash' if memoized else '0')
+            auto_validate_func += self.writeIndent(3)
+            auto_validate_func += 'CoreValidationWaitForQueuedCalls();\n'
+            indent = 3
+        auto_validate_func += self.writeIndent(indent)
         if has_return:
             auto_validate_func += '%s test_result = ' % cur_command.return_type.text
         # Define the pre-validate call
-        auto_validate_func += '%s(' % cur_command.name.replace("xr",
-                                                               "GenValidUsageInputsXr")
-        count = 0
-        for param in cur_command.params:
-            if count > 0:
-                auto_validate_func += ', '
-            count = count + 1
-            auto_validate_func += param.name
-        auto_validate_func += ');\n'
+        auto_validate_func += '%s(%s);\n' % (cur_command.name.replace("xr", "GenValidUsageInputsXr"), param_names)
         if has_return and cur_command.return_type.text == 'XrResult':
-            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += self.writeIndent(indent)
             auto_validate_func += 'if (XR_SUCCESS != test_result) {\n'
-            auto_validate_func += self.writeIndent(2)
+            auto_validate_func += self.writeIndent(indent + 1)
             auto_validate_func += 'return test_result;\n'
-            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += self.writeIndent(indent)
+            auto_validate_func += '}\n'
+        if memoized:
+            auto_validate_func += self.writeIndent(indent)
+            auto_validate_func += 'if (memoized) {\n'
+            auto_validate_func += self.writeIndent(indent + 1)
+            auto_validate_func += 'CoreValidationRememberInputs(input_hash);\n'
+            auto_validate_func += self.writeIndent(indent)
             auto_validate_func += '}\n'
+        if queued:
+            auto_validate_func += self.writeIndent(2)
+            auto_validate_func += '}\n'
+        auto_validate_func += self.writeIndent(1)
+        auto_validate_func += '}\n'
         # Make the calldown to the next layer
         auto_validate_func += self.writeIndent(1)
+        if cur_command.name in VALID_USAGE_PERFORMANCE_TRACKED:
+            # The performance checks see the call once it returns.
+            auto_validate_func += 'XrResult result = %s(%s);\n' % (
+                cur_command.name.replace("xr", "GenValidUsageNextXr"), param_names)
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += 'if (CoreValidationTracksPerformance()) {\n'
+            auto_validate_func += self.writeIndent(2)
+            auto_validate_func += '%s(result, %s);\n' % (cur_command.name.replace("xr", "CoreValidationTrackXr", 1), param_names)
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += '}\n'
+            auto_validate_func += self.writeIndent(1)
+            auto_validate_func += 'return result;\n'
+            auto_validate_func += '}\n\n'
+            return auto_validate_func
         if has_return:
             auto_validate_func += 'return '
-        auto_validate_func += '%s(' % cur_command.name.replace("xr",
-                                                               "GenValidUsageNextXr")
-        count = 0
-        for param in cur_command.params:
-            if count > 0:
-                auto_validate_func += ', '
-            count = count + 1
-            auto_validate_func += param.name
-        auto_validate_func += ');\n'
+        auto_validate_func += '%s(%s);\n' % (cur_command.name.replace("xr", "GenValidUsageNextXr"), param_names)
         auto_validate_func += '}\n\n'
         return auto_validate_func
 
@@ -2590,60 +3453,33 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_source_funcs += self.outputInfoMapDeclarations(extern=False)
         validation_source_funcs += '\n'
         validation_source_funcs += self.outputValidationInternalProtos()
+        validation_source_funcs += self.outputCleanUpChildrenFuncs()
         validation_source_funcs += '// Function used to clean up any residual map values that point to an instance prior to that\n'
         validation_source_funcs += '// instance being deleted.\n'
         validation_source_funcs += 'void GenValidUsageCleanUpMaps(GenValidUsageXrInstanceInfo *instance_info) {\n'
+        validation_source_funcs += '    %s(instance_info);\n' % self.makeCleanUpChildrenName('XrInstance')
+        validation_source_funcs += '}\n'
+        validation_source_funcs += '\n'
+        validation_source_funcs += '// Function used to free the tables the maps replaced as they grew, once no instance is left.\n'
+        validation_source_funcs += 'void GenValidUsageReleaseRetiredMapTables() {\n'
         for handle in self.api_handles:
             if handle.protect_value:
                 validation_source_funcs += '#if %s\n' % handle.protect_string
-            if handle.name == 'XrInstance':
-                validation_source_funcs += '    EraseAllInstanceTableMapElements(instance_info);\n'
-            else:
-                validation_source_funcs += '    %s.removeHandlesForInstance(instance_info);\n' % self.makeInfoName(handle_type=handle)
+            validation_source_funcs += '    %s.releaseRetiredTables();\n' % self.makeInfoName(handle)
             if handle.protect_value:
                 validation_source_funcs += '#endif // %s\n' % handle.protect_string
         validation_source_funcs += '}\n'
         validation_source_funcs += '\n'
-        validation_source_funcs += '// Function to convert XrObjectType to string\n'
-        validation_source_funcs += 'std::string GenValidUsageXrObjectTypeToString(const XrObjectType& type) {\n'
-        validation_source_funcs += '    std::string object_string;\n'
-        count = 0
-        for object_type in self.api_object_types:
-            object_string = object_type.name.replace("XR_OBJECT_TYPE_", "").replace("_", "")
-            if object_string == "UNKNOWN":
-                if count == 0:
-                    validation_source_funcs += '    if '
-                else:
-                    validation_source_funcs += '    } else if '
-                validation_source_funcs += '(type == XR_OBJECT_TYPE_UNKNOWN) {\n'
-                validation_source_funcs += '        object_string = "Unknown XR Object";\n'
-            else:
-                for handle in self.api_handles:
-                    handle_name = handle.name[2:].upper()
-                    if handle_name != object_string:
-                        continue
-                    if object_type.protect_value:
-                        validation_source_funcs += '#if %s\n' % object_type.protect_string
-                    if count == 0:
-                        validation_source_funcs += '    if '
-                    else:
-                        validation_source_funcs += '    } else if '
-                    validation_source_funcs += '(type == %s) {\n' % object_type.name
-                    validation_source_funcs += '        object_string = "%s";\n' % handle.name
-                    if object_type.protect_value:
-                        validation_source_funcs += '#endif // %s\n' % object_type.protect_string
-            count = count + 1
-        validation_source_funcs += '    }\n'
-        validation_source_funcs += '    return object_string;\n'
-        validation_source_funcs += '}\n\n'
         validation_source_funcs += self.outputValidationStateCheckStructs()
-        validation_source_funcs += self.outputValidationSourceNextChainProtos()
         validation_source_funcs += self.outputValidationSourceFlagBitValues()
         validation_source_funcs += self.outputValidationSourceEnumValues()
         validation_source_funcs += self.writeVerifyExtensions()
         validation_source_funcs += self.writeValidateHandleChecks()
         validation_source_funcs += self.writeValidateHandleParent()
         validation_source_funcs += self.writeValidateStructFuncs()
+        validation_source_funcs += self.writeStructTables()
+        validation_source_funcs += self.writeHashStructFuncs()
+        validation_source_funcs += self.writeCopyStructFuncs()
         validation_source_funcs += self.outputValidationSourceNextChainFunc()
 
         for x in range(0, 2):
@@ -2690,8 +3526,21 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 validation_source_funcs += self.genNextValidateFunc(
                     cur_cmd, has_return, is_create, is_destroy, is_sempath_query)
                 if cur_cmd.name not in VALID_USAGE_MANUALLY_DEFINED:
+                    # Only calls returning a result are memoized, since only they tell a validation failure apart.
+                    hash_inputs_func = None
+                    if has_return and cur_cmd.return_type.text == 'XrResult':
+                        hash_inputs_func = self.genHashInputsFunc(cur_cmd)
+                    queue_inputs_func = None
+                    if hash_inputs_func is not None:
+                        validation_source_funcs += hash_inputs_func
+                        # The calls creating and destroying handles are validated as they are made, after
+                        # those queued before them.
+                        if not is_create and not is_destroy:
+                            queue_inputs_func = self.genQueueInputsFunc(cur_cmd)
+                    if queue_inputs_func is not None:
+                        validation_source_funcs += queue_inputs_func
                     validation_source_funcs += self.genAutoValidateFunc(
-                        cur_cmd, has_return)
+                        cur_cmd, has_return, hash_inputs_func is not None, queue_inputs_func is not None)
 
                 if cur_cmd.protect_value:
                     validation_source_funcs += '#endif // %s\n' % cur_cmd.protect_string
@@ -2703,14 +3552,11 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_source_funcs += '    const char*         name,\n'
         validation_source_funcs += '    PFN_xrVoidFunction* function) {\n'
         validation_source_funcs += '    try {\n'
-        validation_source_funcs += '        std::string func_name = name;\n'
-        validation_source_funcs += '        std::vector<GenValidUsageXrObjectInfo> objects;\n'
+        validation_source_funcs += '        GenValidUsageXrObjectInfoList objects;\n'
         validation_source_funcs += '        if (g_instance_info.verifyHandle(&instance) == VALIDATE_XR_HANDLE_INVALID) {\n'
         validation_source_funcs += '            // Make sure the instance is valid if it is not XR_NULL_HANDLE\n'
-        validation_source_funcs += '            std::vector<GenValidUsageXrObjectInfo> objects;\n'
-        validation_source_funcs += '            objects.resize(1);\n'
-        validation_source_funcs += '            objects[0].handle = MakeHandleGeneric(instance);\n'
-        validation_source_funcs += '            objects[0].type = XR_OBJECT_TYPE_INSTANCE;\n'
+        validation_source_funcs += '            GenValidUsageXrObjectInfoList objects;\n'
+        validation_source_funcs += '            objects.emplace_back(instance, XR_OBJECT_TYPE_INSTANCE);\n'
         validation_source_funcs += '            CoreValidLogMessage(nullptr, "VUID-xrGetInstanceProcAddr-instance-parameter",\n'
         validation_source_funcs += '                                VALID_USAGE_DEBUG_SEVERITY_ERROR, "xrGetInstanceProcAddr", objects,\n'
         validation_source_funcs += '                                "Invalid instance handle provided.");\n'
@@ -2724,7 +3570,8 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
         validation_source_funcs += '            return XR_ERROR_VALIDATION_FAILURE;\n'
         validation_source_funcs += '        }\n'
 
-        count = 0
+        validation_source_funcs += '        *function = nullptr;\n'
+        validation_source_funcs += '        switch (ReflectionCommandFromName(name)) {\n'
         for x in range(0, 2):
             if x == 0:
                 commands = self.core_commands
@@ -2734,19 +3581,15 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
             for cur_cmd in commands:
                 if cur_cmd.ext_name != cur_extension_name:
                     if 'XR_VERSION_' in cur_cmd.ext_name:
-                        validation_source_funcs += '\n        // ---- Core %s commands\n' % cur_cmd.ext_name[11:].replace(
+                        validation_source_funcs += '\n            // ---- Core %s commands\n' % cur_cmd.ext_name[11:].replace(
                             "_", ".")
                     else:
-                        validation_source_funcs += '\n        // ---- %s extension commands\n' % cur_cmd.ext_name
+                        validation_source_funcs += '\n            // ---- %s extension commands\n' % cur_cmd.ext_name
                     cur_extension_name = cur_cmd.ext_name
 
                 if cur_cmd.name in self.no_trampoline_or_terminator:
                     continue
 
-                has_return = False
-                if cur_cmd.return_type is not None:
-                    has_return = True
-
                 if cur_cmd.name in VALID_USAGE_MANUALLY_DEFINED:
                     # Remove 'xr' from proto name and use manual name
                     layer_command_name = cur_cmd.name.replace(
@@ -2759,16 +3602,14 @@ class ValidationSourceOutputGenerator(AutomaticSourceOutputGenerator):
                 if cur_cmd.protect_value:
                     validation_source_funcs += '#if %s\n' % cur_cmd.protect_string
 
-                if count == 0:
-                    validation_source_funcs += '        if (func_name == "%s") {\n' % cur_cmd.name
-                else:
-                    validation_source_funcs += '        } else if (func_name == "%s") {\n' % cur_cmd.name
-                count = count + 1
-
-                validation_source_funcs += '            *function = reinterpret_cast<PFN_xrVoidFunction>(%s);\n' % layer_command_name
+                validation_source_funcs += '            case %s:\n' % reflectionCommandId(cur_cmd.name)
+                validation_source_funcs += '                *function = reinterpret_cast<PFN_xrVoidFunction>(%s);\n' % layer_command_name
+                validation_source_funcs += '                break;\n'
                 if cur_cmd.protect_value:
                     validation_source_funcs += '#endif // %s\n' % cur_cmd.protect_string
 
+        validation_source_funcs += '            default:\n'
+        validation_source_funcs += '                break;\n'
         validation_source_funcs += '        }\n'
         validation_source_funcs += '        // If we setup the function, just return\n'
         validation_source_funcs += '        if (*function != nullptr) {\n'
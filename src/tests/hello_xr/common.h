@@ -10,6 +10,8 @@
 #include <stdarg.h>
 #include <stddef.h>
 
+#include "xr_generated_reflection.hpp"
+
 // Macro to generate stringify functions for OpenXR enumerations based data provided in openxr_reflection.h
 // clang-format off
 #define ENUM_CASE_STR(name, val) case name: return #name;
@@ -26,9 +28,14 @@ MAKE_TO_STRING_FUNC(XrReferenceSpaceType);
 MAKE_TO_STRING_FUNC(XrViewConfigurationType);
 MAKE_TO_STRING_FUNC(XrEnvironmentBlendMode);
 MAKE_TO_STRING_FUNC(XrSessionState);
-MAKE_TO_STRING_FUNC(XrResult);
 MAKE_TO_STRING_FUNC(XrFormFactor);
 
+// Results are named from the generated reflection tables, shared with the loader and API layers.
+inline const char* to_string(XrResult e) {
+    const char* name = ReflectionResultName(e);
+    return nullptr != name ? name : "Unknown XrResult";
+}
+
 inline bool EqualsIgnoreCase(const std::string& s1, const std::string& s2, const std::locale& loc = std::locale()) {
     const std::ctype<char>& ctype = std::use_facet<std::ctype<char>>(loc);
     const auto compareCharLower = [&](char c1, char c2) { return ctype.tolower(c1) == ctype.tolower(c2); };
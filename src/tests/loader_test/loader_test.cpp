@@ -20,24 +20,45 @@
 // Author: Dave Houlton <daveh@lunarg.com>
 //
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
 #include <sstream>
 #include <cstring>
+#include <thread>
 #include <vector>
 
+#include "capture_stream.h"
+#include "concurrent_handle_registry.h"
 #include "filesystem_utils.hpp"
+#include "loader_specific_api.h"
 #include "loader_test_utils.hpp"
+#include "xr_generated_reflection.hpp"
 
 #include "hex_and_handles.h"
 
 #include "xr_dependencies.h"
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
+#include <openxr/openxr_reflection.h>
 
 #ifdef XR_USE_GRAPHICS_API_D3D11
 #include "d3d11.h"
 #endif
 
+#ifndef XR_USE_PLATFORM_WIN32
+#include <time.h>
+#endif
+
 #include <type_traits>
 static_assert(sizeof(XrStructureType) == 4, "This should be a 32-bit enum");
 
@@ -72,6 +93,51 @@ void ForceLoaderUnloadRuntime() {
     }
 }
 
+// CMake writes manifests for the API layers built alongside the tests into this directory, naming each
+// layer library by its full path so the layer tests load them without a library search path.
+const char* const kBuiltApiLayerPath = "resources/api_layers";
+const char* const kApiDumpLayerName = "XR_APILAYER_LUNARG_api_dump";
+const char* const kCoreValidationLayerName = "XR_APILAYER_LUNARG_core_validation";
+
+// Point the loader at the test runtime and the built API layers, with no layer implicitly enabled.
+bool UseTestRuntimeWithBuiltLayers() {
+    std::string current_path;
+    std::string runtime_path;
+    std::string layer_path;
+    if (!FileSysUtilsGetCurrentPath(current_path) ||
+        !FileSysUtilsCombinePaths(current_path, "resources/runtimes/test_runtime.json", runtime_path) ||
+        !FileSysUtilsCombinePaths(current_path, kBuiltApiLayerPath, layer_path)) {
+        return false;
+    }
+    LoaderTestSetEnvironmentVariable("XR_RUNTIME_JSON", runtime_path);
+    LoaderTestUnsetEnvironmentVariable("XR_ENABLE_API_LAYERS");
+    LoaderTestSetEnvironmentVariable("XR_API_LAYER_PATH", layer_path);
+    return true;
+}
+
+// Whether CMake wrote a manifest for the layer, which it only does when the layer was built.
+bool BuiltApiLayerExists(const char* layer_name) {
+    const std::string prefix = "XR_APILAYER_LUNARG_";
+    std::string name = layer_name;
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+        name = name.substr(prefix.size());
+    }
+    std::string manifest_path;
+    return FileSysUtilsCombinePaths(kBuiltApiLayerPath, "XrApiLayer_" + name + ".json", manifest_path) &&
+           FileSysUtilsPathExists(manifest_path);
+}
+
+// The instance create info every layer test starts from, enabling just the one layer.
+XrInstanceCreateInfo BuiltLayerInstanceCreateInfo(const char* const* layer_name) {
+    XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+    strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+    instance_create_info.applicationInfo.applicationVersion = 688;
+    instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+    instance_create_info.enabledApiLayerCount = 1;
+    instance_create_info.enabledApiLayerNames = layer_name;
+    return instance_create_info;
+}
+
 bool DetectInstalledRuntime() {
     bool runtime_found = false;
     uint32_t ext_count = 0;
@@ -566,6 +632,20 @@ void TestEnumInstanceExtensions(uint32_t& total, uint32_t& passed, uint32_t& ski
     local_failed++;            \
     cout << "        " << cout_string << ": Failed" << endl;
 
+// Creating an instance with a layer that was built must succeed; only a layer the build left out is skipped.
+#define TEST_LAYER_INSTANCE(layer_name, create_result, cout_string)                        \
+    local_total++;                                                                         \
+    if (!BuiltApiLayerExists(layer_name)) {                                                \
+        cout << "        " << cout_string << ": Skipped" << endl;                          \
+        local_skipped++;                                                                   \
+    } else if (XR_FAILED(create_result)) {                                                 \
+        cout << "        " << cout_string << ": Failed (" << create_result << ")" << endl; \
+        local_failed++;                                                                    \
+    } else {                                                                               \
+        cout << "        " << cout_string << ": Passed" << endl;                           \
+        local_passed++;                                                                    \
+    }
+
 // Test creating and destroying an OpenXR instance through the loader.
 DEFINE_TEST(TestCreateDestroyInstance) {
     INIT_TEST(TestCreateDestroyInstance)
@@ -2092,44 +2172,3370 @@ DEFINE_TEST(TestDebugUtils) {
     TEST_REPORT(TestDebugUtils)
 }
 
-int main(int argc, char* argv[]) {
-    uint32_t total_tests = 0;
-    uint32_t total_passed = 0;
-    uint32_t total_skipped = 0;
-    uint32_t total_failed = 0;
+// Test several XrInstances alive at once, and the call throughput with 1, 4 and 16 instances each
+// driven from its own thread.  Uses the test runtime, so it does not need an installed runtime.
+DEFINE_TEST(TestMultipleInstances) {
+    INIT_TEST(TestMultipleInstances)
 
-    // Unused for now.
-    (void)argc;
-    (void)argv;
+    try {
+        std::string current_path;
+        std::string runtime_path;
+        if (!FileSysUtilsGetCurrentPath(current_path) ||
+            !FileSysUtilsCombinePaths(current_path, "resources/runtimes/test_runtime.json", runtime_path)) {
+            TEST_FAIL("Unable to set runtime path")
+            TEST_REPORT(TestMultipleInstances)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_RUNTIME_JSON", runtime_path);
+        LoaderTestUnsetEnvironmentVariable("XR_ENABLE_API_LAYERS");
+        LoaderTestUnsetEnvironmentVariable("XR_API_LAYER_PATH");
 
-#if FILTER_OUT_LOADER_ERRORS == 1
-    // Re-direct std::cerr to a string since we're intentionally causing errors and we don't
-    // want it polluting the output stream.
-    std::stringstream buffer;
-    std::streambuf* original_cerr = nullptr;
-    original_cerr = std::cerr.rdbuf(buffer.rdbuf());
-#endif
+        ForceLoaderUnloadRuntime();
 
-    cout << "Starting loader_test" << endl << "--------------------" << endl;
+        XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+        strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+        instance_create_info.applicationInfo.applicationVersion = 688;
+        instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
 
-    g_has_installed_runtime = DetectInstalledRuntime();
+        XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+        system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+        XrSystemId system_id;
+
+        XrInstance first_instance = XR_NULL_HANDLE;
+        XrInstance second_instance = XR_NULL_HANDLE;
+        uint64_t unknown_handle = 0xBAD;
+        TEST_EQUAL(xrCreateInstance(&instance_create_info, &first_instance), XR_SUCCESS, "Creating first instance")
+        const char* const anchor_extension_name = XR_MSFT_SPATIAL_ANCHOR_EXTENSION_NAME;
+        XrInstanceCreateInfo anchor_instance_create_info = instance_create_info;
+        anchor_instance_create_info.enabledExtensionCount = 1;
+        anchor_instance_create_info.enabledExtensionNames = &anchor_extension_name;
+        TEST_EQUAL(xrCreateInstance(&anchor_instance_create_info, &second_instance), XR_SUCCESS, "Creating second instance")
+        TEST_EQUAL(first_instance != second_instance, true, "Instance handles are distinct")
+        TEST_EQUAL(xrGetSystem(first_instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem on first instance")
+        TEST_EQUAL(xrGetSystem(second_instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem on second instance")
+        TEST_EQUAL(xrGetSystem(TreatIntegerAsHandle<XrInstance>(unknown_handle), &system_get_info, &system_id),
+                   XR_ERROR_HANDLE_INVALID, "xrGetSystem on an unknown instance")
+
+        // With several instances the loader looks every handle up, so one destroyed along with its
+        // parent must be unknown afterwards.
+        XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+        session_create_info.systemId = system_id;
+        XrSession session = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateSession(second_instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+        XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+        space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+        space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+        XrSpace session_space = XR_NULL_HANDLE;
+        XrSpace other_space = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &session_space), XR_SUCCESS, "Creating a space")
+        XrSwapchainCreateInfo swapchain_create_info{XR_TYPE_SWAPCHAIN_CREATE_INFO};
+        XrSwapchain swapchain = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateSwapchain(session, &swapchain_create_info, &swapchain), XR_SUCCESS, "Creating a swapchain")
+        XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+        strcpy(action_set_create_info.actionSetName, "gameplay");
+        strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+        XrActionSet action_set = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateActionSet(second_instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+        XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+        strcpy(action_create_info.actionName, "grab_object");
+        strcpy(action_create_info.localizedActionName, "Grab Object");
+        action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+        XrAction action = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+        TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+        TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+
+        TEST_EQUAL(xrCreateSession(second_instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession again")
+        TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &other_space), XR_SUCCESS, "Creating another space")
+        XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+        TEST_EQUAL(xrLocateSpace(session_space, other_space, 1, &location), XR_ERROR_HANDLE_INVALID,
+                   "A space is unknown once its session is destroyed")
+        TEST_EQUAL(xrLocateSpace(other_space, other_space, 1, &location), XR_SUCCESS, "A space of a live session")
+        TEST_EQUAL(xrDestroySwapchain(swapchain), XR_ERROR_HANDLE_INVALID,
+                   "A swapchain is unknown once its session is destroyed")
+        TEST_EQUAL(xrDestroyAction(action), XR_ERROR_HANDLE_INVALID, "An action is unknown once its action set is destroyed")
+
+        // The loader has no trampolines for the commands of XR_MSFT_spatial_anchor, but the ones from
+        // xrGetInstanceProcAddr record the handles they create, which the trampolines may be passed.
+        PFN_xrCreateSpatialAnchorMSFT create_anchor = nullptr;
+        PFN_xrCreateSpatialAnchorSpaceMSFT create_anchor_space = nullptr;
+        PFN_xrDestroySpatialAnchorMSFT destroy_anchor = nullptr;
+        TEST_EQUAL(xrGetInstanceProcAddr(second_instance, "xrCreateSpatialAnchorMSFT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&create_anchor)),
+                   XR_SUCCESS, "Getting xrCreateSpatialAnchorMSFT")
+        TEST_EQUAL(xrGetInstanceProcAddr(second_instance, "xrCreateSpatialAnchorSpaceMSFT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&create_anchor_space)),
+                   XR_SUCCESS, "Getting xrCreateSpatialAnchorSpaceMSFT")
+        TEST_EQUAL(xrGetInstanceProcAddr(second_instance, "xrDestroySpatialAnchorMSFT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&destroy_anchor)),
+                   XR_SUCCESS, "Getting xrDestroySpatialAnchorMSFT")
+        if (create_anchor != nullptr && create_anchor_space != nullptr && destroy_anchor != nullptr) {
+            XrSpatialAnchorCreateInfoMSFT anchor_create_info{XR_TYPE_SPATIAL_ANCHOR_CREATE_INFO_MSFT};
+            anchor_create_info.space = other_space;
+            anchor_create_info.pose.orientation.w = 1.0f;
+            XrSpatialAnchorMSFT anchor = XR_NULL_HANDLE;
+            TEST_EQUAL(create_anchor(session, &anchor_create_info, &anchor), XR_SUCCESS, "Creating a spatial anchor")
+            XrSpatialAnchorSpaceCreateInfoMSFT anchor_space_create_info{XR_TYPE_SPATIAL_ANCHOR_SPACE_CREATE_INFO_MSFT};
+            anchor_space_create_info.anchor = anchor;
+            anchor_space_create_info.poseInAnchorSpace.orientation.w = 1.0f;
+            XrSpace anchor_space = XR_NULL_HANDLE;
+            XrSpace session_anchor_space = XR_NULL_HANDLE;
+            TEST_EQUAL(create_anchor_space(session, &anchor_space_create_info, &anchor_space), XR_SUCCESS,
+                       "Creating a spatial anchor space")
+            TEST_EQUAL(create_anchor_space(session, &anchor_space_create_info, &session_anchor_space), XR_SUCCESS,
+                       "Creating another spatial anchor space")
+            TEST_EQUAL(xrLocateSpace(anchor_space, other_space, 1, &location), XR_SUCCESS,
+                       "Passing a space from an extension command to a trampoline")
+            TEST_EQUAL(xrDestroySpace(anchor_space), XR_SUCCESS, "Destroying a space from an extension command")
+            TEST_EQUAL(xrLocateSpace(anchor_space, other_space, 1, &location), XR_ERROR_HANDLE_INVALID,
+                       "A space from an extension command is unknown once destroyed")
+            TEST_EQUAL(destroy_anchor(anchor), XR_SUCCESS, "Destroying a spatial anchor")
+            TEST_EQUAL(destroy_anchor(anchor), XR_ERROR_HANDLE_INVALID, "A spatial anchor is unknown once destroyed")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession again")
+            TEST_EQUAL(xrLocateSpace(session_anchor_space, session_anchor_space, 1, &location), XR_ERROR_HANDLE_INVALID,
+                       "A space from an extension command is unknown once its session is destroyed")
+        } else {
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession again")
+        }
 
-    TestEnumLayers(total_tests, total_passed, total_skipped, total_failed);
-    TestEnumInstanceExtensions(total_tests, total_passed, total_skipped, total_failed);
+        TEST_EQUAL(xrDestroyInstance(first_instance), XR_SUCCESS, "Destroying first instance")
+        TEST_EQUAL(xrGetSystem(second_instance, &system_get_info, &system_id), XR_SUCCESS,
+                   "xrGetSystem on second instance after destroying the first")
+        TEST_EQUAL(xrDestroyInstance(second_instance), XR_SUCCESS, "Destroying second instance")
+
+        const uint32_t calls_per_instance = 200000;
+        for (uint32_t instance_count : {1u, 4u, 16u}) {
+            // All instances are created before any thread starts calling, and destroyed once all are done.
+            std::atomic<uint32_t> created{0};
+            std::atomic<uint32_t> finished{0};
+            std::vector<XrResult> results(instance_count, XR_SUCCESS);
+            std::vector<double> seconds(instance_count, 0.0);
+            std::vector<std::thread> threads;
+            for (uint32_t index = 0; index < instance_count; ++index) {
+                threads.emplace_back([&, index]() {
+                    XrInstance instance = XR_NULL_HANDLE;
+                    XrResult result = xrCreateInstance(&instance_create_info, &instance);
+                    created++;
+                    while (created.load() < instance_count) {
+                        std::this_thread::yield();
+                    }
 
-    if (g_has_installed_runtime) {
-        cout << "Installed XR runtime detected - doing active runtime tests" << endl;
-        cout << "----------------------------------------------------------" << endl;
-        TestCreateDestroyInstance(total_tests, total_passed, total_skipped, total_failed);
-        TestGetSystem(total_tests, total_passed, total_skipped, total_failed);
-        TestCreateDestroySession(total_tests, total_passed, total_skipped, total_failed);
-    } else {
-        cout << "No installed XR runtime detected - active runtime tests skipped(!)" << endl;
+                    XrSystemId thread_system_id;
+                    auto start = std::chrono::steady_clock::now();
+                    for (uint32_t call = 0; XR_SUCCEEDED(result) && call < calls_per_instance; ++call) {
+                        result = xrGetSystem(instance, &system_get_info, &thread_system_id);
+                    }
+                    seconds[index] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    finished++;
+                    while (finished.load() < instance_count) {
+                        std::this_thread::yield();
+                    }
+                    if (instance != XR_NULL_HANDLE) {
+                        XrResult destroy_result = xrDestroyInstance(instance);
+                        if (XR_SUCCEEDED(result)) {
+                            result = destroy_result;
+                        }
+                    }
+                    results[index] = result;
+                });
+            }
+            double slowest_seconds = 0.0;
+            bool all_succeeded = true;
+            for (uint32_t index = 0; index < instance_count; ++index) {
+                threads[index].join();
+                slowest_seconds = std::max(slowest_seconds, seconds[index]);
+                all_succeeded = all_succeeded && XR_SUCCEEDED(results[index]);
+            }
+
+            std::string count_string = std::to_string(instance_count);
+            TEST_EQUAL(all_succeeded, true, "xrGetSystem from " + count_string + " threads with an instance each")
+            if (slowest_seconds > 0.0) {
+                cout << "        Throughput with " << count_string << " instances: "
+                     << static_cast<uint64_t>(calls_per_instance * instance_count / slowest_seconds) << " calls per second" << endl;
+            }
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
     }
 
-    if (g_debug_utils_exists) {
-        TestDebugUtils(total_tests, total_passed, total_skipped, total_failed);
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestMultipleInstances)
+}
+
+// Enable extensions the loader knows from the registry, which it keeps as bits, together with ones it
+// does not, which it keeps by name, coming from the runtime, the loader itself and an API layer.
+// The test runtime reports XR_KHR_fake_ext1, XR_KHR_fake_ext2, XR_MND_headless and XR_MSFT_spatial_anchor, and the test layer
+// XR_KHR_fake_ext2 and XR_KHR_fake_ext3.
+DEFINE_TEST(TestEnabledExtensions) {
+    INIT_TEST(TestEnabledExtensions)
+
+    try {
+        std::string current_path;
+        std::string runtime_path;
+        if (!FileSysUtilsGetCurrentPath(current_path) ||
+            !FileSysUtilsCombinePaths(current_path, "resources/runtimes/test_runtime.json", runtime_path)) {
+            TEST_FAIL("Unable to set runtime path")
+            TEST_REPORT(TestEnabledExtensions)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_RUNTIME_JSON", runtime_path);
+        LoaderTestUnsetEnvironmentVariable("XR_ENABLE_API_LAYERS");
+        LoaderTestSetEnvironmentVariable("XR_API_LAYER_PATH", "resources/layers");
+
+        ForceLoaderUnloadRuntime();
+
+        const char* const test_layer_name = "XR_APILAYER_test";
+        struct ExtensionCase {
+            std::vector<const char*> extension_names;
+            bool with_test_layer;
+            XrResult expected_result;
+            const char* subtest_name;
+        };
+        const ExtensionCase extension_cases[] = {
+            {{XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME, "XR_KHR_fake_ext1"},
+             false,
+             XR_SUCCESS,
+             "Known and unknown extensions of the runtime and the loader"},
+            {{"XR_KHR_fake_ext3"}, false, XR_ERROR_EXTENSION_NOT_PRESENT, "An unknown extension nothing supports"},
+            {{XR_EXT_PERFORMANCE_SETTINGS_EXTENSION_NAME}, false, XR_ERROR_EXTENSION_NOT_PRESENT,
+             "A known extension nothing supports"},
+            {{"XR_KHR_fake_ext3", "XR_KHR_fake_ext1", XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME},
+             true,
+             XR_SUCCESS,
+             "Extensions of the API layer merged with those of the runtime"},
+        };
+        for (const ExtensionCase& extension_case : extension_cases) {
+            XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+            strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+            instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+            instance_create_info.enabledExtensionCount = static_cast<uint32_t>(extension_case.extension_names.size());
+            instance_create_info.enabledExtensionNames = extension_case.extension_names.data();
+            if (extension_case.with_test_layer) {
+                instance_create_info.enabledApiLayerCount = 1;
+                instance_create_info.enabledApiLayerNames = &test_layer_name;
+            }
+            XrInstance instance = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateInstance(&instance_create_info, &instance), extension_case.expected_result,
+                       extension_case.subtest_name)
+            if (instance != XR_NULL_HANDLE) {
+                // The loader only hands out the debug utils commands of an instance that enabled them.
+                PFN_xrVoidFunction function = nullptr;
+                TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT", &function), XR_SUCCESS,
+                           "Getting a command of an enabled extension")
+                TEST_EQUAL(function != nullptr, true, "An enabled extension is found among the others")
+                TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+            }
+        }
+
+        const char* const headless_name = XR_MND_HEADLESS_EXTENSION_NAME;
+        XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+        strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+        instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = &headless_name;
+        XrInstance instance = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateInstance(&instance_create_info, &instance), XR_SUCCESS, "Creating instance without debug utils")
+        PFN_xrVoidFunction function = nullptr;
+        xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT", &function);
+        TEST_EQUAL(function == nullptr, true, "No command of an extension that was not enabled")
+        TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestEnabledExtensions)
+}
+
+// Test the handle registry shared by the loader and the API layers, on its own.
+DEFINE_TEST(TestConcurrentHandleRegistry) {
+    INIT_TEST(TestConcurrentHandleRegistry)
+
+    try {
+        ConcurrentHandleRegistry<uint64_t, uint32_t> registry;
+        const uint64_t handle_count = 1000;
+        std::vector<uint32_t> values(handle_count);
+        int first_owner = 0;
+        int second_owner = 0;
+        for (uint64_t handle = 1; handle < handle_count; ++handle) {
+            values[handle] = static_cast<uint32_t>(handle);
+            registry.Insert(handle, &values[handle], handle % 2 == 0 ? &first_owner : &second_owner);
+        }
+        registry.Insert(0, &values[0], &first_owner);
+
+        bool all_found = true;
+        for (uint64_t handle = 1; handle < handle_count; ++handle) {
+            all_found = all_found && registry.Find(handle) == &values[handle];
+        }
+        TEST_EQUAL(all_found, true, "Finding every inserted handle")
+        TEST_EQUAL(registry.Find(0) == nullptr, true, "The null handle is never inserted")
+        TEST_EQUAL(registry.Find(handle_count) == nullptr, true, "Finding an unknown handle")
+
+        TEST_EQUAL(registry.Erase(3) == &values[3], true, "Erasing a handle returns its value")
+        TEST_EQUAL(registry.Find(3) == nullptr, true, "An erased handle is not found")
+        TEST_EQUAL(registry.Erase(3) == nullptr, true, "Erasing a handle twice")
+        registry.Insert(3, &values[3], &second_owner);
+        TEST_EQUAL(registry.Find(3) == &values[3], true, "Inserting an erased handle again")
+        TEST_EQUAL(registry.Insert(5, &values[7], &first_owner) == &values[5], true, "Inserting a handle again returns its value")
+        TEST_EQUAL(registry.Find(5) == &values[7], true, "Inserting a handle again replaces its value")
+        TEST_EQUAL(registry.EraseIfValue(5, &values[5]), false, "Erasing a handle with another value")
+        TEST_EQUAL(registry.Find(5) == &values[7], true, "A handle with another value is kept")
+        TEST_EQUAL(registry.EraseIfValue(7, &values[7]), true, "Erasing a handle with its value")
+        TEST_EQUAL(registry.Find(7) == nullptr, true, "A handle erased with its value is not found")
+        registry.Insert(7, &values[7], &second_owner);
+
+        uint64_t erased_count = 0;
+        bool erased_own = true;
+        registry.EraseOwner(&second_owner, [&](uint64_t handle, uint32_t* value) {
+            ++erased_count;
+            erased_own = erased_own && handle % 2 == 1 && handle != 5 && value == &values[handle];
+        });
+        TEST_EQUAL(erased_count, handle_count / 2 - 1, "Erasing the handles of an owner visits each of them")
+        TEST_EQUAL(erased_own, true, "Erasing the handles of an owner leaves those of other owners")
+        bool owner_erased = true;
+        for (uint64_t handle = 1; handle < handle_count; ++handle) {
+            bool first = handle % 2 == 0 || handle == 5;
+            owner_erased = owner_erased && (registry.Find(handle) != nullptr) == first;
+        }
+        TEST_EQUAL(owner_erased, true, "Only the handles of the erased owner are gone")
+        TEST_EQUAL(registry.Empty(), false, "The registry still has the handles of the other owner")
+        registry.EraseOwner(&first_owner);
+        TEST_EQUAL(registry.Empty(), true, "The registry is empty once every owner is erased")
+
+        // Readers look up handles that stay in the registry, while a writer inserts and erases others,
+        // which also makes the shards rebuild their tables.  The replaced tables are freed as the
+        // writer goes, so the memory of the registry stays bounded however long the churn lasts.
+        const XrSdkAllocationCounters& counters = XrSdkModuleAllocationCounters();
+        const uint64_t stable_count = 256;
+        for (uint64_t handle = 1; handle < stable_count; ++handle) {
+            registry.Insert(handle, &values[handle], &first_owner);
+        }
+        std::atomic<bool> writing{true};
+        std::atomic<uint32_t> wrong_lookups{0};
+        std::vector<std::thread> readers;
+        for (uint32_t reader = 0; reader < 3; ++reader) {
+            readers.emplace_back([&]() {
+                do {
+                    for (uint64_t handle = 1; handle < stable_count; ++handle) {
+                        if (registry.Find(handle) != &values[handle]) {
+                            wrong_lookups++;
+                        }
+                    }
+                } while (writing.load());
+            });
+        }
+        const uint32_t round_count = 200;
+        uint64_t first_round_bytes = 0;
+        uint64_t most_bytes = 0;
+        for (uint32_t round = 0; round < round_count; ++round) {
+            for (uint64_t handle = stable_count; handle < handle_count; ++handle) {
+                registry.Insert(handle + round * handle_count, &values[handle], &second_owner);
+            }
+            uint64_t bytes = counters.current_bytes.load();
+            if (round == 0) {
+                first_round_bytes = bytes;
+            }
+            most_bytes = std::max(most_bytes, bytes);
+            if (round % 2 == 0) {
+                registry.EraseOwner(&second_owner);
+            } else {
+                for (uint64_t handle = stable_count; handle < handle_count; ++handle) {
+                    registry.Erase(handle + round * handle_count);
+                }
+            }
+        }
+        writing = false;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        // One more round once the readers are gone, which frees every table as soon as it is replaced.
+        for (uint64_t handle = stable_count; handle < handle_count; ++handle) {
+            registry.Insert(handle + round_count * handle_count, &values[handle], &second_owner);
+        }
+        uint64_t settled_bytes = counters.current_bytes.load();
+        registry.EraseOwner(&second_owner);
+        cout << "        Registry churn: " << first_round_bytes << " bytes after the first round, at most " << most_bytes
+             << " with readers, " << settled_bytes << " without" << endl;
+        TEST_EQUAL(wrong_lookups.load(), 0u, "Lookups while other handles are inserted and erased")
+        // A replaced table that a reader still holds waits for the next write to the shard.
+        TEST_EQUAL(most_bytes <= first_round_bytes * 2, true, "Inserting and erasing handles does not grow the registry")
+        TEST_EQUAL(settled_bytes <= first_round_bytes + first_round_bytes / 4, true,
+                   "Replaced tables are freed once no reader can use them")
+        registry.ReleaseRetiredTables();
+        TEST_EQUAL(registry.Find(stable_count - 1) == &values[stable_count - 1], true, "Lookups after releasing old tables")
+
+        // Every thread looks up the same handles, which only shares cache lines that are read.  The
+        // same number of lookups per thread, so the time stays flat as long as there are cores.
+        const uint32_t lookup_rounds = 2048;
+        cout << "        Registry lookups on " << std::thread::hardware_concurrency() << " hardware threads:";
+        for (uint32_t thread_count = 1; thread_count <= 16; thread_count *= 2) {
+            std::vector<std::thread> threads;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t thread = 0; thread < thread_count; ++thread) {
+                threads.emplace_back([&]() {
+                    for (uint32_t round = 0; round < lookup_rounds; ++round) {
+                        for (uint64_t handle = 1; handle < stable_count; ++handle) {
+                            if (registry.Find(handle) != &values[handle]) {
+                                wrong_lookups++;
+                            }
+                        }
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            cout << " " << thread_count << " threads "
+                 << static_cast<uint64_t>(thread_count * lookup_rounds * (stable_count - 1) / seconds / 1e6) << "M/s";
+        }
+        cout << endl;
+        TEST_EQUAL(wrong_lookups.load(), 0u, "Lookups from many threads at once")
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Output results for this test
+    TEST_REPORT(TestConcurrentHandleRegistry)
+}
+
+// A frame with a stereo projection layer with depth, and quad and cylinder layers on top of it, for the
+// API dump tests.  The layers point at each other, so the frame is neither copied nor moved.
+struct ApiDumpTestFrame {
+    XrCompositionLayerDepthInfoKHR depth_infos[2];
+    XrCompositionLayerProjectionView views[2];
+    XrCompositionLayerProjection projection_layer{XR_TYPE_COMPOSITION_LAYER_PROJECTION};
+    XrCompositionLayerQuad quad_layer{XR_TYPE_COMPOSITION_LAYER_QUAD};
+    XrCompositionLayerCylinderKHR cylinder_layer{XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR};
+    const XrCompositionLayerBaseHeader* layers[3];
+    XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+
+    ApiDumpTestFrame() {
+        for (uint32_t eye = 0; eye < 2; ++eye) {
+            depth_infos[eye] = {XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR};
+            depth_infos[eye].subImage.imageRect = {{0, 0}, {1920, 1080}};
+            depth_infos[eye].subImage.imageArrayIndex = eye;
+            // Reversed depth with an infinite far plane.
+            depth_infos[eye].minDepth = 1.0f;
+            depth_infos[eye].nearZ = 0.05f;
+            depth_infos[eye].farZ = std::numeric_limits<float>::infinity();
+            views[eye] = {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW, &depth_infos[eye]};
+            views[eye].pose.orientation.w = 1.0f;
+            views[eye].pose.position = {eye == 0 ? -0.032f : 0.032f, 1.7f, 0.0f};
+            views[eye].fov = {-0.785398f, 0.785398f, 0.785398f, -0.785398f};
+            views[eye].subImage.imageRect = {{0, 0}, {1920, 1080}};
+            views[eye].subImage.imageArrayIndex = eye;
+        }
+        projection_layer.viewCount = 2;
+        projection_layer.views = views;
+        quad_layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+        quad_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+        quad_layer.subImage.imageRect = {{0, 0}, {512, 512}};
+        quad_layer.pose.orientation.w = 1.0f;
+        quad_layer.pose.position = {0.0f, 0.0f, -2.5f};
+        quad_layer.size = {1.5f, 1.5f};
+        cylinder_layer.layerFlags =
+            XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT | XR_COMPOSITION_LAYER_UNPREMULTIPLIED_ALPHA_BIT;
+        cylinder_layer.eyeVisibility = XR_EYE_VISIBILITY_LEFT;
+        cylinder_layer.subImage.imageRect = {{-16, 8}, {2048, 1024}};
+        cylinder_layer.pose.orientation = {0.0f, 0.258819f, 0.0f, 0.965926f};
+        cylinder_layer.pose.position = {0.5f, 1.25f, -1.0e-7f};
+        cylinder_layer.radius = 3.0e6f;
+        cylinder_layer.centralAngle = 1.0471976f;
+        cylinder_layer.aspectRatio = 16.0f / 9.0f;
+        layers[0] = reinterpret_cast<const XrCompositionLayerBaseHeader*>(&projection_layer);
+        layers[1] = reinterpret_cast<const XrCompositionLayerBaseHeader*>(&quad_layer);
+        layers[2] = reinterpret_cast<const XrCompositionLayerBaseHeader*>(&cylinder_layer);
+        frame_end_info.displayTime = 1;
+        frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+        frame_end_info.layerCount = 3;
+        frame_end_info.layers = layers;
     }
+    ApiDumpTestFrame(const ApiDumpTestFrame&) = delete;
+    ApiDumpTestFrame& operator=(const ApiDumpTestFrame&) = delete;
+};
+
+// Time the API dump layer recording xrEndFrame calls with several composition layers, which is the
+// largest command most applications call every frame.  Uses the test runtime, which accepts any frame.
+DEFINE_TEST(TestApiDumpFrameEnd) {
+    INIT_TEST(TestApiDumpFrameEnd)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestApiDumpFrameEnd)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_FILE_NAME", "api_dump_frame_end.txt");
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kApiDumpLayerName);
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kApiDumpLayerName, create_result, "Creating instance with the API dump layer")
+        if (XR_SUCCEEDED(create_result)) {
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            ApiDumpTestFrame frame;
+            XrFrameEndInfo& frame_end_info = frame.frame_end_info;
+
+            const uint32_t frame_count = 2000;
+            XrResult frame_result = XR_SUCCESS;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; XR_SUCCEEDED(frame_result) && frame < frame_count; ++frame) {
+                frame_end_info.displayTime += 11111111;
+                frame_result = xrEndFrame(session, &frame_end_info);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            TEST_EQUAL(frame_result, XR_SUCCESS, "xrEndFrame with the API dump layer")
+            cout << "        Recording xrEndFrame: " << static_cast<uint64_t>(seconds * 1e9 / frame_count) << " ns per call"
+                 << endl;
+
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestApiDumpFrameEnd)
+}
+
+// CMake copies the expected API dump output into this directory.
+const char* const kGoldenOutputPath = "resources/golden";
+
+// Whether a value in API dump output is an address: a non-null pointer, the address of a structure, or
+// a handle.  Some integers are written in hex too, but their types say they are integers.
+bool IsApiDumpAddress(const std::string& type, const std::string& value) {
+    size_t digits = value.compare(0, 2, "0x") == 0 ? 2 : 0;
+    if (digits == value.size() || value.find_first_not_of("0123456789abcdefABCDEF", digits) != std::string::npos ||
+        value.find_first_not_of('0', digits) == std::string::npos) {
+        return false;
+    }
+    return type.find('*') != std::string::npos || (digits == 2 && type.find("int") == std::string::npos);
+}
+
+// Replace the values that change from run to run in API dump text or HTML output with <address>: the
+// pointers and structure addresses, which are on the stack and the heap, and the handles, which depend
+// on how many handles the test runtime handed out before.
+std::string MaskApiDumpAddresses(const std::string& output) {
+    const std::string html_type = "<div class='type'>";
+    const std::string html_value = "<div class='val'>";
+    const std::string html_end = "</div>";
+    const std::string text_value = " = ";
+    std::string masked;
+    std::string type;
+    for (size_t start = 0; start < output.size();) {
+        size_t end = output.find('\n', start);
+        end = end == std::string::npos ? output.size() : end + 1;
+        std::string line = output.substr(start, end - start);
+        start = end;
+
+        // In HTML, the type and the value of an entry are on lines of their own, and in text, an entry is
+        // an indented line with the type, the name and the value.
+        size_t value_start = std::string::npos;
+        size_t value_end = line.find_last_not_of('\n') + 1;
+        size_t tag = line.find(html_type);
+        if (tag != std::string::npos) {
+            tag += html_type.size();
+            type = line.substr(tag, line.rfind(html_end) - tag);
+        } else if ((tag = line.find(html_value)) != std::string::npos) {
+            value_start = tag + html_value.size();
+            value_end = line.rfind(html_end);
+        } else if (line.compare(0, 4, "    ") == 0 && (tag = line.find(text_value)) != std::string::npos) {
+            type = line.substr(0, line.rfind(' ', tag - 1));
+            value_start = tag + text_value.size();
+        }
+        if (value_start != std::string::npos && value_start <= value_end &&
+            IsApiDumpAddress(type, line.substr(value_start, value_end - value_start))) {
+            line.replace(value_start, value_end - value_start, "<address>");
+        }
+        masked += line;
+    }
+    return masked;
+}
+
+// Record one xrEndFrame call of the test frame with the API dump layer, as text and as HTML, and check
+// that the output is the same as the expected output, once addresses are masked.  On a difference, the
+// masked output is written next to the test, to be compared with or copied over the expected output.
+DEFINE_TEST(TestApiDumpGoldenOutput) {
+    INIT_TEST(TestApiDumpGoldenOutput)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestApiDumpGoldenOutput)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_INCLUDE", "xrEndFrame");
+
+        const char* const export_types[2] = {"text", "html"};
+        const char* const file_names[2] = {"api_dump_golden.txt", "api_dump_golden.html"};
+        for (uint32_t format = 0; format < 2; ++format) {
+            // Text files are appended to, so start from an empty one.
+            std::remove(file_names[format]);
+            LoaderTestSetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE", export_types[format]);
+            LoaderTestSetEnvironmentVariable("XR_API_DUMP_FILE_NAME", file_names[format]);
+
+            ForceLoaderUnloadRuntime();
+
+            XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kApiDumpLayerName);
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kApiDumpLayerName, create_result, "Creating instance with the API dump layer")
+            if (XR_FAILED(create_result)) {
+                continue;
+            }
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            ApiDumpTestFrame frame;
+            TEST_EQUAL(xrEndFrame(session, &frame.frame_end_info), XR_SUCCESS, "xrEndFrame with the API dump layer")
+
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            // Destroying the last instance closes the file.
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            std::ifstream dump_file(file_names[format], std::ios::in | std::ios::binary);
+            std::string output = MaskApiDumpAddresses(
+                std::string((std::istreambuf_iterator<char>(dump_file)), std::istreambuf_iterator<char>()));
+            std::string golden_path;
+            FileSysUtilsCombinePaths(kGoldenOutputPath, file_names[format], golden_path);
+            std::ifstream golden_file(golden_path, std::ios::in | std::ios::binary);
+            std::string golden((std::istreambuf_iterator<char>(golden_file)), std::istreambuf_iterator<char>());
+            TEST_EQUAL(golden.empty(), false, "Expected output exists")
+            bool same = output == golden;
+            if (!same) {
+                std::string actual_name = std::string("actual_") + file_names[format];
+                std::ofstream actual_file(actual_name, std::ios::out | std::ios::binary | std::ios::trunc);
+                actual_file << output;
+                cout << "        Output differs from " << golden_path << ", written to " << actual_name << endl;
+            }
+            TEST_EQUAL(same, true, std::string("Recorded ") + export_types[format] + " is the expected output")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_INCLUDE");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_FILE_NAME");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestApiDumpGoldenOutput)
+}
+
+// Capture a few calls with the API dump layer in capture mode, and check the capture file has the
+// header and one record for each call, in the format openxr_replay reads.
+DEFINE_TEST(TestApiDumpCapture) {
+    INIT_TEST(TestApiDumpCapture)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestApiDumpCapture)
+            return;
+        }
+        const char* capture_file_name = "api_dump_capture.bin";
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE", "capture");
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_FILE_NAME", capture_file_name);
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kApiDumpLayerName);
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kApiDumpLayerName, create_result, "Creating instance with the API dump layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+            // Destroying the last instance closes the capture file.
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            std::ifstream capture_file(capture_file_name, std::ios::in | std::ios::binary);
+            std::string capture((std::istreambuf_iterator<char>(capture_file)), std::istreambuf_iterator<char>());
+            CaptureFileHeader file_header{};
+            TEST_EQUAL(capture.size() >= sizeof(file_header), true, "Capture file has a header")
+            if (capture.size() >= sizeof(file_header)) {
+                memcpy(&file_header, capture.data(), sizeof(file_header));
+                TEST_EQUAL(memcmp(file_header.magic, XR_CAPTURE_MAGIC, sizeof(file_header.magic)), 0, "Capture file magic")
+                TEST_EQUAL(file_header.format_version, static_cast<uint32_t>(XR_CAPTURE_FORMAT_VERSION), "Capture format version")
+                TEST_EQUAL(file_header.api_version, static_cast<uint64_t>(XR_CURRENT_API_VERSION), "Capture API version")
+
+                // xrCreateInstance, xrGetSystem and xrDestroyInstance, each complete and successful.
+                uint32_t record_count = 0;
+                bool records_valid = true;
+                size_t offset = file_header.header_size;
+                while (offset + sizeof(CaptureRecordHeader) <= capture.size()) {
+                    CaptureRecordHeader record{};
+                    memcpy(&record, capture.data() + offset, sizeof(record));
+                    if (record.size < sizeof(record) || record.size > capture.size() - offset ||
+                        record.call_index != record_count || record.result != XR_SUCCESS) {
+                        records_valid = false;
+                        break;
+                    }
+                    offset += record.size;
+                    record_count++;
+                }
+                TEST_EQUAL(records_valid && offset == capture.size(), true, "Capture records are complete")
+                TEST_EQUAL(record_count, 3U, "Capture has a record for each call")
+            }
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_FILE_NAME");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestApiDumpCapture)
+}
+
+// Record with the API dump layer while leaving out xrGetSystem and all but the first two xrEndFrame
+// calls, and check the text file only has the calls that were to be recorded.
+DEFINE_TEST(TestApiDumpFilter) {
+    INIT_TEST(TestApiDumpFilter)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestApiDumpFilter)
+            return;
+        }
+        // Text files are appended to, so start from an empty one.
+        const char* dump_file_name = "api_dump_filter.txt";
+        std::remove(dump_file_name);
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_FILE_NAME", dump_file_name);
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_EXCLUDE", "xrGetSys*");
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_SAMPLE", "xr?ndFrame=every:3, xrEndFrame=first:2");
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kApiDumpLayerName);
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kApiDumpLayerName, create_result, "Creating instance with the API dump layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            XrResult frame_result = XR_SUCCESS;
+            for (uint32_t frame = 0; XR_SUCCEEDED(frame_result) && frame < 5; ++frame) {
+                frame_end_info.displayTime = frame + 1;
+                frame_result = xrEndFrame(session, &frame_end_info);
+            }
+            TEST_EQUAL(frame_result, XR_SUCCESS, "xrEndFrame with the API dump layer")
+
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            // Destroying the last instance closes the file.
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            std::ifstream dump_file(dump_file_name);
+            uint32_t end_frame_count = 0;
+            uint32_t get_system_count = 0;
+            uint32_t create_session_count = 0;
+            std::string line;
+            while (std::getline(dump_file, line)) {
+                if (line == "XrResult xrEndFrame") {
+                    end_frame_count++;
+                } else if (line == "XrResult xrGetSystem") {
+                    get_system_count++;
+                } else if (line == "XrResult xrCreateSession") {
+                    create_session_count++;
+                }
+            }
+            TEST_EQUAL(end_frame_count, 2U, "Only the first two xrEndFrame calls are recorded")
+            TEST_EQUAL(get_system_count, 0U, "Excluded xrGetSystem is not recorded")
+            TEST_EQUAL(create_session_count, 1U, "Other calls are recorded")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_FILE_NAME");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_EXCLUDE");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_SAMPLE");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestApiDumpFilter)
+}
+
+// Record a few calls with the API dump layer in JSON lines mode, and check the file has one object for
+// each call, with its command, result and parameters.
+DEFINE_TEST(TestApiDumpJsonLines) {
+    INIT_TEST(TestApiDumpJsonLines)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestApiDumpJsonLines)
+            return;
+        }
+        // JSON lines are appended to, like text, so start from an empty file.
+        const char* dump_file_name = "api_dump_json_lines.jsonl";
+        std::remove(dump_file_name);
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE", "jsonl");
+        LoaderTestSetEnvironmentVariable("XR_API_DUMP_FILE_NAME", dump_file_name);
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kApiDumpLayerName);
+        strcpy(instance_create_info.applicationInfo.applicationName, "Loader \"Test\"");
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kApiDumpLayerName, create_result, "Creating instance with the API dump layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+            // Destroying the last instance closes the file.
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            std::ifstream dump_file(dump_file_name);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(dump_file, line)) {
+                lines.push_back(line);
+            }
+            TEST_EQUAL(lines.size(), static_cast<size_t>(3), "One line for each call")
+            if (lines.size() == 3) {
+                const char* const commands[3] = {"xrCreateInstance", "xrGetSystem", "xrDestroyInstance"};
+                for (uint32_t index = 0; index < 3; ++index) {
+                    std::string start = std::string("{\"command\":\"") + commands[index] + "\",\"thread\":";
+                    TEST_EQUAL(lines[index].compare(0, start.size(), start), 0, commands[index])
+                    TEST_EQUAL(lines[index].back(), '}', "Line is a complete object")
+                    TEST_EQUAL(lines[index].find("\"result\":\"XR_SUCCESS\",\"params\":{") != std::string::npos, true,
+                               "Line has the result and parameters")
+                }
+                TEST_EQUAL(lines[0].find("\"applicationName\":\"Loader \\\"Test\\\"\"") != std::string::npos, true,
+                           "Strings are escaped")
+                TEST_EQUAL(lines[1].find("\"formFactor\":\"XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY\"") != std::string::npos, true,
+                           "Enum values are written by name")
+                TEST_EQUAL(lines[1].find("\"systemId\":" + std::to_string(system_id) + "}") != std::string::npos, true,
+                           "Outputs are written")
+            }
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_EXPORT_TYPE");
+    LoaderTestUnsetEnvironmentVariable("XR_API_DUMP_FILE_NAME");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestApiDumpJsonLines)
+}
+
+// Time the core validation layer validating xrLocateSpace, the command most often called from several
+// threads at once, from 1 to 16 threads.  Uses the test runtime, which reports every space at the origin.
+DEFINE_TEST(TestCoreValidationLocateSpace) {
+    INIT_TEST(TestCoreValidationLocateSpace)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationLocateSpace)
+            return;
+        }
+
+        ForceLoaderUnloadRuntime();
+
+        // Without a graphics API, core validation only accepts a session from the headless extension.
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            // The same number of calls for each thread count, shared out between the threads.
+            const uint32_t call_count = 32768;
+            for (uint32_t thread_count = 1; thread_count <= 16; thread_count *= 2) {
+                std::atomic<uint32_t> failed_calls{0};
+                std::vector<std::thread> threads;
+                auto start = std::chrono::steady_clock::now();
+                for (uint32_t thread = 0; thread < thread_count; ++thread) {
+                    threads.emplace_back([&, thread] {
+                        XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+                        for (uint32_t call = 0; call < call_count / thread_count; ++call) {
+                            if (XR_FAILED(xrLocateSpace(view_space, local_space, 1 + thread + call, &location))) {
+                                failed_calls++;
+                            }
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::string subtest_name = "xrLocateSpace from " + std::to_string(thread_count) + " threads";
+                TEST_EQUAL(failed_calls.load(), 0u, subtest_name)
+                cout << "        Validating xrLocateSpace from " << thread_count << " threads on "
+                     << std::thread::hardware_concurrency()
+                     << " hardware threads: " << static_cast<uint64_t>(call_count / seconds) << " calls per second" << endl;
+            }
+
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationLocateSpace)
+}
+
+// Time destroying sessions with core validation while another session keeps many spaces alive, which
+// should not slow it down, and check that the spaces of a destroyed session are no longer valid.
+DEFINE_TEST(TestCoreValidationSessionTeardown) {
+    INIT_TEST(TestCoreValidationSessionTeardown)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationSessionTeardown)
+            return;
+        }
+
+        ForceLoaderUnloadRuntime();
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            const uint32_t session_count = 64;
+            const uint32_t spaces_per_session = 16;
+
+            // Each round creates and destroys the same sessions, with more spaces held by the long
+            // lived session the second time.
+            XrSession long_lived_session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &long_lived_session), XR_SUCCESS,
+                       "Creating long lived session")
+            uint32_t long_lived_space_count = 0;
+            XrResult round_result = XR_SUCCESS;
+            for (uint32_t held_space_count : {0u, 16384u}) {
+                for (; XR_SUCCEEDED(round_result) && long_lived_space_count < held_space_count; ++long_lived_space_count) {
+                    XrSpace space = XR_NULL_HANDLE;
+                    round_result = xrCreateReferenceSpace(long_lived_session, &space_create_info, &space);
+                }
+                std::vector<XrSession> sessions(session_count, XR_NULL_HANDLE);
+                for (XrSession& session : sessions) {
+                    if (XR_SUCCEEDED(round_result)) {
+                        round_result = xrCreateSession(instance, &session_create_info, &session);
+                    }
+                    for (uint32_t space_index = 0; XR_SUCCEEDED(round_result) && space_index < spaces_per_session; ++space_index) {
+                        XrSpace space = XR_NULL_HANDLE;
+                        round_result = xrCreateReferenceSpace(session, &space_create_info, &space);
+                    }
+                }
+                auto start = std::chrono::steady_clock::now();
+                for (XrSession session : sessions) {
+                    if (XR_SUCCEEDED(round_result)) {
+                        round_result = xrDestroySession(session);
+                    }
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::string subtest_name = "Destroying sessions with " + std::to_string(held_space_count) + " other spaces";
+                TEST_EQUAL(round_result, XR_SUCCESS, subtest_name)
+                cout << "        Destroying a session with " << spaces_per_session << " spaces, with " << held_space_count
+                     << " other spaces: " << static_cast<uint64_t>(seconds * 1e9 / session_count) << " ns" << endl;
+            }
+
+            // Destroying a session destroys its spaces.
+            XrSession session = XR_NULL_HANDLE;
+            XrSpace first_space = XR_NULL_HANDLE;
+            XrSpace second_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &first_space), XR_SUCCESS, "Creating first space")
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &second_space), XR_SUCCESS, "Creating second space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+            TEST_EQUAL(xrLocateSpace(first_space, second_space, 1, &location), XR_ERROR_HANDLE_INVALID,
+                       "Spaces of a destroyed session are invalid")
+
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationSessionTeardown)
+}
+
+// Check that core validation does not allocate while validating calls that are valid, for the commands
+// applications call most often: locating spaces and getting action states.
+DEFINE_TEST(TestCoreValidationAllocations) {
+    INIT_TEST(TestCoreValidationAllocations)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationAllocations)
+            return;
+        }
+
+        ForceLoaderUnloadRuntime();
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+            strcpy(action_create_info.actionName, "grab_object");
+            strcpy(action_create_info.localizedActionName, "Grab Object");
+            action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+            XrAction action = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+
+            // The first calls may set up state that lasts, so only count the ones after them.
+            const uint32_t call_count = 100;
+            XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+            XrActionStateGetInfo action_state_get_info{XR_TYPE_ACTION_STATE_GET_INFO};
+            action_state_get_info.action = action;
+            XrActionStateBoolean action_state{XR_TYPE_ACTION_STATE_BOOLEAN};
+            XrResult call_result = XR_SUCCESS;
+            uint64_t new_count = 0;
+            for (uint32_t round = 0; round < 2; ++round) {
+                new_count = g_global_new_count.load();
+                for (uint32_t call = 0; XR_SUCCEEDED(call_result) && call < call_count; ++call) {
+                    call_result = xrLocateSpace(view_space, local_space, 1 + call, &location);
+                }
+                new_count = g_global_new_count.load() - new_count;
+            }
+            TEST_EQUAL(call_result, XR_SUCCESS, "xrLocateSpace")
+            TEST_EQUAL(new_count, 0u, "xrLocateSpace allocations")
+            for (uint32_t round = 0; round < 2; ++round) {
+                new_count = g_global_new_count.load();
+                for (uint32_t call = 0; XR_SUCCEEDED(call_result) && call < call_count; ++call) {
+                    call_result = xrGetActionStateBoolean(session, &action_state_get_info, &action_state);
+                }
+                new_count = g_global_new_count.load() - new_count;
+            }
+            TEST_EQUAL(call_result, XR_SUCCESS, "xrGetActionStateBoolean")
+            TEST_EQUAL(new_count, 0u, "xrGetActionStateBoolean allocations")
+
+            TEST_EQUAL(xrDestroyAction(action), XR_SUCCESS, "xrDestroyAction")
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationAllocations)
+}
+
+DEFINE_TEST(TestCoreValidationNextChain) {
+    INIT_TEST(TestCoreValidationNextChain)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationNextChain)
+            return;
+        }
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            // Every structure in a chain only has to extend the structure at its start, not the one before it.
+            XrSystemHandTrackingPropertiesEXT hand_tracking_properties{XR_TYPE_SYSTEM_HAND_TRACKING_PROPERTIES_EXT};
+            XrSystemEyeGazeInteractionPropertiesEXT eye_gaze_properties{XR_TYPE_SYSTEM_EYE_GAZE_INTERACTION_PROPERTIES_EXT};
+            hand_tracking_properties.next = &eye_gaze_properties;
+            XrSystemProperties system_properties{XR_TYPE_SYSTEM_PROPERTIES};
+            system_properties.next = &hand_tracking_properties;
+            XrResult call_result = XR_SUCCESS;
+            uint64_t new_count = 0;
+            for (uint32_t round = 0; round < 2; ++round) {
+                new_count = g_global_new_count.load();
+                call_result = xrGetSystemProperties(instance, system_id, &system_properties);
+                new_count = g_global_new_count.load() - new_count;
+            }
+            TEST_EQUAL(call_result, XR_SUCCESS, "xrGetSystemProperties with a chain of two structures")
+            TEST_EQUAL(new_count, 0u, "xrGetSystemProperties allocations")
+
+            XrSystemHandTrackingPropertiesEXT duplicate_properties{XR_TYPE_SYSTEM_HAND_TRACKING_PROPERTIES_EXT};
+            eye_gaze_properties.next = &duplicate_properties;
+            TEST_EQUAL(xrGetSystemProperties(instance, system_id, &system_properties), XR_ERROR_VALIDATION_FAILURE,
+                       "xrGetSystemProperties with a duplicate structure")
+
+            XrActionSetCreateInfo unrelated_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            eye_gaze_properties.next = &unrelated_info;
+            TEST_EQUAL(xrGetSystemProperties(instance, system_id, &system_properties), XR_ERROR_VALIDATION_FAILURE,
+                       "xrGetSystemProperties with a structure that does not extend it")
+
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationNextChain)
+}
+
+DEFINE_TEST(TestCoreValidationSampling) {
+    INIT_TEST(TestCoreValidationSampling)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationSampling)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable(
+            "XR_CORE_VALIDATION_SAMPLE",
+            "@spaces=unique, xrCreateReferenceSpace=first:0, xrDestroySpace=always, xrGetActionStateBoolean=every:3");
+
+        ForceLoaderUnloadRuntime();
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        XrInstance instance = XR_NULL_HANDLE;
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            // The spaces are created without being validated, but still tracked, so destroying them is valid.
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            // Only the first call with each pair of spaces is validated.
+            XrSpaceLocation wrong_location{XR_TYPE_SPACE_VELOCITY};
+            TEST_EQUAL(xrLocateSpace(view_space, local_space, 1, &wrong_location), XR_ERROR_VALIDATION_FAILURE,
+                       "First xrLocateSpace of view in local space")
+            TEST_EQUAL(xrLocateSpace(view_space, local_space, 2, &wrong_location), XR_SUCCESS,
+                       "Second xrLocateSpace of view in local space")
+            TEST_EQUAL(xrLocateSpace(local_space, view_space, 3, &wrong_location), XR_ERROR_VALIDATION_FAILURE,
+                       "First xrLocateSpace of local in view space")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+            strcpy(action_create_info.actionName, "grab_object");
+            strcpy(action_create_info.localizedActionName, "Grab Object");
+            action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+            XrAction action = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+
+            // Calls 0 and 3 are validated.
+            XrActionStateGetInfo action_state_get_info{XR_TYPE_ACTION_STATE_GET_INFO};
+            action_state_get_info.action = action;
+            XrActionStateBoolean wrong_action_state{XR_TYPE_ACTION_STATE_FLOAT};
+            uint32_t failed_calls = 0;
+            for (uint32_t call = 0; call < 6; ++call) {
+                if (xrGetActionStateBoolean(session, &action_state_get_info, &wrong_action_state) == XR_ERROR_VALIDATION_FAILURE) {
+                    failed_calls |= 1 << call;
+                }
+            }
+            TEST_EQUAL(failed_calls, 0x9u, "Validated calls of xrGetActionStateBoolean")
+
+            TEST_EQUAL(xrDestroyAction(action), XR_SUCCESS, "xrDestroyAction")
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_ERROR_HANDLE_INVALID, "Destroying view space again")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_SAMPLE");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationSampling)
+}
+
+// Time a frame loop like that of hello_xr with core validation, validating every call and then
+// memoizing the frame loop, and check that memoized inputs are still validated again once they
+// change or a handle they use is destroyed.
+DEFINE_TEST(TestCoreValidationMemoization) {
+    INIT_TEST(TestCoreValidationMemoization)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationMemoization)
+            return;
+        }
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        const char* const memoized_commands[2] = {"", "@frame,@spaces,@actions,xrSyncActions"};
+        for (const char* memoized : memoized_commands) {
+            const bool memoizing = memoized[0] != '\0';
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_MEMOIZE", memoized);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrSwapchainCreateInfo swapchain_create_info{XR_TYPE_SWAPCHAIN_CREATE_INFO};
+            swapchain_create_info.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+            swapchain_create_info.sampleCount = 1;
+            swapchain_create_info.width = 1;
+            swapchain_create_info.height = 1;
+            swapchain_create_info.faceCount = 1;
+            swapchain_create_info.arraySize = 1;
+            swapchain_create_info.mipCount = 1;
+            XrSwapchain swapchain = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSwapchain(session, &swapchain_create_info, &swapchain), XR_SUCCESS, "xrCreateSwapchain")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+            strcpy(action_create_info.actionName, "grab_object");
+            strcpy(action_create_info.localizedActionName, "Grab Object");
+            action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+            XrAction action = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+
+            // The inputs of each frame, which only differ from the last frame by the display time.
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            XrActiveActionSet active_action_set{action_set, XR_NULL_PATH};
+            XrActionsSyncInfo actions_sync_info{XR_TYPE_ACTIONS_SYNC_INFO};
+            actions_sync_info.countActiveActionSets = 1;
+            actions_sync_info.activeActionSets = &active_action_set;
+            XrActionStateGetInfo action_state_get_info{XR_TYPE_ACTION_STATE_GET_INFO};
+            action_state_get_info.action = action;
+            XrActionStateBoolean action_state{XR_TYPE_ACTION_STATE_BOOLEAN};
+            XrViewLocateInfo view_locate_info{XR_TYPE_VIEW_LOCATE_INFO};
+            view_locate_info.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+            view_locate_info.space = local_space;
+            XrViewState view_state{XR_TYPE_VIEW_STATE};
+            XrView views[2] = {{XR_TYPE_VIEW}, {XR_TYPE_VIEW}};
+            uint32_t view_count = 0;
+            XrSpaceLocation view_location{XR_TYPE_SPACE_LOCATION};
+            XrCompositionLayerProjectionView projection_views[2] = {{XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW},
+                                                                    {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW}};
+            for (uint32_t view = 0; view < 2; ++view) {
+                projection_views[view].subImage.swapchain = swapchain;
+                projection_views[view].subImage.imageRect.extent = {1, 1};
+            }
+            XrCompositionLayerProjection projection_layer{XR_TYPE_COMPOSITION_LAYER_PROJECTION};
+            projection_layer.space = local_space;
+            projection_layer.viewCount = 2;
+            projection_layer.views = projection_views;
+            XrCompositionLayerQuad quad_layer{XR_TYPE_COMPOSITION_LAYER_QUAD};
+            quad_layer.space = view_space;
+            quad_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+            quad_layer.subImage.swapchain = swapchain;
+            quad_layer.subImage.imageRect.extent = {1, 1};
+            quad_layer.pose.orientation.w = 1.0f;
+            quad_layer.size = {1.0f, 1.0f};
+            const XrCompositionLayerBaseHeader* const layers[2] = {
+                reinterpret_cast<const XrCompositionLayerBaseHeader*>(&projection_layer),
+                reinterpret_cast<const XrCompositionLayerBaseHeader*>(&quad_layer)};
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            frame_end_info.layerCount = 2;
+            frame_end_info.layers = layers;
+
+            const uint32_t frame_count = 20000;
+            uint32_t failed_frames = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info)) ||
+                              XR_FAILED(xrSyncActions(session, &actions_sync_info)) ||
+                              XR_FAILED(xrGetActionStateBoolean(session, &action_state_get_info, &action_state));
+                view_locate_info.displayTime = frame_state.predictedDisplayTime;
+                failed = failed || XR_FAILED(xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views)) ||
+                         XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &view_location));
+                for (uint32_t view = 0; view < 2; ++view) {
+                    projection_views[view].pose = views[view].pose;
+                    projection_views[view].fov = views[view].fov;
+                }
+                quad_layer.pose = view_location.pose;
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::string subtest_name = memoizing ? "Frames with memoized validation" : "Frames with validation";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            cout << "        Frame loop with " << (memoizing ? "memoized validation: " : "validation: ")
+                 << static_cast<uint64_t>(frame_count / seconds) << " frames per second" << endl;
+
+            if (memoizing) {
+                // Changed inputs are validated again, and invalid ones are never remembered.
+                quad_layer.eyeVisibility = static_cast<XrEyeVisibility>(7);
+                TEST_EQUAL(xrEndFrame(session, &frame_end_info), XR_ERROR_VALIDATION_FAILURE, "xrEndFrame with changed layer")
+                TEST_EQUAL(xrEndFrame(session, &frame_end_info), XR_ERROR_VALIDATION_FAILURE, "xrEndFrame with changed layer again")
+                quad_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+                TEST_EQUAL(xrEndFrame(session, &frame_end_info), XR_SUCCESS, "xrEndFrame with layer restored")
+
+                // Destroying the swapchain the layers use makes the same inputs invalid.
+                TEST_EQUAL(xrDestroySwapchain(swapchain), XR_SUCCESS, "xrDestroySwapchain")
+                swapchain = XR_NULL_HANDLE;
+                TEST_EQUAL(xrEndFrame(session, &frame_end_info), XR_ERROR_VALIDATION_FAILURE,
+                           "xrEndFrame with destroyed swapchain")
+            }
+
+            TEST_EQUAL(xrDestroyAction(action), XR_SUCCESS, "xrDestroyAction")
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            if (swapchain != XR_NULL_HANDLE) {
+                TEST_EQUAL(xrDestroySwapchain(swapchain), XR_SUCCESS, "xrDestroySwapchain")
+            }
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_MEMOIZE");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationMemoization)
+}
+
+// Make the same mistake in many calls with core validation, with and without a limit on repeated
+// messages, and check that only the allowed messages and the summaries of the others are written.
+DEFINE_TEST(TestCoreValidationMessageLimit) {
+    INIT_TEST(TestCoreValidationMessageLimit)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationMessageLimit)
+            return;
+        }
+        const char* message_file_name = "core_validation_messages.txt";
+        LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_EXPORT_TYPE", "text");
+        LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_FILE_NAME", message_file_name);
+        LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_MESSAGE_SUMMARY", "100");
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        const char* const message_limits[2] = {"", "2"};
+        for (const char* message_limit : message_limits) {
+            const bool limited = message_limit[0] != '\0';
+            // Text files are appended to, so start from an empty one.
+            std::remove(message_file_name);
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_MESSAGE_LIMIT", message_limit);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            // The same wrong structure every frame, for two pairs of spaces, which are told apart.
+            const uint32_t call_count = 2000;
+            XrSpaceLocation wrong_location{XR_TYPE_SPACE_VELOCITY};
+            uint32_t passed_calls = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t call = 0; call < call_count; ++call) {
+                if (xrLocateSpace(view_space, local_space, 1 + call, &wrong_location) != XR_ERROR_VALIDATION_FAILURE) {
+                    passed_calls++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (xrLocateSpace(local_space, view_space, 1, &wrong_location) != XR_ERROR_VALIDATION_FAILURE) {
+                passed_calls++;
+            }
+            TEST_EQUAL(passed_calls, 0u, "Calls with the wrong structure fail")
+            cout << "        Failing xrLocateSpace with " << (limited ? "limited" : "all") << " messages written: "
+                 << static_cast<uint64_t>(call_count / seconds) << " calls per second" << endl;
+
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            const std::string message_start = "[VALID_ERROR | VUID-xrLocateSpace-location-parameter | xrLocateSpace]";
+            std::ifstream message_file(message_file_name);
+            uint32_t message_count = 0;
+            uint32_t summary_count = 0;
+            std::string line;
+            while (std::getline(message_file, line)) {
+                if (line.compare(0, message_start.size(), message_start) != 0) {
+                    continue;
+                }
+                message_count++;
+                if (line.find("(suppressed 100 repeats of this message)") != std::string::npos) {
+                    summary_count++;
+                }
+            }
+            if (limited) {
+                // Two messages, then one for every 100 repeats, for the first pair of spaces, and one for the other.
+                TEST_EQUAL(message_count, 2u + (call_count - 2) / 100 + 1, "Messages written with a limit")
+                TEST_EQUAL(summary_count, (call_count - 2) / 100, "Summaries of suppressed repeats")
+            } else {
+                TEST_EQUAL(message_count, call_count + 1, "Messages written without a limit")
+                TEST_EQUAL(summary_count, 0u, "Summaries without a limit")
+            }
+        }
+        std::remove(message_file_name);
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_EXPORT_TYPE");
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_FILE_NAME");
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_MESSAGE_LIMIT");
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_MESSAGE_SUMMARY");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationMessageLimit)
+}
+
+// Counts the core validation messages passed to a debug messenger.
+static XrBool32 XRAPI_PTR CountValidationMessagesCallback(XrDebugUtilsMessageSeverityFlagsEXT /*messageSeverity*/,
+                                                          XrDebugUtilsMessageTypeFlagsEXT messageTypes,
+                                                          const XrDebugUtilsMessengerCallbackDataEXT* /*callbackData*/,
+                                                          void* userData) {
+    if ((messageTypes & XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) != 0) {
+        (*static_cast<uint32_t*>(userData))++;
+    }
+    return XR_FALSE;
+}
+
+// Time the frames of an app that makes core validation report 1,000 messages a second, with no output,
+// text and HTML output, and check that each message reaches the debug messenger before the call
+// returns and is in the output once the instance is destroyed.
+DEFINE_TEST(TestCoreValidationMessageOutput) {
+    INIT_TEST(TestCoreValidationMessageOutput)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationMessageOutput)
+            return;
+        }
+
+        const char* const extension_names[2] = {XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 2;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        struct MessageOutput {
+            const char* export_type;
+            const char* file_name;
+            // The start of the line written once for each message
+            const char* message_line;
+        };
+        const MessageOutput outputs[3] = {
+            {"", "", ""},
+            {"text", "core_validation_output.txt", "[VALID_ERROR | VUID-"},
+            {"html", "core_validation_output.html", "      <div class='headervar'>VUID-"},
+        };
+        for (const MessageOutput& output : outputs) {
+            const std::string export_type = output.export_type[0] != '\0' ? output.export_type : "no";
+            std::remove(output.file_name);
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_EXPORT_TYPE", output.export_type);
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_FILE_NAME", output.file_name);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            PFN_xrCreateDebugUtilsMessengerEXT create_debug_utils_messenger = nullptr;
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&create_debug_utils_messenger)),
+                       XR_SUCCESS, "Getting xrCreateDebugUtilsMessengerEXT")
+            uint32_t callback_count = 0;
+            XrDebugUtilsMessengerCreateInfoEXT messenger_create_info{XR_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
+            messenger_create_info.messageSeverities = XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+            messenger_create_info.messageTypes = XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+            messenger_create_info.userCallback = CountValidationMessagesCallback;
+            messenger_create_info.userData = &callback_count;
+            XrDebugUtilsMessengerEXT messenger = XR_NULL_HANDLE;
+            TEST_EQUAL(create_debug_utils_messenger(instance, &messenger_create_info, &messenger), XR_SUCCESS,
+                       "xrCreateDebugUtilsMessengerEXT")
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            // 100 frames a second, each locating spaces with the wrong structure 5 times, which reports
+            // 2 messages a call, and paced so that the messages are spread over the second as they would
+            // be in an app.
+            const uint32_t frame_count = 100;
+            const uint32_t calls_per_frame = 5;
+            const uint32_t messages_per_call = 2;
+            const std::chrono::milliseconds frame_interval(10);
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            XrSpaceLocation wrong_location{XR_TYPE_SPACE_VELOCITY};
+            uint32_t failed_frames = 0;
+            uint32_t late_callbacks = 0;
+            double total_seconds = 0.0;
+            double worst_seconds = 0.0;
+            auto next_frame = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                std::this_thread::sleep_until(next_frame);
+                next_frame += frame_interval;
+                auto frame_start = std::chrono::steady_clock::now();
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info));
+                for (uint32_t call = 0; call < calls_per_frame; ++call) {
+                    uint32_t earlier_callbacks = callback_count;
+                    failed = failed || xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &wrong_location) !=
+                                           XR_ERROR_VALIDATION_FAILURE;
+                    if (callback_count != earlier_callbacks + messages_per_call) {
+                        late_callbacks++;
+                    }
+                }
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count();
+                total_seconds += seconds;
+                worst_seconds = (std::max)(worst_seconds, seconds);
+            }
+            std::string subtest_name = "Frames with " + export_type + " output";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            subtest_name = "Debug messenger called during each call with " + export_type + " output";
+            TEST_EQUAL(late_callbacks, 0u, subtest_name)
+            cout << "        1000 messages a second with " << export_type << " output: "
+                 << static_cast<uint64_t>(total_seconds * 1e6 / frame_count) << " us mean, "
+                 << static_cast<uint64_t>(worst_seconds * 1e6) << " us worst frame time" << endl;
+
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+
+            if (output.file_name[0] != '\0') {
+                // Everything is written by the time the last instance is destroyed.
+                const std::string message_line = output.message_line;
+                std::ifstream output_file(output.file_name);
+                uint32_t message_count = 0;
+                std::string last_line;
+                std::string line;
+                while (std::getline(output_file, line)) {
+                    if (line.compare(0, message_line.size(), message_line) == 0) {
+                        message_count++;
+                    }
+                    last_line = line;
+                }
+                subtest_name = "Messages in the " + export_type + " output";
+                TEST_EQUAL(message_count, frame_count * calls_per_frame * messages_per_call, subtest_name)
+                if (export_type == "html") {
+                    TEST_EQUAL(last_line, std::string("</html>"), "HTML output finished")
+                }
+                output_file.close();
+                std::remove(output.file_name);
+            }
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_EXPORT_TYPE");
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_FILE_NAME");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationMessageOutput)
+}
+
+// Counts the performance warnings passed to a debug messenger by message ID.
+static XrBool32 XRAPI_PTR CountPerformanceWarningsCallback(XrDebugUtilsMessageSeverityFlagsEXT messageSeverity,
+                                                           XrDebugUtilsMessageTypeFlagsEXT messageTypes,
+                                                           const XrDebugUtilsMessengerCallbackDataEXT* callbackData, void* userData) {
+    if (messageSeverity == XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT &&
+        messageTypes == XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) {
+        (*static_cast<std::map<std::string, uint32_t>*>(userData))[callbackData->messageId]++;
+    }
+    return XR_FALSE;
+}
+
+// Run frames that follow the usual pattern and frames that waste time in each of the ways the
+// performance checks of core validation look for, with every check and then with one of them.
+DEFINE_TEST(TestCoreValidationPerformanceChecks) {
+    INIT_TEST(TestCoreValidationPerformanceChecks)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationPerformanceChecks)
+            return;
+        }
+
+        const char* const extension_names[2] = {XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 2;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        const char* const enabled_checks[2] = {"all, wait-begin-gap=2", "repeated-sync"};
+        for (const char* checks : enabled_checks) {
+            const bool all_checks = checks[0] == 'a';
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_PERFORMANCE", checks);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            PFN_xrCreateDebugUtilsMessengerEXT create_debug_utils_messenger = nullptr;
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&create_debug_utils_messenger)),
+                       XR_SUCCESS, "Getting xrCreateDebugUtilsMessengerEXT")
+            std::map<std::string, uint32_t> warnings;
+            XrDebugUtilsMessengerCreateInfoEXT messenger_create_info{XR_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
+            messenger_create_info.messageSeverities = XR_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+            messenger_create_info.messageTypes = XR_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+            messenger_create_info.userCallback = CountPerformanceWarningsCallback;
+            messenger_create_info.userData = &warnings;
+            XrDebugUtilsMessengerEXT messenger = XR_NULL_HANDLE;
+            TEST_EQUAL(create_debug_utils_messenger(instance, &messenger_create_info, &messenger), XR_SUCCESS,
+                       "xrCreateDebugUtilsMessengerEXT")
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            // Enumerating and converting paths before the frame loop is what they are for.
+            uint32_t reference_space_count = 0;
+            XrReferenceSpaceType reference_spaces[3];
+            TEST_EQUAL(xrEnumerateReferenceSpaces(session, 0, &reference_space_count, nullptr), XR_SUCCESS,
+                       "xrEnumerateReferenceSpaces count")
+            TEST_EQUAL(xrEnumerateReferenceSpaces(session, 3, &reference_space_count, reference_spaces), XR_SUCCESS,
+                       "xrEnumerateReferenceSpaces")
+            XrPath left_hand_path = XR_NULL_PATH;
+            TEST_EQUAL(xrStringToPath(instance, "/user/hand/left", &left_hand_path), XR_SUCCESS, "xrStringToPath")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActiveActionSet active_action_set{action_set, XR_NULL_PATH};
+            XrActionsSyncInfo actions_sync_info{XR_TYPE_ACTIONS_SYNC_INFO};
+            actions_sync_info.countActiveActionSets = 1;
+            actions_sync_info.activeActionSets = &active_action_set;
+
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            XrSpaceLocation view_location{XR_TYPE_SPACE_LOCATION};
+
+            // Frames that sync once and locate each pair of spaces once, which are not reported.
+            const uint32_t frame_count = 5;
+            uint32_t failed_frames = 0;
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info)) ||
+                              XR_FAILED(xrSyncActions(session, &actions_sync_info)) ||
+                              XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &view_location));
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            std::string subtest_name = all_checks ? "Frames with all checks" : "Frames with one check";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            subtest_name = all_checks ? "Usual frames with all checks" : "Usual frames with one check";
+            TEST_EQUAL(warnings.size(), size_t(0), subtest_name)
+
+            // Frames that make every mistake once.
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state));
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                failed = failed || XR_FAILED(xrBeginFrame(session, &frame_begin_info)) ||
+                         XR_FAILED(xrSyncActions(session, &actions_sync_info)) ||
+                         XR_FAILED(xrSyncActions(session, &actions_sync_info)) ||
+                         XR_FAILED(xrEnumerateReferenceSpaces(session, 0, &reference_space_count, nullptr)) ||
+                         XR_FAILED(xrEnumerateReferenceSpaces(session, 3, &reference_space_count, reference_spaces)) ||
+                         XR_FAILED(xrStringToPath(instance, "/user/hand/left", &left_hand_path)) ||
+                         XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &view_location)) ||
+                         XR_FAILED(xrLocateSpace(local_space, view_space, frame_state.predictedDisplayTime, &view_location));
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            TEST_EQUAL(failed_frames, 0u, "Frames with mistakes")
+            // Every mistake is reported once a frame, except for the enumeration, which is reported once
+            // it has been called in 3 frames in a row.
+            const std::map<std::string, uint32_t> expected_warnings =
+                all_checks ? std::map<std::string, uint32_t>{{"PERF-enumerate-per-frame", 1},
+                                                             {"PERF-path-in-frame", frame_count},
+                                                             {"PERF-repeated-locate", frame_count},
+                                                             {"PERF-repeated-sync", frame_count},
+                                                             {"PERF-wait-begin-gap", frame_count}}
+                           : std::map<std::string, uint32_t>{{"PERF-repeated-sync", frame_count}};
+            for (const auto& expected : expected_warnings) {
+                subtest_name = expected.first + (all_checks ? " with all checks" : " with one check");
+                TEST_EQUAL(warnings[expected.first], expected.second, subtest_name)
+            }
+            subtest_name = all_checks ? "Only the expected warnings with all checks" : "Only the expected warnings with one check";
+            TEST_EQUAL(warnings.size(), expected_warnings.size(), subtest_name)
+
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_PERFORMANCE");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationPerformanceChecks)
+}
+
+// Time a frame loop without any API layer and with core validation, to show what validation adds to
+// each call with the checks of the profile the layer was built with.
+DEFINE_TEST(TestCoreValidationCallOverhead) {
+    INIT_TEST(TestCoreValidationCallOverhead)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationCallOverhead)
+            return;
+        }
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        // The time of each call without a layer, which validation adds to.
+        double unlayered_ns_per_call = 0.0;
+        for (uint32_t layer_count = 0; layer_count < 2; ++layer_count) {
+            const bool validating = layer_count != 0;
+            instance_create_info.enabledApiLayerCount = layer_count;
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            if (validating) {
+                TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            } else {
+                TEST_EQUAL(create_result, XR_SUCCESS, "Creating instance without an API layer")
+            }
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+            strcpy(action_create_info.actionName, "grab_object");
+            strcpy(action_create_info.localizedActionName, "Grab Object");
+            action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+            XrAction action = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            XrActiveActionSet active_action_set{action_set, XR_NULL_PATH};
+            XrActionsSyncInfo actions_sync_info{XR_TYPE_ACTIONS_SYNC_INFO};
+            actions_sync_info.countActiveActionSets = 1;
+            actions_sync_info.activeActionSets = &active_action_set;
+            XrActionStateGetInfo action_state_get_info{XR_TYPE_ACTION_STATE_GET_INFO};
+            action_state_get_info.action = action;
+            XrActionStateBoolean action_state{XR_TYPE_ACTION_STATE_BOOLEAN};
+            XrViewLocateInfo view_locate_info{XR_TYPE_VIEW_LOCATE_INFO};
+            view_locate_info.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+            view_locate_info.space = local_space;
+            XrViewState view_state{XR_TYPE_VIEW_STATE};
+            XrView views[2] = {{XR_TYPE_VIEW}, {XR_TYPE_VIEW}};
+            uint32_t view_count = 0;
+            XrSpaceLocation view_location{XR_TYPE_SPACE_LOCATION};
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+
+            // Seven calls a frame, all of them validated when the layer is enabled.
+            const uint32_t frame_count = 20000;
+            const uint32_t calls_per_frame = 7;
+            uint32_t failed_frames = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info)) ||
+                              XR_FAILED(xrSyncActions(session, &actions_sync_info)) ||
+                              XR_FAILED(xrGetActionStateBoolean(session, &action_state_get_info, &action_state));
+                view_locate_info.displayTime = frame_state.predictedDisplayTime;
+                failed = failed || XR_FAILED(xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views)) ||
+                         XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &view_location));
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double ns_per_call = seconds * 1e9 / (frame_count * calls_per_frame);
+            std::string subtest_name = validating ? "Frames with validation" : "Frames without a layer";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            if (validating) {
+                cout << "        Calls with validation: " << static_cast<uint64_t>(ns_per_call) << " ns per call, "
+                     << static_cast<uint64_t>(ns_per_call - unlayered_ns_per_call) << " ns more than without a layer"
+                     << endl;
+            } else {
+                unlayered_ns_per_call = ns_per_call;
+                cout << "        Calls without a layer: " << static_cast<uint64_t>(ns_per_call) << " ns per call" << endl;
+            }
+
+            TEST_EQUAL(xrDestroyAction(action), XR_SUCCESS, "xrDestroyAction")
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationCallOverhead)
+}
+
+// Records the message IDs of the core validation messages passed to a debug messenger.
+static XrBool32 XRAPI_PTR RecordValidationMessageIdsCallback(XrDebugUtilsMessageSeverityFlagsEXT /*messageSeverity*/,
+                                                             XrDebugUtilsMessageTypeFlagsEXT messageTypes,
+                                                             const XrDebugUtilsMessengerCallbackDataEXT* callbackData,
+                                                             void* userData) {
+    if ((messageTypes & XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) != 0) {
+        static_cast<std::vector<std::string>*>(userData)->emplace_back(callbackData->messageId);
+    }
+    return XR_FALSE;
+}
+
+// Pass valid and invalid structures to core validation with each of the ways it can validate structures,
+// check that they report the same results and messages, and time calls taking structures with each.  Only
+// a layer built with CORE_VALIDATION_COMPARE_STRUCT_TABLES reads XR_CORE_VALIDATION_STRUCT_ENGINE, and
+// the others always use the one they were built with.
+DEFINE_TEST(TestCoreValidationStructTables) {
+    INIT_TEST(TestCoreValidationStructTables)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationStructTables)
+            return;
+        }
+
+        const char* const extension_names[2] = {XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 2;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        // The result and message IDs of each call of the corpus, with each engine.
+        struct CallOutcome {
+            XrResult result;
+            std::vector<std::string> message_ids;
+        };
+        const char* const engines[3] = {"tables", "unrolled", "compare"};
+        std::vector<std::vector<CallOutcome>> engine_outcomes;
+        for (const char* engine : engines) {
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_STRUCT_ENGINE", engine);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            PFN_xrCreateDebugUtilsMessengerEXT create_debug_utils_messenger = nullptr;
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&create_debug_utils_messenger)),
+                       XR_SUCCESS, "Getting xrCreateDebugUtilsMessengerEXT")
+            std::vector<std::string> message_ids;
+            XrDebugUtilsMessengerCreateInfoEXT messenger_create_info{XR_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
+            messenger_create_info.messageSeverities = XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+            messenger_create_info.messageTypes = XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+            messenger_create_info.userCallback = RecordValidationMessageIdsCallback;
+            messenger_create_info.userData = &message_ids;
+            XrDebugUtilsMessengerEXT messenger = XR_NULL_HANDLE;
+            TEST_EQUAL(create_debug_utils_messenger(instance, &messenger_create_info, &messenger), XR_SUCCESS,
+                       "xrCreateDebugUtilsMessengerEXT")
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrActionSetCreateInfo action_set_create_info{XR_TYPE_ACTION_SET_CREATE_INFO};
+            strcpy(action_set_create_info.actionSetName, "gameplay");
+            strcpy(action_set_create_info.localizedActionSetName, "Gameplay");
+            XrActionSet action_set = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateActionSet(instance, &action_set_create_info, &action_set), XR_SUCCESS, "xrCreateActionSet")
+            XrActionCreateInfo action_create_info{XR_TYPE_ACTION_CREATE_INFO};
+            strcpy(action_create_info.actionName, "grab_object");
+            strcpy(action_create_info.localizedActionName, "Grab Object");
+            action_create_info.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
+            XrAction action = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateAction(action_set, &action_create_info, &action), XR_SUCCESS, "xrCreateAction")
+            message_ids.clear();
+
+            // The corpus: each call passes the structures below, changed by one mistake, or none.
+            uint64_t unknown_handle = 0xBADC0DE;
+            XrFrameWaitInfo unrelated_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrSpace space = XR_NULL_HANDLE;
+            XrActiveActionSet active_action_set{action_set, XR_NULL_PATH};
+            XrActionsSyncInfo actions_sync_info{XR_TYPE_ACTIONS_SYNC_INFO};
+            XrViewLocateInfo view_locate_info{XR_TYPE_VIEW_LOCATE_INFO};
+            XrViewState view_state{XR_TYPE_VIEW_STATE};
+            XrView views[2] = {{XR_TYPE_VIEW}, {XR_TYPE_VIEW}};
+            uint32_t view_count = 0;
+            XrSessionCreateInfo bad_session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            XrSession bad_session = XR_NULL_HANDLE;
+            XrActionSuggestedBinding suggested_binding{action, XR_NULL_PATH};
+            XrInteractionProfileSuggestedBinding suggested_bindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
+            XrHapticActionInfo haptic_action_info{XR_TYPE_HAPTIC_ACTION_INFO};
+            haptic_action_info.action = action;
+            XrHapticVibration haptic_vibration{XR_TYPE_HAPTIC_VIBRATION};
+            XrSwapchainCreateInfo swapchain_create_info{XR_TYPE_SWAPCHAIN_CREATE_INFO};
+            swapchain_create_info.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+            swapchain_create_info.sampleCount = 1;
+            swapchain_create_info.width = 1;
+            swapchain_create_info.height = 1;
+            swapchain_create_info.faceCount = 1;
+            swapchain_create_info.arraySize = 1;
+            swapchain_create_info.mipCount = 1;
+            XrSwapchain swapchain = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSwapchain(session, &swapchain_create_info, &swapchain), XR_SUCCESS, "xrCreateSwapchain")
+            XrCompositionLayerQuad quad_layers[2] = {{XR_TYPE_COMPOSITION_LAYER_QUAD}, {XR_TYPE_COMPOSITION_LAYER_QUAD}};
+            const XrCompositionLayerBaseHeader* layers[2] = {};
+            for (uint32_t layer = 0; layer < 2; ++layer) {
+                quad_layers[layer].space = local_space;
+                quad_layers[layer].subImage.swapchain = swapchain;
+                quad_layers[layer].pose.orientation.w = 1.0f;
+                layers[layer] = reinterpret_cast<XrCompositionLayerBaseHeader*>(&quad_layers[layer]);
+            }
+            // The mistakes are made in the second layer.
+            XrCompositionLayerQuad& changed_layer = quad_layers[1];
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            auto reset = [&]() {
+                space_create_info.type = XR_TYPE_REFERENCE_SPACE_CREATE_INFO;
+                space_create_info.next = nullptr;
+                space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+                active_action_set.actionSet = action_set;
+                actions_sync_info.next = nullptr;
+                actions_sync_info.countActiveActionSets = 1;
+                actions_sync_info.activeActionSets = &active_action_set;
+                view_locate_info.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+                view_locate_info.space = local_space;
+                bad_session_create_info.systemId = system_id;
+                bad_session_create_info.createFlags = 0;
+                suggested_bindings.countSuggestedBindings = 1;
+                suggested_bindings.suggestedBindings = &suggested_binding;
+                haptic_vibration.type = XR_TYPE_HAPTIC_VIBRATION;
+                changed_layer.type = XR_TYPE_COMPOSITION_LAYER_QUAD;
+                changed_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+                frame_end_info.layerCount = 2;
+                frame_end_info.layers = layers;
+            };
+            std::vector<std::function<XrResult()>> corpus = {
+                [&]() { return xrCreateReferenceSpace(session, &space_create_info, &space); },
+                [&]() {
+                    space_create_info.type = XR_TYPE_ACTION_SPACE_CREATE_INFO;
+                    return xrCreateReferenceSpace(session, &space_create_info, &space);
+                },
+                [&]() {
+                    space_create_info.referenceSpaceType = static_cast<XrReferenceSpaceType>(0x7FFF);
+                    return xrCreateReferenceSpace(session, &space_create_info, &space);
+                },
+                [&]() {
+                    space_create_info.next = &unrelated_info;
+                    return xrCreateReferenceSpace(session, &space_create_info, &space);
+                },
+                [&]() { return xrSyncActions(session, &actions_sync_info); },
+                [&]() {
+                    actions_sync_info.activeActionSets = nullptr;
+                    return xrSyncActions(session, &actions_sync_info);
+                },
+                [&]() {
+                    active_action_set.actionSet = TreatIntegerAsHandle<XrActionSet>(unknown_handle);
+                    return xrSyncActions(session, &actions_sync_info);
+                },
+                [&]() {
+                    actions_sync_info.next = &unrelated_info;
+                    return xrSyncActions(session, &actions_sync_info);
+                },
+                [&]() { return xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views); },
+                [&]() {
+                    view_locate_info.viewConfigurationType = static_cast<XrViewConfigurationType>(0x7FFF);
+                    return xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views);
+                },
+                [&]() {
+                    view_locate_info.space = TreatIntegerAsHandle<XrSpace>(unknown_handle);
+                    return xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views);
+                },
+                [&]() {
+                    bad_session_create_info.createFlags = 0x100;
+                    return xrCreateSession(instance, &bad_session_create_info, &bad_session);
+                },
+                [&]() {
+                    suggested_bindings.countSuggestedBindings = 0;
+                    return xrSuggestInteractionProfileBindings(instance, &suggested_bindings);
+                },
+                [&]() {
+                    haptic_vibration.type = XR_TYPE_VIEW;
+                    return xrApplyHapticFeedback(session, &haptic_action_info, reinterpret_cast<XrHapticBaseHeader*>(&haptic_vibration));
+                },
+                [&]() {
+                    frame_end_info.layers = nullptr;
+                    return xrEndFrame(session, &frame_end_info);
+                },
+                [&]() {
+                    changed_layer.type = XR_TYPE_VIEW;
+                    return xrEndFrame(session, &frame_end_info);
+                },
+                [&]() {
+                    changed_layer.eyeVisibility = static_cast<XrEyeVisibility>(0x7FFF);
+                    return xrEndFrame(session, &frame_end_info);
+                },
+            };
+            // The message each call must report, with any engine, or nothing for the calls without a mistake.
+            const char* const expected_message_ids[] = {
+                "",
+                "VUID-XrReferenceSpaceCreateInfo-type-type",
+                "VUID-XrReferenceSpaceCreateInfo-referenceSpaceType-parameter",
+                "VUID-XrReferenceSpaceCreateInfo-next-next",
+                "",
+                "VUID-XrActionsSyncInfo-activeActionSets-parameter",
+                "VUID-XrActiveActionSet-actionSet-parameter",
+                "VUID-XrActionsSyncInfo-next-next",
+                "",
+                "VUID-XrViewLocateInfo-viewConfigurationType-parameter",
+                "VUID-XrViewLocateInfo-space-parameter",
+                "VUID-XrSessionCreateInfo-createFlags-parameter",
+                "VUID-XrInteractionProfileSuggestedBinding-countSuggestedBindings-arraylength",
+                "VUID-XrHapticBaseHeader-type-type",
+                "VUID-XrFrameEndInfo-layers-parameter",
+                "VUID-XrCompositionLayerBaseHeader-type-type",
+                "VUID-XrCompositionLayerQuad-eyeVisibility-parameter",
+            };
+            static_assert(sizeof(expected_message_ids) / sizeof(expected_message_ids[0]) == 17, "One message for each call");
+
+            std::vector<CallOutcome> outcomes;
+            uint32_t unexpected_calls = 0;
+            uint32_t mismatches = 0;
+            for (size_t call = 0; call < corpus.size(); ++call) {
+                reset();
+                message_ids.clear();
+                XrResult result = corpus[call]();
+                if (space != XR_NULL_HANDLE) {
+                    xrDestroySpace(space);
+                    space = XR_NULL_HANDLE;
+                }
+                const std::string expected_message_id = expected_message_ids[call];
+                bool expected = expected_message_id.empty()
+                                    ? message_ids.empty() && XR_SUCCEEDED(result)
+                                    : std::find(message_ids.begin(), message_ids.end(), expected_message_id) != message_ids.end();
+                if (!expected) {
+                    cout << "        Call " << call << " did not report " << expected_message_id << endl;
+                    unexpected_calls++;
+                }
+                mismatches += static_cast<uint32_t>(
+                    std::count(message_ids.begin(), message_ids.end(), "CoreValidation-struct-tables-mismatch"));
+                outcomes.push_back({result, message_ids});
+            }
+            std::string subtest_name = std::string("Messages of the corpus with the ") + engine + " engine";
+            TEST_EQUAL(unexpected_calls, 0u, subtest_name)
+            subtest_name = std::string("Differences between the engines found by the ") + engine + " engine";
+            TEST_EQUAL(mismatches, 0u, subtest_name)
+            engine_outcomes.push_back(outcomes);
+
+            // Time frames whose calls take a few structures each, ending with two quad layers.
+            reset();
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            const uint32_t frame_count = 20000;
+            const uint32_t calls_per_frame = 5;
+            uint32_t failed_frames = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info)) ||
+                              XR_FAILED(xrSyncActions(session, &actions_sync_info));
+                view_locate_info.displayTime = frame_state.predictedDisplayTime;
+                failed = failed || XR_FAILED(xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views));
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            subtest_name = std::string("Frames with the ") + engine + " engine";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            cout << "        Calls validating structures with the " << engine << " engine: "
+                 << static_cast<uint64_t>(seconds * 1e9 / (frame_count * calls_per_frame)) << " ns per call" << endl;
+
+            TEST_EQUAL(xrDestroySwapchain(swapchain), XR_SUCCESS, "xrDestroySwapchain")
+            TEST_EQUAL(xrDestroyAction(action), XR_SUCCESS, "xrDestroyAction")
+            TEST_EQUAL(xrDestroyActionSet(action_set), XR_SUCCESS, "xrDestroyActionSet")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+
+        // Every engine reports the same results and messages as the tables.
+        for (size_t engine = 1; engine < engine_outcomes.size(); ++engine) {
+            uint32_t different_calls = 0;
+            for (size_t call = 0; call < engine_outcomes[engine].size(); ++call) {
+                if (engine_outcomes[engine][call].result != engine_outcomes[0][call].result ||
+                    engine_outcomes[engine][call].message_ids != engine_outcomes[0][call].message_ids) {
+                    cout << "        Call " << call << " is validated differently by the " << engines[engine] << " engine"
+                         << endl;
+                    different_calls++;
+                }
+            }
+            std::string subtest_name = std::string("Results of the ") + engines[engine] + " engine";
+            TEST_EQUAL(different_calls, 0u, subtest_name)
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_STRUCT_ENGINE");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationStructTables)
+}
+
+// What a debug messenger was passed for a core validation message, and the thread it was called on.
+struct AsyncValidationMessage {
+    std::string message_id;
+    std::string session_name;
+    std::string label_name;
+    std::thread::id thread_id;
+};
+
+// Records the core validation messages passed to a debug messenger, which may be called from a worker thread.
+static XrBool32 XRAPI_PTR RecordAsyncValidationMessagesCallback(XrDebugUtilsMessageSeverityFlagsEXT /*messageSeverity*/,
+                                                                XrDebugUtilsMessageTypeFlagsEXT messageTypes,
+                                                                const XrDebugUtilsMessengerCallbackDataEXT* callbackData,
+                                                                void* userData) {
+    if ((messageTypes & XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) != 0) {
+        AsyncValidationMessage message;
+        message.message_id = callbackData->messageId;
+        for (uint32_t object = 0; object < callbackData->objectCount; ++object) {
+            if (callbackData->objects[object].objectType == XR_OBJECT_TYPE_SESSION &&
+                callbackData->objects[object].objectName != nullptr) {
+                message.session_name = callbackData->objects[object].objectName;
+            }
+        }
+        if (callbackData->sessionLabelCount != 0) {
+            message.label_name = callbackData->sessionLabels[0].labelName;
+        }
+        message.thread_id = std::this_thread::get_id();
+        // Only one call is made at a time, and its messages are read once the next call waits for them.
+        static_cast<std::vector<AsyncValidationMessage>*>(userData)->push_back(message);
+    }
+    return XR_FALSE;
+}
+
+// The processor time the calling thread has used, which leaves out the time of other threads even when
+// they run on the same core.
+static double ThreadCpuSeconds() {
+#ifdef XR_USE_PLATFORM_WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+        return 0.0;
+    }
+    auto to_ticks = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    return (to_ticks(kernel_time) + to_ticks(user_time)) * 100e-9;
+#else
+    timespec time{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0.0;
+    }
+    return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+// Time a frame loop with core validation made as each call is made and by worker threads, and check
+// that an invalid call validated by a worker is passed down the chain, and that its message reaches the
+// debug messenger from the worker with the name and label its session had when the call was made.
+DEFINE_TEST(TestCoreValidationAsync) {
+    INIT_TEST(TestCoreValidationAsync)
+
+    try {
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestCoreValidationAsync)
+            return;
+        }
+
+        const char* const extension_names[2] = {XR_MND_HEADLESS_EXTENSION_NAME, XR_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 2;
+        instance_create_info.enabledExtensionNames = extension_names;
+
+        const char* const worker_counts[2] = {"0", "2"};
+        for (const char* workers : worker_counts) {
+            const bool async = workers[0] != '0';
+            LoaderTestSetEnvironmentVariable("XR_CORE_VALIDATION_ASYNC", workers);
+            ForceLoaderUnloadRuntime();
+
+            XrInstance instance = XR_NULL_HANDLE;
+            XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+            TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+            if (XR_FAILED(create_result)) {
+                break;
+            }
+
+            PFN_xrCreateDebugUtilsMessengerEXT create_debug_utils_messenger = nullptr;
+            PFN_xrSetDebugUtilsObjectNameEXT set_debug_utils_object_name = nullptr;
+            PFN_xrSessionBeginDebugUtilsLabelRegionEXT session_begin_debug_utils_label_region = nullptr;
+            PFN_xrSessionEndDebugUtilsLabelRegionEXT session_end_debug_utils_label_region = nullptr;
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrCreateDebugUtilsMessengerEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&create_debug_utils_messenger)),
+                       XR_SUCCESS, "Getting xrCreateDebugUtilsMessengerEXT")
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSetDebugUtilsObjectNameEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&set_debug_utils_object_name)),
+                       XR_SUCCESS, "Getting xrSetDebugUtilsObjectNameEXT")
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSessionBeginDebugUtilsLabelRegionEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&session_begin_debug_utils_label_region)),
+                       XR_SUCCESS, "Getting xrSessionBeginDebugUtilsLabelRegionEXT")
+            TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSessionEndDebugUtilsLabelRegionEXT",
+                                             reinterpret_cast<PFN_xrVoidFunction*>(&session_end_debug_utils_label_region)),
+                       XR_SUCCESS, "Getting xrSessionEndDebugUtilsLabelRegionEXT")
+            std::vector<AsyncValidationMessage> messages;
+            XrDebugUtilsMessengerCreateInfoEXT messenger_create_info{XR_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
+            messenger_create_info.messageSeverities = XR_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+            messenger_create_info.messageTypes = XR_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+            messenger_create_info.userCallback = RecordAsyncValidationMessagesCallback;
+            messenger_create_info.userData = &messages;
+            XrDebugUtilsMessengerEXT messenger = XR_NULL_HANDLE;
+            TEST_EQUAL(create_debug_utils_messenger(instance, &messenger_create_info, &messenger), XR_SUCCESS,
+                       "xrCreateDebugUtilsMessengerEXT")
+
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+            XrDebugUtilsObjectNameInfoEXT session_name_info{XR_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT};
+            session_name_info.objectType = XR_OBJECT_TYPE_SESSION;
+            session_name_info.objectHandle = MakeHandleGeneric(session);
+            session_name_info.objectName = "Main session";
+            TEST_EQUAL(set_debug_utils_object_name(instance, &session_name_info), XR_SUCCESS, "Naming the session")
+
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_VIEW;
+            XrSpace view_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &view_space), XR_SUCCESS, "Creating view space")
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrSpace local_space = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateReferenceSpace(session, &space_create_info, &local_space), XR_SUCCESS, "Creating local space")
+
+            XrSwapchainCreateInfo swapchain_create_info{XR_TYPE_SWAPCHAIN_CREATE_INFO};
+            swapchain_create_info.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+            swapchain_create_info.sampleCount = 1;
+            swapchain_create_info.width = 1;
+            swapchain_create_info.height = 1;
+            swapchain_create_info.faceCount = 1;
+            swapchain_create_info.arraySize = 1;
+            swapchain_create_info.mipCount = 1;
+            XrSwapchain swapchain = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSwapchain(session, &swapchain_create_info, &swapchain), XR_SUCCESS, "xrCreateSwapchain")
+
+            XrFrameWaitInfo frame_wait_info{XR_TYPE_FRAME_WAIT_INFO};
+            XrFrameState frame_state{XR_TYPE_FRAME_STATE};
+            XrFrameBeginInfo frame_begin_info{XR_TYPE_FRAME_BEGIN_INFO};
+            XrViewLocateInfo view_locate_info{XR_TYPE_VIEW_LOCATE_INFO};
+            view_locate_info.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+            view_locate_info.space = local_space;
+            XrViewState view_state{XR_TYPE_VIEW_STATE};
+            XrView views[2] = {{XR_TYPE_VIEW}, {XR_TYPE_VIEW}};
+            uint32_t view_count = 0;
+            XrSpaceLocation view_location{XR_TYPE_SPACE_LOCATION};
+            XrCompositionLayerProjectionView projection_views[2] = {{XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW},
+                                                                    {XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW}};
+            for (uint32_t view = 0; view < 2; ++view) {
+                projection_views[view].subImage.swapchain = swapchain;
+                projection_views[view].subImage.imageRect.extent = {1, 1};
+            }
+            XrCompositionLayerProjection projection_layer{XR_TYPE_COMPOSITION_LAYER_PROJECTION};
+            projection_layer.space = local_space;
+            projection_layer.viewCount = 2;
+            projection_layer.views = projection_views;
+            XrCompositionLayerQuad quad_layer{XR_TYPE_COMPOSITION_LAYER_QUAD};
+            quad_layer.space = view_space;
+            quad_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+            quad_layer.subImage.swapchain = swapchain;
+            quad_layer.subImage.imageRect.extent = {1, 1};
+            quad_layer.pose.orientation.w = 1.0f;
+            quad_layer.size = {1.0f, 1.0f};
+            const XrCompositionLayerBaseHeader* const layers[2] = {
+                reinterpret_cast<const XrCompositionLayerBaseHeader*>(&projection_layer),
+                reinterpret_cast<const XrCompositionLayerBaseHeader*>(&quad_layer)};
+            XrFrameEndInfo frame_end_info{XR_TYPE_FRAME_END_INFO};
+            frame_end_info.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+            frame_end_info.layerCount = 2;
+            frame_end_info.layers = layers;
+
+            const uint32_t frame_count = 20000;
+            uint32_t failed_frames = 0;
+            auto start = std::chrono::steady_clock::now();
+            const double start_cpu_seconds = ThreadCpuSeconds();
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                bool failed = XR_FAILED(xrWaitFrame(session, &frame_wait_info, &frame_state)) ||
+                              XR_FAILED(xrBeginFrame(session, &frame_begin_info));
+                view_locate_info.displayTime = frame_state.predictedDisplayTime;
+                failed = failed || XR_FAILED(xrLocateViews(session, &view_locate_info, &view_state, 2, &view_count, views)) ||
+                         XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &view_location));
+                for (uint32_t view = 0; view < 2; ++view) {
+                    projection_views[view].pose = views[view].pose;
+                    projection_views[view].fov = views[view].fov;
+                }
+                quad_layer.pose = view_location.pose;
+                frame_end_info.displayTime = frame_state.predictedDisplayTime;
+                if (failed || XR_FAILED(xrEndFrame(session, &frame_end_info))) {
+                    failed_frames++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double cpu_seconds = ThreadCpuSeconds() - start_cpu_seconds;
+            std::string subtest_name = async ? "Frames with asynchronous validation" : "Frames with validation";
+            TEST_EQUAL(failed_frames, 0u, subtest_name)
+            // The time the frame loop takes only drops with the workers on cores the application does not use,
+            // but the time its own thread spends on each frame drops either way.
+            cout << "        Frame loop with " << (async ? "asynchronous validation: " : "validation: ")
+                 << static_cast<uint64_t>(frame_count / seconds) << " frames per second, "
+                 << static_cast<uint64_t>(cpu_seconds * 1e9 / frame_count) << " ns of the calling thread per frame, "
+                 << std::thread::hardware_concurrency() << " cores" << endl;
+
+            // Each thread queues its calls in a ring of its own, which the workers validate alongside the others.
+            std::atomic<uint32_t> failed_locates{0};
+            std::vector<std::thread> locating_threads;
+            for (uint32_t thread = 0; thread < 4; ++thread) {
+                locating_threads.emplace_back([&]() {
+                    XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+                    for (uint32_t locate = 0; locate < 1000; ++locate) {
+                        if (XR_FAILED(xrLocateSpace(view_space, local_space, frame_state.predictedDisplayTime, &location))) {
+                            failed_locates++;
+                        }
+                    }
+                });
+            }
+            for (std::thread& thread : locating_threads) {
+                thread.join();
+            }
+            TEST_EQUAL(failed_locates.load(), 0u, "Locating spaces from several threads")
+
+            // An invalid layer is only reported once the call is validated, so a call queued for a worker
+            // An invalid layer is only reported once the call is validated, so a call queued for a worker
+            // reaches the runtime, which does not check it.
+            XrDebugUtilsLabelEXT label{XR_TYPE_DEBUG_UTILS_LABEL_EXT};
+            label.labelName = "Invalid frame";
+            TEST_EQUAL(session_begin_debug_utils_label_region(session, &label), XR_SUCCESS,
+                       "xrSessionBeginDebugUtilsLabelRegionEXT")
+            quad_layer.eyeVisibility = static_cast<XrEyeVisibility>(7);
+            const XrResult invalid_frame_result = async ? XR_SUCCESS : XR_ERROR_VALIDATION_FAILURE;
+            TEST_EQUAL(xrEndFrame(session, &frame_end_info), invalid_frame_result, "xrEndFrame with invalid layer")
+            quad_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+            // Ending the label region first waits for the queued call to be validated.
+            TEST_EQUAL(session_end_debug_utils_label_region(session), XR_SUCCESS, "xrSessionEndDebugUtilsLabelRegionEXT")
+            // The layer, the frame end info and the call are each reported.
+            TEST_EQUAL(messages.size(), size_t(3), "Messages for the invalid layer")
+            uint32_t unnamed_messages = 0;
+            uint32_t unlabelled_messages = 0;
+            uint32_t messages_from_caller = 0;
+            for (const AsyncValidationMessage& message : messages) {
+                unnamed_messages += message.session_name != "Main session" ? 1 : 0;
+                unlabelled_messages += message.label_name != "Invalid frame" ? 1 : 0;
+                messages_from_caller += message.thread_id == std::this_thread::get_id() ? 1 : 0;
+            }
+            TEST_EQUAL(unnamed_messages, 0u, "Session name of the messages")
+            TEST_EQUAL(unlabelled_messages, 0u, "Session label of the messages")
+            const uint32_t expected_messages_from_caller = async ? 0u : 3u;
+            TEST_EQUAL(messages_from_caller, expected_messages_from_caller, "Thread reporting the messages")
+
+            TEST_EQUAL(xrDestroySwapchain(swapchain), XR_SUCCESS, "xrDestroySwapchain")
+            TEST_EQUAL(xrDestroySpace(local_space), XR_SUCCESS, "Destroying local space")
+            TEST_EQUAL(xrDestroySpace(view_space), XR_SUCCESS, "Destroying view space")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+        }
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    LoaderTestUnsetEnvironmentVariable("XR_CORE_VALIDATION_ASYNC");
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCoreValidationAsync)
+}
+
+// The switch openxr_reflection.h lets applications write, which the reflection tables replace.
+#define RESULT_CASE_STR(name, value) \
+    case name:                       \
+        return #name;
+static const char* ResultNameFromSwitch(XrResult result) {
+    switch (result) {
+        XR_LIST_ENUM_XrResult(RESULT_CASE_STR)
+        default:
+            return nullptr;
+    }
+}
+#undef RESULT_CASE_STR
+
+static bool NamedAs(const char* name, const char* expected) { return nullptr != name && 0 == strcmp(name, expected); }
+
+// The label profiler settings are read once, by the first loader call that logs, so main sets them
+// before making any loader call.
+static const char kLabelProfileFileName[] = "loader_test_label_profile.csv";
+
+// Read the lines of the label profile written so far, split on commas, without the header and the
+// first skipped_count lines, which other tests wrote.
+static std::vector<std::vector<std::string>> ReadLabelProfileRows(size_t skipped_count) {
+    std::vector<std::vector<std::string>> rows;
+    std::ifstream in(kLabelProfileFileName);
+    std::string line;
+    std::getline(in, line);
+    for (size_t skipped = 0; skipped < skipped_count && std::getline(in, line); ++skipped) {
+    }
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::istringstream line_stream(line);
+        std::string field;
+        while (std::getline(line_stream, field, ',')) {
+            fields.push_back(field);
+        }
+        rows.push_back(fields);
+    }
+    return rows;
+}
+
+// Time session labels with the loader's label profiler, and check the CSV lines written for each
+// session when it ends or when the application asks for them.
+DEFINE_TEST(TestLabelProfiler) {
+    INIT_TEST(TestLabelProfiler)
+
+    try {
+        std::string current_path;
+        std::string runtime_path;
+        if (!FileSysUtilsGetCurrentPath(current_path) ||
+            !FileSysUtilsCombinePaths(current_path, "resources/runtimes/test_runtime.json", runtime_path)) {
+            TEST_FAIL("Unable to set runtime path")
+            TEST_REPORT(TestLabelProfiler)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_RUNTIME_JSON", runtime_path);
+        LoaderTestUnsetEnvironmentVariable("XR_ENABLE_API_LAYERS");
+        LoaderTestUnsetEnvironmentVariable("XR_API_LAYER_PATH");
+
+        ForceLoaderUnloadRuntime();
+
+        const char* const extension_names[1] = {XR_EXT_DEBUG_UTILS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+        strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+        instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+        XrInstance instance = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateInstance(&instance_create_info, &instance), XR_SUCCESS, "Creating instance with debug utils")
+
+        PFN_xrSessionBeginDebugUtilsLabelRegionEXT begin_region = nullptr;
+        PFN_xrSessionEndDebugUtilsLabelRegionEXT end_region = nullptr;
+        PFN_xrSessionInsertDebugUtilsLabelEXT insert_label = nullptr;
+        TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSessionBeginDebugUtilsLabelRegionEXT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&begin_region)),
+                   XR_SUCCESS, "Getting xrSessionBeginDebugUtilsLabelRegionEXT")
+        TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSessionEndDebugUtilsLabelRegionEXT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&end_region)),
+                   XR_SUCCESS, "Getting xrSessionEndDebugUtilsLabelRegionEXT")
+        TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrSessionInsertDebugUtilsLabelEXT",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&insert_label)),
+                   XR_SUCCESS, "Getting xrSessionInsertDebugUtilsLabelEXT")
+
+        if (begin_region != nullptr && end_region != nullptr && insert_label != nullptr) {
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession frame_session = XR_NULL_HANDLE;
+            XrSession loading_session = XR_NULL_HANDLE;
+            const size_t earlier_row_count = ReadLabelProfileRows(0).size();
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &frame_session), XR_SUCCESS, "Creating frame session")
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &loading_session), XR_SUCCESS, "Creating loading session")
+            const std::string frame_session_string = HandleToHexString(frame_session);
+            const std::string loading_session_string = HandleToHexString(loading_session);
+
+            XrDebugUtilsLabelEXT label{XR_TYPE_DEBUG_UTILS_LABEL_EXT};
+            label.labelName = "loading";
+            begin_region(loading_session, &label);
+            end_region(loading_session);
+
+            // One render label in ten lasts at least a millisecond, so its p50 is below that and its p95 above.
+            const uint32_t frame_count = 100;
+            const uint64_t slow_ns = 1000000;
+            for (uint32_t frame = 0; frame < frame_count; ++frame) {
+                label.labelName = "frame";
+                begin_region(frame_session, &label);
+                label.labelName = "update";
+                insert_label(frame_session, &label);
+                label.labelName = "render";
+                insert_label(frame_session, &label);
+                if (frame % 10 == 0) {
+                    auto start = std::chrono::steady_clock::now();
+                    while (std::chrono::steady_clock::now() - start < std::chrono::nanoseconds(slow_ns)) {
+                    }
+                }
+                end_region(frame_session);
+            }
+
+            TEST_EQUAL(xrDestroySession(frame_session), XR_SUCCESS, "Destroying frame session")
+            std::vector<std::vector<std::string>> rows = ReadLabelProfileRows(earlier_row_count);
+            // session, kind, label_path, count, mean_us, p50_us, p95_us, p99_us, max_us
+            std::vector<std::string> expected_rows[3] = {
+                {frame_session_string, "region", "\"frame\""},
+                {frame_session_string, "label", "\"frame/render\""},
+                {frame_session_string, "label", "\"frame/update\""},
+            };
+            TEST_EQUAL(rows.size(), size_t(3), "Destroying a session writes only its lines")
+            bool rows_match = rows.size() == 3;
+            bool counts_match = rows_match;
+            bool percentiles_ordered = rows_match;
+            for (size_t row = 0; rows_match && row < 3; ++row) {
+                rows_match = rows[row].size() == 9 && std::equal(expected_rows[row].begin(), expected_rows[row].end(), rows[row].begin());
+                if (rows_match) {
+                    counts_match = counts_match && std::stoull(rows[row][3]) == frame_count;
+                    double mean_us = std::stod(rows[row][4]);
+                    double p50_us = std::stod(rows[row][5]);
+                    double p95_us = std::stod(rows[row][6]);
+                    double p99_us = std::stod(rows[row][7]);
+                    double max_us = std::stod(rows[row][8]);
+                    percentiles_ordered = percentiles_ordered && p50_us <= p95_us && p95_us <= p99_us && p99_us <= max_us &&
+                                          mean_us <= max_us;
+                }
+            }
+            TEST_EQUAL(rows_match, true, "A line per label path of the destroyed session, sorted by path")
+            TEST_EQUAL(counts_match, true, "Every label of the destroyed session is counted")
+            TEST_EQUAL(percentiles_ordered, true, "Percentiles are ordered and no more than the maximum")
+            if (rows_match) {
+                bool slow_render_split = std::stod(rows[1][5]) < slow_ns / 1000.0 && std::stod(rows[1][6]) >= slow_ns / 1000.0;
+                TEST_EQUAL(slow_render_split, true, "Percentiles of the render label come from its durations")
+            }
+
+            // XR_LOADER_LABEL_PROFILE_FLUSH_LABEL of the loader
+            label.labelName = "XR_LOADER_LABEL_PROFILE_FLUSH";
+            insert_label(loading_session, &label);
+            rows = ReadLabelProfileRows(earlier_row_count);
+            bool flushed = rows.size() == 4 && rows[3].size() == 9 && rows[3][0] == loading_session_string &&
+                           rows[3][2] == "\"loading\"" && rows[3][3] == "1";
+            TEST_EQUAL(flushed, true, "The flush label writes the sessions still alive")
+
+            label.labelName = "loading";
+            begin_region(loading_session, &label);
+            end_region(loading_session);
+            TEST_EQUAL(xrDestroySession(loading_session), XR_SUCCESS, "Destroying loading session")
+            rows = ReadLabelProfileRows(earlier_row_count);
+            bool written_since = rows.size() == 5 && rows[4].size() == 9 && rows[4][0] == loading_session_string &&
+                                 rows[4][2] == "\"loading\"" && rows[4][3] == "1";
+            TEST_EQUAL(written_since, true, "A flushed session only writes what it timed since")
+        }
+
+        TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestLabelProfiler)
+}
+
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+// Find the statistics of a command, or return empty ones if it was never called.
+static XrLoaderCommandStatistics GetCommandStatistics(PFN_xrLoaderGetCommandStatistics get_command_statistics,
+                                                      const char* command_name) {
+    XrLoaderCommandStatistics found{};
+    uint32_t count = 0;
+    if (XR_FAILED(get_command_statistics(0, &count, nullptr))) {
+        return found;
+    }
+    std::vector<XrLoaderCommandStatistics> statistics(count);
+    if (XR_FAILED(get_command_statistics(count, &count, statistics.data()))) {
+        return found;
+    }
+    for (const XrLoaderCommandStatistics& command : statistics) {
+        if (strcmp(command.commandName, command_name) == 0) {
+            found = command;
+        }
+    }
+    return found;
+}
+
+// Count calls through the loader trampolines from several threads, and check the statistics the
+// loader returns for them.  main enables the statistics before making any loader call.
+DEFINE_TEST(TestCommandStatistics) {
+    INIT_TEST(TestCommandStatistics)
+
+    try {
+        std::string current_path;
+        std::string runtime_path;
+        if (!FileSysUtilsGetCurrentPath(current_path) ||
+            !FileSysUtilsCombinePaths(current_path, "resources/runtimes/test_runtime.json", runtime_path)) {
+            TEST_FAIL("Unable to set runtime path")
+            TEST_REPORT(TestCommandStatistics)
+            return;
+        }
+        LoaderTestSetEnvironmentVariable("XR_RUNTIME_JSON", runtime_path);
+        LoaderTestUnsetEnvironmentVariable("XR_ENABLE_API_LAYERS");
+        LoaderTestUnsetEnvironmentVariable("XR_API_LAYER_PATH");
+
+        ForceLoaderUnloadRuntime();
+
+        XrInstanceCreateInfo instance_create_info{XR_TYPE_INSTANCE_CREATE_INFO};
+        strcpy(instance_create_info.applicationInfo.applicationName, "Loader Test");
+        instance_create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+        XrInstance instance = XR_NULL_HANDLE;
+        TEST_EQUAL(xrCreateInstance(&instance_create_info, &instance), XR_SUCCESS, "Creating instance")
+
+        PFN_xrLoaderGetCommandStatistics get_command_statistics = nullptr;
+        TEST_EQUAL(xrGetInstanceProcAddr(instance, "xrLoaderGetCommandStatistics",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&get_command_statistics)),
+                   XR_SUCCESS, "Getting xrLoaderGetCommandStatistics")
+        if (get_command_statistics != nullptr) {
+            uint32_t command_count = 0;
+            TEST_EQUAL(get_command_statistics(0, &command_count, nullptr), XR_SUCCESS, "Getting the number of called commands")
+            TEST_EQUAL(command_count > 0, true, "Commands called by the earlier tests are counted")
+            XrLoaderCommandStatistics one_command{};
+            uint32_t too_few_count = 0;
+            XrResult too_few_result = get_command_statistics(1, &too_few_count, &one_command);
+            XrResult expected_too_few_result = command_count > 1 ? XR_ERROR_SIZE_INSUFFICIENT : XR_SUCCESS;
+            TEST_EQUAL(too_few_result, expected_too_few_result, "Getting statistics with too little room")
+            TEST_EQUAL(get_command_statistics(0, nullptr, nullptr), XR_ERROR_VALIDATION_FAILURE,
+                       "Getting statistics without a count output")
+
+            XrLoaderCommandStatistics before = GetCommandStatistics(get_command_statistics, "xrGetSystem");
+            const uint32_t thread_count = 4;
+            const uint32_t calls_per_thread = 1000;
+            std::vector<std::thread> threads;
+            std::atomic<uint32_t> failed_calls{0};
+            for (uint32_t thread = 0; thread < thread_count; ++thread) {
+                threads.emplace_back([&]() {
+                    XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+                    system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+                    XrSystemId system_id;
+                    for (uint32_t call = 0; call < calls_per_thread; ++call) {
+                        if (XR_FAILED(xrGetSystem(instance, &system_get_info, &system_id))) {
+                            failed_calls++;
+                        }
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            TEST_EQUAL(failed_calls.load(), 0u, "xrGetSystem from several threads")
+
+            XrLoaderCommandStatistics after = GetCommandStatistics(get_command_statistics, "xrGetSystem");
+            TEST_EQUAL(after.callCount - before.callCount, uint64_t(thread_count * calls_per_thread),
+                       "Every call from every thread is counted")
+            TEST_EQUAL(after.totalDuration > before.totalDuration, true, "The calls add to the total duration")
+            bool percentiles_ordered = after.p50Duration <= after.p95Duration && after.p95Duration <= after.p99Duration &&
+                                       after.p99Duration <= after.maxDuration && after.maxDuration <= after.totalDuration;
+            TEST_EQUAL(percentiles_ordered, true, "Percentiles are ordered and no more than the maximum")
+            TEST_EQUAL(after.p50Duration > 0, true, "The median comes from the recorded durations")
+        }
+
+        TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestCommandStatistics)
+}
+#endif  // XRLOADER_ENABLE_COMMAND_STATS
+
+// Allocation callbacks that count what they allocate and free.  Each block keeps its size and start in
+// front of the memory handed out.
+struct CountedAllocations {
+    std::atomic<uint64_t> allocation_count{0};
+    std::atomic<uint64_t> free_count{0};
+    std::atomic<uint64_t> current_bytes{0};
+};
+
+static void* XRAPI_CALL CountedAllocationsAllocate(void* user_data, size_t size, size_t alignment) {
+    auto* counted = static_cast<CountedAllocations*>(user_data);
+    auto* block = static_cast<uint8_t*>(std::malloc(size + alignment + 2 * sizeof(uintptr_t)));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    uintptr_t address = reinterpret_cast<uintptr_t>(block) + 2 * sizeof(uintptr_t);
+    auto* memory = reinterpret_cast<uintptr_t*>((address + alignment - 1) / alignment * alignment);
+    memory[-1] = reinterpret_cast<uintptr_t>(block);
+    memory[-2] = size;
+    counted->allocation_count++;
+    counted->current_bytes += size;
+    return memory;
+}
+
+static void XRAPI_CALL CountedAllocationsFree(void* user_data, void* memory) {
+    auto* counted = static_cast<CountedAllocations*>(user_data);
+    auto* header = static_cast<uintptr_t*>(memory);
+    counted->free_count++;
+    counted->current_bytes -= header[-2];
+    std::free(reinterpret_cast<void*>(header[-1]));
+}
+
+// Route the allocations of the loader and the core validation layer through counting callbacks, and
+// check that all of them are freed by xrDestroyInstance.
+DEFINE_TEST(TestAllocationCallbacks) {
+    INIT_TEST(TestAllocationCallbacks)
+
+    try {
+        // An allocation remembers the callbacks that made it, and goes back to them once others are installed.
+        CountedAllocations direct;
+        const XrLoaderAllocationCallbacks direct_callbacks = {&direct, CountedAllocationsAllocate, CountedAllocationsFree};
+        XrSdkSetAllocationCallbacks(&direct_callbacks);
+        void* memory = XrSdkAllocate(100, 64);
+        XrSdkSetAllocationCallbacks(nullptr);
+        TEST_EQUAL(reinterpret_cast<uintptr_t>(memory) % 64, uintptr_t(0), "XrSdkAllocate aligns as asked")
+        TEST_EQUAL(direct.allocation_count.load(), uint64_t(1), "XrSdkAllocate goes through the installed callbacks")
+        XrSdkFree(memory);
+        TEST_EQUAL(direct.free_count.load(), uint64_t(1), "XrSdkFree goes through the callbacks that allocated")
+        TEST_EQUAL(direct.current_bytes.load(), uint64_t(0), "XrSdkFree frees the whole allocation")
+
+        if (!UseTestRuntimeWithBuiltLayers()) {
+            TEST_FAIL("Unable to set runtime and API layer paths")
+            TEST_REPORT(TestAllocationCallbacks)
+            return;
+        }
+        ForceLoaderUnloadRuntime();
+
+        PFN_xrLoaderSetAllocationCallbacks set_allocation_callbacks = nullptr;
+        PFN_xrLoaderGetAllocationStatistics get_allocation_statistics = nullptr;
+        TEST_EQUAL(xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrLoaderSetAllocationCallbacks",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&set_allocation_callbacks)),
+                   XR_SUCCESS, "Getting xrLoaderSetAllocationCallbacks")
+        TEST_EQUAL(xrGetInstanceProcAddr(XR_NULL_HANDLE, "xrLoaderGetAllocationStatistics",
+                                         reinterpret_cast<PFN_xrVoidFunction*>(&get_allocation_statistics)),
+                   XR_SUCCESS, "Getting xrLoaderGetAllocationStatistics")
+        if (set_allocation_callbacks == nullptr || get_allocation_statistics == nullptr) {
+            TEST_REPORT(TestAllocationCallbacks)
+            return;
+        }
+        const XrLoaderAllocationCallbacks no_free_callbacks = {nullptr, CountedAllocationsAllocate, nullptr};
+        TEST_EQUAL(set_allocation_callbacks(&no_free_callbacks), XR_ERROR_VALIDATION_FAILURE,
+                   "Installing callbacks without a free function")
+
+        CountedAllocations counted;
+        const XrLoaderAllocationCallbacks callbacks = {&counted, CountedAllocationsAllocate, CountedAllocationsFree};
+        XrLoaderAllocationStatistics loader_before{};
+        XrLoaderAllocationStatistics layer_before{};
+        get_allocation_statistics(&loader_before, &layer_before);
+        TEST_EQUAL(set_allocation_callbacks(&callbacks), XR_SUCCESS, "Installing counting callbacks")
+
+        const char* const extension_names[1] = {XR_MND_HEADLESS_EXTENSION_NAME};
+        XrInstanceCreateInfo instance_create_info = BuiltLayerInstanceCreateInfo(&kCoreValidationLayerName);
+        instance_create_info.enabledExtensionCount = 1;
+        instance_create_info.enabledExtensionNames = extension_names;
+        XrInstance instance = XR_NULL_HANDLE;
+        // Enough spaces for the handle tables to be replaced by larger ones.
+        std::vector<XrSpace> spaces(256, XR_NULL_HANDLE);
+        XrResult create_result = xrCreateInstance(&instance_create_info, &instance);
+        TEST_LAYER_INSTANCE(kCoreValidationLayerName, create_result, "Creating instance with the core validation layer")
+        if (XR_SUCCEEDED(create_result)) {
+            // Reading the manifests while the instance is created goes through JsonCpp, which only has the global
+            // operator new, but from there on everything goes through the callbacks.
+            uint64_t new_count = g_global_new_count.load();
+            XrSystemGetInfo system_get_info{XR_TYPE_SYSTEM_GET_INFO};
+            system_get_info.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
+            XrSystemId system_id = XR_NULL_SYSTEM_ID;
+            TEST_EQUAL(xrGetSystem(instance, &system_get_info, &system_id), XR_SUCCESS, "xrGetSystem")
+            XrSessionCreateInfo session_create_info{XR_TYPE_SESSION_CREATE_INFO};
+            session_create_info.systemId = system_id;
+            XrSession session = XR_NULL_HANDLE;
+            TEST_EQUAL(xrCreateSession(instance, &session_create_info, &session), XR_SUCCESS, "xrCreateSession")
+            XrReferenceSpaceCreateInfo space_create_info{XR_TYPE_REFERENCE_SPACE_CREATE_INFO};
+            space_create_info.poseInReferenceSpace.orientation.w = 1.0f;
+            space_create_info.referenceSpaceType = XR_REFERENCE_SPACE_TYPE_LOCAL;
+            XrResult space_result = XR_SUCCESS;
+            for (size_t index = 0; XR_SUCCEEDED(space_result) && index < spaces.size(); ++index) {
+                space_result = xrCreateReferenceSpace(session, &space_create_info, &spaces[index]);
+            }
+            TEST_EQUAL(space_result, XR_SUCCESS, "Creating spaces")
+            XrSpaceLocation location{XR_TYPE_SPACE_LOCATION};
+            TEST_EQUAL(xrLocateSpace(spaces.front(), spaces.back(), 1, &location), XR_SUCCESS, "xrLocateSpace")
+            TEST_EQUAL(xrDestroySession(session), XR_SUCCESS, "xrDestroySession")
+
+            XrLoaderAllocationStatistics loader_during{};
+            XrLoaderAllocationStatistics layer_during{};
+            TEST_EQUAL(get_allocation_statistics(&loader_during, &layer_during), XR_SUCCESS, "Getting allocation statistics")
+            TEST_EQUAL(layer_during.allocationCount > layer_before.allocationCount, true, "The API layer allocates through the loader")
+            new_count = g_global_new_count.load() - new_count;
+            TEST_EQUAL(new_count, uint64_t(0), "Nothing uses the global operator new while the instance is alive")
+
+            // What was allocated with the callbacks still goes back to them once they are removed.
+            TEST_EQUAL(set_allocation_callbacks(nullptr), XR_SUCCESS, "Removing the callbacks")
+            TEST_EQUAL(xrDestroyInstance(instance), XR_SUCCESS, "Destroying instance")
+            ForceLoaderUnloadRuntime();
+
+            XrLoaderAllocationStatistics loader_after{};
+            XrLoaderAllocationStatistics layer_after{};
+            get_allocation_statistics(&loader_after, &layer_after);
+            cout << "        " << counted.allocation_count.load() << " allocations through the callbacks, "
+                 << counted.current_bytes.load() << " bytes left after xrDestroyInstance" << endl;
+            TEST_EQUAL(counted.free_count.load(), counted.allocation_count.load(),
+                       "Everything allocated through the callbacks is freed by xrDestroyInstance")
+            TEST_EQUAL(layer_after.currentBytes, layer_before.currentBytes, "The API layer frees all its memory")
+            TEST_EQUAL(loader_after.currentBytes, loader_before.currentBytes, "The loader frees all its memory")
+        }
+        set_allocation_callbacks(nullptr);
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Cleanup
+    CleanupEnvironmentVariables();
+
+    // Output results for this test
+    TEST_REPORT(TestAllocationCallbacks)
+}
+
+// Test the generated reflection tables against openxr_reflection.h, and time their lookups.
+DEFINE_TEST(TestReflectionTables) {
+    INIT_TEST(TestReflectionTables)
+
+    try {
+        // The lists of enum values end with a value no enumerant has, which the tables do not name.
+        uint32_t wrong_results = 0;
+#define CHECK_RESULT_NAME(name, value) \
+    wrong_results += value != 0x7FFFFFFF && !NamedAs(ReflectionResultName(name), #name) ? 1 : 0;
+        XR_LIST_ENUM_XrResult(CHECK_RESULT_NAME)
+#undef CHECK_RESULT_NAME
+        TEST_EQUAL(wrong_results, 0u, "Naming every result")
+
+        uint32_t wrong_structure_types = 0;
+#define CHECK_STRUCTURE_TYPE_NAME(name, value) \
+    wrong_structure_types += value != 0x7FFFFFFF && !NamedAs(ReflectionStructureTypeName(name), #name) ? 1 : 0;
+        XR_LIST_ENUM_XrStructureType(CHECK_STRUCTURE_TYPE_NAME)
+#undef CHECK_STRUCTURE_TYPE_NAME
+        TEST_EQUAL(wrong_structure_types, 0u, "Naming every structure type")
+
+        uint32_t wrong_object_types = 0;
+#define CHECK_OBJECT_TYPE_NAME(name, value) \
+    wrong_object_types += value != 0x7FFFFFFF && !NamedAs(ReflectionObjectTypeName(name), #name) ? 1 : 0;
+        XR_LIST_ENUM_XrObjectType(CHECK_OBJECT_TYPE_NAME)
+#undef CHECK_OBJECT_TYPE_NAME
+        TEST_EQUAL(wrong_object_types, 0u, "Naming every object type")
+        const ReflectionObjectTypeInfo* session_info = ReflectionGetObjectTypeInfo(XR_OBJECT_TYPE_SESSION);
+        const bool session_handle_named = nullptr != session_info && NamedAs(session_info->handle_name, "XrSession");
+        TEST_EQUAL(session_handle_named, true, "Handle type of an object type")
+
+        uint32_t wrong_structs = 0;
+#define CHECK_STRUCT_INFO(structure, type)                                                                 \
+    {                                                                                                      \
+        const ReflectionStructInfo* info = ReflectionGetStructInfo(type);                                 \
+        wrong_structs += nullptr == info || !NamedAs(info->struct_name, #structure) ||                     \
+                                 info->size != sizeof(structure) || info->alignment != alignof(structure) \
+                             ? 1                                                                           \
+                             : 0;                                                                          \
+    }
+        XR_LIST_STRUCTURE_TYPES(CHECK_STRUCT_INFO)
+#undef CHECK_STRUCT_INFO
+        TEST_EQUAL(wrong_structs, 0u, "Name, size and alignment of every structure")
+        TEST_EQUAL(ReflectionStructAllowsNext(XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW, XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR),
+                   true, "Structure allowed in a next chain")
+        TEST_EQUAL(ReflectionStructAllowsNext(XR_TYPE_FRAME_END_INFO, XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR), false,
+                   "Structure not allowed in a next chain")
+
+        uint32_t wrong_commands = 0;
+        for (uint32_t command = 0; command < REFLECTION_COMMAND_COUNT; ++command) {
+            wrong_commands += ReflectionCommandFromName(g_reflection_command_names[command]) != command ? 1 : 0;
+        }
+        TEST_EQUAL(wrong_commands, 0u, "Looking up every command by name")
+        TEST_EQUAL(ReflectionCommandFromName("xrCreateInstance"), REFLECTION_COMMAND_XR_CREATE_INSTANCE, "Looking up a command")
+        TEST_EQUAL(ReflectionCommandFromName("xrCreateInstanceX"), REFLECTION_COMMAND_COUNT, "Looking up an unknown command")
+        TEST_EQUAL(ReflectionCommandFromName("xrCreateApiLayerInstance"), REFLECTION_COMMAND_COUNT,
+                   "Looking up a loader command")
+        TEST_EQUAL(ReflectionCommandFromName(""), REFLECTION_COMMAND_COUNT, "Looking up an empty name")
+
+        TEST_EQUAL(ReflectionResultName(static_cast<XrResult>(-999)) == nullptr, true, "Naming an unknown result")
+        TEST_EQUAL(ReflectionStructureTypeName(static_cast<XrStructureType>(2000000000)) == nullptr, true,
+                   "Naming an unknown structure type")
+        TEST_EQUAL(ReflectionStructureTypeName(static_cast<XrStructureType>(14)) == nullptr, true,
+                   "Naming a structure type in a hole")
+        TEST_EQUAL(ReflectionObjectTypeName(static_cast<XrObjectType>(-1)) == nullptr, true, "Naming an unknown object type")
+
+        // Time naming results with a switch and looking up commands by comparing names, as the generated
+        // xrGetInstanceProcAddr functions did, against the tables.
+        std::vector<XrResult> results;
+#define ADD_RESULT(name, value) \
+    if (value != 0x7FFFFFFF) {  \
+        results.push_back(name); \
+    }
+        XR_LIST_ENUM_XrResult(ADD_RESULT)
+#undef ADD_RESULT
+        // In a fixed order, the branches of the switch would be predicted every time.
+        std::shuffle(results.begin(), results.end(), std::mt19937(0));
+        const uint32_t lookup_rounds = 20000;
+        size_t switch_sink = 0;
+        size_t table_sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < lookup_rounds; ++round) {
+            for (XrResult result : results) {
+                switch_sink += reinterpret_cast<uintptr_t>(ResultNameFromSwitch(result));
+            }
+        }
+        double switch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < lookup_rounds; ++round) {
+            for (XrResult result : results) {
+                table_sink += reinterpret_cast<uintptr_t>(ReflectionResultName(result));
+            }
+        }
+        double table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        TEST_EQUAL(table_sink, switch_sink, "Switch and table name the same results")
+        const double result_lookups = static_cast<double>(lookup_rounds) * results.size();
+        cout << "        Naming results with a switch: " << static_cast<uint64_t>(result_lookups / switch_seconds)
+             << " per second, with the table: " << static_cast<uint64_t>(result_lookups / table_seconds) << " per second"
+             << endl;
+
+        const uint32_t command_rounds = 200;
+        size_t compare_sink = 0;
+        table_sink = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < command_rounds; ++round) {
+            for (const char* name : g_reflection_command_names) {
+                const std::string func_name = name;
+                uint32_t command = 0;
+                while (command < REFLECTION_COMMAND_COUNT && func_name != g_reflection_command_names[command]) {
+                    ++command;
+                }
+                compare_sink += command;
+            }
+        }
+        double compare_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < command_rounds; ++round) {
+            for (const char* name : g_reflection_command_names) {
+                table_sink += ReflectionCommandFromName(name);
+            }
+        }
+        table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        TEST_EQUAL(table_sink, compare_sink, "Comparing names and the table find the same commands")
+        const double command_lookups = static_cast<double>(command_rounds) * REFLECTION_COMMAND_COUNT;
+        cout << "        Looking up commands by comparing names: " << static_cast<uint64_t>(command_lookups / compare_seconds)
+             << " per second, with the table: " << static_cast<uint64_t>(command_lookups / table_seconds) << " per second"
+             << endl;
+    } catch (...) {
+        TEST_FAIL("Exception triggered during test, automatic failure")
+    }
+
+    // Output results for this test
+    TEST_REPORT(TestReflectionTables)
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t total_tests = 0;
+    uint32_t total_passed = 0;
+    uint32_t total_skipped = 0;
+    uint32_t total_failed = 0;
+
+    // Unused for now.
+    (void)argc;
+    (void)argv;
+
+#if FILTER_OUT_LOADER_ERRORS == 1
+    // Re-direct std::cerr to a string since we're intentionally causing errors and we don't
+    // want it polluting the output stream.
+    std::stringstream buffer;
+    std::streambuf* original_cerr = nullptr;
+    original_cerr = std::cerr.rdbuf(buffer.rdbuf());
+#endif
+
+    cout << "Starting loader_test" << endl << "--------------------" << endl;
+
+    std::remove(kLabelProfileFileName);
+    LoaderTestSetEnvironmentVariable("XR_LOADER_LABEL_PROFILE", kLabelProfileFileName);
+    LoaderTestSetEnvironmentVariable("XR_LOADER_LABEL_PROFILE_FORMAT", "csv");
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+    LoaderTestSetEnvironmentVariable("XR_LOADER_COMMAND_STATS", "1");
+#endif
+
+    g_has_installed_runtime = DetectInstalledRuntime();
+
+    TestEnumLayers(total_tests, total_passed, total_skipped, total_failed);
+    TestEnumInstanceExtensions(total_tests, total_passed, total_skipped, total_failed);
+
+    if (g_has_installed_runtime) {
+        cout << "Installed XR runtime detected - doing active runtime tests" << endl;
+        cout << "----------------------------------------------------------" << endl;
+        TestCreateDestroyInstance(total_tests, total_passed, total_skipped, total_failed);
+        TestGetSystem(total_tests, total_passed, total_skipped, total_failed);
+        TestCreateDestroySession(total_tests, total_passed, total_skipped, total_failed);
+    } else {
+        cout << "No installed XR runtime detected - active runtime tests skipped(!)" << endl;
+    }
+
+    if (g_debug_utils_exists) {
+        TestDebugUtils(total_tests, total_passed, total_skipped, total_failed);
+    }
+
+    TestMultipleInstances(total_tests, total_passed, total_skipped, total_failed);
+    TestEnabledExtensions(total_tests, total_passed, total_skipped, total_failed);
+    TestConcurrentHandleRegistry(total_tests, total_passed, total_skipped, total_failed);
+    TestApiDumpFrameEnd(total_tests, total_passed, total_skipped, total_failed);
+    TestApiDumpGoldenOutput(total_tests, total_passed, total_skipped, total_failed);
+    TestApiDumpCapture(total_tests, total_passed, total_skipped, total_failed);
+    TestApiDumpFilter(total_tests, total_passed, total_skipped, total_failed);
+    TestApiDumpJsonLines(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationLocateSpace(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationSessionTeardown(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationAllocations(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationNextChain(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationSampling(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationMemoization(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationMessageLimit(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationMessageOutput(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationPerformanceChecks(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationCallOverhead(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationStructTables(total_tests, total_passed, total_skipped, total_failed);
+    TestCoreValidationAsync(total_tests, total_passed, total_skipped, total_failed);
+    TestReflectionTables(total_tests, total_passed, total_skipped, total_failed);
+    TestLabelProfiler(total_tests, total_passed, total_skipped, total_failed);
+    TestAllocationCallbacks(total_tests, total_passed, total_skipped, total_failed);
+#ifdef XRLOADER_ENABLE_COMMAND_STATS
+    TestCommandStatistics(total_tests, total_passed, total_skipped, total_failed);
+#endif
 
 #if FILTER_OUT_LOADER_ERRORS == 1
     // Restore std::cerr to the original buffer
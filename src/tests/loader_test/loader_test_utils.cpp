@@ -28,6 +28,7 @@
 #include "xr_dependencies.h"
 #include <openxr/openxr.h>
 
+#include <new>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -99,3 +100,40 @@ bool LoaderTestUnsetEnvironmentVariable(const std::string &variable) {
 #error "Unsupported platform"
 
 #endif
+
+// The replacements of the global operator new and delete live here rather than next to the tests, so
+// the compiler cannot inline them into the tests and see a pointer from operator new reach free.
+// Every replaceable form of C++14 is defined, so that no allocation is made by one pair of functions
+// and freed by another.
+std::atomic<uint64_t> g_global_new_count{0};
+
+static void *CountedAllocate(size_t size) noexcept {
+    g_global_new_count++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(size_t size) {
+    void *memory = CountedAllocate(size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t size) {
+    void *memory = CountedAllocate(size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size); }
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete[](void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+void operator delete[](void *memory, size_t) noexcept { free(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { free(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { free(memory); }
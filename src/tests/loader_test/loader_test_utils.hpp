@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 #if defined(XR_OS_LINUX) || defined(XR_OS_APPLE)
@@ -39,3 +41,7 @@
 bool LoaderTestSetEnvironmentVariable(const std::string& variable, const std::string& value);
 bool LoaderTestGetEnvironmentVariable(const std::string& variable, std::string& value);
 bool LoaderTestUnsetEnvironmentVariable(const std::string& variable);
+
+// Counts the allocations made with the global operator new.  Where the platform resolves operator new
+// across modules, as on Linux, this includes the allocations made by the loader and the API layers.
+extern std::atomic<uint64_t> g_global_new_count;
@@ -19,6 +19,9 @@
 // Author: Mark Young <marky@lunarg.com>
 //
 
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 
@@ -35,10 +38,17 @@
 #define RUNTIME_EXPORT
 #endif
 
+// Every handle of every type gets a value of its own, as with a runtime that hands out pointers, since the
+// loader and the API layers track the handles of every type together.
+static uint64_t NextHandle() {
+    static std::atomic<uint64_t> next_handle{1};
+    return next_handle.fetch_add(1);
+}
+
 extern "C" {
 
 XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateInstance(const XrInstanceCreateInfo * /* info */, XrInstance *instance) {
-    *instance = (XrInstance)1;
+    *instance = (XrInstance)NextHandle();
     return XR_SUCCESS;
 }
 
@@ -51,13 +61,18 @@ XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrEnumerateInstanceExtensionProperties
     if (nullptr != layerName) {
         return XR_ERROR_API_LAYER_NOT_PRESENT;
     }
-    // Return 2 fake extensions, just to test
-    *propertyCountOutput = 2;
+    // Return 2 fake extensions, just to test, headless so that sessions can be created without a graphics API,
+    // and spatial anchors, whose handles only commands from xrGetInstanceProcAddr create.
+    *propertyCountOutput = 4;
     if (0 != propertyCapacityInput) {
         strcpy(properties[0].extensionName, "XR_KHR_fake_ext1");
         properties[0].extensionVersion = 57;
         strcpy(properties[1].extensionName, "XR_KHR_fake_ext2");
         properties[1].extensionVersion = 3;
+        strcpy(properties[2].extensionName, XR_MND_HEADLESS_EXTENSION_NAME);
+        properties[2].extensionVersion = XR_MND_headless_SPEC_VERSION;
+        strcpy(properties[3].extensionName, XR_MSFT_SPATIAL_ANCHOR_EXTENSION_NAME);
+        properties[3].extensionVersion = XR_MSFT_spatial_anchor_SPEC_VERSION;
     }
     return XR_SUCCESS;
 }
@@ -88,6 +103,233 @@ XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrGetSystemProperties(XrInstance insta
     return XR_SUCCESS;
 }
 
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateSession(XrInstance instance, const XrSessionCreateInfo * /* createInfo */,
+                                                          XrSession *session) {
+    if (instance == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *session = (XrSession)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroySession(XrSession session) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+// Frames are 11 ms apart and always rendered.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrWaitFrame(XrSession session, const XrFrameWaitInfo * /* frameWaitInfo */,
+                                                      XrFrameState *frameState) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    static std::atomic<XrTime> next_display_time{11000000};
+    frameState->predictedDisplayPeriod = 11000000;
+    frameState->predictedDisplayTime = next_display_time.fetch_add(frameState->predictedDisplayPeriod);
+    frameState->shouldRender = XR_TRUE;
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrBeginFrame(XrSession session, const XrFrameBeginInfo * /* frameBeginInfo */) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+// Accepts any frame without looking at it.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrEndFrame(XrSession session, const XrFrameEndInfo * /* frameEndInfo */) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+// Two views at the origin, looking straight ahead.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrLocateViews(XrSession session, const XrViewLocateInfo * /* viewLocateInfo */,
+                                                        XrViewState *viewState, uint32_t viewCapacityInput,
+                                                        uint32_t *viewCountOutput, XrView *views) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    viewState->viewStateFlags = 0;
+    *viewCountOutput = 2;
+    if (viewCapacityInput == 0) {
+        return XR_SUCCESS;
+    }
+    if (viewCapacityInput < 2) {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    for (uint32_t view = 0; view < 2; ++view) {
+        views[view].pose = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
+        views[view].fov = {-0.7f, 0.7f, 0.7f, -0.7f};
+    }
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo * /* createInfo */,
+                                                            XrSwapchain *swapchain) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *swapchain = (XrSwapchain)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroySwapchain(XrSwapchain swapchain) {
+    return swapchain == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateReferenceSpace(XrSession session,
+                                                                 const XrReferenceSpaceCreateInfo * /* createInfo */,
+                                                                 XrSpace *space) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *space = (XrSpace)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroySpace(XrSpace space) {
+    return space == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateSpatialAnchorMSFT(XrSession session,
+                                                                    const XrSpatialAnchorCreateInfoMSFT * /* createInfo */,
+                                                                    XrSpatialAnchorMSFT *anchor) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *anchor = (XrSpatialAnchorMSFT)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateSpatialAnchorSpaceMSFT(XrSession session,
+                                                                         const XrSpatialAnchorSpaceCreateInfoMSFT * /* createInfo */,
+                                                                         XrSpace *space) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *space = (XrSpace)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroySpatialAnchorMSFT(XrSpatialAnchorMSFT anchor) {
+    return anchor == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrEnumerateReferenceSpaces(XrSession session, uint32_t spaceCapacityInput,
+                                                                     uint32_t *spaceCountOutput, XrReferenceSpaceType *spaces) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    const XrReferenceSpaceType reference_spaces[3] = {XR_REFERENCE_SPACE_TYPE_VIEW, XR_REFERENCE_SPACE_TYPE_LOCAL,
+                                                      XR_REFERENCE_SPACE_TYPE_STAGE};
+    *spaceCountOutput = 3;
+    if (spaceCapacityInput == 0) {
+        return XR_SUCCESS;
+    }
+    if (spaceCapacityInput < 3) {
+        return XR_ERROR_SIZE_INSUFFICIENT;
+    }
+    for (uint32_t space = 0; space < 3; ++space) {
+        spaces[space] = reference_spaces[space];
+    }
+    return XR_SUCCESS;
+}
+
+// Every space is at the origin of every other one, and none of them is tracked.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrLocateSpace(XrSpace space, XrSpace baseSpace, XrTime /* time */,
+                                                        XrSpaceLocation *location) {
+    if (space == XR_NULL_HANDLE || baseSpace == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    location->locationFlags = 0;
+    location->pose = {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
+    return XR_SUCCESS;
+}
+
+// Paths are never turned back into strings, so each call just returns a new path.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrStringToPath(XrInstance instance, const char * /* pathString */, XrPath *path) {
+    if (instance == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    static std::atomic<uint64_t> next_path{1};
+    *path = next_path.fetch_add(1);
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateActionSet(XrInstance instance, const XrActionSetCreateInfo * /* createInfo */,
+                                                            XrActionSet *actionSet) {
+    if (instance == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *actionSet = (XrActionSet)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroyActionSet(XrActionSet actionSet) {
+    return actionSet == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrCreateAction(XrActionSet actionSet, const XrActionCreateInfo * /* createInfo */,
+                                                         XrAction *action) {
+    if (actionSet == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    *action = (XrAction)NextHandle();
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrDestroyAction(XrAction action) {
+    return action == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrSyncActions(XrSession session, const XrActionsSyncInfo * /* syncInfo */) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+// No action is ever bound, so none of them is active.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrGetActionStateBoolean(XrSession session, const XrActionStateGetInfo * /* getInfo */,
+                                                                  XrActionStateBoolean *state) {
+    if (session == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    state->currentState = XR_FALSE;
+    state->changedSinceLastSync = XR_FALSE;
+    state->lastChangeTime = 0;
+    state->isActive = XR_FALSE;
+    return XR_SUCCESS;
+}
+
+// Session labels are only kept by the loader and API layers, so they are just accepted here.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrSessionBeginDebugUtilsLabelRegionEXT(XrSession session,
+                                                                                 const XrDebugUtilsLabelEXT * /* labelInfo */) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrSessionEndDebugUtilsLabelRegionEXT(XrSession session) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrSessionInsertDebugUtilsLabelEXT(XrSession session,
+                                                                            const XrDebugUtilsLabelEXT * /* labelInfo */) {
+    return session == XR_NULL_HANDLE ? XR_ERROR_HANDLE_INVALID : XR_SUCCESS;
+}
+
+// The test runtime knows no names, so every value is reported the way the specification requires for unknown ones.
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrResultToString(XrInstance instance, XrResult value,
+                                                           char buffer[XR_MAX_RESULT_STRING_SIZE]) {
+    if (instance == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, XR_SUCCEEDED(value) ? "XR_UNKNOWN_SUCCESS_%d" : "XR_UNKNOWN_FAILURE_%d",
+             static_cast<int>(value));
+    return XR_SUCCESS;
+}
+
+XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrStructureTypeToString(XrInstance instance, XrStructureType value,
+                                                                  char buffer[XR_MAX_STRUCTURE_NAME_SIZE]) {
+    if (instance == XR_NULL_HANDLE) {
+        return XR_ERROR_HANDLE_INVALID;
+    }
+    snprintf(buffer, XR_MAX_STRUCTURE_NAME_SIZE, "XR_UNKNOWN_STRUCTURE_TYPE_%d", static_cast<int>(value));
+    return XR_SUCCESS;
+}
+
 XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrGetInstanceProcAddr(XrInstance instance, const char *name,
                                                                 PFN_xrVoidFunction *function) {
     if (0 == strcmp(name, "xrGetInstanceProcAddr")) {
@@ -106,6 +348,60 @@ XRAPI_ATTR XrResult XRAPI_CALL RuntimeTestXrGetInstanceProcAddr(XrInstance insta
         *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrGetSystem);
     } else if (0 == strcmp(name, "xrGetSystemProperties")) {
         *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrGetSystemProperties);
+    } else if (0 == strcmp(name, "xrCreateSession")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateSession);
+    } else if (0 == strcmp(name, "xrDestroySession")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroySession);
+    } else if (0 == strcmp(name, "xrWaitFrame")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrWaitFrame);
+    } else if (0 == strcmp(name, "xrBeginFrame")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrBeginFrame);
+    } else if (0 == strcmp(name, "xrEndFrame")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrEndFrame);
+    } else if (0 == strcmp(name, "xrLocateViews")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrLocateViews);
+    } else if (0 == strcmp(name, "xrCreateSwapchain")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateSwapchain);
+    } else if (0 == strcmp(name, "xrDestroySwapchain")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroySwapchain);
+    } else if (0 == strcmp(name, "xrCreateReferenceSpace")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateReferenceSpace);
+    } else if (0 == strcmp(name, "xrDestroySpace")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroySpace);
+    } else if (0 == strcmp(name, "xrCreateSpatialAnchorMSFT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateSpatialAnchorMSFT);
+    } else if (0 == strcmp(name, "xrCreateSpatialAnchorSpaceMSFT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateSpatialAnchorSpaceMSFT);
+    } else if (0 == strcmp(name, "xrDestroySpatialAnchorMSFT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroySpatialAnchorMSFT);
+    } else if (0 == strcmp(name, "xrEnumerateReferenceSpaces")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrEnumerateReferenceSpaces);
+    } else if (0 == strcmp(name, "xrLocateSpace")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrLocateSpace);
+    } else if (0 == strcmp(name, "xrStringToPath")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrStringToPath);
+    } else if (0 == strcmp(name, "xrCreateActionSet")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateActionSet);
+    } else if (0 == strcmp(name, "xrDestroyActionSet")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroyActionSet);
+    } else if (0 == strcmp(name, "xrCreateAction")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrCreateAction);
+    } else if (0 == strcmp(name, "xrDestroyAction")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrDestroyAction);
+    } else if (0 == strcmp(name, "xrSyncActions")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrSyncActions);
+    } else if (0 == strcmp(name, "xrGetActionStateBoolean")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrGetActionStateBoolean);
+    } else if (0 == strcmp(name, "xrSessionBeginDebugUtilsLabelRegionEXT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrSessionBeginDebugUtilsLabelRegionEXT);
+    } else if (0 == strcmp(name, "xrSessionEndDebugUtilsLabelRegionEXT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrSessionEndDebugUtilsLabelRegionEXT);
+    } else if (0 == strcmp(name, "xrSessionInsertDebugUtilsLabelEXT")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrSessionInsertDebugUtilsLabelEXT);
+    } else if (0 == strcmp(name, "xrResultToString")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrResultToString);
+    } else if (0 == strcmp(name, "xrStructureTypeToString")) {
+        *function = reinterpret_cast<PFN_xrVoidFunction>(RuntimeTestXrStructureTypeToString);
     } else {
         *function = nullptr;
     }
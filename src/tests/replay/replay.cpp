@@ -0,0 +1,298 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Replays a capture made by the api_dump layer in capture mode through the loader, and reports how
+// long each command took in the capture and in the replay.
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#define _CRT_SECURE_NO_WARNINGS
+#endif  // defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+
+#include "replay_decoder.h"
+#include "xr_generated_capture.hpp"
+#include <openxr/openxr.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Record {
+    CaptureRecordHeader header;
+    const char* parameters;
+    size_t parameters_size;
+    // Where the record comes in the order the calls started, and in the order they completed.
+    size_t start_rank;
+    size_t completion_rank;
+    // How many of the calls in the capture had completed when this one started.
+    size_t completed_before;
+};
+
+struct CommandStatistics {
+    uint64_t calls = 0;
+    uint64_t captured_duration = 0;
+    uint64_t replayed_duration = 0;
+    uint64_t mismatches = 0;
+};
+
+// Starts each call once every call that started before it in the capture has started, and every
+// call that had completed when it started has completed, which keeps the order of the calls on
+// different threads the same as in the capture.
+class ReplaySchedule {
+   public:
+    explicit ReplaySchedule(size_t records) : _completed(records, false) {}
+
+    void WaitToStart(const Record& record) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [&] { return _started == record.start_rank && _completed_prefix >= record.completed_before; });
+    }
+
+    // Lets the next call start.
+    void Started() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        ++_started;
+        _changed.notify_all();
+    }
+
+    void Complete(const Record& record) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _completed[record.completion_rank] = true;
+        while (_completed_prefix < _completed.size() && _completed[_completed_prefix]) {
+            ++_completed_prefix;
+        }
+        _changed.notify_all();
+    }
+
+   private:
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    size_t _started = 0;
+    std::vector<bool> _completed;
+    size_t _completed_prefix = 0;
+};
+
+struct ReplayOptions {
+    bool timing = false;
+    bool verbose = false;
+};
+
+void PrintUsage() {
+    fprintf(stderr, "usage: openxr_replay [--timing] [--verbose] <capture file>\n");
+    fprintf(stderr, "  --timing   Start each call no earlier than it started in the capture\n");
+    fprintf(stderr, "  --verbose  Print each call whose result differs from the capture\n");
+}
+
+bool ReadCapture(const char* file_name, std::string& data, std::vector<Record>& records) {
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Could not open %s\n", file_name);
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    CaptureFileHeader file_header{};
+    if (data.size() < sizeof(file_header)) {
+        fprintf(stderr, "%s is not a capture file\n", file_name);
+        return false;
+    }
+    memcpy(&file_header, data.data(), sizeof(file_header));
+    if (memcmp(file_header.magic, XR_CAPTURE_MAGIC, sizeof(file_header.magic)) != 0) {
+        fprintf(stderr, "%s is not a capture file\n", file_name);
+        return false;
+    }
+    if (file_header.format_version != XR_CAPTURE_FORMAT_VERSION || file_header.header_size < sizeof(file_header) ||
+        file_header.header_size > data.size()) {
+        fprintf(stderr, "%s has capture format version %u, this replay reads version %u\n", file_name, file_header.format_version,
+                XR_CAPTURE_FORMAT_VERSION);
+        return false;
+    }
+    if (file_header.api_version != XR_CURRENT_API_VERSION) {
+        fprintf(stderr, "%s was captured with OpenXR %u.%u.%u, this replay was built for %u.%u.%u\n", file_name,
+                static_cast<unsigned>(XR_VERSION_MAJOR(file_header.api_version)),
+                static_cast<unsigned>(XR_VERSION_MINOR(file_header.api_version)),
+                static_cast<unsigned>(XR_VERSION_PATCH(file_header.api_version)),
+                static_cast<unsigned>(XR_VERSION_MAJOR(XR_CURRENT_API_VERSION)),
+                static_cast<unsigned>(XR_VERSION_MINOR(XR_CURRENT_API_VERSION)),
+                static_cast<unsigned>(XR_VERSION_PATCH(XR_CURRENT_API_VERSION)));
+        return false;
+    }
+
+    size_t offset = file_header.header_size;
+    while (offset < data.size()) {
+        Record record{};
+        if (data.size() - offset < sizeof(record.header)) {
+            fprintf(stderr, "%s ends with a truncated record, which is ignored\n", file_name);
+            break;
+        }
+        memcpy(&record.header, data.data() + offset, sizeof(record.header));
+        if (record.header.size < sizeof(record.header) || record.header.size > data.size() - offset) {
+            fprintf(stderr, "%s ends with a truncated record, which is ignored\n", file_name);
+            break;
+        }
+        record.parameters = data.data() + offset + sizeof(record.header);
+        record.parameters_size = record.header.size - sizeof(record.header);
+        records.push_back(record);
+        offset += record.header.size;
+    }
+
+    // A capture can start after the application has already made calls, so the indices are ranked
+    // among the calls that are in the capture.
+    std::vector<uint64_t> call_indices;
+    std::vector<uint64_t> completion_indices;
+    for (const Record& record : records) {
+        call_indices.push_back(record.header.call_index);
+        completion_indices.push_back(record.header.completion_index);
+    }
+    std::sort(call_indices.begin(), call_indices.end());
+    std::sort(completion_indices.begin(), completion_indices.end());
+    for (Record& record : records) {
+        record.start_rank = static_cast<size_t>(
+            std::lower_bound(call_indices.begin(), call_indices.end(), record.header.call_index) - call_indices.begin());
+        record.completion_rank = static_cast<size_t>(
+            std::lower_bound(completion_indices.begin(), completion_indices.end(), record.header.completion_index) -
+            completion_indices.begin());
+        record.completed_before = static_cast<size_t>(
+            std::lower_bound(completion_indices.begin(), completion_indices.end(), record.header.completed_before) -
+            completion_indices.begin());
+    }
+    return true;
+}
+
+void ReplayThread(const std::vector<const Record*>& records, const ReplayOptions& options, ReplaySchedule& schedule,
+                  ReplayObjects& objects, std::chrono::steady_clock::time_point replay_start,
+                  std::map<uint32_t, CommandStatistics>& statistics) {
+    ReplayArena arena;
+    for (const Record* record : records) {
+        schedule.WaitToStart(*record);
+        if (options.timing) {
+            std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds(record->header.start_time));
+        }
+        schedule.Started();
+
+        XrResult captured_result = static_cast<XrResult>(record->header.result);
+        XrResult result = XR_ERROR_RUNTIME_FAILURE;
+        std::string error;
+        auto call_start = std::chrono::steady_clock::now();
+        try {
+            arena.Reset();
+            ReplayDecoder decoder(objects, arena, record->parameters, record->parameters_size);
+            result = ReplayCommand(decoder, record->header.command, captured_result);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        auto call_end = std::chrono::steady_clock::now();
+        schedule.Complete(*record);
+
+        CommandStatistics& command = statistics[record->header.command];
+        ++command.calls;
+        command.captured_duration += record->header.duration;
+        command.replayed_duration +=
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(call_end - call_start).count());
+        if (!error.empty()) {
+            ++command.mismatches;
+            fprintf(stderr, "Call %llu (%s) could not be replayed: %s\n",
+                    static_cast<unsigned long long>(record->header.call_index), ReplayCommandName(record->header.command),
+                    error.c_str());
+        } else if (result != captured_result) {
+            ++command.mismatches;
+            if (options.verbose) {
+                fprintf(stderr, "Call %llu (%s) returned %d, the capture has %d\n",
+                        static_cast<unsigned long long>(record->header.call_index), ReplayCommandName(record->header.command),
+                        static_cast<int>(result), static_cast<int>(captured_result));
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options;
+    const char* file_name = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--timing") == 0) {
+            options.timing = true;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            options.verbose = true;
+        } else if (argv[i][0] != '-' && file_name == nullptr) {
+            file_name = argv[i];
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (file_name == nullptr) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string data;
+    std::vector<Record> records;
+    if (!ReadCapture(file_name, data, records)) {
+        return 1;
+    }
+
+    // Each thread of the capture gets a thread of its own, which makes its calls in the order it
+    // made them.
+    std::map<uint32_t, std::vector<const Record*>> thread_records;
+    for (const Record& record : records) {
+        thread_records[record.header.thread].push_back(&record);
+    }
+    for (auto& thread : thread_records) {
+        std::sort(thread.second.begin(), thread.second.end(),
+                  [](const Record* a, const Record* b) { return a->header.call_index < b->header.call_index; });
+    }
+
+    ReplaySchedule schedule(records.size());
+    ReplayObjects objects;
+    std::vector<std::map<uint32_t, CommandStatistics>> thread_statistics(thread_records.size());
+    std::vector<std::thread> threads;
+    auto replay_start = std::chrono::steady_clock::now();
+    size_t thread_index = 0;
+    for (const auto& thread : thread_records) {
+        threads.emplace_back(ReplayThread, std::cref(thread.second), std::cref(options), std::ref(schedule), std::ref(objects),
+                             replay_start, std::ref(thread_statistics[thread_index++]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::map<uint32_t, CommandStatistics> statistics;
+    uint64_t mismatches = 0;
+    for (const auto& thread : thread_statistics) {
+        for (const auto& command : thread) {
+            CommandStatistics& total = statistics[command.first];
+            total.calls += command.second.calls;
+            total.captured_duration += command.second.captured_duration;
+            total.replayed_duration += command.second.replayed_duration;
+            total.mismatches += command.second.mismatches;
+            mismatches += command.second.mismatches;
+        }
+    }
+
+    printf("Replayed %zu calls on %zu threads, %llu returned a different result than in the capture\n", records.size(),
+           thread_records.size(), static_cast<unsigned long long>(mismatches));
+    // The durations are the average of each command, in microseconds.
+    printf("%-48s %10s %14s %14s %10s\n", "Command", "Calls", "Captured us", "Replayed us", "Different");
+    for (const auto& command : statistics) {
+        const CommandStatistics& total = command.second;
+        printf("%-48s %10llu %14.3f %14.3f %10llu\n", ReplayCommandName(command.first),
+               static_cast<unsigned long long>(total.calls), total.captured_duration / 1000.0 / total.calls,
+               total.replayed_duration / 1000.0 / total.calls, static_cast<unsigned long long>(total.mismatches));
+    }
+    return mismatches == 0 ? 0 : 2;
+}
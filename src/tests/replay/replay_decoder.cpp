@@ -0,0 +1,114 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "replay_decoder.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace {
+const size_t kBlockSize = 64 * 1024;
+const size_t kAlignment = alignof(std::max_align_t);
+
+XRAPI_ATTR XrBool32 XRAPI_CALL ReplayDebugUtilsMessengerCallback(XrDebugUtilsMessageSeverityFlagsEXT /* messageSeverity */,
+                                                                 XrDebugUtilsMessageTypeFlagsEXT /* messageTypes */,
+                                                                 const XrDebugUtilsMessengerCallbackDataEXT* /* callbackData */,
+                                                                 void* /* userData */) {
+    return XR_FALSE;
+}
+}  // namespace
+
+void* ReplayArena::Allocate(size_t size) {
+    size = (size + kAlignment - 1) / kAlignment * kAlignment;
+    if (size > kBlockSize) {
+        _large.emplace_back(new char[size]());
+        return _large.back().get();
+    }
+    if (_block < _blocks.size() && _used + size > kBlockSize) {
+        ++_block;
+        _used = 0;
+    }
+    if (_block == _blocks.size()) {
+        _blocks.emplace_back(new char[kBlockSize]);
+    }
+    char* data = _blocks[_block].get() + _used;
+    _used += size;
+    memset(data, 0, size);
+    return data;
+}
+
+void ReplayArena::Reset() {
+    _block = 0;
+    _used = 0;
+    _large.clear();
+}
+
+uint64_t ReplayObjects::Translate(uint32_t kind, uint64_t captured) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (kind < _translations.size()) {
+        auto it = _translations[kind].find(captured);
+        if (it != _translations[kind].end()) {
+            return it->second;
+        }
+    }
+    return captured;
+}
+
+XrGeneratedDispatchTable* ReplayObjects::Table(uint32_t kind, uint64_t replayed) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (kind < _replayed.size()) {
+        auto it = _replayed[kind].find(replayed);
+        if (it != _replayed[kind].end()) {
+            return it->second.table;
+        }
+    }
+    return nullptr;
+}
+
+XrGeneratedDispatchTable* ReplayObjects::AddInstance(XrInstance instance) {
+    std::unique_ptr<XrGeneratedDispatchTable> table(new XrGeneratedDispatchTable());
+    GeneratedXrPopulateDispatchTable(table.get(), instance, xrGetInstanceProcAddr);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _tables.push_back(std::move(table));
+    return _tables.back().get();
+}
+
+void ReplayObjects::Add(uint32_t kind, uint64_t captured, uint64_t replayed, XrGeneratedDispatchTable* table) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (kind >= _translations.size()) {
+        _translations.resize(kind + 1);
+        _replayed.resize(kind + 1);
+    }
+    _translations[kind][captured] = replayed;
+    _replayed[kind][replayed] = Replayed{captured, table};
+}
+
+void ReplayObjects::Remove(uint32_t kind, uint64_t replayed) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (kind >= _replayed.size()) {
+        return;
+    }
+    auto it = _replayed[kind].find(replayed);
+    if (it != _replayed[kind].end()) {
+        _translations[kind].erase(it->second.captured);
+        _replayed[kind].erase(it);
+    }
+}
+
+void ReplayDecoder::ReadAddress(PFN_xrDebugUtilsMessengerCallbackEXT& callback) {
+    callback = ReadObjectValue() != 0 ? ReplayDebugUtilsMessengerCallback : nullptr;
+}
+
+void ReplayDecoder::ReadStringArray(const char* const*& array) {
+    array = nullptr;
+    uint32_t count = ReadCount();
+    if (count != kCaptureNullCount) {
+        const char** strings = Allocate<const char*>(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            strings[i] = ReadString();
+        }
+        array = strings;
+    }
+}
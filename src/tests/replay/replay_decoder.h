@@ -0,0 +1,221 @@
+// Copyright (c) 2017-2021, The Khronos Group Inc.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include "capture_stream.h"
+#include "xr_dependencies.h"
+#include "xr_generated_dispatch_table.h"
+#include <openxr/openxr.h>
+#include <openxr/openxr_platform.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Memory for the parameters of one call.  Everything allocated is released together by Reset,
+// which keeps the blocks around for the next call.
+class ReplayArena {
+   public:
+    // Zeroed, and aligned for any type.
+    void* Allocate(size_t size);
+    void Reset();
+
+   private:
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    size_t _block = 0;
+    size_t _used = 0;
+    // Allocations too large for a block are freed by Reset.
+    std::vector<std::unique_ptr<char[]>> _large;
+};
+
+// The handles and atoms created by the replay, keyed by the values they had in the capture, and the
+// dispatch table of the instance each belongs to.  Shared by all replay threads.
+class ReplayObjects {
+   public:
+    ReplayObjects() = default;
+    ReplayObjects(const ReplayObjects&) = delete;
+    ReplayObjects& operator=(const ReplayObjects&) = delete;
+
+    // Values the replay did not create, such as the handles of calls that failed in the capture,
+    // are passed through unchanged.
+    uint64_t Translate(uint32_t kind, uint64_t captured) const;
+    XrGeneratedDispatchTable* Table(uint32_t kind, uint64_t replayed) const;
+
+    XrGeneratedDispatchTable* AddInstance(XrInstance instance);
+    void Add(uint32_t kind, uint64_t captured, uint64_t replayed, XrGeneratedDispatchTable* table);
+    void Remove(uint32_t kind, uint64_t replayed);
+
+   private:
+    struct Replayed {
+        uint64_t captured;
+        XrGeneratedDispatchTable* table;
+    };
+
+    mutable std::mutex _mutex;
+    // Indexed by kind.
+    std::vector<std::unordered_map<uint64_t, uint64_t>> _translations;
+    std::vector<std::unordered_map<uint64_t, Replayed>> _replayed;
+    // Kept until the end of the replay, as calls on other threads may still be using them.
+    std::vector<std::unique_ptr<XrGeneratedDispatchTable>> _tables;
+};
+
+// Reads the parameters of a captured call back into the structures the call is replayed with,
+// translating the handles and atoms it contains into those of the replay.  Used by the generated
+// code in xr_generated_replay.cpp, where each kind is a ReplayObjectKind.
+class ReplayDecoder : public CaptureDecoder {
+   public:
+    ReplayDecoder(ReplayObjects& objects, ReplayArena& arena, const char* data, size_t size)
+        : CaptureDecoder(data, size), _objects(objects), _arena(arena) {}
+
+    template <typename T>
+    T* Allocate(size_t count) {
+        return static_cast<T*>(_arena.Allocate(sizeof(T) * count));
+    }
+
+    template <typename T>
+    void ReadObject(uint32_t kind, T& object) {
+        uint64_t value = _objects.Translate(kind, ReadObjectValue());
+        memcpy(&object, &value, sizeof(object));
+    }
+
+    // The memory the address pointed to in the capture does not exist here.
+    template <typename T>
+    void ReadAddress(T& pointer) {
+        ReadObjectValue();
+        pointer = nullptr;
+    }
+    // Messengers get a callback that ignores the messages.
+    void ReadAddress(PFN_xrDebugUtilsMessengerCallbackEXT& callback);
+
+    // A pointer to a single value, written as a presence flag followed by the value.
+    template <typename T>
+    void ReadPointee(T*& pointer) {
+        pointer = nullptr;
+        if (ReadPresence()) {
+            typename std::remove_const<T>::type* value = Allocate<typename std::remove_const<T>::type>(1);
+            Read(value, sizeof(*value));
+            pointer = value;
+        }
+    }
+
+    // Only allocates the value, for the call to return something into.
+    template <typename T>
+    void ReadPointeeShape(T*& pointer) {
+        pointer = nullptr;
+        if (ReadPresence()) {
+            pointer = Allocate<typename std::remove_const<T>::type>(1);
+        }
+    }
+
+    template <typename T>
+    void ReadObjectPointee(uint32_t kind, T*& pointer) {
+        pointer = nullptr;
+        if (ReadPresence()) {
+            typename std::remove_const<T>::type* value = Allocate<typename std::remove_const<T>::type>(1);
+            ReadObject(kind, *value);
+            pointer = value;
+        }
+    }
+
+    // An array, written as its size followed by the elements.
+    template <typename T>
+    void ReadArray(T*& array) {
+        array = nullptr;
+        uint32_t count = ReadCount();
+        if (count != kCaptureNullCount) {
+            typename std::remove_const<T>::type* elements = Allocate<typename std::remove_const<T>::type>(count);
+            Read(elements, sizeof(*elements) * count);
+            array = elements;
+        }
+    }
+
+    template <typename T>
+    void ReadArrayShape(T*& array) {
+        array = nullptr;
+        uint32_t count = ReadCount();
+        if (count != kCaptureNullCount) {
+            array = Allocate<typename std::remove_const<T>::type>(count);
+        }
+    }
+
+    template <typename T>
+    void ReadObjectArray(uint32_t kind, T*& array) {
+        array = nullptr;
+        uint32_t count = ReadCount();
+        if (count != kCaptureNullCount) {
+            typename std::remove_const<T>::type* elements = Allocate<typename std::remove_const<T>::type>(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                ReadObject(kind, elements[i]);
+            }
+            array = elements;
+        }
+    }
+
+    void ReadStringArray(const char* const*& array);
+
+    template <typename T>
+    XrGeneratedDispatchTable* Table(uint32_t kind, T object) const {
+        return _objects.Table(kind, ObjectValue(object));
+    }
+
+    XrGeneratedDispatchTable* AddInstance(XrInstance instance) { return _objects.AddInstance(instance); }
+
+    // Reads the object a call returned in the capture, and maps it to the one the replayed call
+    // returned, if it succeeded too.
+    template <typename T>
+    void ReadReturnedObject(uint32_t kind, const T* object, XrResult result, XrGeneratedDispatchTable* table) {
+        if (ReadPresence()) {
+            uint64_t captured = ReadObjectValue();
+            if (object != nullptr && XR_SUCCEEDED(result)) {
+                _objects.Add(kind, captured, ObjectValue(*object), table);
+            }
+        }
+    }
+
+    // The returned array is never larger than the capacity the call was replayed with.
+    template <typename T>
+    void ReadReturnedObjects(uint32_t kind, const T* array, XrResult result, XrGeneratedDispatchTable* table) {
+        uint32_t count = ReadCount();
+        if (count == kCaptureNullCount) {
+            return;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t captured = ReadObjectValue();
+            if (array != nullptr && XR_SUCCEEDED(result)) {
+                _objects.Add(kind, captured, ObjectValue(array[i]), table);
+            }
+        }
+    }
+
+    template <typename T>
+    void RemoveObject(uint32_t kind, T object) {
+        _objects.Remove(kind, ObjectValue(object));
+    }
+
+   private:
+    template <typename T>
+    static uint64_t ObjectValue(T object) {
+        uint64_t value = 0;
+        memcpy(&value, &object, sizeof(object));
+        return value;
+    }
+
+    ReplayObjects& _objects;
+    ReplayArena& _arena;
+};
+
+// Generated into xr_generated_replay.cpp.
+
+// Decodes the parameters of one call and makes it through the loader.  Returns the result of the
+// replayed call, and throws if the record cannot be decoded.
+XrResult ReplayCommand(ReplayDecoder& decoder, uint32_t command, XrResult captured_result);
+// The name of a CaptureCommand, or "unknown command".
+const char* ReplayCommandName(uint32_t command);